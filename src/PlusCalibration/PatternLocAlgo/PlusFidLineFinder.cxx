@@ -42,6 +42,12 @@ PlusFidLineFinder::PlusFidLineFinder()
 
   m_MinThetaRad = -1.0;
   m_MaxThetaRad = -1.0;
+
+  m_DotGridCellSizePx = 1.0;
+  m_DotGridOrigin[0] = 0.0;
+  m_DotGridOrigin[1] = 0.0;
+  m_DotGridDimensions[0] = 0;
+  m_DotGridDimensions[1] = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -445,13 +451,14 @@ void PlusFidLineFinder::FindLines2Points()
   {
     //the expected length of the line
     int lineLenPx = floor(m_Patterns[i]->GetDistanceToOriginMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel + 0.5);
+    int lineLenTolerancePx = floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel + 0.5);
 
     for (unsigned int dot1Index = 0; dot1Index < m_DotsVector.size() - 1; dot1Index++)
     {
       for (unsigned int dot2Index = dot1Index + 1; dot2Index < m_DotsVector.size(); dot2Index++)
       {
         double length = SegmentLength(m_DotsVector[dot1Index], m_DotsVector[dot2Index]);
-        bool acceptLength = fabs(length - lineLenPx) < floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel + 0.5);
+        bool acceptLength = fabs(length - lineLenPx) < lineLenTolerancePx;
 
         if (acceptLength)  //to only add valid two point lines
         {
@@ -464,15 +471,16 @@ void PlusFidLineFinder::FindLines2Points()
             twoPointsLine.AddPoint(dot1Index);
             twoPointsLine.AddPoint(dot2Index);
 
-            bool duplicate = std::binary_search(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), twoPointsLine, PlusFidLine::compareLines);
+            // the lines are kept sorted, so that duplicates can be found by a binary search
+            std::vector<PlusFidLine>::iterator insertPosition = std::lower_bound(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), twoPointsLine, PlusFidLine::compareLines);
+            bool duplicate = (insertPosition != twoPointsLinesVector.end() && !PlusFidLine::compareLines(twoPointsLine, *insertPosition));
 
             if (!duplicate)
             {
               twoPointsLine.SetStartPointIndex(dot1Index);
               ComputeLine(twoPointsLine);
 
-              twoPointsLinesVector.push_back(twoPointsLine);
-              std::sort(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), PlusFidLine::compareLines);   //the lines need to be sorted that way each time for the binary search to be performed
+              twoPointsLinesVector.insert(insertPosition, twoPointsLine);
             }
           }
         }
@@ -506,6 +514,22 @@ void PlusFidLineFinder::FindLinesNPoints()
     }
   }
 
+  // A point can only be added to a line if it is close to the expected position: on the line (within dist)
+  // and at the expected distance from the start point (within the length tolerance). The line is the one
+  // through the start and end points of the shorter line, as in ComputeDistancePointLine (not a fitted line).
+  // Index the dots by position so that only dots around the expected position have to be tested.
+  double maxSearchRadiusPx = dist;
+  for (unsigned int i = 0 ; i < m_Patterns.size() ; i++)
+  {
+    for (unsigned int w = 0 ; w < m_Patterns[i]->GetDistanceToOriginToleranceMm().size() ; w++)
+    {
+      double lineLenTolerancePx = floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[w] / m_ApproximateSpacingMmPerPixel + 0.5);
+      maxSearchRadiusPx = std::max(maxSearchRadiusPx, lineLenTolerancePx + dist);
+    }
+  }
+  BuildDotGrid(maxSearchRadiusPx);
+
+  std::vector<int> nearbyDotIndices;
   for (unsigned int i = 0 ; i < m_Patterns.size() ; i++)
   {
     for (unsigned int linesVectorIndex = 3 ; linesVectorIndex <= maxNumberOfPointsPerLine ; linesVectorIndex++)
@@ -515,13 +539,32 @@ void PlusFidLineFinder::FindLinesNPoints()
         continue;
       }
 
+      int lineLenPx = floor(m_Patterns[i]->GetDistanceToOriginMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
+      int lineLenTolerancePx = floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
+      // Accepted points are within lineLenTolerancePx along and dist across the line from the expected position
+      double searchRadiusPx = (lineLenTolerancePx + dist) * sqrt(2.0) + 1.0;
+
       for (unsigned int l = 0; l < m_LinesVector[linesVectorIndex - 1].size(); l++)
       {
         PlusFidLine currentShorterPointsLine;
         currentShorterPointsLine = m_LinesVector[linesVectorIndex - 1][l]; //the current max point line we want to expand
 
-        for (unsigned int b3 = 0; b3 < m_DotsVector.size(); b3++)
+        const PlusFidDot& startDot = m_DotsVector[currentShorterPointsLine.GetStartPointIndex()];
+        const PlusFidDot& endDot = m_DotsVector[currentShorterPointsLine.GetEndPointIndex()];
+        double originToEndPointVector[3] = { endDot.GetX() - startDot.GetX(), endDot.GetY() - startDot.GetY(), 0 };
+        double originToEndPointDistance = vtkMath::Normalize(originToEndPointVector);
+        if (originToEndPointDistance > 0)
         {
+          GetDotsNearPosition(startDot.GetX() + originToEndPointVector[0] * lineLenPx, startDot.GetY() + originToEndPointVector[1] * lineLenPx, searchRadiusPx, nearbyDotIndices);
+        }
+        else
+        {
+          GetDotsNearPosition(startDot.GetX(), startDot.GetY(), lineLenPx + searchRadiusPx, nearbyDotIndices);
+        }
+
+        for (std::vector<int>::iterator dotIt = nearbyDotIndices.begin(); dotIt != nearbyDotIndices.end(); ++dotIt)
+        {
+          int b3 = (*dotIt);
           std::vector<int> candidatesIndex;
           bool checkDuplicateFlag = false;//assume there is no duplicate
 
@@ -558,8 +601,7 @@ void PlusFidLineFinder::FindLinesNPoints()
 
             double length = SegmentLength(m_DotsVector[currentShorterPointsLine.GetStartPointIndex()], m_DotsVector[b3]);   //distance between the origin and the point we try to add
 
-            int lineLenPx = floor(m_Patterns[i]->GetDistanceToOriginMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
-            bool acceptLength = fabs(length - lineLenPx) < floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
+            bool acceptLength = fabs(length - lineLenPx) < lineLenTolerancePx;
 
             if (!acceptLength)
             {
@@ -567,13 +609,8 @@ void PlusFidLineFinder::FindLinesNPoints()
             }
 
             // Create the vector between the origin point to the end point and between the origin point to the new point to check if the new point is between the origin and the end point
-            double originToEndPointVector[3] = { m_DotsVector[currentShorterPointsLine.GetEndPointIndex()].GetX() - m_DotsVector[currentShorterPointsLine.GetStartPointIndex()].GetX(),
-                                                 m_DotsVector[currentShorterPointsLine.GetEndPointIndex()].GetY() - m_DotsVector[currentShorterPointsLine.GetStartPointIndex()].GetY(),
-                                                 0
-                                               };
-
-            double originToNewPointVector[3] = {m_DotsVector[b3].GetX() - m_DotsVector[currentShorterPointsLine.GetStartPointIndex()].GetX(),
-                                                m_DotsVector[b3].GetY() - m_DotsVector[currentShorterPointsLine.GetStartPointIndex()].GetY(),
+            double originToNewPointVector[3] = {m_DotsVector[b3].GetX() - startDot.GetX(),
+                                                m_DotsVector[b3].GetY() - startDot.GetY(),
                                                 0
                                                };
 
@@ -591,14 +628,15 @@ void PlusFidLineFinder::FindLinesNPoints()
               m_LinesVector.push_back(emptyLine);
             }
 
-            if (!std::binary_search(m_LinesVector[linesVectorIndex].begin(), m_LinesVector[linesVectorIndex].end(), line, PlusFidLine::compareLines))
+            // the lines are kept sorted, so that lines that are already in the list can be quickly found by a binary search
+            std::vector<PlusFidLine>& lines = m_LinesVector[linesVectorIndex];
+            std::vector<PlusFidLine>::iterator insertPosition = std::lower_bound(lines.begin(), lines.end(), line, PlusFidLine::compareLines);
+            if (insertPosition == lines.end() || PlusFidLine::compareLines(line, *insertPosition))
             {
               ComputeLine(line);
               if (AcceptLine(line))
               {
-                m_LinesVector[linesVectorIndex].push_back(line);
-                // sort the lines so that lines that are already in the list can be quickly found by a binary search
-                std::sort(m_LinesVector[linesVectorIndex].begin(), m_LinesVector[linesVectorIndex].end(), PlusFidLine::compareLines);
+                lines.insert(insertPosition, line);
               }
             }
           }
@@ -614,6 +652,64 @@ void PlusFidLineFinder::FindLinesNPoints()
 
 //-----------------------------------------------------------------------------
 
+void PlusFidLineFinder::BuildDotGrid(double cellSizePx)
+{
+  m_DotGridCellSizePx = std::max(cellSizePx, 1.0);
+  m_DotGridCells.clear();
+  m_DotGridDimensions[0] = 0;
+  m_DotGridDimensions[1] = 0;
+  if (m_DotsVector.empty())
+  {
+    return;
+  }
+
+  double maxPosition[2] = { m_DotsVector[0].GetX(), m_DotsVector[0].GetY() };
+  m_DotGridOrigin[0] = maxPosition[0];
+  m_DotGridOrigin[1] = maxPosition[1];
+  for (std::vector<PlusFidDot>::const_iterator dotIt = m_DotsVector.begin(); dotIt != m_DotsVector.end(); ++dotIt)
+  {
+    m_DotGridOrigin[0] = std::min(m_DotGridOrigin[0], dotIt->GetX());
+    m_DotGridOrigin[1] = std::min(m_DotGridOrigin[1], dotIt->GetY());
+    maxPosition[0] = std::max(maxPosition[0], dotIt->GetX());
+    maxPosition[1] = std::max(maxPosition[1], dotIt->GetY());
+  }
+  m_DotGridDimensions[0] = static_cast<int>((maxPosition[0] - m_DotGridOrigin[0]) / m_DotGridCellSizePx) + 1;
+  m_DotGridDimensions[1] = static_cast<int>((maxPosition[1] - m_DotGridOrigin[1]) / m_DotGridCellSizePx) + 1;
+  m_DotGridCells.resize(m_DotGridDimensions[0] * m_DotGridDimensions[1]);
+
+  for (unsigned int dotIndex = 0; dotIndex < m_DotsVector.size(); dotIndex++)
+  {
+    int cellX = static_cast<int>((m_DotsVector[dotIndex].GetX() - m_DotGridOrigin[0]) / m_DotGridCellSizePx);
+    int cellY = static_cast<int>((m_DotsVector[dotIndex].GetY() - m_DotGridOrigin[1]) / m_DotGridCellSizePx);
+    m_DotGridCells[cellY * m_DotGridDimensions[0] + cellX].push_back(dotIndex);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void PlusFidLineFinder::GetDotsNearPosition(double x, double y, double radiusPx, std::vector<int>& dotIndices) const
+{
+  dotIndices.clear();
+  if (m_DotGridCells.empty())
+  {
+    return;
+  }
+  int minCellX = std::max(0, static_cast<int>(floor((x - radiusPx - m_DotGridOrigin[0]) / m_DotGridCellSizePx)));
+  int minCellY = std::max(0, static_cast<int>(floor((y - radiusPx - m_DotGridOrigin[1]) / m_DotGridCellSizePx)));
+  int maxCellX = std::min(m_DotGridDimensions[0] - 1, static_cast<int>(floor((x + radiusPx - m_DotGridOrigin[0]) / m_DotGridCellSizePx)));
+  int maxCellY = std::min(m_DotGridDimensions[1] - 1, static_cast<int>(floor((y + radiusPx - m_DotGridOrigin[1]) / m_DotGridCellSizePx)));
+  for (int cellY = minCellY; cellY <= maxCellY; cellY++)
+  {
+    for (int cellX = minCellX; cellX <= maxCellX; cellX++)
+    {
+      const std::vector<int>& cell = m_DotGridCells[cellY * m_DotGridDimensions[0] + cellX];
+      dotIndices.insert(dotIndices.end(), cell.begin(), cell.end());
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
 void PlusFidLineFinder::Clear()
 {
   //LOG_TRACE("FidLineFinder::Clear");
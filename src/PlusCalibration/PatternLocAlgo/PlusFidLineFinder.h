@@ -41,6 +41,9 @@ public:
   /*! Set the approximate spacing in Mm per pixel */
   void SetApproximateSpacingMmPerPixel(double value) { m_ApproximateSpacingMmPerPixel = value; };
 
+  /*! Get the approximate spacing in Mm per pixel */
+  double GetApproximateSpacingMmPerPixel() const { return m_ApproximateSpacingMmPerPixel; };
+
   /*! Set the minimum angle allowed for a line, in degrees */
   void SetMinThetaDegrees(double angleDeg);
 
@@ -106,6 +109,13 @@ protected:
   /*! Return true if an angle is in the allowed angle range, false otherwise */
   bool AcceptAngleRad(double angleRad);
 
+  /*! Sort the dots into square cells of the given size, so that dots around a position can be found without testing all dots */
+  void BuildDotGrid(double cellSizePx);
+
+  /*! Get the indices of all dots that are in the grid cells touched by the square of the given half size around the position.
+  Dots that are farther than the radius may be returned, too. */
+  void GetDotsNearPosition(double x, double y, double radiusPx, std::vector<int>& dotIndices) const;
+
   //Accessors and mutators
 
   /*! Get the maximum rotation vector, this maximum rotation represents the physical limitation of the probe,
@@ -133,6 +143,12 @@ protected:
   std::vector<PlusFidDot> m_DotsVector;
   std::vector< std::vector<PlusFidLine> > m_LinesVector;
 
+  // Spatial index of m_DotsVector, built by BuildDotGrid
+  double m_DotGridCellSizePx;
+  double m_DotGridOrigin[2];
+  int m_DotGridDimensions[2];
+  std::vector< std::vector<int> > m_DotGridCells;
+
   std::vector<PlusFidPattern*> m_Patterns;
 };
 
@@ -15,10 +15,14 @@ See License.txt for details.
 
 static const double DOT_STEPS  = 4.0;
 static const double DOT_RADIUS = 6.0;
+static const double DEFAULT_TEMPORAL_TRACKING_SEARCH_RADIUS_MM = 3.0;
 
 //-----------------------------------------------------------------------------
 
 PlusFidPatternRecognition::PlusFidPatternRecognition()
+  : m_MaxLineLengthToleranceMm(0.0)
+  , m_TemporalTrackingEnabled(false)
+  , m_TemporalTrackingSearchRadiusMm(DEFAULT_TEMPORAL_TRACKING_SEARCH_RADIUS_MM)
 {
 
 }
@@ -46,6 +50,14 @@ PlusStatus PlusFidPatternRecognition::ReadConfiguration(vtkXMLDataElement* rootC
   m_FidLineFinder.ReadConfiguration(rootConfigElement);
   m_FidLabeling.ReadConfiguration(rootConfigElement, m_FidLineFinder.GetMinThetaRad(), m_FidLineFinder.GetMaxThetaRad());
 
+  XML_FIND_NESTED_ELEMENT_OPTIONAL(segmentationParameters, rootConfigElement, "Segmentation");
+  if (segmentationParameters != NULL)
+  {
+    XML_READ_BOOL_ATTRIBUTE_OPTIONAL(TemporalTrackingEnabled, segmentationParameters);
+    XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, TemporalTrackingSearchRadiusMm, segmentationParameters);
+  }
+  ResetTemporalTracking();
+
   return PLUS_SUCCESS;
 }
 
@@ -120,16 +132,30 @@ PlusStatus PlusFidPatternRecognition::RecognizePattern(igsioTrackedFrame* tracke
 
   m_FidSegmentation.SetCandidateFidValues(m_FidSegmentation.GetDotsVector());
 
-  m_FidLineFinder.SetCandidateFidValues(m_FidSegmentation.GetCandidateFidValues());
-  m_FidLineFinder.SetDotsVector(m_FidSegmentation.GetDotsVector());
-  m_FidLabeling.SetDotsVector(m_FidSegmentation.GetDotsVector());
-
-  m_FidLineFinder.FindLines();
+  bool patternFound = false;
+  if (m_TemporalTrackingEnabled && !m_PreviousFoundDotsCoordinateValue.empty())
+  {
+    // Warm start: search the pattern around its previous position first
+    std::vector<PlusFidDot> trackedDots;
+    GetDotsNearPreviousPattern(m_FidSegmentation.GetDotsVector(), trackedDots);
+    if (trackedDots.size() >= m_PreviousFoundDotsCoordinateValue.size())
+    {
+      patternFound = FindPattern(trackedDots);
+    }
+    if (!patternFound)
+    {
+      LOG_TRACE("Pattern is not found around its position in the previous frame, search among all candidates");
+    }
+  }
+  if (!patternFound)
+  {
+    patternFound = FindPattern(m_FidSegmentation.GetDotsVector());
+  }
 
-  if (m_FidLineFinder.GetLinesVector().size() > 3)
+  m_PreviousFoundDotsCoordinateValue.clear();
+  if (patternFound)
   {
-    m_FidLabeling.SetLinesVector(m_FidLineFinder.GetLinesVector());
-    m_FidLabeling.FindPattern();
+    m_PreviousFoundDotsCoordinateValue = m_FidLabeling.GetFoundDotsCoordinateValue();
   }
 
   if (m_FidSegmentation.GetDebugOutput())
@@ -158,6 +184,57 @@ PlusStatus PlusFidPatternRecognition::RecognizePattern(igsioTrackedFrame* tracke
 
 //-----------------------------------------------------------------------------
 
+bool PlusFidPatternRecognition::FindPattern(std::vector<PlusFidDot>& dots)
+{
+  m_FidLineFinder.Clear();
+  m_FidLabeling.Clear();
+
+  m_FidLineFinder.SetCandidateFidValues(m_FidSegmentation.GetCandidateFidValues());
+  m_FidLineFinder.SetDotsVector(dots);
+  m_FidLabeling.SetDotsVector(dots);
+
+  m_FidLineFinder.FindLines();
+
+  if (m_FidLineFinder.GetLinesVector().size() > 3)
+  {
+    m_FidLabeling.SetLinesVector(m_FidLineFinder.GetLinesVector());
+    m_FidLabeling.FindPattern();
+  }
+
+  return m_FidLabeling.GetDotsFound() && !m_FidLabeling.GetFoundDotsCoordinateValue().empty();
+}
+
+//-----------------------------------------------------------------------------
+
+void PlusFidPatternRecognition::GetDotsNearPreviousPattern(const std::vector<PlusFidDot>& dots, std::vector<PlusFidDot>& trackedDots)
+{
+  trackedDots.clear();
+  double searchRadiusPx = m_TemporalTrackingSearchRadiusMm / m_FidLineFinder.GetApproximateSpacingMmPerPixel();
+  double searchRadiusSquaredPx = searchRadiusPx * searchRadiusPx;
+  for (std::vector<PlusFidDot>::const_iterator dotIt = dots.begin(); dotIt != dots.end(); ++dotIt)
+  {
+    for (std::vector< std::vector<double> >::const_iterator previousDotIt = m_PreviousFoundDotsCoordinateValue.begin(); previousDotIt != m_PreviousFoundDotsCoordinateValue.end(); ++previousDotIt)
+    {
+      double dx = dotIt->GetX() - (*previousDotIt)[0];
+      double dy = dotIt->GetY() - (*previousDotIt)[1];
+      if (dx * dx + dy * dy <= searchRadiusSquaredPx)
+      {
+        trackedDots.push_back(*dotIt);
+        break;
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void PlusFidPatternRecognition::ResetTemporalTracking()
+{
+  m_PreviousFoundDotsCoordinateValue.clear();
+}
+
+//-----------------------------------------------------------------------------
+
 PlusStatus PlusFidPatternRecognition::RecognizePattern(vtkIGSIOTrackedFrameList* trackedFrameList, PatternRecognitionError& patternRecognitionError, int* numberOfSuccessfullySegmentedImages/*=NULL*/, std::vector<unsigned int>* segmentedFramesIndices)
 {
   LOG_TRACE("FidPatternRecognition::RecognizePattern");
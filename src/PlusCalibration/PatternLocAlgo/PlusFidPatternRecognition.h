@@ -95,7 +95,27 @@ public:
   /*! Reads the phantom definition and computes the NWires intersection if needed */
   PlusStatus ReadPhantomDefinition(vtkXMLDataElement* rootConfigElement);
 
+  /*!
+  Enable temporal tracking. If enabled, the pattern is first searched among the dots that are close to the
+  pattern found in the previous frame, which is much faster than searching among all candidates.
+  If the pattern is not found this way then all candidates are searched.
+  */
+  void SetTemporalTrackingEnabled(bool enabled) { m_TemporalTrackingEnabled = enabled; };
+  bool GetTemporalTrackingEnabled() const { return m_TemporalTrackingEnabled; };
+
+  /*! Set the maximum distance of a dot from its position in the previous frame, in mm */
+  void SetTemporalTrackingSearchRadiusMm(double radiusMm) { m_TemporalTrackingSearchRadiusMm = radiusMm; };
+  double GetTemporalTrackingSearchRadiusMm() const { return m_TemporalTrackingSearchRadiusMm; };
+
+  /*! Forget the pattern found in the previous frame (next frame is searched among all candidates) */
+  void ResetTemporalTracking();
+
 protected:
+  /*! Find lines and the pattern among the dots. Returns true if the pattern is found. */
+  bool FindPattern(std::vector<PlusFidDot>& dots);
+
+  /*! Get the dots that are close to the dots found in the previous frame */
+  void GetDotsNearPreviousPattern(const std::vector<PlusFidDot>& dots, std::vector<PlusFidDot>& trackedDots);
 
   PlusFidSegmentation           m_FidSegmentation;
   PlusFidLineFinder             m_FidLineFinder;
@@ -103,6 +123,10 @@ protected:
   std::vector<PlusFidPattern*>  m_Patterns;
 
   double                        m_MaxLineLengthToleranceMm;
+
+  bool                          m_TemporalTrackingEnabled;
+  double                        m_TemporalTrackingSearchRadiusMm;
+  std::vector< std::vector<double> > m_PreviousFoundDotsCoordinateValue;
 };
 
 //-----------------------------------------------------------------------------
@@ -9,12 +9,15 @@ See License.txt for details.
 #include "PlusFidPatternRecognition.h"
 #include "PlusPatternLocResultFile.h"
 #include "igsioTrackedFrame.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkSmartPointer.h"
 #include "vtkIGSIOTrackedFrameList.h"
+#include "vtkMath.h"
 #include "vtkXMLDataElement.h"
 #include "vtkXMLUtilities.h"
 #include "vtksys/CommandLineArguments.hxx"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -31,8 +34,225 @@ static const double FIDUCIAL_POSITION_TOLERANCE = 0.1;  // in pixel
 static const double BASELINE_TO_ALGORITHM_TOLERANCE = 5;
 ///////////////////////////////////////////////////////////////////
 
-void SegmentImageSequence(vtkIGSIOTrackedFrameList* trackedFrameList, std::ofstream& outFile, const std::string& inputTestcaseName, const std::string& inputImageSequenceFileName, PlusFidPatternRecognition& patternRecognition, const char* fidPositionOutputFilename)
+//-----------------------------------------------------------------------------
+/*!
+  Line finder that uses the original exhaustive line search, which tests every dot against every shorter line.
+  Used as a reference for checking that the indexed line search of PlusFidLineFinder finds exactly the same lines.
+*/
+class ReferenceLineFinder : public PlusFidLineFinder
 {
+public:
+  ReferenceLineFinder(const PlusFidLineFinder& lineFinder) : PlusFidLineFinder(lineFinder) {}
+
+  /*! Find lines among the dots of the line finder that this object was copied from */
+  void FindLinesReference()
+  {
+    std::vector<PlusFidDot> dots = m_DotsVector;
+    std::vector<PlusFidDot> candidateFidValues = m_CandidateFidValues;
+    Clear();
+    m_DotsVector = dots;
+    m_CandidateFidValues = candidateFidValues;
+
+    FindLines2PointsReference();
+    FindLinesNPointsReference();
+    std::sort(m_LinesVector[m_LinesVector.size() - 1].begin(), m_LinesVector[m_LinesVector.size() - 1].end(), PlusFidLine::lessThan);
+  }
+
+  /*! Find lines using the line search of PlusFidLineFinder */
+  void FindLinesIndexed()
+  {
+    std::vector<PlusFidDot> dots = m_DotsVector;
+    std::vector<PlusFidDot> candidateFidValues = m_CandidateFidValues;
+    Clear();
+    m_DotsVector = dots;
+    m_CandidateFidValues = candidateFidValues;
+
+    FindLines();
+  }
+
+protected:
+  void FindLines2PointsReference()
+  {
+    if (m_DotsVector.size() < 2)
+    {
+      return;
+    }
+
+    std::vector<PlusFidLine> twoPointsLinesVector;
+    for (unsigned int i = 0 ; i < m_Patterns.size() ; i++)
+    {
+      int lineLenPx = floor(m_Patterns[i]->GetDistanceToOriginMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel + 0.5);
+      for (unsigned int dot1Index = 0; dot1Index < m_DotsVector.size() - 1; dot1Index++)
+      {
+        for (unsigned int dot2Index = dot1Index + 1; dot2Index < m_DotsVector.size(); dot2Index++)
+        {
+          double length = SegmentLength(m_DotsVector[dot1Index], m_DotsVector[dot2Index]);
+          bool acceptLength = fabs(length - lineLenPx) < floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel + 0.5);
+          if (!acceptLength || !AcceptAngleRad(ComputeAngleRad(m_DotsVector[dot1Index], m_DotsVector[dot2Index])))
+          {
+            continue;
+          }
+          PlusFidLine twoPointsLine;
+          twoPointsLine.AddPoint(dot1Index);
+          twoPointsLine.AddPoint(dot2Index);
+          if (!std::binary_search(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), twoPointsLine, PlusFidLine::compareLines))
+          {
+            twoPointsLine.SetStartPointIndex(dot1Index);
+            ComputeLine(twoPointsLine);
+            twoPointsLinesVector.push_back(twoPointsLine);
+            std::sort(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), PlusFidLine::compareLines);
+          }
+        }
+      }
+    }
+    std::sort(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), PlusFidLine::lessThan);
+    m_LinesVector.push_back(twoPointsLinesVector);
+  }
+
+  void FindLinesNPointsReference()
+  {
+    double dist = m_CollinearPointsMaxDistanceFromLineMm / m_ApproximateSpacingMmPerPixel;
+    unsigned int maxNumberOfPointsPerLine(0);
+    for (unsigned int i = 0 ; i < m_Patterns.size() ; i++)
+    {
+      maxNumberOfPointsPerLine = std::max(maxNumberOfPointsPerLine, static_cast<unsigned int>(m_Patterns[i]->GetWires().size()));
+    }
+
+    for (unsigned int i = 0 ; i < m_Patterns.size() ; i++)
+    {
+      for (unsigned int linesVectorIndex = 3 ; linesVectorIndex <= maxNumberOfPointsPerLine ; linesVectorIndex++)
+      {
+        if (linesVectorIndex > m_LinesVector.size())
+        {
+          continue;
+        }
+        for (unsigned int l = 0; l < m_LinesVector[linesVectorIndex - 1].size(); l++)
+        {
+          PlusFidLine currentShorterPointsLine = m_LinesVector[linesVectorIndex - 1][l];
+          for (unsigned int b3 = 0; b3 < m_DotsVector.size(); b3++)
+          {
+            std::vector<int> candidatesIndex;
+            bool checkDuplicateFlag = false;
+            for (unsigned int previousPoints = 0 ; previousPoints < currentShorterPointsLine.GetNumberOfPoints() ; previousPoints++)
+            {
+              candidatesIndex.push_back(currentShorterPointsLine.GetPoint(previousPoints));
+              if (candidatesIndex[previousPoints] == static_cast<int>(b3))
+              {
+                checkDuplicateFlag = true;
+              }
+            }
+            if (checkDuplicateFlag || ComputeDistancePointLine(m_DotsVector[b3], currentShorterPointsLine) > dist)
+            {
+              continue;
+            }
+            candidatesIndex.push_back(b3);
+
+            PlusFidLine line;
+            std::sort(candidatesIndex.begin(), candidatesIndex.end());
+            for (unsigned int f = 0; f < candidatesIndex.size(); f++)
+            {
+              line.AddPoint(candidatesIndex[f]);
+            }
+            line.SetStartPointIndex(currentShorterPointsLine.GetStartPointIndex());
+
+            const PlusFidDot& startDot = m_DotsVector[currentShorterPointsLine.GetStartPointIndex()];
+            const PlusFidDot& endDot = m_DotsVector[currentShorterPointsLine.GetEndPointIndex()];
+            double length = SegmentLength(startDot, m_DotsVector[b3]);
+            int lineLenPx = floor(m_Patterns[i]->GetDistanceToOriginMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
+            if (!(fabs(length - lineLenPx) < floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5)))
+            {
+              continue;
+            }
+            double originToEndPointVector[3] = { endDot.GetX() - startDot.GetX(), endDot.GetY() - startDot.GetY(), 0 };
+            double originToNewPointVector[3] = { m_DotsVector[b3].GetX() - startDot.GetX(), m_DotsVector[b3].GetY() - startDot.GetY(), 0 };
+            if (vtkMath::Dot(originToEndPointVector, originToNewPointVector) < 0)
+            {
+              continue;
+            }
+
+            if (m_LinesVector.size() <= linesVectorIndex)
+            {
+              m_LinesVector.push_back(std::vector<PlusFidLine>());
+            }
+            if (!std::binary_search(m_LinesVector[linesVectorIndex].begin(), m_LinesVector[linesVectorIndex].end(), line, PlusFidLine::compareLines))
+            {
+              ComputeLine(line);
+              if (AcceptLine(line))
+              {
+                m_LinesVector[linesVectorIndex].push_back(line);
+                std::sort(m_LinesVector[linesVectorIndex].begin(), m_LinesVector[linesVectorIndex].end(), PlusFidLine::compareLines);
+              }
+            }
+          }
+        }
+      }
+    }
+    if (m_LinesVector[m_LinesVector.size() - 1].empty())
+    {
+      m_LinesVector.pop_back();
+    }
+  }
+};
+
+//-----------------------------------------------------------------------------
+// Return the number of differences between the lines found by the reference and the indexed line search
+int CompareLineSearchToReference(PlusFidPatternRecognition& patternRecognition, unsigned int frameIndex, double& referenceTimeSec, double& indexedTimeSec)
+{
+  ReferenceLineFinder referenceLineFinder(*patternRecognition.GetFidLineFinder());
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  referenceLineFinder.FindLinesReference();
+  referenceTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+  std::vector< std::vector<PlusFidLine> > referenceLines = referenceLineFinder.GetLinesVector();
+
+  ReferenceLineFinder indexedLineFinder(*patternRecognition.GetFidLineFinder());
+  startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  indexedLineFinder.FindLinesIndexed();
+  indexedTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+  std::vector< std::vector<PlusFidLine> > indexedLines = indexedLineFinder.GetLinesVector();
+
+  if (referenceLines.size() != indexedLines.size())
+  {
+    LOG_ERROR("Frame " << frameIndex << ": line search found lines with up to " << indexedLines.size() - 1 << " points, the reference line search found lines with up to "
+              << referenceLines.size() - 1 << " points");
+    return 1;
+  }
+  int numberOfDifferences(0);
+  for (unsigned int numberOfPoints = 0; numberOfPoints < referenceLines.size(); numberOfPoints++)
+  {
+    // Lines with equal intensity may be in any order, so compare them in point order
+    std::sort(referenceLines[numberOfPoints].begin(), referenceLines[numberOfPoints].end(), PlusFidLine::compareLines);
+    std::sort(indexedLines[numberOfPoints].begin(), indexedLines[numberOfPoints].end(), PlusFidLine::compareLines);
+    if (referenceLines[numberOfPoints].size() != indexedLines[numberOfPoints].size())
+    {
+      LOG_ERROR("Frame " << frameIndex << ": line search found " << indexedLines[numberOfPoints].size() << " lines with " << numberOfPoints
+                << " points, the reference line search found " << referenceLines[numberOfPoints].size());
+      numberOfDifferences++;
+      continue;
+    }
+    for (unsigned int l = 0; l < referenceLines[numberOfPoints].size(); l++)
+    {
+      const PlusFidLine& referenceLine = referenceLines[numberOfPoints][l];
+      const PlusFidLine& indexedLine = indexedLines[numberOfPoints][l];
+      if (PlusFidLine::compareLines(referenceLine, indexedLine) || PlusFidLine::compareLines(indexedLine, referenceLine)
+          || referenceLine.GetStartPointIndex() != indexedLine.GetStartPointIndex() || referenceLine.GetEndPointIndex() != indexedLine.GetEndPointIndex()
+          || referenceLine.GetIntensity() != indexedLine.GetIntensity())
+      {
+        LOG_ERROR("Frame " << frameIndex << ": line " << l << " with " << numberOfPoints << " points differs from the line found by the reference line search");
+        numberOfDifferences++;
+      }
+    }
+  }
+  return numberOfDifferences;
+}
+
+//-----------------------------------------------------------------------------
+// Return the number of frames where the line search result differs from the reference line search (if compareReferenceLineSearch is enabled)
+int SegmentImageSequence(vtkIGSIOTrackedFrameList* trackedFrameList, std::ofstream& outFile, const std::string& inputTestcaseName, const std::string& inputImageSequenceFileName, PlusFidPatternRecognition& patternRecognition, const char* fidPositionOutputFilename, bool compareReferenceLineSearch)
+{
+  int numberOfLineSearchDifferences = 0;
+  double referenceLineSearchTimeSec = 0;
+  double indexedLineSearchTimeSec = 0;
+
   double sumFiducialNum = 0;// divide by framenum
   double sumFiducialCandidate = 0;// divide by framenum
 
@@ -65,6 +285,11 @@ void SegmentImageSequence(vtkIGSIOTrackedFrameList* trackedFrameList, std::ofstr
     }
     patternRecognition.RecognizePattern(trackedFrameList->GetTrackedFrame(currentFrameIndex), segResults, error, currentFrameIndex);
 
+    if (compareReferenceLineSearch && CompareLineSearchToReference(patternRecognition, currentFrameIndex, referenceLineSearchTimeSec, indexedLineSearchTimeSec) != 0)
+    {
+      numberOfLineSearchDifferences++;
+    }
+
     sumFiducialCandidate += segResults.GetNumDots();
     int numFid = 0;
     for (unsigned int fidPosition = 0; fidPosition < segResults.GetFoundDotsCoordinateValue().size(); fidPosition++)
@@ -109,6 +334,13 @@ void SegmentImageSequence(vtkIGSIOTrackedFrameList* trackedFrameList, std::ofstr
   {
     outFileFidPositions.close();
   }
+
+  if (compareReferenceLineSearch)
+  {
+    LOG_INFO("Line search time for " << trackedFrameList->GetNumberOfTrackedFrames() << " frames: " << indexedLineSearchTimeSec * 1000.0
+             << "ms (reference line search: " << referenceLineSearchTimeSec * 1000.0 << "ms)");
+  }
+  return numberOfLineSearchDifferences;
 }
 
 // return the number of differences
@@ -376,6 +608,7 @@ int main(int argc, char** argv)
   std::string outputTestResultsFileName;
   std::string outputFiducialPositionsFileName;
   std::string fiducialGeomString;
+  bool compareReferenceLineSearch(false);
 
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
@@ -391,6 +624,7 @@ int main(int argc, char** argv)
   args.AddArgument("--output-fiducial-positions-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFiducialPositionsFileName, "Name of file for storing fiducial positions in time");
 
   args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Calibration configuration file name");
+  args.AddArgument("--compare-reference-line-search", vtksys::CommandLineArguments::NO_ARGUMENT, &compareReferenceLineSearch, "Check that the line search finds the same lines in each frame as the exhaustive reference line search");
 
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
 
@@ -448,13 +682,19 @@ int main(int argc, char** argv)
   }
 
   LOG_INFO("Segment image sequence");
-  SegmentImageSequence(trackedFrameList.GetPointer(), outFile, inputTestcaseName, inputImageSequenceFileName, patternRecognition, fidPositionOutputFilename);
+  int numberOfLineSearchDifferences = SegmentImageSequence(trackedFrameList.GetPointer(), outFile, inputTestcaseName, inputImageSequenceFileName, patternRecognition, fidPositionOutputFilename, compareReferenceLineSearch);
 
   PlusUsFidSegResultFile::WriteSegmentationResultsFooter(outFile);
   outFile.close();
 
   LOG_DEBUG("Done!");
 
+  if (numberOfLineSearchDifferences > 0)
+  {
+    LOG_ERROR("Line search result differs from the reference line search in " << numberOfLineSearchDifferences << " frames");
+    return EXIT_FAILURE;
+  }
+
   if (!inputBaselineFileName.empty())
   {
     LOG_INFO("Compare results");
@@ -217,6 +217,7 @@ int main( int argc, char** argv )
   std::vector<int> clipRectSize;
   std::string inputBaselineFileName;
   bool saveImages = false;
+  int streamingChunkSize = 0;
 
   args.AddArgument( "--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help." );
   args.AddArgument( "--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)" );
@@ -224,6 +225,7 @@ int main( int argc, char** argv )
   args.AddArgument( "--clip-rect-origin", vtksys::CommandLineArguments::MULTI_ARGUMENT, &clipRectOrigin, "Origin of the clipping rectangle" );
   args.AddArgument( "--clip-rect-size", vtksys::CommandLineArguments::MULTI_ARGUMENT, &clipRectSize, "Size of the clipping rectangle" );
   args.AddArgument( "--save-images", vtksys::CommandLineArguments::NO_ARGUMENT, &saveImages, "Save images with detected lines overlaid" );
+  args.AddArgument( "--streaming-chunk-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &streamingChunkSize, "If specified then frames are passed to the algorithm in chunks of this size (streaming mode) instead of processing the whole sequence at once" );
   args.AddArgument( "--baseline-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputBaselineFileName, "Input xml baseline file name with path" );
 
   if ( !args.Parse() )
@@ -271,15 +273,36 @@ int main( int argc, char** argv )
     lineSegmenter->SetClipRectangle( origin, size );
   }
 
-  lineSegmenter->SetTrackedFrameList( *trackedFrameList );
   lineSegmenter->SetSaveIntermediateImages( saveImages );
   lineSegmenter->SetIntermediateFilesOutputDirectory( vtkPlusConfig::GetInstance()->GetOutputDirectory() );
 
   LOG_DEBUG( "Segment lines" );
-  if ( lineSegmenter->Update() != PLUS_SUCCESS )
+  if ( streamingChunkSize > 0 )
   {
-    LOG_ERROR( "Failed to get line positions from video frames" );
-    return PLUS_FAIL;
+    // Simulate frames arriving from a live channel
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> chunkFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    for ( unsigned int frameIndex = 0; frameIndex < trackedFrameList->GetNumberOfTrackedFrames(); ++frameIndex )
+    {
+      chunkFrameList->AddTrackedFrame( trackedFrameList->GetTrackedFrame( frameIndex ) );
+      if ( chunkFrameList->GetNumberOfTrackedFrames() >= static_cast<unsigned int>( streamingChunkSize ) || frameIndex + 1 == trackedFrameList->GetNumberOfTrackedFrames() )
+      {
+        if ( lineSegmenter->AddFrames( chunkFrameList ) != PLUS_SUCCESS )
+        {
+          LOG_ERROR( "Failed to get line positions from video frames" );
+          return EXIT_FAILURE;
+        }
+        chunkFrameList->Clear();
+      }
+    }
+  }
+  else
+  {
+    lineSegmenter->SetTrackedFrameList( *trackedFrameList );
+    if ( lineSegmenter->Update() != PLUS_SUCCESS )
+    {
+      LOG_ERROR( "Failed to get line positions from video frames" );
+      return PLUS_FAIL;
+    }
   }
   std::vector<vtkPlusLineSegmentationAlgo::LineParameters> lineParameters;
   lineSegmenter->GetDetectedLineParameters( lineParameters );
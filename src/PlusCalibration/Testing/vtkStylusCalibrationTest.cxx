@@ -14,6 +14,7 @@
 #include "PlusMath.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusDataCollector.h"
+#include "vtkMath.h"
 #include "vtkMatrix4x4.h"
 #include "vtkMinimalStandardRandomSequence.h"
 #include "vtkPlusPivotCalibrationAlgo.h"
@@ -35,6 +36,7 @@ const double TRANSLATION_ERROR_THRESHOLD = 0.5; // error threshold is 0.5mm
 const double ROTATION_ERROR_THRESHOLD = 0.5; // error threshold is 0.5deg
 
 int CompareCalibrationResultsWithBaseline(const char* baselineFileName, const char* currentResultFileName, const char* stylusCoordinateFrame, const char* stylusTipCoordinateFrame);
+int CompareIncrementalCalibrationResults(vtkPlusPivotCalibrationAlgo* pivotCalibration, vtkIGSIOTransformRepository* transformRepository);
 
 int main(int argc, char* argv[])
 {
@@ -44,6 +46,7 @@ int main(int argc, char* argv[])
   int numberOfPointsToAcquire = 100;
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
   double outlierGenerationProbability = 0.0;
+  bool compareIncremental = false;
 
   vtksys::CommandLineArguments cmdargs;
   cmdargs.Initialize(argc, argv);
@@ -52,6 +55,7 @@ int main(int argc, char* argv[])
   cmdargs.AddArgument("--baseline-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputBaselineFileName, "Name of file storing baseline calibration results");
   cmdargs.AddArgument("--number-of-points-to-acquire", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfPointsToAcquire, "Number of acquired points during the pivot calibration (default: 100)");
   cmdargs.AddArgument("--outlier-generation-probability", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outlierGenerationProbability, "Probability for a point being an outlier. If this number is larger than 0 then some valid measurement points are replaced by randomly generated samples to test the robustness of the algorithm. (range: 0.0-1.0; default: 0.0)");
+  cmdargs.AddArgument("--compare-incremental", vtksys::CommandLineArguments::NO_ARGUMENT, &compareIncremental, "Compute the pivot point with incremental calibration, too, and compare it to the batch calibration result");
   cmdargs.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
 
   if (!cmdargs.Parse())
@@ -204,6 +208,10 @@ int main(int argc, char* argv[])
     }
 
     pivotCalibration->InsertNextCalibrationPoint(stylusToReferenceMatrix);
+    if (compareIncremental)
+    {
+      pivotCalibration->InsertNextIncrementalCalibrationPoint(stylusToReferenceMatrix);
+    }
   }
   vtkPlusLogger::PrintProgressbar(100.0);
 
@@ -221,6 +229,13 @@ int main(int argc, char* argv[])
   LOG_INFO("Number of detected outliers: " << pivotCalibration->GetNumberOfDetectedOutliers());
   LOG_INFO("Mean calibration error: " << pivotCalibration->GetPivotCalibrationErrorMm() << " mm");
 
+  if (compareIncremental && CompareIncrementalCalibrationResults(pivotCalibration, transformRepository) != 0)
+  {
+    LOG_ERROR("Comparison of incremental and batch calibration results failed");
+    std::cout << "Exit failure!!!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
   // Save result
   if (transformRepository->WriteConfiguration(configRootElement) != PLUS_SUCCESS)
   {
@@ -320,3 +335,35 @@ int CompareCalibrationResultsWithBaseline(const char* baselineFileName, const ch
 
   return numberOfFailures;
 }
+
+//-----------------------------------------------------------------------------
+
+// return the number of differences
+int CompareIncrementalCalibrationResults(vtkPlusPivotCalibrationAlgo* pivotCalibration, vtkIGSIOTransformRepository* transformRepository)
+{
+  double incrementalPivotPoint_Marker[3] = {0};
+  if (pivotCalibration->GetIncrementalPivotPointToMarkerTranslation(incrementalPivotPoint_Marker) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Incremental calibration result is not available");
+    return 1;
+  }
+  LOG_INFO("Incremental calibration: " << pivotCalibration->GetIncrementalCalibrationNumberOfPoints() << " points, "
+           << pivotCalibration->GetIncrementalCalibrationNumberOfRejectedPoints() << " rejected, RMS error: " << pivotCalibration->GetIncrementalCalibrationErrorMm() << " mm");
+
+  igsioTransformName pivotPointToMarkerTransformName(pivotCalibration->GetObjectPivotPointCoordinateFrame(), pivotCalibration->GetObjectMarkerCoordinateFrame());
+  vtkSmartPointer<vtkMatrix4x4> pivotPointToMarkerMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  if (transformRepository->GetTransform(pivotPointToMarkerTransformName, pivotPointToMarkerMatrix) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get pivot calibration result from the transform repository");
+    return 1;
+  }
+
+  double batchPivotPoint_Marker[3] = {pivotPointToMarkerMatrix->GetElement(0, 3), pivotPointToMarkerMatrix->GetElement(1, 3), pivotPointToMarkerMatrix->GetElement(2, 3)};
+  double posDiff = sqrt(vtkMath::Distance2BetweenPoints(incrementalPivotPoint_Marker, batchPivotPoint_Marker));
+  if (posDiff > TRANSLATION_ERROR_THRESHOLD)
+  {
+    LOG_ERROR("Incremental and batch pivot point mismatch: translation difference is " << posDiff << ", maximum allowed is " << TRANSLATION_ERROR_THRESHOLD);
+    return 1;
+  }
+  return 0;
+}
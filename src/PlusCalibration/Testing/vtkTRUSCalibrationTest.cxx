@@ -32,6 +32,7 @@
 const double ERROR_THRESHOLD = 0.05; // error threshold is 5% 
 
 int CompareCalibrationResultsWithBaseline(const char* baselineFileName, const char* currentResultFileName, double translationErrorThreshold, double rotationErrorThreshold); 
+int CompareOptimizationSolvers(vtkPlusProbeCalibrationAlgo* probeCal, vtkIGSIOTrackedFrameList* validationTrackedFrameList, vtkIGSIOTrackedFrameList* calibrationTrackedFrameList, vtkIGSIOTransformRepository* transformRepository, const std::vector<PlusNWire>& nWires);
 
 int main (int argc, char* argv[])
 { 
@@ -46,6 +47,7 @@ int main (int argc, char* argv[])
   double inputTranslationErrorThreshold(1e-10); 
   double inputRotationErrorThreshold(1e-10); 
 
+  bool compareOptimizationSolvers(false);
   int verboseLevel=vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
   vtksys::CommandLineArguments cmdargs;
@@ -60,6 +62,7 @@ int main (int argc, char* argv[])
   cmdargs.AddArgument("--baseline-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputBaselineFileName, "Name of file storing baseline calibration results");
   cmdargs.AddArgument("--translation-error-threshold", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputTranslationErrorThreshold, "Translation error threshold in mm.");  
   cmdargs.AddArgument("--rotation-error-threshold", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputRotationErrorThreshold, "Rotation error threshold in degrees.");  
+  cmdargs.AddArgument("--compare-optimization-solvers", vtksys::CommandLineArguments::NO_ARGUMENT, &compareOptimizationSolvers, "Run the calibration optimization with all solvers and compare the results and computation times.");
   cmdargs.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");  
 
   if ( !cmdargs.Parse() )
@@ -213,6 +216,11 @@ int main (int argc, char* argv[])
     LOG_ERROR("Comparison of calibration data to baseline failed");
   }
 
+  if ( compareOptimizationSolvers )
+  {
+    numberOfFailures += CompareOptimizationSolvers( probeCal, validationTrackedFrameList, calibrationTrackedFrameList, transformRepository, patternRecognition.GetFidLineFinder()->GetNWires() );
+  }
+
   if ( numberOfFailures > 0 )
   {
     std::cout << "Test exited with failures!!!" << std::endl; 
@@ -225,6 +233,57 @@ int main (int argc, char* argv[])
 
 //----------------------------------------------------------------------------
 
+// Calibrate with the Powell and the Levenberg-Marquardt solvers, and compare the optimization errors and computation times
+// return the number of failures
+int CompareOptimizationSolvers(vtkPlusProbeCalibrationAlgo* probeCal, vtkIGSIOTrackedFrameList* validationTrackedFrameList, vtkIGSIOTrackedFrameList* calibrationTrackedFrameList, vtkIGSIOTransformRepository* transformRepository, const std::vector<PlusNWire>& nWires)
+{
+  int numberOfFailures=0;
+
+  vtkPlusProbeCalibrationOptimizerAlgo* optimizer = probeCal->GetOptimizer();
+  if ( !optimizer->Enabled() )
+  {
+    optimizer->SetOptimizationMethod(vtkPlusProbeCalibrationOptimizerAlgo::MINIMIZE_DISTANCE_OF_ALL_WIRES_IN_2D);
+  }
+
+  const vtkPlusProbeCalibrationOptimizerAlgo::OptimizationSolverType solvers[2] =
+  {
+    vtkPlusProbeCalibrationOptimizerAlgo::SOLVER_POWELL,
+    vtkPlusProbeCalibrationOptimizerAlgo::SOLVER_LEVENBERG_MARQUARDT
+  };
+  double errorRms[2] = { 0.0, 0.0 };
+  double computationTimeSec[2] = { 0.0, 0.0 };
+  for ( int solverIndex = 0; solverIndex < 2; solverIndex++ )
+  {
+    optimizer->SetOptimizationSolver(solvers[solverIndex]);
+    if (probeCal->Calibrate( validationTrackedFrameList, calibrationTrackedFrameList, transformRepository, nWires) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Calibration failed with " << vtkPlusProbeCalibrationOptimizerAlgo::GetOptimizationSolverAsString(solvers[solverIndex]) << " optimization solver");
+      return ++numberOfFailures;
+    }
+    computationTimeSec[solverIndex] = optimizer->GetLastOptimizationTimeSec();
+    double errorMean=0.0;
+    double errorStDev=0.0;
+    optimizer->ComputeError(optimizer->GetOptimizedImageToProbeTransformMatrix(), errorMean, errorStDev, errorRms[solverIndex]);
+    LOG_INFO("Optimization solver " << vtkPlusProbeCalibrationOptimizerAlgo::GetOptimizationSolverAsString(solvers[solverIndex])
+      << ": error rms = " << errorRms[solverIndex] << ", computation time = " << computationTimeSec[solverIndex] << " sec");
+  }
+
+  // Levenberg-Marquardt minimizes the same error, so the result must not be worse than the Powell result
+  if ( errorRms[1] > errorRms[0] * (1.0 + ERROR_THRESHOLD) )
+  {
+    LOG_ERROR("Levenberg-Marquardt optimization error (" << errorRms[1] << ") is larger than the Powell optimization error (" << errorRms[0] << ")");
+    numberOfFailures++;
+  }
+  if ( computationTimeSec[1] > 0 )
+  {
+    LOG_INFO("Levenberg-Marquardt speedup compared to Powell: " << computationTimeSec[0] / computationTimeSec[1] << "x");
+  }
+
+  return numberOfFailures;
+}
+
+//----------------------------------------------------------------------------
+
 // return the number of differences
 int CompareCalibrationResultsWithBaseline(const char* baselineFileName, const char* currentResultFileName, double translationErrorThreshold, double rotationErrorThreshold)
 {
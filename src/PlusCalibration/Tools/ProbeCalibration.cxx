@@ -39,6 +39,7 @@ const double ERROR_THRESHOLD = 0.05;
 #endif
 
 int CompareCalibrationResultsWithBaseline(const char* baselineFileName, const char* currentResultFileName, double translationErrorThreshold, double rotationErrorThreshold);
+int CompareIncrementalCalibrationResults(vtkPlusProbeCalibrationAlgo* freehandCalibration, vtkIGSIOTrackedFrameList* calibrationTrackedFrameList, vtkIGSIOTransformRepository* transformRepository, const std::vector<PlusNWire>& nWires, double errorThreshold);
 
 int main(int argc, char* argv[])
 {
@@ -59,6 +60,9 @@ int main(int argc, char* argv[])
   double inputRotationErrorThreshold(1e-10);
 #endif
 
+  bool compareIncremental(false);
+  double incrementalErrorThreshold(1.0);
+
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
   vtksys::CommandLineArguments args;
@@ -75,6 +79,9 @@ int main(int argc, char* argv[])
   args.AddArgument("--translation-error-threshold", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputTranslationErrorThreshold, "Translation error threshold in mm. Used for baseline comparison.");
   args.AddArgument("--rotation-error-threshold", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputRotationErrorThreshold, "Rotation error threshold in degrees. Used for baseline comparison.");
 
+  args.AddArgument("--compare-incremental", vtksys::CommandLineArguments::NO_ARGUMENT, &compareIncremental, "Compute the calibration with incremental calibration, too, and compare it to the batch calibration result.");
+  args.AddArgument("--incremental-error-threshold", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &incrementalErrorThreshold, "Maximum allowed distance in mm between image points transformed by the incremental and the batch calibration result (default: 1.0).");
+
   args.AddArgument("--output-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &resultConfigFileName, "Result configuration file name. Optional.");
 
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
@@ -208,6 +215,17 @@ int main(int argc, char* argv[])
     }
   }
 
+  if (compareIncremental)
+  {
+    LOG_INFO("Compare incremental calibration with batch calibration");
+    if (CompareIncrementalCalibrationResults(freehandCalibration, calibrationTrackedFrameList, transformRepository, patternRecognition.GetFidLineFinder()->GetNWires(), incrementalErrorThreshold) != 0)
+    {
+      LOG_ERROR("Comparison of incremental and batch calibration results failed");
+      std::cout << "Exit failure!!!" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   std::cout << "Calibration has been completed successfully" << std::endl;
   return EXIT_SUCCESS;
 }
@@ -1009,3 +1027,76 @@ int CompareCalibrationResultsWithBaseline(const char* baselineFileName, const ch
 
   return numberOfFailures;
 }
+
+//-------------------------------------------------------------------------------------------------
+// Feed the calibration frames one by one to the incremental calibration and compare the result to the batch calibration result
+// (that has to be computed already). The results are compared by transforming the image corners and center to the probe frame,
+// because that shows the difference in mm where the image is, independently from how the difference is distributed between the
+// axes and the translation.
+// return the number of differences
+int CompareIncrementalCalibrationResults(vtkPlusProbeCalibrationAlgo* freehandCalibration, vtkIGSIOTrackedFrameList* calibrationTrackedFrameList, vtkIGSIOTransformRepository* transformRepository, const std::vector<PlusNWire>& nWires, double errorThreshold)
+{
+  if (calibrationTrackedFrameList->GetNumberOfTrackedFrames() < 1)
+  {
+    LOG_ERROR("Calibration data is empty");
+    return 1;
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> batchImageToProbeMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  freehandCalibration->GetImageToProbeTransformMatrix(batchImageToProbeMatrix);
+
+  if (freehandCalibration->StartIncrementalCalibration(nWires) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start incremental calibration");
+    return 1;
+  }
+  for (unsigned int frameIndex = 0; frameIndex < calibrationTrackedFrameList->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    if (freehandCalibration->AddIncrementalCalibrationFrame(calibrationTrackedFrameList->GetTrackedFrame(frameIndex), transformRepository) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add frame #" << frameIndex << " to incremental calibration");
+      return 1;
+    }
+  }
+  if (!freehandCalibration->IsIncrementalCalibrationResultAvailable())
+  {
+    LOG_ERROR("Incremental calibration result is not available");
+    return 1;
+  }
+  LOG_INFO("Incremental calibration: " << freehandCalibration->GetIncrementalCalibrationNumberOfFrames() << " frames, "
+           << freehandCalibration->GetIncrementalCalibrationNumberOfRejectedFrames() << " rejected, RMS error: " << freehandCalibration->GetIncrementalCalibrationRmsErrorMm() << " mm");
+
+  vtkSmartPointer<vtkMatrix4x4> incrementalImageToProbeMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  freehandCalibration->GetImageToProbeTransformMatrix(incrementalImageToProbeMatrix);
+  vnl_matrix_fixed<double, 4, 4> incrementalImageToProbeTransformMatrix;
+  PlusMath::ConvertVtkMatrixToVnlMatrix(incrementalImageToProbeMatrix, incrementalImageToProbeTransformMatrix);
+  LOG_INFO("Incremental image to probe transform matrix = ");
+  PlusMath::LogMatrix(incrementalImageToProbeTransformMatrix, 6);
+
+  FrameSizeType frameSize = calibrationTrackedFrameList->GetTrackedFrame(0)->GetFrameSize();
+  const double imagePoints[5][2] =
+  {
+    { 0, 0 },
+    { static_cast<double>(frameSize[0] - 1), 0 },
+    { 0, static_cast<double>(frameSize[1] - 1) },
+    { static_cast<double>(frameSize[0] - 1), static_cast<double>(frameSize[1] - 1) },
+    { 0.5 * (frameSize[0] - 1), 0.5 * (frameSize[1] - 1) }
+  };
+  int numberOfFailures = 0;
+  for (int pointIndex = 0; pointIndex < 5; ++pointIndex)
+  {
+    double point_Image[4] = { imagePoints[pointIndex][0], imagePoints[pointIndex][1], 0, 1 };
+    double batchPoint_Probe[4] = { 0, 0, 0, 1 };
+    double incrementalPoint_Probe[4] = { 0, 0, 0, 1 };
+    batchImageToProbeMatrix->MultiplyPoint(point_Image, batchPoint_Probe);
+    incrementalImageToProbeMatrix->MultiplyPoint(point_Image, incrementalPoint_Probe);
+    double posDiff = sqrt(vtkMath::Distance2BetweenPoints(batchPoint_Probe, incrementalPoint_Probe));
+    if (posDiff > errorThreshold)
+    {
+      LOG_ERROR("Incremental and batch calibration mismatch at image point (" << point_Image[0] << ", " << point_Image[1] << "): distance is " << posDiff << " mm, maximum allowed is " << errorThreshold << " mm");
+      numberOfFailures++;
+    }
+  }
+
+  return numberOfFailures;
+}
@@ -15,10 +15,8 @@ See License.txt for details.
 
 // ITK includes
 #include <itkBinaryThresholdImageFilter.h>
-#include <itkImageDuplicator.h>
 #include <itkImageFileWriter.h>
 #include <itkImageRegionIterator.h>
-#include <itkLineIterator.h>
 #include <itkOtsuThresholdImageFilter.h>
 #include <itkRGBPixel.h>
 #include <itkResampleImageFilter.h>
@@ -31,6 +29,7 @@ See License.txt for details.
 #include <vtkContextView.h>
 #endif
 #include <vtkDoubleArray.h>
+#include <vtkImageData.h>
 #include <vtkIntArray.h>
 #include <vtkObjectFactory.h>
 #include <vtkPen.h>
@@ -41,6 +40,11 @@ See License.txt for details.
 #include <vtkRenderer.h>
 #include <vtkTable.h>
 
+// STL includes
+#include <algorithm>
+#include <future>
+#include <thread>
+
 static const double INTESNITY_THRESHOLD_PERCENTAGE_OF_PEAK = 0.5; // threshold (as the percentage of the peak intensity along a scanline) for COG
 static const double MAX_CONSECUTIVE_INVALID_VIDEO_FRAMES = 10; // the maximum number of consecutive invalid frames before warning message issued
 static const double MAX_PERCENTAGE_OF_INVALID_VIDEO_FRAMES = 0.1; // the maximum percentage of the invalid frames before warning message issued
@@ -71,6 +75,7 @@ vtkPlusLineSegmentationAlgo::vtkPlusLineSegmentationAlgo()
   , m_SaveIntermediateImages(false)
   , IntermediateFilesOutputDirectory("")
   , PlotIntensityProfile(false)
+  , NumberOfThreads(0)
   , m_SignalTimeRangeMin(0.0)
   , m_SignalTimeRangeMax(-1.0)
 {
@@ -186,213 +191,279 @@ PlusStatus vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric()
 {
   m_SignalValues.clear();
   m_SignalTimestamps.clear();
-
-  LineParameters nonDetectedLineParams;
-  nonDetectedLineParams.lineDetected = false;
-  nonDetectedLineParams.lineOriginPoint_Image[0] = 0;
-  nonDetectedLineParams.lineOriginPoint_Image[1] = 0;
-  nonDetectedLineParams.lineDirectionVector_Image[0] = 0;
-  nonDetectedLineParams.lineDirectionVector_Image[1] = 1;
-  m_LineParameters.assign(m_TrackedFrameList->GetNumberOfTrackedFrames(), nonDetectedLineParams);
+  m_LineParameters.clear();
 
   //  For each video frame, detect line and extract mindpoint and slope parameters
-  int numberOfSuccessfulLineSegmentations = 0;
-  bool signalTimeRangeDefined = (m_SignalTimeRangeMin <= m_SignalTimeRangeMax);
-  for (unsigned int frameNumber = 0; frameNumber < m_TrackedFrameList->GetNumberOfTrackedFrames(); ++frameNumber)
+  int numberOfSuccessfulLineSegmentations = ProcessFrames(m_TrackedFrameList, 0);
+
+  double segmentationSuccessRate = double(numberOfSuccessfulLineSegmentations) / m_TrackedFrameList->GetNumberOfTrackedFrames();
+  if (segmentationSuccessRate < EXPECTED_LINE_SEGMENTATION_SUCCESS_RATE)
   {
-    LOG_TRACE("Calculating video position metric for frame " << frameNumber);
-    igsioTrackedFrame* trackedFrame = m_TrackedFrameList->GetTrackedFrame(frameNumber);
-    if (signalTimeRangeDefined && (trackedFrame->GetTimestamp() < m_SignalTimeRangeMin || trackedFrame->GetTimestamp() > m_SignalTimeRangeMax))
-    {
-      // frame is out of the specified signal range
-      LOG_TRACE("Skip frame, it is out of the valid signal range");
-      continue;
-    }
+    LOG_WARNING("Line segmentation success rate is very low (" << segmentationSuccessRate * 100 << "%): a line could only be detected on " << numberOfSuccessfulLineSegmentations << " frames out of " << m_TrackedFrameList->GetNumberOfTrackedFrames());
+  }
 
-    // Get current image
-    if (trackedFrame->GetImageData()->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
-    {
-      LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric only supports 8-bit images");
-      continue;
-    }
-    auto localImage = CharImageType::New();
-    PlusCommon::DeepCopyVtkVolumeToItkImage<CharPixelType>(trackedFrame->GetImageData()->GetImage(), localImage);
-    if (localImage.IsNull())
-    {
-      // Dropped frame
-      LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric failed to retrieve image data from frame");
-      continue;
-    }
+  bool plotVideoMetric = vtkPlusLogger::Instance()->GetLogLevel() >= vtkPlusLogger::LOG_LEVEL_TRACE;
+  if (plotVideoMetric)
+  {
+    PlotDoubleArray(m_SignalValues);
+  }
 
-    // Create an image duplicator to copy the original image
-    typedef itk::ImageDuplicator<CharImageType> DuplicatorType;
-    auto duplicator = DuplicatorType::New();
-    CharImageType::Pointer scanlineImage;
-    if (m_SaveIntermediateImages == true)
-    {
-      duplicator->SetInputImage(localImage);
-      duplicator->Update();
+  return PLUS_SUCCESS;
 
-      // Create an image copy to draw the scanlines on
-      scanlineImage = duplicator->GetOutput();
-    }
+} //  End LineDetection
 
-    std::vector<itk::Point<double, 2> > intensityPeakPositions;
-    CharImageType::RegionType region = localImage->GetLargestPossibleRegion();
-    LimitToClipRegion(region);
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusLineSegmentationAlgo::AddFrames(vtkIGSIOTrackedFrameList* trackedFrameList)
+{
+  if (trackedFrameList == NULL)
+  {
+    LOG_ERROR("vtkPlusLineSegmentationAlgo::AddFrames failed: invalid input frame list");
+    return PLUS_FAIL;
+  }
+  if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  if (vtkIGSIOTrackedFrameList::VerifyProperties(trackedFrameList, US_IMG_ORIENT_MF, US_IMG_BRIGHTNESS) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusLineSegmentationAlgo::AddFrames failed: video data orientation or type is not supported (MF orientation, BRIGHTNESS type is expected)");
+    return PLUS_FAIL;
+  }
+
+  int numberOfSuccessfulLineSegmentations = ProcessFrames(trackedFrameList, static_cast<int>(m_LineParameters.size()));
+  LOG_TRACE("Line detected on " << numberOfSuccessfulLineSegmentations << " out of " << trackedFrameList->GetNumberOfTrackedFrames() << " new frames");
+  return PLUS_SUCCESS;
+}
 
-    int numOfValidScanlines = 0;
+//-----------------------------------------------------------------------------
+int vtkPlusLineSegmentationAlgo::ProcessFrames(vtkIGSIOTrackedFrameList* trackedFrameList, int firstFrameNumber)
+{
+  const unsigned int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+  std::vector<FrameResult> frameResults(numberOfFrames);
 
-    for (int currScanlineNum = 0; currScanlineNum < NUMBER_OF_SCANLINES; ++currScanlineNum)
+  // Intermediate image saving and intensity profile plotting are for debugging, they are only supported on a single thread
+  unsigned int numberOfThreads = (this->NumberOfThreads > 0 ? this->NumberOfThreads : std::thread::hardware_concurrency());
+  if (m_SaveIntermediateImages || this->PlotIntensityProfile)
+  {
+    numberOfThreads = 1;
+  }
+  numberOfThreads = std::max(1u, std::min(numberOfFrames, numberOfThreads));
+
+  std::vector<std::future<void> > workers;
+  for (unsigned int threadIndex = 1; threadIndex < numberOfThreads; ++threadIndex)
+  {
+    workers.push_back(std::async(std::launch::async, [ =, &frameResults]()
     {
-      // Set the scanline start pixel
-      CharImageType::IndexType startPixel;
-      double scanlineSpacingPix = static_cast<double>(region.GetSize()[0] - 1) / (NUMBER_OF_SCANLINES - 1);
-      startPixel[0] = region.GetIndex()[0] + scanlineSpacingPix * (currScanlineNum);
-      startPixel[1] = region.GetIndex()[1];
-
-      // Set the scanline end pixel
-      CharImageType::IndexType endPixel;
-      endPixel[0] = startPixel[0];
-      endPixel[1] = startPixel[1] + region.GetSize()[1] - 1;
-
-      std::deque<int> intensityProfile; // Holds intensity profile of the line
-      itk::LineIterator<CharImageType> it(localImage, startPixel, endPixel);
-      it.GoToBegin();
-
-      itk::LineIterator<CharImageType>* itScanlineImage = NULL;
-      if (m_SaveIntermediateImages == true)
+      ScanlineBuffers buffers;
+      for (unsigned int frameIndex = threadIndex; frameIndex < numberOfFrames; frameIndex += numberOfThreads)
       {
-        // Iterator for the scanline image copy
-        // it's time-consuming to instantiate this iterator, so only do it if intermediate image saving is requested
-        itScanlineImage = new itk::LineIterator<CharImageType>(scanlineImage, startPixel, endPixel);
-        itScanlineImage->GoToBegin();
+        ProcessFrame(trackedFrameList->GetTrackedFrame(frameIndex), firstFrameNumber + frameIndex, buffers, frameResults[frameIndex]);
       }
+    }));
+  }
+  ScanlineBuffers buffers;
+  for (unsigned int frameIndex = 0; frameIndex < numberOfFrames; frameIndex += numberOfThreads)
+  {
+    ProcessFrame(trackedFrameList->GetTrackedFrame(frameIndex), firstFrameNumber + frameIndex, buffers, frameResults[frameIndex]);
+  }
+  for (auto workerIt = workers.begin(); workerIt != workers.end(); ++workerIt)
+  {
+    workerIt->get();
+  }
 
-      while (!it.IsAtEnd())
-      {
-        intensityProfile.push_back((int)it.Get());
-        if (m_SaveIntermediateImages == true)
-        {
-          // Set the pixels on the scanline image copy to white
-          itScanlineImage->Set(255);
-          ++(*itScanlineImage);
-        }
-        ++it;
-      }
+  // Collect results in frame order
+  int numberOfSuccessfulLineSegmentations = 0;
+  for (unsigned int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+  {
+    m_LineParameters.push_back(frameResults[frameIndex].Parameters);
+    if (!frameResults[frameIndex].Parameters.lineDetected)
+    {
+      continue;
+    }
+    ++numberOfSuccessfulLineSegmentations;
+    m_SignalValues.push_back(frameResults[frameIndex].SignalValue);
+    m_SignalTimestamps.push_back(trackedFrameList->GetTrackedFrame(frameIndex)->GetTimestamp());
+  }
 
-      // Delete the iterator declared with new()
-      if (itScanlineImage != NULL)
-      {
-        delete itScanlineImage;
-        itScanlineImage = NULL;
-      }
+  return numberOfSuccessfulLineSegmentations;
+}
 
-      if (this->PlotIntensityProfile)
-      {
-        // Plot the intensity profile
-        PlotIntArray(intensityProfile);
-      }
+//-----------------------------------------------------------------------------
+void vtkPlusLineSegmentationAlgo::ProcessFrame(igsioTrackedFrame* trackedFrame, int frameNumber, ScanlineBuffers& buffers, FrameResult& result)
+{
+  result.Parameters.lineDetected = false;
+  result.Parameters.lineOriginPoint_Image[0] = 0;
+  result.Parameters.lineOriginPoint_Image[1] = 0;
+  result.Parameters.lineDirectionVector_Image[0] = 0;
+  result.Parameters.lineDirectionVector_Image[1] = 1;
+  result.SignalValue = 0;
+
+  LOG_TRACE("Calculating video position metric for frame " << frameNumber);
+  bool signalTimeRangeDefined = (m_SignalTimeRangeMin <= m_SignalTimeRangeMax);
+  if (signalTimeRangeDefined && (trackedFrame->GetTimestamp() < m_SignalTimeRangeMin || trackedFrame->GetTimestamp() > m_SignalTimeRangeMax))
+  {
+    // frame is out of the specified signal range
+    LOG_TRACE("Skip frame, it is out of the valid signal range");
+    return;
+  }
 
-      // Find the max intensity value from the peak with the largest area
-      int maxFromLargestArea = -1;
-      int maxFromLargestAreaIndex = -1;
-      int startOfMaxArea = -1;
-      if (FindLargestPeak(intensityProfile, maxFromLargestArea, maxFromLargestAreaIndex, startOfMaxArea) == PLUS_SUCCESS)
-      {
-        double currPeakPos_y = -1;
-        switch (PEAK_POS_METRIC)
-        {
-          case PEAK_POS_COG:
-            {
-              /* Use center-of-gravity (COG) as peak-position metric*/
-              if (ComputeCenterOfGravity(intensityProfile, startOfMaxArea, currPeakPos_y) != PLUS_SUCCESS)
-              {
-                // unable to compute center-of-gravity; this scanline is invalid
-                continue;
-              }
-              break;
-            }
-          case PEAK_POS_START:
-            {
-              /* Use peak start as peak-position metric*/
-              if (FindPeakStart(intensityProfile, maxFromLargestArea, startOfMaxArea, currPeakPos_y) != PLUS_SUCCESS)
-              {
-                // unable to compute peak start; this scanline is invalid
-                continue;
-              }
-              break;
-            }
-        }
+  // Get current image
+  if (trackedFrame->GetImageData()->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
+  {
+    LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric only supports 8-bit images");
+    return;
+  }
+  vtkImageData* image = trackedFrame->GetImageData()->GetImage();
+  if (image == NULL || image->GetScalarPointer() == NULL)
+  {
+    // Dropped frame
+    LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric failed to retrieve image data from frame");
+    return;
+  }
 
-        itk::Point<double, 2> currPeakPos;
-        currPeakPos[0] = static_cast<double>(startPixel[0]);
-        currPeakPos[1] = startPixel[1] + currPeakPos_y;
-        intensityPeakPositions.push_back(currPeakPos);
-        ++numOfValidScanlines;
+  // Scanlines are read directly from the frame pixel data
+  int extent[6] = {0, 0, 0, 0, 0, 0};
+  image->GetExtent(extent);
+  const CharPixelType* pixels = static_cast<const CharPixelType*>(image->GetScalarPointer(extent[0], extent[2], extent[4]));
+  vtkIdType increments[3] = {0, 0, 0};
+  image->GetIncrements(increments);
+
+  CharImageType::RegionType region;
+  CharImageType::IndexType regionIndex;
+  regionIndex[0] = 0;
+  regionIndex[1] = 0;
+  CharImageType::SizeType regionSize;
+  regionSize[0] = extent[1] - extent[0] + 1;
+  regionSize[1] = extent[3] - extent[2] + 1;
+  region.SetIndex(regionIndex);
+  region.SetSize(regionSize);
+  LimitToClipRegion(region);
+
+  CharImageType::Pointer scanlineImage;
+  if (m_SaveIntermediateImages == true)
+  {
+    // Create an image copy to draw the scanlines on
+    scanlineImage = CharImageType::New();
+    PlusCommon::DeepCopyVtkVolumeToItkImage<CharPixelType>(image, scanlineImage);
+  }
 
-      } // end if() found intensity peak
+  std::vector<itk::Point<double, 2> >& intensityPeakPositions = buffers.IntensityPeakPositions;
+  intensityPeakPositions.clear();
+  std::vector<int>& intensityProfile = buffers.IntensityProfile; // Holds intensity profile of the line
 
-    } // end currScanlineNum loop
+  int numOfValidScanlines = 0;
 
-    if (numOfValidScanlines < MINIMUM_NUMBER_OF_VALID_SCANLINES)
+  for (int currScanlineNum = 0; currScanlineNum < NUMBER_OF_SCANLINES; ++currScanlineNum)
+  {
+    // Set the scanline start pixel
+    CharImageType::IndexType startPixel;
+    double scanlineSpacingPix = static_cast<double>(region.GetSize()[0] - 1) / (NUMBER_OF_SCANLINES - 1);
+    startPixel[0] = region.GetIndex()[0] + scanlineSpacingPix * (currScanlineNum);
+    startPixel[1] = region.GetIndex()[1];
+
+    // Get the intensity profile along the vertical scanline
+    const unsigned int scanlineLength = region.GetSize()[1];
+    intensityProfile.resize(scanlineLength);
+    const CharPixelType* scanlinePixel = pixels + startPixel[0] * increments[0] + startPixel[1] * increments[1];
+    for (unsigned int pixelIndex = 0; pixelIndex < scanlineLength; ++pixelIndex, scanlinePixel += increments[1])
     {
-      //TODO: drop the frame from the analysis
-      LOG_DEBUG("Only " << numOfValidScanlines << " valid scanlines; this is less than the required " << MINIMUM_NUMBER_OF_VALID_SCANLINES << ". Skipping frame" << frameNumber);
+      intensityProfile[pixelIndex] = static_cast<int>(*scanlinePixel);
     }
 
-    LineParameters params;
-    ComputeLineParameters(intensityPeakPositions, params);
-    if (!params.lineDetected)
+    if (m_SaveIntermediateImages == true)
     {
-      LOG_DEBUG("Unable to compute line parameters for frame " << frameNumber);
-      continue;
+      // Set the pixels on the scanline image copy to white
+      CharImageType::IndexType scanlineImagePixel = startPixel;
+      for (unsigned int pixelIndex = 0; pixelIndex < scanlineLength; ++pixelIndex, ++scanlineImagePixel[1])
+      {
+        scanlineImage->SetPixel(scanlineImagePixel, 255);
+      }
     }
-    if (params.lineDirectionVector_Image[0] < MIN_X_SLOPE_COMPONENT_FOR_DETECTED_LINE)
+
+    if (this->PlotIntensityProfile)
     {
-      // Line is close to vertical, skip frame because intersection of
-      // line with image's horizontal half point is unstable
-      LOG_TRACE("Line on frame " << frameNumber << " is too close to vertical, skip the frame");
-      continue;
+      // Plot the intensity profile
+      PlotIntArray(intensityProfile);
     }
 
-    ++numberOfSuccessfulLineSegmentations;
-    m_LineParameters[frameNumber] = params;
-
-    // Store the y-value of the line, when the line's x-value is half of the image's width
-    double t = (region.GetIndex()[0] + 0.5 * region.GetSize()[0] - params.lineOriginPoint_Image[0]) / params.lineDirectionVector_Image[0];
-    m_SignalValues.push_back(std::abs(params.lineOriginPoint_Image[1] + t * params.lineDirectionVector_Image[1]));
+    // Find the max intensity value from the peak with the largest area
+    int maxFromLargestArea = -1;
+    int maxFromLargestAreaIndex = -1;
+    int startOfMaxArea = -1;
+    if (FindLargestPeak(intensityProfile, maxFromLargestArea, maxFromLargestAreaIndex, startOfMaxArea) == PLUS_SUCCESS)
+    {
+      double currPeakPos_y = -1;
+      switch (PEAK_POS_METRIC)
+      {
+        case PEAK_POS_COG:
+          {
+            /* Use center-of-gravity (COG) as peak-position metric*/
+            if (ComputeCenterOfGravity(intensityProfile, startOfMaxArea, currPeakPos_y) != PLUS_SUCCESS)
+            {
+              // unable to compute center-of-gravity; this scanline is invalid
+              continue;
+            }
+            break;
+          }
+        case PEAK_POS_START:
+          {
+            /* Use peak start as peak-position metric*/
+            if (FindPeakStart(intensityProfile, maxFromLargestArea, startOfMaxArea, currPeakPos_y) != PLUS_SUCCESS)
+            {
+              // unable to compute peak start; this scanline is invalid
+              continue;
+            }
+            break;
+          }
+      }
 
-    //  Store timestamp for image frame
-    m_SignalTimestamps.push_back(m_TrackedFrameList->GetTrackedFrame(frameNumber)->GetTimestamp());
+      itk::Point<double, 2> currPeakPos;
+      currPeakPos[0] = static_cast<double>(startPixel[0]);
+      currPeakPos[1] = startPixel[1] + currPeakPos_y;
+      intensityPeakPositions.push_back(currPeakPos);
+      ++numOfValidScanlines;
 
-    if (m_SaveIntermediateImages == true)
-    {
-      SaveIntermediateImage(frameNumber, scanlineImage,
-                            params.lineOriginPoint_Image[0], params.lineOriginPoint_Image[1], params.lineDirectionVector_Image[0], params.lineDirectionVector_Image[1],
-                            numOfValidScanlines, intensityPeakPositions);
-    }
+    } // end if() found intensity peak
 
-  } // end frameNum loop
+  } // end currScanlineNum loop
 
-  double segmentationSuccessRate = double(numberOfSuccessfulLineSegmentations) / m_TrackedFrameList->GetNumberOfTrackedFrames();
-  if (segmentationSuccessRate < EXPECTED_LINE_SEGMENTATION_SUCCESS_RATE)
+  if (numOfValidScanlines < MINIMUM_NUMBER_OF_VALID_SCANLINES)
   {
-    LOG_WARNING("Line segmentation success rate is very low (" << segmentationSuccessRate * 100 << "%): a line could only be detected on " << numberOfSuccessfulLineSegmentations << " frames out of " << m_TrackedFrameList->GetNumberOfTrackedFrames());
+    //TODO: drop the frame from the analysis
+    LOG_DEBUG("Only " << numOfValidScanlines << " valid scanlines; this is less than the required " << MINIMUM_NUMBER_OF_VALID_SCANLINES << ". Skipping frame" << frameNumber);
   }
 
-  bool plotVideoMetric = vtkPlusLogger::Instance()->GetLogLevel() >= vtkPlusLogger::LOG_LEVEL_TRACE;
-  if (plotVideoMetric)
+  LineParameters params;
+  ComputeLineParameters(intensityPeakPositions, params);
+  if (!params.lineDetected)
   {
-    PlotDoubleArray(m_SignalValues);
+    LOG_DEBUG("Unable to compute line parameters for frame " << frameNumber);
+    return;
+  }
+  if (params.lineDirectionVector_Image[0] < MIN_X_SLOPE_COMPONENT_FOR_DETECTED_LINE)
+  {
+    // Line is close to vertical, skip frame because intersection of
+    // line with image's horizontal half point is unstable
+    LOG_TRACE("Line on frame " << frameNumber << " is too close to vertical, skip the frame");
+    return;
   }
 
-  return PLUS_SUCCESS;
+  result.Parameters = params;
 
-} //  End LineDetection
+  // Store the y-value of the line, when the line's x-value is half of the image's width
+  double t = (region.GetIndex()[0] + 0.5 * region.GetSize()[0] - params.lineOriginPoint_Image[0]) / params.lineDirectionVector_Image[0];
+  result.SignalValue = std::abs(params.lineOriginPoint_Image[1] + t * params.lineDirectionVector_Image[1]);
+
+  if (m_SaveIntermediateImages == true)
+  {
+    SaveIntermediateImage(frameNumber, scanlineImage,
+                          params.lineOriginPoint_Image[0], params.lineOriginPoint_Image[1], params.lineDirectionVector_Image[0], params.lineDirectionVector_Image[1],
+                          numOfValidScanlines, intensityPeakPositions);
+  }
+}
 
 //-----------------------------------------------------------------------------
-PlusStatus vtkPlusLineSegmentationAlgo::FindPeakStart(std::deque<int>& intensityProfile, int maxFromLargestArea, int startOfMaxArea, double& startOfPeak)
+PlusStatus vtkPlusLineSegmentationAlgo::FindPeakStart(const std::vector<int>& intensityProfile, int maxFromLargestArea, int startOfMaxArea, double& startOfPeak)
 {
   // Start of peak is defined as the location at which it reaches 50% of its maximum value.
   double startPeakValue = maxFromLargestArea * 0.5;
@@ -410,7 +481,7 @@ PlusStatus vtkPlusLineSegmentationAlgo::FindPeakStart(std::deque<int>& intensity
 }
 
 //-----------------------------------------------------------------------------
-PlusStatus vtkPlusLineSegmentationAlgo::FindLargestPeak(std::deque<int>& intensityProfile, int& maxFromLargestArea, int& maxFromLargestAreaIndex, int& startOfMaxArea)
+PlusStatus vtkPlusLineSegmentationAlgo::FindLargestPeak(const std::vector<int>& intensityProfile, int& maxFromLargestArea, int& maxFromLargestAreaIndex, int& startOfMaxArea)
 {
   int currentLargestArea = 0;
   int currentArea = 0;
@@ -489,7 +560,7 @@ PlusStatus vtkPlusLineSegmentationAlgo::FindLargestPeak(std::deque<int>& intensi
 }
 //-----------------------------------------------------------------------------
 
-PlusStatus vtkPlusLineSegmentationAlgo::ComputeCenterOfGravity(std::deque<int>& intensityProfile, int startOfMaxArea, double& centerOfGravity)
+PlusStatus vtkPlusLineSegmentationAlgo::ComputeCenterOfGravity(const std::vector<int>& intensityProfile, int startOfMaxArea, double& centerOfGravity)
 {
   if (intensityProfile.size() == 0)
   {
@@ -731,7 +802,7 @@ PlusStatus vtkPlusLineSegmentationAlgo::Update()
 }
 
 //-----------------------------------------------------------------------------
-void vtkPlusLineSegmentationAlgo::PlotIntArray(const std::deque<int>& intensityValues)
+void vtkPlusLineSegmentationAlgo::PlotIntArray(const std::vector<int>& intensityValues)
 {
 #ifdef PLUS_RENDERING_ENABLED
   //  Create table
@@ -11,6 +11,7 @@
 #include "vtkPlusCalibrationExport.h"
 #include "vtkObject.h"
 #include <deque>
+#include <vector>
 
 //class igsioTrackedFrame; 
 //class vtkIGSIOTrackedFrameList;
@@ -18,6 +19,13 @@
 /*!
   \class vtkPlusLineSegmentationAlgo
   \brief Detect the position of a line (image of a plane) in an US image sequence.
+
+  Frames are processed in parallel. Each thread reads the scanlines directly from the frame pixel data
+  into its own reusable buffers.
+
+  The algorithm can be used on a recorded frame list (SetTrackedFrameList and Update) or in streaming mode:
+  frames are passed to AddFrames as they are acquired (for example, the frames returned by vtkPlusChannel::GetTrackedFrameList)
+  and the results are appended to the detected positions, without storing the frames.
   \ingroup PlusLibCalibrationAlgorithm
 */
 class vtkPlusCalibrationExport vtkPlusLineSegmentationAlgo : public vtkObject
@@ -77,10 +85,38 @@ public:
 
   PlusStatus Reset();
 
+  /*!
+    Streaming mode: detect the line on the frames and append the results to the detected timestamps, positions, and line parameters.
+    The frames are not stored, so the results of previous calls are kept until Reset() is called. Frames are expected in
+    the order of acquisition.
+  */
+  PlusStatus AddFrames(vtkIGSIOTrackedFrameList* trackedFrameList);
+
   /*! Plot intensity profile for each scanline. Enable for debugging. */
   vtkGetMacro(PlotIntensityProfile, bool);
   vtkSetMacro(PlotIntensityProfile, bool);
 
+  /*! Number of threads used for processing frames. If 0 then all available processor cores are used. */
+  vtkGetMacro(NumberOfThreads, int);
+  vtkSetMacro(NumberOfThreads, int);
+
+protected:
+  /*! Buffers used for processing a frame. Each processing thread has its own, to avoid allocations for each frame. */
+  struct ScanlineBuffers
+  {
+    std::vector<int> IntensityProfile;
+    std::vector<itk::Point<double, 2> > IntensityPeakPositions;
+  };
+
+  /*! Line detection result of a single frame */
+  struct FrameResult
+  {
+    /*! lineDetected is false if the frame is skipped or no line is found */
+    LineParameters Parameters;
+    /*! Position of the line at the horizontal center of the processed region */
+    double SignalValue;
+  };
+
 protected:
   vtkPlusLineSegmentationAlgo();
   virtual ~vtkPlusLineSegmentationAlgo();
@@ -89,15 +125,21 @@ protected:
 
   PlusStatus ComputeVideoPositionMetric();
 
-  PlusStatus FindPeakStart(std::deque<int>& intensityProfile, int maxFromLargestArea, int startOfMaxArea, double& startOfPeak);
+  /*! Detect the line on the frames of the list (in parallel) and append the results to the detected signal. Returns the number of frames where a line was detected. */
+  int ProcessFrames(vtkIGSIOTrackedFrameList* trackedFrameList, int firstFrameNumber);
+
+  /*! Detect the line on a single frame. Thread-safe if saving of intermediate images and plotting are disabled. */
+  void ProcessFrame(igsioTrackedFrame* trackedFrame, int frameNumber, ScanlineBuffers& buffers, FrameResult& result);
 
-  PlusStatus FindLargestPeak(std::deque<int>& intensityProfile, int& maxFromLargestArea, int& maxFromLargestAreaIndex, int& startOfMaxArea);
+  PlusStatus FindPeakStart(const std::vector<int>& intensityProfile, int maxFromLargestArea, int startOfMaxArea, double& startOfPeak);
 
-  PlusStatus ComputeCenterOfGravity(std::deque<int>& intensityProfile, int startOfMaxArea, double& centerOfGravity);
+  PlusStatus FindLargestPeak(const std::vector<int>& intensityProfile, int& maxFromLargestArea, int& maxFromLargestAreaIndex, int& startOfMaxArea);
+
+  PlusStatus ComputeCenterOfGravity(const std::vector<int>& intensityProfile, int startOfMaxArea, double& centerOfGravity);
 
   void ComputeLineParameters(std::vector<itk::Point<double, 2> >& data, LineParameters& outputParameters);
 
-  void PlotIntArray(const std::deque<int>& intensityValues);
+  void PlotIntArray(const std::vector<int>& intensityValues);
 
   void PlotDoubleArray(const std::deque<double>& intensityValues);
 
@@ -122,6 +164,9 @@ protected:
   /*! Plot intensity profile for each scanline. Enable for debugging. */
   bool PlotIntensityProfile;
 
+  /*! Number of threads used for processing frames. If 0 then all available processor cores are used. */
+  int NumberOfThreads;
+
   double m_SignalTimeRangeMin;
   double m_SignalTimeRangeMax;
 
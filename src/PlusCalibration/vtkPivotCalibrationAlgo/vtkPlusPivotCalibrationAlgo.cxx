@@ -6,11 +6,23 @@
 
 #include "vtkPlusPivotCalibrationAlgo.h"
 
+#include <vtkMatrix4x4.h>
+
+namespace
+{
+  const double DEFAULT_INCREMENTAL_OUTLIER_REJECTION_FACTOR = 3.0;
+  const unsigned int MIN_NUMBER_OF_INCREMENTAL_CALIBRATION_POINTS = 10; // the pivot point is not reported and outliers are not rejected until this many poses are accepted
+  const double MIN_INCREMENTAL_OUTLIER_THRESHOLD_MM = 0.5; // poses are not rejected if their error is below this value
+}
+
 vtkStandardNewMacro(vtkPlusPivotCalibrationAlgo);
 
 //-----------------------------------------------------------------------------
 vtkPlusPivotCalibrationAlgo::vtkPlusPivotCalibrationAlgo()
+  : IncrementalCalibrationWindowSize(0)
+  , IncrementalCalibrationOutlierRejectionFactor(DEFAULT_INCREMENTAL_OUTLIER_REJECTION_FACTOR)
 {
+  this->ResetIncrementalCalibration();
 }
 
 //-----------------------------------------------------------------------------
@@ -25,5 +37,94 @@ PlusStatus vtkPlusPivotCalibrationAlgo::ReadConfiguration(vtkXMLDataElement* aCo
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ObjectMarkerCoordinateFrame, pivotCalibrationElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ReferenceCoordinateFrame, pivotCalibrationElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ObjectPivotPointCoordinateFrame, pivotCalibrationElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, IncrementalCalibrationWindowSize, pivotCalibrationElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, IncrementalCalibrationOutlierRejectionFactor, pivotCalibrationElement);
+  this->ResetIncrementalCalibration();
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusPivotCalibrationAlgo::ResetIncrementalCalibration()
+{
+  this->IncrementalSolver.SetWindowSize(this->IncrementalCalibrationWindowSize > 0 ? this->IncrementalCalibrationWindowSize : 0);
+  // Unknowns: pivot point in marker coordinate system (3), pivot point in reference coordinate system (3)
+  this->IncrementalSolver.Initialize(6, 1);
+  this->IncrementalSolver.SetOutlierRejectionFactor(this->IncrementalCalibrationOutlierRejectionFactor);
+  this->IncrementalSolver.SetMinimumNumberOfObservationsForOutlierRejection(MIN_NUMBER_OF_INCREMENTAL_CALIBRATION_POINTS);
+  this->IncrementalSolver.SetMinimumOutlierThreshold(MIN_INCREMENTAL_OUTLIER_THRESHOLD_MM);
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusPivotCalibrationAlgo::InsertNextIncrementalCalibrationPoint(vtkMatrix4x4* markerToReferenceTransformMatrix, bool* accepted/*=NULL*/)
+{
+  if (markerToReferenceTransformMatrix == NULL)
+  {
+    LOG_ERROR("vtkPlusPivotCalibrationAlgo::InsertNextIncrementalCalibrationPoint failed: invalid transform");
+    return PLUS_FAIL;
+  }
+
+  // MarkerToReference rotation * pivot_Marker + MarkerToReference translation = pivot_Reference
+  // => [ R | -I ] * [ pivot_Marker; pivot_Reference ] = -t
+  vnl_matrix<double> a(3, 6, 0.0);
+  vnl_matrix<double> b(3, 1, 0.0);
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int col = 0; col < 3; ++col)
+    {
+      a(row, col) = markerToReferenceTransformMatrix->GetElement(row, col);
+    }
+    a(row, 3 + row) = -1.0;
+    b(row, 0) = -markerToReferenceTransformMatrix->GetElement(row, 3);
+  }
+
+  return this->IncrementalSolver.AddObservation(a, b, accepted);
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusPivotCalibrationAlgo::GetIncrementalPivotPointToMarkerTranslation(double pivotPoint_Marker[3])
+{
+  vnl_matrix<double> solution;
+  if (this->IncrementalSolver.GetNumberOfObservations() < MIN_NUMBER_OF_INCREMENTAL_CALIBRATION_POINTS || this->IncrementalSolver.GetSolution(solution) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    pivotPoint_Marker[i] = solution(i, 0);
+  }
   return PLUS_SUCCESS;
 }
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusPivotCalibrationAlgo::GetIncrementalPivotPointPosition(double pivotPoint_Reference[3])
+{
+  vnl_matrix<double> solution;
+  if (this->IncrementalSolver.GetNumberOfObservations() < MIN_NUMBER_OF_INCREMENTAL_CALIBRATION_POINTS || this->IncrementalSolver.GetSolution(solution) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    pivotPoint_Reference[i] = solution(3 + i, 0);
+  }
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+double vtkPlusPivotCalibrationAlgo::GetIncrementalCalibrationErrorMm()
+{
+  // Residual of a pose is the distance between the tip position and the pivot point
+  return this->IncrementalSolver.GetRmsResidual();
+}
+
+//-----------------------------------------------------------------------------
+unsigned int vtkPlusPivotCalibrationAlgo::GetIncrementalCalibrationNumberOfPoints()
+{
+  return this->IncrementalSolver.GetNumberOfObservations();
+}
+
+//-----------------------------------------------------------------------------
+unsigned int vtkPlusPivotCalibrationAlgo::GetIncrementalCalibrationNumberOfRejectedPoints()
+{
+  return this->IncrementalSolver.GetNumberOfRejectedObservations();
+}
@@ -10,6 +10,7 @@ See License.txt for details.
 // Local includes
 #include "PlusConfigure.h"
 #include "vtkPlusCalibrationExport.h"
+#include "PlusIncrementalLeastSquares.h"
 
 // IGSIO includes
 #include <vtkIGSIOPivotCalibrationAlgo.h>
@@ -32,6 +33,9 @@ See License.txt for details.
   The method detects outlier points (points that have larger than 3x error than the standard deviation) and ignores them when computing the pivot point
   coordinates and the calibration error.
 
+  In addition to the batch calibration (DoPivotCalibration), the pivot point can be estimated incrementally while the poses are acquired
+  (InsertNextIncrementalCalibrationPoint). The incremental estimate is updated after each pose with bounded cost and outliers are rejected online.
+
   \ingroup PlusLibCalibrationAlgorithm
 */
 class vtkPlusCalibrationExport vtkPlusPivotCalibrationAlgo : public vtkIGSIOPivotCalibrationAlgo
@@ -46,9 +50,48 @@ public:
   */
   PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig) override;
 
+  /*! Remove all poses from the incremental calibration. Window size and outlier rejection factor are applied. */
+  void ResetIncrementalCalibration();
+
+  /*!
+    Add a pose to the incremental calibration and update the pivot point estimate
+    \param markerToReferenceTransformMatrix Pose of the marker
+    \param accepted Optional output, false if the pose was rejected as an outlier
+  */
+  PlusStatus InsertNextIncrementalCalibrationPoint(vtkMatrix4x4* markerToReferenceTransformMatrix, bool* accepted = NULL);
+
+  /*! Get the current estimate of the pivot point position in the marker coordinate system. Returns PLUS_FAIL if there are not enough poses yet. */
+  PlusStatus GetIncrementalPivotPointToMarkerTranslation(double pivotPoint_Marker[3]);
+
+  /*! Get the current estimate of the pivot point position in the reference coordinate system. Returns PLUS_FAIL if there are not enough poses yet. */
+  PlusStatus GetIncrementalPivotPointPosition(double pivotPoint_Reference[3]);
+
+  /*! RMS distance (in mm) between the pivot point and the stylus tip positions computed with the current incremental estimate */
+  double GetIncrementalCalibrationErrorMm();
+
+  /*! Number of poses used in the current incremental estimate */
+  unsigned int GetIncrementalCalibrationNumberOfPoints();
+
+  /*! Number of poses rejected as outliers since the last reset */
+  unsigned int GetIncrementalCalibrationNumberOfRejectedPoints();
+
+  /*! Number of most recent poses used in incremental calibration. If 0 then all accepted poses are used. Applied at reset. */
+  vtkSetMacro(IncrementalCalibrationWindowSize, int);
+  vtkGetMacro(IncrementalCalibrationWindowSize, int);
+
+  /*! A pose is rejected if its error is larger than this factor times the current RMS error. If 0 then no poses are rejected. Applied at reset. */
+  vtkSetMacro(IncrementalCalibrationOutlierRejectionFactor, double);
+  vtkGetMacro(IncrementalCalibrationOutlierRejectionFactor, double);
+
 protected:
   vtkPlusPivotCalibrationAlgo();
   virtual ~vtkPlusPivotCalibrationAlgo();
+
+  /*! Solver of incremental calibration. Unknowns: pivot point in marker and in reference coordinate system. */
+  PlusIncrementalLeastSquares IncrementalSolver;
+
+  int IncrementalCalibrationWindowSize;
+  double IncrementalCalibrationOutlierRejectionFactor;
 };
 
 #endif
@@ -32,6 +32,8 @@ See License.txt for details.
 
 static const int MIN_NUMBER_OF_VALID_CALIBRATION_FRAMES = 10; // minimum number of successfully calibrated frames required for calibration
 static const double DEFAULT_ERROR_CONFIDENCE_INTERVAL = 0.95; // this fraction of the data is taken into account when computing mean and standard deviation in the final calibration error report
+static const double DEFAULT_INCREMENTAL_OUTLIER_REJECTION_FACTOR = 3.0; // frames with larger error than this factor times the RMS error are rejected in incremental calibration
+static const double MIN_INCREMENTAL_OUTLIER_THRESHOLD_MM = 1.0; // frames are not rejected in incremental calibration if the error of their points is below this value
 
 vtkStandardNewMacro(vtkPlusProbeCalibrationAlgo);
 
@@ -49,6 +51,8 @@ vtkPlusProbeCalibrationAlgo::vtkPlusProbeCalibrationAlgo()
   , PhantomCoordinateFrame(NULL)
   , ReferenceCoordinateFrame(NULL)
   , ErrorConfidenceLevel(DEFAULT_ERROR_CONFIDENCE_INTERVAL)
+  , IncrementalCalibrationWindowSize(0)
+  , IncrementalCalibrationOutlierRejectionFactor(DEFAULT_INCREMENTAL_OUTLIER_REJECTION_FACTOR)
 {
   this->Optimizer = vtkPlusProbeCalibrationOptimizerAlgo::New();
   this->Optimizer->SetProbeCalibrationAlgo(this);
@@ -75,6 +79,10 @@ PlusStatus vtkPlusProbeCalibrationAlgo::ReadConfiguration(vtkXMLDataElement* aCo
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(PhantomCoordinateFrame, probeCalibrationElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ReferenceCoordinateFrame, probeCalibrationElement);
 
+  // Incremental calibration options
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, IncrementalCalibrationWindowSize, probeCalibrationElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, IncrementalCalibrationOutlierRejectionFactor, probeCalibrationElement);
+
   // Optimization options
   if (this->Optimizer->ReadConfiguration(probeCalibrationElement) != PLUS_SUCCESS)
   {
@@ -185,6 +193,16 @@ PlusStatus vtkPlusProbeCalibrationAlgo::ComputeImageToProbeTransformByLinearLeas
   imageToProbeTransformMatrix(3, 2) = 0;
   imageToProbeTransformMatrix(3, 3) = 1;
 
+  CompleteImageToProbeTransformZAxis(imageToProbeTransformMatrix);
+
+  LOG_DEBUG(outliers.size() << " outliers points were found");
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusProbeCalibrationAlgo::CompleteImageToProbeTransformZAxis(vnl_matrix_fixed<double, 4, 4>& imageToProbeTransformMatrix)
+{
   // Complete the transformation matrix from a projection matrix to a 3D-3D transformation matrix (so that it can be inverted or can be used to transform 3D widgets to the image plane)
   // Make the z vector have about the same length as x an y, so that when a 3D widget is transformed using this transform, the aspect ratio is maintained
 
@@ -198,10 +216,6 @@ PlusStatus vtkPlusProbeCalibrationAlgo::ComputeImageToProbeTransformByLinearLeas
   imageToProbeTransformMatrix(0, 2) = zVector[0];
   imageToProbeTransformMatrix(1, 2) = zVector[1];
   imageToProbeTransformMatrix(2, 2) = zVector[2];
-
-  LOG_DEBUG(outliers.size() << " outliers points were found");
-
-  return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
@@ -370,6 +384,27 @@ PlusStatus vtkPlusProbeCalibrationAlgo::AddPositionsPerImage(igsioTrackedFrame*
 {
   LOG_TRACE("vtkPlusProbeCalibrationAlgo::AddPositionsPerImage(type=" << datasetType << ")");
 
+  NWirePositionType framePosition;
+  bool segmentationValid = false;
+  if (this->ComputePositionsPerImage(trackedFrame, transformRepository, framePosition, segmentationValid) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (!segmentationValid)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  this->PreProcessedWirePositions[datasetType].FramePositions.push_back(framePosition);
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusProbeCalibrationAlgo::ComputePositionsPerImage(igsioTrackedFrame* trackedFrame, vtkIGSIOTransformRepository* transformRepository, NWirePositionType& framePosition, bool& segmentationValid)
+{
+  segmentationValid = false;
+
   // Get position of segmented fiducial points in the image
   std::vector<vnl_vector<double> > segmentedWireIntersectionPointsPos_Image;
   {
@@ -444,8 +479,9 @@ PlusStatus vtkPlusProbeCalibrationAlgo::AddPositionsPerImage(igsioTrackedFrame*
     phantomToProbeTransformMatrix = referenceToProbeTransformMatrix * phantomToReferenceTransformMatrix;
   }
 
-  // Create a new element to store all the position information for the frame
-  NWirePositionType framePosition;
+  // Store all the position information for the frame
+  framePosition.AllWiresIntersectionPointsPos_Image.clear();
+  framePosition.MiddleWireIntersectionPointsPos_Probe.clear();
 
   {
     // Store all the probe to phantom transforms, used only in 2D minimization
@@ -509,8 +545,7 @@ PlusStatus vtkPlusProbeCalibrationAlgo::AddPositionsPerImage(igsioTrackedFrame*
     }
   }
 
-  this->PreProcessedWirePositions[datasetType].FramePositions.push_back(framePosition);
-
+  segmentationValid = true;
   return PLUS_SUCCESS;
 }
 
@@ -1145,6 +1180,182 @@ void vtkPlusProbeCalibrationAlgo::ComputeError3d(const vnl_matrix_fixed<double,
   igsioMath::ComputeRms(reprojectionErrors, errorRms);
 }
 
+//--------------------------------------------------------------------------------
+void vtkPlusProbeCalibrationAlgo::GetCalibrationWireCorrespondences(std::vector< std::vector<vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType> >& frameCorrespondences)
+{
+  const std::vector<NWirePositionType>& framePositions = this->PreProcessedWirePositions[CALIBRATION_NOT_OUTLIER].FramePositions;
+  frameCorrespondences.clear();
+  frameCorrespondences.resize(framePositions.size());
+  for (unsigned int frameIndex = 0; frameIndex < framePositions.size(); frameIndex++)
+  {
+    vnl_matrix_fixed<double, 4, 4> phantomToProbeTransform_vnl = vnl_inverse(framePositions[frameIndex].ProbeToPhantomTransform);
+    std::vector<vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType>& correspondences = frameCorrespondences[frameIndex];
+    correspondences.resize(this->NWires.size() * 3);
+    for (unsigned int nWireIndex = 0; nWireIndex < this->NWires.size(); nWireIndex++)
+    {
+      for (int wireIndex = 0; wireIndex < 3; wireIndex++)
+      {
+        const PlusFidWire& wire = this->NWires[nWireIndex].GetWires()[wireIndex];
+        vnl_vector_fixed<double, 4> wireFrontPoint_Phantom(wire.EndPointFront[0], wire.EndPointFront[1], wire.EndPointFront[2], 1.0);
+        vnl_vector_fixed<double, 4> wireBackPoint_Phantom(wire.EndPointBack[0], wire.EndPointBack[1], wire.EndPointBack[2], 1.0);
+        vnl_vector_fixed<double, 4> wireFrontPoint_Probe = phantomToProbeTransform_vnl * wireFrontPoint_Phantom;
+        vnl_vector_fixed<double, 4> wireBackPoint_Probe = phantomToProbeTransform_vnl * wireBackPoint_Phantom;
+        const vnl_vector_fixed<double, 4>& segmentedPoint_Image = framePositions[frameIndex].AllWiresIntersectionPointsPos_Image[3 * nWireIndex + wireIndex];
+
+        vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType& correspondence = correspondences[3 * nWireIndex + wireIndex];
+        correspondence.SegmentedPoint_Image.set(segmentedPoint_Image[0], segmentedPoint_Image[1], segmentedPoint_Image[2]);
+        correspondence.WireFrontPoint_Probe.set(wireFrontPoint_Probe[0], wireFrontPoint_Probe[1], wireFrontPoint_Probe[2]);
+        correspondence.WireBackPoint_Probe.set(wireBackPoint_Probe[0], wireBackPoint_Probe[1], wireBackPoint_Probe[2]);
+        correspondence.MiddleWire = (wireIndex == 1);
+        if (correspondence.MiddleWire)
+        {
+          const vnl_vector_fixed<double, 4>& middleWirePoint_Probe = framePositions[frameIndex].MiddleWireIntersectionPointsPos_Probe[nWireIndex];
+          correspondence.MiddleWirePoint_Probe.set(middleWirePoint_Probe[0], middleWirePoint_Probe[1], middleWirePoint_Probe[2]);
+        }
+        else
+        {
+          correspondence.MiddleWirePoint_Probe.fill(0.0);
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusProbeCalibrationAlgo::StartIncrementalCalibration(const std::vector<PlusNWire>& nWires)
+{
+  LOG_TRACE("vtkPlusProbeCalibrationAlgo::StartIncrementalCalibration");
+
+  if (nWires.empty())
+  {
+    LOG_ERROR("Unable to start incremental calibration: no N-wires are defined");
+    return PLUS_FAIL;
+  }
+  if (this->IncrementalCalibrationWindowSize < 0 || (this->IncrementalCalibrationWindowSize > 0 && this->IncrementalCalibrationWindowSize < MIN_NUMBER_OF_VALID_CALIBRATION_FRAMES))
+  {
+    LOG_ERROR("Invalid incremental calibration window size: " << this->IncrementalCalibrationWindowSize << " (it must be 0 or at least " << MIN_NUMBER_OF_VALID_CALIBRATION_FRAMES << ")");
+    return PLUS_FAIL;
+  }
+
+  this->NWires = nWires;
+
+  // Unknowns: ImageToProbe X axis, Y axis, translation (the image points are in the Z=0 plane, so the Z axis is not determined by the data)
+  // Right hand sides: X, Y, Z coordinates in the probe frame
+  this->IncrementalSolver.SetWindowSize(this->IncrementalCalibrationWindowSize);
+  this->IncrementalSolver.Initialize(3, 3);
+  this->IncrementalSolver.SetOutlierRejectionFactor(this->IncrementalCalibrationOutlierRejectionFactor);
+  this->IncrementalSolver.SetMinimumNumberOfObservationsForOutlierRejection(MIN_NUMBER_OF_VALID_CALIBRATION_FRAMES);
+  // Residual of a frame is the norm of the errors of all the middle wire points of the frame
+  this->IncrementalSolver.SetMinimumOutlierThreshold(MIN_INCREMENTAL_OUTLIER_THRESHOLD_MM * sqrt(static_cast<double>(nWires.size())));
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusProbeCalibrationAlgo::AddIncrementalCalibrationFrame(igsioTrackedFrame* trackedFrame, vtkIGSIOTransformRepository* transformRepository, bool* frameAccepted/*=NULL*/)
+{
+  if (frameAccepted != NULL)
+  {
+    *frameAccepted = false;
+  }
+  if (this->NWires.empty())
+  {
+    LOG_ERROR("Incremental calibration is not started");
+    return PLUS_FAIL;
+  }
+
+  NWirePositionType framePosition;
+  bool segmentationValid = false;
+  if (this->ComputePositionsPerImage(trackedFrame, transformRepository, framePosition, segmentationValid) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (!segmentationValid)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  // One equation for each middle wire point: [x y 1] * [X axis; Y axis; translation] = probe position
+  const unsigned int numberOfNWires = this->NWires.size();
+  vnl_matrix<double> middleWirePointsPos_Image(numberOfNWires, 3);
+  vnl_matrix<double> middleWirePointsPos_Probe(numberOfNWires, 3);
+  for (unsigned int nWireIndex = 0; nWireIndex < numberOfNWires; ++nWireIndex)
+  {
+    const vnl_vector_fixed<double, 4>& pointPos_Image = framePosition.AllWiresIntersectionPointsPos_Image[nWireIndex * 3 + 1];
+    middleWirePointsPos_Image(nWireIndex, 0) = pointPos_Image[0];
+    middleWirePointsPos_Image(nWireIndex, 1) = pointPos_Image[1];
+    middleWirePointsPos_Image(nWireIndex, 2) = 1.0;
+    const vnl_vector_fixed<double, 4>& pointPos_Probe = framePosition.MiddleWireIntersectionPointsPos_Probe[nWireIndex];
+    middleWirePointsPos_Probe(nWireIndex, 0) = pointPos_Probe[0];
+    middleWirePointsPos_Probe(nWireIndex, 1) = pointPos_Probe[1];
+    middleWirePointsPos_Probe(nWireIndex, 2) = pointPos_Probe[2];
+  }
+
+  bool accepted = false;
+  if (this->IncrementalSolver.AddObservation(middleWirePointsPos_Image, middleWirePointsPos_Probe, &accepted) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (frameAccepted != NULL)
+  {
+    *frameAccepted = accepted;
+  }
+  if (!accepted || !this->IsIncrementalCalibrationResultAvailable())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  vnl_matrix<double> solution;
+  if (this->IncrementalSolver.GetSolution(solution) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get incremental calibration solution");
+    return PLUS_FAIL;
+  }
+  vnl_matrix_fixed<double, 4, 4> imageToProbeTransformMatrix;
+  imageToProbeTransformMatrix.set_identity();
+  for (int row = 0; row < 3; ++row)
+  {
+    imageToProbeTransformMatrix(row, 0) = solution(0, row);
+    imageToProbeTransformMatrix(row, 1) = solution(1, row);
+    imageToProbeTransformMatrix(row, 3) = solution(2, row);
+  }
+  CompleteImageToProbeTransformZAxis(imageToProbeTransformMatrix);
+  this->ImageToProbeTransformMatrix = imageToProbeTransformMatrix;
+
+  LOG_DEBUG("Incremental calibration updated (" << this->GetIncrementalCalibrationNumberOfFrames() << " frames, RMS error: " << this->GetIncrementalCalibrationRmsErrorMm() << " mm)");
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusProbeCalibrationAlgo::IsIncrementalCalibrationResultAvailable()
+{
+  return this->IncrementalSolver.GetNumberOfObservations() >= MIN_NUMBER_OF_VALID_CALIBRATION_FRAMES;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusProbeCalibrationAlgo::GetIncrementalCalibrationRmsErrorMm()
+{
+  if (this->NWires.empty())
+  {
+    return -1.0;
+  }
+  // The solver residual is computed for all the points of a frame
+  return this->IncrementalSolver.GetRmsResidual() / sqrt(static_cast<double>(this->NWires.size()));
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusProbeCalibrationAlgo::GetIncrementalCalibrationNumberOfFrames()
+{
+  return this->IncrementalSolver.GetNumberOfObservations();
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusProbeCalibrationAlgo::GetIncrementalCalibrationNumberOfRejectedFrames()
+{
+  return this->IncrementalSolver.GetNumberOfRejectedObservations();
+}
+
 //--------------------------------------------------------------------------------
 double vtkPlusProbeCalibrationAlgo::GetCalibrationReprojectionError3DMean()
 {
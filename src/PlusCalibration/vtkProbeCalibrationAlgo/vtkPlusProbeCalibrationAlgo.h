@@ -17,6 +17,7 @@
 
 #include "vtkObject.h"
 #include "vtkPlusProbeCalibrationOptimizerAlgo.h"
+#include "PlusIncrementalLeastSquares.h"
 
 //class igsioTrackedFrame; 
 //class vtkIGSIOTrackedFrameList;
@@ -122,6 +123,52 @@ public:
   void ComputeError2d( const vnl_matrix_fixed<double, 4, 4>& imageToProbeMatrix, double& errorMean, double& errorStDev, double& errorRms );
   void ComputeError3d( const vnl_matrix_fixed<double, 4, 4>& imageToProbeMatrix, double& errorMean, double& errorStDev, double& errorRms );
 
+  /*!
+    Get the segmented wire intersection points of the non-outlier calibration frames with the corresponding wires transformed to the probe frame.
+    Used by the optimizer for computing residuals without accessing the tracked frames.
+    \param frameCorrespondences Output correspondences (indices: [frame][nwire*3+wire])
+  */
+  void GetCalibrationWireCorrespondences( std::vector< std::vector<vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType> >& frameCorrespondences );
+
+  /*!
+    Start incremental (live) calibration. Segmented frames can be added one by one by AddIncrementalCalibrationFrame while they are acquired
+    and the ImageToProbe estimate is updated after each frame, so the operator can see whether the sweep is good before all frames are collected.
+    The estimate is computed by the same linear least squares formulation as the batch calibration, using a recursive (or sliding window) solver,
+    so the cost of an update does not depend on the number of frames that have been added. The final calibration (with optimization and error report)
+    is still computed by Calibrate.
+    \param nWires NWire structure that contains the computed imaginary intersections
+  */
+  PlusStatus StartIncrementalCalibration( const std::vector<PlusNWire>& nWires );
+
+  /*!
+    Add a segmented frame to the incremental calibration and update the ImageToProbe estimate (that can be retrieved by GetImageToProbeTransformMatrix).
+    Frames with failed segmentation are ignored. Frames that are inconsistent with the current estimate are rejected as outliers.
+    \param trackedFrame Tracked frame (already segmented)
+    \param transformRepository Transform repository object to be able to get the default transform
+    \param frameAccepted Optional output, true if the frame was used for updating the estimate
+  */
+  PlusStatus AddIncrementalCalibrationFrame( igsioTrackedFrame* trackedFrame, vtkIGSIOTransformRepository* transformRepository, bool* frameAccepted = NULL );
+
+  /*! Returns true if enough frames have been added to the incremental calibration to compute an ImageToProbe estimate */
+  bool IsIncrementalCalibrationResultAvailable();
+
+  /*! RMS distance (in mm) between the middle wire positions computed from the phantom geometry and from the current incremental ImageToProbe estimate */
+  double GetIncrementalCalibrationRmsErrorMm();
+
+  /*! Number of frames used in the current incremental calibration estimate */
+  unsigned int GetIncrementalCalibrationNumberOfFrames();
+
+  /*! Number of frames rejected as outliers since the incremental calibration was started */
+  unsigned int GetIncrementalCalibrationNumberOfRejectedFrames();
+
+  /*! Number of most recent frames used in incremental calibration. If 0 then all accepted frames are used. */
+  vtkSetMacro( IncrementalCalibrationWindowSize, int );
+  vtkGetMacro( IncrementalCalibrationWindowSize, int );
+
+  /*! A frame is rejected in incremental calibration if its error is larger than this factor times the current RMS error. If 0 then no frames are rejected. */
+  vtkSetMacro( IncrementalCalibrationOutlierRejectionFactor, double );
+  vtkGetMacro( IncrementalCalibrationOutlierRejectionFactor, double );
+
 protected:
 
   enum PreProcessedWirePositionIdType
@@ -146,6 +193,20 @@ protected:
   */
   PlusStatus AddPositionsPerImage( igsioTrackedFrame* trackedFrame, vtkIGSIOTransformRepository* transformRepository, PreProcessedWirePositionIdType datasetType );
 
+  struct NWirePositionType;
+
+  /*!
+    Calculate positions of an individual image
+    \param trackedFrame The actual tracked frame (already segmented)
+    \param transformRepository Transform repository object to be able to get the default transform
+    \param framePosition Computed positions
+    \param segmentationValid Set to false if segmentation failed on the frame (in this case the frame has to be ignored)
+  */
+  PlusStatus ComputePositionsPerImage( igsioTrackedFrame* trackedFrame, vtkIGSIOTransformRepository* transformRepository, NWirePositionType& framePosition, bool& segmentationValid );
+
+  /*! Complete the ImageToProbe matrix (computed from 2D image points) with a Z axis that is orthogonal to the X and Y axes and has their average length */
+  static void CompleteImageToProbeTransformZAxis( vnl_matrix_fixed<double, 4, 4>& imageToProbeTransformMatrix );
+
   /*!
     Calculate 3D reprojection errors
     \param trackedFrameList Tracked frame list for error computation
@@ -316,6 +377,15 @@ protected:
 
   vtkPlusProbeCalibrationOptimizerAlgo* Optimizer;
 
+  /*! Solver of incremental calibration. Unknowns: rows of the ImageToProbe X axis, Y axis, and translation; right hand sides: probe X, Y, Z coordinates. */
+  PlusIncrementalLeastSquares IncrementalSolver;
+
+  /*! Number of most recent frames used in incremental calibration (0 = all) */
+  int IncrementalCalibrationWindowSize;
+
+  /*! Outlier rejection factor of incremental calibration */
+  double IncrementalCalibrationOutlierRejectionFactor;
+
 private:
   vtkPlusProbeCalibrationAlgo( const vtkPlusProbeCalibrationAlgo& );
   void operator=( const vtkPlusProbeCalibrationAlgo& );
@@ -13,6 +13,7 @@ See License.txt for details.
 #include "vtkPlusProbeCalibrationOptimizerAlgo.h"
 #include "vtkPlusProbeCalibrationAlgo.h"
 #include "vtkTransform.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkIGSIOTransformRepository.h"
 #include "vtkXMLUtilities.h"
 
@@ -22,8 +23,25 @@ See License.txt for details.
 #include "itkScaleVersor3DTransform.h"
 #include "itkSimilarity3DTransform.h"
 
+#include <vnl/vnl_rotation_matrix.h>
+#include <vnl/algo/vnl_svd.h>
+
+#include <algorithm>
+#include <future>
+#include <thread>
+
 typedef  itk::PowellOptimizer  OptimizerType;
 
+namespace
+{
+  const int LM_MAX_NUMBER_OF_ITERATIONS = 100;
+  const double LM_INITIAL_DAMPING = 1e-3;
+  const double LM_MAX_DAMPING = 1e10;
+  const double LM_RELATIVE_COST_TOLERANCE = 1e-10;
+  const double LM_STEP_TOLERANCE = 1e-10;
+  const unsigned int LM_MAX_NUMBER_OF_PARAMETERS = 8;
+}
+
 //-----------------------------------------------------------------------------
 class DistanceToWiresCostFunction : public itk::SingleValuedCostFunction
 {
@@ -159,12 +177,418 @@ private:
   vtkPlusProbeCalibrationOptimizerAlgo* m_CalibrationOptimizer;
 };
 
+//-----------------------------------------------------------------------------
+/*!
+  Sum of (robust) squared residuals of all wire correspondences, with analytic Jacobians.
+
+  The image to probe transform is represented by a rotation matrix, a translation vector, and a pixel spacing (one
+  value for isotropic, two values for anisotropic spacing; the spacing along the Z axis is the average of X and Y,
+  the same as in DistanceToWiresCostFunction). The parameters that the solver changes are increments around the current
+  estimate: rotation vector (3), translation (3), spacing (1 or 2). Rotation increments are applied as
+  R <- R * exp([w]x), therefore the parameterization is minimal and has no singularities.
+
+  The 2D residual is the difference between the segmented point and the intersection of the wire and the image plane (pixel),
+  the 3D residual is the difference between the segmented middle wire point transformed to the probe frame and its computed
+  position (mm). These match the errors computed by vtkPlusProbeCalibrationAlgo::ComputeError2d and ComputeError3d.
+*/
+class WireResidualProblem
+{
+public:
+  typedef vnl_matrix_fixed<double, LM_MAX_NUMBER_OF_PARAMETERS, LM_MAX_NUMBER_OF_PARAMETERS> NormalMatrixType;
+  typedef vnl_vector_fixed<double, LM_MAX_NUMBER_OF_PARAMETERS> NormalVectorType;
+
+  struct StateType
+  {
+    vnl_matrix_fixed<double, 3, 3> Rotation;
+    vnl_vector_fixed<double, 3> Translation;
+    vnl_vector_fixed<double, 3> Spacing;
+  };
+
+  struct NormalEquationsType
+  {
+    NormalMatrixType JtJ;
+    NormalVectorType Jtr;
+    double Cost;
+    unsigned int NumberOfResiduals;
+    NormalEquationsType()
+      : Cost(0.0)
+      , NumberOfResiduals(0)
+    {
+      JtJ.fill(0.0);
+      Jtr.fill(0.0);
+    }
+    void Add(const NormalEquationsType& other)
+    {
+      JtJ += other.JtJ;
+      Jtr += other.Jtr;
+      Cost += other.Cost;
+      NumberOfResiduals += other.NumberOfResiduals;
+    }
+  };
+
+  WireResidualProblem(const std::vector< std::vector<vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType> >& frameCorrespondences,
+                      vtkPlusProbeCalibrationOptimizerAlgo::OptimizationMethodType method, bool isotropicPixelSpacing,
+                      vtkPlusProbeCalibrationOptimizerAlgo::RobustLossType robustLoss, double robustLossThreshold)
+    : FrameCorrespondences(frameCorrespondences)
+    , Method(method)
+    , IsotropicPixelSpacing(isotropicPixelSpacing)
+    , RobustLoss(robustLoss)
+    , RobustLossThreshold(robustLossThreshold)
+  {
+    unsigned int numberOfFrames = static_cast<unsigned int>(this->FrameCorrespondences.size());
+    this->NumberOfThreads = std::max(1u, std::min(numberOfFrames, std::thread::hardware_concurrency()));
+  }
+
+  unsigned int GetNumberOfParameters() const
+  {
+    return this->IsotropicPixelSpacing ? 7 : 8;
+  }
+
+  unsigned int GetNumberOfThreads() const
+  {
+    return this->NumberOfThreads;
+  }
+
+  //----------------------------------------------------------------------------
+  static void GetTransformMatrix(vnl_matrix_fixed<double, 4, 4>& imageToProbeTransform_vnl, const StateType& state)
+  {
+    imageToProbeTransform_vnl.set_identity();
+    for (int row = 0; row < 3; row++)
+    {
+      for (int column = 0; column < 3; column++)
+      {
+        imageToProbeTransform_vnl(row, column) = state.Rotation(row, column) * state.Spacing[column];
+      }
+      imageToProbeTransform_vnl(row, 3) = state.Translation[row];
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Get the state from a matrix that is already constrained (orthogonal axes, Z spacing is computed from X and Y) */
+  static void GetState(StateType& state, const vnl_matrix_fixed<double, 4, 4>& constrainedImageToProbeTransform_vnl)
+  {
+    for (int column = 0; column < 3; column++)
+    {
+      vnl_vector_fixed<double, 3> axis(constrainedImageToProbeTransform_vnl(0, column), constrainedImageToProbeTransform_vnl(1, column), constrainedImageToProbeTransform_vnl(2, column));
+      state.Spacing[column] = axis.magnitude();
+      state.Rotation.set_column(column, axis / state.Spacing[column]);
+      state.Translation[column] = constrainedImageToProbeTransform_vnl(column, 3);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Apply the parameter increment to the state */
+  StateType GetUpdatedState(const StateType& state, const vnl_vector<double>& increment) const
+  {
+    StateType updatedState;
+    vnl_vector_fixed<double, 3> rotationIncrement(increment[0], increment[1], increment[2]);
+    updatedState.Rotation = state.Rotation * vnl_rotation_matrix(rotationIncrement);
+    updatedState.Translation = state.Translation + vnl_vector_fixed<double, 3>(increment[3], increment[4], increment[5]);
+    if (this->IsotropicPixelSpacing)
+    {
+      double spacing = state.Spacing[0] + increment[6];
+      updatedState.Spacing.fill(spacing);
+    }
+    else
+    {
+      updatedState.Spacing[0] = state.Spacing[0] + increment[6];
+      updatedState.Spacing[1] = state.Spacing[1] + increment[7];
+      updatedState.Spacing[2] = (updatedState.Spacing[0] + updatedState.Spacing[1]) / 2.0;
+    }
+    return updatedState;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Compute the cost and (if requested) the normal equations at the given state.
+    Frames are distributed between all available processor cores, each thread accumulates its own partial sums.
+  */
+  NormalEquationsType Evaluate(const StateType& state, bool computeJacobian) const
+  {
+    const unsigned int numberOfFrames = static_cast<unsigned int>(this->FrameCorrespondences.size());
+    std::vector< std::future<NormalEquationsType> > workers;
+    for (unsigned int threadIndex = 1; threadIndex < this->NumberOfThreads; ++threadIndex)
+    {
+      workers.push_back(std::async(std::launch::async, [ = ]()
+      {
+        return this->EvaluateFrames(state, computeJacobian, threadIndex, numberOfFrames, this->NumberOfThreads);
+      }));
+    }
+    NormalEquationsType normalEquations = this->EvaluateFrames(state, computeJacobian, 0, numberOfFrames, this->NumberOfThreads);
+    for (auto workerIt = workers.begin(); workerIt != workers.end(); ++workerIt)
+    {
+      normalEquations.Add(workerIt->get());
+    }
+    return normalEquations;
+  }
+
+protected:
+  typedef vnl_matrix_fixed<double, 3, LM_MAX_NUMBER_OF_PARAMETERS> JacobianType;
+
+  //----------------------------------------------------------------------------
+  NormalEquationsType EvaluateFrames(const StateType& state, bool computeJacobian, unsigned int firstFrameIndex, unsigned int numberOfFrames, unsigned int frameIndexStep) const
+  {
+    NormalEquationsType normalEquations;
+    vnl_vector_fixed<double, 3> residual;
+    JacobianType jacobian;
+    for (unsigned int frameIndex = firstFrameIndex; frameIndex < numberOfFrames; frameIndex += frameIndexStep)
+    {
+      const std::vector<vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType>& correspondences = this->FrameCorrespondences[frameIndex];
+      for (auto correspondenceIt = correspondences.begin(); correspondenceIt != correspondences.end(); ++correspondenceIt)
+      {
+        unsigned int residualSize = 0;
+        if (this->Method == vtkPlusProbeCalibrationOptimizerAlgo::MINIMIZE_DISTANCE_OF_ALL_WIRES_IN_2D)
+        {
+          if (!this->ComputeResidual2d(state, *correspondenceIt, residual, computeJacobian ? &jacobian : NULL))
+          {
+            // image plane and wire are parallel
+            continue;
+          }
+          residualSize = 2;
+        }
+        else
+        {
+          if (!correspondenceIt->MiddleWire)
+          {
+            continue;
+          }
+          this->ComputeResidual3d(state, *correspondenceIt, residual, computeJacobian ? &jacobian : NULL);
+          residualSize = 3;
+        }
+        this->AddResidual(normalEquations, residual, residualSize, computeJacobian ? &jacobian : NULL);
+      }
+    }
+    return normalEquations;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Add the (robust) squared residual to the cost, and its contribution to the normal equations. Robust loss is applied by iteratively reweighting the residuals. */
+  void AddResidual(NormalEquationsType& normalEquations, const vnl_vector_fixed<double, 3>& residual, unsigned int residualSize, const JacobianType* jacobian) const
+  {
+    double squaredError = 0.0;
+    for (unsigned int i = 0; i < residualSize; i++)
+    {
+      squaredError += residual[i] * residual[i];
+    }
+    double weight = 1.0;
+    if (this->RobustLoss == vtkPlusProbeCalibrationOptimizerAlgo::LOSS_HUBER && squaredError > this->RobustLossThreshold * this->RobustLossThreshold)
+    {
+      double error = sqrt(squaredError);
+      weight = this->RobustLossThreshold / error;
+      normalEquations.Cost += this->RobustLossThreshold * (2.0 * error - this->RobustLossThreshold);
+    }
+    else
+    {
+      normalEquations.Cost += squaredError;
+    }
+    normalEquations.NumberOfResiduals++;
+
+    if (jacobian == NULL)
+    {
+      return;
+    }
+    const unsigned int numberOfParameters = this->GetNumberOfParameters();
+    for (unsigned int i = 0; i < numberOfParameters; i++)
+    {
+      for (unsigned int k = 0; k < residualSize; k++)
+      {
+        normalEquations.Jtr[i] += weight * (*jacobian)(k, i) * residual[k];
+      }
+      for (unsigned int j = i; j < numberOfParameters; j++)
+      {
+        double sum = 0.0;
+        for (unsigned int k = 0; k < residualSize; k++)
+        {
+          sum += (*jacobian)(k, i) * (*jacobian)(k, j);
+        }
+        normalEquations.JtJ(i, j) += weight * sum;
+        if (i != j)
+        {
+          normalEquations.JtJ(j, i) += weight * sum;
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Get the derivative of the spacing vector components with respect to the spacing parameters */
+  void GetSpacingJacobian(vnl_matrix_fixed<double, 3, 2>& spacingJacobian) const
+  {
+    if (this->IsotropicPixelSpacing)
+    {
+      spacingJacobian.set_column(0, vnl_vector_fixed<double, 3>(1.0, 1.0, 1.0));
+      spacingJacobian.set_column(1, vnl_vector_fixed<double, 3>(0.0, 0.0, 0.0));
+    }
+    else
+    {
+      spacingJacobian.set_column(0, vnl_vector_fixed<double, 3>(1.0, 0.0, 0.5));
+      spacingJacobian.set_column(1, vnl_vector_fixed<double, 3>(0.0, 1.0, 0.5));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Transform a point from the probe frame to the image frame: p_Image = S^-1 * R^T * (p_Probe - t)
+    and compute the derivative of p_Image with respect to the parameter increments.
+  */
+  void TransformProbeToImage(const StateType& state, const vnl_vector_fixed<double, 3>& point_Probe, vnl_vector_fixed<double, 3>& point_Image, JacobianType* jacobian) const
+  {
+    vnl_vector_fixed<double, 3> rotatedPoint = state.Rotation.transpose() * (point_Probe - state.Translation);
+    for (int i = 0; i < 3; i++)
+    {
+      point_Image[i] = rotatedPoint[i] / state.Spacing[i];
+    }
+    if (jacobian == NULL)
+    {
+      return;
+    }
+    jacobian->fill(0.0);
+    // Rotation: d(exp(-[w]x) * u)/dw = [u]x
+    const double skew[3][3] =
+    {
+      { 0.0, -rotatedPoint[2], rotatedPoint[1] },
+      { rotatedPoint[2], 0.0, -rotatedPoint[0] },
+      { -rotatedPoint[1], rotatedPoint[0], 0.0 }
+    };
+    for (int i = 0; i < 3; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        (*jacobian)(i, j) = skew[i][j] / state.Spacing[i];
+        // Translation
+        (*jacobian)(i, 3 + j) = -state.Rotation(j, i) / state.Spacing[i];
+      }
+    }
+    // Spacing
+    vnl_matrix_fixed<double, 3, 2> spacingJacobian;
+    GetSpacingJacobian(spacingJacobian);
+    for (unsigned int spacingIndex = 0; spacingIndex + 6 < this->GetNumberOfParameters(); spacingIndex++)
+    {
+      for (int i = 0; i < 3; i++)
+      {
+        (*jacobian)(i, 6 + spacingIndex) = -point_Image[i] / state.Spacing[i] * spacingJacobian(i, spacingIndex);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns false if the wire is parallel to the image plane */
+  bool ComputeResidual2d(const StateType& state, const vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType& correspondence,
+                         vnl_vector_fixed<double, 3>& residual, JacobianType* jacobian) const
+  {
+    vnl_vector_fixed<double, 3> front_Image;
+    vnl_vector_fixed<double, 3> back_Image;
+    JacobianType frontJacobian;
+    JacobianType backJacobian;
+    TransformProbeToImage(state, correspondence.WireFrontPoint_Probe, front_Image, jacobian ? &frontJacobian : NULL);
+    TransformProbeToImage(state, correspondence.WireBackPoint_Probe, back_Image, jacobian ? &backJacobian : NULL);
+
+    // Intersection of the wire and the image plane (z=0): x = (front * back_z - back * front_z) / (back_z - front_z)
+    const double zDifference = back_Image[2] - front_Image[2];
+    if (fabs(zDifference) < 1e-12)
+    {
+      return false;
+    }
+    double intersection[2] = { 0 };
+    for (int i = 0; i < 2; i++)
+    {
+      intersection[i] = (front_Image[i] * back_Image[2] - back_Image[i] * front_Image[2]) / zDifference;
+      residual[i] = correspondence.SegmentedPoint_Image[i] - intersection[i];
+    }
+    residual[2] = 0.0;
+
+    if (jacobian == NULL)
+    {
+      return true;
+    }
+    jacobian->fill(0.0);
+    for (int i = 0; i < 2; i++)
+    {
+      // Derivatives of the intersection with respect to the front and back point coordinates
+      const double dFrontI = back_Image[2] / zDifference;
+      const double dFrontZ = (intersection[i] - back_Image[i]) / zDifference;
+      const double dBackI = -front_Image[2] / zDifference;
+      const double dBackZ = (front_Image[i] - intersection[i]) / zDifference;
+      for (unsigned int j = 0; j < this->GetNumberOfParameters(); j++)
+      {
+        (*jacobian)(i, j) = -(dFrontI * frontJacobian(i, j) + dFrontZ * frontJacobian(2, j) + dBackI * backJacobian(i, j) + dBackZ * backJacobian(2, j));
+      }
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void ComputeResidual3d(const StateType& state, const vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType& correspondence,
+                         vnl_vector_fixed<double, 3>& residual, JacobianType* jacobian) const
+  {
+    vnl_vector_fixed<double, 3> scaledPoint;
+    for (int i = 0; i < 3; i++)
+    {
+      scaledPoint[i] = correspondence.SegmentedPoint_Image[i] * state.Spacing[i];
+    }
+    residual = state.Rotation * scaledPoint + state.Translation - correspondence.MiddleWirePoint_Probe;
+
+    if (jacobian == NULL)
+    {
+      return;
+    }
+    jacobian->fill(0.0);
+    // Rotation: d(R * exp([w]x) * p)/dw = -R * [p]x
+    const double skew[3][3] =
+    {
+      { 0.0, -scaledPoint[2], scaledPoint[1] },
+      { scaledPoint[2], 0.0, -scaledPoint[0] },
+      { -scaledPoint[1], scaledPoint[0], 0.0 }
+    };
+    for (int i = 0; i < 3; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        double sum = 0.0;
+        for (int k = 0; k < 3; k++)
+        {
+          sum -= state.Rotation(i, k) * skew[k][j];
+        }
+        (*jacobian)(i, j) = sum;
+      }
+      // Translation
+      (*jacobian)(i, 3 + i) = 1.0;
+    }
+    // Spacing
+    vnl_matrix_fixed<double, 3, 2> spacingJacobian;
+    GetSpacingJacobian(spacingJacobian);
+    for (unsigned int spacingIndex = 0; spacingIndex + 6 < this->GetNumberOfParameters(); spacingIndex++)
+    {
+      for (int i = 0; i < 3; i++)
+      {
+        double sum = 0.0;
+        for (int k = 0; k < 3; k++)
+        {
+          sum += state.Rotation(i, k) * correspondence.SegmentedPoint_Image[k] * spacingJacobian(k, spacingIndex);
+        }
+        (*jacobian)(i, 6 + spacingIndex) = sum;
+      }
+    }
+  }
+
+  const std::vector< std::vector<vtkPlusProbeCalibrationOptimizerAlgo::WireCorrespondenceType> >& FrameCorrespondences;
+  vtkPlusProbeCalibrationOptimizerAlgo::OptimizationMethodType Method;
+  bool IsotropicPixelSpacing;
+  vtkPlusProbeCalibrationOptimizerAlgo::RobustLossType RobustLoss;
+  double RobustLossThreshold;
+  unsigned int NumberOfThreads;
+};
+
 //-----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkPlusProbeCalibrationOptimizerAlgo);
 
 //-----------------------------------------------------------------------------
 vtkPlusProbeCalibrationOptimizerAlgo::vtkPlusProbeCalibrationOptimizerAlgo()
 : IsotropicPixelSpacing(true)
+, OptimizationSolver(SOLVER_POWELL)
+, RobustLoss(LOSS_NONE)
+, RobustLossThreshold(1.0)
+, LastOptimizationTimeSec(0.0)
 , ProbeCalibrationAlgo(NULL)
 {
 }
@@ -227,10 +651,7 @@ PlusStatus vtkPlusProbeCalibrationOptimizerAlgo::ShowTransformation(const vnl_ma
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusProbeCalibrationOptimizerAlgo::Update()
 {
-  DistanceToWiresCostFunction::Pointer costFunction = new DistanceToWiresCostFunction(this);
-
-  DistanceToWiresCostFunction::ParametersType imageToProbeSeedTransformParameters(costFunction->GetNumberOfParameters());
-  DistanceToWiresCostFunction::GetTransformParameters(imageToProbeSeedTransformParameters, this->ImageToProbeSeedTransformMatrix);
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
 
   double errorMean=0.0;
   double errorStDev=0.0;
@@ -243,6 +664,59 @@ PlusStatus vtkPlusProbeCalibrationOptimizerAlgo::Update()
     igsioMath::LogVtkMatrix(vtkMatrix);
   }
 
+  PlusStatus status = PLUS_FAIL;
+  switch (this->OptimizationSolver)
+  {
+  case SOLVER_POWELL:
+    status = UpdatePowell(this->ImageToProbeSeedTransformMatrix);
+    break;
+  case SOLVER_LEVENBERG_MARQUARDT:
+    status = UpdateLevenbergMarquardt(this->ImageToProbeSeedTransformMatrix);
+    break;
+  default:
+    LOG_ERROR("Invalid optimization solver: " << this->OptimizationSolver);
+  }
+  if (status != PLUS_SUCCESS)
+  {
+    return status;
+  }
+
+  this->LastOptimizationTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+  LOG_INFO("Optimization solver: " << GetOptimizationSolverAsString(this->OptimizationSolver) << ", computation time: " << this->LastOptimizationTimeSec << " sec");
+
+  {
+    vtkSmartPointer<vtkMatrix4x4> vtkMatrix=vtkSmartPointer<vtkMatrix4x4>::New();
+    PlusMath::ConvertVnlMatrixToVtkMatrix(this->ImageToProbeTransformMatrix, vtkMatrix);
+    igsioMath::LogVtkMatrix(vtkMatrix);
+  }
+
+  // Store the optimized parameters and show the results
+  LOG_INFO("Cost function = " << GetOptimizationMethodAsString(this->OptimizationMethod));
+
+  LOG_INFO("Without optimization:");
+  ShowTransformation(this->ImageToProbeSeedTransformMatrix);
+
+  LOG_INFO("With optimization:");
+  ShowTransformation(this->ImageToProbeTransformMatrix);
+
+  vtkSmartPointer<vtkMatrix4x4> imageToProbeSeedTransformMatrixVtk = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkSmartPointer<vtkMatrix4x4> imageToProbeTransformMatrixVtk = vtkSmartPointer<vtkMatrix4x4>::New();
+  PlusMath::ConvertVnlMatrixToVtkMatrix(this->ImageToProbeSeedTransformMatrix,imageToProbeSeedTransformMatrixVtk);
+  PlusMath::ConvertVnlMatrixToVtkMatrix(this->ImageToProbeTransformMatrix,imageToProbeTransformMatrixVtk);
+  double angleDifference = igsioMath::GetOrientationDifference(imageToProbeSeedTransformMatrixVtk, imageToProbeTransformMatrixVtk);
+  LOG_INFO("Orientation difference between unoptimized and optimized matrices =  " << angleDifference << " deg");
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusProbeCalibrationOptimizerAlgo::UpdatePowell(const vnl_matrix_fixed<double,4,4> &imageToProbeSeedTransformMatrix)
+{
+  DistanceToWiresCostFunction::Pointer costFunction = new DistanceToWiresCostFunction(this);
+
+  DistanceToWiresCostFunction::ParametersType imageToProbeSeedTransformParameters(costFunction->GetNumberOfParameters());
+  DistanceToWiresCostFunction::GetTransformParameters(imageToProbeSeedTransformParameters, imageToProbeSeedTransformMatrix);
+
   double initialError=costFunction->GetValue(imageToProbeSeedTransformParameters);
   LOG_INFO("Initial cost function value with constrained matrix= " << initialError );
   {
@@ -321,27 +795,108 @@ PlusStatus vtkPlusProbeCalibrationOptimizerAlgo::Update()
   // Store the matrix
 
   costFunction->GetTransformMatrix(this->ImageToProbeTransformMatrix, optimizer->GetCurrentPosition());
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusProbeCalibrationOptimizerAlgo::UpdateLevenbergMarquardt(const vnl_matrix_fixed<double,4,4> &imageToProbeSeedTransformMatrix)
+{
+  if (this->OptimizationMethod != MINIMIZE_DISTANCE_OF_ALL_WIRES_IN_2D && this->OptimizationMethod != MINIMIZE_DISTANCE_OF_MIDDLE_WIRES_IN_3D)
   {
-    vtkSmartPointer<vtkMatrix4x4> vtkMatrix=vtkSmartPointer<vtkMatrix4x4>::New();
-    PlusMath::ConvertVnlMatrixToVtkMatrix(this->ImageToProbeTransformMatrix, vtkMatrix);
-    igsioMath::LogVtkMatrix(vtkMatrix);
+    LOG_ERROR("Invalid cost function");
+    return PLUS_FAIL;
+  }
+  if (this->RobustLoss != LOSS_NONE && this->RobustLossThreshold <= 0)
+  {
+    LOG_ERROR("RobustLossThreshold must be positive, current value: " << this->RobustLossThreshold);
+    return PLUS_FAIL;
   }
 
-  // Store the optimized parameters and show the results
-  LOG_INFO("Cost function = " << GetOptimizationMethodAsString(this->OptimizationMethod));
+  std::vector< std::vector<WireCorrespondenceType> > frameCorrespondences;
+  this->ProbeCalibrationAlgo->GetCalibrationWireCorrespondences(frameCorrespondences);
+  WireResidualProblem problem(frameCorrespondences, this->OptimizationMethod, this->IsotropicPixelSpacing, this->RobustLoss, this->RobustLossThreshold);
+  const unsigned int numberOfParameters = problem.GetNumberOfParameters();
 
-  LOG_INFO("Without optimization:");
-  ShowTransformation(this->ImageToProbeSeedTransformMatrix);
+  // Start from the seed constrained the same way as in the Powell solver (orthogonal axes, Z spacing computed from X and Y)
+  vnl_matrix_fixed<double,4,4> constrainedImageToProbeSeedTransformMatrix;
+  {
+    DistanceToWiresCostFunction::ParametersType imageToProbeSeedTransformParameters(numberOfParameters);
+    DistanceToWiresCostFunction::GetTransformParameters(imageToProbeSeedTransformParameters, imageToProbeSeedTransformMatrix);
+    DistanceToWiresCostFunction::GetTransformMatrix(constrainedImageToProbeSeedTransformMatrix, imageToProbeSeedTransformParameters);
+  }
+  WireResidualProblem::StateType state;
+  WireResidualProblem::GetState(state, constrainedImageToProbeSeedTransformMatrix);
 
-  LOG_INFO("With optimization:");
-  ShowTransformation(this->ImageToProbeTransformMatrix);
+  WireResidualProblem::NormalEquationsType normalEquations = problem.Evaluate(state, true);
+  if (normalEquations.NumberOfResiduals < numberOfParameters)
+  {
+    LOG_ERROR("Not enough segmented points for the optimization: " << normalEquations.NumberOfResiduals);
+    return PLUS_FAIL;
+  }
+  LOG_INFO("Initial cost function value with constrained matrix = " << sqrt(normalEquations.Cost / normalEquations.NumberOfResiduals)
+    << " (" << normalEquations.NumberOfResiduals << " residuals, " << problem.GetNumberOfThreads() << " threads)");
 
-  vtkSmartPointer<vtkMatrix4x4> imageToProbeSeedTransformMatrixVtk = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkSmartPointer<vtkMatrix4x4> imageToProbeTransformMatrixVtk = vtkSmartPointer<vtkMatrix4x4>::New();
-  PlusMath::ConvertVnlMatrixToVtkMatrix(this->ImageToProbeSeedTransformMatrix,imageToProbeSeedTransformMatrixVtk);
-  PlusMath::ConvertVnlMatrixToVtkMatrix(this->ImageToProbeTransformMatrix,imageToProbeTransformMatrixVtk);
-  double angleDifference = igsioMath::GetOrientationDifference(imageToProbeSeedTransformMatrixVtk, imageToProbeTransformMatrixVtk);
-  LOG_INFO("Orientation difference between unoptimized and optimized matrices =  " << angleDifference << " deg");
+  double damping = LM_INITIAL_DAMPING;
+  int iteration = 0;
+  std::string stopCondition = "Maximum number of iterations reached";
+  for (iteration = 0; iteration < LM_MAX_NUMBER_OF_ITERATIONS; iteration++)
+  {
+    bool stepAccepted = false;
+    bool converged = false;
+    while (!stepAccepted)
+    {
+      // Solve (JtJ + damping * diag(JtJ)) * increment = -Jtr
+      vnl_matrix<double> dampedJtJ(numberOfParameters, numberOfParameters);
+      vnl_vector<double> negativeJtr(numberOfParameters);
+      for (unsigned int i = 0; i < numberOfParameters; i++)
+      {
+        for (unsigned int j = 0; j < numberOfParameters; j++)
+        {
+          dampedJtJ(i, j) = normalEquations.JtJ(i, j);
+        }
+        dampedJtJ(i, i) += damping * std::max(normalEquations.JtJ(i, i), 1e-12);
+        negativeJtr[i] = -normalEquations.Jtr[i];
+      }
+      vnl_svd<double> svd(dampedJtJ);
+      vnl_vector<double> increment = svd.solve(negativeJtr);
+
+      WireResidualProblem::StateType candidateState = problem.GetUpdatedState(state, increment);
+      WireResidualProblem::NormalEquationsType candidateNormalEquations = problem.Evaluate(candidateState, false);
+      if (candidateNormalEquations.Cost < normalEquations.Cost)
+      {
+        stepAccepted = true;
+        double relativeCostDecrease = (normalEquations.Cost - candidateNormalEquations.Cost) / std::max(normalEquations.Cost, 1e-12);
+        state = candidateState;
+        normalEquations = problem.Evaluate(state, true);
+        damping = std::max(damping / 10.0, 1e-12);
+        if (relativeCostDecrease < LM_RELATIVE_COST_TOLERANCE || increment.magnitude() < LM_STEP_TOLERANCE)
+        {
+          stopCondition = "Cost function value or parameter change is below tolerance";
+          converged = true;
+        }
+      }
+      else
+      {
+        damping *= 10.0;
+        if (damping > LM_MAX_DAMPING)
+        {
+          stopCondition = "No further decrease of the cost function value";
+          converged = true;
+          break;
+        }
+      }
+    }
+    if (converged)
+    {
+      break;
+    }
+  }
+
+  LOG_INFO("Optimization stopping condition: " << stopCondition << ". Number of iterations: " << iteration
+    << ". Final cost function value: " << sqrt(normalEquations.Cost / normalEquations.NumberOfResiduals));
+
+  WireResidualProblem::GetTransformMatrix(this->ImageToProbeTransformMatrix, state);
 
   return PLUS_SUCCESS;
 }
@@ -383,6 +938,32 @@ const char* vtkPlusProbeCalibrationOptimizerAlgo::GetOptimizationMethodAsString(
   }
 }
 
+//----------------------------------------------------------------------------
+const char* vtkPlusProbeCalibrationOptimizerAlgo::GetOptimizationSolverAsString(OptimizationSolverType type)
+{
+  switch (type)
+  {
+  case SOLVER_POWELL: return "POWELL";
+  case SOLVER_LEVENBERG_MARQUARDT: return "LEVENBERG_MARQUARDT";
+  default:
+    LOG_ERROR("Unknown optimization solver: "<<type);
+    return "unknown";
+  }
+}
+
+//----------------------------------------------------------------------------
+const char* vtkPlusProbeCalibrationOptimizerAlgo::GetRobustLossAsString(RobustLossType type)
+{
+  switch (type)
+  {
+  case LOSS_NONE: return "NONE";
+  case LOSS_HUBER: return "HUBER";
+  default:
+    LOG_ERROR("Unknown robust loss: "<<type);
+    return "unknown";
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusProbeCalibrationOptimizerAlgo::ReadConfiguration( vtkXMLDataElement* aConfig )
 {
@@ -415,5 +996,49 @@ PlusStatus vtkPlusProbeCalibrationOptimizerAlgo::ReadConfiguration( vtkXMLDataEl
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IsotropicPixelSpacing, aConfig);
 
+  const char* optimizationSolver=aConfig->GetAttribute("OptimizationSolver");
+  if (optimizationSolver==NULL)
+  {
+    this->OptimizationSolver=SOLVER_POWELL;
+  }
+  else if (STRCASECMP(optimizationSolver, GetOptimizationSolverAsString(SOLVER_POWELL)) == 0)
+  {
+    this->OptimizationSolver=SOLVER_POWELL;
+  }
+  else if (STRCASECMP(optimizationSolver, GetOptimizationSolverAsString(SOLVER_LEVENBERG_MARQUARDT)) == 0)
+  {
+    this->OptimizationSolver=SOLVER_LEVENBERG_MARQUARDT;
+  }
+  else
+  {
+    LOG_ERROR("Unknown OptimizationSolver: " << optimizationSolver);
+    return PLUS_FAIL;
+  }
+
+  const char* robustLoss=aConfig->GetAttribute("RobustLoss");
+  if (robustLoss==NULL)
+  {
+    this->RobustLoss=LOSS_NONE;
+  }
+  else if (STRCASECMP(robustLoss, GetRobustLossAsString(LOSS_NONE)) == 0)
+  {
+    this->RobustLoss=LOSS_NONE;
+  }
+  else if (STRCASECMP(robustLoss, GetRobustLossAsString(LOSS_HUBER)) == 0)
+  {
+    this->RobustLoss=LOSS_HUBER;
+  }
+  else
+  {
+    LOG_ERROR("Unknown RobustLoss: " << robustLoss);
+    return PLUS_FAIL;
+  }
+
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, RobustLossThreshold, aConfig);
+  if (this->RobustLoss != LOSS_NONE && this->OptimizationSolver != SOLVER_LEVENBERG_MARQUARDT)
+  {
+    LOG_WARNING("RobustLoss is only used by the " << GetOptimizationSolverAsString(SOLVER_LEVENBERG_MARQUARDT) << " optimization solver");
+  }
+
   return PLUS_SUCCESS;
 }
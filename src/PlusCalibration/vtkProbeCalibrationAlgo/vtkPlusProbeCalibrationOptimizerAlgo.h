@@ -31,6 +31,12 @@ class vtkPlusProbeCalibrationAlgo;
   it is more accurate to optimize the in-plane (2D) error. Also this optimizer enforces orthogonality of the image to
   probe matrix and optionally it can enforce isotropic image pixel spacing.
 
+  Two solvers are available. The Powell solver is derivative-free, it minimizes the RMS error computed by
+  vtkPlusProbeCalibrationAlgo. The Levenberg-Marquardt solver uses a minimal parameterization (rotation increment,
+  translation, pixel spacing) with analytic Jacobians, evaluates the residuals of the frames in parallel, and
+  optionally it can use a robust (Huber) loss to reduce the influence of mis-segmented points. It requires much less
+  cost function evaluations, therefore it is preferred for calibrations with many frames.
+
   \ingroup PlusLibCalibrationAlgo
 */
 class vtkPlusProbeCalibrationOptimizerAlgo : public vtkObject
@@ -46,6 +52,35 @@ public:
     MINIMIZE_DISTANCE_OF_ALL_WIRES_IN_2D
   };  
 
+  /* Algorithm that is used for finding the minimum of the cost function */
+  enum OptimizationSolverType
+  {
+    SOLVER_POWELL,
+    SOLVER_LEVENBERG_MARQUARDT
+  };
+
+  /* Loss function applied to the residual of each segmented point (only used by the Levenberg-Marquardt solver) */
+  enum RobustLossType
+  {
+    LOSS_NONE,
+    LOSS_HUBER
+  };
+
+  /*! Segmented wire intersection point and the corresponding wire, used for residual computation */
+  struct WireCorrespondenceType
+  {
+    /*! Segmented wire intersection point position in the image frame (pixel) */
+    vnl_vector_fixed<double,3> SegmentedPoint_Image;
+    /*! Front end point of the wire in the probe frame */
+    vnl_vector_fixed<double,3> WireFrontPoint_Probe;
+    /*! Back end point of the wire in the probe frame */
+    vnl_vector_fixed<double,3> WireBackPoint_Probe;
+    /*! Computed position of the segmented point in the probe frame (only set for middle wires) */
+    vnl_vector_fixed<double,3> MiddleWirePoint_Probe;
+    /*! True if the point is the intersection of the middle wire of an N-wire */
+    bool MiddleWire;
+  };
+
   vtkTypeMacro(vtkPlusProbeCalibrationOptimizerAlgo,vtkObject);
   static vtkPlusProbeCalibrationOptimizerAlgo *New();
 
@@ -75,6 +110,20 @@ public:
   void SetOptimizationMethod(OptimizationMethodType optimizationMethod) { this->OptimizationMethod=optimizationMethod; }
   static const char* GetOptimizationMethodAsString(OptimizationMethodType type);
 
+  OptimizationSolverType GetOptimizationSolver() { return this->OptimizationSolver; }
+  void SetOptimizationSolver(OptimizationSolverType optimizationSolver) { this->OptimizationSolver=optimizationSolver; }
+  static const char* GetOptimizationSolverAsString(OptimizationSolverType type);
+
+  RobustLossType GetRobustLoss() { return this->RobustLoss; }
+  void SetRobustLoss(RobustLossType robustLoss) { this->RobustLoss=robustLoss; }
+  static const char* GetRobustLossAsString(RobustLossType type);
+
+  double GetRobustLossThreshold() { return this->RobustLossThreshold; }
+  void SetRobustLossThreshold(double robustLossThreshold) { this->RobustLossThreshold=robustLossThreshold; }
+
+  /*! Get the time spent in the last Update call (in seconds) */
+  double GetLastOptimizationTimeSec() { return this->LastOptimizationTimeSec; }
+
   void SetImageToProbeSeedTransform(const vnl_matrix_fixed<double,4,4> &imageToProbeTransformMatrix);
 
   void SetProbeCalibrationAlgo(vtkPlusProbeCalibrationAlgo* probeCalibrationAlgo);
@@ -82,6 +131,12 @@ public:
 protected:
 
   PlusStatus ShowTransformation(const vnl_matrix_fixed<double,4,4> &transformationMatrix);
+
+  /*! Minimize the RMS error using the derivative-free Powell optimizer */
+  PlusStatus UpdatePowell(const vnl_matrix_fixed<double,4,4> &imageToProbeSeedTransformMatrix);
+
+  /*! Minimize the sum of squared (or robust) residuals using the Levenberg-Marquardt method */
+  PlusStatus UpdateLevenbergMarquardt(const vnl_matrix_fixed<double,4,4> &imageToProbeSeedTransformMatrix);
   
   vtkPlusProbeCalibrationOptimizerAlgo();
   virtual  ~vtkPlusProbeCalibrationOptimizerAlgo();
@@ -93,6 +148,18 @@ protected:
   /*! Cost function to minimize during the optimization */
   OptimizationMethodType OptimizationMethod;
 
+  /*! Algorithm that finds the minimum of the cost function */
+  OptimizationSolverType OptimizationSolver;
+
+  /*! Loss function applied to the residuals by the Levenberg-Marquardt solver */
+  RobustLossType RobustLoss;
+
+  /*! Residuals larger than this value are down-weighted by the robust loss (in the unit of the residual: pixel for 2D, mm for 3D) */
+  double RobustLossThreshold;
+
+  /*! Duration of the last optimization */
+  double LastOptimizationTimeSec;
+
   /*! Store the seed for the optimization process */
   vnl_matrix_fixed<double,4,4> ImageToProbeSeedTransformMatrix;
 
@@ -0,0 +1,63 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusClock.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// STL includes
+#include <atomic>
+
+namespace
+{
+  std::atomic<bool> VirtualClockEnabled(false);
+  std::atomic<double> VirtualTime(0.0);
+}
+
+//----------------------------------------------------------------------------
+double PlusClock::GetTime()
+{
+  if (VirtualClockEnabled.load(std::memory_order_acquire))
+  {
+    return VirtualTime.load(std::memory_order_acquire);
+  }
+  return vtkIGSIOAccurateTimer::GetSystemTime();
+}
+
+//----------------------------------------------------------------------------
+void PlusClock::EnableVirtualClock(double startTime)
+{
+  VirtualTime.store(startTime, std::memory_order_release);
+  VirtualClockEnabled.store(true, std::memory_order_release);
+  LOG_INFO("Virtual clock enabled, start time: " << std::fixed << startTime);
+}
+
+//----------------------------------------------------------------------------
+void PlusClock::DisableVirtualClock()
+{
+  if (VirtualClockEnabled.exchange(false, std::memory_order_acq_rel))
+  {
+    LOG_INFO("Virtual clock disabled at time: " << std::fixed << VirtualTime.load(std::memory_order_acquire));
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusClock::IsVirtualClockEnabled()
+{
+  return VirtualClockEnabled.load(std::memory_order_acquire);
+}
+
+//----------------------------------------------------------------------------
+void PlusClock::SetVirtualTime(double time)
+{
+  double currentTime = VirtualTime.load(std::memory_order_acquire);
+  while (time > currentTime && !VirtualTime.compare_exchange_weak(currentTime, time, std::memory_order_acq_rel))
+  {
+    // currentTime is updated by compare_exchange_weak on failure, retry with the new value
+  }
+}
@@ -0,0 +1,49 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusClock_h
+#define __PlusClock_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+/*!
+  \class PlusClock
+  \brief Time base of data acquisition and processing
+
+  By default the time is the system time (vtkIGSIOAccurateTimer::GetSystemTime). If the virtual clock is enabled
+  then the time only changes when it is set explicitly by SetVirtualTime(). The virtual clock is used by
+  vtkPlusDataCollector for replaying recorded data deterministically, as fast as possible: the replay is driven
+  by the timestamps of the recorded frames instead of the wall clock.
+
+  The clock is shared by the whole process. Code that paces acquisition or processing (data collection, virtual devices)
+  should get the current time from this class. Code that measures elapsed wall-clock time (e.g., performance statistics)
+  should use the system time instead.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusClock
+{
+public:
+  /*! Current time in seconds: the system time, or the virtual time if the virtual clock is enabled */
+  static double GetTime();
+
+  /*! Switch to virtual time, starting at the specified time */
+  static void EnableVirtualClock(double startTime);
+
+  /*! Switch back to system time */
+  static void DisableVirtualClock();
+
+  static bool IsVirtualClockEnabled();
+
+  /*! Set the current virtual time. The virtual time never goes backward, earlier times are ignored. */
+  static void SetVirtualTime(double time);
+
+private:
+  PlusClock();
+};
+
+#endif //__PlusClock_h
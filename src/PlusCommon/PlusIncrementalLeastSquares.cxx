@@ -0,0 +1,217 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusIncrementalLeastSquares.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "vnl/algo/vnl_svd.h"
+
+namespace
+{
+  // Singular values of the normal matrix smaller than this fraction of the largest one are treated as zero
+  // (the solution is the minimum-norm solution while the observations do not constrain all unknowns yet)
+  const double RELATIVE_SINGULAR_VALUE_TOLERANCE = 1e-12;
+
+  const double DEFAULT_OUTLIER_REJECTION_FACTOR = 3.0;
+  const unsigned int DEFAULT_MINIMUM_NUMBER_OF_OBSERVATIONS_FOR_OUTLIER_REJECTION = 10;
+}
+
+//----------------------------------------------------------------------------
+PlusIncrementalLeastSquares::PlusIncrementalLeastSquares()
+  : NumberOfUnknowns(0)
+  , NumberOfRightHandSides(0)
+  , BtB(0.0)
+  , SolutionValid(false)
+  , NumberOfObservations(0)
+  , NumberOfRejectedObservations(0)
+  , NumberOfRemovalsSinceRecompute(0)
+  , WindowSize(0)
+  , OutlierRejectionFactor(DEFAULT_OUTLIER_REJECTION_FACTOR)
+  , MinimumOutlierThreshold(0.0)
+  , MinimumNumberOfObservationsForOutlierRejection(DEFAULT_MINIMUM_NUMBER_OF_OBSERVATIONS_FOR_OUTLIER_REJECTION)
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusIncrementalLeastSquares::Initialize(unsigned int numberOfUnknowns, unsigned int numberOfRightHandSides)
+{
+  this->NumberOfUnknowns = numberOfUnknowns;
+  this->NumberOfRightHandSides = numberOfRightHandSides;
+  this->Reset();
+}
+
+//----------------------------------------------------------------------------
+void PlusIncrementalLeastSquares::Reset()
+{
+  this->AtA.set_size(this->NumberOfUnknowns, this->NumberOfUnknowns);
+  this->AtA.fill(0.0);
+  this->AtB.set_size(this->NumberOfUnknowns, this->NumberOfRightHandSides);
+  this->AtB.fill(0.0);
+  this->BtB = 0.0;
+  this->Solution.set_size(this->NumberOfUnknowns, this->NumberOfRightHandSides);
+  this->Solution.fill(0.0);
+  this->SolutionValid = false;
+  this->Observations.clear();
+  this->NumberOfObservations = 0;
+  this->NumberOfRejectedObservations = 0;
+  this->NumberOfRemovalsSinceRecompute = 0;
+}
+
+//----------------------------------------------------------------------------
+void PlusIncrementalLeastSquares::SetWindowSize(unsigned int windowSize)
+{
+  if (this->WindowSize == windowSize)
+  {
+    return;
+  }
+  this->WindowSize = windowSize;
+  // Observations are only stored if there is a window, so the existing sums cannot be trimmed to the new window
+  this->Reset();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIncrementalLeastSquares::AddObservation(const vnl_matrix<double>& a, const vnl_matrix<double>& b, bool* accepted/*=NULL*/)
+{
+  if (accepted != NULL)
+  {
+    *accepted = false;
+  }
+  if (this->NumberOfUnknowns == 0 || a.cols() != this->NumberOfUnknowns || b.cols() != this->NumberOfRightHandSides || a.rows() != b.rows() || a.rows() == 0)
+  {
+    LOG_ERROR("PlusIncrementalLeastSquares::AddObservation failed: observation size (A: " << a.rows() << "x" << a.cols() << ", B: " << b.rows() << "x" << b.cols()
+              << ") does not match the problem size (" << this->NumberOfUnknowns << " unknowns, " << this->NumberOfRightHandSides << " right hand sides)");
+    return PLUS_FAIL;
+  }
+
+  // Online outlier rejection: compare the residual of the new observation to the residual of the accepted ones
+  if (this->OutlierRejectionFactor > 0 && this->SolutionValid && this->NumberOfObservations >= this->MinimumNumberOfObservationsForOutlierRejection)
+  {
+    double residual = this->GetObservationResidual(a, b);
+    double threshold = std::max(this->OutlierRejectionFactor * this->GetRmsResidual(), this->MinimumOutlierThreshold);
+    if (residual > threshold)
+    {
+      LOG_DEBUG("Observation is rejected as outlier: residual = " << residual << ", threshold = " << threshold);
+      this->NumberOfRejectedObservations++;
+      return PLUS_SUCCESS;
+    }
+  }
+
+  this->AccumulateObservation(a, b, 1.0);
+  this->NumberOfObservations++;
+
+  if (this->WindowSize > 0)
+  {
+    Observation observation;
+    observation.A = a;
+    observation.B = b;
+    this->Observations.push_back(observation);
+
+    if (this->Observations.size() > this->WindowSize)
+    {
+      // Remove the oldest observation from the window
+      this->NumberOfRemovalsSinceRecompute++;
+      if (this->NumberOfRemovalsSinceRecompute >= this->WindowSize)
+      {
+        this->Observations.pop_front();
+        this->RecomputeNormalEquations();
+      }
+      else
+      {
+        this->AccumulateObservation(this->Observations.front().A, this->Observations.front().B, -1.0);
+        this->Observations.pop_front();
+      }
+      this->NumberOfObservations--;
+    }
+  }
+
+  this->UpdateSolution();
+
+  if (accepted != NULL)
+  {
+    *accepted = true;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIncrementalLeastSquares::AccumulateObservation(const vnl_matrix<double>& a, const vnl_matrix<double>& b, double sign)
+{
+  vnl_matrix<double> aTransposed = a.transpose();
+  this->AtA += sign * (aTransposed * a);
+  this->AtB += sign * (aTransposed * b);
+  this->BtB += sign * b.frobenius_norm() * b.frobenius_norm();
+}
+
+//----------------------------------------------------------------------------
+void PlusIncrementalLeastSquares::RecomputeNormalEquations()
+{
+  this->AtA.fill(0.0);
+  this->AtB.fill(0.0);
+  this->BtB = 0.0;
+  for (std::deque<Observation>::const_iterator it = this->Observations.begin(); it != this->Observations.end(); ++it)
+  {
+    this->AccumulateObservation(it->A, it->B, 1.0);
+  }
+  this->NumberOfRemovalsSinceRecompute = 0;
+}
+
+//----------------------------------------------------------------------------
+void PlusIncrementalLeastSquares::UpdateSolution()
+{
+  if (this->NumberOfObservations == 0)
+  {
+    this->Solution.fill(0.0);
+    this->SolutionValid = false;
+    return;
+  }
+  vnl_svd<double> svd(this->AtA, -RELATIVE_SINGULAR_VALUE_TOLERANCE);
+  this->Solution = svd.solve(this->AtB);
+  this->SolutionValid = true;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIncrementalLeastSquares::GetSolution(vnl_matrix<double>& x) const
+{
+  if (!this->SolutionValid)
+  {
+    return PLUS_FAIL;
+  }
+  x = this->Solution;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+double PlusIncrementalLeastSquares::GetObservationResidual(const vnl_matrix<double>& a, const vnl_matrix<double>& b) const
+{
+  return (a * this->Solution - b).frobenius_norm();
+}
+
+//----------------------------------------------------------------------------
+double PlusIncrementalLeastSquares::GetRmsResidual() const
+{
+  if (!this->SolutionValid || this->NumberOfObservations == 0)
+  {
+    return 0.0;
+  }
+  // Sum of squared residuals from the normal equations: trace(Xt*AtA*X) - 2*trace(Xt*AtB) + BtB
+  double sumSquaredResiduals = this->BtB;
+  vnl_matrix<double> ataX = this->AtA * this->Solution;
+  for (unsigned int row = 0; row < this->NumberOfUnknowns; ++row)
+  {
+    for (unsigned int col = 0; col < this->NumberOfRightHandSides; ++col)
+    {
+      sumSquaredResiduals += this->Solution(row, col) * (ataX(row, col) - 2.0 * this->AtB(row, col));
+    }
+  }
+  // May be slightly negative due to round-off errors
+  if (sumSquaredResiduals < 0)
+  {
+    sumSquaredResiduals = 0;
+  }
+  return std::sqrt(sumSquaredResiduals / this->NumberOfObservations);
+}
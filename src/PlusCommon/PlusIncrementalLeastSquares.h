@@ -0,0 +1,131 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIncrementalLeastSquares_h
+#define __PlusIncrementalLeastSquares_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <deque>
+
+#include "vnl/vnl_matrix.h"
+
+/*!
+  \class PlusIncrementalLeastSquares
+  \brief Recursive / sliding-window linear least squares solver for calibrations that are updated while data is acquired
+
+  Solves A*X = B in the least squares sense, where the rows of A and B are added observation by observation
+  (an observation is a block of rows that belong together, e.g., all N-wire points of one ultrasound frame
+  or the three equations of one pivot calibration pose). Only the normal equations (AtA, AtB, BtB) are accumulated,
+  so adding an observation and updating the solution costs the same regardless of how many observations
+  were added before.
+
+  If a window size is set then only the most recent observations are kept: when the window is full the contribution
+  of the oldest observation is subtracted from the normal equations. To prevent accumulation of round-off errors
+  the normal equations are recomputed from the stored observations after every WindowSize removals, so the
+  amortized cost of an update remains bounded.
+
+  Outliers are rejected online: once enough observations are accepted, a new observation is rejected if its
+  residual (computed with the current solution) is larger than OutlierRejectionFactor times the RMS residual of the
+  accepted observations.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusIncrementalLeastSquares
+{
+public:
+  PlusIncrementalLeastSquares();
+
+  /*!
+    Set the problem size and remove all observations
+    \param numberOfUnknowns Number of columns of A (number of rows of X)
+    \param numberOfRightHandSides Number of columns of B (number of columns of X)
+  */
+  void Initialize(unsigned int numberOfUnknowns, unsigned int numberOfRightHandSides);
+
+  /*! Remove all observations, keep the problem size and settings */
+  void Reset();
+
+  /*! Maximum number of observations used for computing the solution. If 0 then all accepted observations are used. Changing the window size removes all observations. */
+  void SetWindowSize(unsigned int windowSize);
+  unsigned int GetWindowSize() const { return this->WindowSize; }
+
+  /*! An observation is rejected if its residual is larger than this factor times the current RMS residual. If 0 then outliers are not rejected. */
+  void SetOutlierRejectionFactor(double factor) { this->OutlierRejectionFactor = factor; }
+  double GetOutlierRejectionFactor() const { return this->OutlierRejectionFactor; }
+
+  /*! Observations are not rejected if their residual is below this value (prevents rejecting everything when the data is nearly noise-free) */
+  void SetMinimumOutlierThreshold(double threshold) { this->MinimumOutlierThreshold = threshold; }
+  double GetMinimumOutlierThreshold() const { return this->MinimumOutlierThreshold; }
+
+  /*! Outlier rejection is enabled only after this many observations have been accepted */
+  void SetMinimumNumberOfObservationsForOutlierRejection(unsigned int count) { this->MinimumNumberOfObservationsForOutlierRejection = count; }
+  unsigned int GetMinimumNumberOfObservationsForOutlierRejection() const { return this->MinimumNumberOfObservationsForOutlierRejection; }
+
+  /*!
+    Add an observation and update the solution
+    \param a Coefficient rows of the observation (k x numberOfUnknowns)
+    \param b Right hand side rows of the observation (k x numberOfRightHandSides)
+    \param accepted Optional output, set to false if the observation was rejected as an outlier
+    \return PLUS_FAIL if the size of the observation does not match the problem size
+  */
+  PlusStatus AddObservation(const vnl_matrix<double>& a, const vnl_matrix<double>& b, bool* accepted = NULL);
+
+  /*! Get the current solution (numberOfUnknowns x numberOfRightHandSides). Returns PLUS_FAIL if there are no observations yet. */
+  PlusStatus GetSolution(vnl_matrix<double>& x) const;
+
+  /*! Residual norm of an observation computed with the current solution */
+  double GetObservationResidual(const vnl_matrix<double>& a, const vnl_matrix<double>& b) const;
+
+  /*! Root mean square of the residual norms of the observations that are used in the current solution */
+  double GetRmsResidual() const;
+
+  /*! Number of observations that are used in the current solution */
+  unsigned int GetNumberOfObservations() const { return this->NumberOfObservations; }
+
+  /*! Number of observations that were rejected as outliers since the last reset */
+  unsigned int GetNumberOfRejectedObservations() const { return this->NumberOfRejectedObservations; }
+
+protected:
+  struct Observation
+  {
+    vnl_matrix<double> A;
+    vnl_matrix<double> B;
+  };
+
+  /*! Add (sign=1) or subtract (sign=-1) the contribution of an observation to the normal equations */
+  void AccumulateObservation(const vnl_matrix<double>& a, const vnl_matrix<double>& b, double sign);
+
+  /*! Recompute the normal equations from the stored observations */
+  void RecomputeNormalEquations();
+
+  /*! Solve the normal equations and store the result in Solution */
+  void UpdateSolution();
+
+  unsigned int NumberOfUnknowns;
+  unsigned int NumberOfRightHandSides;
+
+  vnl_matrix<double> AtA;
+  vnl_matrix<double> AtB;
+  double BtB;
+
+  vnl_matrix<double> Solution;
+  bool SolutionValid;
+
+  /*! Observations in the window (only stored if window size is not 0) */
+  std::deque<Observation> Observations;
+  unsigned int NumberOfObservations;
+  unsigned int NumberOfRejectedObservations;
+  unsigned int NumberOfRemovalsSinceRecompute;
+
+  unsigned int WindowSize;
+  double OutlierRejectionFactor;
+  double MinimumOutlierThreshold;
+  unsigned int MinimumNumberOfObservationsForOutlierRejection;
+};
+
+#endif // __PlusIncrementalLeastSquares_h
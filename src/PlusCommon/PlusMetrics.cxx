@@ -0,0 +1,337 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMetrics.h"
+
+// VTK includes
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+std::atomic<bool> PlusMetricsRegistry::Enabled(false);
+
+//----------------------------------------------------------------------------
+PlusMetricHistogram::PlusMetricHistogram()
+{
+  this->Reset();
+}
+
+//----------------------------------------------------------------------------
+void PlusMetricHistogram::Reset()
+{
+  for (int i = 0; i < BUCKET_COUNT; ++i)
+  {
+    this->Buckets[i].store(0, std::memory_order_relaxed);
+  }
+  this->Count.store(0, std::memory_order_relaxed);
+  this->SumNs.store(0, std::memory_order_relaxed);
+  this->MaxNs.store(0, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+int PlusMetricHistogram::GetBucketIndex(uint64_t valueNs)
+{
+  if (valueNs < SUB_BUCKET_COUNT)
+  {
+    return static_cast<int>(valueNs);
+  }
+  // Position of the most significant bit
+  int msb = 0;
+  for (int shift = 32; shift > 0; shift >>= 1)
+  {
+    if (valueNs >> (msb + shift))
+    {
+      msb += shift;
+    }
+  }
+  if (msb >= MAX_VALUE_BITS)
+  {
+    return BUCKET_COUNT - 1;
+  }
+  int subBucket = static_cast<int>((valueNs >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1));
+  return (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + subBucket;
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusMetricHistogram::GetBucketUpperBoundNs(int bucketIndex)
+{
+  if (bucketIndex < SUB_BUCKET_COUNT)
+  {
+    return static_cast<uint64_t>(bucketIndex);
+  }
+  int block = bucketIndex / SUB_BUCKET_COUNT;
+  int subBucket = bucketIndex % SUB_BUCKET_COUNT;
+  int shift = block - 1;
+  uint64_t lowerBound = static_cast<uint64_t>(SUB_BUCKET_COUNT + subBucket) << shift;
+  return lowerBound + (static_cast<uint64_t>(1) << shift) - 1;
+}
+
+//----------------------------------------------------------------------------
+void PlusMetricHistogram::Record(uint64_t valueNs)
+{
+  this->Buckets[GetBucketIndex(valueNs)].fetch_add(1, std::memory_order_relaxed);
+  this->Count.fetch_add(1, std::memory_order_relaxed);
+  this->SumNs.fetch_add(valueNs, std::memory_order_relaxed);
+  uint64_t previousMax = this->MaxNs.load(std::memory_order_relaxed);
+  while (valueNs > previousMax && !this->MaxNs.compare_exchange_weak(previousMax, valueNs, std::memory_order_relaxed))
+  {
+  }
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusMetricHistogram::GetPercentileNs(double fraction) const
+{
+  uint64_t count = this->GetCount();
+  if (count == 0)
+  {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(fraction * count + 0.5);
+  if (rank < 1)
+  {
+    rank = 1;
+  }
+  uint64_t cumulativeCount = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i)
+  {
+    cumulativeCount += this->GetBucketCount(i);
+    if (cumulativeCount >= rank)
+    {
+      return std::min(GetBucketUpperBoundNs(i), this->GetMaxNs());
+    }
+  }
+  return this->GetMaxNs();
+}
+
+//----------------------------------------------------------------------------
+PlusMetricsRegistry::PlusMetricsRegistry()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusMetricsRegistry* PlusMetricsRegistry::GetInstance()
+{
+  // Intentionally never deleted: instrumented code may cache metric pointers in static variables
+  static PlusMetricsRegistry* instance = new PlusMetricsRegistry;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+PlusMetricCounter* PlusMetricsRegistry::GetCounter(const std::string& name, const std::string& labels)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::unique_ptr<PlusMetricCounter>& metric = this->Counters[MetricKey(name, labels)];
+  if (!metric)
+  {
+    metric.reset(new PlusMetricCounter);
+  }
+  return metric.get();
+}
+
+//----------------------------------------------------------------------------
+PlusMetricGauge* PlusMetricsRegistry::GetGauge(const std::string& name, const std::string& labels)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::unique_ptr<PlusMetricGauge>& metric = this->Gauges[MetricKey(name, labels)];
+  if (!metric)
+  {
+    metric.reset(new PlusMetricGauge);
+  }
+  return metric.get();
+}
+
+//----------------------------------------------------------------------------
+PlusMetricHistogram* PlusMetricsRegistry::GetHistogram(const std::string& name, const std::string& labels)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::unique_ptr<PlusMetricHistogram>& metric = this->Histograms[MetricKey(name, labels)];
+  if (!metric)
+  {
+    metric.reset(new PlusMetricHistogram);
+  }
+  return metric.get();
+}
+
+//----------------------------------------------------------------------------
+std::string PlusMetricsRegistry::MakeLabel(const std::string& name, const std::string& value)
+{
+  std::string label = name + "=\"";
+  for (std::string::const_iterator it = value.begin(); it != value.end(); ++it)
+  {
+    switch (*it)
+    {
+      case '\\':
+        label += "\\\\";
+        break;
+      case '"':
+        label += "\\\"";
+        break;
+      case '\n':
+        label += "\\n";
+        break;
+      default:
+        label += *it;
+    }
+  }
+  return label + "\"";
+}
+
+//----------------------------------------------------------------------------
+void PlusMetricsRegistry::Reset()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->ResetInternal();
+}
+
+//----------------------------------------------------------------------------
+void PlusMetricsRegistry::ResetInternal()
+{
+  for (auto it = this->Counters.begin(); it != this->Counters.end(); ++it)
+  {
+    it->second->Reset();
+  }
+  for (auto it = this->Gauges.begin(); it != this->Gauges.end(); ++it)
+  {
+    it->second->Reset();
+  }
+  for (auto it = this->Histograms.begin(); it != this->Histograms.end(); ++it)
+  {
+    it->second->Reset();
+  }
+}
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  std::string GetLabelString(const std::string& labels, const std::string& extraLabel = "")
+  {
+    if (labels.empty() && extraLabel.empty())
+    {
+      return "";
+    }
+    if (labels.empty())
+    {
+      return "{" + extraLabel + "}";
+    }
+    if (extraLabel.empty())
+    {
+      return "{" + labels + "}";
+    }
+    return "{" + labels + "," + extraLabel + "}";
+  }
+
+  //----------------------------------------------------------------------------
+  template <class MetricType>
+  void WriteSimpleMetrics(std::ostream& os, const std::map<std::pair<std::string, std::string>, std::unique_ptr<MetricType> >& metrics, const char* typeName)
+  {
+    std::string previousName;
+    for (auto it = metrics.begin(); it != metrics.end(); ++it)
+    {
+      if (it->first.first != previousName)
+      {
+        os << "# TYPE " << it->first.first << " " << typeName << "\n";
+        previousName = it->first.first;
+      }
+      os << it->first.first << GetLabelString(it->first.second) << " " << it->second->GetValue() << "\n";
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string PlusMetricsRegistry::GetPrometheusText(bool resetAfterExport/*=false*/)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::ostringstream os;
+  os << std::setprecision(9);
+
+  WriteSimpleMetrics(os, this->Counters, "counter");
+  WriteSimpleMetrics(os, this->Gauges, "gauge");
+
+  // Histograms are sorted by name, all series of a metric family are written together
+  const double quantiles[] = { 0.5, 0.9, 0.99 };
+  for (auto familyBegin = this->Histograms.begin(); familyBegin != this->Histograms.end();)
+  {
+    const std::string& name = familyBegin->first.first;
+    auto familyEnd = familyBegin;
+    while (familyEnd != this->Histograms.end() && familyEnd->first.first == name)
+    {
+      ++familyEnd;
+    }
+
+    os << "# TYPE " << name << " histogram\n";
+    for (auto it = familyBegin; it != familyEnd; ++it)
+    {
+      const std::string& labels = it->first.second;
+      const PlusMetricHistogram& histogram = *(it->second);
+      // All buckets are listed with cumulative counts. The last bucket also stores values that are out of range,
+      // therefore it is only included in the +Inf bucket.
+      uint64_t cumulativeCount = 0;
+      for (int i = 0; i < PlusMetricHistogram::BUCKET_COUNT - 1; ++i)
+      {
+        cumulativeCount += histogram.GetBucketCount(i);
+        std::ostringstream le;
+        le << std::setprecision(9) << "le=\"" << PlusMetricHistogram::GetBucketUpperBoundNs(i) * 1e-9 << "\"";
+        os << name << "_bucket" << GetLabelString(labels, le.str()) << " " << cumulativeCount << "\n";
+      }
+      os << name << "_bucket" << GetLabelString(labels, "le=\"+Inf\"") << " " << histogram.GetCount() << "\n";
+      os << name << "_sum" << GetLabelString(labels) << " " << histogram.GetSumNs() * 1e-9 << "\n";
+      os << name << "_count" << GetLabelString(labels) << " " << histogram.GetCount() << "\n";
+    }
+
+    os << "# TYPE " << name << "_max gauge\n";
+    for (auto it = familyBegin; it != familyEnd; ++it)
+    {
+      os << name << "_max" << GetLabelString(it->first.second) << " " << it->second->GetMaxNs() * 1e-9 << "\n";
+    }
+
+    os << "# TYPE " << name << "_quantile gauge\n";
+    for (auto it = familyBegin; it != familyEnd; ++it)
+    {
+      for (int q = 0; q < 3; ++q)
+      {
+        std::ostringstream quantileLabel;
+        quantileLabel << "quantile=\"" << quantiles[q] << "\"";
+        os << name << "_quantile" << GetLabelString(it->first.second, quantileLabel.str()) << " " << it->second->GetPercentileNs(quantiles[q]) * 1e-9 << "\n";
+      }
+    }
+
+    familyBegin = familyEnd;
+  }
+
+  if (resetAfterExport)
+  {
+    this->ResetInternal();
+  }
+
+  return os.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusMetricsRegistry::WritePrometheusTextFile(const std::string& fileName)
+{
+  // Write to a temporary file first so that readers never see a partially written file
+  std::string tempFileName = fileName + ".tmp";
+  {
+    std::ofstream file(tempFileName.c_str(), std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+    {
+      LOG_ERROR("Failed to open metrics file for writing: " << tempFileName);
+      return PLUS_FAIL;
+    }
+    file << this->GetPrometheusText();
+  }
+  vtksys::SystemTools::RemoveFile(fileName);
+  if (!vtksys::SystemTools::RenameFile(tempFileName.c_str(), fileName.c_str()))
+  {
+    LOG_ERROR("Failed to rename metrics file " << tempFileName << " to " << fileName);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
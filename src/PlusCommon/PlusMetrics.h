@@ -0,0 +1,280 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusMetrics_h
+#define __PlusMetrics_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/*!
+  \class PlusMetricCounter
+  \brief Monotonically increasing lock-free counter
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusMetricCounter
+{
+public:
+  PlusMetricCounter() : Value(0) {}
+  void Add(uint64_t value = 1) { this->Value.fetch_add(value, std::memory_order_relaxed); }
+  uint64_t GetValue() const { return this->Value.load(std::memory_order_relaxed); }
+  void Reset() { this->Value.store(0, std::memory_order_relaxed); }
+
+protected:
+  std::atomic<uint64_t> Value;
+};
+
+/*!
+  \class PlusMetricGauge
+  \brief Lock-free gauge that stores the most recently set value
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusMetricGauge
+{
+public:
+  PlusMetricGauge() : Value(0) {}
+  void Set(double value) { this->Value.store(value, std::memory_order_relaxed); }
+  double GetValue() const { return this->Value.load(std::memory_order_relaxed); }
+  void Reset() { this->Value.store(0, std::memory_order_relaxed); }
+
+protected:
+  std::atomic<double> Value;
+};
+
+/*!
+  \class PlusMetricHistogram
+  \brief Lock-free latency histogram with logarithmic buckets (HDR histogram style)
+
+  Values are recorded in nanoseconds. Each power-of-two range is divided into 2^SUB_BUCKET_BITS
+  linear sub-buckets, therefore the relative error of the reported percentiles is below 1/2^SUB_BUCKET_BITS
+  (about 6%) over the whole range (1ns to about 18 minutes). Recording a value is a few integer operations
+  and two relaxed atomic increments.
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusMetricHistogram
+{
+public:
+  enum
+  {
+    SUB_BUCKET_BITS = 4,
+    SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS,
+    MAX_VALUE_BITS = 40,
+    BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT
+  };
+
+  PlusMetricHistogram();
+
+  /*! Record a value in nanoseconds */
+  void Record(uint64_t valueNs);
+
+  /*! Record a duration in seconds */
+  void RecordSec(double valueSec) { this->Record(valueSec > 0 ? static_cast<uint64_t>(valueSec * 1e9) : 0); }
+
+  uint64_t GetCount() const { return this->Count.load(std::memory_order_relaxed); }
+  uint64_t GetSumNs() const { return this->SumNs.load(std::memory_order_relaxed); }
+  uint64_t GetMaxNs() const { return this->MaxNs.load(std::memory_order_relaxed); }
+  uint64_t GetBucketCount(int bucketIndex) const { return this->Buckets[bucketIndex].load(std::memory_order_relaxed); }
+
+  /*! Get the value (in nanoseconds) below which the given fraction (0..1) of the recorded values fall */
+  uint64_t GetPercentileNs(double fraction) const;
+
+  void Reset();
+
+  /*! Index of the bucket that contains the value */
+  static int GetBucketIndex(uint64_t valueNs);
+  /*! Largest value (in nanoseconds) that is stored in the bucket */
+  static uint64_t GetBucketUpperBoundNs(int bucketIndex);
+
+protected:
+  std::atomic<uint64_t> Buckets[BUCKET_COUNT];
+  std::atomic<uint64_t> Count;
+  std::atomic<uint64_t> SumNs;
+  std::atomic<uint64_t> MaxNs;
+
+private:
+  PlusMetricHistogram(const PlusMetricHistogram&);
+  void operator=(const PlusMetricHistogram&);
+};
+
+/*!
+  \class PlusMetricsRegistry
+  \brief Process-wide registry of runtime performance metrics
+
+  Metrics are identified by a name and an optional label string in Prometheus syntax (e.g., device="VideoDevice").
+  Metric objects are never deleted while the process is running, therefore the returned pointers can be cached
+  by the callers. Collection is disabled by default; use the PLUS_METRIC_* macros for instrumentation so that
+  the only overhead in disabled state is a single relaxed atomic load. Per-device, per-channel, or per-client
+  metrics are distinguished by labels (e.g., MakeLabel("device", deviceId)).
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusMetricsRegistry
+{
+public:
+  static PlusMetricsRegistry* GetInstance();
+
+  static bool IsEnabled() { return Enabled.load(std::memory_order_relaxed); }
+  static void SetEnabled(bool enabled) { Enabled.store(enabled, std::memory_order_relaxed); }
+
+  PlusMetricCounter* GetCounter(const std::string& name, const std::string& labels = "");
+  PlusMetricGauge* GetGauge(const std::string& name, const std::string& labels = "");
+  PlusMetricHistogram* GetHistogram(const std::string& name, const std::string& labels = "");
+
+  /*! Get a counter, gauge, or histogram depending on the template parameter */
+  template <class MetricType> MetricType* GetMetric(const std::string& name, const std::string& labels);
+
+  /*! Create a label string in Prometheus syntax (name="value"), special characters of the value are escaped */
+  static std::string MakeLabel(const std::string& name, const std::string& value);
+
+  /*! Reset all registered metrics to zero */
+  void Reset();
+
+  /*!
+    Get all metrics in Prometheus text exposition format. Histogram values are reported in seconds.
+    The maximum and the 50th, 90th, 99th percentiles of each histogram are reported as separate gauges
+    (with _max and _quantile name suffix).
+    \param resetAfterExport Reset all metrics to zero right after the export
+  */
+  std::string GetPrometheusText(bool resetAfterExport = false);
+
+  /*! Write all metrics to a file in Prometheus text exposition format (written to a temporary file then renamed) */
+  PlusStatus WritePrometheusTextFile(const std::string& fileName);
+
+protected:
+  PlusMetricsRegistry();
+
+  /*! Reset all metrics, the mutex must be locked by the caller */
+  void ResetInternal();
+
+  typedef std::pair<std::string, std::string> MetricKey;
+  std::map<MetricKey, std::unique_ptr<PlusMetricCounter> > Counters;
+  std::map<MetricKey, std::unique_ptr<PlusMetricGauge> > Gauges;
+  std::map<MetricKey, std::unique_ptr<PlusMetricHistogram> > Histograms;
+  std::mutex Mutex;
+
+  static std::atomic<bool> Enabled;
+
+private:
+  PlusMetricsRegistry(const PlusMetricsRegistry&);
+  void operator=(const PlusMetricsRegistry&);
+};
+
+template <> inline PlusMetricCounter* PlusMetricsRegistry::GetMetric<PlusMetricCounter>(const std::string& name, const std::string& labels) { return this->GetCounter(name, labels); }
+template <> inline PlusMetricGauge* PlusMetricsRegistry::GetMetric<PlusMetricGauge>(const std::string& name, const std::string& labels) { return this->GetGauge(name, labels); }
+template <> inline PlusMetricHistogram* PlusMetricsRegistry::GetMetric<PlusMetricHistogram>(const std::string& name, const std::string& labels) { return this->GetHistogram(name, labels); }
+
+/*!
+  \class PlusMetricScopedTimer
+  \brief Records the lifetime of the object into a histogram (nothing is measured if the histogram is NULL)
+  \ingroup PlusLibCommon
+*/
+class PlusMetricScopedTimer
+{
+public:
+  explicit PlusMetricScopedTimer(PlusMetricHistogram* histogram)
+    : Histogram(histogram)
+  {
+    if (this->Histogram != NULL)
+    {
+      this->StartTime = std::chrono::steady_clock::now();
+    }
+  }
+  ~PlusMetricScopedTimer()
+  {
+    if (this->Histogram != NULL)
+    {
+      this->Histogram->Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->StartTime).count()));
+    }
+  }
+
+protected:
+  PlusMetricHistogram* Histogram;
+  std::chrono::steady_clock::time_point StartTime;
+};
+
+/*!
+  \class PlusMetricCallSiteCache
+  \brief Metric pointer cached at an instrumentation call site
+
+  Used by the PLUS_METRIC_* macros as a thread-local static variable. The registry is only looked up when
+  the label string differs from the one of the previous call in the same thread, which is rare, as each
+  device, channel, or client is usually processed by its own thread.
+  \ingroup PlusLibCommon
+*/
+template <class MetricType>
+class PlusMetricCallSiteCache
+{
+public:
+  PlusMetricCallSiteCache() : Metric(NULL) {}
+  MetricType* Get(const char* name, const std::string& labels)
+  {
+    if (this->Metric == NULL || this->Labels != labels)
+    {
+      this->Metric = PlusMetricsRegistry::GetInstance()->GetMetric<MetricType>(name, labels);
+      this->Labels = labels;
+    }
+    return this->Metric;
+  }
+
+protected:
+  std::string Labels;
+  MetricType* Metric;
+};
+
+//----------------------------------------------------------------------------
+// Instrumentation macros. Metric names must be constant at the call site. The labels argument is a string in
+// Prometheus syntax (see PlusMetricsRegistry::MakeLabel), empty string for process-wide metrics. The labels
+// expression is only evaluated if metrics collection is enabled.
+
+#define PLUS_METRIC_COUNTER_ADD(metricName, labels, value) \
+  do \
+  { \
+    if (PlusMetricsRegistry::IsEnabled()) \
+    { \
+      static thread_local PlusMetricCallSiteCache<PlusMetricCounter> plusMetricCache; \
+      plusMetricCache.Get(metricName, labels)->Add(value); \
+    } \
+  } while (0)
+
+#define PLUS_METRIC_GAUGE_SET(metricName, labels, value) \
+  do \
+  { \
+    if (PlusMetricsRegistry::IsEnabled()) \
+    { \
+      static thread_local PlusMetricCallSiteCache<PlusMetricGauge> plusMetricCache; \
+      plusMetricCache.Get(metricName, labels)->Set(value); \
+    } \
+  } while (0)
+
+#define PLUS_METRIC_HISTOGRAM_RECORD_SEC(metricName, labels, valueSec) \
+  do \
+  { \
+    if (PlusMetricsRegistry::IsEnabled()) \
+    { \
+      static thread_local PlusMetricCallSiteCache<PlusMetricHistogram> plusMetricCache; \
+      plusMetricCache.Get(metricName, labels)->RecordSec(valueSec); \
+    } \
+  } while (0)
+
+/*! Measure the time until the end of the current scope. Can be used only once per scope. */
+#define PLUS_METRIC_SCOPED_TIMER(metricName, labels) \
+  PlusMetricHistogram* plusMetricScopedHistogram = NULL; \
+  if (PlusMetricsRegistry::IsEnabled()) \
+  { \
+    static thread_local PlusMetricCallSiteCache<PlusMetricHistogram> plusMetricCache; \
+    plusMetricScopedHistogram = plusMetricCache.Get(metricName, labels); \
+  } \
+  PlusMetricScopedTimer plusMetricScopedTimer(plusMetricScopedHistogram)
+
+#endif //__PlusMetrics_h
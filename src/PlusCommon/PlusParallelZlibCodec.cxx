@@ -0,0 +1,721 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMetrics.h"
+#include "PlusParallelZlibCodec.h"
+
+// VTK includes
+#include <vtk_zlib.h>
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+  const uint64_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+  /*! zlib counts bytes in 32-bit integers, chunks must be smaller than this */
+  const uint64_t MAX_CHUNK_SIZE = 1 << 30;
+  const unsigned int ZLIB_HEADER_SIZE = 2;
+  const unsigned int ZLIB_TRAILER_SIZE = 4;
+  const unsigned int GZIP_HEADER_SIZE = 10;
+  const unsigned int GZIP_TRAILER_SIZE = 8;
+  const double BYTES_PER_MB = 1024.0 * 1024.0;
+
+  //----------------------------------------------------------------------------
+  unsigned int GetHeaderSize(PlusParallelZlibCodec::StreamFormat format)
+  {
+    return format == PlusParallelZlibCodec::FORMAT_ZLIB ? ZLIB_HEADER_SIZE : GZIP_HEADER_SIZE;
+  }
+
+  //----------------------------------------------------------------------------
+  unsigned int GetTrailerSize(PlusParallelZlibCodec::StreamFormat format)
+  {
+    return format == PlusParallelZlibCodec::FORMAT_ZLIB ? ZLIB_TRAILER_SIZE : GZIP_TRAILER_SIZE;
+  }
+
+  //----------------------------------------------------------------------------
+  uLong GetInitialChecksum(PlusParallelZlibCodec::StreamFormat format)
+  {
+    return format == PlusParallelZlibCodec::FORMAT_ZLIB ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0);
+  }
+
+  //----------------------------------------------------------------------------
+  uLong UpdateChecksum(PlusParallelZlibCodec::StreamFormat format, uLong checksum, const unsigned char* data, uint64_t size)
+  {
+    return format == PlusParallelZlibCodec::FORMAT_ZLIB ? adler32(checksum, data, static_cast<uInt>(size)) : crc32(checksum, data, static_cast<uInt>(size));
+  }
+
+  //----------------------------------------------------------------------------
+  uLong CombineChecksums(PlusParallelZlibCodec::StreamFormat format, uLong checksum1, uLong checksum2, uint64_t size2)
+  {
+    return format == PlusParallelZlibCodec::FORMAT_ZLIB ? adler32_combine(checksum1, checksum2, static_cast<z_off_t>(size2)) : crc32_combine(checksum1, checksum2, static_cast<z_off_t>(size2));
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteHeader(PlusParallelZlibCodec::StreamFormat format, int compressionLevel, std::ostream& output)
+  {
+    if (format == PlusParallelZlibCodec::FORMAT_ZLIB)
+    {
+      // deflate with 32k window; the second byte is the compression level hint with a matching check value
+      unsigned char header[ZLIB_HEADER_SIZE] = { 0x78, 0x9C };
+      if (compressionLevel >= 0 && compressionLevel < 2)
+      {
+        header[1] = 0x01;
+      }
+      else if (compressionLevel >= 2 && compressionLevel < 6)
+      {
+        header[1] = 0x5E;
+      }
+      else if (compressionLevel > 6)
+      {
+        header[1] = 0xDA;
+      }
+      output.write(reinterpret_cast<const char*>(header), sizeof(header));
+    }
+    else
+    {
+      // deflate, no flags, no modification time, unknown operating system
+      const unsigned char header[GZIP_HEADER_SIZE] = { 0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF };
+      output.write(reinterpret_cast<const char*>(header), sizeof(header));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteTrailer(PlusParallelZlibCodec::StreamFormat format, uLong checksum, uint64_t uncompressedSize, std::ostream& output)
+  {
+    unsigned char trailer[GZIP_TRAILER_SIZE] = { 0 };
+    if (format == PlusParallelZlibCodec::FORMAT_ZLIB)
+    {
+      // big endian Adler-32
+      for (int i = 0; i < 4; ++i)
+      {
+        trailer[i] = static_cast<unsigned char>((checksum >> (24 - 8 * i)) & 0xFF);
+      }
+    }
+    else
+    {
+      // little endian CRC-32 and uncompressed size modulo 2^32
+      for (int i = 0; i < 4; ++i)
+      {
+        trailer[i] = static_cast<unsigned char>((checksum >> (8 * i)) & 0xFF);
+        trailer[4 + i] = static_cast<unsigned char>((uncompressedSize >> (8 * i)) & 0xFF);
+      }
+    }
+    output.write(reinterpret_cast<const char*>(trailer), GetTrailerSize(format));
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Check that the stream starts with the header that WriteHeader writes (a header with optional gzip fields is not accepted) */
+  bool IsHeaderValid(PlusParallelZlibCodec::StreamFormat format, const unsigned char* stream, uint64_t streamSize)
+  {
+    if (streamSize < GetHeaderSize(format) + GetTrailerSize(format))
+    {
+      return false;
+    }
+    if (format == PlusParallelZlibCodec::FORMAT_ZLIB)
+    {
+      return (stream[0] & 0x0F) == Z_DEFLATED && (stream[1] & 0x20) == 0 && ((stream[0] << 8) + stream[1]) % 31 == 0;
+    }
+    return stream[0] == 0x1F && stream[1] == 0x8B && stream[2] == Z_DEFLATED && stream[3] == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  uLong ReadTrailerChecksum(PlusParallelZlibCodec::StreamFormat format, const unsigned char* trailer)
+  {
+    uLong checksum = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+      checksum |= static_cast<uLong>(trailer[i]) << (format == PlusParallelZlibCodec::FORMAT_ZLIB ? 24 - 8 * i : 8 * i);
+    }
+    return checksum;
+  }
+
+  //----------------------------------------------------------------------------
+  struct CompressionJob
+  {
+    std::vector<unsigned char> Input;
+    std::vector<unsigned char> Output;
+    uLong Checksum;
+    bool LastChunk;
+    bool Done;
+    bool Failed;
+    CompressionJob() : Checksum(0), LastChunk(false), Done(false), Failed(false) {}
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Compress the input of the job into a raw deflate stream that ends with a full flush (or the end of the stream for the last chunk) */
+  bool CompressChunk(z_stream& zStream, PlusParallelZlibCodec::StreamFormat format, CompressionJob& job)
+  {
+    if (deflateReset(&zStream) != Z_OK)
+    {
+      return false;
+    }
+    job.Checksum = UpdateChecksum(format, GetInitialChecksum(format), job.Input.empty() ? NULL : &job.Input[0], job.Input.size());
+
+    const int flush = job.LastChunk ? Z_FINISH : Z_FULL_FLUSH;
+    job.Output.resize(deflateBound(&zStream, static_cast<uLong>(job.Input.size())) + 64);
+    zStream.next_in = job.Input.empty() ? Z_NULL : &job.Input[0];
+    zStream.avail_in = static_cast<uInt>(job.Input.size());
+    uint64_t outputSize = 0;
+    while (true)
+    {
+      zStream.next_out = &job.Output[0] + outputSize;
+      zStream.avail_out = static_cast<uInt>(job.Output.size() - outputSize);
+      int result = deflate(&zStream, flush);
+      if (result == Z_STREAM_ERROR)
+      {
+        return false;
+      }
+      outputSize = job.Output.size() - zStream.avail_out;
+      if ((job.LastChunk && result == Z_STREAM_END) || (!job.LastChunk && zStream.avail_out != 0))
+      {
+        break;
+      }
+      job.Output.resize(job.Output.size() * 2);
+    }
+    job.Output.resize(static_cast<std::size_t>(outputSize));
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Inflate a chunk of a raw deflate stream, the chunk must produce exactly outputSize bytes */
+  bool DecompressChunk(z_stream& zStream, const unsigned char* input, uint64_t inputSize, unsigned char* output, uint64_t outputSize, bool lastChunk)
+  {
+    if (inflateReset(&zStream) != Z_OK)
+    {
+      return false;
+    }
+    zStream.next_in = const_cast<unsigned char*>(input);
+    zStream.avail_in = static_cast<uInt>(inputSize);
+    zStream.next_out = output;
+    zStream.avail_out = static_cast<uInt>(outputSize);
+    int result = inflate(&zStream, Z_SYNC_FLUSH);
+    if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+    {
+      return false;
+    }
+    if (zStream.avail_out != 0)
+    {
+      return false;
+    }
+    if (result != Z_STREAM_END && (zStream.avail_in > 0 || lastChunk))
+    {
+      // Output is complete, only the empty block that marks the end of the chunk (or the end of the stream) is left.
+      // It must not produce any output, which is checked by offering a single byte of output space.
+      unsigned char extraByte = 0;
+      zStream.next_out = &extraByte;
+      zStream.avail_out = 1;
+      result = inflate(&zStream, Z_SYNC_FLUSH);
+      if ((result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) || zStream.avail_out != 1)
+      {
+        return false;
+      }
+    }
+    return zStream.avail_in == 0 && (lastChunk ? result == Z_STREAM_END : result != Z_STREAM_END);
+  }
+}
+
+//----------------------------------------------------------------------------
+double PlusParallelZlibCodec::Statistics::GetCompressionRatio() const
+{
+  return this->CompressedSize > 0 ? static_cast<double>(this->UncompressedSize) / this->CompressedSize : 0.0;
+}
+
+//----------------------------------------------------------------------------
+double PlusParallelZlibCodec::Statistics::GetThroughputMBPerSec() const
+{
+  return this->ElapsedTimeSec > 0 ? this->UncompressedSize / BYTES_PER_MB / this->ElapsedTimeSec : 0.0;
+}
+
+//----------------------------------------------------------------------------
+PlusParallelZlibCodec::PlusParallelZlibCodec()
+  : CompressionLevel(Z_DEFAULT_COMPRESSION)
+  , ChunkSize(DEFAULT_CHUNK_SIZE)
+  , NumberOfThreads(0)
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusParallelZlibCodec::SetCompressionLevel(int compressionLevel)
+{
+  this->CompressionLevel = std::max(-1, std::min(9, compressionLevel));
+}
+
+//----------------------------------------------------------------------------
+int PlusParallelZlibCodec::GetCompressionLevel() const
+{
+  return this->CompressionLevel;
+}
+
+//----------------------------------------------------------------------------
+void PlusParallelZlibCodec::SetChunkSize(uint64_t chunkSize)
+{
+  this->ChunkSize = std::max<uint64_t>(1, std::min(MAX_CHUNK_SIZE, chunkSize));
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusParallelZlibCodec::GetChunkSize() const
+{
+  return this->ChunkSize;
+}
+
+//----------------------------------------------------------------------------
+void PlusParallelZlibCodec::SetNumberOfThreads(unsigned int numberOfThreads)
+{
+  this->NumberOfThreads = numberOfThreads;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusParallelZlibCodec::GetNumberOfThreads() const
+{
+  return this->NumberOfThreads;
+}
+
+//----------------------------------------------------------------------------
+const PlusParallelZlibCodec::Statistics& PlusParallelZlibCodec::GetLastStatistics() const
+{
+  return this->LastStatistics;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusParallelZlibCodec::GetNumberOfWorkerThreads(uint64_t numberOfChunks) const
+{
+  unsigned int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads == 0)
+  {
+    numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return static_cast<unsigned int>(std::max<uint64_t>(1, std::min<uint64_t>(numberOfThreads, numberOfChunks)));
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelZlibCodec::Compress(std::istream& input, uint64_t uncompressedSize, StreamFormat format, std::ostream& output, std::vector<uint64_t>* chunkStreamSizes /*=NULL*/)
+{
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  if (chunkStreamSizes != NULL)
+  {
+    chunkStreamSizes->clear();
+  }
+
+  const uint64_t numberOfChunks = std::max<uint64_t>(1, (uncompressedSize + this->ChunkSize - 1) / this->ChunkSize);
+  const unsigned int numberOfThreads = this->GetNumberOfWorkerThreads(numberOfChunks);
+
+  // Jobs are reused in a circular manner, this limits the number of chunks that are kept in memory
+  std::vector<CompressionJob> jobs(2 * numberOfThreads);
+  std::deque<CompressionJob*> queuedJobs;
+  std::mutex mutex;
+  std::condition_variable jobQueued;
+  std::condition_variable jobDone;
+  bool stopWorkers = false;
+
+  const int compressionLevel = this->CompressionLevel;
+  std::atomic<bool> workerInitFailed(false);
+  std::vector<std::thread> workers;
+  for (unsigned int i = 0; i < numberOfThreads; ++i)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      z_stream zStream;
+      memset(&zStream, 0, sizeof(zStream));
+      bool initialized = (deflateInit2(&zStream, compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+      if (!initialized)
+      {
+        workerInitFailed = true;
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true)
+      {
+        jobQueued.wait(lock, [&] { return stopWorkers || !queuedJobs.empty(); });
+        if (queuedJobs.empty())
+        {
+          break;
+        }
+        CompressionJob* job = queuedJobs.front();
+        queuedJobs.pop_front();
+        lock.unlock();
+        bool success = initialized && CompressChunk(zStream, format, *job);
+        lock.lock();
+        job->Failed = !success;
+        job->Done = true;
+        jobDone.notify_all();
+      }
+      lock.unlock();
+      if (initialized)
+      {
+        deflateEnd(&zStream);
+      }
+    }));
+  }
+
+  WriteHeader(format, compressionLevel, output);
+  uint64_t compressedSize = GetHeaderSize(format);
+  uLong checksum = GetInitialChecksum(format);
+
+  PlusStatus status = PLUS_SUCCESS;
+  uint64_t numberOfReadChunks = 0;
+  uint64_t numberOfWrittenChunks = 0;
+  while (numberOfWrittenChunks < numberOfChunks && status == PLUS_SUCCESS)
+  {
+    // Read chunks while there are free jobs
+    while (numberOfReadChunks < numberOfChunks && numberOfReadChunks - numberOfWrittenChunks < jobs.size())
+    {
+      CompressionJob& job = jobs[numberOfReadChunks % jobs.size()];
+      uint64_t chunkOffset = numberOfReadChunks * this->ChunkSize;
+      job.Input.resize(static_cast<std::size_t>(std::min(this->ChunkSize, uncompressedSize - chunkOffset)));
+      if (!job.Input.empty() && !input.read(reinterpret_cast<char*>(&job.Input[0]), static_cast<std::streamsize>(job.Input.size())))
+      {
+        LOG_ERROR("Failed to read data for compression at offset " << chunkOffset);
+        status = PLUS_FAIL;
+        break;
+      }
+      job.LastChunk = (numberOfReadChunks + 1 == numberOfChunks);
+      std::lock_guard<std::mutex> lock(mutex);
+      job.Done = false;
+      job.Failed = false;
+      queuedJobs.push_back(&job);
+      jobQueued.notify_one();
+      ++numberOfReadChunks;
+    }
+    if (status != PLUS_SUCCESS)
+    {
+      break;
+    }
+
+    // Write the next chunk when it is ready
+    CompressionJob& job = jobs[numberOfWrittenChunks % jobs.size()];
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobDone.wait(lock, [&] { return job.Done; });
+    }
+    if (job.Failed)
+    {
+      LOG_ERROR("Failed to compress data chunk " << numberOfWrittenChunks);
+      status = PLUS_FAIL;
+      break;
+    }
+    if (!job.Output.empty())
+    {
+      output.write(reinterpret_cast<const char*>(&job.Output[0]), static_cast<std::streamsize>(job.Output.size()));
+    }
+    checksum = CombineChecksums(format, checksum, job.Checksum, job.Input.size());
+    compressedSize += job.Output.size();
+    if (chunkStreamSizes != NULL)
+    {
+      chunkStreamSizes->push_back(job.Output.size());
+    }
+    ++numberOfWrittenChunks;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopWorkers = true;
+    queuedJobs.clear();
+  }
+  jobQueued.notify_all();
+  for (std::vector<std::thread>::iterator workerIt = workers.begin(); workerIt != workers.end(); ++workerIt)
+  {
+    workerIt->join();
+  }
+  if (workerInitFailed)
+  {
+    LOG_ERROR("Failed to initialize zlib compression");
+    status = PLUS_FAIL;
+  }
+  if (status != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  WriteTrailer(format, checksum, uncompressedSize, output);
+  compressedSize += GetTrailerSize(format);
+  if (!output)
+  {
+    LOG_ERROR("Failed to write compressed data");
+    return PLUS_FAIL;
+  }
+
+  this->LastStatistics.UncompressedSize = uncompressedSize;
+  this->LastStatistics.CompressedSize = compressedSize;
+  this->LastStatistics.ElapsedTimeSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  this->LastStatistics.NumberOfChunks = static_cast<unsigned int>(numberOfChunks);
+  this->LastStatistics.NumberOfThreads = numberOfThreads;
+  PLUS_METRIC_COUNTER_ADD("plus_compression_uncompressed_bytes_total", "", uncompressedSize);
+  PLUS_METRIC_COUNTER_ADD("plus_compression_compressed_bytes_total", "", compressedSize);
+  PLUS_METRIC_GAUGE_SET("plus_compression_throughput_mb_per_sec", "", this->LastStatistics.GetThroughputMBPerSec());
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelZlibCodec::Decompress(const unsigned char* stream, uint64_t streamSize, StreamFormat format, unsigned char* output, uint64_t uncompressedSize,
+    const std::vector<uint64_t>& chunkStreamSizes, uint64_t chunkSize)
+{
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  if (stream == NULL || (output == NULL && uncompressedSize > 0))
+  {
+    LOG_ERROR("PlusParallelZlibCodec::Decompress failed: invalid buffer");
+    return PLUS_FAIL;
+  }
+
+  unsigned int numberOfThreads = 1;
+  PlusStatus status = PLUS_FAIL;
+  if (!chunkStreamSizes.empty())
+  {
+    numberOfThreads = this->GetNumberOfWorkerThreads(chunkStreamSizes.size());
+    status = this->DecompressInParallel(stream, streamSize, format, output, uncompressedSize, chunkStreamSizes, chunkSize);
+    if (status != PLUS_SUCCESS)
+    {
+      LOG_DEBUG("Compressed data chunks do not match the chunk sizes, the data is decompressed by a single thread");
+      numberOfThreads = 1;
+    }
+  }
+  if (status != PLUS_SUCCESS)
+  {
+    status = this->DecompressSequentially(stream, streamSize, format, output, uncompressedSize);
+  }
+  if (status != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  this->LastStatistics.UncompressedSize = uncompressedSize;
+  this->LastStatistics.CompressedSize = streamSize;
+  this->LastStatistics.ElapsedTimeSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  this->LastStatistics.NumberOfChunks = static_cast<unsigned int>(std::max<std::size_t>(1, chunkStreamSizes.size()));
+  this->LastStatistics.NumberOfThreads = numberOfThreads;
+  PLUS_METRIC_COUNTER_ADD("plus_decompression_uncompressed_bytes_total", "", uncompressedSize);
+  PLUS_METRIC_GAUGE_SET("plus_decompression_throughput_mb_per_sec", "", this->LastStatistics.GetThroughputMBPerSec());
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelZlibCodec::DecompressInParallel(const unsigned char* stream, uint64_t streamSize, StreamFormat format, unsigned char* output, uint64_t uncompressedSize,
+    const std::vector<uint64_t>& chunkStreamSizes, uint64_t chunkSize)
+{
+  if (chunkSize == 0 || chunkSize > MAX_CHUNK_SIZE || !IsHeaderValid(format, stream, streamSize))
+  {
+    return PLUS_FAIL;
+  }
+  const uint64_t numberOfChunks = std::max<uint64_t>(1, (uncompressedSize + chunkSize - 1) / chunkSize);
+  if (chunkStreamSizes.size() != numberOfChunks)
+  {
+    return PLUS_FAIL;
+  }
+
+  uint64_t chunkStreamsSize = 0;
+  for (std::size_t i = 0; i < chunkStreamSizes.size(); ++i)
+  {
+    chunkStreamsSize += chunkStreamSizes[i];
+  }
+  if (GetHeaderSize(format) + chunkStreamsSize + GetTrailerSize(format) != streamSize)
+  {
+    return PLUS_FAIL;
+  }
+
+  std::vector<uint32_t> chunkChecksums;
+  if (this->InflateChunks(stream + GetHeaderSize(format), chunkStreamSizes, chunkSize, output, uncompressedSize, true, format, &chunkChecksums) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  uLong checksum = GetInitialChecksum(format);
+  for (uint64_t chunkIndex = 0; chunkIndex < numberOfChunks; ++chunkIndex)
+  {
+    checksum = CombineChecksums(format, checksum, chunkChecksums[chunkIndex], std::min(chunkSize, uncompressedSize - chunkIndex * chunkSize));
+  }
+  const unsigned char* trailer = stream + streamSize - GetTrailerSize(format);
+  if (ReadTrailerChecksum(format, trailer) != checksum)
+  {
+    LOG_DEBUG("Checksum of the decompressed data does not match the stream");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelZlibCodec::DecompressChunks(const unsigned char* chunkStreams, const std::vector<uint64_t>& chunkStreamSizes, uint64_t chunkSize,
+    unsigned char* output, uint64_t outputSize, bool lastChunkIncluded)
+{
+  if (chunkStreams == NULL || output == NULL || chunkStreamSizes.empty())
+  {
+    LOG_ERROR("PlusParallelZlibCodec::DecompressChunks failed: invalid buffer");
+    return PLUS_FAIL;
+  }
+  if (chunkSize == 0 || chunkSize > MAX_CHUNK_SIZE
+      || outputSize > chunkStreamSizes.size() * chunkSize || outputSize <= (chunkStreamSizes.size() - 1) * chunkSize
+      || (!lastChunkIncluded && outputSize != chunkStreamSizes.size() * chunkSize))
+  {
+    LOG_ERROR("PlusParallelZlibCodec::DecompressChunks failed: output size " << outputSize << " does not match " << chunkStreamSizes.size() << " chunks of " << chunkSize << " bytes");
+    return PLUS_FAIL;
+  }
+
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  if (this->InflateChunks(chunkStreams, chunkStreamSizes, chunkSize, output, outputSize, lastChunkIncluded, FORMAT_ZLIB, NULL) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("PlusParallelZlibCodec::DecompressChunks failed: invalid compressed data");
+    return PLUS_FAIL;
+  }
+
+  uint64_t chunkStreamsSize = 0;
+  for (std::size_t i = 0; i < chunkStreamSizes.size(); ++i)
+  {
+    chunkStreamsSize += chunkStreamSizes[i];
+  }
+  this->LastStatistics.UncompressedSize = outputSize;
+  this->LastStatistics.CompressedSize = chunkStreamsSize;
+  this->LastStatistics.ElapsedTimeSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  this->LastStatistics.NumberOfChunks = static_cast<unsigned int>(chunkStreamSizes.size());
+  this->LastStatistics.NumberOfThreads = this->GetNumberOfWorkerThreads(chunkStreamSizes.size());
+  PLUS_METRIC_COUNTER_ADD("plus_decompression_uncompressed_bytes_total", "", outputSize);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelZlibCodec::InflateChunks(const unsigned char* chunkStreams, const std::vector<uint64_t>& chunkStreamSizes, uint64_t chunkSize,
+    unsigned char* output, uint64_t outputSize, bool lastChunkIncluded, StreamFormat format, std::vector<uint32_t>* chunkChecksums)
+{
+  // Location of each chunk
+  const uint64_t numberOfChunks = chunkStreamSizes.size();
+  std::vector<uint64_t> chunkStreamOffsets(chunkStreamSizes.size());
+  uint64_t chunkStreamOffset = 0;
+  for (std::size_t i = 0; i < chunkStreamSizes.size(); ++i)
+  {
+    if (chunkStreamSizes[i] > MAX_CHUNK_SIZE * 2)
+    {
+      return PLUS_FAIL;
+    }
+    chunkStreamOffsets[i] = chunkStreamOffset;
+    chunkStreamOffset += chunkStreamSizes[i];
+  }
+  if (chunkChecksums != NULL)
+  {
+    chunkChecksums->assign(chunkStreamSizes.size(), 0);
+  }
+
+  std::atomic<uint64_t> nextChunkIndex(0);
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> workers;
+  const unsigned int numberOfThreads = this->GetNumberOfWorkerThreads(numberOfChunks);
+  for (unsigned int i = 0; i < numberOfThreads; ++i)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      z_stream zStream;
+      memset(&zStream, 0, sizeof(zStream));
+      if (inflateInit2(&zStream, -MAX_WBITS) != Z_OK)
+      {
+        failed = true;
+        return;
+      }
+      for (uint64_t chunkIndex = nextChunkIndex++; chunkIndex < numberOfChunks && !failed; chunkIndex = nextChunkIndex++)
+      {
+        unsigned char* chunkOutput = output + chunkIndex * chunkSize;
+        uint64_t chunkOutputSize = std::min(chunkSize, outputSize - chunkIndex * chunkSize);
+        if (!DecompressChunk(zStream, chunkStreams + chunkStreamOffsets[chunkIndex], chunkStreamSizes[chunkIndex], chunkOutput, chunkOutputSize,
+                             lastChunkIncluded && chunkIndex + 1 == numberOfChunks))
+        {
+          failed = true;
+          break;
+        }
+        if (chunkChecksums != NULL)
+        {
+          (*chunkChecksums)[chunkIndex] = static_cast<uint32_t>(UpdateChecksum(format, GetInitialChecksum(format), chunkOutput, chunkOutputSize));
+        }
+      }
+      inflateEnd(&zStream);
+    }));
+  }
+  for (std::vector<std::thread>::iterator workerIt = workers.begin(); workerIt != workers.end(); ++workerIt)
+  {
+    workerIt->join();
+  }
+  return failed ? PLUS_FAIL : PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusParallelZlibCodec::GetStreamHeaderSize(StreamFormat format)
+{
+  return GetHeaderSize(format);
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusParallelZlibCodec::GetStreamTrailerSize(StreamFormat format)
+{
+  return GetTrailerSize(format);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelZlibCodec::DecompressSequentially(const unsigned char* stream, uint64_t streamSize, StreamFormat format, unsigned char* output, uint64_t uncompressedSize)
+{
+  z_stream zStream;
+  memset(&zStream, 0, sizeof(zStream));
+  if (inflateInit2(&zStream, format == FORMAT_ZLIB ? MAX_WBITS : MAX_WBITS + 16) != Z_OK)
+  {
+    LOG_ERROR("Failed to initialize zlib decompression");
+    return PLUS_FAIL;
+  }
+
+  uint64_t inputOffset = 0;
+  uint64_t outputOffset = 0;
+  int result = Z_OK;
+  unsigned char extraByte = 0;
+  while (result == Z_OK)
+  {
+    // zlib counts bytes in 32-bit integers, large buffers are passed in pieces
+    if (zStream.avail_in == 0)
+    {
+      zStream.next_in = const_cast<unsigned char*>(stream) + inputOffset;
+      zStream.avail_in = static_cast<uInt>(std::min(MAX_CHUNK_SIZE, streamSize - inputOffset));
+      inputOffset += zStream.avail_in;
+    }
+    if (outputOffset < uncompressedSize)
+    {
+      zStream.next_out = output + outputOffset;
+      zStream.avail_out = static_cast<uInt>(std::min(MAX_CHUNK_SIZE, uncompressedSize - outputOffset));
+    }
+    else
+    {
+      // Output is complete, only the end of the stream is expected
+      zStream.next_out = &extraByte;
+      zStream.avail_out = 1;
+    }
+    uInt availableOutput = zStream.avail_out;
+    result = inflate(&zStream, Z_NO_FLUSH);
+    uint64_t producedOutput = availableOutput - zStream.avail_out;
+    if (outputOffset >= uncompressedSize && producedOutput > 0)
+    {
+      LOG_ERROR("Decompressed data is larger than the expected " << uncompressedSize << " bytes");
+      inflateEnd(&zStream);
+      return PLUS_FAIL;
+    }
+    outputOffset += producedOutput;
+    if (result == Z_BUF_ERROR && zStream.avail_in == 0 && inputOffset < streamSize)
+    {
+      result = Z_OK;
+    }
+  }
+  const char* errorMessage = zStream.msg;
+  inflateEnd(&zStream);
+
+  if (result != Z_STREAM_END)
+  {
+    LOG_ERROR("Failed to decompress data: " << (errorMessage != NULL ? errorMessage : "incomplete or invalid stream"));
+    return PLUS_FAIL;
+  }
+  if (outputOffset != uncompressedSize)
+  {
+    LOG_ERROR("Decompressed data size (" << outputOffset << " bytes) does not match the expected size (" << uncompressedSize << " bytes)");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
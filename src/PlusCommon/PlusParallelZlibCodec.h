@@ -0,0 +1,127 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusParallelZlibCodec_h
+#define __PlusParallelZlibCodec_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+// STL includes
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+/*!
+  \class PlusParallelZlibCodec
+  \brief Multi-threaded deflate compression and decompression of large buffers
+
+  The input is split into chunks of equal size (except the last one) that are compressed independently by a pool of
+  worker threads. Each chunk is a raw deflate stream that ends with a full flush, therefore the concatenated chunks form
+  one valid deflate stream. The stream is wrapped in a zlib (RFC 1950) or gzip (RFC 1952) header and trailer, with the
+  checksum combined from the checksums of the chunks, so the output can be read by any zlib-compatible reader.
+
+  The compressed size of each chunk is returned by Compress. If these sizes are passed to Decompress then the chunks
+  are decompressed in parallel, otherwise (or if the chunk sizes do not match the stream) the stream is decompressed
+  by a single thread.
+
+  Compression ratio and throughput of the last operation are available in GetLastStatistics().
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusParallelZlibCodec
+{
+public:
+  enum StreamFormat
+  {
+    FORMAT_ZLIB,
+    FORMAT_GZIP
+  };
+
+  struct Statistics
+  {
+    uint64_t UncompressedSize;
+    uint64_t CompressedSize;
+    double ElapsedTimeSec;
+    unsigned int NumberOfChunks;
+    unsigned int NumberOfThreads;
+    Statistics() : UncompressedSize(0), CompressedSize(0), ElapsedTimeSec(0), NumberOfChunks(0), NumberOfThreads(0) {}
+    /*! Uncompressed size divided by compressed size */
+    double GetCompressionRatio() const;
+    /*! Uncompressed megabytes (2^20 bytes) processed per second */
+    double GetThroughputMBPerSec() const;
+  };
+
+  PlusParallelZlibCodec();
+
+  /*! Compression level (0-9), -1 means the zlib default level */
+  void SetCompressionLevel(int compressionLevel);
+  int GetCompressionLevel() const;
+
+  /*! Uncompressed size of the chunks in bytes */
+  void SetChunkSize(uint64_t chunkSize);
+  uint64_t GetChunkSize() const;
+
+  /*! Number of worker threads. 0 means the number of processor cores. */
+  void SetNumberOfThreads(unsigned int numberOfThreads);
+  unsigned int GetNumberOfThreads() const;
+
+  /*!
+    Compress data read from the input stream and write the compressed stream to the output.
+    Reading and writing is done by the calling thread while the chunks are compressed by the worker threads,
+    at most two chunks per thread are kept in memory.
+    \param uncompressedSize Number of bytes to read from the input
+    \param chunkStreamSizes Optional output, compressed size of each chunk (without the stream header and trailer)
+  */
+  PlusStatus Compress(std::istream& input, uint64_t uncompressedSize, StreamFormat format, std::ostream& output, std::vector<uint64_t>* chunkStreamSizes = NULL);
+
+  /*!
+    Decompress a complete zlib or gzip stream into a buffer
+    \param uncompressedSize Size of the output buffer, the uncompressed data must have exactly this size
+    \param chunkStreamSizes Compressed size of each chunk as returned by Compress. If empty then the stream is decompressed by a single thread.
+    \param chunkSize Uncompressed size of the chunks that was used for compression
+  */
+  PlusStatus Decompress(const unsigned char* stream, uint64_t streamSize, StreamFormat format, unsigned char* output, uint64_t uncompressedSize,
+                        const std::vector<uint64_t>& chunkStreamSizes, uint64_t chunkSize);
+
+  /*!
+    Decompress consecutive chunks of a stream that was compressed by Compress, without decompressing the rest of the stream.
+    The checksum in the stream trailer covers the whole data, therefore it is not verified.
+    \param chunkStreams Compressed data of the chunks (located after the stream header and the preceding chunks)
+    \param chunkStreamSizes Compressed size of each chunk to decompress
+    \param chunkSize Uncompressed size of the chunks that was used for compression
+    \param outputSize Size of the output buffer. It is less than the size of all the chunks if the last chunk of the stream is included.
+    \param lastChunkIncluded True if the last of the decompressed chunks is the last chunk of the stream
+  */
+  PlusStatus DecompressChunks(const unsigned char* chunkStreams, const std::vector<uint64_t>& chunkStreamSizes, uint64_t chunkSize,
+                              unsigned char* output, uint64_t outputSize, bool lastChunkIncluded);
+
+  /*! Size of the header that precedes the first chunk in the stream */
+  static unsigned int GetStreamHeaderSize(StreamFormat format);
+  /*! Size of the trailer that follows the last chunk in the stream */
+  static unsigned int GetStreamTrailerSize(StreamFormat format);
+
+  const Statistics& GetLastStatistics() const;
+
+protected:
+  unsigned int GetNumberOfWorkerThreads(uint64_t numberOfChunks) const;
+
+  /*! Decompress chunks by the worker threads. If chunkChecksums is not NULL then the checksum of each decompressed chunk is computed, too. */
+  PlusStatus InflateChunks(const unsigned char* chunkStreams, const std::vector<uint64_t>& chunkStreamSizes, uint64_t chunkSize,
+                           unsigned char* output, uint64_t outputSize, bool lastChunkIncluded, StreamFormat format, std::vector<uint32_t>* chunkChecksums);
+
+  PlusStatus DecompressInParallel(const unsigned char* stream, uint64_t streamSize, StreamFormat format, unsigned char* output, uint64_t uncompressedSize,
+                                  const std::vector<uint64_t>& chunkStreamSizes, uint64_t chunkSize);
+  PlusStatus DecompressSequentially(const unsigned char* stream, uint64_t streamSize, StreamFormat format, unsigned char* output, uint64_t uncompressedSize);
+
+  int CompressionLevel;
+  uint64_t ChunkSize;
+  unsigned int NumberOfThreads;
+  Statistics LastStatistics;
+};
+
+#endif //__PlusParallelZlibCodec_h
@@ -0,0 +1,352 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusMetricsTest.cxx
+  \brief Test the metrics registry and the Prometheus text export
+
+  Checks the histogram bucket layout (bucket index and upper bound on bucket edges and for out of range values),
+  the percentile estimate, counter and gauge updates from several threads, and the exact Prometheus text output
+  including the escaping of label values.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusMetrics.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const int NUMBER_OF_THREADS = 4;
+  const int NUMBER_OF_UPDATES_PER_THREAD = 10000;
+
+  //----------------------------------------------------------------------------
+  int TestBucketLayout()
+  {
+    int numberOfErrors(0);
+
+    // Small values have their own bucket
+    for (uint64_t value = 0; value < PlusMetricHistogram::SUB_BUCKET_COUNT; ++value)
+    {
+      if (PlusMetricHistogram::GetBucketIndex(value) != static_cast<int>(value)
+          || PlusMetricHistogram::GetBucketUpperBoundNs(static_cast<int>(value)) != value)
+      {
+        LOG_ERROR("Value " << value << " is not stored in its own bucket: bucket index " << PlusMetricHistogram::GetBucketIndex(value));
+        numberOfErrors++;
+      }
+    }
+
+    // Bucket edges: the upper bound is the last value of the bucket, the next value starts the next bucket
+    const uint64_t expectedBuckets[][3] = { /* value, bucket index, upper bound of the bucket */
+      { 16, 16, 16 }, { 17, 17, 17 }, { 31, 31, 31 }, { 32, 32, 33 }, { 33, 32, 33 }, { 34, 33, 35 }, { 63, 47, 63 },
+      { 64, 48, 67 }, { 1000, 111, 1023 }, { 1023, 111, 1023 }, { 1024, 112, 1087 }
+    };
+    for (size_t i = 0; i < sizeof(expectedBuckets) / sizeof(expectedBuckets[0]); ++i)
+    {
+      int bucketIndex = PlusMetricHistogram::GetBucketIndex(expectedBuckets[i][0]);
+      if (bucketIndex != static_cast<int>(expectedBuckets[i][1]) || PlusMetricHistogram::GetBucketUpperBoundNs(bucketIndex) != expectedBuckets[i][2])
+      {
+        LOG_ERROR("Value " << expectedBuckets[i][0] << " is stored in bucket " << bucketIndex << " (upper bound " << PlusMetricHistogram::GetBucketUpperBoundNs(bucketIndex)
+                  << "), expected bucket " << expectedBuckets[i][1] << " (upper bound " << expectedBuckets[i][2] << ")");
+        numberOfErrors++;
+      }
+    }
+
+    for (int bucketIndex = 0; bucketIndex < PlusMetricHistogram::BUCKET_COUNT - 1; ++bucketIndex)
+    {
+      uint64_t upperBound = PlusMetricHistogram::GetBucketUpperBoundNs(bucketIndex);
+      if (PlusMetricHistogram::GetBucketIndex(upperBound) != bucketIndex || PlusMetricHistogram::GetBucketIndex(upperBound + 1) != bucketIndex + 1)
+      {
+        LOG_ERROR("Upper bound " << upperBound << " of bucket " << bucketIndex << " is not on the bucket edge");
+        numberOfErrors++;
+      }
+      // The relative bucket width is limited by the number of sub-buckets
+      uint64_t lowerBound = (bucketIndex == 0 ? 0 : PlusMetricHistogram::GetBucketUpperBoundNs(bucketIndex - 1) + 1);
+      if ((upperBound - lowerBound + 1) * PlusMetricHistogram::SUB_BUCKET_COUNT > lowerBound + PlusMetricHistogram::SUB_BUCKET_COUNT)
+      {
+        LOG_ERROR("Bucket " << bucketIndex << " is too wide: " << lowerBound << " - " << upperBound);
+        numberOfErrors++;
+      }
+    }
+
+    // Out of range values are stored in the last bucket
+    const uint64_t maxValueInRange = (static_cast<uint64_t>(1) << PlusMetricHistogram::MAX_VALUE_BITS) - 1;
+    if (PlusMetricHistogram::GetBucketUpperBoundNs(PlusMetricHistogram::BUCKET_COUNT - 1) != maxValueInRange)
+    {
+      LOG_ERROR("Upper bound of the last bucket is " << PlusMetricHistogram::GetBucketUpperBoundNs(PlusMetricHistogram::BUCKET_COUNT - 1) << ", expected " << maxValueInRange);
+      numberOfErrors++;
+    }
+    const uint64_t outOfRangeValues[] = { maxValueInRange + 1, maxValueInRange * 1000, std::numeric_limits<uint64_t>::max() };
+    for (size_t i = 0; i < sizeof(outOfRangeValues) / sizeof(outOfRangeValues[0]); ++i)
+    {
+      if (PlusMetricHistogram::GetBucketIndex(outOfRangeValues[i]) != PlusMetricHistogram::BUCKET_COUNT - 1)
+      {
+        LOG_ERROR("Out of range value " << outOfRangeValues[i] << " is stored in bucket " << PlusMetricHistogram::GetBucketIndex(outOfRangeValues[i]));
+        numberOfErrors++;
+      }
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestPercentile()
+  {
+    int numberOfErrors(0);
+
+    PlusMetricHistogram histogram;
+    if (histogram.GetPercentileNs(0.5) != 0)
+    {
+      LOG_ERROR("Percentile of an empty histogram is " << histogram.GetPercentileNs(0.5) << ", expected 0");
+      numberOfErrors++;
+    }
+
+    // Values 1..1000, the n-th percentile is n*10
+    const uint64_t numberOfValues = 1000;
+    for (uint64_t value = 1; value <= numberOfValues; ++value)
+    {
+      histogram.Record(value);
+    }
+    if (histogram.GetCount() != numberOfValues || histogram.GetSumNs() != numberOfValues * (numberOfValues + 1) / 2 || histogram.GetMaxNs() != numberOfValues)
+    {
+      LOG_ERROR("Unexpected histogram statistics: count " << histogram.GetCount() << ", sum " << histogram.GetSumNs() << ", max " << histogram.GetMaxNs());
+      numberOfErrors++;
+    }
+
+    const double fractions[] = { 0.0, 0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 1.0 };
+    for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); ++i)
+    {
+      uint64_t exactValue = std::max<uint64_t>(1, static_cast<uint64_t>(fractions[i] * numberOfValues + 0.5));
+      // The estimate is the upper bound of the bucket of the exact value, but never more than the maximum
+      uint64_t expectedValue = std::min(PlusMetricHistogram::GetBucketUpperBoundNs(PlusMetricHistogram::GetBucketIndex(exactValue)), numberOfValues);
+      uint64_t estimatedValue = histogram.GetPercentileNs(fractions[i]);
+      if (estimatedValue != expectedValue || estimatedValue < exactValue || estimatedValue > exactValue + exactValue / PlusMetricHistogram::SUB_BUCKET_COUNT)
+      {
+        LOG_ERROR("Percentile " << fractions[i] << " is " << estimatedValue << ", expected " << expectedValue << " (exact value " << exactValue << ")");
+        numberOfErrors++;
+      }
+    }
+
+    histogram.Reset();
+    if (histogram.GetCount() != 0 || histogram.GetSumNs() != 0 || histogram.GetMaxNs() != 0 || histogram.GetPercentileNs(0.5) != 0)
+    {
+      LOG_ERROR("Histogram is not empty after reset");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestConcurrentUpdates()
+  {
+    int numberOfErrors(0);
+
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    registry->Reset();
+    PlusMetricCounter* counter = registry->GetCounter("plus_test_concurrent_total");
+    PlusMetricGauge* gauge = registry->GetGauge("plus_test_concurrent");
+    PlusMetricHistogram* histogram = registry->GetHistogram("plus_test_concurrent_seconds");
+
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < NUMBER_OF_THREADS; ++threadIndex)
+    {
+      threads.push_back(std::thread([registry, threadIndex]()
+      {
+        for (int i = 0; i < NUMBER_OF_UPDATES_PER_THREAD; ++i)
+        {
+          // Metrics are looked up in every iteration so that the registry is accessed concurrently as well
+          registry->GetCounter("plus_test_concurrent_total")->Add(2);
+          registry->GetGauge("plus_test_concurrent")->Set(threadIndex);
+          registry->GetHistogram("plus_test_concurrent_seconds")->Record(static_cast<uint64_t>(i));
+        }
+      }));
+    }
+    for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+    {
+      threadIt->join();
+    }
+
+    const uint64_t numberOfUpdates = static_cast<uint64_t>(NUMBER_OF_THREADS) * NUMBER_OF_UPDATES_PER_THREAD;
+    if (counter->GetValue() != 2 * numberOfUpdates)
+    {
+      LOG_ERROR("Counter value is " << counter->GetValue() << ", expected " << 2 * numberOfUpdates);
+      numberOfErrors++;
+    }
+    if (gauge->GetValue() < 0 || gauge->GetValue() >= NUMBER_OF_THREADS || gauge->GetValue() != static_cast<int>(gauge->GetValue()))
+    {
+      LOG_ERROR("Gauge value " << gauge->GetValue() << " was not set by any of the threads");
+      numberOfErrors++;
+    }
+    uint64_t expectedSum = NUMBER_OF_THREADS * (static_cast<uint64_t>(NUMBER_OF_UPDATES_PER_THREAD) * (NUMBER_OF_UPDATES_PER_THREAD - 1) / 2);
+    if (histogram->GetCount() != numberOfUpdates || histogram->GetSumNs() != expectedSum || histogram->GetMaxNs() != NUMBER_OF_UPDATES_PER_THREAD - 1)
+    {
+      LOG_ERROR("Unexpected histogram statistics: count " << histogram->GetCount() << ", sum " << histogram->GetSumNs() << ", max " << histogram->GetMaxNs());
+      numberOfErrors++;
+    }
+    uint64_t bucketCountSum(0);
+    for (int bucketIndex = 0; bucketIndex < PlusMetricHistogram::BUCKET_COUNT; ++bucketIndex)
+    {
+      bucketCountSum += histogram->GetBucketCount(bucketIndex);
+    }
+    if (bucketCountSum != numberOfUpdates)
+    {
+      LOG_ERROR("Sum of the bucket counts is " << bucketCountSum << ", expected " << numberOfUpdates);
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestPrometheusText()
+  {
+    int numberOfErrors(0);
+
+    std::string escapedLabel = PlusMetricsRegistry::MakeLabel("device", "Video\"1\\\n");
+    if (escapedLabel != "device=\"Video\\\"1\\\\\\n\"")
+    {
+      LOG_ERROR("Label is not escaped correctly: " << escapedLabel);
+      numberOfErrors++;
+    }
+
+    // The registry is a singleton, start from a known state
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    registry->Reset();
+    bool wasEnabled = PlusMetricsRegistry::IsEnabled();
+    PlusMetricsRegistry::SetEnabled(true);
+    PLUS_METRIC_COUNTER_ADD("plus_test_frames_total", escapedLabel, 40);
+    PLUS_METRIC_COUNTER_ADD("plus_test_frames_total", "", 3);
+    PLUS_METRIC_GAUGE_SET("plus_test_rate", PlusMetricsRegistry::MakeLabel("channel", "A"), 2.5);
+    for (int i = 0; i < 5; ++i)
+    {
+      registry->GetHistogram("plus_test_latency_seconds")->Record(1000);
+    }
+    PlusMetricsRegistry::SetEnabled(wasEnabled);
+
+    std::string text = registry->GetPrometheusText(true);
+
+    // Counters and gauges of the previous test are reset but still registered
+    const std::string expectedSimpleMetrics =
+      "# TYPE plus_test_concurrent_total counter\n"
+      "plus_test_concurrent_total 0\n"
+      "# TYPE plus_test_frames_total counter\n"
+      "plus_test_frames_total 3\n"
+      "plus_test_frames_total{device=\"Video\\\"1\\\\\\n\"} 40\n"
+      "# TYPE plus_test_concurrent gauge\n"
+      "plus_test_concurrent 0\n"
+      "# TYPE plus_test_rate gauge\n"
+      "plus_test_rate{channel=\"A\"} 2.5\n";
+    if (text.compare(0, expectedSimpleMetrics.size(), expectedSimpleMetrics) != 0)
+    {
+      LOG_ERROR("Unexpected counters and gauges in the Prometheus text:\n" << text.substr(0, expectedSimpleMetrics.size()) << "\nexpected:\n" << expectedSimpleMetrics);
+      numberOfErrors++;
+    }
+
+    // Each histogram has a line for each bucket (except the last one, which is only included in +Inf)
+    const int numberOfLinesPerHistogram = PlusMetricHistogram::BUCKET_COUNT - 1 + 3;
+    std::vector<std::string> lines;
+    std::istringstream textStream(text);
+    for (std::string line; std::getline(textStream, line);)
+    {
+      lines.push_back(line);
+    }
+    const size_t numberOfSimpleMetricLines = 9;
+    const size_t expectedNumberOfLines = numberOfSimpleMetricLines + 2 * (1 + numberOfLinesPerHistogram + 2 + 4);
+    if (lines.size() != expectedNumberOfLines)
+    {
+      LOG_ERROR("Prometheus text has " << lines.size() << " lines, expected " << expectedNumberOfLines);
+      numberOfErrors++;
+    }
+
+    // The values recorded in the histogram are all in the bucket of 1000ns, which ends at 1023ns
+    const std::string expectedHistogramLines[] =
+    {
+      "# TYPE plus_test_latency_seconds histogram",
+      "plus_test_latency_seconds_bucket{le=\"0\"} 0",
+      "plus_test_latency_seconds_bucket{le=\"9.91e-07\"} 0",
+      "plus_test_latency_seconds_bucket{le=\"1.023e-06\"} 5",
+      "plus_test_latency_seconds_bucket{le=\"1.087e-06\"} 5",
+      "plus_test_latency_seconds_bucket{le=\"549.755814\"} 5",
+      "plus_test_latency_seconds_bucket{le=\"+Inf\"} 5",
+      "plus_test_latency_seconds_sum 5e-06",
+      "plus_test_latency_seconds_count 5",
+      "# TYPE plus_test_latency_seconds_max gauge",
+      "plus_test_latency_seconds_max 1e-06",
+      "# TYPE plus_test_latency_seconds_quantile gauge",
+      "plus_test_latency_seconds_quantile{quantile=\"0.5\"} 1e-06",
+      "plus_test_latency_seconds_quantile{quantile=\"0.9\"} 1e-06",
+      "plus_test_latency_seconds_quantile{quantile=\"0.99\"} 1e-06"
+    };
+    size_t searchStartPos = expectedSimpleMetrics.size();
+    for (size_t i = 0; i < sizeof(expectedHistogramLines) / sizeof(expectedHistogramLines[0]); ++i)
+    {
+      size_t linePos = text.find("\n" + expectedHistogramLines[i] + "\n", searchStartPos - 1);
+      if (linePos == std::string::npos)
+      {
+        LOG_ERROR("Line is not found in the Prometheus text (or not in the expected order): " << expectedHistogramLines[i]);
+        numberOfErrors++;
+        continue;
+      }
+      searchStartPos = linePos + 1;
+    }
+
+    // All metrics are reset after the export
+    if (registry->GetCounter("plus_test_frames_total", escapedLabel)->GetValue() != 0 || registry->GetGauge("plus_test_rate", "channel=\"A\"")->GetValue() != 0
+        || registry->GetHistogram("plus_test_latency_seconds")->GetCount() != 0)
+    {
+      LOG_ERROR("Metrics are not reset after the export");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  numberOfErrors += TestBucketLayout();
+  numberOfErrors += TestPercentile();
+  numberOfErrors += TestConcurrentUpdates();
+  numberOfErrors += TestPrometheusText();
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,323 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusParallelZlibCodecTest.cxx
+  \brief Test the multi-threaded zlib and gzip compression and decompression
+
+  Checks compression and decompression round trips at the chunk boundaries for both stream formats, that the compressed
+  stream can be read by plain zlib, the decompression of a range of chunks from the middle of a stream, and that the
+  data is decompressed by a single thread if the chunk sizes do not match the stream.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusParallelZlibCodec.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+// VTK includes
+#include <vtk_zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const uint64_t CHUNK_SIZE = 1000;
+  const unsigned int NUMBER_OF_THREADS = 4;
+
+  //----------------------------------------------------------------------------
+  /*! Partially compressible test data: runs of repeated values alternate with pseudo-random bytes */
+  std::vector<unsigned char> CreateTestData(uint64_t size)
+  {
+    std::vector<unsigned char> data(size);
+    uint32_t randomState = 12345;
+    for (uint64_t i = 0; i < size; ++i)
+    {
+      randomState = randomState * 1103515245 + 12345;
+      data[i] = ((i / 100) % 2 == 0) ? static_cast<unsigned char>(i / 100) : static_cast<unsigned char>(randomState >> 16);
+    }
+    return data;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetFormatName(PlusParallelZlibCodec::StreamFormat format)
+  {
+    return format == PlusParallelZlibCodec::FORMAT_ZLIB ? "zlib" : "gzip";
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompressData(const std::vector<unsigned char>& data, PlusParallelZlibCodec::StreamFormat format, std::string& stream, std::vector<uint64_t>& chunkStreamSizes)
+  {
+    PlusParallelZlibCodec codec;
+    codec.SetChunkSize(CHUNK_SIZE);
+    codec.SetNumberOfThreads(NUMBER_OF_THREADS);
+    std::istringstream input(std::string(data.begin(), data.end()));
+    std::ostringstream output;
+    chunkStreamSizes.clear();
+    if (codec.Compress(input, data.size(), format, output, &chunkStreamSizes) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    stream = output.str();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Decompress the stream with plain zlib, without using the chunk information */
+  PlusStatus DecompressWithZlib(const std::string& stream, PlusParallelZlibCodec::StreamFormat format, std::vector<unsigned char>& output)
+  {
+    // One extra byte to detect if the decompressed data is longer than expected
+    std::vector<unsigned char> buffer(output.size() + 1);
+    uLongf decompressedSize = static_cast<uLongf>(buffer.size());
+    if (format == PlusParallelZlibCodec::FORMAT_ZLIB)
+    {
+      if (uncompress(&buffer[0], &decompressedSize, reinterpret_cast<const Bytef*>(stream.data()), static_cast<uLong>(stream.size())) != Z_OK)
+      {
+        return PLUS_FAIL;
+      }
+    }
+    else
+    {
+      z_stream zStream;
+      memset(&zStream, 0, sizeof(zStream));
+      if (inflateInit2(&zStream, MAX_WBITS + 16) != Z_OK)
+      {
+        return PLUS_FAIL;
+      }
+      zStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(stream.data()));
+      zStream.avail_in = static_cast<uInt>(stream.size());
+      zStream.next_out = &buffer[0];
+      zStream.avail_out = static_cast<uInt>(buffer.size());
+      int result = inflate(&zStream, Z_FINISH);
+      decompressedSize = zStream.total_out;
+      inflateEnd(&zStream);
+      if (result != Z_STREAM_END)
+      {
+        return PLUS_FAIL;
+      }
+    }
+    if (decompressedSize != output.size())
+    {
+      return PLUS_FAIL;
+    }
+    std::copy(buffer.begin(), buffer.begin() + decompressedSize, output.begin());
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestRoundTrip(PlusParallelZlibCodec::StreamFormat format, uint64_t size)
+  {
+    int numberOfErrors(0);
+    std::vector<unsigned char> data = CreateTestData(size);
+    std::string stream;
+    std::vector<uint64_t> chunkStreamSizes;
+    if (CompressData(data, format, stream, chunkStreamSizes) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to compress " << size << " bytes into a " << GetFormatName(format) << " stream");
+      return 1;
+    }
+
+    const uint64_t expectedNumberOfChunks = std::max<uint64_t>(1, (size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    uint64_t chunkStreamsSize = 0;
+    for (size_t i = 0; i < chunkStreamSizes.size(); ++i)
+    {
+      chunkStreamsSize += chunkStreamSizes[i];
+    }
+    if (chunkStreamSizes.size() != expectedNumberOfChunks
+        || PlusParallelZlibCodec::GetStreamHeaderSize(format) + chunkStreamsSize + PlusParallelZlibCodec::GetStreamTrailerSize(format) != stream.size())
+    {
+      LOG_ERROR("Chunks of the " << GetFormatName(format) << " stream of " << size << " bytes are invalid: " << chunkStreamSizes.size() << " chunks (expected "
+                << expectedNumberOfChunks << "), " << chunkStreamsSize << " compressed bytes in the chunks, stream size: " << stream.size());
+      numberOfErrors++;
+    }
+
+    PlusParallelZlibCodec codec;
+    codec.SetNumberOfThreads(NUMBER_OF_THREADS);
+
+    // Parallel decompression (one extra byte so that the buffer is valid for empty data as well)
+    std::vector<unsigned char> decompressed(size + 1, 0);
+    if (codec.Decompress(reinterpret_cast<const unsigned char*>(stream.data()), stream.size(), format, &decompressed[0], size, chunkStreamSizes, CHUNK_SIZE) != PLUS_SUCCESS
+        || !std::equal(data.begin(), data.end(), decompressed.begin()))
+    {
+      LOG_ERROR("Parallel decompression of the " << GetFormatName(format) << " stream of " << size << " bytes failed");
+      numberOfErrors++;
+    }
+    else if (codec.GetLastStatistics().NumberOfChunks != expectedNumberOfChunks)
+    {
+      LOG_ERROR("Parallel decompression of the " << GetFormatName(format) << " stream of " << size << " bytes processed " << codec.GetLastStatistics().NumberOfChunks
+                << " chunks, expected " << expectedNumberOfChunks);
+      numberOfErrors++;
+    }
+
+    // Decompression by a single thread
+    std::fill(decompressed.begin(), decompressed.end(), 0);
+    if (codec.Decompress(reinterpret_cast<const unsigned char*>(stream.data()), stream.size(), format, &decompressed[0], size, std::vector<uint64_t>(), CHUNK_SIZE) != PLUS_SUCCESS
+        || !std::equal(data.begin(), data.end(), decompressed.begin()))
+    {
+      LOG_ERROR("Sequential decompression of the " << GetFormatName(format) << " stream of " << size << " bytes failed");
+      numberOfErrors++;
+    }
+
+    // Any zlib-compatible reader can decompress the stream
+    std::vector<unsigned char> zlibDecompressed(size);
+    if (DecompressWithZlib(stream, format, zlibDecompressed) != PLUS_SUCCESS || zlibDecompressed != data)
+    {
+      LOG_ERROR("Decompression of the " << GetFormatName(format) << " stream of " << size << " bytes by zlib failed");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestDecompressChunks()
+  {
+    int numberOfErrors(0);
+    const uint64_t size = 10 * CHUNK_SIZE + 17;
+    std::vector<unsigned char> data = CreateTestData(size);
+    std::string stream;
+    std::vector<uint64_t> chunkStreamSizes;
+    if (CompressData(data, PlusParallelZlibCodec::FORMAT_ZLIB, stream, chunkStreamSizes) != PLUS_SUCCESS || chunkStreamSizes.size() != 11)
+    {
+      LOG_ERROR("Failed to compress data for the chunk decompression test");
+      return 1;
+    }
+
+    // Compressed data of each chunk is located after the stream header and the preceding chunks
+    std::vector<uint64_t> chunkStreamOffsets(1, PlusParallelZlibCodec::GetStreamHeaderSize(PlusParallelZlibCodec::FORMAT_ZLIB));
+    for (size_t i = 0; i < chunkStreamSizes.size(); ++i)
+    {
+      chunkStreamOffsets.push_back(chunkStreamOffsets.back() + chunkStreamSizes[i]);
+    }
+
+    PlusParallelZlibCodec codec;
+    codec.SetNumberOfThreads(NUMBER_OF_THREADS);
+    const size_t ranges[][2] = { /* first chunk, number of chunks */
+      { 3, 4 }, { 5, 1 }, { 9, 2 }, { 10, 1 }
+    };
+    for (size_t rangeIndex = 0; rangeIndex < sizeof(ranges) / sizeof(ranges[0]); ++rangeIndex)
+    {
+      const size_t firstChunk = ranges[rangeIndex][0];
+      const size_t numberOfChunks = ranges[rangeIndex][1];
+      const bool lastChunkIncluded = (firstChunk + numberOfChunks == chunkStreamSizes.size());
+      const uint64_t outputSize = std::min<uint64_t>(numberOfChunks * CHUNK_SIZE, size - firstChunk * CHUNK_SIZE);
+      std::vector<uint64_t> rangeChunkStreamSizes(chunkStreamSizes.begin() + firstChunk, chunkStreamSizes.begin() + firstChunk + numberOfChunks);
+      std::vector<unsigned char> output(outputSize, 0);
+      if (codec.DecompressChunks(reinterpret_cast<const unsigned char*>(stream.data()) + chunkStreamOffsets[firstChunk], rangeChunkStreamSizes, CHUNK_SIZE,
+                                 &output[0], outputSize, lastChunkIncluded) != PLUS_SUCCESS
+          || !std::equal(output.begin(), output.end(), data.begin() + firstChunk * CHUNK_SIZE))
+      {
+        LOG_ERROR("Decompression of chunks " << firstChunk << "-" << firstChunk + numberOfChunks - 1 << " failed");
+        numberOfErrors++;
+      }
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestSequentialFallback(PlusParallelZlibCodec::StreamFormat format)
+  {
+    int numberOfErrors(0);
+    const uint64_t size = 5 * CHUNK_SIZE + 300;
+    std::vector<unsigned char> data = CreateTestData(size);
+    std::string stream;
+    std::vector<uint64_t> chunkStreamSizes;
+    if (CompressData(data, format, stream, chunkStreamSizes) != PLUS_SUCCESS || chunkStreamSizes.size() != 6)
+    {
+      LOG_ERROR("Failed to compress data for the sequential decompression test");
+      return 1;
+    }
+
+    // The total size is correct, but the chunk boundaries are not
+    std::vector<uint64_t> shiftedChunkStreamSizes = chunkStreamSizes;
+    shiftedChunkStreamSizes[1] += 1;
+    shiftedChunkStreamSizes[2] -= 1;
+    std::vector<uint64_t> missingChunkStreamSizes(chunkStreamSizes.begin(), chunkStreamSizes.end() - 1);
+
+    struct WrongChunkInfo
+    {
+      const char* Description;
+      const std::vector<uint64_t>* ChunkStreamSizes;
+      uint64_t ChunkSize;
+    };
+    const WrongChunkInfo wrongChunkInfos[] =
+    {
+      { "shifted chunk boundaries", &shiftedChunkStreamSizes, CHUNK_SIZE },
+      { "missing chunk", &missingChunkStreamSizes, CHUNK_SIZE },
+      { "wrong chunk size", &chunkStreamSizes, 2 * CHUNK_SIZE }
+    };
+    PlusParallelZlibCodec codec;
+    codec.SetNumberOfThreads(NUMBER_OF_THREADS);
+    for (size_t i = 0; i < sizeof(wrongChunkInfos) / sizeof(wrongChunkInfos[0]); ++i)
+    {
+      std::vector<unsigned char> decompressed(size, 0);
+      if (codec.Decompress(reinterpret_cast<const unsigned char*>(stream.data()), stream.size(), format, &decompressed[0], size,
+                           *wrongChunkInfos[i].ChunkStreamSizes, wrongChunkInfos[i].ChunkSize) != PLUS_SUCCESS
+          || decompressed != data)
+      {
+        LOG_ERROR("Decompression of the " << GetFormatName(format) << " stream with " << wrongChunkInfos[i].Description << " failed");
+        numberOfErrors++;
+      }
+      else if (codec.GetLastStatistics().NumberOfThreads != 1)
+      {
+        LOG_ERROR("The " << GetFormatName(format) << " stream with " << wrongChunkInfos[i].Description << " is decompressed by "
+                  << codec.GetLastStatistics().NumberOfThreads << " threads, expected sequential decompression");
+        numberOfErrors++;
+      }
+    }
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  const PlusParallelZlibCodec::StreamFormat formats[] = { PlusParallelZlibCodec::FORMAT_ZLIB, PlusParallelZlibCodec::FORMAT_GZIP };
+  const uint64_t sizes[] = { 0, 1, CHUNK_SIZE - 1, CHUNK_SIZE, CHUNK_SIZE + 1 };
+  for (size_t formatIndex = 0; formatIndex < sizeof(formats) / sizeof(formats[0]); ++formatIndex)
+  {
+    for (size_t sizeIndex = 0; sizeIndex < sizeof(sizes) / sizeof(sizes[0]); ++sizeIndex)
+    {
+      numberOfErrors += TestRoundTrip(formats[formatIndex], sizes[sizeIndex]);
+    }
+    numberOfErrors += TestSequentialFallback(formats[formatIndex]);
+  }
+  numberOfErrors += TestDecompressChunks();
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
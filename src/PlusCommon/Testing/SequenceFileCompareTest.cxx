@@ -0,0 +1,179 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file SequenceFileCompareTest.cxx
+  \brief Compare the frames of two sequence files
+
+  Unlike a byte-by-byte comparison of the files, the result does not depend on the file format, compression and
+  header layout: the number of frames, the timestamps, the frame fields, and the pixel data of each frame are compared.
+  Used for checking that different ways of writing the same sequence (e.g., in-memory and chunked editing,
+  serial and parallel compression) produce the same frames.
+*/
+
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+  const double TIMESTAMP_TOLERANCE_SEC = 1e-6;
+
+  //----------------------------------------------------------------------------
+  int CompareFrameFields(igsioTrackedFrame* frame, igsioTrackedFrame* baselineFrame, unsigned int frameIndex, const std::vector<std::string>& ignoredFieldNames)
+  {
+    int numberOfErrors(0);
+    igsioFieldMapType fields = frame->GetFrameFields();
+    igsioFieldMapType baselineFields = baselineFrame->GetFrameFields();
+    for (igsioFieldMapType::iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+    {
+      if (std::find(ignoredFieldNames.begin(), ignoredFieldNames.end(), fieldIt->first) != ignoredFieldNames.end())
+      {
+        continue;
+      }
+      igsioFieldMapType::iterator baselineFieldIt = baselineFields.find(fieldIt->first);
+      if (baselineFieldIt == baselineFields.end())
+      {
+        LOG_ERROR("Frame " << frameIndex << ": field " << fieldIt->first << " is not in the baseline frame");
+        numberOfErrors++;
+      }
+      else if (fieldIt->second.second != baselineFieldIt->second.second)
+      {
+        LOG_ERROR("Frame " << frameIndex << ": field " << fieldIt->first << " value is '" << fieldIt->second.second << "', expected '" << baselineFieldIt->second.second << "'");
+        numberOfErrors++;
+      }
+    }
+    for (igsioFieldMapType::iterator baselineFieldIt = baselineFields.begin(); baselineFieldIt != baselineFields.end(); ++baselineFieldIt)
+    {
+      if (fields.find(baselineFieldIt->first) == fields.end()
+          && std::find(ignoredFieldNames.begin(), ignoredFieldNames.end(), baselineFieldIt->first) == ignoredFieldNames.end())
+      {
+        LOG_ERROR("Frame " << frameIndex << ": baseline field " << baselineFieldIt->first << " is missing");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareImageData(igsioTrackedFrame* frame, igsioTrackedFrame* baselineFrame, unsigned int frameIndex)
+  {
+    igsioVideoFrame* image = frame->GetImageData();
+    igsioVideoFrame* baselineImage = baselineFrame->GetImageData();
+    if (image->IsImageValid() != baselineImage->IsImageValid())
+    {
+      LOG_ERROR("Frame " << frameIndex << ": image data is " << (image->IsImageValid() ? "present" : "missing") << ", expected "
+                << (baselineImage->IsImageValid() ? "present" : "missing"));
+      return 1;
+    }
+    if (!image->IsImageValid())
+    {
+      return 0;
+    }
+
+    FrameSizeType frameSize = { 0, 0, 0 };
+    FrameSizeType baselineFrameSize = { 0, 0, 0 };
+    image->GetFrameSize(frameSize);
+    baselineImage->GetFrameSize(baselineFrameSize);
+    if (frameSize != baselineFrameSize || image->GetVTKScalarPixelType() != baselineImage->GetVTKScalarPixelType()
+        || image->GetFrameSizeInBytes() != baselineImage->GetFrameSizeInBytes())
+    {
+      LOG_ERROR("Frame " << frameIndex << ": image size is " << frameSize[0] << "x" << frameSize[1] << "x" << frameSize[2] << " (" << image->GetFrameSizeInBytes()
+                << " bytes), expected " << baselineFrameSize[0] << "x" << baselineFrameSize[1] << "x" << baselineFrameSize[2] << " (" << baselineImage->GetFrameSizeInBytes() << " bytes)");
+      return 1;
+    }
+    if (memcmp(image->GetScalarPointer(), baselineImage->GetScalarPointer(), image->GetFrameSizeInBytes()) != 0)
+    {
+      LOG_ERROR("Frame " << frameIndex << ": pixel data does not match the baseline");
+      return 1;
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string seqFileName;
+  std::string baselineSeqFileName;
+  std::vector<std::string> ignoredFieldNames;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &seqFileName, "Sequence file to check");
+  args.AddArgument("--baseline-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &baselineSeqFileName, "Sequence file that contains the expected frames");
+  args.AddArgument("--ignored-frame-fields", vtksys::CommandLineArguments::MULTI_ARGUMENT, &ignoredFieldNames, "Names of frame fields that are not compared");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (seqFileName.empty() || baselineSeqFileName.empty())
+  {
+    std::cerr << "Both --seq-file and --baseline-seq-file are required" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(seqFileName, frameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read sequence file: " << seqFileName);
+    return EXIT_FAILURE;
+  }
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> baselineFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(baselineSeqFileName, baselineFrameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read baseline sequence file: " << baselineSeqFileName);
+    return EXIT_FAILURE;
+  }
+
+  if (frameList->GetNumberOfTrackedFrames() != baselineFrameList->GetNumberOfTrackedFrames())
+  {
+    LOG_ERROR("Sequence contains " << frameList->GetNumberOfTrackedFrames() << " frames, expected " << baselineFrameList->GetNumberOfTrackedFrames());
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors(0);
+  for (unsigned int i = 0; i < frameList->GetNumberOfTrackedFrames(); ++i)
+  {
+    igsioTrackedFrame* frame = frameList->GetTrackedFrame(i);
+    igsioTrackedFrame* baselineFrame = baselineFrameList->GetTrackedFrame(i);
+    if (fabs(frame->GetTimestamp() - baselineFrame->GetTimestamp()) > TIMESTAMP_TOLERANCE_SEC)
+    {
+      LOG_ERROR("Frame " << i << ": timestamp is " << frame->GetTimestamp() << ", expected " << baselineFrame->GetTimestamp());
+      numberOfErrors++;
+    }
+    numberOfErrors += CompareFrameFields(frame, baselineFrame, i, ignoredFieldNames);
+    numberOfErrors += CompareImageData(frame, baselineFrame, i);
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully: " << frameList->GetNumberOfTrackedFrames() << " frames match");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,260 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusLoggerAsyncTest.cxx
+  \brief Test the asynchronous logging backend of vtkPlusLogger
+
+  Several threads log messages while asynchronous logging is enabled. After FlushAsyncLog the binary log file is read
+  back and checked: the file header and the record fields must match the documented format, the messages of each
+  thread must be in the order they were logged, and every message must be either written or reported as dropped.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusLogger.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const int NUMBER_OF_THREADS = 4;
+  /*! Much more than the ring buffer of a thread can hold, so that some messages are likely dropped */
+  const int NUMBER_OF_MESSAGES_PER_THREAD = 20000;
+  const char BINARY_LOG_MAGIC[8] = { 'P', 'L', 'U', 'S', 'L', 'O', 'G', '1' };
+  const char DROPPED_MESSAGE_SUFFIX[] = " log messages were dropped";
+
+  struct BinaryLogRecord
+  {
+    double Timestamp;
+    uint64_t ThreadId;
+    int32_t Level;
+    int32_t LineNumber;
+    std::string FileName;
+    std::string Message;
+  };
+
+  //----------------------------------------------------------------------------
+  template<class T> bool ReadValue(std::ifstream& file, T& value)
+  {
+    file.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return file.gcount() == sizeof(value);
+  }
+
+  //----------------------------------------------------------------------------
+  bool ReadString(std::ifstream& file, uint32_t length, std::string& value)
+  {
+    value.resize(length);
+    if (length == 0)
+    {
+      return true;
+    }
+    file.read(&value[0], length);
+    return file.gcount() == static_cast<std::streamsize>(length);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ReadBinaryLog(const std::string& fileName, std::vector<BinaryLogRecord>& records)
+  {
+    std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+      LOG_ERROR("Failed to open binary log file: " << fileName);
+      return PLUS_FAIL;
+    }
+    char magic[sizeof(BINARY_LOG_MAGIC)] = { 0 };
+    file.read(magic, sizeof(magic));
+    if (file.gcount() != sizeof(magic) || memcmp(magic, BINARY_LOG_MAGIC, sizeof(magic)) != 0)
+    {
+      LOG_ERROR("Binary log file does not start with the expected file header: " << fileName);
+      return PLUS_FAIL;
+    }
+    while (file.peek() != std::ifstream::traits_type::eof())
+    {
+      BinaryLogRecord record;
+      uint32_t fileNameLength(0);
+      uint32_t messageLength(0);
+      if (!ReadValue(file, record.Timestamp) || !ReadValue(file, record.ThreadId) || !ReadValue(file, record.Level) || !ReadValue(file, record.LineNumber)
+          || !ReadValue(file, fileNameLength) || !ReadValue(file, messageLength)
+          || !ReadString(file, fileNameLength, record.FileName) || !ReadString(file, messageLength, record.Message))
+      {
+        LOG_ERROR("Binary log file is truncated after " << records.size() << " records: " << fileName);
+        return PLUS_FAIL;
+      }
+      records.push_back(record);
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  void LogMessages(int threadIndex, int lineNumber)
+  {
+    for (int messageIndex = 0; messageIndex < NUMBER_OF_MESSAGES_PER_THREAD; ++messageIndex)
+    {
+      std::ostringstream message;
+      message << threadIndex << " " << messageIndex;
+      // Trace level, so that the messages only go to the binary log unless the test runs with --verbose=5
+      vtkPlusLogger::LogMessageAsync(vtkIGSIOLogger::LOG_LEVEL_TRACE, message.str(), __FILE__, lineNumber);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+int TestAsyncLogging(const std::string& binaryLogFileName)
+{
+  int numberOfErrors(0);
+
+  if (!vtkPlusLogger::SetBinaryLogFileName(binaryLogFileName))
+  {
+    LOG_ERROR("Failed to open binary log file: " << binaryLogFileName);
+    return 1;
+  }
+  vtkPlusLogger::SetAsyncLoggingEnabled(true);
+
+  const int logLineNumber = __LINE__;
+  std::vector<std::thread> threads;
+  for (int threadIndex = 0; threadIndex < NUMBER_OF_THREADS; ++threadIndex)
+  {
+    threads.push_back(std::thread(&LogMessages, threadIndex, logLineNumber));
+  }
+  for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+
+  // All messages that were logged before the flush must be in the binary log after the flush, while the sink is still running
+  vtkPlusLogger::FlushAsyncLog();
+  vtkPlusLogger::SetBinaryLogFileName("");
+  vtkPlusLogger::SetAsyncLoggingEnabled(false);
+
+  std::vector<BinaryLogRecord> records;
+  if (ReadBinaryLog(binaryLogFileName, records) != PLUS_SUCCESS)
+  {
+    return numberOfErrors + 1;
+  }
+
+  std::map<int, int> lastMessageIndex;
+  std::map<int, double> lastTimestamp;
+  std::map<int, uint64_t> threadIds;
+  uint64_t numberOfWrittenMessages(0);
+  uint64_t numberOfDroppedMessages(0);
+  for (std::vector<BinaryLogRecord>::iterator recordIt = records.begin(); recordIt != records.end(); ++recordIt)
+  {
+    size_t droppedSuffixPos = recordIt->Message.find(DROPPED_MESSAGE_SUFFIX);
+    if (droppedSuffixPos != std::string::npos)
+    {
+      // Drop report of the sink
+      uint64_t numberOfDroppedMessagesInReport(0);
+      std::istringstream(recordIt->Message.substr(0, droppedSuffixPos)) >> numberOfDroppedMessagesInReport;
+      if (recordIt->Level != vtkIGSIOLogger::LOG_LEVEL_WARNING || numberOfDroppedMessagesInReport == 0)
+      {
+        LOG_ERROR("Invalid drop report in the binary log (level " << recordIt->Level << "): " << recordIt->Message);
+        numberOfErrors++;
+      }
+      numberOfDroppedMessages += numberOfDroppedMessagesInReport;
+      continue;
+    }
+
+    int threadIndex(-1);
+    int messageIndex(-1);
+    std::istringstream(recordIt->Message) >> threadIndex >> messageIndex;
+    if (threadIndex < 0 || threadIndex >= NUMBER_OF_THREADS || messageIndex < 0 || messageIndex >= NUMBER_OF_MESSAGES_PER_THREAD)
+    {
+      LOG_ERROR("Unexpected message in the binary log: " << recordIt->Message);
+      numberOfErrors++;
+      continue;
+    }
+    numberOfWrittenMessages++;
+
+    if (recordIt->Level != vtkIGSIOLogger::LOG_LEVEL_TRACE || recordIt->LineNumber != logLineNumber || recordIt->FileName != __FILE__)
+    {
+      LOG_ERROR("Unexpected record fields in the binary log: level " << recordIt->Level << ", location " << recordIt->FileName << "(" << recordIt->LineNumber << ")");
+      numberOfErrors++;
+    }
+    if (threadIds.find(threadIndex) == threadIds.end())
+    {
+      threadIds[threadIndex] = recordIt->ThreadId;
+    }
+    else if (threadIds[threadIndex] != recordIt->ThreadId)
+    {
+      LOG_ERROR("Messages of thread " << threadIndex << " have different thread IDs in the binary log");
+      numberOfErrors++;
+    }
+
+    // Messages of a thread must be written in the order they were logged
+    if (lastMessageIndex.find(threadIndex) != lastMessageIndex.end()
+        && (messageIndex <= lastMessageIndex[threadIndex] || recordIt->Timestamp < lastTimestamp[threadIndex]))
+    {
+      LOG_ERROR("Message " << messageIndex << " of thread " << threadIndex << " is written after message " << lastMessageIndex[threadIndex]);
+      numberOfErrors++;
+    }
+    lastMessageIndex[threadIndex] = messageIndex;
+    lastTimestamp[threadIndex] = recordIt->Timestamp;
+  }
+
+  for (std::map<int, uint64_t>::iterator threadIt = threadIds.begin(); threadIt != threadIds.end(); ++threadIt)
+  {
+    for (std::map<int, uint64_t>::iterator otherThreadIt = threadIds.begin(); otherThreadIt != threadIt; ++otherThreadIt)
+    {
+      if (threadIt->second == otherThreadIt->second)
+      {
+        LOG_ERROR("Threads " << otherThreadIt->first << " and " << threadIt->first << " have the same thread ID in the binary log");
+        numberOfErrors++;
+      }
+    }
+  }
+
+  // Every message is either written or reported as dropped
+  uint64_t numberOfLoggedMessages = static_cast<uint64_t>(NUMBER_OF_THREADS) * NUMBER_OF_MESSAGES_PER_THREAD;
+  if (numberOfWrittenMessages + numberOfDroppedMessages != numberOfLoggedMessages)
+  {
+    LOG_ERROR("Logged " << numberOfLoggedMessages << " messages, but " << numberOfWrittenMessages << " are written and " << numberOfDroppedMessages << " are reported as dropped");
+    numberOfErrors++;
+  }
+  LOG_INFO("Logged " << numberOfLoggedMessages << " messages, " << numberOfWrittenMessages << " written, " << numberOfDroppedMessages << " dropped");
+
+  return numberOfErrors;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = TestAsyncLogging(vtkPlusConfig::GetInstance()->GetOutputPath("vtkPlusLoggerAsyncTest.bin"));
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
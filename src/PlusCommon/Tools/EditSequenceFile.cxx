@@ -9,6 +9,9 @@ See License.txt for details.
 #include "PlusMath.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
+#include "vtkIGSIOMetaImageSequenceIO.h"
+#include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
 
@@ -22,6 +25,11 @@ See License.txt for details.
 #include <vtksys/CommandLineArguments.hxx>
 #include <vtksys/RegularExpression.hxx>
 
+// STL includes
+#include <algorithm>
+#include <future>
+#include <thread>
+
 enum OperationType
 {
   UPDATE_FRAME_FIELD_NAME,
@@ -52,6 +60,8 @@ public:
     FrameScalarDecimalDigits = 5;
     FrameTransformStart = NULL;
     FrameTransformIncrement = NULL;
+    FrameValuesInitialized = false;
+    FrameScalarCurrent = 0;
   }
 
   std::string               FieldName;
@@ -64,6 +74,109 @@ public:
   vtkMatrix4x4*             FrameTransformStart;
   vtkMatrix4x4*             FrameTransformIncrement;
   std::string               FrameTransformIndexFieldName;
+
+  // Values for the next frame. They are kept between calls, so that the frames can be updated in multiple chunks.
+  bool                          FrameValuesInitialized;
+  double                        FrameScalarCurrent;
+  vtkSmartPointer<vtkTransform> FrameTransformCurrent;
+};
+
+// Copies frame fields from the frame of an additional sequence that is the closest in time to the master frame.
+// Master frames must be passed in increasing timestamp order.
+class FrameFieldMixer
+{
+public:
+  FrameFieldMixer(vtkIGSIOTrackedFrameList* additionalTrackedFrameList)
+    : AdditionalTrackedFrameList(additionalTrackedFrameList)
+    , AdditionalFrameIndex(0)
+    , MaxTimestampValueForCurrentAdditionalFrame(0)
+  {
+    if (AdditionalTrackedFrameList->GetNumberOfTrackedFrames() >= 1)
+    {
+      MaxTimestampValueForCurrentAdditionalFrame = AdditionalTrackedFrameList->GetTrackedFrame(0)->GetTimestamp();
+    }
+    if (AdditionalTrackedFrameList->GetNumberOfTrackedFrames() >= 2)
+    {
+      MaxTimestampValueForCurrentAdditionalFrame = (AdditionalTrackedFrameList->GetTrackedFrame(1)->GetTimestamp() + AdditionalTrackedFrameList->GetTrackedFrame(0)->GetTimestamp()) / 2.0;
+    }
+  }
+
+  void MixFrame(igsioTrackedFrame* masterTrackedFrame)
+  {
+    if (AdditionalTrackedFrameList->GetNumberOfTrackedFrames() == 0)
+    {
+      return;
+    }
+
+    // Determine which additional frame belongs to this master frame
+    while (masterTrackedFrame->GetTimestamp() > MaxTimestampValueForCurrentAdditionalFrame
+           && AdditionalFrameIndex + 1 < AdditionalTrackedFrameList->GetNumberOfTrackedFrames())
+    {
+      AdditionalFrameIndex++;
+      // use this frame index until timestamp is closest to this frame's timestamp
+      if (AdditionalFrameIndex + 1 < AdditionalTrackedFrameList->GetNumberOfTrackedFrames())
+      {
+        MaxTimestampValueForCurrentAdditionalFrame = (AdditionalTrackedFrameList->GetTrackedFrame(AdditionalFrameIndex)->GetTimestamp() +
+            AdditionalTrackedFrameList->GetTrackedFrame(AdditionalFrameIndex + 1)->GetTimestamp()) / 2.0;
+      }
+    }
+
+    // Copy frame fields
+    igsioTrackedFrame* additionalFrame = AdditionalTrackedFrameList->GetTrackedFrame(AdditionalFrameIndex);
+    auto customFrameFields = additionalFrame->GetCustomFields();
+    for (auto fieldIter = customFrameFields.begin(); fieldIter != customFrameFields.end(); ++fieldIter)
+    {
+      if (!fieldIter->first.compare("FrameNumber") ||
+          !fieldIter->first.compare("Timestamp") ||
+          !fieldIter->first.compare("UnfilteredTimestamp") ||
+          !fieldIter->first.compare("ImageStatus"))
+      {
+        // Timing and image information is taken from the first sequence
+        continue;
+      }
+      masterTrackedFrame->SetFrameField(fieldIter->first, fieldIter->second.second, fieldIter->second.first);
+    }
+  }
+
+protected:
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> AdditionalTrackedFrameList;
+  unsigned int AdditionalFrameIndex;
+  double MaxTimestampValueForCurrentAdditionalFrame;
+};
+
+// Parameters of the requested operation
+class SequenceEdit
+{
+public:
+  SequenceEdit()
+  {
+    Operation = NO_OPERATION;
+    FirstFrameIndex = 0;
+    LastFrameIndex = 0;
+    DecimationFactor = 2;
+    FillGrayLevel = 0;
+    CropFlipInfo.hFlip = false;
+    CropFlipInfo.vFlip = false;
+    CropFlipInfo.eFlip = false;
+  }
+
+  OperationType                       Operation;
+  unsigned int                        FirstFrameIndex;
+  unsigned int                        LastFrameIndex;
+  unsigned int                        DecimationFactor;
+  std::string                         FieldName;
+  std::string                         UpdatedFieldName;
+  std::string                         UpdatedFieldValue;
+  FrameFieldUpdate                    FieldUpdate;
+  std::vector<std::string>            TransformNamesToAdd;
+  vtkSmartPointer<vtkXMLDataElement>  DeviceSetConfiguration;
+  std::vector<unsigned int>           FillRectOrigin;
+  std::vector<unsigned int>           FillRectSize;
+  int                                 FillGrayLevel;
+  igsioVideoFrame::FlipInfoType       CropFlipInfo;
+  std::vector<int>                    CropRectOrigin;
+  std::vector<int>                    CropRectSize;
+  std::string                         UpdatedReferenceTransformName;
 };
 
 PlusStatus TrimSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int firstFrameIndex, unsigned int lastFrameIndex);
@@ -71,14 +184,50 @@ PlusStatus DecimateSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, unsi
 PlusStatus UpdateFrameFieldValue(FrameFieldUpdate& fieldUpdate);
 PlusStatus DeleteFrameField(vtkIGSIOTrackedFrameList* trackedFrameList, std::string fieldName);
 PlusStatus ConvertStringToMatrix(std::string& strMatrix, vtkMatrix4x4* matrix);
-PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<std::string> transformNamesToAdd, std::string deviceSetConfigurationFileName);
+PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<std::string>& transformNamesToAdd, vtkXMLDataElement* deviceSetConfiguration);
 PlusStatus FillRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<unsigned int>& fillRectOrigin, const std::vector<unsigned int>& fillRectSize, int fillGrayLevel);
-PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize);
+PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, const igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize);
+PlusStatus UpdateReferenceTransform(vtkIGSIOTrackedFrameList* trackedFrameList, const std::string& strUpdatedReferenceTransformName);
+PlusStatus ApplyHeaderOperation(vtkIGSIOTrackedFrameList* trackedFrameList, const SequenceEdit& edit);
+PlusStatus ApplyFrameOperation(vtkIGSIOTrackedFrameList* trackedFrameList, SequenceEdit& edit);
+PlusStatus ReadSequenceFieldsForMixing(const std::string& inputFileName, vtkIGSIOTrackedFrameList* trackedFrameList);
+bool OpenSequenceStreamReaders(const std::vector<std::string>& inputFileNames, std::vector<vtkSmartPointer<vtkPlusSequenceStreamReader> >& readers);
+PlusStatus EditSequenceInChunks(const std::vector<std::string>& inputFileNames, std::vector<vtkSmartPointer<vtkPlusSequenceStreamReader> >& readers,
+                                const std::vector<std::string>& mixedFileNames, const std::string& outputFileName, bool useCompression, bool incrementTimestamps,
+                                const std::vector<std::string>& customHeaderFields, SequenceEdit& edit, unsigned int chunkSize);
 
 namespace
 {
   const std::string FIELD_VALUE_FRAME_SCALAR = "{frame-scalar}";
   const std::string FIELD_VALUE_FRAME_TRANSFORM = "{frame-transform}";
+
+  //----------------------------------------------------------------------------
+  // Call the function for each frame of the list. Frames are distributed between all available processor cores.
+  template<typename FrameFunction>
+  void ForEachFrameInParallel(vtkIGSIOTrackedFrameList* trackedFrameList, FrameFunction frameFunction)
+  {
+    const unsigned int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+    const unsigned int numberOfThreads = std::max(1u, std::min(numberOfFrames, std::thread::hardware_concurrency()));
+    std::vector<std::future<void> > workers;
+    for (unsigned int threadIndex = 1; threadIndex < numberOfThreads; ++threadIndex)
+    {
+      workers.push_back(std::async(std::launch::async, [ = ]()
+      {
+        for (unsigned int i = threadIndex; i < numberOfFrames; i += numberOfThreads)
+        {
+          frameFunction(trackedFrameList->GetTrackedFrame(i), i);
+        }
+      }));
+    }
+    for (unsigned int i = 0; i < numberOfFrames; i += numberOfThreads)
+    {
+      frameFunction(trackedFrameList->GetTrackedFrame(i), i);
+    }
+    for (auto workerIt = workers.begin(); workerIt != workers.end(); ++workerIt)
+    {
+      workerIt->get();
+    }
+  }
 }
 
 // Fuse all fields in sequence files into the first sequence
@@ -107,56 +256,16 @@ PlusStatus MixTrackedFrameLists(vtkIGSIOTrackedFrameList* trackedFrameList, std:
   {
     LOG_INFO("Read input sequence file: " << inputFileNames[i]);
     vtkSmartPointer<vtkIGSIOTrackedFrameList> additionalTrackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-    if (vtkPlusSequenceIO::Read(inputFileNames[i], additionalTrackedFrameList) != PLUS_SUCCESS)
+    if (ReadSequenceFieldsForMixing(inputFileNames[i], additionalTrackedFrameList) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Couldn't read sequence file: " << inputFileNames[0]);
+      LOG_ERROR("Couldn't read sequence file: " << inputFileNames[i]);
       return PLUS_FAIL;
     }
-    if (additionalTrackedFrameList->GetNumberOfTrackedFrames() == 0)
-    {
-      continue;
-    }
 
-    unsigned int additionalFrameIndex = 0;
-    double maxTimestampValueForCurrentAdditionalFrame = additionalTrackedFrameList->GetTrackedFrame(0)->GetTimestamp();
-    if (additionalTrackedFrameList->GetNumberOfTrackedFrames() >= 2)
-    {
-      maxTimestampValueForCurrentAdditionalFrame = (additionalTrackedFrameList->GetTrackedFrame(additionalFrameIndex + 1)->GetTimestamp() + additionalTrackedFrameList->GetTrackedFrame(additionalFrameIndex)->GetTimestamp()) / 2.0;
-    }
+    FrameFieldMixer mixer(additionalTrackedFrameList);
     for (unsigned int f = 0; f < trackedFrameList->GetNumberOfTrackedFrames(); ++f)
     {
-      igsioTrackedFrame* masterTrackedFrame = trackedFrameList->GetTrackedFrame(f);
-
-      // Determine which additional frame belongs to this master frame
-      while (masterTrackedFrame->GetTimestamp() > maxTimestampValueForCurrentAdditionalFrame
-             && additionalFrameIndex + 1 < additionalTrackedFrameList->GetNumberOfTrackedFrames())
-      {
-        if (additionalFrameIndex == additionalTrackedFrameList->GetNumberOfTrackedFrames() - 1)
-        {
-          // last frame, all remaining frames are assigned to it
-          break;
-        }
-        additionalFrameIndex++;
-        // use this frame index until timestamp is closest to this frame's timestamp
-        maxTimestampValueForCurrentAdditionalFrame = (additionalTrackedFrameList->GetTrackedFrame(additionalFrameIndex)->GetTimestamp() +
-            additionalTrackedFrameList->GetTrackedFrame(additionalFrameIndex + 1)->GetTimestamp()) / 2.0;
-      }
-
-      // Copy frame fields
-      igsioTrackedFrame* additionalFrame = additionalTrackedFrameList->GetTrackedFrame(additionalFrameIndex);
-      auto customFrameFields = additionalFrame->GetCustomFields();
-      for (auto fieldIter = customFrameFields.begin(); fieldIter != customFrameFields.end(); ++fieldIter)
-      {
-        if (!fieldIter->first.compare("FrameNumber") ||
-            !fieldIter->first.compare("Timestamp") ||
-            !fieldIter->first.compare("UnfilteredTimestamp") ||
-            !fieldIter->first.compare("ImageStatus"))
-        {
-          // Timing and image information is taken from the first sequence
-          continue;
-        }
-        masterTrackedFrame->SetFrameField(fieldIter->first, fieldIter->second.second, fieldIter->second.first);
-      }
+      mixer.MixFrame(trackedFrameList->GetTrackedFrame(f));
     }
   }
   return PLUS_SUCCESS;
@@ -222,6 +331,8 @@ int main(int argc, char** argv)
   std::string                     strOperation;
   OperationType                   operation;
   bool                            useCompression = false;
+  bool                            parallelCompression = false;
+  int                             compressionThreads = 0;
   bool                            incrementTimestamps = false;
 
   int                             firstFrameIndex = -1; // First frame index used for trimming the sequence file.
@@ -261,6 +372,8 @@ int main(int argc, char** argv)
   bool                            flipY(false);
   bool                            flipZ(false);
 
+  int                             chunkSize = 0; // Number of frames that are kept in memory at once, 0 = all
+
   args.Initialize(argc, argv);
   args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
@@ -295,7 +408,10 @@ int main(int argc, char** argv)
   args.AddArgument("--update-reference-transform", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &strUpdatedReferenceTransformName, "Set the reference transform name to update old files by changing all ToolToReference transforms to ToolToTracker transform.");
 
   args.AddArgument("--use-compression", vtksys::CommandLineArguments::NO_ARGUMENT, &useCompression, "Compress sequence file images.");
+  args.AddArgument("--parallel-compression", vtksys::CommandLineArguments::NO_ARGUMENT, &parallelCompression, "Compress and decompress sequence file images using multiple threads. Supported for MetaImage and NRRD files.");
+  args.AddArgument("--compression-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &compressionThreads, "Number of threads used for parallel compression. 0 = number of processor cores. (Default: 0)");
   args.AddArgument("--increment-timestamps", vtksys::CommandLineArguments::NO_ARGUMENT, &incrementTimestamps, "Increment timestamps in the order of the input-file-names");
+  args.AddArgument("--chunk-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &chunkSize, "Number of frames that are read, processed, and written at once. Memory usage does not depend on the sequence length. Requires uncompressed MetaImage input files, and MetaImage output without compression or with --parallel-compression. 0 = load all frames into memory. (Default: 0)");
 
   args.AddArgument("--add-transform", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &transformNamesToAdd, "Name of the transform to add to each frame (e.g., StylusTipToTracker); multiple transforms can be added separated by a comma (e.g., StylusTipToReference,ProbeToReference)");
   args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &deviceSetConfigurationFileName, "Used device set configuration file path and name");
@@ -360,6 +476,9 @@ int main(int argc, char** argv)
 
   vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
 
+  vtkPlusSequenceIO::SetParallelCompressionEnabled(parallelCompression);
+  vtkPlusSequenceIO::SetCompressionNumberOfThreads(static_cast<unsigned int>(std::max(compressionThreads, 0)));
+
   // Check command line arguments
   if (inputFileName.empty() && inputFileNames.empty())
   {
@@ -430,6 +549,16 @@ int main(int argc, char** argv)
   }
   else if (igsioCommon::IsEqualInsensitive(strOperation, "FILL_IMAGE_RECTANGLE"))
   {
+    if (rectOriginPix.size() != 2 || rectSizePix.size() != 2)
+    {
+      LOG_ERROR("Incorrect size of vector for rectangle origin or size. Aborting.");
+      return EXIT_FAILURE;
+    }
+    if (rectOriginPix[0] < 0 || rectOriginPix[1] < 0 || rectSizePix[0] < 0 || rectSizePix[1] < 0)
+    {
+      LOG_ERROR("Negative value for rectangle origin or size entered. Aborting.");
+      return EXIT_FAILURE;
+    }
     operation = FILL_IMAGE_RECTANGLE;
   }
   else if (igsioCommon::IsEqualInsensitive(strOperation, "CROP"))
@@ -466,9 +595,86 @@ int main(int argc, char** argv)
   }
 
   ///////////////////////////////////////////////////////////////////
-  // Read input files
+  // Set up the operation
+
+  SequenceEdit edit;
+  edit.Operation = operation;
+  edit.FieldName = fieldName;
+  edit.UpdatedFieldName = updatedFieldName;
+  edit.UpdatedFieldValue = updatedFieldValue;
+  edit.UpdatedReferenceTransformName = strUpdatedReferenceTransformName;
+  edit.FirstFrameIndex = static_cast<unsigned int>(std::max(firstFrameIndex, 0));
+  edit.LastFrameIndex = static_cast<unsigned int>(std::max(lastFrameIndex, 0));
+  edit.DecimationFactor = static_cast<unsigned int>(std::max(decimationFactor, 0));
 
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  switch (operation)
+  {
+    case UPDATE_FRAME_FIELD_NAME:
+      {
+        edit.FieldUpdate.FieldName = fieldName;
+        edit.FieldUpdate.UpdatedFieldName = updatedFieldName;
+      }
+      break;
+    case UPDATE_FRAME_FIELD_VALUE:
+      {
+        edit.FieldUpdate.FieldName = fieldName;
+        edit.FieldUpdate.UpdatedFieldName = updatedFieldName;
+        edit.FieldUpdate.UpdatedFieldValue = updatedFieldValue;
+        edit.FieldUpdate.FrameScalarDecimalDigits = frameScalarDecimalDigits;
+        edit.FieldUpdate.FrameScalarIncrement = frameScalarIncrement;
+        edit.FieldUpdate.FrameScalarStart = frameScalarStart;
+        edit.FieldUpdate.FrameTransformStart = frameTransformStart;
+        edit.FieldUpdate.FrameTransformIncrement = frameTransformIncrement;
+        edit.FieldUpdate.FrameTransformIndexFieldName = strFrameTransformIndexFieldName;
+      }
+      break;
+    case DELETE_FRAME_FIELD:
+      {
+        if (fieldName.empty())
+        {
+          LOG_ERROR("Field name is empty!");
+          return EXIT_FAILURE;
+        }
+        LOG_INFO("Delete frame field: " << fieldName);
+      }
+      break;
+    case ADD_TRANSFORM:
+      {
+        LOG_INFO("Add transform '" << transformNamesToAdd << "' using device set configuration file '" << deviceSetConfigurationFileName << "'");
+        igsioCommon::SplitStringIntoTokens(transformNamesToAdd, ',', edit.TransformNamesToAdd);
+        if (deviceSetConfigurationFileName.empty())
+        {
+          LOG_ERROR("Used device set configuration file name is empty");
+          return EXIT_FAILURE;
+        }
+        // Read configuration
+        edit.DeviceSetConfiguration = vtkSmartPointer<vtkXMLDataElement>::New();
+        if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(edit.DeviceSetConfiguration, deviceSetConfigurationFileName.c_str()) == PLUS_FAIL)
+        {
+          LOG_ERROR("Unable to read configuration from file " << deviceSetConfigurationFileName.c_str());
+          return EXIT_FAILURE;
+        }
+      }
+      break;
+    case FILL_IMAGE_RECTANGLE:
+      {
+        edit.FillRectOrigin.assign(rectOriginPix.begin(), rectOriginPix.end());
+        edit.FillRectSize.assign(rectSizePix.begin(), rectSizePix.end());
+        edit.FillGrayLevel = fillGrayLevel;
+      }
+      break;
+    case CROP:
+      {
+        edit.CropFlipInfo.hFlip = flipX;
+        edit.CropFlipInfo.vFlip = flipY;
+        edit.CropFlipInfo.eFlip = flipZ;
+        edit.CropRectOrigin = rectOriginPix;
+        edit.CropRectSize = rectSizePix;
+      }
+      break;
+    default:
+      break;
+  }
 
   if (!inputFileName.empty())
   {
@@ -476,6 +682,47 @@ int main(int argc, char** argv)
     inputFileNames.insert(inputFileNames.begin(), inputFileName);
   }
 
+  ///////////////////////////////////////////////////////////////////
+  // Edit the sequence chunk by chunk, if the input files allow it
+
+  if (chunkSize > 0)
+  {
+    // When sequences are mixed then only the first (master) sequence contains image data
+    std::vector<std::string> streamedFileNames(inputFileNames);
+    std::vector<std::string> mixedFileNames;
+    if (operation == MIX && !inputFileNames.empty())
+    {
+      streamedFileNames.assign(1, inputFileNames[0]);
+      mixedFileNames.assign(inputFileNames.begin() + 1, inputFileNames.end());
+    }
+
+    std::vector<vtkSmartPointer<vtkPlusSequenceStreamReader> > readers;
+    if (useCompression && vtkIGSIOMetaImageSequenceIO::CanWriteFile(outputFileName) && !parallelCompression)
+    {
+      LOG_WARNING("Compressed MetaImage output cannot be written in chunks. All frames are loaded into memory.");
+    }
+    else if (!OpenSequenceStreamReaders(streamedFileNames, readers))
+    {
+      LOG_WARNING("Input sequence files cannot be read in chunks (only uncompressed MetaImage files are supported). All frames are loaded into memory.");
+    }
+    else
+    {
+      if (EditSequenceInChunks(streamedFileNames, readers, mixedFileNames, outputFileName, useCompression, incrementTimestamps,
+                               customHeaderFieldsToMaintain, edit, static_cast<unsigned int>(chunkSize)) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Couldn't edit sequence file: " << outputFileName);
+        return EXIT_FAILURE;
+      }
+      LOG_INFO("Sequence file editing was successful!");
+      return EXIT_SUCCESS;
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////
+  // Read input files
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+
   // Multiple input files are appended unless sequences are mixed
   PlusStatus status = PLUS_SUCCESS;
   if (operation == MIX)
@@ -505,17 +752,7 @@ int main(int argc, char** argv)
       break;
     case TRIM:
       {
-        if (firstFrameIndex < 0)
-        {
-          firstFrameIndex = 0;
-        }
-        if (lastFrameIndex < 0)
-        {
-          lastFrameIndex = 0;
-        }
-        unsigned int firstFrameIndexUint = static_cast<unsigned int>(firstFrameIndex);
-        unsigned int lastFrameIndexUint = static_cast<unsigned int>(lastFrameIndex);
-        if (TrimSequenceFile(trackedFrameList, firstFrameIndexUint, lastFrameIndexUint) != PLUS_SUCCESS)
+        if (TrimSequenceFile(trackedFrameList, edit.FirstFrameIndex, edit.LastFrameIndex) != PLUS_SUCCESS)
         {
           LOG_ERROR("Failed to trim sequence file");
           return EXIT_FAILURE;
@@ -524,147 +761,32 @@ int main(int argc, char** argv)
       break;
     case DECIMATE:
       {
-        if (DecimateSequenceFile(trackedFrameList, decimationFactor) != PLUS_SUCCESS)
+        if (DecimateSequenceFile(trackedFrameList, edit.DecimationFactor) != PLUS_SUCCESS)
         {
           LOG_ERROR("Failed to decimate sequence file");
           return EXIT_FAILURE;
         }
       }
       break;
-    case UPDATE_FRAME_FIELD_NAME:
-      {
-        FrameFieldUpdate fieldUpdate;
-        fieldUpdate.TrackedFrameList = trackedFrameList;
-        fieldUpdate.FieldName = fieldName;
-        fieldUpdate.UpdatedFieldName = updatedFieldName;
-
-        if (UpdateFrameFieldValue(fieldUpdate) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to update frame field name '" << fieldName << "' to '" << updatedFieldName << "'");
-          return EXIT_FAILURE;
-        }
-      }
-      break;
-    case UPDATE_FRAME_FIELD_VALUE:
-      {
-        FrameFieldUpdate fieldUpdate;
-        fieldUpdate.TrackedFrameList = trackedFrameList;
-        fieldUpdate.FieldName = fieldName;
-        fieldUpdate.UpdatedFieldName = updatedFieldName;
-        fieldUpdate.UpdatedFieldValue = updatedFieldValue;
-        fieldUpdate.FrameScalarDecimalDigits = frameScalarDecimalDigits;
-        fieldUpdate.FrameScalarIncrement = frameScalarIncrement;
-        fieldUpdate.FrameScalarStart = frameScalarStart;
-        fieldUpdate.FrameTransformStart = frameTransformStart;
-        fieldUpdate.FrameTransformIncrement = frameTransformIncrement;
-        fieldUpdate.FrameTransformIndexFieldName = strFrameTransformIndexFieldName;
-
-        if (UpdateFrameFieldValue(fieldUpdate) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to update frame field value");
-          return EXIT_FAILURE;
-        }
-      }
-      break;
-    case DELETE_FRAME_FIELD:
-      {
-        if (DeleteFrameField(trackedFrameList, fieldName) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to delete frame field");
-          return EXIT_FAILURE;
-        }
-      }
-      break;
-    case DELETE_FIELD:
-      {
-        // Delete field
-        LOG_INFO("Delete field: " << fieldName);
-        if (trackedFrameList->SetCustomString(fieldName.c_str(), NULL) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to delete field: " << fieldName);
-          return EXIT_FAILURE;
-        }
-      }
-      break;
     case UPDATE_FIELD_NAME:
-      {
-        // Update field name
-        LOG_INFO("Update field name '" << fieldName << "' to  '" << updatedFieldName << "'");
-        const char* fieldValue = trackedFrameList->GetCustomString(fieldName.c_str());
-        if (fieldValue != NULL)
-        {
-          // Delete field
-          if (trackedFrameList->SetCustomString(fieldName.c_str(), NULL) != PLUS_SUCCESS)
-          {
-            LOG_ERROR("Failed to delete field: " << fieldName);
-            return EXIT_FAILURE;
-          }
-
-          // Add new field
-          if (trackedFrameList->SetCustomString(updatedFieldName.c_str(), fieldValue) != PLUS_SUCCESS)
-          {
-            LOG_ERROR("Failed to update field '" << updatedFieldName << "' with value '" << fieldValue << "'");
-            return EXIT_FAILURE;
-          }
-        }
-      }
-      break;
     case UPDATE_FIELD_VALUE:
+    case DELETE_FIELD:
       {
-        // Update field value
-        LOG_INFO("Update field '" << fieldName << "' with value '" << updatedFieldValue << "'");
-        if (trackedFrameList->SetCustomString(fieldName.c_str(), updatedFieldValue.c_str()) != PLUS_SUCCESS)
+        if (ApplyHeaderOperation(trackedFrameList, edit) != PLUS_SUCCESS)
         {
-          LOG_ERROR("Failed to update field '" << fieldName << "' with value '" << updatedFieldValue << "'");
           return EXIT_FAILURE;
         }
       }
       break;
+    case UPDATE_FRAME_FIELD_NAME:
+    case UPDATE_FRAME_FIELD_VALUE:
+    case DELETE_FRAME_FIELD:
     case ADD_TRANSFORM:
-      {
-        // Add transform
-        LOG_INFO("Add transform '" << transformNamesToAdd << "' using device set configuration file '" << deviceSetConfigurationFileName << "'");
-        std::vector<std::string> transformNamesList;
-        igsioCommon::SplitStringIntoTokens(transformNamesToAdd, ',', transformNamesList);
-        if (AddTransform(trackedFrameList, transformNamesList, deviceSetConfigurationFileName) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to add transform '" << transformNamesToAdd << "' using device set configuration file '" << deviceSetConfigurationFileName << "'");
-          return EXIT_FAILURE;
-        }
-      }
-      break;
     case FILL_IMAGE_RECTANGLE:
-      {
-        if (rectOriginPix.size() != 2 || rectSizePix.size() != 2)
-        {
-          LOG_ERROR("Incorrect size of vector for rectangle origin or size. Aborting.");
-          return PLUS_FAIL;
-        }
-        if (rectOriginPix[0] < 0 || rectOriginPix[1] < 0 || rectSizePix[0] < 0 || rectSizePix[1] < 0)
-        {
-          LOG_ERROR("Negative value for rectangle origin or size entered. Aborting.");
-          return PLUS_FAIL;
-        }
-        std::vector<unsigned int> rectOriginPixUint(rectOriginPix.begin(), rectOriginPix.end());
-        std::vector<unsigned int> rectSizePixUint(rectSizePix.begin(), rectSizePix.end());
-        // Fill a rectangular region in the image with a solid color
-        if (FillRectangle(trackedFrameList, rectOriginPixUint, rectSizePixUint, fillGrayLevel) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to fill rectangle");
-          return EXIT_FAILURE;
-        }
-      }
-      break;
     case CROP:
       {
-        // Crop a rectangular region from the image
-        igsioVideoFrame::FlipInfoType flipInfo;
-        flipInfo.hFlip = flipX;
-        flipInfo.vFlip = flipY;
-        flipInfo.eFlip = flipZ;
-        if (CropRectangle(trackedFrameList, flipInfo, rectOriginPix, rectSizePix) != PLUS_SUCCESS)
+        if (ApplyFrameOperation(trackedFrameList, edit) != PLUS_SUCCESS)
         {
-          LOG_ERROR("Failed to fill rectangle");
           return EXIT_FAILURE;
         }
       }
@@ -679,101 +801,15 @@ int main(int argc, char** argv)
       }
   }
 
-
   //////////////////////////////////////////////////////////////////
   // Convert files to the new file format
 
   if (!strUpdatedReferenceTransformName.empty())
   {
-    igsioTransformName referenceTransformName;
-    if (referenceTransformName.SetTransformName(strUpdatedReferenceTransformName.c_str()) != PLUS_SUCCESS)
+    if (UpdateReferenceTransform(trackedFrameList, strUpdatedReferenceTransformName) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Reference transform name is invalid: " << strUpdatedReferenceTransformName);
       return EXIT_FAILURE;
     }
-
-    for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
-    {
-      igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(i);
-
-      vtkSmartPointer<vtkMatrix4x4> referenceToTrackerMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-      if (trackedFrame->GetFrameTransform(referenceTransformName, referenceToTrackerMatrix) != PLUS_SUCCESS)
-      {
-        LOG_WARNING("Couldn't get reference transform with name: " << strUpdatedReferenceTransformName);
-        continue;
-      }
-
-      std::vector<igsioTransformName> transformNameList;
-      trackedFrame->GetFrameTransformNameList(transformNameList);
-
-      vtkSmartPointer<vtkTransform> toolToTrackerTransform = vtkSmartPointer<vtkTransform>::New();
-      vtkSmartPointer<vtkMatrix4x4> toolToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-      for (unsigned int n = 0; n < transformNameList.size(); ++n)
-      {
-        // No need to change the reference transform
-        if (transformNameList[n] == referenceTransformName)
-        {
-          continue;
-        }
-
-        ToolStatus status = TOOL_INVALID;
-        if (trackedFrame->GetFrameTransform(transformNameList[n], toolToReferenceMatrix) != PLUS_SUCCESS)
-        {
-          std::string strTransformName;
-          transformNameList[i].GetTransformName(strTransformName);
-          LOG_ERROR("Failed to get frame transform: " << strTransformName);
-          continue;
-        }
-
-        if (trackedFrame->GetFrameTransformStatus(transformNameList[n], status) != PLUS_SUCCESS)
-        {
-          std::string strTransformName;
-          transformNameList[i].GetTransformName(strTransformName);
-          LOG_ERROR("Failed to get frame transform status: " << strTransformName);
-          continue;
-        }
-
-        // Compute ToolToTracker transform from ToolToReference
-        toolToTrackerTransform->Identity();
-        toolToTrackerTransform->Concatenate(referenceToTrackerMatrix);
-        toolToTrackerTransform->Concatenate(toolToReferenceMatrix);
-
-        // Update the name to ToolToTracker
-        igsioTransformName toolToTracker(transformNameList[n].From().c_str(), "Tracker");
-        // Set the new custom transform
-        if (trackedFrame->SetFrameTransform(toolToTracker, toolToTrackerTransform->GetMatrix()) != PLUS_SUCCESS)
-        {
-          std::string strTransformName;
-          transformNameList[i].GetTransformName(strTransformName);
-          LOG_ERROR("Failed to set frame transform: " << strTransformName);
-          continue;
-        }
-
-        // Use the same status as it was before
-        if (trackedFrame->SetFrameTransformStatus(toolToTracker, status) != PLUS_SUCCESS)
-        {
-          std::string strTransformName;
-          transformNameList[i].GetTransformName(strTransformName);
-          LOG_ERROR("Failed to set frame transform status: " << strTransformName);
-          continue;
-        }
-
-        // Delete old transform and status fields
-        std::string oldTransformName, oldTransformStatus;
-        transformNameList[n].GetTransformName(oldTransformName);
-        // Append Transform to the end of the transform name
-        vtksys::RegularExpression isTransform("Transform$");
-        if (!isTransform.find(oldTransformName))
-        {
-          oldTransformName.append("Transform");
-        }
-        oldTransformStatus = oldTransformName;
-        oldTransformStatus.append("Status");
-        trackedFrame->DeleteFrameField(oldTransformName.c_str());
-        trackedFrame->DeleteFrameField(oldTransformStatus.c_str());
-
-      }
-    }
   }
 
   ///////////////////////////////////////////////////////////////////
@@ -854,7 +890,6 @@ PlusStatus DeleteFrameField(vtkIGSIOTrackedFrameList* trackedFrameList, std::str
     return PLUS_FAIL;
   }
 
-  LOG_INFO("Delete frame field: " << fieldName);
   int numberOfErrors(0);
   for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
   {
@@ -877,18 +912,25 @@ PlusStatus DeleteFrameField(vtkIGSIOTrackedFrameList* trackedFrameList, std::str
 //-------------------------------------------------------
 PlusStatus UpdateFrameFieldValue(FrameFieldUpdate& fieldUpdate)
 {
-  LOG_INFO("Update frame field");
   int numberOfErrors(0);
 
-  // Set the start scalar value
-  double scalarVariable = fieldUpdate.FrameScalarStart;
-
-  // Set the start transform matrix
-  vtkSmartPointer<vtkTransform> frameTransform = vtkSmartPointer<vtkTransform>::New();
-  if (fieldUpdate.FrameTransformStart != NULL)
+  if (!fieldUpdate.FrameValuesInitialized)
   {
-    frameTransform->SetMatrix(fieldUpdate.FrameTransformStart);
+    LOG_INFO("Update frame field");
+
+    // Set the start scalar value
+    fieldUpdate.FrameScalarCurrent = fieldUpdate.FrameScalarStart;
+
+    // Set the start transform matrix
+    fieldUpdate.FrameTransformCurrent = vtkSmartPointer<vtkTransform>::New();
+    if (fieldUpdate.FrameTransformStart != NULL)
+    {
+      fieldUpdate.FrameTransformCurrent->SetMatrix(fieldUpdate.FrameTransformStart);
+    }
+    fieldUpdate.FrameValuesInitialized = true;
   }
+  double& scalarVariable = fieldUpdate.FrameScalarCurrent;
+  vtkTransform* frameTransform = fieldUpdate.FrameTransformCurrent;
 
   for (unsigned int i = 0; i < fieldUpdate.TrackedFrameList->GetNumberOfTrackedFrames(); ++i)
   {
@@ -1006,7 +1048,7 @@ PlusStatus ConvertStringToMatrix(std::string& strMatrix, vtkMatrix4x4* matrix)
 }
 
 //-------------------------------------------------------
-PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<std::string> transformNamesToAdd, std::string deviceSetConfigurationFileName)
+PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<std::string>& transformNamesToAdd, vtkXMLDataElement* deviceSetConfiguration)
 {
   if (trackedFrameList == NULL)
   {
@@ -1020,17 +1062,9 @@ PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<
     return PLUS_FAIL;
   }
 
-  if (deviceSetConfigurationFileName.empty())
-  {
-    LOG_ERROR("Used device set configuration file name is empty");
-    return PLUS_FAIL;
-  }
-
-  // Read configuration
-  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
-  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, deviceSetConfigurationFileName.c_str()) == PLUS_FAIL)
+  if (deviceSetConfiguration == NULL)
   {
-    LOG_ERROR("Unable to read configuration from file " << deviceSetConfigurationFileName.c_str());
+    LOG_ERROR("Device set configuration is invalid");
     return PLUS_FAIL;
   }
 
@@ -1040,7 +1074,7 @@ PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<
 
     // Set up transform repository
     vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
-    if (transformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    if (transformRepository->ReadConfiguration(deviceSetConfiguration) != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to set device set configuration to transform repository!");
       return PLUS_FAIL;
@@ -1051,7 +1085,7 @@ PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<
       return PLUS_FAIL;
     }
 
-    for (std::vector<std::string>::iterator transformNameToAddIt = transformNamesToAdd.begin(); transformNameToAddIt != transformNamesToAdd.end(); ++transformNameToAddIt)
+    for (std::vector<std::string>::const_iterator transformNameToAddIt = transformNamesToAdd.begin(); transformNameToAddIt != transformNamesToAdd.end(); ++transformNameToAddIt)
     {
       // Create transform name
       igsioTransformName transformName;
@@ -1088,34 +1122,33 @@ PlusStatus FillRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, const std::
     return PLUS_FAIL;
   }
 
-  for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+  ForEachFrameInParallel(trackedFrameList, [&](igsioTrackedFrame * frame, unsigned int i)
   {
-    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(i);
-    igsioVideoFrame* videoFrame = trackedFrame->GetImageData();
+    igsioVideoFrame* videoFrame = frame->GetImageData();
     FrameSizeType frameSize = { 0, 0, 0 };
     if (videoFrame == NULL || videoFrame->GetFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to retrieve pixel data from frame " << i << ". Fill rectangle failed.");
-      continue;
+      return;
     }
     if (fillRectOrigin[0] >= frameSize[0] ||
         fillRectOrigin[1] >= frameSize[1])
     {
       LOG_ERROR("Invalid fill rectangle origin is specified (" << fillRectOrigin[0] << ", " << fillRectOrigin[1] << "). The image size is ("
                 << frameSize[0] << ", " << frameSize[1] << ").");
-      continue;
+      return;
     }
     if (fillRectSize[0] <= 0 || fillRectOrigin[0] + fillRectSize[0] > frameSize[0] ||
         fillRectSize[1] <= 0 || fillRectOrigin[1] + fillRectSize[1] > frameSize[1])
     {
       LOG_ERROR("Invalid fill rectangle size is specified (" << fillRectSize[0] << ", " << fillRectSize[1] << "). The specified fill rectangle origin is ("
                 << fillRectOrigin[0] << ", " << fillRectOrigin[1] << ") and the image size is (" << frameSize[0] << ", " << frameSize[1] << ").");
-      continue;
+      return;
     }
     if (videoFrame->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
     {
       LOG_ERROR("Fill rectangle is supported only for B-mode images (unsigned char type)");
-      continue;
+      return;
     }
     unsigned char fillData = 0;
     if (fillGrayLevel < 0)
@@ -1134,12 +1167,12 @@ PlusStatus FillRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, const std::
     {
       memset(static_cast<unsigned char*>(videoFrame->GetScalarPointer()) + (fillRectOrigin[1] + y)*frameSize[0] + fillRectOrigin[0], fillData, fillRectSize[0]);
     }
-  }
+  });
   return PLUS_SUCCESS;
 }
 
 //-------------------------------------------------------
-PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize)
+PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, const igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize)
 {
   if (trackedFrameList == NULL)
   {
@@ -1156,16 +1189,15 @@ PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, igsioVideoF
   tfmMatrix->SetElement(2, 3, -rectOrigin[2]);
   igsioTransformName imageToCroppedImage("Image", "CroppedImage");
 
-  for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+  ForEachFrameInParallel(trackedFrameList, [&](igsioTrackedFrame * trackedFrame, unsigned int i)
   {
-    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(i);
     igsioVideoFrame* videoFrame = trackedFrame->GetImageData();
 
     FrameSizeType frameSize = { 0, 0, 0 };
     if (videoFrame == NULL || videoFrame->GetFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to retrieve pixel data from frame " << i << ". Crop rectangle failed.");
-      continue;
+      return;
     }
 
     vtkSmartPointer<vtkImageData> croppedImage = vtkSmartPointer<vtkImageData>::New();
@@ -1174,7 +1206,467 @@ PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, igsioVideoF
     videoFrame->DeepCopyFrom(croppedImage);
     trackedFrame->SetFrameTransform(imageToCroppedImage, tfmMatrix);
     trackedFrame->SetFrameTransformStatus(imageToCroppedImage, TOOL_OK);
+  });
+
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+// Change all ToolToReference transforms to ToolToTracker transforms
+PlusStatus UpdateReferenceTransform(vtkIGSIOTrackedFrameList* trackedFrameList, const std::string& strUpdatedReferenceTransformName)
+{
+  igsioTransformName referenceTransformName;
+  if (referenceTransformName.SetTransformName(strUpdatedReferenceTransformName.c_str()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Reference transform name is invalid: " << strUpdatedReferenceTransformName);
+    return PLUS_FAIL;
+  }
+
+  for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+  {
+    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(i);
+
+    vtkSmartPointer<vtkMatrix4x4> referenceToTrackerMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (trackedFrame->GetFrameTransform(referenceTransformName, referenceToTrackerMatrix) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Couldn't get reference transform with name: " << strUpdatedReferenceTransformName);
+      continue;
+    }
+
+    std::vector<igsioTransformName> transformNameList;
+    trackedFrame->GetFrameTransformNameList(transformNameList);
+
+    vtkSmartPointer<vtkTransform> toolToTrackerTransform = vtkSmartPointer<vtkTransform>::New();
+    vtkSmartPointer<vtkMatrix4x4> toolToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (unsigned int n = 0; n < transformNameList.size(); ++n)
+    {
+      // No need to change the reference transform
+      if (transformNameList[n] == referenceTransformName)
+      {
+        continue;
+      }
+
+      ToolStatus status = TOOL_INVALID;
+      if (trackedFrame->GetFrameTransform(transformNameList[n], toolToReferenceMatrix) != PLUS_SUCCESS)
+      {
+        std::string strTransformName;
+        transformNameList[n].GetTransformName(strTransformName);
+        LOG_ERROR("Failed to get frame transform: " << strTransformName);
+        continue;
+      }
+
+      if (trackedFrame->GetFrameTransformStatus(transformNameList[n], status) != PLUS_SUCCESS)
+      {
+        std::string strTransformName;
+        transformNameList[n].GetTransformName(strTransformName);
+        LOG_ERROR("Failed to get frame transform status: " << strTransformName);
+        continue;
+      }
+
+      // Compute ToolToTracker transform from ToolToReference
+      toolToTrackerTransform->Identity();
+      toolToTrackerTransform->Concatenate(referenceToTrackerMatrix);
+      toolToTrackerTransform->Concatenate(toolToReferenceMatrix);
+
+      // Update the name to ToolToTracker
+      igsioTransformName toolToTracker(transformNameList[n].From().c_str(), "Tracker");
+      // Set the new custom transform
+      if (trackedFrame->SetFrameTransform(toolToTracker, toolToTrackerTransform->GetMatrix()) != PLUS_SUCCESS)
+      {
+        std::string strTransformName;
+        transformNameList[n].GetTransformName(strTransformName);
+        LOG_ERROR("Failed to set frame transform: " << strTransformName);
+        continue;
+      }
+
+      // Use the same status as it was before
+      if (trackedFrame->SetFrameTransformStatus(toolToTracker, status) != PLUS_SUCCESS)
+      {
+        std::string strTransformName;
+        transformNameList[n].GetTransformName(strTransformName);
+        LOG_ERROR("Failed to set frame transform status: " << strTransformName);
+        continue;
+      }
+
+      // Delete old transform and status fields
+      std::string oldTransformName, oldTransformStatus;
+      transformNameList[n].GetTransformName(oldTransformName);
+      // Append Transform to the end of the transform name
+      vtksys::RegularExpression isTransform("Transform$");
+      if (!isTransform.find(oldTransformName))
+      {
+        oldTransformName.append("Transform");
+      }
+      oldTransformStatus = oldTransformName;
+      oldTransformStatus.append("Status");
+      trackedFrame->DeleteFrameField(oldTransformName.c_str());
+      trackedFrame->DeleteFrameField(oldTransformStatus.c_str());
+
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+// Apply operations that modify the sequence header fields
+PlusStatus ApplyHeaderOperation(vtkIGSIOTrackedFrameList* trackedFrameList, const SequenceEdit& edit)
+{
+  switch (edit.Operation)
+  {
+    case DELETE_FIELD:
+      {
+        // Delete field
+        LOG_INFO("Delete field: " << edit.FieldName);
+        if (trackedFrameList->SetCustomString(edit.FieldName.c_str(), NULL) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to delete field: " << edit.FieldName);
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case UPDATE_FIELD_NAME:
+      {
+        // Update field name
+        LOG_INFO("Update field name '" << edit.FieldName << "' to  '" << edit.UpdatedFieldName << "'");
+        const char* fieldValue = trackedFrameList->GetCustomString(edit.FieldName.c_str());
+        if (fieldValue != NULL)
+        {
+          std::string copyOfFieldValue(fieldValue);
+          // Delete field
+          if (trackedFrameList->SetCustomString(edit.FieldName.c_str(), NULL) != PLUS_SUCCESS)
+          {
+            LOG_ERROR("Failed to delete field: " << edit.FieldName);
+            return PLUS_FAIL;
+          }
+
+          // Add new field
+          if (trackedFrameList->SetCustomString(edit.UpdatedFieldName.c_str(), copyOfFieldValue.c_str()) != PLUS_SUCCESS)
+          {
+            LOG_ERROR("Failed to update field '" << edit.UpdatedFieldName << "' with value '" << copyOfFieldValue << "'");
+            return PLUS_FAIL;
+          }
+        }
+      }
+      break;
+    case UPDATE_FIELD_VALUE:
+      {
+        // Update field value
+        LOG_INFO("Update field '" << edit.FieldName << "' with value '" << edit.UpdatedFieldValue << "'");
+        if (trackedFrameList->SetCustomString(edit.FieldName.c_str(), edit.UpdatedFieldValue.c_str()) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to update field '" << edit.FieldName << "' with value '" << edit.UpdatedFieldValue << "'");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    default:
+      break;
+  }
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+// Apply operations that modify each frame. May be called multiple times, for consecutive chunks of the sequence.
+PlusStatus ApplyFrameOperation(vtkIGSIOTrackedFrameList* trackedFrameList, SequenceEdit& edit)
+{
+  switch (edit.Operation)
+  {
+    case UPDATE_FRAME_FIELD_NAME:
+    case UPDATE_FRAME_FIELD_VALUE:
+      {
+        edit.FieldUpdate.TrackedFrameList = trackedFrameList;
+        if (UpdateFrameFieldValue(edit.FieldUpdate) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to update frame field '" << edit.FieldName << "'");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case DELETE_FRAME_FIELD:
+      {
+        if (DeleteFrameField(trackedFrameList, edit.FieldName) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to delete frame field");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case ADD_TRANSFORM:
+      {
+        if (AddTransform(trackedFrameList, edit.TransformNamesToAdd, edit.DeviceSetConfiguration) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to add transforms");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case FILL_IMAGE_RECTANGLE:
+      {
+        // Fill a rectangular region in the image with a solid color
+        if (FillRectangle(trackedFrameList, edit.FillRectOrigin, edit.FillRectSize, edit.FillGrayLevel) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to fill rectangle");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case CROP:
+      {
+        // Crop a rectangular region from the image
+        if (CropRectangle(trackedFrameList, edit.CropFlipInfo, edit.CropRectOrigin, edit.CropRectSize) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to crop rectangle");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    default:
+      break;
+  }
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+// Only frame fields are mixed into the master sequence, therefore image data is not loaded if the file format allows it
+PlusStatus ReadSequenceFieldsForMixing(const std::string& inputFileName, vtkIGSIOTrackedFrameList* trackedFrameList)
+{
+  vtkSmartPointer<vtkPlusSequenceStreamReader> reader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+  if (reader->Open(inputFileName) == PLUS_SUCCESS)
+  {
+    return reader->ReadFrames(0, reader->GetNumberOfFrames(), trackedFrameList, false);
+  }
+  return vtkPlusSequenceIO::Read(inputFileName, trackedFrameList);
+}
+
+//-------------------------------------------------------
+// Returns false if any of the input files cannot be read in chunks
+bool OpenSequenceStreamReaders(const std::vector<std::string>& inputFileNames, std::vector<vtkSmartPointer<vtkPlusSequenceStreamReader> >& readers)
+{
+  readers.clear();
+  for (std::vector<std::string>::const_iterator fileNameIt = inputFileNames.begin(); fileNameIt != inputFileNames.end(); ++fileNameIt)
+  {
+    vtkSmartPointer<vtkPlusSequenceStreamReader> reader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+    if (reader->Open(*fileNameIt) != PLUS_SUCCESS)
+    {
+      readers.clear();
+      return false;
+    }
+    readers.push_back(reader);
+  }
+  return !readers.empty();
+}
+
+//-------------------------------------------------------
+// Read, edit, and write the sequence in chunks of frames, so that memory usage does not depend on the length of the sequence.
+// Input files are appended (or mixed) and the operation is applied the same way as when all frames are loaded into memory.
+PlusStatus EditSequenceInChunks(const std::vector<std::string>& inputFileNames, std::vector<vtkSmartPointer<vtkPlusSequenceStreamReader> >& readers,
+                                const std::vector<std::string>& mixedFileNames, const std::string& outputFileName, bool useCompression, bool incrementTimestamps,
+                                const std::vector<std::string>& customHeaderFields, SequenceEdit& edit, unsigned int chunkSize)
+{
+  unsigned int numberOfInputFrames = 0;
+  for (unsigned int i = 0; i < readers.size(); ++i)
+  {
+    numberOfInputFrames += readers[i]->GetNumberOfFrames();
   }
 
+  if (edit.Operation == TRIM)
+  {
+    LOG_INFO("Trim sequence file from frame #: " << edit.FirstFrameIndex << " to frame #" << edit.LastFrameIndex);
+    if (edit.LastFrameIndex >= numberOfInputFrames || edit.FirstFrameIndex > edit.LastFrameIndex)
+    {
+      LOG_ERROR("Invalid input range: (" << edit.FirstFrameIndex << ", " << edit.LastFrameIndex << ")" << " Permitted range within (0, " << numberOfInputFrames - 1 << ")");
+      return PLUS_FAIL;
+    }
+  }
+  else if (edit.Operation == DECIMATE)
+  {
+    LOG_INFO("Decimate sequence file: keep 1 frame out of every " << edit.DecimationFactor << " frames");
+    if (edit.DecimationFactor < 2)
+    {
+      LOG_ERROR("Invalid decimation factor: " << edit.DecimationFactor << ". It must be an integer larger or equal than 2.");
+      return PLUS_FAIL;
+    }
+  }
+  else if (edit.Operation == MIX && numberOfInputFrames == 0)
+  {
+    LOG_ERROR("No frames in sequence file: " << inputFileNames[0]);
+    return PLUS_FAIL;
+  }
+
+  // Frame fields of the sequences that are mixed into the master sequence
+  std::vector<FrameFieldMixer> mixers;
+  for (std::vector<std::string>::const_iterator fileNameIt = mixedFileNames.begin(); fileNameIt != mixedFileNames.end(); ++fileNameIt)
+  {
+    LOG_INFO("Read input sequence file: " << (*fileNameIt));
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> additionalTrackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (ReadSequenceFieldsForMixing(*fileNameIt, additionalTrackedFrameList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't read sequence file: " << (*fileNameIt));
+      return PLUS_FAIL;
+    }
+    mixers.push_back(FrameFieldMixer(additionalTrackedFrameList));
+  }
+
+  // Frames of the current chunk. Header fields are kept when the list is cleared.
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> chunkFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (edit.Operation == MIX)
+  {
+    // Header is taken from the master sequence
+    const std::map<std::string, std::string>& masterHeaderFields = readers[0]->GetCustomHeaderFields();
+    for (std::map<std::string, std::string>::const_iterator fieldIt = masterHeaderFields.begin(); fieldIt != masterHeaderFields.end(); ++fieldIt)
+    {
+      chunkFrameList->SetCustomString(fieldIt->first, fieldIt->second);
+    }
+  }
+  else
+  {
+    for (unsigned int i = 0; i < readers.size(); ++i)
+    {
+      const std::map<std::string, std::string>& headerFields = readers[i]->GetCustomHeaderFields();
+      for (std::vector<std::string>::const_iterator fieldNameIt = customHeaderFields.begin(); fieldNameIt != customHeaderFields.end(); ++fieldNameIt)
+      {
+        std::map<std::string, std::string>::const_iterator fieldIt = headerFields.find(*fieldNameIt);
+        chunkFrameList->SetCustomString(*fieldNameIt, fieldIt != headerFields.end() ? fieldIt->second : std::string());
+      }
+    }
+  }
+  if (ApplyHeaderOperation(chunkFrameList, edit) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkIGSIOSequenceIOBase> writer;
+  writer.TakeReference(vtkIGSIOSequenceIO::CreateSequenceHandlerForFile(outputFileName));
+  if (writer.GetPointer() == NULL)
+  {
+    LOG_ERROR("Could not create writer for file: " << outputFileName);
+    return PLUS_FAIL;
+  }
+  // With parallel compression the frames are written uncompressed and the whole file is compressed at the end
+  const bool compressOnClose = useCompression && vtkPlusSequenceIO::GetParallelCompressionEnabled() && vtkPlusSequenceIO::CanCompressSequenceFile(outputFileName);
+  writer->SetUseCompression(useCompression && !compressOnClose);
+  writer->SetEnableImageDataWrite(edit.Operation != REMOVE_IMAGE_DATA);
+  writer->SetTrackedFrameList(chunkFrameList);
+  // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
+  writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(outputFileName));
+
+  LOG_INFO("Save output sequence file to: " << outputFileName);
+  bool isHeaderPrepared = false;
+  bool isData3D = false;
+  unsigned int numberOfWrittenFrames = 0;
+  auto writeChunk = [&]() -> PlusStatus
+  {
+    if (chunkFrameList->GetNumberOfTrackedFrames() == 0)
+    {
+      return PLUS_SUCCESS;
+    }
+    for (auto mixerIt = mixers.begin(); mixerIt != mixers.end(); ++mixerIt)
+    {
+      for (unsigned int f = 0; f < chunkFrameList->GetNumberOfTrackedFrames(); ++f)
+      {
+        mixerIt->MixFrame(chunkFrameList->GetTrackedFrame(f));
+      }
+    }
+    if (ApplyFrameOperation(chunkFrameList, edit) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (!edit.UpdatedReferenceTransformName.empty() && UpdateReferenceTransform(chunkFrameList, edit.UpdatedReferenceTransformName) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (!isHeaderPrepared)
+    {
+      if (writer->PrepareHeader() != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to prepare header");
+        return PLUS_FAIL;
+      }
+      isHeaderPrepared = true;
+      isData3D = (chunkFrameList->GetTrackedFrame(0)->GetFrameSize()[2] > 1);
+    }
+    if (writer->AppendImagesToHeader() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to append image data to header.");
+      return PLUS_FAIL;
+    }
+    if (writer->WriteImages() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to append images to " << outputFileName);
+      return PLUS_FAIL;
+    }
+    numberOfWrittenFrames += chunkFrameList->GetNumberOfTrackedFrames();
+    LOG_DEBUG("Written frames: " << numberOfWrittenFrames);
+    chunkFrameList->Clear();
+    return PLUS_SUCCESS;
+  };
+
+  const bool readImageData = (edit.Operation != REMOVE_IMAGE_DATA);
+  unsigned int inputFrameIndex = 0; // index of the frame in the appended input sequences
+  double lastTimestamp = 0;
+  for (unsigned int i = 0; i < readers.size(); ++i)
+  {
+    LOG_INFO("Read input sequence file: " << inputFileNames[i]);
+    const double timestampOffset = (incrementTimestamps && edit.Operation != MIX) ? lastTimestamp : 0.0;
+    const unsigned int numberOfFrames = readers[i]->GetNumberOfFrames();
+    for (unsigned int f = 0; f < numberOfFrames; ++f, ++inputFrameIndex)
+    {
+      if (edit.Operation == TRIM && (inputFrameIndex < edit.FirstFrameIndex || inputFrameIndex > edit.LastFrameIndex))
+      {
+        continue;
+      }
+      if (edit.Operation == DECIMATE && inputFrameIndex % edit.DecimationFactor != 0)
+      {
+        continue;
+      }
+      if (readers[i]->ReadFrames(f, 1, chunkFrameList, readImageData) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Couldn't read frame " << f << " of sequence file: " << inputFileNames[i]);
+        return PLUS_FAIL;
+      }
+      if (timestampOffset != 0.0)
+      {
+        igsioTrackedFrame* trackedFrame = chunkFrameList->GetTrackedFrame(chunkFrameList->GetNumberOfTrackedFrames() - 1);
+        trackedFrame->SetTimestamp(timestampOffset + trackedFrame->GetTimestamp());
+      }
+      if (chunkFrameList->GetNumberOfTrackedFrames() >= chunkSize && writeChunk() != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+
+    if (incrementTimestamps && numberOfFrames > 0)
+    {
+      // Next sequence starts at the last timestamp of this sequence (the last frame may have been removed by the operation)
+      vtkSmartPointer<vtkIGSIOTrackedFrameList> lastFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+      if (readers[i]->ReadFrames(numberOfFrames - 1, 1, lastFrameList, false) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Couldn't read last frame of sequence file: " << inputFileNames[i]);
+        return PLUS_FAIL;
+      }
+      lastTimestamp = timestampOffset + lastFrameList->GetTrackedFrame(0)->GetTimestamp();
+    }
+  }
+  if (writeChunk() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (!isHeaderPrepared && writer->PrepareHeader() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to prepare header");
+    return PLUS_FAIL;
+  }
+  writer->UpdateDimensionsCustomStrings(numberOfWrittenFrames, isData3D);
+  writer->UpdateFieldInImageHeader(writer->GetDimensionSizeString());
+  writer->UpdateFieldInImageHeader(writer->GetDimensionKindsString());
+  writer->FinalizeHeader();
+  writer->Close();
+
+  if (compressOnClose && edit.Operation != REMOVE_IMAGE_DATA)
+  {
+    return vtkPlusSequenceIO::CompressSequenceFile(vtkPlusConfig::GetInstance()->GetOutputPath(outputFileName));
+  }
   return PLUS_SUCCESS;
 }
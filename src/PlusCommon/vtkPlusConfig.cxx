@@ -7,6 +7,7 @@
 #include "PlusConfigure.h"
 #include "vtkDirectory.h"
 #include "vtkMatrix4x4.h"
+#include "vtkPlusSequenceIO.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkXMLUtilities.h"
 #include "vtksys/SystemTools.hxx"
@@ -304,6 +305,20 @@ PlusStatus vtkPlusConfig::LoadApplicationConfiguration()
     saveNeeded = true;
   }
 
+  // Read asynchronous logging (messages are written by a background thread, so that slow disk or console output does not block acquisition)
+  const char* asyncLogging = applicationConfigurationRoot->GetAttribute("AsyncLogging");
+  if (asyncLogging != NULL)
+  {
+    vtkPlusLogger::SetAsyncLoggingEnabled(STRCASECMP(asyncLogging, "TRUE") == 0);
+  }
+
+  // Read parallel compression (compressed sequence files are compressed and decompressed by multiple threads)
+  const char* parallelCompression = applicationConfigurationRoot->GetAttribute("ParallelCompression");
+  if (parallelCompression != NULL)
+  {
+    vtkPlusSequenceIO::SetParallelCompressionEnabled(STRCASECMP(parallelCompression, "TRUE") == 0);
+  }
+
   // Read last device set config file
   const char* lastDeviceSetConfigFile = applicationConfigurationRoot->GetAttribute("LastDeviceSetConfigurationFileName");
   if ((lastDeviceSetConfigFile != NULL) && (STRCASECMP(lastDeviceSetConfigFile, "") != 0))
@@ -457,6 +472,26 @@ PlusStatus vtkPlusConfig::WriteApplicationConfiguration()
   // Save log level
   applicationConfigurationRoot->SetIntAttribute("LogLevel", vtkPlusLogger::Instance()->GetLogLevel());
 
+  // Save asynchronous logging (only if it is enabled, as synchronous logging is the default)
+  if (vtkPlusLogger::IsAsyncLoggingEnabled())
+  {
+    applicationConfigurationRoot->SetAttribute("AsyncLogging", "TRUE");
+  }
+  else
+  {
+    applicationConfigurationRoot->RemoveAttribute("AsyncLogging");
+  }
+
+  // Save parallel compression (only if it is enabled, as single-threaded compression is the default)
+  if (vtkPlusSequenceIO::GetParallelCompressionEnabled())
+  {
+    applicationConfigurationRoot->SetAttribute("ParallelCompression", "TRUE");
+  }
+  else
+  {
+    applicationConfigurationRoot->RemoveAttribute("ParallelCompression");
+  }
+
   // Save device set directory
   applicationConfigurationRoot->SetAttribute("DeviceSetConfigurationDirectory", this->DeviceSetConfigurationDirectory.c_str());
 
@@ -6,12 +6,351 @@
 
 #include "PlusConfigure.h"
 #include "PlusCommon.h"
+#include "PlusMetrics.h"
 #include "vtkPlusLogger.h"
 
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 //-----------------------------------------------------------------------------
 namespace
 {
   vtkIGSIOSimpleRecursiveCriticalSection LoggerCreationCriticalSection;
+
+  /*! Number of records in the ring buffer of each thread (must be a power of two) */
+  const size_t THREAD_RING_CAPACITY = 1024;
+  /*! The sink thread checks the ring buffers at least this often */
+  const int SINK_IDLE_PERIOD_MSEC = 5;
+  const char BINARY_LOG_MAGIC[8] = { 'P', 'L', 'U', 'S', 'L', 'O', 'G', '1' };
+
+  struct AsyncLogRecord
+  {
+    double Timestamp;
+    uint64_t ThreadId;
+    vtkIGSIOLogger::LogLevelType Level;
+    const char* FileName;
+    int LineNumber;
+    std::string Message;
+  };
+
+  //-----------------------------------------------------------------------------
+  /*! Single producer (the logging thread), single consumer (the thread that drains the records, see DrainMutex) ring buffer */
+  class AsyncLogThreadRing
+  {
+  public:
+    explicit AsyncLogThreadRing(uint64_t threadId)
+      : ThreadId(threadId), Records(THREAD_RING_CAPACITY), Head(0), Tail(0)
+    {
+    }
+
+    /*! Returns false if the ring is full, in this case the record is left unchanged */
+    bool Push(AsyncLogRecord& record)
+    {
+      size_t tail = this->Tail.load(std::memory_order_relaxed);
+      if (tail - this->Head.load(std::memory_order_acquire) >= THREAD_RING_CAPACITY)
+      {
+        return false;
+      }
+      this->Records[tail & (THREAD_RING_CAPACITY - 1)] = std::move(record);
+      this->Tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    void PopAll(std::vector<AsyncLogRecord>& records)
+    {
+      size_t head = this->Head.load(std::memory_order_relaxed);
+      size_t tail = this->Tail.load(std::memory_order_acquire);
+      for (; head != tail; ++head)
+      {
+        records.push_back(std::move(this->Records[head & (THREAD_RING_CAPACITY - 1)]));
+      }
+      this->Head.store(head, std::memory_order_release);
+    }
+
+    bool IsEmpty() const
+    {
+      return this->Head.load(std::memory_order_acquire) == this->Tail.load(std::memory_order_acquire);
+    }
+
+    const uint64_t ThreadId;
+
+  protected:
+    std::vector<AsyncLogRecord> Records;
+    // Head is written by the consumer, Tail by the producer: keep them on separate cache lines
+    // (padding is used instead of alignas, as over-aligned heap allocation requires C++17)
+    std::atomic<size_t> Head;
+    char Padding[64];
+    std::atomic<size_t> Tail;
+  };
+
+  //-----------------------------------------------------------------------------
+  class AsyncLogBackend
+  {
+  public:
+    static AsyncLogBackend* GetInstance()
+    {
+      static AsyncLogBackend* instance = new AsyncLogBackend;
+      return instance;
+    }
+
+    AsyncLogThreadRing* GetThreadRing()
+    {
+      thread_local std::shared_ptr<AsyncLogThreadRing> threadRing;
+      if (!threadRing)
+      {
+        threadRing = std::make_shared<AsyncLogThreadRing>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::lock_guard<std::mutex> lock(this->Mutex);
+        this->Rings.push_back(threadRing);
+      }
+      return threadRing.get();
+    }
+
+    //-----------------------------------------------------------------------------
+    void Start()
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      if (this->SinkThread.joinable())
+      {
+        return;
+      }
+      if (!this->ExitHandlerRegistered)
+      {
+        std::atexit(&AsyncLogBackend::OnExit);
+        this->ExitHandlerRegistered = true;
+      }
+      this->StopRequested = false;
+      this->SinkThread = std::thread(&AsyncLogBackend::SinkThreadMain, this);
+      this->Enabled.store(true);
+    }
+
+    //-----------------------------------------------------------------------------
+    void Stop()
+    {
+      std::thread sinkThread;
+      {
+        std::lock_guard<std::mutex> lock(this->Mutex);
+        // New messages are logged synchronously from now on
+        this->Enabled.store(false);
+        if (!this->SinkThread.joinable() || this->SinkThread.get_id() == std::this_thread::get_id())
+        {
+          return;
+        }
+        this->StopRequested = true;
+        sinkThread.swap(this->SinkThread);
+      }
+      this->WakeUp.notify_all();
+      sinkThread.join();
+      // Write records that were pushed while the sink thread was stopping
+      this->Drain();
+    }
+
+    //-----------------------------------------------------------------------------
+    void Flush()
+    {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      if (!this->SinkThread.joinable() || this->SinkThread.get_id() == std::this_thread::get_id())
+      {
+        return;
+      }
+      uint64_t flushRequest = ++this->FlushRequested;
+      this->WakeUp.notify_all();
+      this->FlushDone.wait(lock, [this, flushRequest] { return this->FlushCompleted >= flushRequest || !this->SinkThread.joinable(); });
+    }
+
+    //-----------------------------------------------------------------------------
+    bool SetBinaryLogFileName(const std::string& binaryLogFileName)
+    {
+      std::lock_guard<std::mutex> drainLock(this->DrainMutex);
+      if (this->BinaryLogFile.is_open())
+      {
+        this->BinaryLogFile.close();
+      }
+      this->BinaryLogFileName = binaryLogFileName;
+      if (binaryLogFileName.empty())
+      {
+        return true;
+      }
+      this->BinaryLogFile.open(binaryLogFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!this->BinaryLogFile.is_open())
+      {
+        this->BinaryLogFileName.clear();
+        return false;
+      }
+      this->BinaryLogFile.write(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC));
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    std::string GetBinaryLogFileName()
+    {
+      std::lock_guard<std::mutex> drainLock(this->DrainMutex);
+      return this->BinaryLogFileName;
+    }
+
+    /*! Written by any thread, read by the LOG_* macros */
+    std::atomic<bool> Enabled;
+    std::atomic<uint64_t> NumberOfDroppedRecords;
+
+  protected:
+    AsyncLogBackend()
+      : Enabled(false)
+      , NumberOfDroppedRecords(0)
+      , StopRequested(false)
+      , ExitHandlerRegistered(false)
+      , FlushRequested(0)
+      , FlushCompleted(0)
+    {
+    }
+
+    static void OnExit()
+    {
+      AsyncLogBackend::GetInstance()->Stop();
+    }
+
+    //-----------------------------------------------------------------------------
+    /*! Collect the records of all threads and write them in timestamp order. Returns the number of written records. */
+    size_t Drain()
+    {
+      std::vector<std::shared_ptr<AsyncLogThreadRing> > rings;
+      {
+        std::lock_guard<std::mutex> lock(this->Mutex);
+        // Forget rings of threads that have exited (only this list refers to them) once they are empty
+        this->Rings.erase(std::remove_if(this->Rings.begin(), this->Rings.end(), [](const std::shared_ptr<AsyncLogThreadRing>& ring)
+        {
+          return ring.use_count() == 1 && ring->IsEmpty();
+        }), this->Rings.end());
+        rings = this->Rings;
+      }
+
+      std::lock_guard<std::mutex> drainLock(this->DrainMutex);
+      this->DrainedRecords.clear();
+      for (auto it = rings.begin(); it != rings.end(); ++it)
+      {
+        (*it)->PopAll(this->DrainedRecords);
+      }
+      std::stable_sort(this->DrainedRecords.begin(), this->DrainedRecords.end(), [](const AsyncLogRecord& a, const AsyncLogRecord& b)
+      {
+        return a.Timestamp < b.Timestamp;
+      });
+
+      for (auto it = this->DrainedRecords.begin(); it != this->DrainedRecords.end(); ++it)
+      {
+        this->WriteRecord(*it);
+      }
+
+      uint64_t numberOfDroppedRecords = this->NumberOfDroppedRecords.exchange(0);
+      if (numberOfDroppedRecords > 0)
+      {
+        std::ostringstream msg;
+        msg << numberOfDroppedRecords << " log messages were dropped because the logging threads produced them faster than they could be written";
+        AsyncLogRecord dropReport;
+        dropReport.Timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+        dropReport.ThreadId = std::hash<std::thread::id>()(std::this_thread::get_id());
+        dropReport.Level = vtkIGSIOLogger::LOG_LEVEL_WARNING;
+        dropReport.FileName = __FILE__;
+        dropReport.LineNumber = __LINE__;
+        dropReport.Message = msg.str();
+        this->WriteRecord(dropReport);
+      }
+
+      if (this->BinaryLogFile.is_open() && (!this->DrainedRecords.empty() || numberOfDroppedRecords > 0))
+      {
+        this->BinaryLogFile.flush();
+      }
+
+      return this->DrainedRecords.size();
+    }
+
+    //-----------------------------------------------------------------------------
+    /*!
+      Write a record to the binary log and the synchronous logger. The synchronous logger prefixes each line with the
+      time of writing, so the time when the message was logged is passed as the optional prefix of the line.
+    */
+    void WriteRecord(const AsyncLogRecord& record)
+    {
+      if (this->BinaryLogFile.is_open())
+      {
+        this->WriteBinaryRecord(record);
+      }
+      std::ostringstream timestamp;
+      timestamp << std::fixed << std::setprecision(6) << record.Timestamp;
+      vtkPlusLogger::Instance()->LogMessage(record.Level, record.Message, record.FileName, record.LineNumber, timestamp.str().c_str());
+    }
+
+    //-----------------------------------------------------------------------------
+    void WriteBinaryRecord(const AsyncLogRecord& record)
+    {
+      int32_t level = static_cast<int32_t>(record.Level);
+      int32_t lineNumber = static_cast<int32_t>(record.LineNumber);
+      uint32_t fileNameLength = static_cast<uint32_t>(record.FileName ? strlen(record.FileName) : 0);
+      uint32_t messageLength = static_cast<uint32_t>(record.Message.size());
+      this->BinaryLogFile.write(reinterpret_cast<const char*>(&record.Timestamp), sizeof(record.Timestamp));
+      this->BinaryLogFile.write(reinterpret_cast<const char*>(&record.ThreadId), sizeof(record.ThreadId));
+      this->BinaryLogFile.write(reinterpret_cast<const char*>(&level), sizeof(level));
+      this->BinaryLogFile.write(reinterpret_cast<const char*>(&lineNumber), sizeof(lineNumber));
+      this->BinaryLogFile.write(reinterpret_cast<const char*>(&fileNameLength), sizeof(fileNameLength));
+      this->BinaryLogFile.write(reinterpret_cast<const char*>(&messageLength), sizeof(messageLength));
+      this->BinaryLogFile.write(record.FileName, fileNameLength);
+      this->BinaryLogFile.write(record.Message.data(), messageLength);
+    }
+
+    //-----------------------------------------------------------------------------
+    void SinkThreadMain()
+    {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      while (true)
+      {
+        bool stopRequested = this->StopRequested;
+        uint64_t flushRequested = this->FlushRequested;
+        lock.unlock();
+
+        size_t numberOfWrittenRecords = this->Drain();
+
+        lock.lock();
+        this->FlushCompleted = flushRequested;
+        this->FlushDone.notify_all();
+        if (stopRequested)
+        {
+          break;
+        }
+        if (numberOfWrittenRecords == 0 && this->FlushRequested == this->FlushCompleted && !this->StopRequested)
+        {
+          this->WakeUp.wait_for(lock, std::chrono::milliseconds(SINK_IDLE_PERIOD_MSEC));
+        }
+      }
+      this->FlushDone.notify_all();
+    }
+
+    /*! Guards Rings, SinkThread, and the flush and stop requests */
+    std::mutex Mutex;
+    std::condition_variable WakeUp;
+    std::condition_variable FlushDone;
+    std::vector<std::shared_ptr<AsyncLogThreadRing> > Rings;
+    std::thread SinkThread;
+    bool StopRequested;
+    bool ExitHandlerRegistered;
+    uint64_t FlushRequested;
+    uint64_t FlushCompleted;
+
+    /*! Only one thread may consume records of the rings; also guards the binary log file */
+    std::mutex DrainMutex;
+    std::vector<AsyncLogRecord> DrainedRecords;
+    std::ofstream BinaryLogFile;
+    std::string BinaryLogFileName;
+  };
 }
 
 //-------------------------------------------------------
@@ -54,3 +393,72 @@ vtkIGSIOLogger* vtkPlusLogger::Instance()
 
   return m_pInstance;
 }
+
+//-------------------------------------------------------
+void vtkPlusLogger::SetAsyncLoggingEnabled(bool enable)
+{
+  if (enable)
+  {
+    AsyncLogBackend::GetInstance()->Start();
+  }
+  else
+  {
+    AsyncLogBackend::GetInstance()->Stop();
+  }
+}
+
+//-------------------------------------------------------
+bool vtkPlusLogger::IsAsyncLoggingEnabled()
+{
+  return AsyncLogBackend::GetInstance()->Enabled.load(std::memory_order_relaxed);
+}
+
+//-------------------------------------------------------
+bool vtkPlusLogger::SetBinaryLogFileName(const std::string& binaryLogFileName)
+{
+  return AsyncLogBackend::GetInstance()->SetBinaryLogFileName(binaryLogFileName);
+}
+
+//-------------------------------------------------------
+std::string vtkPlusLogger::GetBinaryLogFileName()
+{
+  return AsyncLogBackend::GetInstance()->GetBinaryLogFileName();
+}
+
+//-------------------------------------------------------
+void vtkPlusLogger::LogMessageAsync(LogLevelType level, std::string&& message, const char* fileName, int lineNumber)
+{
+  AsyncLogBackend* backend = AsyncLogBackend::GetInstance();
+  if (!backend->Enabled.load(std::memory_order_relaxed))
+  {
+    Instance()->LogMessage(level, message, fileName, lineNumber);
+    return;
+  }
+
+  AsyncLogThreadRing* ring = backend->GetThreadRing();
+  AsyncLogRecord record;
+  record.Timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  record.ThreadId = ring->ThreadId;
+  record.Level = level;
+  record.FileName = fileName;
+  record.LineNumber = lineNumber;
+  record.Message = std::move(message);
+  if (ring->Push(record))
+  {
+    return;
+  }
+  if (level <= LOG_LEVEL_WARNING)
+  {
+    // Errors and warnings are never dropped: if the ring is full then they are written in the calling thread
+    Instance()->LogMessage(level, record.Message, fileName, lineNumber);
+    return;
+  }
+  backend->NumberOfDroppedRecords.fetch_add(1, std::memory_order_relaxed);
+  PLUS_METRIC_COUNTER_ADD("plus_log_dropped_messages_total", "", 1);
+}
+
+//-------------------------------------------------------
+void vtkPlusLogger::FlushAsyncLog()
+{
+  AsyncLogBackend::GetInstance()->Flush();
+}
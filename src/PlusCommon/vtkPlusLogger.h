@@ -13,9 +13,32 @@
 // PlusCommon includes
 #include "vtkPlusCommonExport.h"
 
+// STL includes
+#include <sstream>
+#include <string>
+#include <utility>
+
 /*!
   \class vtkPlusLogger
-  \brief Class to abstract away specific sequence file read/write details
+  \brief Plus logger, with an optional asynchronous backend
+
+  By default messages are written synchronously by vtkIGSIOLogger (to the log file, the console, and the observers)
+  in the thread that logs the message, which may block acquisition threads if the disk or the console is slow.
+
+  If asynchronous logging is enabled then the LOG_* macros only format the message text and push a record into a
+  lock-free ring buffer that belongs to the calling thread. A single background sink thread collects the records of
+  all threads, orders them by timestamp, and writes them using the synchronous logger. The time when the message was
+  logged is written in the line as prefix of the message. The logging thread does not wait for the sink: if the ring
+  buffer of the thread is full then an error or warning is written synchronously in the logging thread, while any
+  other record is dropped and the number of dropped records is reported by the sink (and in the
+  plus_log_dropped_messages_total metric).
+
+  If a binary log file is set then the sink also writes each record in a structured binary format:
+  an 8-byte "PLUSLOG1" file header followed by records of
+  timestamp (double, system time in seconds), thread ID (uint64), level (int32), line (int32),
+  file name length (uint32), message length (uint32), file name, message (without terminating zero),
+  all in the native byte order.
+
   \ingroup PlusLibCommon
 */
 class vtkPlusCommonExport vtkPlusLogger : public vtkIGSIOLogger
@@ -23,9 +46,74 @@ class vtkPlusCommonExport vtkPlusLogger : public vtkIGSIOLogger
 public:
   static vtkIGSIOLogger* Instance();
 
+  /*!
+    Enable or disable asynchronous logging. When enabled, the sink thread is started.
+    When disabled, the records that are already queued are written and the sink thread is stopped.
+  */
+  static void SetAsyncLoggingEnabled(bool enable);
+  static bool IsAsyncLoggingEnabled();
+
+  /*!
+    Set the file where structured binary records are written by the sink thread. Empty string disables binary logging.
+    Returns false if the file cannot be opened.
+  */
+  static bool SetBinaryLogFileName(const std::string& binaryLogFileName);
+  static std::string GetBinaryLogFileName();
+
+  /*!
+    Queue a message for the sink thread. If the ring buffer of the calling thread is full then errors and warnings are logged
+    synchronously and other messages are dropped.
+    If asynchronous logging is not enabled then the message is logged synchronously.
+    \param fileName Name of the source file, it must be a string literal (only the pointer is stored)
+  */
+  static void LogMessageAsync(LogLevelType level, std::string&& message, const char* fileName, int lineNumber);
+
+  /*! Wait until all records that were queued before this call are written */
+  static void FlushAsyncLog();
+
+  /*! Log a message through the asynchronous backend if it is enabled, otherwise through the synchronous logger */
+  static void DispatchMessage(LogLevelType level, std::string&& message, const char* fileName, int lineNumber)
+  {
+    if (IsAsyncLoggingEnabled())
+    {
+      LogMessageAsync(level, std::move(message), fileName, lineNumber);
+    }
+    else
+    {
+      Instance()->LogMessage(level, message, fileName, lineNumber);
+    }
+  }
+
 private:
   vtkPlusLogger();
   ~vtkPlusLogger();
 };
 
-#endif // __vtkPlusLogger_h 
+//----------------------------------------------------------------------------
+// Logging macros. They replace the vtkIGSIOLogger macros so that messages are routed through the asynchronous
+// backend when it is enabled. The message is not formatted at all if the log level filters it out.
+
+#undef LOG_ERROR
+#undef LOG_WARNING
+#undef LOG_INFO
+#undef LOG_DEBUG
+#undef LOG_TRACE
+#undef LOG_DYNAMIC
+
+#define LOG_DYNAMIC(msg, logLevel) \
+  { \
+    if (vtkPlusLogger::Instance()->GetLogLevel() >= (logLevel)) \
+    { \
+      std::ostringstream plusLogMsgStream; \
+      plusLogMsgStream << msg; \
+      vtkPlusLogger::DispatchMessage(static_cast<vtkIGSIOLogger::LogLevelType>(logLevel), plusLogMsgStream.str(), __FILE__, __LINE__); \
+    } \
+  }
+
+#define LOG_ERROR(msg) LOG_DYNAMIC(msg, vtkIGSIOLogger::LOG_LEVEL_ERROR)
+#define LOG_WARNING(msg) LOG_DYNAMIC(msg, vtkIGSIOLogger::LOG_LEVEL_WARNING)
+#define LOG_INFO(msg) LOG_DYNAMIC(msg, vtkIGSIOLogger::LOG_LEVEL_INFO)
+#define LOG_DEBUG(msg) LOG_DYNAMIC(msg, vtkIGSIOLogger::LOG_LEVEL_DEBUG)
+#define LOG_TRACE(msg) LOG_DYNAMIC(msg, vtkIGSIOLogger::LOG_LEVEL_TRACE)
+
+#endif // __vtkPlusLogger_h
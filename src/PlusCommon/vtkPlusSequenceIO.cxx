@@ -5,13 +5,223 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusParallelZlibCodec.h"
 #include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
 
 #include <vtkIGSIOSequenceIO.h>
+#include <vtkIGSIOTrackedFrameList.h>
 
 /// VTK includes
 #include <vtkNew.h>
 
+// STL includes
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+  std::atomic<bool> ParallelCompressionEnabled(false);
+  std::atomic<unsigned int> CompressionNumberOfThreads(0);
+
+  const double BYTES_PER_MB = 1024.0 * 1024.0;
+
+  /*! Header lines of a sequence file and the location of its pixel data */
+  struct SequenceFileHeader
+  {
+    std::vector<std::string> Lines;
+    /*! Index of the line that specifies the compression (CompressedData or encoding field), -1 if there is no such line */
+    int CompressionLineIndex;
+    /*! Index of the line that specifies the pixel data file (ElementDataFile or data file field), -1 if there is no such line */
+    int DataFileLineIndex;
+    bool Compressed;
+    /*! Pixel data file, empty if the pixel data is stored in the header file */
+    std::string DataFileName;
+    std::streamoff DataOffset;
+    SequenceFileHeader() : CompressionLineIndex(-1), DataFileLineIndex(-1), Compressed(false), DataOffset(0) {}
+  };
+
+  //----------------------------------------------------------------------------
+  bool IsMetaImageFile(const std::string& filename)
+  {
+    std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+    return extension == ".mha" || extension == ".mhd";
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsNrrdFile(const std::string& filename)
+  {
+    std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+    return extension == ".nrrd" || extension == ".nhdr";
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Get the full path of a pixel data file that is specified in the header. Returns false if the data is split into multiple files. */
+  bool GetDataFilePath(const std::string& headerFileName, const std::string& dataFileName, std::string& dataFilePath)
+  {
+    if (igsioCommon::IsEqualInsensitive(dataFileName, "LIST") || dataFileName.find('%') != std::string::npos || dataFileName.find(' ') != std::string::npos)
+    {
+      return false;
+    }
+    dataFilePath = dataFileName;
+    if (!vtksys::SystemTools::FileIsFullPath(dataFilePath.c_str()))
+    {
+      dataFilePath = vtksys::SystemTools::GetFilenamePath(headerFileName) + "/" + dataFileName;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ReadMetaImageHeader(const std::string& filename, std::ifstream& file, SequenceFileHeader& header)
+  {
+    std::string line;
+    while (std::getline(file, line))
+    {
+      std::size_t separatorPos = line.find('=');
+      std::string name = igsioCommon::Trim(line.substr(0, separatorPos));
+      std::string value = (separatorPos == std::string::npos ? std::string() : igsioCommon::Trim(line.substr(separatorPos + 1)));
+      if (name == "CompressedDataSize" || name == "CompressedDataChunkSize" || name == "CompressedDataChunkStreamSizes")
+      {
+        // these are written again with the new values
+        continue;
+      }
+      if (name == "CompressedData")
+      {
+        header.Compressed = igsioCommon::IsEqualInsensitive(value, "True");
+        header.CompressionLineIndex = static_cast<int>(header.Lines.size());
+      }
+      else if (name == "ElementDataFile")
+      {
+        // This is always the last field of the header
+        header.DataFileLineIndex = static_cast<int>(header.Lines.size());
+        header.Lines.push_back(line);
+        if (igsioCommon::IsEqualInsensitive(value, "LOCAL"))
+        {
+          header.DataOffset = file.tellg();
+        }
+        else if (!GetDataFilePath(filename, value, header.DataFileName))
+        {
+          LOG_ERROR("Sequence file with multiple pixel data files cannot be compressed: " << filename);
+          return PLUS_FAIL;
+        }
+        return PLUS_SUCCESS;
+      }
+      header.Lines.push_back(line);
+    }
+    LOG_ERROR("ElementDataFile field is not found in sequence file header: " << filename);
+    return PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ReadNrrdHeader(const std::string& filename, std::ifstream& file, SequenceFileHeader& header)
+  {
+    std::string line;
+    if (!std::getline(file, line) || line.compare(0, 4, "NRRD") != 0)
+    {
+      LOG_ERROR("Invalid NRRD file: " << filename);
+      return PLUS_FAIL;
+    }
+    header.Lines.push_back(line);
+    bool encodingFound = false;
+    while (std::getline(file, line))
+    {
+      if (igsioCommon::Trim(line).empty())
+      {
+        // end of the header, attached data follows
+        break;
+      }
+      std::size_t separatorPos = line.find(':');
+      if (line[0] != '#' && separatorPos != std::string::npos && line.compare(separatorPos, 3, ":=") != 0)
+      {
+        std::string name = vtksys::SystemTools::LowerCase(igsioCommon::Trim(line.substr(0, separatorPos)));
+        std::string value = igsioCommon::Trim(line.substr(separatorPos + 1));
+        if (name == "encoding")
+        {
+          encodingFound = true;
+          header.CompressionLineIndex = static_cast<int>(header.Lines.size());
+          header.Compressed = (value == "gzip" || value == "gz");
+          if (!header.Compressed && value != "raw")
+          {
+            LOG_ERROR("NRRD file with " << value << " encoding cannot be compressed: " << filename);
+            return PLUS_FAIL;
+          }
+        }
+        else if (name == "data file" || name == "datafile")
+        {
+          header.DataFileLineIndex = static_cast<int>(header.Lines.size());
+          if (!GetDataFilePath(filename, value, header.DataFileName))
+          {
+            LOG_ERROR("Sequence file with multiple pixel data files cannot be compressed: " << filename);
+            return PLUS_FAIL;
+          }
+        }
+      }
+      header.Lines.push_back(line);
+    }
+    if (!encodingFound)
+    {
+      LOG_ERROR("Encoding field is not found in NRRD file header: " << filename);
+      return PLUS_FAIL;
+    }
+    header.DataOffset = header.DataFileName.empty() ? static_cast<std::streamoff>(file.tellg()) : 0;
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns true if the header of a MetaImage file specifies pixel data that is compressed in chunks by CompressSequenceFile */
+  bool IsChunkCompressedMetaImageFile(const std::string& filename)
+  {
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    std::string line;
+    while (std::getline(file, line))
+    {
+      std::size_t separatorPos = line.find('=');
+      std::string name = igsioCommon::Trim(line.substr(0, separatorPos));
+      if (name == "CompressedData")
+      {
+        std::string value = (separatorPos == std::string::npos ? std::string() : igsioCommon::Trim(line.substr(separatorPos + 1)));
+        if (!igsioCommon::IsEqualInsensitive(value, "True"))
+        {
+          return false;
+        }
+      }
+      else if (name == "CompressedDataChunkStreamSizes")
+      {
+        return true;
+      }
+      else if (name == "ElementDataFile")
+      {
+        // This is always the last field of the header
+        return false;
+      }
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteHeaderLines(const std::vector<std::string>& lines, std::ostream& output)
+  {
+    for (std::vector<std::string>::const_iterator lineIt = lines.begin(); lineIt != lines.end(); ++lineIt)
+    {
+      output << *lineIt << "\n";
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Copy the whole content of a file to the end of the output */
+  PlusStatus AppendFile(const std::string& filename, std::ostream& output)
+  {
+    std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!input.is_open())
+    {
+      return PLUS_FAIL;
+    }
+    output << input.rdbuf();
+    return output ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+}
+
 //----------------------------------------------------------------------------
 igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, US_IMAGE_ORIENTATION orientationInFile/*=US_IMG_ORIENT_MF*/, bool useCompression/*=true*/, bool enableImageDataWrite/*=true*/)
 {
@@ -20,6 +230,14 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, vtkIGSIOTracke
   {
     outputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   }
+  if (useCompression && enableImageDataWrite && GetParallelCompressionEnabled() && CanCompressSequenceFile(filename))
+  {
+    if (vtkIGSIOSequenceIO::Write(filename, outputDirectory, frameList, orientationInFile, false, enableImageDataWrite) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    return CompressSequenceFile(outputDirectory.empty() ? filename : vtkPlusConfig::GetInstance()->GetOutputPath(filename));
+  }
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frameList, orientationInFile, useCompression, enableImageDataWrite);
 }
 
@@ -31,6 +249,14 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, igsioTrackedFr
   {
     outputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   }
+  if (useCompression && enableImageDataWrite && GetParallelCompressionEnabled() && CanCompressSequenceFile(filename))
+  {
+    if (vtkIGSIOSequenceIO::Write(filename, outputDirectory, frame, orientationInFile, false, enableImageDataWrite) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    return CompressSequenceFile(outputDirectory.empty() ? filename : vtkPlusConfig::GetInstance()->GetOutputPath(filename));
+  }
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frame, orientationInFile, useCompression, enableImageDataWrite);
 }
 
@@ -48,5 +274,235 @@ igsioStatus vtkPlusSequenceIO::Read(const std::string& trackedSequenceDataFileNa
       return PLUS_FAIL;
     }
   }
+
+  // Files that were compressed in chunks are decompressed in parallel
+  if (frameList != NULL && IsMetaImageFile(trackedSequenceDataFilePath) && IsChunkCompressedMetaImageFile(trackedSequenceDataFilePath))
+  {
+    vtkSmartPointer<vtkPlusSequenceStreamReader> reader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+    reader->SetReadCompressedData(true);
+    reader->SetUseMemoryMapping(true);
+    reader->SetNumberOfDecompressionThreads(GetCompressionNumberOfThreads());
+    if (reader->Open(trackedSequenceDataFilePath) == PLUS_SUCCESS)
+    {
+      const std::map<std::string, std::string>& headerFields = reader->GetCustomHeaderFields();
+      for (std::map<std::string, std::string>::const_iterator fieldIt = headerFields.begin(); fieldIt != headerFields.end(); ++fieldIt)
+      {
+        frameList->SetCustomString(fieldIt->first, fieldIt->second);
+      }
+      return reader->ReadFrames(0, reader->GetNumberOfFrames(), frameList);
+    }
+  }
+
   return vtkIGSIOSequenceIO::Read(trackedSequenceDataFilePath, frameList);
 }
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceIO::SetParallelCompressionEnabled(bool enable)
+{
+  ParallelCompressionEnabled = enable;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceIO::GetParallelCompressionEnabled()
+{
+  return ParallelCompressionEnabled;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceIO::SetCompressionNumberOfThreads(unsigned int numberOfThreads)
+{
+  CompressionNumberOfThreads = numberOfThreads;
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusSequenceIO::GetCompressionNumberOfThreads()
+{
+  return CompressionNumberOfThreads;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceIO::CanCompressSequenceFile(const std::string& filename)
+{
+  return IsMetaImageFile(filename) || IsNrrdFile(filename);
+}
+
+//----------------------------------------------------------------------------
+igsioStatus vtkPlusSequenceIO::CompressSequenceFile(const std::string& filename)
+{
+  if (!CanCompressSequenceFile(filename))
+  {
+    LOG_ERROR("Sequence file format cannot be compressed: " << filename);
+    return PLUS_FAIL;
+  }
+
+  const bool metaImage = IsMetaImageFile(filename);
+  SequenceFileHeader header;
+  std::ifstream headerFile(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!headerFile.is_open())
+  {
+    LOG_ERROR("Failed to open sequence file for compression: " << filename);
+    return PLUS_FAIL;
+  }
+  if ((metaImage ? ReadMetaImageHeader(filename, headerFile, header) : ReadNrrdHeader(filename, headerFile, header)) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (header.Compressed)
+  {
+    LOG_DEBUG("Sequence file is already compressed: " << filename);
+    return PLUS_SUCCESS;
+  }
+
+  // Compress the pixel data into a separate file. For files with attached pixel data this is a temporary file,
+  // which is appended to the updated header.
+  const bool dataAttached = header.DataFileName.empty();
+  std::string compressedDataFileName;
+  if (dataAttached)
+  {
+    compressedDataFileName = filename + ".compressed.tmp";
+  }
+  else if (metaImage)
+  {
+    compressedDataFileName = vtksys::SystemTools::GetFilenamePath(header.DataFileName) + "/" + vtksys::SystemTools::GetFilenameWithoutLastExtension(header.DataFileName) + ".zraw";
+  }
+  else
+  {
+    compressedDataFileName = header.DataFileName + ".gz";
+  }
+
+  std::ifstream dataFile;
+  if (dataAttached)
+  {
+    headerFile.clear();
+    headerFile.seekg(0, std::ios::end);
+  }
+  else
+  {
+    headerFile.close();
+    dataFile.open(header.DataFileName.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!dataFile.is_open())
+    {
+      LOG_ERROR("Failed to open sequence pixel data file for compression: " << header.DataFileName);
+      return PLUS_FAIL;
+    }
+  }
+  std::ifstream& input = dataAttached ? headerFile : dataFile;
+  const std::streamoff dataEnd = input.tellg();
+  if (dataEnd < header.DataOffset)
+  {
+    LOG_ERROR("Sequence pixel data is truncated: " << filename);
+    return PLUS_FAIL;
+  }
+  const uint64_t uncompressedSize = static_cast<uint64_t>(dataEnd - header.DataOffset);
+  input.seekg(header.DataOffset);
+
+  PlusParallelZlibCodec codec;
+  codec.SetNumberOfThreads(GetCompressionNumberOfThreads());
+  std::vector<uint64_t> chunkStreamSizes;
+  {
+    std::ofstream compressedDataFile(compressedDataFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!compressedDataFile.is_open())
+    {
+      LOG_ERROR("Failed to open file for writing compressed pixel data: " << compressedDataFileName);
+      return PLUS_FAIL;
+    }
+    if (codec.Compress(input, uncompressedSize, metaImage ? PlusParallelZlibCodec::FORMAT_ZLIB : PlusParallelZlibCodec::FORMAT_GZIP, compressedDataFile, &chunkStreamSizes) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to compress pixel data of " << filename);
+      compressedDataFile.close();
+      vtksys::SystemTools::RemoveFile(compressedDataFileName.c_str());
+      return PLUS_FAIL;
+    }
+  }
+  input.close();
+  const PlusParallelZlibCodec::Statistics& statistics = codec.GetLastStatistics();
+
+  // Update the header
+  std::vector<std::string> lines;
+  for (int i = 0; i < static_cast<int>(header.Lines.size()); ++i)
+  {
+    if (metaImage && i == header.CompressionLineIndex)
+    {
+      lines.push_back("CompressedData = True");
+      lines.push_back("CompressedDataSize = " + igsioCommon::ToString<uint64_t>(statistics.CompressedSize));
+    }
+    else if (metaImage && i == header.DataFileLineIndex)
+    {
+      if (header.CompressionLineIndex < 0)
+      {
+        lines.push_back("CompressedData = True");
+        lines.push_back("CompressedDataSize = " + igsioCommon::ToString<uint64_t>(statistics.CompressedSize));
+      }
+      std::ostringstream chunkStreamSizesStr;
+      for (std::vector<uint64_t>::iterator sizeIt = chunkStreamSizes.begin(); sizeIt != chunkStreamSizes.end(); ++sizeIt)
+      {
+        chunkStreamSizesStr << (sizeIt == chunkStreamSizes.begin() ? "" : " ") << *sizeIt;
+      }
+      lines.push_back("CompressedDataChunkSize = " + igsioCommon::ToString<uint64_t>(codec.GetChunkSize()));
+      lines.push_back("CompressedDataChunkStreamSizes = " + chunkStreamSizesStr.str());
+      lines.push_back("ElementDataFile = " + (dataAttached ? std::string("LOCAL") : vtksys::SystemTools::GetFilenameName(compressedDataFileName)));
+    }
+    else if (!metaImage && i == header.CompressionLineIndex)
+    {
+      lines.push_back("encoding: gzip");
+    }
+    else if (!metaImage && i == header.DataFileLineIndex)
+    {
+      lines.push_back("data file: " + vtksys::SystemTools::GetFilenameName(compressedDataFileName));
+    }
+    else
+    {
+      lines.push_back(header.Lines[i]);
+    }
+  }
+
+  // Write the updated header (and the attached pixel data) to a temporary file, then replace the original file
+  const std::string updatedFileName = filename + ".tmp";
+  {
+    std::ofstream updatedFile(updatedFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    WriteHeaderLines(lines, updatedFile);
+    if (dataAttached)
+    {
+      if (!metaImage)
+      {
+        // NRRD header is terminated by an empty line
+        updatedFile << "\n";
+      }
+      if (AppendFile(compressedDataFileName, updatedFile) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to write compressed sequence file: " << updatedFileName);
+        updatedFile.close();
+        vtksys::SystemTools::RemoveFile(updatedFileName.c_str());
+        vtksys::SystemTools::RemoveFile(compressedDataFileName.c_str());
+        return PLUS_FAIL;
+      }
+    }
+    if (!updatedFile)
+    {
+      LOG_ERROR("Failed to write compressed sequence file: " << updatedFileName);
+      updatedFile.close();
+      vtksys::SystemTools::RemoveFile(updatedFileName.c_str());
+      vtksys::SystemTools::RemoveFile(compressedDataFileName.c_str());
+      return PLUS_FAIL;
+    }
+  }
+  if (!vtksys::SystemTools::RenameFile(updatedFileName.c_str(), filename.c_str()))
+  {
+    LOG_ERROR("Failed to rename compressed sequence file " << updatedFileName << " to " << filename);
+    return PLUS_FAIL;
+  }
+  if (dataAttached)
+  {
+    vtksys::SystemTools::RemoveFile(compressedDataFileName.c_str());
+  }
+  else if (compressedDataFileName != header.DataFileName)
+  {
+    vtksys::SystemTools::RemoveFile(header.DataFileName.c_str());
+  }
+
+  LOG_INFO("Compressed sequence file " << filename << ": " << std::fixed << std::setprecision(1)
+           << statistics.UncompressedSize / BYTES_PER_MB << " MB to " << statistics.CompressedSize / BYTES_PER_MB << " MB (ratio "
+           << std::setprecision(2) << statistics.GetCompressionRatio() << ") at " << std::setprecision(1) << statistics.GetThroughputMBPerSec()
+           << " MB/s using " << statistics.NumberOfThreads << " threads");
+  return PLUS_SUCCESS;
+}
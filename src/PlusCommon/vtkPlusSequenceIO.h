@@ -12,6 +12,14 @@
 /*!
   \class vtkPlusSequenceIO
   \brief Class to abstract away specific sequence file read/write details
+
+  If parallel compression is enabled then compressed MetaImage (.mha, .mhd) and NRRD (.nrrd, .nhdr) files are written
+  uncompressed first and then compressed by multiple threads (see CompressSequenceFile). The result is a standard
+  zlib/gzip compressed file that any reader can open, but it is not identical to the output of the single-threaded
+  compression, therefore parallel compression is disabled by default.
+
+  Compressed MetaImage files that were written with parallel compression are decompressed by multiple threads in Read.
+
   \ingroup PlusLibCommon
 */
 class vtkPlusCommonExport vtkPlusSequenceIO : public vtkObject
@@ -26,6 +34,24 @@ public:
   /*! Read file contents into the object */
   static igsioStatus Read(const std::string& filename, vtkIGSIOTrackedFrameList* frameList);
 
+  /*! Enable compressing sequence files by multiple threads when they are written with compression */
+  static void SetParallelCompressionEnabled(bool enable);
+  static bool GetParallelCompressionEnabled();
+
+  /*! Number of threads that are used for parallel compression and decompression. 0 means the number of processor cores. */
+  static void SetCompressionNumberOfThreads(unsigned int numberOfThreads);
+  static unsigned int GetCompressionNumberOfThreads();
+
+  /*! Returns true if the file format can be compressed by CompressSequenceFile */
+  static bool CanCompressSequenceFile(const std::string& filename);
+
+  /*!
+    Compress an uncompressed MetaImage or NRRD sequence file in place, using multiple threads.
+    The compressed size of each data chunk is stored in MetaImage headers so that the file can be decompressed in parallel.
+    Compression ratio and throughput are logged. Files that are already compressed are not modified.
+  */
+  static igsioStatus CompressSequenceFile(const std::string& filename);
+
 protected:
   vtkPlusSequenceIO();
   virtual ~vtkPlusSequenceIO();
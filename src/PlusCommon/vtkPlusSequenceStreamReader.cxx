@@ -0,0 +1,841 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusParallelZlibCodec.h"
+#include "vtkPlusSequenceStreamReader.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <thread>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+vtkStandardNewMacro(vtkPlusSequenceStreamReader);
+
+namespace
+{
+  const std::string SEQUENCE_FIELD_PREFIX = "Seq_Frame";
+
+  // Header fields that describe the file layout. These are not passed through as custom fields.
+  const char* LAYOUT_HEADER_FIELDS[] =
+  {
+    "ObjectType", "NDims", "DimSize", "ElementType", "ElementNumberOfChannels", "BinaryData", "BinaryDataByteOrderMSB",
+    "CompressedData", "CompressedDataSize", "CompressedDataChunkSize", "CompressedDataChunkStreamSizes", "ElementDataFile", "Kinds",
+    "UltrasoundImageOrientation", NULL
+  };
+
+  //----------------------------------------------------------------------------
+  bool IsLayoutHeaderField(const std::string& name)
+  {
+    for (int i = 0; LAYOUT_HEADER_FIELDS[i] != NULL; ++i)
+    {
+      if (name == LAYOUT_HEADER_FIELDS[i])
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Split a "name = value" header line. Returns false if the line is not a field. */
+  bool ParseHeaderLine(const std::string& line, std::string& name, std::string& value)
+  {
+    std::size_t separatorPos = line.find('=');
+    if (separatorPos == std::string::npos)
+    {
+      return false;
+    }
+    name = igsioCommon::Trim(line.substr(0, separatorPos));
+    value = igsioCommon::Trim(line.substr(separatorPos + 1));
+    return !name.empty();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Get frame index and field name from a Seq_FrameNNNN_FieldName header field name. Returns false if it is not a frame field. */
+  bool ParseFrameFieldName(const std::string& headerFieldName, unsigned int& frameIndex, std::string& frameFieldName)
+  {
+    if (headerFieldName.compare(0, SEQUENCE_FIELD_PREFIX.size(), SEQUENCE_FIELD_PREFIX) != 0)
+    {
+      return false;
+    }
+    std::size_t separatorPos = headerFieldName.find('_', SEQUENCE_FIELD_PREFIX.size());
+    if (separatorPos == std::string::npos)
+    {
+      return false;
+    }
+    if (igsioCommon::StringToNumber<unsigned int>(headerFieldName.substr(SEQUENCE_FIELD_PREFIX.size(), separatorPos - SEQUENCE_FIELD_PREFIX.size()), frameIndex) != PLUS_SUCCESS)
+    {
+      return false;
+    }
+    frameFieldName = headerFieldName.substr(separatorPos + 1);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  bool GetPixelTypeFromElementType(const std::string& elementType, igsioCommon::VTKScalarPixelType& pixelType)
+  {
+    const struct
+    {
+      const char* ElementType;
+      igsioCommon::VTKScalarPixelType PixelType;
+    } elementTypes[] =
+    {
+      { "MET_CHAR", VTK_CHAR }, { "MET_UCHAR", VTK_UNSIGNED_CHAR }, { "MET_SHORT", VTK_SHORT }, { "MET_USHORT", VTK_UNSIGNED_SHORT },
+      { "MET_INT", VTK_INT }, { "MET_UINT", VTK_UNSIGNED_INT }, { "MET_LONG", VTK_LONG }, { "MET_ULONG", VTK_UNSIGNED_LONG },
+      { "MET_FLOAT", VTK_FLOAT }, { "MET_DOUBLE", VTK_DOUBLE }, { NULL, VTK_VOID }
+    };
+    for (int i = 0; elementTypes[i].ElementType != NULL; ++i)
+    {
+      if (elementType == elementTypes[i].ElementType)
+      {
+        pixelType = elementTypes[i].PixelType;
+        return true;
+      }
+    }
+    return false;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusSequenceStreamReader::vtkPlusSequenceStreamReader()
+  : PixelDataOffset(0)
+  , NumberOfFrames(0)
+  , PixelType(VTK_UNSIGNED_CHAR)
+  , NumberOfScalarComponents(1)
+  , ImageType(US_IMG_BRIGHTNESS)
+  , ImageOrientationInFile(US_IMG_ORIENT_MF)
+  , FrameSizeInBytes(0)
+  , UseMemoryMapping(false)
+  , MappedPixelData(NULL)
+  , MappedPixelDataSize(0)
+  , ReadCompressedData(false)
+  , NumberOfDecompressionThreads(0)
+  , PixelDataCompressed(false)
+  , CompressedDataChunkSize(0)
+  , DecompressedFirstChunkIndex(0)
+  , NumberOfDecompressedChunks(0)
+#ifdef _WIN32
+  , PixelDataFileHandle(NULL)
+  , PixelDataMappingHandle(NULL)
+#endif
+{
+  this->FrameSize[0] = 0;
+  this->FrameSize[1] = 0;
+  this->FrameSize[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusSequenceStreamReader::~vtkPlusSequenceStreamReader()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << this->FileName << std::endl;
+  os << indent << "NumberOfFrames: " << this->NumberOfFrames << std::endl;
+  os << indent << "FrameSize: " << this->FrameSize[0] << " " << this->FrameSize[1] << " " << this->FrameSize[2] << std::endl;
+  os << indent << "PixelType: " << vtkImageScalarTypeNameMacro(this->PixelType) << std::endl;
+  os << indent << "NumberOfScalarComponents: " << this->NumberOfScalarComponents << std::endl;
+  os << indent << "ImageOrientationInFile: " << igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientationInFile) << std::endl;
+  os << indent << "UseMemoryMapping: " << (this->UseMemoryMapping ? "true" : "false") << std::endl;
+  os << indent << "PixelDataMapped: " << (this->IsPixelDataMapped() ? "true" : "false") << std::endl;
+  os << indent << "ReadCompressedData: " << (this->ReadCompressedData ? "true" : "false") << std::endl;
+  os << indent << "NumberOfDecompressionThreads: " << this->NumberOfDecompressionThreads << std::endl;
+  os << indent << "PixelDataCompressed: " << (this->PixelDataCompressed ? "true" : "false") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceStreamReader::CanReadFile(const std::string& filename)
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+  return (extension == ".mha" || extension == ".mhd");
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::Open(const std::string& filename)
+{
+  this->Close();
+
+  if (!CanReadFile(filename))
+  {
+    LOG_DEBUG("Sequence file format is not supported by the stream reader: " << filename);
+    return PLUS_FAIL;
+  }
+
+  // If file is not found in the current directory then try to find it in the image directory, too
+  this->FileName = filename;
+  if (!vtksys::SystemTools::FileExists(this->FileName.c_str(), true))
+  {
+    if (vtkPlusConfig::GetInstance()->FindImagePath(filename, this->FileName) == PLUS_FAIL)
+    {
+      LOG_ERROR("Cannot find sequence metafile: " << filename);
+      return PLUS_FAIL;
+    }
+  }
+
+  this->HeaderStream.open(this->FileName.c_str(), std::ios::in | std::ios::binary);
+  if (!this->HeaderStream.is_open())
+  {
+    LOG_ERROR("Failed to open sequence file for reading: " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  if (this->ReadHeader() != PLUS_SUCCESS || this->ParseImageProperties() != PLUS_SUCCESS)
+  {
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  if (this->FrameSizeInBytes > 0 && this->PixelDataCompressed && this->ReadCompressedDataChunkIndex() != PLUS_SUCCESS)
+  {
+    this->Close();
+    return PLUS_FAIL;
+  }
+  if (this->FrameSizeInBytes > 0)
+  {
+    this->PixelDataStream.open(this->PixelDataFileName.c_str(), std::ios::in | std::ios::binary);
+    if (!this->PixelDataStream.is_open())
+    {
+      LOG_ERROR("Failed to open sequence pixel data file for reading: " << this->PixelDataFileName);
+      this->Close();
+      return PLUS_FAIL;
+    }
+    if (this->UseMemoryMapping && this->MapPixelData() != PLUS_SUCCESS)
+    {
+      LOG_DEBUG("Sequence pixel data file is not memory mapped, it is read using file streams: " << this->PixelDataFileName);
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::Close()
+{
+  this->UnmapPixelData();
+  if (this->HeaderStream.is_open())
+  {
+    this->HeaderStream.close();
+  }
+  if (this->PixelDataStream.is_open())
+  {
+    this->PixelDataStream.close();
+  }
+  this->HeaderStream.clear();
+  this->PixelDataStream.clear();
+  this->HeaderFields.clear();
+  this->CustomHeaderFields.clear();
+  this->FrameFieldOffsets.clear();
+  this->PixelDataFileName.clear();
+  this->PixelDataOffset = 0;
+  this->NumberOfFrames = 0;
+  this->FrameSizeInBytes = 0;
+  this->PixelDataCompressed = false;
+  this->CompressedDataChunkSize = 0;
+  this->CompressedDataChunkOffsets.clear();
+  this->DecompressedFirstChunkIndex = 0;
+  this->NumberOfDecompressedChunks = 0;
+  std::vector<unsigned char>().swap(this->FramePixelBuffer);
+  std::vector<unsigned char>().swap(this->CompressedChunkBuffer);
+  std::vector<unsigned char>().swap(this->DecompressedChunkData);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::MapPixelData()
+{
+  this->UnmapPixelData();
+
+  uint64_t fileSize = 0;
+  const void* memory = NULL;
+#ifdef _WIN32
+  HANDLE fileHandle = CreateFileA(this->PixelDataFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+  {
+    return PLUS_FAIL;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart <= 0 || static_cast<uint64_t>(size.QuadPart) > static_cast<uint64_t>(SIZE_MAX))
+  {
+    CloseHandle(fileHandle);
+    return PLUS_FAIL;
+  }
+  fileSize = static_cast<uint64_t>(size.QuadPart);
+  HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mappingHandle == NULL)
+  {
+    CloseHandle(fileHandle);
+    return PLUS_FAIL;
+  }
+  memory = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (memory == NULL)
+  {
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    return PLUS_FAIL;
+  }
+  this->PixelDataFileHandle = fileHandle;
+  this->PixelDataMappingHandle = mappingHandle;
+#else
+  int fd = open(this->PixelDataFileName.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return PLUS_FAIL;
+  }
+  struct stat fileStatus;
+  if (fstat(fd, &fileStatus) != 0 || fileStatus.st_size <= 0 || static_cast<uint64_t>(fileStatus.st_size) > static_cast<uint64_t>(SIZE_MAX))
+  {
+    close(fd);
+    return PLUS_FAIL;
+  }
+  fileSize = static_cast<uint64_t>(fileStatus.st_size);
+  void* mappedMemory = mmap(NULL, static_cast<size_t>(fileSize), PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping remains valid after the file is closed
+  close(fd);
+  if (mappedMemory == MAP_FAILED)
+  {
+    return PLUS_FAIL;
+  }
+  // frames are usually read in increasing order, let the system read ahead
+  madvise(mappedMemory, static_cast<size_t>(fileSize), MADV_SEQUENTIAL);
+  memory = mappedMemory;
+#endif
+
+  this->MappedPixelData = static_cast<const unsigned char*>(memory);
+  this->MappedPixelDataSize = fileSize;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::UnmapPixelData()
+{
+  if (this->MappedPixelData == NULL)
+  {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(this->MappedPixelData);
+  CloseHandle(this->PixelDataMappingHandle);
+  CloseHandle(this->PixelDataFileHandle);
+  this->PixelDataMappingHandle = NULL;
+  this->PixelDataFileHandle = NULL;
+#else
+  munmap(const_cast<unsigned char*>(this->MappedPixelData), static_cast<size_t>(this->MappedPixelDataSize));
+#endif
+  this->MappedPixelData = NULL;
+  this->MappedPixelDataSize = 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceStreamReader::IsPixelDataMapped() const
+{
+  return this->MappedPixelData != NULL;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceStreamReader::IsPixelDataCompressed() const
+{
+  return this->PixelDataCompressed;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadCompressedDataChunkIndex()
+{
+  uint64_t compressedSize = 0;
+  if (igsioCommon::StringToNumber<uint64_t>(this->HeaderFields["CompressedDataSize"], compressedSize) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Invalid CompressedDataSize field in sequence file header: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  uint64_t chunkSize = 0;
+  if (igsioCommon::StringToNumber<uint64_t>(this->HeaderFields["CompressedDataChunkSize"], chunkSize) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Invalid CompressedDataChunkSize field in sequence file header: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  std::vector<std::string> chunkStreamSizeTokens;
+  igsioCommon::SplitStringIntoTokens(this->HeaderFields["CompressedDataChunkStreamSizes"], ' ', chunkStreamSizeTokens, false);
+  std::vector<uint64_t> chunkStreamSizes;
+  for (std::vector<std::string>::iterator tokenIt = chunkStreamSizeTokens.begin(); tokenIt != chunkStreamSizeTokens.end(); ++tokenIt)
+  {
+    uint64_t chunkStreamSize = 0;
+    if (igsioCommon::StringToNumber<uint64_t>(*tokenIt, chunkStreamSize) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Invalid CompressedDataChunkStreamSizes field in sequence file header: " << this->FileName);
+      return PLUS_FAIL;
+    }
+    chunkStreamSizes.push_back(chunkStreamSize);
+  }
+
+  const uint64_t uncompressedSize = this->FrameSizeInBytes * this->NumberOfFrames;
+  if (chunkSize == 0 || chunkStreamSizes.size() != std::max<uint64_t>(1, (uncompressedSize + chunkSize - 1) / chunkSize))
+  {
+    LOG_ERROR("CompressedDataChunkStreamSizes field does not match the pixel data size in sequence file header: " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  // Location of each chunk in the pixel data file
+  uint64_t chunkOffset = static_cast<uint64_t>(this->PixelDataOffset) + PlusParallelZlibCodec::GetStreamHeaderSize(PlusParallelZlibCodec::FORMAT_ZLIB);
+  this->CompressedDataChunkOffsets.clear();
+  for (std::vector<uint64_t>::iterator sizeIt = chunkStreamSizes.begin(); sizeIt != chunkStreamSizes.end(); ++sizeIt)
+  {
+    this->CompressedDataChunkOffsets.push_back(chunkOffset);
+    chunkOffset += *sizeIt;
+  }
+  this->CompressedDataChunkOffsets.push_back(chunkOffset);
+  if (chunkOffset + PlusParallelZlibCodec::GetStreamTrailerSize(PlusParallelZlibCodec::FORMAT_ZLIB) != static_cast<uint64_t>(this->PixelDataOffset) + compressedSize)
+  {
+    LOG_ERROR("CompressedDataChunkStreamSizes field does not match CompressedDataSize in sequence file header: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  this->CompressedDataChunkSize = chunkSize;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::DecompressPixelData(uint64_t firstChunkIndex, uint64_t numberOfChunks)
+{
+  const uint64_t totalNumberOfChunks = this->CompressedDataChunkOffsets.size() - 1;
+  const uint64_t uncompressedSize = std::min(numberOfChunks * this->CompressedDataChunkSize,
+                                             this->FrameSizeInBytes * this->NumberOfFrames - firstChunkIndex * this->CompressedDataChunkSize);
+  const uint64_t compressedOffset = this->CompressedDataChunkOffsets[firstChunkIndex];
+  const uint64_t compressedSize = this->CompressedDataChunkOffsets[firstChunkIndex + numberOfChunks] - compressedOffset;
+  std::vector<uint64_t> chunkStreamSizes;
+  for (uint64_t chunkIndex = firstChunkIndex; chunkIndex < firstChunkIndex + numberOfChunks; ++chunkIndex)
+  {
+    chunkStreamSizes.push_back(this->CompressedDataChunkOffsets[chunkIndex + 1] - this->CompressedDataChunkOffsets[chunkIndex]);
+  }
+
+  // Compressed data is read directly from the memory mapped file if possible
+  const unsigned char* compressedData = NULL;
+  if (this->MappedPixelData != NULL)
+  {
+    if (compressedOffset + compressedSize > this->MappedPixelDataSize)
+    {
+      LOG_ERROR("Failed to read compressed pixel data from " << this->PixelDataFileName << ": file is truncated");
+      return PLUS_FAIL;
+    }
+    compressedData = this->MappedPixelData + compressedOffset;
+  }
+  else
+  {
+    this->CompressedChunkBuffer.resize(static_cast<std::size_t>(compressedSize));
+    this->PixelDataStream.clear();
+    this->PixelDataStream.seekg(static_cast<std::streamoff>(compressedOffset));
+    if (this->CompressedChunkBuffer.empty() || !this->PixelDataStream.read(reinterpret_cast<char*>(&this->CompressedChunkBuffer[0]), static_cast<std::streamsize>(compressedSize)))
+    {
+      LOG_ERROR("Failed to read compressed pixel data from " << this->PixelDataFileName);
+      return PLUS_FAIL;
+    }
+    compressedData = &this->CompressedChunkBuffer[0];
+  }
+
+  this->NumberOfDecompressedChunks = 0;
+  this->DecompressedChunkData.resize(static_cast<std::size_t>(uncompressedSize));
+  PlusParallelZlibCodec codec;
+  codec.SetNumberOfThreads(this->NumberOfDecompressionThreads);
+  if (codec.DecompressChunks(compressedData, chunkStreamSizes, this->CompressedDataChunkSize, &this->DecompressedChunkData[0], uncompressedSize,
+                             firstChunkIndex + numberOfChunks == totalNumberOfChunks) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to decompress pixel data of " << this->FileName);
+    return PLUS_FAIL;
+  }
+  this->DecompressedFirstChunkIndex = firstChunkIndex;
+  this->NumberOfDecompressedChunks = numberOfChunks;
+
+  const PlusParallelZlibCodec::Statistics& statistics = codec.GetLastStatistics();
+  LOG_TRACE("Decompressed chunks " << firstChunkIndex << "-" << firstChunkIndex + numberOfChunks - 1 << " of " << this->FileName << " (" << statistics.NumberOfThreads << " threads): "
+            << std::fixed << std::setprecision(1) << statistics.GetThroughputMBPerSec() << " MB/s");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+const unsigned char* vtkPlusSequenceStreamReader::GetDecompressedPixelData(uint64_t offset, uint64_t size)
+{
+  const uint64_t firstChunkIndex = offset / this->CompressedDataChunkSize;
+  const uint64_t lastChunkIndex = (offset + size - 1) / this->CompressedDataChunkSize;
+  if (this->NumberOfDecompressedChunks == 0 || firstChunkIndex < this->DecompressedFirstChunkIndex
+      || lastChunkIndex >= this->DecompressedFirstChunkIndex + this->NumberOfDecompressedChunks)
+  {
+    // Frames are usually read in increasing order: decompress the chunks ahead, too, so that each thread has a chunk to decompress
+    unsigned int numberOfThreads = this->NumberOfDecompressionThreads;
+    if (numberOfThreads == 0)
+    {
+      numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const uint64_t totalNumberOfChunks = this->CompressedDataChunkOffsets.size() - 1;
+    const uint64_t numberOfChunks = std::min(std::max<uint64_t>(lastChunkIndex - firstChunkIndex + 1, numberOfThreads), totalNumberOfChunks - firstChunkIndex);
+    if (this->DecompressPixelData(firstChunkIndex, numberOfChunks) != PLUS_SUCCESS)
+    {
+      return NULL;
+    }
+  }
+  return &this->DecompressedChunkData[0] + (offset - this->DecompressedFirstChunkIndex * this->CompressedDataChunkSize);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadHeader()
+{
+  std::string line;
+  std::string name;
+  std::string value;
+  bool frameFieldsCompleted = false;
+  bool elementDataFileFound = false;
+  unsigned int frameIndex = 0;
+  std::string frameFieldName;
+
+  std::streamoff lineStartOffset = this->HeaderStream.tellg();
+  while (std::getline(this->HeaderStream, line))
+  {
+    if (!ParseHeaderLine(line, name, value))
+    {
+      lineStartOffset = this->HeaderStream.tellg();
+      continue;
+    }
+
+    if (ParseFrameFieldName(name, frameIndex, frameFieldName))
+    {
+      if (frameFieldsCompleted || frameIndex > this->FrameFieldOffsets.size() || frameIndex + 1 < this->FrameFieldOffsets.size())
+      {
+        // Fields of each frame must be stored in one block, in increasing frame order
+        LOG_DEBUG("Frame fields are not stored in frame order in " << this->FileName << ", the file cannot be read by the stream reader");
+        return PLUS_FAIL;
+      }
+      if (frameIndex == this->FrameFieldOffsets.size())
+      {
+        // first field of a new frame
+        this->FrameFieldOffsets.push_back(lineStartOffset);
+      }
+    }
+    else
+    {
+      if (!this->FrameFieldOffsets.empty() && !frameFieldsCompleted)
+      {
+        // end of the frame fields
+        this->FrameFieldOffsets.push_back(lineStartOffset);
+        frameFieldsCompleted = true;
+      }
+      this->HeaderFields[name] = value;
+      if (!IsLayoutHeaderField(name))
+      {
+        this->CustomHeaderFields[name] = value;
+      }
+      if (name == "ElementDataFile")
+      {
+        // This is always the last field of the header
+        elementDataFileFound = true;
+        break;
+      }
+    }
+    lineStartOffset = this->HeaderStream.tellg();
+  }
+
+  if (!elementDataFileFound)
+  {
+    LOG_ERROR("ElementDataFile field is not found in sequence file header: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  if (!this->FrameFieldOffsets.empty() && !frameFieldsCompleted)
+  {
+    this->FrameFieldOffsets.push_back(lineStartOffset);
+  }
+
+  const std::string& elementDataFile = this->HeaderFields["ElementDataFile"];
+  if (igsioCommon::IsEqualInsensitive(elementDataFile, "LOCAL"))
+  {
+    this->PixelDataFileName = this->FileName;
+    this->PixelDataOffset = this->HeaderStream.tellg();
+  }
+  else if (igsioCommon::IsEqualInsensitive(elementDataFile, "LIST") || elementDataFile.find('%') != std::string::npos)
+  {
+    LOG_DEBUG("Sequence file with multiple pixel data files cannot be read by the stream reader: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  else
+  {
+    this->PixelDataFileName = elementDataFile;
+    if (!vtksys::SystemTools::FileIsFullPath(this->PixelDataFileName.c_str()))
+    {
+      this->PixelDataFileName = vtksys::SystemTools::GetFilenamePath(this->FileName) + "/" + elementDataFile;
+    }
+    this->PixelDataOffset = 0;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ParseImageProperties()
+{
+  this->PixelDataCompressed = igsioCommon::IsEqualInsensitive(this->HeaderFields["CompressedData"], "True");
+  if (this->PixelDataCompressed && (!this->ReadCompressedData || this->HeaderFields["CompressedDataChunkStreamSizes"].empty()))
+  {
+    LOG_DEBUG("Compressed sequence file cannot be read by the stream reader: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  if (igsioCommon::IsEqualInsensitive(this->HeaderFields["BinaryDataByteOrderMSB"], "True"))
+  {
+    LOG_DEBUG("Big endian sequence file cannot be read by the stream reader: " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  int numberOfDimensions = 0;
+  if (igsioCommon::StringToNumber<int>(this->HeaderFields["NDims"], numberOfDimensions) != PLUS_SUCCESS || (numberOfDimensions != 3 && numberOfDimensions != 4))
+  {
+    LOG_ERROR("Invalid NDims field in sequence file header: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  std::vector<std::string> dimSizeTokens;
+  igsioCommon::SplitStringIntoTokens(this->HeaderFields["DimSize"], ' ', dimSizeTokens, false);
+  std::vector<unsigned int> dimSize;
+  for (std::vector<std::string>::iterator tokenIt = dimSizeTokens.begin(); tokenIt != dimSizeTokens.end(); ++tokenIt)
+  {
+    unsigned int size = 0;
+    if (igsioCommon::StringToNumber<unsigned int>(*tokenIt, size) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Invalid DimSize field in sequence file header: " << this->FileName);
+      return PLUS_FAIL;
+    }
+    dimSize.push_back(size);
+  }
+  if (dimSize.size() != static_cast<std::size_t>(numberOfDimensions))
+  {
+    LOG_ERROR("DimSize field does not match NDims in sequence file header: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  this->FrameSize[0] = dimSize[0];
+  this->FrameSize[1] = dimSize[1];
+  this->FrameSize[2] = (numberOfDimensions == 4 ? dimSize[2] : 1);
+  this->NumberOfFrames = dimSize[numberOfDimensions - 1];
+
+  if (this->FrameFieldOffsets.size() != this->NumberOfFrames + 1)
+  {
+    LOG_DEBUG("Number of frames with fields (" << (this->FrameFieldOffsets.empty() ? 0 : this->FrameFieldOffsets.size() - 1)
+              << ") does not match the number of frames in the sequence (" << this->NumberOfFrames << "): " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  if (!GetPixelTypeFromElementType(this->HeaderFields["ElementType"], this->PixelType))
+  {
+    LOG_ERROR("Unsupported ElementType in sequence file header: " << this->HeaderFields["ElementType"]);
+    return PLUS_FAIL;
+  }
+
+  this->NumberOfScalarComponents = 1;
+  if (!this->HeaderFields["ElementNumberOfChannels"].empty()
+      && igsioCommon::StringToNumber<unsigned int>(this->HeaderFields["ElementNumberOfChannels"], this->NumberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Invalid ElementNumberOfChannels field in sequence file header: " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  this->ImageOrientationInFile = US_IMG_ORIENT_MF;
+  if (!this->HeaderFields["UltrasoundImageOrientation"].empty())
+  {
+    this->ImageOrientationInFile = igsioCommon::GetUsImageOrientationFromString(this->HeaderFields["UltrasoundImageOrientation"]);
+  }
+  this->ImageType = US_IMG_BRIGHTNESS;
+  if (!this->HeaderFields["UltrasoundImageType"].empty())
+  {
+    this->ImageType = igsioCommon::GetUsImageTypeFromString(this->HeaderFields["UltrasoundImageType"]);
+  }
+
+  this->FrameSizeInBytes = static_cast<uint64_t>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2]
+                           * this->NumberOfScalarComponents * igsioVideoFrame::GetNumberOfBytesPerScalar(this->PixelType);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusSequenceStreamReader::GetNumberOfFrames() const
+{
+  return this->NumberOfFrames;
+}
+
+//----------------------------------------------------------------------------
+const FrameSizeType& vtkPlusSequenceStreamReader::GetFrameSize() const
+{
+  return this->FrameSize;
+}
+
+//----------------------------------------------------------------------------
+igsioCommon::VTKScalarPixelType vtkPlusSequenceStreamReader::GetPixelType() const
+{
+  return this->PixelType;
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusSequenceStreamReader::GetNumberOfScalarComponents() const
+{
+  return this->NumberOfScalarComponents;
+}
+
+//----------------------------------------------------------------------------
+US_IMAGE_TYPE vtkPlusSequenceStreamReader::GetImageType() const
+{
+  return this->ImageType;
+}
+
+//----------------------------------------------------------------------------
+const std::map<std::string, std::string>& vtkPlusSequenceStreamReader::GetCustomHeaderFields() const
+{
+  return this->CustomHeaderFields;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadFrames(unsigned int firstFrameIndex, unsigned int numberOfFrames, vtkIGSIOTrackedFrameList* frameList, bool readImageData /*=true*/)
+{
+  if (frameList == NULL)
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadFrames failed: output frame list is invalid");
+    return PLUS_FAIL;
+  }
+  if (!this->HeaderStream.is_open())
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadFrames failed: no sequence file is open");
+    return PLUS_FAIL;
+  }
+  if (firstFrameIndex >= this->NumberOfFrames)
+  {
+    return PLUS_SUCCESS;
+  }
+  numberOfFrames = std::min(numberOfFrames, this->NumberOfFrames - firstFrameIndex);
+
+  for (unsigned int frameIndex = firstFrameIndex; frameIndex < firstFrameIndex + numberOfFrames; ++frameIndex)
+  {
+    igsioTrackedFrame trackedFrame;
+    if (this->ReadFrame(frameIndex, trackedFrame, readImageData) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (frameList->AddTrackedFrame(&trackedFrame, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add frame " << frameIndex << " to the frame list");
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadFrame(unsigned int frameIndex, igsioTrackedFrame& trackedFrame, bool readImageData /*=true*/)
+{
+  if (!this->HeaderStream.is_open())
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadFrame failed: no sequence file is open");
+    return PLUS_FAIL;
+  }
+  if (frameIndex >= this->NumberOfFrames)
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadFrame failed: frame index " << frameIndex << " is out of range (number of frames: " << this->NumberOfFrames << ")");
+    return PLUS_FAIL;
+  }
+
+  // Frame fields
+  std::string line;
+  std::string name;
+  std::string value;
+  unsigned int fieldFrameIndex = 0;
+  std::string frameFieldName;
+  this->HeaderStream.clear();
+  this->HeaderStream.seekg(this->FrameFieldOffsets[frameIndex]);
+  while (this->HeaderStream.tellg() < this->FrameFieldOffsets[frameIndex + 1] && std::getline(this->HeaderStream, line))
+  {
+    if (!ParseHeaderLine(line, name, value) || !ParseFrameFieldName(name, fieldFrameIndex, frameFieldName))
+    {
+      continue;
+    }
+    if (frameFieldName == "Timestamp")
+    {
+      double timestamp = 0;
+      if (igsioCommon::StringToNumber<double>(value, timestamp) == PLUS_SUCCESS)
+      {
+        trackedFrame.SetTimestamp(timestamp);
+      }
+    }
+    trackedFrame.SetFrameField(frameFieldName, value);
+  }
+
+  // Pixel data
+  if (!readImageData || this->FrameSizeInBytes == 0 || igsioCommon::IsEqualInsensitive(trackedFrame.GetFrameField("ImageStatus"), "INVALID"))
+  {
+    return PLUS_SUCCESS;
+  }
+
+  igsioVideoFrame::FlipInfoType flipInfo;
+  if (igsioVideoFrame::GetFlipAxes(this->ImageOrientationInFile, this->ImageType, US_IMG_ORIENT_MF, flipInfo) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to convert image data to MF orientation from " << igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientationInFile));
+    return PLUS_FAIL;
+  }
+
+  const uint64_t framePixelDataOffset = static_cast<uint64_t>(this->PixelDataOffset) + frameIndex * this->FrameSizeInBytes;
+  const unsigned char* framePixelData = NULL;
+  if (this->PixelDataCompressed)
+  {
+    framePixelData = this->GetDecompressedPixelData(frameIndex * this->FrameSizeInBytes, this->FrameSizeInBytes);
+    if (framePixelData == NULL)
+    {
+      LOG_ERROR("Failed to read pixel data of frame " << frameIndex << " from " << this->PixelDataFileName);
+      return PLUS_FAIL;
+    }
+  }
+  else if (this->MappedPixelData != NULL)
+  {
+    if (framePixelDataOffset + this->FrameSizeInBytes > this->MappedPixelDataSize)
+    {
+      LOG_ERROR("Failed to read pixel data of frame " << frameIndex << " from " << this->PixelDataFileName << ": file is truncated");
+      return PLUS_FAIL;
+    }
+    framePixelData = this->MappedPixelData + framePixelDataOffset;
+  }
+  else
+  {
+    this->FramePixelBuffer.resize(static_cast<std::size_t>(this->FrameSizeInBytes));
+    this->PixelDataStream.clear();
+    this->PixelDataStream.seekg(static_cast<std::streamoff>(framePixelDataOffset));
+    if (!this->PixelDataStream.read(reinterpret_cast<char*>(&this->FramePixelBuffer[0]), static_cast<std::streamsize>(this->FrameSizeInBytes)))
+    {
+      LOG_ERROR("Failed to read pixel data of frame " << frameIndex << " from " << this->PixelDataFileName);
+      return PLUS_FAIL;
+    }
+    framePixelData = &this->FramePixelBuffer[0];
+  }
+
+  std::array<int, 3> clipRectOrigin = {igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP};
+  std::array<int, 3> clipRectSize = {igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP};
+  if (igsioVideoFrame::GetOrientedClippedImage(const_cast<unsigned char*>(framePixelData), flipInfo, this->ImageType, this->PixelType, this->NumberOfScalarComponents,
+      this->FrameSize, *trackedFrame.GetImageData(), clipRectOrigin, clipRectSize) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to convert image of frame " << frameIndex << " to MF orientation");
+    return PLUS_FAIL;
+  }
+  trackedFrame.GetImageData()->SetImageType(this->ImageType);
+  trackedFrame.GetImageData()->SetImageOrientation(US_IMG_ORIENT_MF);
+
+  return PLUS_SUCCESS;
+}
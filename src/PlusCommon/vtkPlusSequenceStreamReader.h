@@ -0,0 +1,195 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusSequenceStreamReader_h
+#define __vtkPlusSequenceStreamReader_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STL includes
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+
+/*!
+  \class vtkPlusSequenceStreamReader
+  \brief Read frames of a sequence file in chunks, without loading the whole sequence into memory
+
+  vtkPlusSequenceIO::Read loads all frames of a sequence into a tracked frame list, which is not feasible for
+  recordings that are larger than the available memory. This reader only parses the header when the file is opened
+  (and stores the location of the fields of each frame), then reads the requested range of frames on demand.
+
+  Only uncompressed MetaImage sequences (.mha, or .mhd with a single pixel data file, little endian) are supported,
+  which is the format that is used by vtkPlusVirtualCapture for recording. Open() returns PLUS_FAIL for other files;
+  those have to be read by vtkPlusSequenceIO::Read.
+
+  If ReadCompressedData is enabled then compressed MetaImage sequences that were written by vtkPlusSequenceIO::CompressSequenceFile
+  (which stores the compressed size of each data chunk in the header) can be read, too. Only the data chunks that contain
+  the requested frames are decompressed (by multiple threads, a few chunks ahead), so the memory usage does not depend on
+  the length of the sequence.
+
+  Images are converted to MF orientation, the same way as when the sequence is read by vtkPlusSequenceIO.
+
+  If UseMemoryMapping is enabled then the pixel data file is mapped into memory and images are converted directly from
+  the mapped file, without an intermediate copy. If the file cannot be mapped (e.g., it is larger than the available
+  address space) then the pixel data is read using file streams.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport vtkPlusSequenceStreamReader : public vtkObject
+{
+public:
+  static vtkPlusSequenceStreamReader* New();
+  vtkTypeMacro(vtkPlusSequenceStreamReader, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Returns true if the file format can be read by this reader (it does not check the file content) */
+  static bool CanReadFile(const std::string& filename);
+
+  /*! Open the sequence file and read its header. If the file is not found then it is searched in the image directory, too. */
+  PlusStatus Open(const std::string& filename);
+
+  /*! Close the sequence file */
+  void Close();
+
+  /*! Number of frames in the sequence */
+  unsigned int GetNumberOfFrames() const;
+
+  /*! Size of the images in the sequence */
+  const FrameSizeType& GetFrameSize() const;
+  /*! Pixel type of the images in the sequence */
+  igsioCommon::VTKScalarPixelType GetPixelType() const;
+  /*! Number of scalar components of the images in the sequence */
+  unsigned int GetNumberOfScalarComponents() const;
+  /*! Image type of the images in the sequence */
+  US_IMAGE_TYPE GetImageType() const;
+
+  /*! If enabled then the pixel data file is memory mapped. Must be set before Open(). */
+  vtkSetMacro(UseMemoryMapping, bool);
+  vtkGetMacro(UseMemoryMapping, bool);
+  vtkBooleanMacro(UseMemoryMapping, bool);
+
+  /*! Returns true if the pixel data of the currently open file is memory mapped */
+  bool IsPixelDataMapped() const;
+
+  /*! If enabled then compressed files with data chunk information can be read (the chunks are decompressed when frames are read). Must be set before Open(). */
+  vtkSetMacro(ReadCompressedData, bool);
+  vtkGetMacro(ReadCompressedData, bool);
+  vtkBooleanMacro(ReadCompressedData, bool);
+
+  /*! Number of threads that decompress the pixel data. 0 means the number of processor cores. */
+  vtkSetMacro(NumberOfDecompressionThreads, unsigned int);
+  vtkGetMacro(NumberOfDecompressionThreads, unsigned int);
+
+  /*! Returns true if the pixel data of the currently open file is compressed */
+  bool IsPixelDataCompressed() const;
+
+  /*!
+    Read frames and add them to the end of the frame list
+    \param firstFrameIndex Index of the first frame to read
+    \param numberOfFrames Number of frames to read. It is reduced if there are less frames in the file.
+    \param frameList Output frame list
+    \param readImageData If false then only the frame fields are read
+  */
+  PlusStatus ReadFrames(unsigned int firstFrameIndex, unsigned int numberOfFrames, vtkIGSIOTrackedFrameList* frameList, bool readImageData = true);
+
+  /*!
+    Read a single frame
+    \param frameIndex Index of the frame to read
+    \param trackedFrame Output frame. Fields are added to the existing fields of the frame, therefore a new frame should be passed for each read.
+    \param readImageData If false then only the frame fields are read
+  */
+  PlusStatus ReadFrame(unsigned int frameIndex, igsioTrackedFrame& trackedFrame, bool readImageData = true);
+
+  /*! Header fields that are not related to the file layout (fields that vtkPlusSequenceIO::Read stores as custom strings) */
+  const std::map<std::string, std::string>& GetCustomHeaderFields() const;
+
+protected:
+  vtkPlusSequenceStreamReader();
+  virtual ~vtkPlusSequenceStreamReader();
+
+  /*! Read header fields and store the location of the frame fields */
+  PlusStatus ReadHeader();
+
+  /*! Get image properties from the header fields */
+  PlusStatus ParseImageProperties();
+
+  /*! Map the pixel data file into memory. Returns PLUS_FAIL if the file cannot be mapped. */
+  PlusStatus MapPixelData();
+  void UnmapPixelData();
+
+  /*! Read the compressed size of each data chunk from the header */
+  PlusStatus ReadCompressedDataChunkIndex();
+
+  /*! Decompress consecutive data chunks into DecompressedChunkData */
+  PlusStatus DecompressPixelData(uint64_t firstChunkIndex, uint64_t numberOfChunks);
+
+  /*! Get uncompressed pixel data, the data chunks are decompressed if needed. Returns NULL if decompression fails. */
+  const unsigned char* GetDecompressedPixelData(uint64_t offset, uint64_t size);
+
+  std::string FileName;
+  std::ifstream HeaderStream;
+  std::ifstream PixelDataStream;
+
+  std::map<std::string, std::string> HeaderFields;
+  std::map<std::string, std::string> CustomHeaderFields;
+
+  /*! Position of the first field of each frame in the header. The last element is the end of the fields of the last frame. */
+  std::vector<std::streamoff> FrameFieldOffsets;
+
+  std::string PixelDataFileName;
+  std::streamoff PixelDataOffset;
+
+  unsigned int NumberOfFrames;
+  FrameSizeType FrameSize;
+  igsioCommon::VTKScalarPixelType PixelType;
+  unsigned int NumberOfScalarComponents;
+  US_IMAGE_TYPE ImageType;
+  US_IMAGE_ORIENTATION ImageOrientationInFile;
+  uint64_t FrameSizeInBytes;
+
+  /*! Pixel data of the frame that is being read (kept to avoid reallocation for each frame) */
+  std::vector<unsigned char> FramePixelBuffer;
+
+  bool UseMemoryMapping;
+  /*! Start of the memory mapped pixel data file, NULL if the file is not mapped */
+  const unsigned char* MappedPixelData;
+  uint64_t MappedPixelDataSize;
+
+  bool ReadCompressedData;
+  unsigned int NumberOfDecompressionThreads;
+  bool PixelDataCompressed;
+  /*! Uncompressed size of the data chunks, if the pixel data in the file is compressed */
+  uint64_t CompressedDataChunkSize;
+  /*! Position of each compressed data chunk in the pixel data file. The last element is the end of the last chunk. */
+  std::vector<uint64_t> CompressedDataChunkOffsets;
+  /*! Compressed data of the chunks that are being decompressed, if the pixel data file is not memory mapped */
+  std::vector<unsigned char> CompressedChunkBuffer;
+  /*! Uncompressed pixel data of consecutive chunks, starting with chunk DecompressedFirstChunkIndex */
+  std::vector<unsigned char> DecompressedChunkData;
+  uint64_t DecompressedFirstChunkIndex;
+  uint64_t NumberOfDecompressedChunks;
+
+#ifdef _WIN32
+  void* PixelDataFileHandle;
+  void* PixelDataMappingHandle;
+#endif
+
+private:
+  vtkPlusSequenceStreamReader(const vtkPlusSequenceStreamReader&);
+  void operator=(const vtkPlusSequenceStreamReader&);
+};
+
+#endif // __vtkPlusSequenceStreamReader_h
@@ -5,6 +5,8 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusClock.h"
+#include "PlusMetrics.h"
 #include "vtkPlusImageProcessorVideoSource.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusBoneEnhancer.h"
@@ -239,7 +241,7 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
   if (this->InputChannels[0]->GetTrackedFrame(trackedFrame) != PLUS_SUCCESS)
   {
     LOG_ERROR("Error while getting latest tracked frame. Last recorded timestamp: " << std::fixed << this->LastProcessedInputDataTimestamp << ". Device ID: " << this->GetDeviceId());
-    this->LastProcessedInputDataTimestamp = vtkIGSIOAccurateTimer::GetSystemTime(); // forget about the past, try to add frames that are acquired from now on
+    this->LastProcessedInputDataTimestamp = PlusClock::GetTime(); // forget about the past, try to add frames that are acquired from now on
     return PLUS_FAIL;
   }
 
@@ -264,9 +266,12 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
   vtkSmartPointer<vtkIGSIOTrackedFrameList> trackingFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   trackingFrames->AddTrackedFrame(&trackedFrame);
   this->ProcessorAlgorithm->SetInputFrames(trackingFrames);
-  if (this->ProcessorAlgorithm->Update() != PLUS_SUCCESS)
   {
-    return PLUS_FAIL;
+    PLUS_METRIC_SCOPED_TIMER("plus_image_processor_update_seconds", PlusMetricsRegistry::MakeLabel("device", this->GetDeviceId()));
+    if (this->ProcessorAlgorithm->Update() != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
   }
 
   vtkPlusDataSource* aSource(NULL);
@@ -353,6 +358,6 @@ void vtkPlusImageProcessorVideoSource::SetEnableProcessing(bool aValue)
   if (processingStartsNow)
   {
     this->LastProcessedInputDataTimestamp = 0.0;
-    this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime(); // reset the starting time for the grace period
+    this->RecordingStartTime = PlusClock::GetTime(); // reset the starting time for the grace period
   }
 }
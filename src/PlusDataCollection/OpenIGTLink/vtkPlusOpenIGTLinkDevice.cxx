@@ -16,6 +16,9 @@ See License.txt for details.
   #include <Winsock2.h>
 #endif
 
+// STL includes
+#include <cerrno>
+
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkDevice::vtkPlusOpenIGTLinkDevice()
   : ServerPort(-1)
@@ -29,6 +32,8 @@ vtkPlusOpenIGTLinkDevice::vtkPlusOpenIGTLinkDevice()
   , ClientSocket(igtl::ClientSocket::New())
   , ReconnectOnReceiveTimeout(true)
   , UseReceivedTimestamps(true)
+  , UseReceiveThread(false)
+  , MessageReceiveStopRequested(false)
 {
   // No callback function provided by the device, so the data capture thread will be used to poll the hardware and add new items to the buffer
   this->StartThreadForInternalUpdates = true;
@@ -42,6 +47,7 @@ vtkPlusOpenIGTLinkDevice::~vtkPlusOpenIGTLinkDevice()
   {
     this->StopRecording();
   }
+  this->StopReceiveThread();
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
   this->ClientSocket = NULL;
 }
@@ -63,6 +69,7 @@ void vtkPlusOpenIGTLinkDevice::PrintSelf(ostream& os, vtkIndent indent)
   {
     os << indent << "Image stream: " << this->ImageMessageEmbeddedTransformName.GetTransformName() << "\n";
   }
+  os << indent << "Use receive thread: " << (this->UseReceiveThread ? "true" : "false") << "\n";
 }
 //----------------------------------------------------------------------------
 std::string vtkPlusOpenIGTLinkDevice::GetSdkVersion()
@@ -94,11 +101,125 @@ PlusStatus vtkPlusOpenIGTLinkDevice::InternalDisconnect()
 {
   LOG_TRACE("vtkPlusOpenIGTLinkDevice::Disconnect");
 
+  // The receive thread locks the socket mutex, therefore it has to be stopped before the mutex is locked here
+  this->StopReceiveThread();
+
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
   this->ClientSocket->CloseSocket();
   return this->StopRecording();
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkDevice::InternalStartRecording()
+{
+  bool useReceiveThread = this->UseReceiveThread;
+  if (useReceiveThread && !this->IsReceiveThreadSupported())
+  {
+    LOG_WARNING("Receive thread is not supported with the current settings of device " << this->GetDeviceId() << ", messages are received by polling");
+    useReceiveThread = false;
+  }
+
+  // The receive thread adds the data to the buffers, no polling by the data capture thread is needed
+  this->StartThreadForInternalUpdates = !useReceiveThread;
+  if (useReceiveThread)
+  {
+    this->StopReceiveThread();
+    this->MessageReceiveStopRequested = false;
+    this->MessageReceiveThread = std::thread(&vtkPlusOpenIGTLinkDevice::ReceiveMessagesThread, this);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkDevice::InternalStopRecording()
+{
+  this->StopReceiveThread();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkDevice::StopReceiveThread()
+{
+  if (this->MessageReceiveThread.joinable())
+  {
+    // The thread notices the request after the pending receive is completed (at most a few receive timeouts)
+    this->MessageReceiveStopRequested = true;
+    this->MessageReceiveThread.join();
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkDevice::IsReceiveThreadSupported()
+{
+  return false;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkDevice::ProcessReceivedMessage(igtl::MessageHeader::Pointer headerMsg)
+{
+  // Not supported by this device, skip the message
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+  this->ClientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkDevice::OnReceiveThreadNoData()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkDevice::ReceiveMessagesThread()
+{
+  LOG_DEBUG("Receive thread started in device " << this->GetDeviceId());
+  while (!this->MessageReceiveStopRequested)
+  {
+    igtl::MessageHeader::Pointer headerMsg;
+    PlusStatus socketStatus = PLUS_FAIL;
+    {
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+      if (this->ClientSocket->GetConnected())
+      {
+        socketStatus = this->ReceiveMessageHeader(headerMsg);
+      }
+    }
+    if (this->MessageReceiveStopRequested)
+    {
+      break;
+    }
+
+    if (socketStatus != PLUS_SUCCESS)
+    {
+      // Socket error or the connection is lost (a receive timeout is not an error)
+      this->OnReceiveThreadNoData();
+      if (this->ReconnectOnReceiveTimeout)
+      {
+        LOG_WARNING("Socket error in device " << this->GetDeviceId() << ": failed to receive OpenIGTLink message. Attempt to reconnect.");
+        if (this->ClientSocketReconnect() == PLUS_SUCCESS)
+        {
+          continue;
+        }
+      }
+      vtkIGSIOAccurateTimer::Delay(this->DelayBetweenRetryAttemptsSec);
+      continue;
+    }
+
+    if (headerMsg.IsNull())
+    {
+      // No message has been received within the receive timeout
+      this->OnReceiveThreadNoData();
+      continue;
+    }
+
+    headerMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (this->ProcessReceivedMessage(headerMsg) != PLUS_SUCCESS)
+    {
+      LOG_DEBUG("Failed to process " << headerMsg->GetMessageType() << " message in device " << this->GetDeviceId());
+    }
+  }
+  LOG_DEBUG("Receive thread stopped in device " << this->GetDeviceId());
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkDevice::Probe()
 {
@@ -178,6 +299,11 @@ PlusStatus vtkPlusOpenIGTLinkDevice::SendRequestedMessageTypes()
 
   // Set message type
   clientInfo.IgtlMessageTypes.push_back(this->MessageType);
+  if (igsioCommon::IsEqualInsensitive(this->MessageType, "TRACKEDFRAME"))
+  {
+    // Request binary TRACKEDFRAME data layout (servers that do not support it keep sending XML data, which can be read as well)
+    clientInfo.SetTrackedFrameBinaryData(true);
+  }
 
   // Set any requested image streams
   if (this->ImageMessageEmbeddedTransformName.IsValid())
@@ -195,6 +321,8 @@ PlusStatus vtkPlusOpenIGTLinkDevice::SendRequestedMessageTypes()
     clientInfo.TransformNames.push_back(tName);
   }
 
+  this->UpdateClientInfo(clientInfo);
+
   // Pack client info message
   auto clientInfoMsg = igtl::PlusClientInfoMessage::New();
   clientInfoMsg->SetClientInfo(clientInfo);
@@ -218,6 +346,11 @@ PlusStatus vtkPlusOpenIGTLinkDevice::SendRequestedMessageTypes()
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkDevice::UpdateClientInfo(PlusIgtlClientInfo& clientInfo)
+{
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkDevice::OnReceiveTimeout()
 {
@@ -254,9 +387,11 @@ PlusStatus vtkPlusOpenIGTLinkDevice::ReceiveMessageHeader(igtl::MessageHeader::P
   headerMsg = this->MessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
 
   int numOfBytesReceived = 0;
+  bool timeout(false);
   {
-    bool timeout(false);
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    // The socket only reports a timeout if errno is set by the receive call, so an earlier timeout must not be reported again
+    errno = 0;
     RETRY_UNTIL_TRUE(
       (numOfBytesReceived = this->ClientSocket->Receive(headerMsg->GetBufferPointer(), headerMsg->GetBufferSize(), timeout)) != 0,
       this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
@@ -278,7 +413,17 @@ PlusStatus vtkPlusOpenIGTLinkDevice::ReceiveMessageHeader(igtl::MessageHeader::P
   // No data has been received
   headerMsg = NULL; // this will indicate the caller that no data has been read
 
-  bool socketError = numOfBytesReceived < 0; /* -1 == SOCKET_ERROR */
+  if (numOfBytesReceived == 0 && !timeout)
+  {
+    // The server closed the connection (or it was not connected). The socket is closed so that the connection is
+    // re-established instead of waiting for data that never comes.
+    LOG_DEBUG("Connection to OpenIGTLink server is closed in device " << this->GetDeviceId());
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    this->ClientSocket->CloseSocket();
+    return PLUS_FAIL;
+  }
+
+  bool socketError = numOfBytesReceived < 0 && !timeout; /* -1 == SOCKET_ERROR */
 #ifdef _WIN32
   // On Windows try to get some more details about the socket error
   if (socketError)
@@ -326,6 +471,7 @@ PlusStatus vtkPlusOpenIGTLinkDevice::ReadConfiguration(vtkXMLDataElement* rootCo
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IgtlMessageCrcCheckEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseReceivedTimestamps, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ReconnectOnReceiveTimeout, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseReceiveThread, deviceConfig);
   return PLUS_SUCCESS;
 }
 
@@ -341,6 +487,7 @@ PlusStatus vtkPlusOpenIGTLinkDevice::WriteConfiguration(vtkXMLDataElement* rootC
   deviceConfig->SetAttribute("IgtlMessageCrcCheckEnabled", this->IgtlMessageCrcCheckEnabled ? "true" : "false");
   deviceConfig->SetAttribute("UseReceivedTimestamps", this->UseReceivedTimestamps ? "true" : "false");
   deviceConfig->SetAttribute("ReconnectOnReceiveTimeout", this->ReconnectOnReceiveTimeout ? "true" : "false");
+  deviceConfig->SetAttribute("UseReceiveThread", this->UseReceiveThread ? "true" : "false");
   return PLUS_SUCCESS;
 }
 
@@ -15,12 +15,23 @@
 #include <igtlClientSocket.h>
 #include <igtlMessageBase.h>
 
+// STL includes
+#include <atomic>
+#include <thread>
+
+class PlusIgtlClientInfo;
 class vtkPlusIgtlMessageFactory;
 
 /*!
   \class vtkPlusOpenIGTLinkDevice
   \brief Common base class for OpenIGTLink-based tracking and video devices
 
+  By default messages are received by the data capture thread, which polls the socket at AcquisitionRate.
+  If UseReceiveThread is enabled (and the device supports it) then a dedicated thread receives the messages as soon as
+  they arrive and adds the data to the buffers directly, so the device keeps up with senders that send bursts of messages
+  or send faster than AcquisitionRate. In this mode a receive timeout only means that the server has not sent anything,
+  the connection is re-established only if there is a socket error.
+
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusOpenIGTLinkDevice : public vtkPlusDevice
@@ -90,6 +101,10 @@ public:
   /*! Get the ReconnectOnNoData flag */
   vtkGetMacro(ReconnectOnReceiveTimeout, bool);
 
+  /*! Receive messages on a dedicated thread as soon as they arrive (instead of polling at AcquisitionRate) */
+  vtkSetMacro(UseReceiveThread, bool);
+  vtkGetMacro(UseReceiveThread, bool);
+
 protected:
   vtkPlusOpenIGTLinkDevice();
   virtual ~vtkPlusOpenIGTLinkDevice();
@@ -100,6 +115,33 @@ protected:
   /*! Sends the requested message types when connection is established */
   virtual PlusStatus SendRequestedMessageTypes();
 
+  /*! Start the receive thread if it is enabled and supported by the device */
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Stop the receive thread */
+  virtual PlusStatus InternalStopRecording();
+
+  /*! Returns true if the device can process messages on the receive thread (see ProcessReceivedMessage) */
+  virtual bool IsReceiveThreadSupported();
+
+  /*!
+    Called by the receive thread for each received message header (already unpacked).
+    The implementation must receive or skip the message body and add the received data to the buffers.
+  */
+  virtual PlusStatus ProcessReceivedMessage(igtl::MessageHeader::Pointer headerMsg);
+
+  /*! Called by the receive thread if no message was received within the receive timeout or the connection is lost */
+  virtual void OnReceiveThreadNoData();
+
+  /*! Main function of the receive thread */
+  void ReceiveMessagesThread();
+
+  /*! Stop the receive thread and wait for it to finish. Must not be called with SocketMutex locked. */
+  void StopReceiveThread();
+
+  /*! Allows derived classes to set additional parameters in the client info that is sent to the server */
+  virtual void UpdateClientInfo(PlusIgtlClientInfo& clientInfo);
+
   /*!
     This method is called when receiving a message is timed out.
     If ReconnectOnReceiveTimeout is enabled then this method attempts to reconnect to the server.
@@ -113,7 +155,7 @@ protected:
 
   /*!
     Receive an OpenITGLink message header.
-    Returns PLUS_FAIL if there was a socket error.
+    Returns PLUS_FAIL if there was a socket error or the server closed the connection (then the socket is closed).
     The headerMsg is NULL is no data is received.
   */
   virtual PlusStatus ReceiveMessageHeader(igtl::MessageHeader::Pointer& headerMsg);
@@ -166,6 +208,12 @@ protected:
   */
   bool UseReceivedTimestamps;
 
+  /*! Receive messages on a dedicated thread */
+  bool UseReceiveThread;
+
+  std::thread MessageReceiveThread;
+  std::atomic<bool> MessageReceiveStopRequested;
+
 private:
   vtkPlusOpenIGTLinkDevice(const vtkPlusOpenIGTLinkDevice&);   // Not implemented.
   void operator=(const vtkPlusOpenIGTLinkDevice&);   // Not implemented.
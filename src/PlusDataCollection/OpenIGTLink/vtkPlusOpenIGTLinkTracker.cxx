@@ -5,6 +5,7 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusMetrics.h"
 #include "vtkPlusOpenIGTLinkTracker.h"
 
 #include "igtlPositionMessage.h"
@@ -13,6 +14,8 @@ See License.txt for details.
 #include "vtkMatrix4x4.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlusDataSource.h"
+#include "PlusIgtlClientInfo.h"
+#include "PlusIgtlDatagramChannel.h"
 #include "vtkPlusIgtlMessageCommon.h"
 
 #include <set>
@@ -22,6 +25,11 @@ vtkStandardNewMacro(vtkPlusOpenIGTLinkTracker);
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkTracker::vtkPlusOpenIGTLinkTracker()
   : UseLastTransformsOnReceiveTimeout(false)
+  , TDATAResolution(50)
+  , TDATACoalescing(false)
+  , LastTDataSampleTimestamp(0)
+  , DatagramPort(-1)
+  , DatagramChannel(NULL)
 {
   SetToolReferenceFrameName("Reference");
 }
@@ -29,21 +37,63 @@ vtkPlusOpenIGTLinkTracker::vtkPlusOpenIGTLinkTracker()
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkTracker::~vtkPlusOpenIGTLinkTracker()
 {
+  this->StopReceiveThread();
+  delete this->DatagramChannel;
+  this->DatagramChannel = NULL;
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkTracker::PrintSelf(ostream& os, vtkIndent indent)
 {
   os << indent << "UseLastTransformsOnReceiveTimeout: " << this->UseLastTransformsOnReceiveTimeout;
+  os << indent << "TDATAResolution: " << this->TDATAResolution;
+  os << indent << "TDATACoalescing: " << this->TDATACoalescing;
+  os << indent << "DatagramAddress: " << this->DatagramAddress;
+  os << indent << "DatagramPort: " << this->DatagramPort;
 
   Superclass::PrintSelf(os, indent);
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::InternalConnect()
+{
+  LOG_TRACE("vtkPlusOpenIGTLinkTracker::InternalConnect");
+  if (!this->IsDatagramReceiveEnabled())
+  {
+    return Superclass::InternalConnect();
+  }
+
+  // The server broadcasts the tracking data regardless of the subscribers, no TCP connection is needed
+  this->ClearAllBuffers();
+  this->LastTDataSampleTimestamp = 0;
+  if (this->DatagramChannel == NULL)
+  {
+    this->DatagramChannel = new PlusIgtlDatagramChannel;
+  }
+  // Multicast datagrams are filtered by the group, datagrams sent to this host directly by the sender address
+  std::string sourceAddress = PlusIgtlDatagramChannel::IsMulticastAddress(this->DatagramAddress) ? std::string() : this->ServerAddress;
+  if (this->DatagramChannel->OpenReceiver(this->DatagramAddress, this->DatagramPort, sourceAddress) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to open datagram receiver in device " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkTracker::InternalDisconnect()
 {
   LOG_TRACE("vtkPlusOpenIGTLinkTracker::Disconnect");
-  if (this->IsTDataMessageType())
+  if (this->IsDatagramReceiveEnabled())
+  {
+    if (this->DatagramChannel != NULL && this->DatagramChannel->IsOpen())
+    {
+      LOG_INFO("Datagrams received in device " << this->GetDeviceId() << ": " << this->DatagramChannel->GetNumberOfDatagrams()
+               << ", lost: " << this->DatagramChannel->GetNumberOfLostDatagrams() << ", dropped (out of order): " << this->DatagramChannel->GetNumberOfDroppedDatagrams());
+      this->DatagramChannel->Close();
+    }
+  }
+  else if (this->IsTDataMessageType())
   {
     // If we need TDATA, request server to stop streaming.
     auto stpMsg = igtl::StopTrackingDataMessage::New();
@@ -79,7 +129,11 @@ PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdate()
     return PLUS_FAIL;
   }
 
-  if (this->IsTDataMessageType())
+  if (this->IsDatagramReceiveEnabled())
+  {
+    return this->InternalUpdateDatagram();
+  }
+  else if (this->IsTDataMessageType())
   {
     return this->InternalUpdateTData();
   }
@@ -142,6 +196,53 @@ PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdateTData()
     this->ClientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
   }
 
+  return this->ReceiveTrackingDataMessage(headerMsg, bodyMsg);
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkTracker::IsReceiveThreadSupported()
+{
+  return !this->IsDatagramReceiveEnabled() && this->IsTDataMessageType();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::ProcessReceivedMessage(igtl::MessageHeader::Pointer headerMsg)
+{
+  igtl::MessageBase::Pointer bodyMsg = this->MessageFactory->CreateReceiveMessage(headerMsg);
+  if (typeid(*bodyMsg) != typeid(igtl::TrackingDataMessage))
+  {
+    // data type is unknown, ignore it
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    this->ClientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+    return PLUS_SUCCESS;
+  }
+  return this->ReceiveTrackingDataMessage(headerMsg, bodyMsg);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkTracker::OnReceiveThreadNoData()
+{
+  double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  bool connected = false;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    connected = this->ClientSocket->GetConnected();
+  }
+  if (!connected)
+  {
+    // Connection is lost, set transform status to INVALID
+    StoreInvalidTransforms(unfilteredTimestamp);
+  }
+  else if (this->UseLastTransformsOnReceiveTimeout)
+  {
+    // The server only sends update if a transform is modified, store the last known transform values
+    StoreMostRecentTransformValues(unfilteredTimestamp);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::ReceiveTrackingDataMessage(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer bodyMsg)
+{
   // TDATA message
   igtl::TrackingDataMessage::Pointer tdataMsg = dynamic_cast<igtl::TrackingDataMessage*>(bodyMsg.GetPointer());
   tdataMsg->SetMessageHeader(headerMsg);
@@ -150,7 +251,15 @@ PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdateTData()
   {
     bool timeout(false);
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
-    this->ClientSocket->Receive(tdataMsg->GetBufferBodyPointer(), tdataMsg->GetBufferBodySize(), timeout);
+    int numOfBytesReceived = this->ClientSocket->Receive(tdataMsg->GetBufferBodyPointer(), tdataMsg->GetBufferBodySize(), timeout);
+    if (numOfBytesReceived < 0 || static_cast<igtlUint64>(numOfBytesReceived) != tdataMsg->GetBufferBodySize())
+    {
+      // A partial body must not be unpacked and the next header must not be read from the middle of this message
+      LOG_ERROR("Couldn't receive TDATA message body from OpenIGTLink server in device " << this->GetDeviceId() << " (received "
+                << numOfBytesReceived << " of " << tdataMsg->GetBufferBodySize() << " bytes)");
+      this->ClientSocket->CloseSocket();
+      return PLUS_FAIL;
+    }
   }
   int c = tdataMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
   if (!(c & igtl::MessageHeader::UNPACK_BODY))
@@ -159,72 +268,100 @@ PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdateTData()
     return PLUS_FAIL;
   }
 
+  return this->ProcessTrackingDataMessage(tdataMsg);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::ProcessTrackingDataMessage(igtl::TrackingDataMessage::Pointer tdataMsg)
+{
+  // A TDATA message may contain tool poses of multiple samples (if TDATA coalescing is enabled on the server)
+  std::vector<double> sampleTimestamps;
+  std::vector<int> sampleElementCounts;
+  std::vector<ToolStatus> elementStatuses;
+  if (vtkPlusIgtlMessageCommon::GetTrackingDataMessageSamples(tdataMsg, sampleTimestamps, sampleElementCounts, elementStatuses) != PLUS_SUCCESS)
+  {
+    // Single sample, all tools are valid
+    sampleTimestamps.assign(1, 0.0);
+    sampleElementCounts.assign(1, tdataMsg->GetNumberOfTrackingDataElements());
+    elementStatuses.assign(tdataMsg->GetNumberOfTrackingDataElements(), TOOL_OK);
+  }
+
   // for now just use system time, all coordinates will be sequential.
-  double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
-  double filteredTimestamp = unfilteredTimestamp; // No need to filter already filtered timestamped items received over OpenIGTLink
-  // We store the list of identified tools (tools we get information about from the tracker).
-  // The tools that are missing from the tracker message are assumed to be out of view.
-  std::set<std::string> identifiedToolSourceIds;
-  for (int i = 0; i < tdataMsg->GetNumberOfTrackingDataElements(); ++ i)
+  // Samples of coalesced messages keep their time offset relative to the latest sample.
+  double receiveTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  int elementIndex = 0;
+  for (size_t sampleIndex = 0; sampleIndex < sampleTimestamps.size(); ++sampleIndex)
   {
-    auto tdataElem = igtl::TrackingDataElement::New();
-    tdataMsg->GetTrackingDataElement(i, tdataElem);
+    double unfilteredTimestamp = receiveTimestamp - (sampleTimestamps.back() - sampleTimestamps[sampleIndex]);
+    double filteredTimestamp = unfilteredTimestamp; // No need to filter already filtered timestamped items received over OpenIGTLink
+    if (unfilteredTimestamp <= this->LastTDataSampleTimestamp)
+    {
+      // Overlaps with the previously received message, timestamps in the buffers must be increasing
+      elementIndex += sampleElementCounts[sampleIndex];
+      continue;
+    }
+    this->LastTDataSampleTimestamp = unfilteredTimestamp;
 
-    igtl::Matrix4x4 igtlMatrix;
-    tdataElem->GetMatrix(igtlMatrix);
-    vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-    // convert igtl matrix to vtk matrix
-    for (int r = 0; r < 4; r++)
+    // We store the list of identified tools (tools we get information about from the tracker).
+    // The tools that are missing from the tracker message are assumed to be out of view.
+    std::set<std::string> identifiedToolSourceIds;
+    for (int i = 0; i < sampleElementCounts[sampleIndex]; ++i, ++elementIndex)
     {
-      for (int c = 0; c < 4; c++)
+      auto tdataElem = igtl::TrackingDataElement::New();
+      tdataMsg->GetTrackingDataElement(elementIndex, tdataElem);
+
+      igtl::Matrix4x4 igtlMatrix;
+      tdataElem->GetMatrix(igtlMatrix);
+      vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      // convert igtl matrix to vtk matrix
+      for (int r = 0; r < 4; r++)
       {
-        toolMatrix->SetElement(r, c, igtlMatrix[r][c]);
+        for (int c = 0; c < 4; c++)
+        {
+          toolMatrix->SetElement(r, c, igtlMatrix[r][c]);
+        }
       }
-    }
-
-    // Get timestamp
-    auto igtlTimestamp = igtl::TimeStamp::New();
-    tdataMsg->GetTimeStamp(igtlTimestamp);
 
-    // Get igtl transform name
-    std::string igtlTransformName = tdataElem->GetName();
+      // Get igtl transform name
+      std::string igtlTransformName = tdataElem->GetName();
 
-    // Set internal transform name
-    igsioTransformName transformName;
-    if (igtlTransformName.find("To") != std::string::npos)
-    {
-      // Plus style transform name sent
-      transformName = igtlTransformName;
-    }
-    else
-    {
-      // Brainlab style transform name sent
-      transformName = igsioTransformName(igtlTransformName.c_str(), this->ToolReferenceFrameName);
-    }
+      // Set internal transform name
+      igsioTransformName transformName;
+      if (igtlTransformName.find("To") != std::string::npos)
+      {
+        // Plus style transform name sent
+        transformName = igtlTransformName;
+      }
+      else
+      {
+        // Brainlab style transform name sent
+        transformName = igsioTransformName(igtlTransformName.c_str(), this->ToolReferenceFrameName);
+      }
 
-    if (this->ToolTimeStampedUpdateWithoutFiltering(transformName.GetTransformName().c_str(), toolMatrix, TOOL_OK, unfilteredTimestamp, filteredTimestamp) == PLUS_SUCCESS)
-    {
-      identifiedToolSourceIds.insert(transformName.GetTransformName());
-    }
-    else
-    {
-      LOG_INFO("ToolTimeStampedUpdate failed for tool: " << transformName.From() << " with timestamp: " << std::fixed << unfilteredTimestamp);
-      // DO NOT return here: we want to update the other tools.
+      if (this->ToolTimeStampedUpdateWithoutFiltering(transformName.GetTransformName().c_str(), toolMatrix, elementStatuses[elementIndex], unfilteredTimestamp, filteredTimestamp) == PLUS_SUCCESS)
+      {
+        identifiedToolSourceIds.insert(transformName.GetTransformName());
+      }
+      else
+      {
+        LOG_INFO("ToolTimeStampedUpdate failed for tool: " << transformName.From() << " with timestamp: " << std::fixed << unfilteredTimestamp);
+        // DO NOT return here: we want to update the other tools.
+      }
     }
-  }
-  // Set status for non-detected tools
-  vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  toolMatrix->Identity();
-  for (DataSourceContainerConstIterator it = this->GetToolIteratorBegin(); it != this->GetToolIteratorEnd(); ++it)
-  {
-    if (identifiedToolSourceIds.find(it->second->GetId()) != identifiedToolSourceIds.end())
+    // Set status for non-detected tools
+    vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    toolMatrix->Identity();
+    for (DataSourceContainerConstIterator it = this->GetToolIteratorBegin(); it != this->GetToolIteratorEnd(); ++it)
     {
-      // this tool has been found and update has been already called with the correct transform
-      LOG_TRACE("Tool " << it->second->GetId() << ": found");
-      continue;
+      if (identifiedToolSourceIds.find(it->second->GetId()) != identifiedToolSourceIds.end())
+      {
+        // this tool has been found and update has been already called with the correct transform
+        LOG_TRACE("Tool " << it->second->GetId() << ": found");
+        continue;
+      }
+      LOG_TRACE("Tool " << it->second->GetId() << ": not found");
+      this->ToolTimeStampedUpdateWithoutFiltering(it->second->GetId(), toolMatrix, TOOL_OUT_OF_VIEW, unfilteredTimestamp, filteredTimestamp);
     }
-    LOG_TRACE("Tool " << it->second->GetId() << ": not found");
-    this->ToolTimeStampedUpdateWithoutFiltering(it->second->GetId(), toolMatrix, TOOL_OUT_OF_VIEW, unfilteredTimestamp, filteredTimestamp);
   }
   return PLUS_SUCCESS;
 }
@@ -331,6 +468,12 @@ PlusStatus vtkPlusOpenIGTLinkTracker::ProcessTransformMessageGeneral(bool& moreM
     return PLUS_SUCCESS;
   }
 
+  return this->StoreReceivedTransform(igtlTransformName, toolMatrix, toolStatus, unfilteredTimestampUtc);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::StoreReceivedTransform(const std::string& igtlTransformName, vtkMatrix4x4* toolMatrix, ToolStatus toolStatus, double unfilteredTimestampUtc)
+{
   // Set transform name
   igsioTransformName transformName;
   if (transformName.SetTransformName(igtlTransformName.c_str()) != PLUS_SUCCESS)
@@ -366,6 +509,78 @@ PlusStatus vtkPlusOpenIGTLinkTracker::ProcessTransformMessageGeneral(bool& moreM
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdateDatagram()
+{
+  LOG_TRACE("vtkPlusOpenIGTLinkTracker::InternalUpdateDatagram");
+
+  double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  double maxAllocatedProcessingTime = 2.0;
+  // set maxAllocatedProcessingTime to 2 acquisition periods to allow reading all transforms even when there are slight delays
+  if (this->GetAcquisitionRate() > 2.0 / maxAllocatedProcessingTime)
+  {
+    maxAllocatedProcessingTime = 2.0 / this->GetAcquisitionRate();
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  bool messageReceived = false;
+  while (vtkIGSIOAccurateTimer::GetSystemTime() - unfilteredTimestamp <= maxAllocatedProcessingTime)
+  {
+    // Wait for the first message only, then process all the datagrams that are already received
+    igtl::MessageBase::Pointer bodyMsg;
+    if (this->DatagramChannel->ReceiveMessage(messageReceived ? 0.0 : this->ReceiveTimeoutSec, this->MessageFactory, this->IgtlMessageCrcCheckEnabled, bodyMsg) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+      break;
+    }
+    if (bodyMsg.IsNull())
+    {
+      // no more messages
+      break;
+    }
+    messageReceived = true;
+    PLUS_METRIC_HISTOGRAM_RECORD_SEC("plus_igtl_datagram_latency_seconds", PlusMetricsRegistry::MakeLabel("device", this->GetDeviceId()),
+                                     vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(vtkIGSIOAccurateTimer::GetSystemTime()) - this->DatagramChannel->GetLastReceivedSendTime());
+
+    double unfilteredTimestampUtc = 0;
+    vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    std::string igtlTransformName;
+    ToolStatus toolStatus(TOOL_UNKNOWN);
+    if (typeid(*bodyMsg) == typeid(igtl::TrackingDataMessage))
+    {
+      this->ProcessTrackingDataMessage(dynamic_cast<igtl::TrackingDataMessage*>(bodyMsg.GetPointer()));
+    }
+    else if (typeid(*bodyMsg) == typeid(igtl::TransformMessage))
+    {
+      if (vtkPlusIgtlMessageCommon::GetTransformFromTransformMessage(dynamic_cast<igtl::TransformMessage*>(bodyMsg.GetPointer()), toolMatrix, toolStatus, igtlTransformName, unfilteredTimestampUtc) == PLUS_SUCCESS)
+      {
+        this->StoreReceivedTransform(igtlTransformName, toolMatrix, toolStatus, unfilteredTimestampUtc);
+      }
+    }
+    else if (typeid(*bodyMsg) == typeid(igtl::PositionMessage))
+    {
+      if (vtkPlusIgtlMessageCommon::GetTransformFromPositionMessage(dynamic_cast<igtl::PositionMessage*>(bodyMsg.GetPointer()), toolMatrix, igtlTransformName, toolStatus, unfilteredTimestampUtc) == PLUS_SUCCESS)
+      {
+        this->StoreReceivedTransform(igtlTransformName, toolMatrix, toolStatus, unfilteredTimestampUtc);
+      }
+    }
+  }
+
+  if (this->UseLastTransformsOnReceiveTimeout)
+  {
+    // Store all the other transforms with the last known value
+    StoreMostRecentTransformValues(unfilteredTimestamp);
+  }
+  else
+  {
+    // Set all those transforms to invalid that contains stale transform values (e.g., the datagrams are lost)
+    StoreInvalidTransforms(unfilteredTimestamp);
+  }
+
+  return status;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkTracker::SendRequestedMessageTypes()
 {
@@ -382,7 +597,7 @@ PlusStatus vtkPlusOpenIGTLinkTracker::SendRequestedMessageTypes()
   {
     auto sttMsg = igtl::StartTrackingDataMessage::New();
     sttMsg->SetDeviceName("");
-    sttMsg->SetResolution(50);
+    sttMsg->SetResolution(this->TDATAResolution);
     sttMsg->SetCoordinateName(this->ToolReferenceFrameName.c_str());
     sttMsg->Pack();
 
@@ -404,6 +619,17 @@ PlusStatus vtkPlusOpenIGTLinkTracker::SendRequestedMessageTypes()
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkTracker::UpdateClientInfo(PlusIgtlClientInfo& clientInfo)
+{
+  if (this->IsTDataMessageType() && this->TDATACoalescing)
+  {
+    // Sample timestamps are sent in meta data, which requires header version 2
+    clientInfo.SetTDATACoalescing(true);
+    clientInfo.SetClientHeaderVersion(IGTL_HEADER_VERSION_2);
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkTracker::StoreMostRecentTransformValues(double unfilteredTimestamp)
 {
@@ -504,6 +730,10 @@ PlusStatus vtkPlusOpenIGTLinkTracker::ReadConfiguration(vtkXMLDataElement* rootC
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseLastTransformsOnReceiveTimeout, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, TDATAResolution, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(TDATACoalescing, deviceConfig);
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(DatagramAddress, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, DatagramPort, deviceConfig);
   return PLUS_SUCCESS;
 }
 
@@ -512,6 +742,13 @@ PlusStatus vtkPlusOpenIGTLinkTracker::WriteConfiguration(vtkXMLDataElement* root
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
   deviceConfig->SetAttribute("UseLastTransformsOnReceiveTimeout", this->UseLastTransformsOnReceiveTimeout ? "true" : "false");
+  deviceConfig->SetIntAttribute("TDATAResolution", this->TDATAResolution);
+  deviceConfig->SetAttribute("TDATACoalescing", this->TDATACoalescing ? "true" : "false");
+  if (this->IsDatagramReceiveEnabled())
+  {
+    XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(DatagramAddress, deviceConfig);
+    deviceConfig->SetIntAttribute("DatagramPort", this->DatagramPort);
+  }
   return PLUS_SUCCESS;
 }
 
@@ -524,3 +761,21 @@ bool vtkPlusOpenIGTLinkTracker::IsTDataMessageType()
   }
   return (igsioCommon::IsEqualInsensitive(this->MessageType, "TDATA"));
 }
+
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkTracker::IsDatagramReceiveEnabled() const
+{
+  return this->DatagramPort > 0;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkPlusOpenIGTLinkTracker::GetNumberOfReceivedDatagrams() const
+{
+  return (this->DatagramChannel != NULL ? this->DatagramChannel->GetNumberOfDatagrams() : 0);
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkPlusOpenIGTLinkTracker::GetNumberOfLostDatagrams() const
+{
+  return (this->DatagramChannel != NULL ? this->DatagramChannel->GetNumberOfLostDatagrams() + this->DatagramChannel->GetNumberOfDroppedDatagrams() : 0);
+}
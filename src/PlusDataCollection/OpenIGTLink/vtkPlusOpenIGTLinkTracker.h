@@ -12,10 +12,23 @@
 #include "vtkPlusOpenIGTLinkDevice.h"
 #include "vtkPlusIgtlMessageFactory.h"
 
+#include <igtlTrackingDataMessage.h>
+
+#include <cstdint>
+
+class PlusIgtlDatagramChannel;
+
 /*!
 \class vtkPlusOpenIGTLinkTracker
 \brief OpenIGTLink tracker client
 
+If DatagramPort is set then the tracking data is received from the datagram broadcast of a Plus server
+(see the DatagramBroadcast element of the PlusOpenIGTLinkServer configuration) instead of a TCP connection.
+DatagramAddress is the multicast group to join (not needed if the server sends the datagrams to this host directly).
+Datagrams that are sent directly to this host are only accepted from ServerAddress.
+
+TDATA messages can be received on a dedicated thread (see UseReceiveThread in vtkPlusOpenIGTLinkDevice).
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusOpenIGTLinkTracker : public vtkPlusOpenIGTLinkDevice
@@ -25,6 +38,9 @@ public:
   vtkTypeMacro(vtkPlusOpenIGTLinkTracker, vtkPlusOpenIGTLinkDevice);
   virtual void PrintSelf(ostream& os, vtkIndent indent);
 
+  /*! Connect to device. If datagram receiving is enabled then only the datagram socket is opened. */
+  virtual PlusStatus InternalConnect();
+
   /*! Disconnect from device */
   virtual PlusStatus InternalDisconnect();
 
@@ -42,6 +58,12 @@ public:
     return true;
   }
 
+  /*! Number of tracking data datagrams received since the device was connected (zero if datagram receiving is disabled) */
+  uint64_t GetNumberOfReceivedDatagrams() const;
+
+  /*! Number of tracking data datagrams lost or dropped (out of order) since the device was connected */
+  uint64_t GetNumberOfLostDatagrams() const;
+
 protected:
   vtkPlusOpenIGTLinkTracker();
   virtual ~vtkPlusOpenIGTLinkTracker();
@@ -50,6 +72,21 @@ protected:
 
   virtual PlusStatus SendRequestedMessageTypes();
 
+  /*! Request coalesced TDATA messages if enabled */
+  virtual void UpdateClientInfo(PlusIgtlClientInfo& clientInfo);
+
+  /*! The receive thread is supported for TDATA messages received through the TCP connection */
+  virtual bool IsReceiveThreadSupported();
+
+  /*! Receive a TDATA message and add the received transforms to the buffers, skip other messages */
+  virtual PlusStatus ProcessReceivedMessage(igtl::MessageHeader::Pointer headerMsg);
+
+  /*! Store the last known or invalid transforms, as if the message was received by polling */
+  virtual void OnReceiveThreadNoData();
+
+  /*! Receive the body of a TDATA message and add all the received transforms to the buffers */
+  PlusStatus ReceiveTrackingDataMessage(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer bodyMsg);
+
   /*! Process TRANSFORM or POSITION messages (add the received transform to the buffer) */
   PlusStatus InternalUpdateGeneral();
 
@@ -59,6 +96,18 @@ protected:
   /*! Process a TDATA message (add all the received transforms to the buffers) */
   PlusStatus InternalUpdateTData();
 
+  /*! Process all the TRANSFORM, POSITION, and TDATA messages that are received in datagrams */
+  PlusStatus InternalUpdateDatagram();
+
+  /*! Add all the transforms of an unpacked TDATA message to the buffers */
+  PlusStatus ProcessTrackingDataMessage(igtl::TrackingDataMessage::Pointer tdataMsg);
+
+  /*! Add a transform received in a TRANSFORM or POSITION message to the buffer */
+  PlusStatus StoreReceivedTransform(const std::string& igtlTransformName, vtkMatrix4x4* toolMatrix, ToolStatus toolStatus, double unfilteredTimestampUtc);
+
+  /*! Returns true if tracking data is received in datagrams instead of the TCP connection */
+  bool IsDatagramReceiveEnabled() const;
+
   /*!
     Store the latest transforms again in the buffers with the provided timestamp.
     If no transforms are defined then identity transform will be stored.
@@ -78,6 +127,33 @@ protected:
   /*! Use the last known transform value if not received a new value. Useful for servers that only notify about changes in the transforms. */
   bool UseLastTransformsOnReceiveTimeout;
 
+  vtkSetMacro(TDATAResolution, int);
+  vtkSetMacro(TDATACoalescing, bool);
+
+  /*! Minimum time between two TDATA messages, in milliseconds (requested from the server in STT_TDATA message) */
+  int TDATAResolution;
+
+  /*!
+    Request the server to send all tool poses collected in TDATAResolution time in each TDATA message
+    (instead of the latest poses only), with the original sample timestamps.
+  */
+  bool TDATACoalescing;
+
+  /*! Timestamp of the last sample that was added to the buffers from a TDATA message */
+  double LastTDataSampleTimestamp;
+
+  vtkSetStdStringMacro(DatagramAddress);
+  vtkSetMacro(DatagramPort, int);
+
+  /*! Multicast group of the tracking data datagrams. If empty then datagrams sent to any address of this host are received. */
+  std::string DatagramAddress;
+
+  /*! Port of the tracking data datagrams. Datagram receiving is disabled if it is not positive. */
+  int DatagramPort;
+
+  /*! Datagram receiver (only used if datagram receiving is enabled) */
+  PlusIgtlDatagramChannel* DatagramChannel;
+
 private:
   vtkPlusOpenIGTLinkTracker(const vtkPlusOpenIGTLinkTracker&);
   void operator=(const vtkPlusOpenIGTLinkTracker&);
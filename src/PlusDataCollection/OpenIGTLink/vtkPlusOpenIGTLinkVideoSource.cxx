@@ -6,6 +6,9 @@ See License.txt for details.
 
 // Plus includes
 #include "PlusConfigure.h"
+#include "PlusCommon.h"
+#include "PlusIgtlClientInfo.h"
+#include "PlusIgtlSharedMemoryRing.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusIgtlMessageCommon.h"
@@ -22,6 +25,9 @@ vtkStandardNewMacro(vtkPlusOpenIGTLinkVideoSource);
 
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkVideoSource::vtkPlusOpenIGTLinkVideoSource()
+  : UseSharedMemoryTransport(false)
+  , SharedMemoryRing(new PlusIgtlSharedMemoryRing)
+  , SharedMemoryRingUnavailable(false)
 {
   this->RequireImageOrientationInConfiguration = true;
 }
@@ -29,12 +35,34 @@ vtkPlusOpenIGTLinkVideoSource::vtkPlusOpenIGTLinkVideoSource()
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkVideoSource::~vtkPlusOpenIGTLinkVideoSource()
 {
+  // The receive thread uses the shared memory ring
+  this->StopReceiveThread();
+  delete this->SharedMemoryRing;
+  this->SharedMemoryRing = NULL;
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseSharedMemoryTransport: " << (this->UseSharedMemoryTransport ? "true" : "false") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkVideoSource::UpdateClientInfo(PlusIgtlClientInfo& clientInfo)
+{
+  if (this->UseSharedMemoryTransport && !this->SharedMemoryRingUnavailable)
+  {
+    // The shared memory image reference is stored in the binary frame data
+    clientInfo.SetSharedMemoryTransport(true);
+    clientInfo.SetTrackedFrameBinaryData(true);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkVideoSource::IsReceiveThreadSupported()
+{
+  return true;
 }
 
 //----------------------------------------------------------------------------
@@ -68,14 +96,35 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
   // We've received valid header data
   headerMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
 
+  return this->ProcessReceivedMessage(headerMsg);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::ProcessReceivedMessage(igtl::MessageHeader::Pointer headerMsg)
+{
   // Set unfiltered and filtered timestamp by converting UTC to system timestamp
   double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
 
+  vtkPlusDataSource* aSource = NULL;
+  if (this->GetFirstActiveOutputVideoSource(aSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve the video source in the OpenIGTLinkVideo device.");
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    this->ClientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+    return PLUS_FAIL;
+  }
+
   igsioTrackedFrame trackedFrame;
   igtl::MessageBase::Pointer bodyMsg = this->MessageFactory->CreateReceiveMessage(headerMsg);
 
   if (typeid(*bodyMsg) == typeid(igtl::ImageMessage))
   {
+    if (!this->ImageMessageEmbeddedTransformName.IsValid())
+    {
+      // Only the pixel data is needed, it can be copied from the message directly into the buffer
+      return this->ReceiveImageMessageIntoBuffer(headerMsg, bodyMsg, aSource, unfilteredTimestamp);
+    }
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
     if (vtkPlusIgtlMessageCommon::UnpackImageMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
     {
       LOG_ERROR("Couldn't get image from OpenIGTLink server!");
@@ -84,10 +133,33 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
   }
   else if (typeid(*bodyMsg) == typeid(igtl::PlusTrackedFrameMessage))
   {
-    if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Couldn't get tracked frame from OpenIGTLink server!");
-      return PLUS_FAIL;
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+      bool useSharedMemoryRing = this->UseSharedMemoryTransport && !this->SharedMemoryRingUnavailable;
+      vtkPlusIgtlMessageCommon::SharedMemoryImageStatus sharedMemoryStatus(vtkPlusIgtlMessageCommon::SHARED_MEMORY_IMAGE_NOT_USED);
+      if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled,
+          useSharedMemoryRing ? this->SharedMemoryRing : NULL, this->UseSharedMemoryTransport ? &sharedMemoryStatus : NULL) != PLUS_SUCCESS)
+      {
+        if (sharedMemoryStatus == vtkPlusIgtlMessageCommon::SHARED_MEMORY_IMAGE_OVERWRITTEN)
+        {
+          // This client is slower than the server, the frame is dropped (later frames are still available)
+          return PLUS_SUCCESS;
+        }
+        if (sharedMemoryStatus == vtkPlusIgtlMessageCommon::SHARED_MEMORY_RING_UNAVAILABLE)
+        {
+          if (useSharedMemoryRing)
+          {
+            // E.g., the server runs as a different user and the ring is not accessible: request the image data in the socket
+            LOG_WARNING("Shared memory ring of the OpenIGTLink server cannot be opened in device " << this->GetDeviceId() << ", image data is received through the socket instead");
+            this->SharedMemoryRingUnavailable = true;
+            return this->SendRequestedMessageTypes();
+          }
+          // Frame was sent before the server switched to socket transport
+          return PLUS_SUCCESS;
+        }
+        LOG_ERROR("Couldn't get tracked frame from OpenIGTLink server!");
+        return PLUS_FAIL;
+      }
     }
     double unfilteredTimestampUtc = trackedFrame.GetTimestamp();
     if (this->UseReceivedTimestamps)
@@ -113,45 +185,112 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
   // for simplicity, we increase frame number always by 1.
   this->FrameNumber++;
 
-  vtkPlusDataSource* aSource = NULL;
-  if (this->GetFirstActiveOutputVideoSource(aSource) != PLUS_SUCCESS)
+  igsioVideoFrame* videoFrame = trackedFrame.GetImageData();
+  if (videoFrame == NULL)
   {
-    LOG_ERROR("Unable to retrieve the video source in the OpenIGTLinkVideo device.");
+    LOG_ERROR("Invalid video frame received, cannot use it to initialize the video buffer");
+    return PLUS_FAIL;
+  }
+  unsigned int numberOfScalarComponents(1);
+  if (videoFrame->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve number of scalar components.");
     return PLUS_FAIL;
   }
+  if (this->InitializeVideoSource(aSource, trackedFrame.GetFrameSize(), videoFrame->GetVTKScalarPixelType(), numberOfScalarComponents, videoFrame->GetImageType()) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  igsioFieldMapType customFields = trackedFrame.GetCustomFields();
+  PlusStatus status = aSource->AddItem(videoFrame, this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &customFields);
+  this->Modified();
 
-  // If the buffer is empty, set the pixel type and frame size to the first received properties
-  if (aSource->GetNumberOfItems() == 0)
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::ReceiveImageMessageIntoBuffer(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer bodyMsg,
+    vtkPlusDataSource* aSource, double unfilteredTimestamp)
+{
+  igtl::ImageMessage::Pointer imgMsg = dynamic_cast<igtl::ImageMessage*>(bodyMsg.GetPointer());
+  imgMsg->SetMessageHeader(headerMsg);
+  imgMsg->AllocateBuffer();
   {
-    igsioVideoFrame* videoFrame = trackedFrame.GetImageData();
-    if (videoFrame == NULL)
-    {
-      LOG_ERROR("Invalid video frame received, cannot use it to initialize the video buffer");
-      return PLUS_FAIL;
-    }
-    aSource->SetPixelType(videoFrame->GetVTKScalarPixelType());
-    unsigned int numberOfScalarComponents(1);
-    if (videoFrame->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+    bool timeout(false);
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    int numOfBytesReceived = this->ClientSocket->Receive(imgMsg->GetBufferBodyPointer(), imgMsg->GetBufferBodySize(), timeout);
+    if (numOfBytesReceived < 0 || static_cast<igtlUint64>(numOfBytesReceived) != imgMsg->GetBufferBodySize())
     {
-      LOG_ERROR("Unable to retrieve number of scalar components.");
+      // Without CRC check a partial body would be unpacked as a valid frame. The rest of the message may still arrive,
+      // so the connection is closed to make the device reconnect instead of reading the next header from the middle of this message.
+      LOG_ERROR("Couldn't receive image message body from OpenIGTLink server in device " << this->GetDeviceId() << " (received "
+                << numOfBytesReceived << " of " << imgMsg->GetBufferBodySize() << " bytes)");
+      this->ClientSocket->CloseSocket();
       return PLUS_FAIL;
     }
-    aSource->SetNumberOfScalarComponents(numberOfScalarComponents);
-    aSource->SetImageType(videoFrame->GetImageType());
-    aSource->SetInputFrameSize(trackedFrame.GetFrameSize());
   }
-  igsioFieldMapType customFields = trackedFrame.GetCustomFields();
-  PlusStatus status = aSource->AddItem(trackedFrame.GetImageData(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &customFields);
+  int c = imgMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  {
+    LOG_ERROR("Couldn't get image from OpenIGTLink server!");
+    return PLUS_FAIL;
+  }
+
+  int imgSize[3] = {0}; // image dimension in pixels
+  imgMsg->GetDimensions(imgSize);
+  if (imgSize[0] < 0 || imgSize[1] < 0 || imgSize[2] < 0)
+  {
+    LOG_ERROR("Image with negative dimension received, cannot use it in the video buffer");
+    return PLUS_FAIL;
+  }
+  FrameSizeType frameSize = {static_cast<unsigned int>(imgSize[0]), static_cast<unsigned int>(imgSize[1]), static_cast<unsigned int>(imgSize[2]) };
+  igsioCommon::VTKScalarPixelType pixelType = PlusCommon::GetVTKScalarPixelTypeFromIGTL(imgMsg->GetScalarType());
+  unsigned int numberOfScalarComponents = static_cast<unsigned int>(imgMsg->GetNumComponents());
+  US_IMAGE_TYPE imageType = US_IMG_BRIGHTNESS;
+  if (imgMsg->GetScalarType() == igtl::ImageMessage::TYPE_INT8 && imgMsg->GetNumComponents() == igtl::ImageMessage::DTYPE_VECTOR)
+  {
+    imageType = US_IMG_RGB_COLOR;
+  }
+
+  if (this->InitializeVideoSource(aSource, frameSize, pixelType, numberOfScalarComponents, imageType) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  this->FrameNumber++;
+  // Time of reception is used as timestamp (same as for images that are unpacked into a tracked frame), no filtering is needed
+  PlusStatus status = aSource->AddItem(imgMsg->GetScalarPointer(), US_IMG_ORIENT_MF, frameSize, pixelType, numberOfScalarComponents, imageType, 0,
+                                       this->FrameNumber, unfilteredTimestamp, unfilteredTimestamp);
   this->Modified();
 
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::InitializeVideoSource(vtkPlusDataSource* aSource, const FrameSizeType& frameSize, igsioCommon::VTKScalarPixelType pixelType,
+    unsigned int numberOfScalarComponents, US_IMAGE_TYPE imageType)
+{
+  if (aSource->GetNumberOfItems() != 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  aSource->SetPixelType(pixelType);
+  aSource->SetNumberOfScalarComponents(numberOfScalarComponents);
+  aSource->SetImageType(imageType);
+  aSource->SetInputFrameSize(frameSize);
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkVideoSource::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(ImageMessageEmbeddedTransformName, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseSharedMemoryTransport, deviceConfig);
+  if (this->UseSharedMemoryTransport && !igsioCommon::IsEqualInsensitive(this->MessageType, "TRACKEDFRAME"))
+  {
+    LOG_WARNING("UseSharedMemoryTransport is only supported for TRACKEDFRAME messages, images are received through the socket");
+  }
   return PLUS_SUCCESS;
 }
 
@@ -160,6 +299,7 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::WriteConfiguration(vtkXMLDataElement*
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
   deviceConfig->SetAttribute("ImageMessageEmbeddedTransformName", this->ImageMessageEmbeddedTransformName.GetTransformName().c_str());
+  deviceConfig->SetAttribute("UseSharedMemoryTransport", this->UseSharedMemoryTransport ? "true" : "false");
   return PLUS_SUCCESS;
 }
 
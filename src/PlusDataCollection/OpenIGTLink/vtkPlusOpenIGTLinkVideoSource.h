@@ -12,12 +12,22 @@
 #include "vtkPlusOpenIGTLinkDevice.h"
 #include "vtkPlusIgtlMessageFactory.h"
 
+class PlusIgtlSharedMemoryRing;
+
 /*!
   \class vtkPlusOpenIGTLinkVideoSource
   \brief VTK interface for video input from OpenIGTLink image message
 
   vtkPlusOpenIGTLinkVideoSource is a class for providing video input interfaces between VTK and OpenIGTLink ready video device.
 
+  If UseSharedMemoryTransport is enabled and the server runs on the same host (and has shared memory transport enabled)
+  then the image data of TRACKEDFRAME messages is read from the shared memory ring of the server instead of the socket.
+  Frames that the server already overwrote in the ring are dropped. If the ring cannot be opened (e.g., the server runs
+  as a different user) then the device requests the image data through the socket instead.
+
+  Pixel data of IMAGE messages (without embedded transform) is copied from the received message directly into the video buffer.
+  The device supports receiving messages on a dedicated thread (see UseReceiveThread in vtkPlusOpenIGTLinkDevice).
+
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusOpenIGTLinkVideoSource : public vtkPlusOpenIGTLinkDevice
@@ -44,10 +54,37 @@ public:
   /*! Verify the device is correctly configured */
   virtual PlusStatus NotifyConfigured();
 
+  vtkSetMacro(UseSharedMemoryTransport, bool);
+  vtkGetMacro(UseSharedMemoryTransport, bool);
+
 protected:
   vtkPlusOpenIGTLinkVideoSource();
   virtual ~vtkPlusOpenIGTLinkVideoSource();
 
+  /*! Request shared memory transport if enabled */
+  virtual void UpdateClientInfo(PlusIgtlClientInfo& clientInfo);
+
+  virtual bool IsReceiveThreadSupported();
+
+  /*! Receive the message body and add the received frame to the video buffer */
+  virtual PlusStatus ProcessReceivedMessage(igtl::MessageHeader::Pointer headerMsg);
+
+  /*! Receive an IMAGE message body and copy the pixel data directly into the video buffer */
+  PlusStatus ReceiveImageMessageIntoBuffer(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer bodyMsg, vtkPlusDataSource* aSource, double unfilteredTimestamp);
+
+  /*! If the buffer is empty, set the pixel type and frame size to the first received properties */
+  PlusStatus InitializeVideoSource(vtkPlusDataSource* aSource, const FrameSizeType& frameSize, igsioCommon::VTKScalarPixelType pixelType,
+                                   unsigned int numberOfScalarComponents, US_IMAGE_TYPE imageType);
+
+  /*! Request image data of TRACKEDFRAME messages through shared memory (only used if the server is on the same host) */
+  bool UseSharedMemoryTransport;
+
+  /*! Shared memory ring of the server, opened when the first message that refers to it is received */
+  PlusIgtlSharedMemoryRing* SharedMemoryRing;
+
+  /*! Set if the shared memory ring of the server could not be opened, the image data is requested through the socket then */
+  bool SharedMemoryRingUnavailable;
+
 private:
   vtkPlusOpenIGTLinkVideoSource(const vtkPlusOpenIGTLinkVideoSource&);   // Not implemented.
   void operator=(const vtkPlusOpenIGTLinkVideoSource&);   // Not implemented.
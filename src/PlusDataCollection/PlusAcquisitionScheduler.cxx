@@ -0,0 +1,396 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusAcquisitionScheduler.h"
+#include "PlusMetrics.h"
+
+// STL includes
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <thread>
+
+// System includes
+#if defined(_WIN32)
+  #include <windows.h>
+#elif defined(__linux__)
+  #include <errno.h>
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/prctl.h>
+  #include <time.h>
+#endif
+
+namespace
+{
+  // Worker threads wake up this much earlier than the deadline and wait for the exact deadline outside the lock
+  const std::chrono::microseconds DEADLINE_WAKEUP_LEAD(500);
+
+  //----------------------------------------------------------------------------
+  void SleepUntil(std::chrono::steady_clock::time_point deadline)
+  {
+#if defined(__linux__)
+    // steady_clock is CLOCK_MONOTONIC on Linux
+    std::chrono::nanoseconds deadlineNs = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+    struct timespec deadlineTs;
+    deadlineTs.tv_sec = static_cast<time_t>(deadlineNs.count() / 1000000000LL);
+    deadlineTs.tv_nsec = static_cast<long>(deadlineNs.count() % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadlineTs, NULL) == EINTR)
+    {
+    }
+#else
+    std::this_thread::sleep_until(deadline);
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns true if the current thread can be restricted to the CPU core */
+  bool IsValidCpuIndex(int cpuIndex)
+  {
+#if defined(_WIN32)
+    const int maxNumberOfCpus = static_cast<int>(sizeof(DWORD_PTR) * 8);
+#elif defined(__linux__)
+    const int maxNumberOfCpus = CPU_SETSIZE;
+#else
+    const int maxNumberOfCpus = std::numeric_limits<int>::max();
+#endif
+    // hardware_concurrency returns 0 if the number of cores is unknown
+    const unsigned int numberOfCpus = std::thread::hardware_concurrency();
+    return cpuIndex >= 0 && cpuIndex < maxNumberOfCpus && (numberOfCpus == 0 || static_cast<unsigned int>(cpuIndex) < numberOfCpus);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Restrict the current thread to a single CPU core. If cpuIndex is negative then all cores are allowed. */
+  void SetCurrentThreadAffinity(int cpuIndex)
+  {
+    if (cpuIndex >= 0 && !IsValidCpuIndex(cpuIndex))
+    {
+      LOG_WARNING("Acquisition scheduler thread affinity is not set: CPU " << cpuIndex << " is out of range (number of CPUs: " << std::thread::hardware_concurrency() << ")");
+      return;
+    }
+#if defined(_WIN32)
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+    DWORD_PTR threadMask = (cpuIndex >= 0 ? (static_cast<DWORD_PTR>(1) << cpuIndex) : processMask);
+    if (SetThreadAffinityMask(GetCurrentThread(), threadMask) == 0)
+    {
+      LOG_WARNING("Failed to set acquisition scheduler thread affinity to CPU " << cpuIndex);
+    }
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (cpuIndex >= 0)
+    {
+      CPU_SET(cpuIndex, &cpuSet);
+    }
+    else
+    {
+      for (int i = 0; i < CPU_SETSIZE; ++i)
+      {
+        CPU_SET(i, &cpuSet);
+      }
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+    {
+      LOG_WARNING("Failed to set acquisition scheduler thread affinity to CPU " << cpuIndex);
+    }
+#else
+    if (cpuIndex >= 0)
+    {
+      LOG_WARNING("Acquisition scheduler thread affinity is not supported on this platform");
+    }
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  void SetCurrentThreadRealTimePriority(int priority)
+  {
+#if defined(_WIN32)
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+      LOG_WARNING("Failed to set time critical priority for acquisition scheduler thread");
+    }
+#elif defined(__linux__)
+    struct sched_param param;
+    param.sched_priority = priority;
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0)
+    {
+      LOG_WARNING("Failed to set SCHED_FIFO priority " << priority << " for acquisition scheduler thread (error code: " << result
+                  << "). Real-time scheduling requires CAP_SYS_NICE capability or an appropriate RLIMIT_RTPRIO.");
+    }
+#else
+    LOG_WARNING("Real-time priority of acquisition scheduler threads is not supported on this platform");
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusAcquisitionScheduler::PlusAcquisitionScheduler()
+  : StopRequested(false)
+  , NumberOfThreads(0)
+  , RealTimePriority(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusAcquisitionScheduler* PlusAcquisitionScheduler::GetInstance()
+{
+  // Intentionally never deleted: worker threads are stopped when the last task is removed
+  static PlusAcquisitionScheduler* instance = new PlusAcquisitionScheduler;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+void PlusAcquisitionScheduler::SetNumberOfThreads(int numberOfThreads)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->NumberOfThreads = numberOfThreads;
+}
+
+//----------------------------------------------------------------------------
+int PlusAcquisitionScheduler::GetNumberOfThreads() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->NumberOfThreads;
+}
+
+//----------------------------------------------------------------------------
+void PlusAcquisitionScheduler::SetRealTimePriority(int priority)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->RealTimePriority = priority;
+}
+
+//----------------------------------------------------------------------------
+int PlusAcquisitionScheduler::GetRealTimePriority() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->RealTimePriority;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusAcquisitionScheduler::AddTask(const std::string& name, double periodSec, int priority, int cpuAffinity, TaskFunction function)
+{
+  if (periodSec <= 0)
+  {
+    LOG_ERROR("Failed to add acquisition task " << name << ": invalid period (" << periodSec << " sec)");
+    return PLUS_FAIL;
+  }
+
+  if (cpuAffinity >= 0 && !IsValidCpuIndex(cpuAffinity))
+  {
+    LOG_WARNING("CPU affinity of acquisition task " << name << " is ignored: CPU " << cpuAffinity << " is out of range (number of CPUs: " << std::thread::hardware_concurrency() << ")");
+    cpuAffinity = -1;
+  }
+
+  std::shared_ptr<Task> task = std::make_shared<Task>();
+  task->Name = name;
+  task->Period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(periodSec));
+  task->Priority = priority;
+  task->CpuAffinity = cpuAffinity;
+  task->Function = function;
+  task->Deadline = Clock::now();
+  task->Running = false;
+  task->Removed = false;
+  task->JitterSumSec = 0.0;
+  std::string labels = PlusMetricsRegistry::MakeLabel("device", name);
+  task->UpdatesCounter = PlusMetricsRegistry::GetInstance()->GetCounter("plus_scheduler_updates_total", labels);
+  task->MissedDeadlinesCounter = PlusMetricsRegistry::GetInstance()->GetCounter("plus_scheduler_missed_deadlines_total", labels);
+  task->JitterHistogram = PlusMetricsRegistry::GetInstance()->GetHistogram("plus_scheduler_jitter_seconds", labels);
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->Tasks.find(name) != this->Tasks.end())
+  {
+    LOG_ERROR("Failed to add acquisition task " << name << ": a task already exists with the same name");
+    return PLUS_FAIL;
+  }
+  this->Tasks[name] = task;
+  if (this->Workers.empty() && !this->StopRequested)
+  {
+    this->StartWorkers();
+  }
+  this->Condition.notify_all();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusAcquisitionScheduler::RemoveTask(const std::string& name)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  auto taskIt = this->Tasks.find(name);
+  if (taskIt == this->Tasks.end())
+  {
+    LOG_ERROR("Failed to remove acquisition task " << name << ": task not found");
+    return PLUS_FAIL;
+  }
+  std::shared_ptr<Task> task = taskIt->second;
+  task->Removed = true;
+  while (task->Running)
+  {
+    this->Condition.wait(lock);
+  }
+  this->Tasks.erase(name);
+
+  const TaskStatistics& stats = task->Statistics;
+  LOG_INFO("Acquisition task " << name << " statistics: " << stats.NumberOfUpdates << " updates, " << stats.NumberOfMissedDeadlines << " missed deadlines, jitter: "
+           << std::fixed << std::setprecision(3) << stats.MeanJitterSec * 1000.0 << "ms mean, " << stats.MaxJitterSec * 1000.0 << "ms max");
+
+  if (this->Tasks.empty())
+  {
+    this->StopWorkers(lock);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusAcquisitionScheduler::GetTaskStatistics(const std::string& name, TaskStatistics& statistics)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  auto taskIt = this->Tasks.find(name);
+  if (taskIt == this->Tasks.end())
+  {
+    return PLUS_FAIL;
+  }
+  statistics = taskIt->second->Statistics;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::shared_ptr<PlusAcquisitionScheduler::Task> PlusAcquisitionScheduler::GetNextTask(Clock::time_point now)
+{
+  std::shared_ptr<Task> nextTask;
+  bool nextTaskDue = false;
+  for (auto taskIt = this->Tasks.begin(); taskIt != this->Tasks.end(); ++taskIt)
+  {
+    const std::shared_ptr<Task>& task = taskIt->second;
+    if (task->Running || task->Removed)
+    {
+      continue;
+    }
+    bool taskDue = (task->Deadline <= now + DEADLINE_WAKEUP_LEAD);
+    if (!nextTask
+        || (taskDue && !nextTaskDue)
+        || (taskDue && nextTaskDue && (task->Priority > nextTask->Priority || (task->Priority == nextTask->Priority && task->Deadline < nextTask->Deadline)))
+        || (!taskDue && !nextTaskDue && task->Deadline < nextTask->Deadline))
+    {
+      nextTask = task;
+      nextTaskDue = taskDue;
+    }
+  }
+  return nextTask;
+}
+
+//----------------------------------------------------------------------------
+void PlusAcquisitionScheduler::StartWorkers()
+{
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  LOG_DEBUG("Starting acquisition scheduler with " << numberOfThreads << " worker threads");
+  for (int i = 0; i < numberOfThreads; ++i)
+  {
+    this->Workers.push_back(std::thread(&PlusAcquisitionScheduler::WorkerThread, this));
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusAcquisitionScheduler::StopWorkers(std::unique_lock<std::mutex>& lock)
+{
+  this->StopRequested = true;
+  this->Condition.notify_all();
+  std::vector<std::thread> workers;
+  workers.swap(this->Workers);
+  lock.unlock();
+  for (auto workerIt = workers.begin(); workerIt != workers.end(); ++workerIt)
+  {
+    workerIt->join();
+  }
+  lock.lock();
+  this->StopRequested = false;
+  LOG_DEBUG("Acquisition scheduler worker threads stopped");
+  if (!this->Tasks.empty())
+  {
+    // Tasks were added while the workers were stopping
+    this->StartWorkers();
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusAcquisitionScheduler::WorkerThread()
+{
+#if defined(__linux__)
+  // Minimal timer slack for accurate wakeups
+  prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+#endif
+  int realTimePriority = this->GetRealTimePriority();
+  if (realTimePriority > 0)
+  {
+    SetCurrentThreadRealTimePriority(realTimePriority);
+  }
+  int currentCpuAffinity = -1;
+
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  while (!this->StopRequested)
+  {
+    std::shared_ptr<Task> task = this->GetNextTask(Clock::now());
+    if (!task)
+    {
+      this->Condition.wait(lock);
+      continue;
+    }
+    if (task->Deadline - DEADLINE_WAKEUP_LEAD > Clock::now())
+    {
+      // Tasks may be added, removed, or picked up by other workers while waiting, therefore re-evaluate after wakeup
+      this->Condition.wait_until(lock, task->Deadline - DEADLINE_WAKEUP_LEAD);
+      continue;
+    }
+
+    task->Running = true;
+    lock.unlock();
+
+    SleepUntil(task->Deadline);
+    if (task->CpuAffinity != currentCpuAffinity)
+    {
+      SetCurrentThreadAffinity(task->CpuAffinity);
+      currentCpuAffinity = task->CpuAffinity;
+    }
+    Clock::time_point startTime = Clock::now();
+    task->Function();
+    Clock::time_point endTime = Clock::now();
+
+    lock.lock();
+    double jitterSec = std::chrono::duration<double>(startTime - task->Deadline).count();
+    TaskStatistics& stats = task->Statistics;
+    stats.NumberOfUpdates++;
+    task->JitterSumSec += jitterSec;
+    stats.MeanJitterSec = task->JitterSumSec / stats.NumberOfUpdates;
+    stats.MaxJitterSec = std::max(stats.MaxJitterSec, jitterSec);
+    uint64_t missedDeadlines = 0;
+    task->Deadline += task->Period;
+    if (task->Deadline < endTime)
+    {
+      // The update took longer than the period: skip the missed periods. The deadline is advanced by whole
+      // periods, so that the schedule keeps its phase (the next update runs at the first deadline after now).
+      missedDeadlines = static_cast<uint64_t>((endTime - task->Deadline) / task->Period) + 1;
+      stats.NumberOfMissedDeadlines += missedDeadlines;
+      task->Deadline += task->Period * static_cast<Clock::rep>(missedDeadlines);
+    }
+    if (PlusMetricsRegistry::IsEnabled())
+    {
+      task->UpdatesCounter->Add(1);
+      task->MissedDeadlinesCounter->Add(missedDeadlines);
+      task->JitterHistogram->RecordSec(jitterSec);
+    }
+    task->Running = false;
+    // Notify waiting workers (the task may be due again) and RemoveTask
+    this->Condition.notify_all();
+  }
+}
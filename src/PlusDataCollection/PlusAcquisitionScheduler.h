@@ -0,0 +1,127 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusAcquisitionScheduler_h
+#define __PlusAcquisitionScheduler_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+
+// STL includes
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PlusMetricCounter;
+class PlusMetricHistogram;
+
+/*!
+  \class PlusAcquisitionScheduler
+  \brief Shared scheduler that calls periodic acquisition tasks from a pool of worker threads
+
+  Devices that require polling (StartThreadForInternalUpdates) normally use one thread each, which sleeps
+  between updates for a relative time. Devices with UseAcquisitionScheduler enabled are updated by this
+  scheduler instead: each task has an absolute deadline (next deadline = previous deadline + period, so there
+  is no drift; if an update overruns then the missed periods are skipped, which keeps the phase of the schedule), a priority (when multiple tasks are due then the one with the highest priority runs first),
+  and an optional CPU affinity. Worker threads wait for the deadline using absolute timers (clock_nanosleep on Linux)
+  and may use real-time (SCHED_FIFO) scheduling.
+
+  Start time jitter and missed deadlines (periods that had to be skipped because the previous update was not completed in time)
+  are collected for each task and reported when the task is removed and as plus_scheduler_* metrics.
+
+  Worker threads are started when the first task is added and stopped when the last task is removed.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusAcquisitionScheduler
+{
+public:
+  typedef std::function<void()> TaskFunction;
+
+  struct TaskStatistics
+  {
+    uint64_t NumberOfUpdates;
+    uint64_t NumberOfMissedDeadlines;
+    double MeanJitterSec;
+    double MaxJitterSec;
+    TaskStatistics() : NumberOfUpdates(0), NumberOfMissedDeadlines(0), MeanJitterSec(0.0), MaxJitterSec(0.0) {}
+  };
+
+  static PlusAcquisitionScheduler* GetInstance();
+
+  /*! Number of worker threads. If 0 then the number of CPU cores is used. Takes effect when the worker threads are started. */
+  void SetNumberOfThreads(int numberOfThreads);
+  int GetNumberOfThreads() const;
+
+  /*! Real-time (SCHED_FIFO) priority of the worker threads (1-99). If 0 then normal scheduling is used. Takes effect when the worker threads are started. */
+  void SetRealTimePriority(int priority);
+  int GetRealTimePriority() const;
+
+  /*!
+    Add a periodic task. The first execution is scheduled immediately.
+    \param name Unique name of the task (device ID)
+    \param periodSec Time between two consecutive executions
+    \param priority Tasks with higher priority are executed first if multiple tasks are due
+    \param cpuAffinity Index of the CPU core where the task must be executed, -1 if any core can be used
+  */
+  PlusStatus AddTask(const std::string& name, double periodSec, int priority, int cpuAffinity, TaskFunction function);
+
+  /*! Remove a task. If the task is being executed then waits for the execution to complete. Must not be called from a task function. */
+  PlusStatus RemoveTask(const std::string& name);
+
+  PlusStatus GetTaskStatistics(const std::string& name, TaskStatistics& statistics);
+
+protected:
+  PlusAcquisitionScheduler();
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct Task
+  {
+    std::string Name;
+    Clock::duration Period;
+    int Priority;
+    int CpuAffinity;
+    TaskFunction Function;
+    Clock::time_point Deadline;
+    bool Running;
+    bool Removed;
+    TaskStatistics Statistics;
+    double JitterSumSec;
+    PlusMetricCounter* UpdatesCounter;
+    PlusMetricCounter* MissedDeadlinesCounter;
+    PlusMetricHistogram* JitterHistogram;
+  };
+
+  /*! Get the task that should be executed next. Returns NULL if there are no tasks waiting for execution. Must be called with the mutex locked. */
+  std::shared_ptr<Task> GetNextTask(Clock::time_point now);
+
+  void StartWorkers();
+  void StopWorkers(std::unique_lock<std::mutex>& lock);
+  void WorkerThread();
+
+  std::map<std::string, std::shared_ptr<Task> > Tasks;
+  std::vector<std::thread> Workers;
+  bool StopRequested;
+  int NumberOfThreads;
+  int RealTimePriority;
+
+  mutable std::mutex Mutex;
+  std::condition_variable Condition;
+
+private:
+  PlusAcquisitionScheduler(const PlusAcquisitionScheduler&);
+  void operator=(const PlusAcquisitionScheduler&);
+};
+
+#endif //__PlusAcquisitionScheduler_h
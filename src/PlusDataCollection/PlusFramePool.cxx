@@ -0,0 +1,437 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusFramePool.h"
+#include "PlusMetrics.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <cstdlib>
+#include <iomanip>
+
+// System includes
+#if defined(_WIN32)
+  #include <windows.h>
+#elif defined(__linux__)
+  #include <sys/mman.h>
+#endif
+
+namespace
+{
+  // Frames up to this size are rounded up to a whole number of pages, larger frames to 1/8 of their power-of-two range
+  const size_t SMALL_FRAME_SIZE_LIMIT = 64 * 1024;
+  const size_t PAGE_SIZE_BYTES = 4096;
+  const int SIZE_CLASSES_PER_POWER_OF_TWO = 8;
+
+  //----------------------------------------------------------------------------
+  size_t RoundUp(size_t value, size_t multiple)
+  {
+    return ((value + multiple - 1) / multiple) * multiple;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Size of huge pages, 0 if huge pages are not supported */
+  size_t GetHugePageSize()
+  {
+#if defined(_WIN32)
+    return static_cast<size_t>(GetLargePageMinimum());
+#elif defined(__linux__)
+    // Default huge page size on x86_64 and most aarch64 configurations
+    return 2 * 1024 * 1024;
+#else
+    return 0;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  double ToMegabytes(uint64_t bytes)
+  {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusFramePool::PlusFramePool()
+  : MemoryBudgetBytes(0)
+  , UsedBytes(0)
+  , ReservedBytes(0)
+  , UseHugePages(false)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusFramePool* PlusFramePool::GetInstance()
+{
+  // Intentionally never deleted: frames may be released by VTK objects that are destroyed during static deinitialization
+  static PlusFramePool* instance = new PlusFramePool;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::SetMemoryBudgetBytes(uint64_t budgetBytes)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MemoryBudgetBytes = budgetBytes;
+  if (this->MemoryBudgetBytes > 0 && this->UsedBytes > this->MemoryBudgetBytes)
+  {
+    LOG_WARNING("Frame memory budget (" << ToMegabytes(this->MemoryBudgetBytes) << "MB) is less than the memory already used by frames ("
+                << ToMegabytes(this->UsedBytes) << "MB). New frames cannot be allocated until frames are released.");
+  }
+  this->ReleaseCachedBlocks(0);
+  this->UpdateMetrics();
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusFramePool::GetMemoryBudgetBytes() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->MemoryBudgetBytes;
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::SetUseHugePages(bool useHugePages)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (useHugePages && GetHugePageSize() == 0)
+  {
+    LOG_WARNING("Huge pages are not supported on this platform");
+  }
+  this->UseHugePages = useHugePages;
+}
+
+//----------------------------------------------------------------------------
+bool PlusFramePool::GetUseHugePages() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->UseHugePages;
+}
+
+//----------------------------------------------------------------------------
+size_t PlusFramePool::GetSizeClass(size_t numberOfBytes) const
+{
+  size_t sizeClass = 0;
+  if (numberOfBytes <= SMALL_FRAME_SIZE_LIMIT)
+  {
+    sizeClass = RoundUp(numberOfBytes, PAGE_SIZE_BYTES);
+  }
+  else
+  {
+    size_t powerOfTwo = SMALL_FRAME_SIZE_LIMIT;
+    while (powerOfTwo * 2 <= numberOfBytes)
+    {
+      powerOfTwo *= 2;
+    }
+    sizeClass = RoundUp(numberOfBytes, powerOfTwo / SIZE_CLASSES_PER_POWER_OF_TWO);
+  }
+
+  size_t hugePageSize = GetHugePageSize();
+  if (this->UseHugePages && hugePageSize > 0 && sizeClass >= hugePageSize)
+  {
+    sizeClass = RoundUp(sizeClass, hugePageSize);
+  }
+  return sizeClass;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusFramePool::AllocateImage(vtkImageData* image, const FrameSizeType& frameSize, igsioCommon::VTKScalarPixelType pixelType,
+                                        unsigned int numberOfScalarComponents, const void* owner, const std::string& ownerName)
+{
+  if (image == NULL)
+  {
+    LOG_ERROR("PlusFramePool::AllocateImage failed: image is invalid");
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkDataArray> scalars = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(pixelType));
+  if (scalars.GetPointer() == NULL)
+  {
+    LOG_ERROR("PlusFramePool::AllocateImage failed: unsupported pixel type " << pixelType);
+    return PLUS_FAIL;
+  }
+
+  vtkIdType numberOfValues = static_cast<vtkIdType>(frameSize[0]) * frameSize[1] * frameSize[2] * numberOfScalarComponents;
+  size_t numberOfBytes = static_cast<size_t>(numberOfValues) * scalars->GetDataTypeSize();
+  if (numberOfBytes == 0)
+  {
+    LOG_ERROR("PlusFramePool::AllocateImage failed: frame size is empty");
+    return PLUS_FAIL;
+  }
+
+  Block block;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (!this->AcquireBlock(this->GetSizeClass(numberOfBytes), block))
+    {
+      PLUS_METRIC_COUNTER_ADD("plus_frame_pool_allocation_failures_total", "", 1);
+      LOG_DEBUG("Frame memory budget (" << ToMegabytes(this->MemoryBudgetBytes) << "MB) does not allow allocation of a "
+                << ToMegabytes(numberOfBytes) << "MB frame for " << ownerName);
+      return PLUS_FAIL;
+    }
+
+    UsedBlock& usedBlock = this->UsedBlocks[block.Pointer];
+    usedBlock.Memory = block;
+    usedBlock.Owner = owner;
+
+    OwnerUsage& usage = this->Owners[owner];
+    usage.Name = ownerName;
+    usage.AllocatedBytes += block.Size;
+    usage.NumberOfFrames++;
+    if (usage.AllocatedBytes > usage.PeakAllocatedBytes)
+    {
+      usage.PeakAllocatedBytes = usage.AllocatedBytes;
+    }
+
+    this->UsedBytes += block.Size;
+    this->UpdateMetrics();
+  }
+
+  scalars->SetNumberOfComponents(numberOfScalarComponents);
+  scalars->SetVoidArray(block.Pointer, numberOfValues, 0, vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+  scalars->SetArrayFreeFunction(&PlusFramePool::FreeImageMemory);
+
+  image->SetExtent(0, frameSize[0] - 1, 0, frameSize[1] - 1, 0, frameSize[2] - 1);
+  // Replacing the scalars returns the previously pooled memory of the image (if any) to the pool
+  image->GetPointData()->SetScalars(scalars);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool PlusFramePool::AcquireBlock(size_t sizeClass, Block& block)
+{
+  std::map<size_t, std::vector<Block> >::iterator freeListIt = this->FreeBlocks.find(sizeClass);
+  if (freeListIt != this->FreeBlocks.end() && !freeListIt->second.empty())
+  {
+    block = freeListIt->second.back();
+    freeListIt->second.pop_back();
+    return true;
+  }
+
+  if (this->MemoryBudgetBytes > 0 && this->ReservedBytes + sizeClass > this->MemoryBudgetBytes)
+  {
+    this->ReleaseCachedBlocks(sizeClass);
+    if (this->ReservedBytes + sizeClass > this->MemoryBudgetBytes)
+    {
+      return false;
+    }
+  }
+
+  if (!this->AllocateSystemMemory(sizeClass, block))
+  {
+    LOG_ERROR("Failed to allocate " << ToMegabytes(sizeClass) << "MB memory for a frame");
+    return false;
+  }
+  this->ReservedBytes += block.Size;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::ReleaseCachedBlocks(uint64_t requiredBytes)
+{
+  if (this->MemoryBudgetBytes == 0)
+  {
+    // No budget, cached blocks are only released by ReleaseCachedMemory()
+    return;
+  }
+  // Release the largest blocks first, as these are the most expensive to keep
+  for (std::map<size_t, std::vector<Block> >::reverse_iterator freeListIt = this->FreeBlocks.rbegin(); freeListIt != this->FreeBlocks.rend(); ++freeListIt)
+  {
+    while (!freeListIt->second.empty())
+    {
+      if (this->ReservedBytes + requiredBytes <= this->MemoryBudgetBytes)
+      {
+        return;
+      }
+      this->FreeSystemMemory(freeListIt->second.back());
+      this->ReservedBytes -= freeListIt->second.back().Size;
+      freeListIt->second.pop_back();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::ReleaseCachedMemory()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::map<size_t, std::vector<Block> >::iterator freeListIt = this->FreeBlocks.begin(); freeListIt != this->FreeBlocks.end(); ++freeListIt)
+  {
+    for (std::vector<Block>::iterator blockIt = freeListIt->second.begin(); blockIt != freeListIt->second.end(); ++blockIt)
+    {
+      this->FreeSystemMemory(*blockIt);
+      this->ReservedBytes -= blockIt->Size;
+    }
+  }
+  this->FreeBlocks.clear();
+  this->UpdateMetrics();
+}
+
+//----------------------------------------------------------------------------
+bool PlusFramePool::AllocateSystemMemory(size_t size, Block& block)
+{
+  block.Size = size;
+  size_t hugePageSize = GetHugePageSize();
+  if (this->UseHugePages && hugePageSize > 0 && size >= hugePageSize)
+  {
+#if defined(_WIN32)
+    // Requires SeLockMemoryPrivilege ("Lock pages in memory"), falls back to regular heap memory if not available
+    void* pointer = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (pointer != NULL)
+    {
+      block.Pointer = pointer;
+      block.Method = ALLOCATION_LARGE_PAGES;
+      return true;
+    }
+    LOG_DEBUG("Failed to allocate frame memory using large pages (error code: " << GetLastError() << "), using regular memory");
+#elif defined(__linux__)
+    void* pointer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pointer == MAP_FAILED)
+    {
+      // No preallocated huge pages are available (vm.nr_hugepages), ask for transparent huge pages instead
+      pointer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#if defined(MADV_HUGEPAGE)
+      if (pointer != MAP_FAILED)
+      {
+        madvise(pointer, size, MADV_HUGEPAGE);
+      }
+#endif
+    }
+    if (pointer != MAP_FAILED)
+    {
+      block.Pointer = pointer;
+      block.Method = ALLOCATION_MMAP;
+      return true;
+    }
+#endif
+  }
+
+  block.Pointer = malloc(size);
+  block.Method = ALLOCATION_HEAP;
+  return (block.Pointer != NULL);
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::FreeSystemMemory(const Block& block)
+{
+  switch (block.Method)
+  {
+#if defined(_WIN32)
+    case ALLOCATION_LARGE_PAGES:
+      VirtualFree(block.Pointer, 0, MEM_RELEASE);
+      break;
+#elif defined(__linux__)
+    case ALLOCATION_MMAP:
+      munmap(block.Pointer, block.Size);
+      break;
+#endif
+    default:
+      free(block.Pointer);
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::FreeImageMemory(void* pointer)
+{
+  PlusFramePool::GetInstance()->ReleaseBlock(pointer);
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::ReleaseBlock(void* pointer)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::unordered_map<void*, UsedBlock>::iterator usedBlockIt = this->UsedBlocks.find(pointer);
+  if (usedBlockIt == this->UsedBlocks.end())
+  {
+    LOG_ERROR("PlusFramePool::ReleaseBlock failed: memory block was not allocated by the frame pool");
+    return;
+  }
+  const Block block = usedBlockIt->second.Memory;
+
+  std::map<const void*, OwnerUsage>::iterator ownerIt = this->Owners.find(usedBlockIt->second.Owner);
+  if (ownerIt != this->Owners.end())
+  {
+    ownerIt->second.AllocatedBytes -= block.Size;
+    ownerIt->second.NumberOfFrames--;
+    if (ownerIt->second.NumberOfFrames == 0)
+    {
+      // The owner may be deleted after all its frames are released, forget about it
+      this->Owners.erase(ownerIt);
+    }
+  }
+  this->UsedBlocks.erase(usedBlockIt);
+  this->UsedBytes -= block.Size;
+
+  this->FreeBlocks[block.Size].push_back(block);
+  if (this->MemoryBudgetBytes > 0 && this->ReservedBytes > this->MemoryBudgetBytes)
+  {
+    this->ReleaseCachedBlocks(0);
+  }
+  this->UpdateMetrics();
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusFramePool::GetAllocatedBytes(const void* owner) const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<const void*, OwnerUsage>::const_iterator ownerIt = this->Owners.find(owner);
+  return (ownerIt != this->Owners.end() ? ownerIt->second.AllocatedBytes : 0);
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusFramePool::GetUsedBytes() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->UsedBytes;
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusFramePool::GetReservedBytes() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->ReservedBytes;
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::UpdateMetrics()
+{
+  PLUS_METRIC_GAUGE_SET("plus_frame_pool_used_bytes", "", static_cast<double>(this->UsedBytes));
+  PLUS_METRIC_GAUGE_SET("plus_frame_pool_reserved_bytes", "", static_cast<double>(this->ReservedBytes));
+}
+
+//----------------------------------------------------------------------------
+void PlusFramePool::PrintUsage(std::ostream& os) const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  os << std::fixed << std::setprecision(1);
+  os << "Frame memory pool: " << ToMegabytes(this->UsedBytes) << "MB used, " << ToMegabytes(this->ReservedBytes - this->UsedBytes) << "MB cached, budget: ";
+  if (this->MemoryBudgetBytes > 0)
+  {
+    os << ToMegabytes(this->MemoryBudgetBytes) << "MB";
+  }
+  else
+  {
+    os << "unlimited";
+  }
+  os << (this->UseHugePages ? ", huge pages enabled" : "") << std::endl;
+
+  for (std::map<const void*, OwnerUsage>::const_iterator ownerIt = this->Owners.begin(); ownerIt != this->Owners.end(); ++ownerIt)
+  {
+    os << "  " << ownerIt->second.Name << ": " << ownerIt->second.NumberOfFrames << " frames, " << ToMegabytes(ownerIt->second.AllocatedBytes)
+       << "MB (peak: " << ToMegabytes(ownerIt->second.PeakAllocatedBytes) << "MB)" << std::endl;
+  }
+  for (std::map<size_t, std::vector<Block> >::const_iterator freeListIt = this->FreeBlocks.begin(); freeListIt != this->FreeBlocks.end(); ++freeListIt)
+  {
+    if (!freeListIt->second.empty())
+    {
+      os << "  Cached: " << freeListIt->second.size() << " x " << ToMegabytes(freeListIt->first) << "MB" << std::endl;
+    }
+  }
+}
@@ -0,0 +1,145 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusFramePool_h
+#define __PlusFramePool_h
+
+#include "igsioCommon.h"
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+
+// STL includes
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class vtkImageData;
+
+/*!
+  \class PlusFramePool
+  \brief Shared, size-classed pool for the pixel data of video buffer frames
+
+  Video buffers (vtkPlusBuffer) do not allocate memory for all their slots in advance, but request memory from
+  this pool when a frame is first written into a slot. Freed frame memory is kept in per-size-class free lists
+  and reused by any buffer that needs a frame of the same size class.
+
+  The total amount of memory held by the pool (frames in use and cached free frames) can be limited by a memory budget.
+  If the budget would be exceeded then cached free frames are returned to the system first, and if that is not
+  enough then the allocation fails (the buffer cannot store the frame).
+
+  Frames larger than the huge page size may optionally be allocated using huge pages (Linux: MAP_HUGETLB with fallback
+  to transparent huge pages, Windows: large pages, requires the "Lock pages in memory" privilege).
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusFramePool
+{
+public:
+  struct OwnerUsage
+  {
+    std::string Name;
+    uint64_t AllocatedBytes;
+    uint64_t PeakAllocatedBytes;
+    uint64_t NumberOfFrames;
+    OwnerUsage() : AllocatedBytes(0), PeakAllocatedBytes(0), NumberOfFrames(0) {}
+  };
+
+  static PlusFramePool* GetInstance();
+
+  /*! Maximum number of bytes held by the pool (frames in use and cached free frames). If 0 then there is no limit. */
+  void SetMemoryBudgetBytes(uint64_t budgetBytes);
+  uint64_t GetMemoryBudgetBytes() const;
+
+  /*! Use huge pages for frames that are larger than the huge page size. Affects frames that are allocated afterwards. */
+  void SetUseHugePages(bool useHugePages);
+  bool GetUseHugePages() const;
+
+  /*!
+    Allocate pixel data for the image from the pool. The image extent and scalars are set to match the requested format.
+    The memory is returned to the pool when the scalars array of the image is deleted.
+    \param owner Object that the allocated memory is accounted to (typically the buffer)
+    \param ownerName Name of the owner object, used in diagnostic messages
+  */
+  PlusStatus AllocateImage(vtkImageData* image, const FrameSizeType& frameSize, igsioCommon::VTKScalarPixelType pixelType,
+                           unsigned int numberOfScalarComponents, const void* owner, const std::string& ownerName);
+
+  /*! Get the number of bytes allocated for frames of the owner object */
+  uint64_t GetAllocatedBytes(const void* owner) const;
+
+  /*! Number of bytes allocated for frames that are in use */
+  uint64_t GetUsedBytes() const;
+
+  /*! Number of bytes held by the pool (frames in use and cached free frames) */
+  uint64_t GetReservedBytes() const;
+
+  /*! Return all cached free frames to the system */
+  void ReleaseCachedMemory();
+
+  /*! Print memory usage of each owner (buffer) and the pool totals */
+  void PrintUsage(std::ostream& os) const;
+
+protected:
+  PlusFramePool();
+
+  enum AllocationMethod
+  {
+    ALLOCATION_HEAP,
+    ALLOCATION_MMAP,
+    ALLOCATION_LARGE_PAGES
+  };
+
+  struct Block
+  {
+    void* Pointer;
+    size_t Size;
+    AllocationMethod Method;
+  };
+
+  struct UsedBlock
+  {
+    Block Memory;
+    const void* Owner;
+  };
+
+  /*! Get the size of the smallest size class that the requested number of bytes fits in */
+  size_t GetSizeClass(size_t numberOfBytes) const;
+
+  /*! Get a block from the free list or allocate a new one. Returns false if the memory budget does not allow the allocation. Must be called with the mutex locked. */
+  bool AcquireBlock(size_t sizeClass, Block& block);
+
+  /*! Return cached free blocks to the system until the requested number of bytes fits in the budget. Must be called with the mutex locked. */
+  void ReleaseCachedBlocks(uint64_t requiredBytes);
+
+  bool AllocateSystemMemory(size_t size, Block& block);
+  void FreeSystemMemory(const Block& block);
+
+  /*! Called by VTK when a scalars array that uses pool memory is deleted */
+  static void FreeImageMemory(void* pointer);
+  void ReleaseBlock(void* pointer);
+
+  void UpdateMetrics();
+
+  std::unordered_map<void*, UsedBlock> UsedBlocks;
+  std::map<size_t, std::vector<Block> > FreeBlocks;
+  std::map<const void*, OwnerUsage> Owners;
+
+  uint64_t MemoryBudgetBytes;
+  uint64_t UsedBytes;
+  uint64_t ReservedBytes;
+  bool UseHugePages;
+
+  mutable std::mutex Mutex;
+
+private:
+  PlusFramePool(const PlusFramePool&);
+  void operator=(const PlusFramePool&);
+};
+
+#endif //__PlusFramePool_h
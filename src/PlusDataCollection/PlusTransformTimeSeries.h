@@ -0,0 +1,74 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusTransformTimeSeries_h
+#define __PlusTransformTimeSeries_h
+
+#include "igsioCommon.h"
+#include "PlusConfigure.h"
+
+// STL includes
+#include <vector>
+
+/*!
+  \class PlusTransformTimeSeries
+  \brief Transforms of a tool in a time range, stored as contiguous columns
+
+  Returned by vtkPlusBuffer::GetTransformTimeSeries. Sample i is described by
+  Timestamps[i], Quaternions[4*i..4*i+3] (w, x, y, z, same convention as vtkMath::Matrix3x3ToQuaternion),
+  Translations[3*i..3*i+2] and Statuses[i].
+
+  Clear() keeps the allocated memory, so if the same object is reused for subsequent queries then no memory
+  is allocated once the arrays have grown to the required size.
+
+  \ingroup PlusLibDataCollection
+*/
+class PlusTransformTimeSeries
+{
+public:
+  /*! Remove all samples (allocated memory is kept) */
+  void Clear()
+  {
+    this->Timestamps.clear();
+    this->Quaternions.clear();
+    this->Translations.clear();
+    this->Statuses.clear();
+  }
+
+  /*! Preallocate memory for the specified number of samples */
+  void Reserve(size_t numberOfSamples)
+  {
+    this->Timestamps.reserve(numberOfSamples);
+    this->Quaternions.reserve(4 * numberOfSamples);
+    this->Translations.reserve(3 * numberOfSamples);
+    this->Statuses.reserve(numberOfSamples);
+  }
+
+  size_t GetNumberOfSamples() const { return this->Timestamps.size(); }
+
+  /*! Append a sample to the end of the series */
+  void AddSample(double timestamp, const double quaternion[4], const double translation[3], ToolStatus status)
+  {
+    this->Timestamps.push_back(timestamp);
+    this->Quaternions.insert(this->Quaternions.end(), quaternion, quaternion + 4);
+    this->Translations.insert(this->Translations.end(), translation, translation + 3);
+    this->Statuses.push_back(status);
+  }
+
+  const double* GetQuaternion(size_t sampleIndex) const { return &this->Quaternions[4 * sampleIndex]; }
+  const double* GetTranslation(size_t sampleIndex) const { return &this->Translations[3 * sampleIndex]; }
+
+  /*! Timestamps in global time (seconds) */
+  std::vector<double> Timestamps;
+  /*! Orientation quaternions (w, x, y, z), 4 values for each sample */
+  std::vector<double> Quaternions;
+  /*! Translations (x, y, z), 3 values for each sample */
+  std::vector<double> Translations;
+  /*! Tool status of each sample */
+  std::vector<ToolStatus> Statuses;
+};
+
+#endif // __PlusTransformTimeSeries_h
@@ -0,0 +1,394 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMetrics.h"
+#include "PlusSequenceFramePrefetcher.h"
+#include "vtkPlusSequenceStreamReader.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+
+// STL includes
+#include <algorithm>
+#include <chrono>
+
+//----------------------------------------------------------------------------
+PlusSequenceFramePrefetcher::PlusSequenceFramePrefetcher()
+  : Reader(NULL)
+  , WindowSize(0)
+  , StopRequested(false)
+  , CurrentFrameIndex(0)
+  , FirstFrameIndex(0)
+  , LastFrameIndex(0)
+  , Repeat(false)
+  , NumberOfWindowMisses(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusSequenceFramePrefetcher::~PlusSequenceFramePrefetcher()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSequenceFramePrefetcher::Open(const std::string& filename, unsigned int windowSize)
+{
+  this->Close();
+
+  if (windowSize < 1)
+  {
+    LOG_ERROR("PlusSequenceFramePrefetcher: invalid window size: " << windowSize);
+    return PLUS_FAIL;
+  }
+
+  this->MetricLabels = PlusMetricsRegistry::MakeLabel("file", vtksys::SystemTools::GetFilenameName(filename));
+  this->Reader = vtkPlusSequenceStreamReader::New();
+  this->Reader->UseMemoryMappingOn();
+  if (this->Reader->Open(filename) != PLUS_SUCCESS)
+  {
+    this->Close();
+    return PLUS_FAIL;
+  }
+  const unsigned int numberOfFrames = this->Reader->GetNumberOfFrames();
+  if (numberOfFrames < 1)
+  {
+    LOG_ERROR("PlusSequenceFramePrefetcher: there is no frame in the sequence file: " << filename);
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  // Only the frame fields are read here, images are read on demand
+  this->Timestamps.reserve(numberOfFrames);
+  for (unsigned int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+  {
+    igsioTrackedFrame trackedFrame;
+    if (this->Reader->ReadFrame(frameIndex, trackedFrame, false) != PLUS_SUCCESS)
+    {
+      this->Close();
+      return PLUS_FAIL;
+    }
+    double timestamp = 0;
+    if (igsioCommon::StringToNumber<double>(trackedFrame.GetFrameField("Timestamp"), timestamp) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("PlusSequenceFramePrefetcher: frame " << frameIndex << " has no valid timestamp in " << filename);
+      this->Close();
+      return PLUS_FAIL;
+    }
+    if (!this->Timestamps.empty() && timestamp < this->Timestamps.back())
+    {
+      LOG_WARNING("PlusSequenceFramePrefetcher: timestamps are not in increasing order at frame " << frameIndex << " in " << filename);
+      this->Close();
+      return PLUS_FAIL;
+    }
+    this->Timestamps.push_back(timestamp);
+  }
+
+  LOG_DEBUG("PlusSequenceFramePrefetcher: opened " << filename << " (" << numberOfFrames << " frames, window size: " << windowSize
+            << ", pixel data " << (this->Reader->IsPixelDataMapped() ? "memory mapped" : "read using file streams") << ")");
+
+  this->WindowSize = windowSize;
+  this->CurrentFrameIndex = 0;
+  this->FirstFrameIndex = 0;
+  this->LastFrameIndex = numberOfFrames - 1;
+  this->Repeat = false;
+  this->NumberOfWindowMisses = 0;
+  this->StopRequested = false;
+  this->Thread = std::thread(&PlusSequenceFramePrefetcher::PrefetchThread, this);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceFramePrefetcher::Close()
+{
+  if (this->Thread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->StopRequested = true;
+    }
+    this->WindowMoved.notify_all();
+    this->FrameRead.notify_all();
+    this->Thread.join();
+  }
+
+  this->Frames.clear();
+  std::vector<double>().swap(this->Timestamps);
+
+  if (this->Reader != NULL)
+  {
+    this->Reader->Delete();
+    this->Reader = NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusSequenceFramePrefetcher::IsOpen() const
+{
+  return this->Thread.joinable();
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceFramePrefetcher::GetNumberOfFrames() const
+{
+  return static_cast<unsigned int>(this->Timestamps.size());
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceFramePrefetcher::GetWindowSize() const
+{
+  return this->WindowSize;
+}
+
+//----------------------------------------------------------------------------
+double PlusSequenceFramePrefetcher::GetTimestamp(unsigned int frameIndex) const
+{
+  if (frameIndex >= this->Timestamps.size())
+  {
+    LOG_ERROR("PlusSequenceFramePrefetcher: frame index " << frameIndex << " is out of range");
+    return 0.0;
+  }
+  return this->Timestamps[frameIndex];
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceFramePrefetcher::GetClosestFrameIndex(double timestamp) const
+{
+  if (this->Timestamps.empty())
+  {
+    return 0;
+  }
+  std::vector<double>::const_iterator nextIt = std::lower_bound(this->Timestamps.begin(), this->Timestamps.end(), timestamp);
+  if (nextIt == this->Timestamps.begin())
+  {
+    return 0;
+  }
+  if (nextIt == this->Timestamps.end())
+  {
+    return static_cast<unsigned int>(this->Timestamps.size() - 1);
+  }
+  std::vector<double>::const_iterator previousIt = nextIt - 1;
+  if (timestamp - *previousIt <= *nextIt - timestamp)
+  {
+    return static_cast<unsigned int>(previousIt - this->Timestamps.begin());
+  }
+  return static_cast<unsigned int>(nextIt - this->Timestamps.begin());
+}
+
+//----------------------------------------------------------------------------
+const FrameSizeType& PlusSequenceFramePrefetcher::GetFrameSize() const
+{
+  return this->Reader->GetFrameSize();
+}
+
+//----------------------------------------------------------------------------
+igsioCommon::VTKScalarPixelType PlusSequenceFramePrefetcher::GetPixelType() const
+{
+  return this->Reader->GetPixelType();
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceFramePrefetcher::GetNumberOfScalarComponents() const
+{
+  return this->Reader->GetNumberOfScalarComponents();
+}
+
+//----------------------------------------------------------------------------
+US_IMAGE_TYPE PlusSequenceFramePrefetcher::GetImageType() const
+{
+  return this->Reader->GetImageType();
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceFramePrefetcher::SetPlaybackRange(unsigned int firstFrameIndex, unsigned int lastFrameIndex, bool repeat)
+{
+  if (this->Timestamps.empty())
+  {
+    LOG_ERROR("PlusSequenceFramePrefetcher::SetPlaybackRange failed: no sequence file is open");
+    return;
+  }
+  const unsigned int maxFrameIndex = static_cast<unsigned int>(this->Timestamps.size() - 1);
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->FirstFrameIndex = std::min(firstFrameIndex, maxFrameIndex);
+    this->LastFrameIndex = std::max(this->FirstFrameIndex, std::min(lastFrameIndex, maxFrameIndex));
+    this->Repeat = repeat;
+    this->CurrentFrameIndex = this->FirstFrameIndex;
+    this->ReleaseFramesOutsideWindow();
+  }
+  this->WindowMoved.notify_one();
+}
+
+//----------------------------------------------------------------------------
+std::shared_ptr<igsioTrackedFrame> PlusSequenceFramePrefetcher::GetFrame(unsigned int frameIndex, double timeoutSec)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  if (this->StopRequested || frameIndex >= this->Timestamps.size())
+  {
+    LOG_ERROR("PlusSequenceFramePrefetcher::GetFrame failed: frame " << frameIndex << " is not available");
+    return std::shared_ptr<igsioTrackedFrame>();
+  }
+
+  if (frameIndex != this->CurrentFrameIndex)
+  {
+    this->CurrentFrameIndex = frameIndex;
+    this->WindowMoved.notify_one();
+  }
+
+  std::map<unsigned int, std::shared_ptr<igsioTrackedFrame> >::iterator frameIt = this->Frames.find(frameIndex);
+  if (frameIt == this->Frames.end())
+  {
+    // The prefetch thread did not keep up with the playback, or the playback position jumped
+    this->NumberOfWindowMisses++;
+    PLUS_METRIC_COUNTER_ADD("plus_saved_data_prefetch_misses_total", this->MetricLabels, 1);
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+        + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeoutSec));
+    while (!this->StopRequested && (frameIt = this->Frames.find(frameIndex)) == this->Frames.end())
+    {
+      if (this->CurrentFrameIndex != frameIndex)
+      {
+        // SetPlaybackRange() moved the window meanwhile, move it back so that the requested frame is read
+        this->CurrentFrameIndex = frameIndex;
+        this->WindowMoved.notify_one();
+      }
+      if (this->FrameRead.wait_until(lock, deadline) == std::cv_status::timeout && this->Frames.find(frameIndex) == this->Frames.end())
+      {
+        LOG_ERROR("PlusSequenceFramePrefetcher: timeout while waiting for frame " << frameIndex);
+        return std::shared_ptr<igsioTrackedFrame>();
+      }
+    }
+    if (frameIt == this->Frames.end())
+    {
+      return std::shared_ptr<igsioTrackedFrame>();
+    }
+  }
+
+  // The caller shares the ownership, so the frame remains valid even if it is released from the window meanwhile
+  return frameIt->second;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceFramePrefetcher::GetNumberOfFramesInMemory() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return static_cast<unsigned int>(this->Frames.size());
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusSequenceFramePrefetcher::GetNumberOfWindowMisses() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->NumberOfWindowMisses;
+}
+
+//----------------------------------------------------------------------------
+bool PlusSequenceFramePrefetcher::GetNextFrameIndex(unsigned int frameIndex, unsigned int& nextFrameIndex) const
+{
+  if (frameIndex < this->LastFrameIndex)
+  {
+    nextFrameIndex = frameIndex + 1;
+    return true;
+  }
+  if (this->Repeat && this->FirstFrameIndex != this->LastFrameIndex)
+  {
+    nextFrameIndex = this->FirstFrameIndex;
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool PlusSequenceFramePrefetcher::IsFrameInWindow(unsigned int frameIndex) const
+{
+  if (frameIndex == this->CurrentFrameIndex)
+  {
+    return true;
+  }
+  if (frameIndex < this->FirstFrameIndex || frameIndex > this->LastFrameIndex)
+  {
+    return false;
+  }
+
+  // Distance from the current frame in playback order
+  unsigned int distance = 0;
+  if (frameIndex > this->CurrentFrameIndex)
+  {
+    distance = frameIndex - this->CurrentFrameIndex;
+  }
+  else if (this->Repeat && this->CurrentFrameIndex <= this->LastFrameIndex)
+  {
+    distance = (this->LastFrameIndex - this->CurrentFrameIndex + 1) + (frameIndex - this->FirstFrameIndex);
+  }
+  else
+  {
+    return false;
+  }
+  return distance < this->WindowSize;
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceFramePrefetcher::ReleaseFramesOutsideWindow()
+{
+  for (std::map<unsigned int, std::shared_ptr<igsioTrackedFrame> >::iterator frameIt = this->Frames.begin(); frameIt != this->Frames.end();)
+  {
+    if (this->IsFrameInWindow(frameIt->first))
+    {
+      ++frameIt;
+      continue;
+    }
+    this->Frames.erase(frameIt++);
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceFramePrefetcher::PrefetchThread()
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  while (!this->StopRequested)
+  {
+    this->ReleaseFramesOutsideWindow();
+
+    // Find the first frame in the window that is not in memory yet
+    bool frameToReadFound = false;
+    unsigned int frameToReadIndex = this->CurrentFrameIndex;
+    for (unsigned int windowPosition = 0; windowPosition < this->WindowSize; ++windowPosition)
+    {
+      if (this->Frames.find(frameToReadIndex) == this->Frames.end())
+      {
+        frameToReadFound = true;
+        break;
+      }
+      if (!this->GetNextFrameIndex(frameToReadIndex, frameToReadIndex))
+      {
+        break;
+      }
+    }
+    if (!frameToReadFound)
+    {
+      this->WindowMoved.wait(lock);
+      continue;
+    }
+
+    // Read the frame without holding the lock, so that frames in memory can be retrieved meanwhile
+    lock.unlock();
+    std::shared_ptr<igsioTrackedFrame> frame = std::make_shared<igsioTrackedFrame>();
+    if (this->Reader->ReadFrame(frameToReadIndex, *frame) != PLUS_SUCCESS)
+    {
+      // Store an empty pointer so that the frame is not read again while it is in the window
+      frame.reset();
+    }
+    lock.lock();
+
+    // The frame is dropped if the window has moved out while the frame was read
+    if (this->IsFrameInWindow(frameToReadIndex) && this->Frames.find(frameToReadIndex) == this->Frames.end())
+    {
+      this->Frames[frameToReadIndex] = frame;
+    }
+    this->FrameRead.notify_all();
+  }
+}
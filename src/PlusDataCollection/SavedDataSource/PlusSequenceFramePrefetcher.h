@@ -0,0 +1,138 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusSequenceFramePrefetcher_h
+#define __PlusSequenceFramePrefetcher_h
+
+#include "igsioCommon.h"
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+
+// STL includes
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkPlusSequenceStreamReader;
+
+/*!
+  \class PlusSequenceFramePrefetcher
+  \brief Keeps a bounded window of frames of a sequence file in memory, reading ahead on a background thread
+
+  When the sequence file is opened, only the frame fields are read (to get the timestamp of each frame).
+  Images are read by a background thread, which keeps the next WindowSize frames (in playback order, starting
+  at the most recently requested frame) in memory. Frames that fall out of the window are released.
+  If the playback range is repeated then the window wraps around from the last frame to the first frame of the range.
+
+  Frames are read by vtkPlusSequenceStreamReader with memory mapping enabled, therefore only those file formats
+  are supported that the stream reader can read (uncompressed MetaImage sequences).
+
+  Frames are shared with the caller of GetFrame(), so a returned frame remains valid even if the window moves
+  (e.g., the playback range is changed from another thread) while the frame is used.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusSequenceFramePrefetcher
+{
+public:
+  PlusSequenceFramePrefetcher();
+  /*! Stops the prefetch thread and releases all frames */
+  ~PlusSequenceFramePrefetcher();
+
+  /*!
+    Open the sequence file, read the timestamp of each frame, and start the prefetch thread.
+    Fails if the file cannot be read by the stream reader or any of the frames has no valid timestamp.
+    \param windowSize Maximum number of frames that are kept in memory
+  */
+  PlusStatus Open(const std::string& filename, unsigned int windowSize);
+
+  /*! Stop the prefetch thread, release all frames, and close the file */
+  void Close();
+
+  bool IsOpen() const;
+
+  unsigned int GetNumberOfFrames() const;
+  unsigned int GetWindowSize() const;
+
+  /*! Timestamp of the frame, as recorded in the file */
+  double GetTimestamp(unsigned int frameIndex) const;
+
+  /*! Index of the frame that has the timestamp closest to the specified time */
+  unsigned int GetClosestFrameIndex(double timestamp) const;
+
+  const FrameSizeType& GetFrameSize() const;
+  igsioCommon::VTKScalarPixelType GetPixelType() const;
+  unsigned int GetNumberOfScalarComponents() const;
+  US_IMAGE_TYPE GetImageType() const;
+
+  /*!
+    Set the range of frames that is played. The prefetch thread reads frames in this range only.
+    If repeat is enabled then the first frame of the range follows the last frame.
+  */
+  void SetPlaybackRange(unsigned int firstFrameIndex, unsigned int lastFrameIndex, bool repeat);
+
+  /*!
+    Get a frame and move the window to start at this frame. If the frame is not in memory yet then it waits until
+    the prefetch thread reads it. The prefetcher releases its reference when the frame falls out of the window,
+    the caller may keep the returned frame as long as it needs it.
+    Returns an empty pointer if the frame could not be read within the timeout.
+  */
+  std::shared_ptr<igsioTrackedFrame> GetFrame(unsigned int frameIndex, double timeoutSec);
+
+  /*! Number of frames that the prefetcher currently keeps in memory */
+  unsigned int GetNumberOfFramesInMemory() const;
+
+  /*! Number of requested frames that were not in memory yet when they were requested */
+  uint64_t GetNumberOfWindowMisses() const;
+
+protected:
+  void PrefetchThread();
+
+  /*! Get the frame that follows frameIndex in playback order. Returns false if there is no next frame. Requires Mutex to be locked. */
+  bool GetNextFrameIndex(unsigned int frameIndex, unsigned int& nextFrameIndex) const;
+
+  /*! Returns true if the frame is within the window that starts at CurrentFrameIndex. Requires Mutex to be locked. */
+  bool IsFrameInWindow(unsigned int frameIndex) const;
+
+  /*! Release frames that are not in the window. Requires Mutex to be locked. */
+  void ReleaseFramesOutsideWindow();
+
+  vtkPlusSequenceStreamReader* Reader;
+  std::vector<double> Timestamps;
+  unsigned int WindowSize;
+
+  mutable std::mutex Mutex;
+  /*! Notified when the window moves or the prefetch thread has to stop */
+  std::condition_variable WindowMoved;
+  /*! Notified when a frame is read */
+  std::condition_variable FrameRead;
+  std::thread Thread;
+  bool StopRequested;
+
+  /*! Frames in memory. Empty pointer means that the frame could not be read. */
+  std::map<unsigned int, std::shared_ptr<igsioTrackedFrame> > Frames;
+  unsigned int CurrentFrameIndex;
+  unsigned int FirstFrameIndex;
+  unsigned int LastFrameIndex;
+  bool Repeat;
+
+  uint64_t NumberOfWindowMisses;
+
+  /*! Labels of the reported metrics (sequence file name) */
+  std::string MetricLabels;
+
+private:
+  PlusSequenceFramePrefetcher(const PlusSequenceFramePrefetcher&);
+  void operator=(const PlusSequenceFramePrefetcher&);
+};
+
+#endif //__PlusSequenceFramePrefetcher_h
@@ -5,6 +5,8 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusClock.h"
+#include "PlusSequenceFramePrefetcher.h"
 #include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
 #include "vtkIGSIOSequenceIO.h"
@@ -18,6 +20,13 @@ See License.txt for details.
 
 vtkStandardNewMacro(vtkPlusSavedDataSource);
 
+namespace
+{
+  // Maximum time to wait for a frame that has not been read from the file yet
+  const double STREAMING_FRAME_TIMEOUT_SEC = 5.0;
+  const int DEFAULT_STREAMING_WINDOW_SIZE = 100;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   : FrameBufferRowAlignment(1)
@@ -26,6 +35,9 @@ vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   , LoopStartTime_Local(0.0)
   , LoopStopTime_Local(0.0)
   , LocalVideoBuffer(NULL)
+  , StreamingEnabled(false)
+  , StreamingWindowSize(DEFAULT_STREAMING_WINDOW_SIZE)
+  , FramePrefetcher(NULL)
   , UseAllFrameFields(false)
   , UseOriginalTimestamps(false)
   , LastAddedFrameUid(0)
@@ -70,7 +82,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdate()
   }
 
   PlusStatus status = PLUS_FAIL;
-  if (this->UseOriginalTimestamps)
+  if (this->UseOriginalTimestamps || PlusClock::IsVirtualClockEnabled())
   {
     status = InternalUpdateOriginalTimestamp(frameToBeAddedUid, frameToBeAddedLoopIndex);
   }
@@ -86,7 +98,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdate()
 PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex)
 {
   // Compute elapsed time since we started the acquisition
-  double elapsedTime = vtkIGSIOAccurateTimer::GetSystemTime() - this->GetOutputDataSource()->GetStartTime();
+  double elapsedTime = PlusClock::GetTime() - this->GetOutputDataSource()->GetStartTime();
   double loopTime = this->LoopStopTime_Local - this->LoopStartTime_Local;
 
   const int numberOfFramesInTheLoop = this->LoopLastFrameUid - this->LoopFirstFrameUid + 1;
@@ -108,8 +120,9 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       currentLoopIndex = floor(elapsedTime / loopTime);
       currentFrameTime_Local = this->LoopStartTime_Local + elapsedTime - loopTime * currentLoopIndex;
+      double oldestTimestamp_Local = 0;
       double latestTimestamp_Local = 0;
-      GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+      GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
       if (currentFrameTime_Local > latestTimestamp_Local)
       {
         // hold the last frame after the end of the buffer
@@ -120,9 +133,9 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
 
     // Get the uid of the frame that has been most recently acquired
     BufferItemUidType closestFrameUid = 0;
-    GetLocalBuffer()->GetItemUidFromTime(currentFrameTime_Local, closestFrameUid);
+    GetLocalFrameUidFromTime(currentFrameTime_Local, closestFrameUid);
     double closestFrameTime_Local = 0;
-    GetLocalBuffer()->GetTimeStamp(closestFrameUid, closestFrameTime_Local);
+    GetLocalFrameTimestamp(closestFrameUid, closestFrameTime_Local);
     if (closestFrameTime_Local > currentFrameTime_Local)
     {
       // the closest frame is newer than the current time, so don't use this item but the one before
@@ -157,16 +170,25 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     this->FrameNumber++;
 
     StreamBufferItem dataBufferItemToBeAdded;
-    if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+    double frameToBeAddedTimestamp_Local = 0;
+    if (this->IsStreamingPlayback())
     {
-      LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
-      status = PLUS_FAIL;
-      continue;
+      GetLocalFrameTimestamp(frameToBeAddedUid, frameToBeAddedTimestamp_Local);
+    }
+    else
+    {
+      if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+      {
+        LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
+        status = PLUS_FAIL;
+        continue;
+      }
+      frameToBeAddedTimestamp_Local = dataBufferItemToBeAdded.GetFilteredTimestamp(0.0);
     }
 
     // Compute the system time corresponding to this frame
     // Get the filtered timestamp from the buffer without any local time offset. Offset will be applied when it is copied to the output stream's buffer.
-    double filteredTimestamp = dataBufferItemToBeAdded.GetFilteredTimestamp(0.0) + frameToBeAddedLoopIndex * loopTime -
+    double filteredTimestamp = frameToBeAddedTimestamp_Local + frameToBeAddedLoopIndex * loopTime -
                                this->LoopStartTime_Local + this->GetOutputDataSource()->GetStartTime();
     double unfilteredTimestamp = filteredTimestamp; // we ignore unfiltered timestamps
 
@@ -174,6 +196,14 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       case VIDEO_STREAM:
         {
+          if (this->IsStreamingPlayback())
+          {
+            if (this->AddStreamedVideoFrame(frameToBeAddedUid, unfilteredTimestamp, filteredTimestamp) != PLUS_SUCCESS)
+            {
+              status = PLUS_FAIL;
+            }
+            break;
+          }
           igsioFieldMapType fieldMap;
           if (this->UseAllFrameFields)
           {
@@ -264,7 +294,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
 
   this->FrameNumber++;
   StreamBufferItem dataBufferItemToBeAdded;
-  if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+  if (!this->IsStreamingPlayback() && GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
   {
     LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
     return PLUS_FAIL;
@@ -275,6 +305,12 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
   {
     case VIDEO_STREAM:
       {
+        if (this->IsStreamingPlayback())
+        {
+          // UNDEFINED_TIMESTAMP => use current timestamp
+          status = this->AddStreamedVideoFrame(frameToBeAddedUid, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP);
+          break;
+        }
         igsioFieldMapType fieldMap;
         if (this->UseAllFrameFields)
         {
@@ -350,6 +386,42 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
   return status;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusSavedDataSource::GetNextFrameTime(double& nextFrameTime)
+{
+  vtkPlusDataSource* outputDataSource = this->GetOutputDataSource();
+  if (outputDataSource == NULL)
+  {
+    return false;
+  }
+
+  const int numberOfFramesInTheLoop = this->LoopLastFrameUid - this->LoopFirstFrameUid + 1;
+  BufferItemUidType nextFrameUid = this->LastAddedFrameUid + 1;
+  int nextFrameLoopIndex = this->LastAddedLoopIndex;
+  if (nextFrameUid > this->LoopLastFrameUid)
+  {
+    nextFrameLoopIndex++;
+    nextFrameUid -= numberOfFramesInTheLoop;
+  }
+
+  double loopTime = this->LoopStopTime_Local - this->LoopStartTime_Local;
+  if ((!this->RepeatEnabled || loopTime == 0) && nextFrameLoopIndex > 0)
+  {
+    // reached the end of the loop
+    return false;
+  }
+
+  double nextFrameTimestamp_Local = 0;
+  if (GetLocalFrameTimestamp(nextFrameUid, nextFrameTimestamp_Local) != PLUS_SUCCESS)
+  {
+    return false;
+  }
+
+  // Same as the filtered timestamp computation in InternalUpdateOriginalTimestamp
+  nextFrameTime = nextFrameTimestamp_Local + nextFrameLoopIndex * loopTime - this->LoopStartTime_Local + outputDataSource->GetStartTime();
+  return true;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusSavedDataSource::Probe()
 {
@@ -380,57 +452,88 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
     return PLUS_FAIL;
   }
 
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-
-  // Read sequence file into tracked frame list
-  vtkIGSIOSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
-
-  if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
+  PlusStatus status = PLUS_FAIL;
+  if (this->StreamingEnabled && this->SimulatedStream == VIDEO_STREAM)
   {
-    LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
-    return PLUS_FAIL;
+    status = InternalConnectStreaming(foundAbsoluteImagePath);
+    if (status != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Frames of " << this->SequenceFile << " cannot be streamed from the file, the whole sequence is loaded into memory instead");
+    }
   }
-
-  PlusStatus status = PLUS_FAIL;
-  switch (this->SimulatedStream)
+  else if (this->StreamingEnabled)
   {
-    case VIDEO_STREAM:
-      status = InternalConnectVideo(savedDataBuffer);
-      break;
-    case TRACKER_STREAM:
-      status = InternalConnectTracker(savedDataBuffer);
-      break;
-    default:
-      LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
+    LOG_WARNING("StreamingEnabled is ignored for SavedDataSource " << this->GetDeviceId() << ", streaming is only available for image data");
   }
 
   if (status != PLUS_SUCCESS)
   {
-    return PLUS_FAIL;
-  }
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
 
-  if (GetLocalBuffer() == NULL)
-  {
-    LOG_ERROR("Local buffer is invalid");
-    return PLUS_FAIL;
+    // Read sequence file into tracked frame list
+    vtkIGSIOSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
+
+    if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
+    {
+      LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
+      return PLUS_FAIL;
+    }
+
+    switch (this->SimulatedStream)
+    {
+      case VIDEO_STREAM:
+        status = InternalConnectVideo(savedDataBuffer);
+        break;
+      case TRACKER_STREAM:
+        status = InternalConnectTracker(savedDataBuffer);
+        break;
+      default:
+        LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
+    }
+
+    if (status != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
   }
 
   double oldestTimestamp_Local = 0;
-  GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
   double latestTimestamp_Local = 0;
-  GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+  double frameRate = 0;
+  if (this->IsStreamingPlayback())
+  {
+    this->LoopFirstFrameUid = 1;
+    this->LoopLastFrameUid = this->FramePrefetcher->GetNumberOfFrames();
+    GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
+    if (this->LoopLastFrameUid > this->LoopFirstFrameUid && latestTimestamp_Local > oldestTimestamp_Local)
+    {
+      frameRate = (this->LoopLastFrameUid - this->LoopFirstFrameUid) / (latestTimestamp_Local - oldestTimestamp_Local);
+    }
+  }
+  else
+  {
+    if (GetLocalBuffer() == NULL)
+    {
+      LOG_ERROR("Local buffer is invalid");
+      return PLUS_FAIL;
+    }
 
-  // Set the default loop start time and length to match the video buffer start time and length
+    GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
+    GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
 
-  this->LoopFirstFrameUid = GetLocalBuffer()->GetOldestItemUidInBuffer();
-  this->LoopLastFrameUid = GetLocalBuffer()->GetLatestItemUidInBuffer();
+    // Set the default loop start time and length to match the video buffer start time and length
+
+    this->LoopFirstFrameUid = GetLocalBuffer()->GetOldestItemUidInBuffer();
+    this->LoopLastFrameUid = GetLocalBuffer()->GetLatestItemUidInBuffer();
+
+    frameRate = GetLocalBuffer()->GetFrameRate();
+  }
 
   this->LoopStartTime_Local = oldestTimestamp_Local;
 
   // When we reach the last frame we have to wait one frame period before
   // playing the first frame, so we have to add one frame period to the loop length (loopTime)
   double framePeriodSec = 0;
-  double frameRate = GetLocalBuffer()->GetFrameRate();
   if (frameRate != 0.0)
   {
     framePeriodSec = 1.0 / frameRate;
@@ -454,6 +557,11 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
 
+  if (this->IsStreamingPlayback())
+  {
+    this->FramePrefetcher->SetPlaybackRange(this->LoopFirstFrameUid - 1, this->LoopLastFrameUid - 1, this->RepeatEnabled);
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -503,26 +611,75 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
   this->LocalVideoBuffer->CopyImagesFromTrackedFrameList(savedDataBuffer, vtkPlusBuffer::READ_FILTERED_IGNORE_UNFILTERED_TIMESTAMPS, this->UseAllFrameFields);
   savedDataBuffer->Clear();
 
+  return SetupVideoSources(this->LocalVideoBuffer->GetImageOrientation(), this->LocalVideoBuffer->GetFrameSize(),
+                           this->LocalVideoBuffer->GetNumberOfScalarComponents(), this->LocalVideoBuffer->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::InternalConnectStreaming(const std::string& sequenceFilePath)
+{
+  vtkPlusDataSource* outputDataSource = this->GetOutputDataSource();
+  if (outputDataSource == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  if (this->StreamingWindowSize < 1)
+  {
+    LOG_ERROR("Invalid StreamingWindowSize: " << this->StreamingWindowSize);
+    return PLUS_FAIL;
+  }
+
+  DeleteLocalBuffers();
+  this->FramePrefetcher = new PlusSequenceFramePrefetcher;
+  if (this->FramePrefetcher->Open(sequenceFilePath, this->StreamingWindowSize) != PLUS_SUCCESS)
+  {
+    DeleteLocalBuffers();
+    return PLUS_FAIL;
+  }
+
+  if (outputDataSource->SetImageType(this->FramePrefetcher->GetImageType()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set video buffer image type");
+    DeleteLocalBuffers();
+    return PLUS_FAIL;
+  }
+
+  // Images are converted to MF orientation when they are read from the file
+  if (SetupVideoSources(US_IMG_ORIENT_MF, this->FramePrefetcher->GetFrameSize(),
+                        this->FramePrefetcher->GetNumberOfScalarComponents(), this->FramePrefetcher->GetPixelType()) != PLUS_SUCCESS)
+  {
+    DeleteLocalBuffers();
+    return PLUS_FAIL;
+  }
+
+  LOG_INFO("Streaming " << this->FramePrefetcher->GetNumberOfFrames() << " frames from " << sequenceFilePath
+           << " (window size: " << this->StreamingWindowSize << " frames)");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::SetupVideoSources(US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType)
+{
   PlusStatus result(PLUS_SUCCESS);
   for (DataSourceContainerIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
   {
     vtkPlusDataSource* source(it->second);
 
-    if (source->SetInputImageOrientation(this->LocalVideoBuffer->GetImageOrientation()) != PLUS_SUCCESS)
+    if (source->SetInputImageOrientation(imageOrientation) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetNumberOfScalarComponents(this->LocalVideoBuffer->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+    if (source->SetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -531,14 +688,14 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
 
     source->Clear();
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetPixelType(this->LocalVideoBuffer->GetPixelType()) != PLUS_SUCCESS)
+    if (source->SetPixelType(pixelType) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -671,6 +828,13 @@ PlusStatus vtkPlusSavedDataSource::ReadConfiguration(vtkXMLDataElement* rootConf
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(RepeatEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseOriginalTimestamps, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(StreamingEnabled, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, StreamingWindowSize, deviceConfig);
+  if (this->StreamingWindowSize < 1)
+  {
+    LOG_WARNING("Invalid StreamingWindowSize: " << this->StreamingWindowSize << " - changed to " << DEFAULT_STREAMING_WINDOW_SIZE << " by default!");
+    this->StreamingWindowSize = DEFAULT_STREAMING_WINDOW_SIZE;
+  }
 
   const char* useData = deviceConfig->GetAttribute("UseData");
   if (useData != NULL)
@@ -708,6 +872,16 @@ PlusStatus vtkPlusSavedDataSource::WriteConfiguration(vtkXMLDataElement* rootCon
   XML_WRITE_CSTRING_ATTRIBUTE_IF_NOT_NULL(SequenceFile, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(RepeatEnabled, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(UseOriginalTimestamps, imageAcquisitionConfig);
+  if (this->StreamingEnabled)
+  {
+    XML_WRITE_BOOL_ATTRIBUTE(StreamingEnabled, imageAcquisitionConfig);
+    imageAcquisitionConfig->SetIntAttribute("StreamingWindowSize", this->StreamingWindowSize);
+  }
+  else
+  {
+    XML_REMOVE_ATTRIBUTE("StreamingEnabled", imageAcquisitionConfig);
+    XML_REMOVE_ATTRIBUTE("StreamingWindowSize", imageAcquisitionConfig);
+  }
 
   if (this->UseAllFrameFields)
   {
@@ -769,7 +943,7 @@ void vtkPlusSavedDataSource::GetLoopTimeRange(double& loopStartTime, double& loo
 //-----------------------------------------------------------------------------
 void vtkPlusSavedDataSource::SetLoopTimeRange(double loopStartTime, double loopStopTime)
 {
-  if (!this->GetLocalBuffer())
+  if (!this->IsStreamingPlayback() && !this->GetLocalBuffer())
   {
     LOG_ERROR("vtkPlusSavedDataSource::SetLoopTimeRange: Invalid local buffer");
     return;
@@ -783,12 +957,17 @@ void vtkPlusSavedDataSource::SetLoopTimeRange(double loopStartTime, double loopS
 
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
+
+  if (this->IsStreamingPlayback())
+  {
+    this->FramePrefetcher->SetPlaybackRange(this->LoopFirstFrameUid - 1, this->LoopLastFrameUid - 1, this->RepeatEnabled);
+  }
 }
 
 //----------------------------------------------------------------------------
 BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(double time_Local, double startTime_Local, double stopTime_Local)
 {
-  if (!this->GetLocalBuffer())
+  if (!this->IsStreamingPlayback() && !this->GetLocalBuffer())
   {
     LOG_ERROR("vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange: Invalid local buffer");
     return 0;
@@ -805,9 +984,8 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
   }
   // time_Local should be also within the local buffer time range
   double oldestTimestamp_Local = 0;
-  this->GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
   double latestTimestamp_Local = 0;
-  this->GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+  this->GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
 
   // if the asked time is outside of the loop range then return the closest element in the range
   if (time_Local < oldestTimestamp_Local)
@@ -821,9 +999,9 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
 
   // Get the uid of the frame that has been most recently acquired
   BufferItemUidType closestFrameUid = 0;
-  this->GetLocalBuffer()->GetItemUidFromTime(time_Local, closestFrameUid);
+  this->GetLocalFrameUidFromTime(time_Local, closestFrameUid);
   double closestFrameTime_Local = 0;
-  this->GetLocalBuffer()->GetTimeStamp(closestFrameUid, closestFrameTime_Local);
+  this->GetLocalFrameTimestamp(closestFrameUid, closestFrameTime_Local);
 
   // The closest frame is at the boundary, but it may be just outside the range:
   // use the next/previous frame if the closest frame is on the wrong side of the boundary
@@ -858,6 +1036,12 @@ vtkPlusBuffer* vtkPlusSavedDataSource::GetLocalTrackerBuffer()
 //----------------------------------------------------------------------------
 void vtkPlusSavedDataSource::DeleteLocalBuffers()
 {
+  if (this->FramePrefetcher != NULL)
+  {
+    delete this->FramePrefetcher;
+    this->FramePrefetcher = NULL;
+  }
+
   if (this->LocalVideoBuffer != NULL)
   {
     this->LocalVideoBuffer->Delete();
@@ -876,6 +1060,98 @@ void vtkPlusSavedDataSource::DeleteLocalBuffers()
   this->LocalTrackerBuffers.clear();
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusSavedDataSource::IsStreamingPlayback() const
+{
+  return this->FramePrefetcher != NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::GetLocalTimeRange(double& oldestTimestamp_Local, double& latestTimestamp_Local)
+{
+  if (this->IsStreamingPlayback())
+  {
+    oldestTimestamp_Local = this->FramePrefetcher->GetTimestamp(0);
+    latestTimestamp_Local = this->FramePrefetcher->GetTimestamp(this->FramePrefetcher->GetNumberOfFrames() - 1);
+    return PLUS_SUCCESS;
+  }
+  vtkPlusBuffer* localBuffer = GetLocalBuffer();
+  if (localBuffer == NULL
+      || localBuffer->GetOldestTimeStamp(oldestTimestamp_Local) != ITEM_OK
+      || localBuffer->GetLatestTimeStamp(latestTimestamp_Local) != ITEM_OK)
+  {
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::GetLocalFrameUidFromTime(double time_Local, BufferItemUidType& frameUid)
+{
+  if (this->IsStreamingPlayback())
+  {
+    frameUid = this->FramePrefetcher->GetClosestFrameIndex(time_Local) + 1;
+    return PLUS_SUCCESS;
+  }
+  vtkPlusBuffer* localBuffer = GetLocalBuffer();
+  if (localBuffer == NULL || localBuffer->GetItemUidFromTime(time_Local, frameUid) != ITEM_OK)
+  {
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::GetLocalFrameTimestamp(BufferItemUidType frameUid, double& timestamp_Local)
+{
+  if (this->IsStreamingPlayback())
+  {
+    if (frameUid < 1 || frameUid > this->FramePrefetcher->GetNumberOfFrames())
+    {
+      return PLUS_FAIL;
+    }
+    timestamp_Local = this->FramePrefetcher->GetTimestamp(frameUid - 1);
+    return PLUS_SUCCESS;
+  }
+  vtkPlusBuffer* localBuffer = GetLocalBuffer();
+  if (localBuffer == NULL || localBuffer->GetTimeStamp(frameUid, timestamp_Local) != ITEM_OK)
+  {
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::AddStreamedVideoFrame(BufferItemUidType frameUid, double unfilteredTimestamp, double filteredTimestamp)
+{
+  // The prefetcher may release the frame meanwhile (e.g., if the loop range is changed), so keep a reference while it is used
+  std::shared_ptr<igsioTrackedFrame> frame = this->FramePrefetcher->GetFrame(frameUid - 1, STREAMING_FRAME_TIMEOUT_SEC);
+  if (frame == NULL)
+  {
+    LOG_ERROR("vtkPlusSavedDataSource: Failed to read frame from the sequence file, UID=" << frameUid);
+    return PLUS_FAIL;
+  }
+
+  igsioFieldMapType fieldMap;
+  if (this->UseAllFrameFields)
+  {
+    // Copy all custom fields, except the ones that are set when the frame is added to the output
+    igsioFieldMapType customFields = frame->GetCustomFields();
+    for (igsioFieldMapType::iterator fieldIt = customFields.begin(); fieldIt != customFields.end(); ++fieldIt)
+    {
+      if (igsioCommon::IsEqualInsensitive(fieldIt->first, "TimeStamp")
+          || igsioCommon::IsEqualInsensitive(fieldIt->first, "UnfilteredTimestamp")
+          || igsioCommon::IsEqualInsensitive(fieldIt->first, "FrameNumber"))
+      {
+        continue;
+      }
+      fieldMap[fieldIt->first] = fieldIt->second;
+    }
+  }
+
+  return this->AddVideoItemToVideoSources(this->GetVideoSources(), *frame->GetImageData(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap);
+}
+
 //----------------------------------------------------------------------------
 vtkPlusBuffer* vtkPlusSavedDataSource::GetLocalBuffer()
 {
@@ -11,6 +11,7 @@ See License.txt for details.
 
 #include "vtkPlusDevice.h"
 
+class PlusSequenceFramePrefetcher;
 class vtkPlusBuffer;
 
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource;
@@ -26,7 +27,12 @@ Attributes:
 \li RepeatEnabled: if true then the sequence is played repeateadly (TRUE|FALSE)
 \li UseOriginalTimestamps: if true then the original timestamps (recorded originally in the source file)
   will be replayed exactly, otherwise only the timestamp difference will be replayed exactly,
-  starting from the current time (TRUE|FALSE)
+  starting from the current time (TRUE|FALSE). If the virtual clock is enabled (see vtkPlusDataCollector VirtualClockEnabled)
+  then frames are always replayed with their original timing.
+\li StreamingEnabled: if true then only a window of frames is kept in memory, the following frames are read from
+  the file in the background while playing (TRUE|FALSE). Used only for image data (UseData IMAGE or IMAGE_AND_TRANSFORM)
+  from uncompressed MetaImage sequence files, for other files the whole sequence is loaded into memory.
+\li StreamingWindowSize: maximum number of frames that are kept in memory in streaming mode
 
 */
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource : public vtkPlusDevice
@@ -73,7 +79,19 @@ public:
   /*! Read the timestamps from the file and use provide them in the output (instead of the current time) */
   vtkBooleanMacro( UseOriginalTimestamps, bool );
 
-  /*! Get local video buffer */
+  /*! Read frames from the file during playback, keep only a window of frames in memory */
+  vtkGetMacro( StreamingEnabled, bool );
+  /*! Read frames from the file during playback, keep only a window of frames in memory */
+  vtkSetMacro( StreamingEnabled, bool );
+  /*! Read frames from the file during playback, keep only a window of frames in memory */
+  vtkBooleanMacro( StreamingEnabled, bool );
+
+  /*! Maximum number of frames that are kept in memory in streaming mode */
+  vtkGetMacro( StreamingWindowSize, int );
+  /*! Maximum number of frames that are kept in memory in streaming mode */
+  vtkSetMacro( StreamingWindowSize, int );
+
+  /*! Get local video buffer. It is NULL if frames are streamed from the file. */
   vtkGetObjectMacro( LocalVideoBuffer, vtkPlusBuffer );
 
   virtual bool IsTracker() const;
@@ -86,6 +104,16 @@ public:
   /*! Probe to see if the tracking system is present on the specified serial port. */
   PlusStatus Probe();
 
+  /*!
+    Get the time when the next frame of the sequence is due, i.e., the earliest time when InternalUpdate adds a new frame
+    to the output. Frames are timed as if the original timestamps were used. Returns false if there are no more frames
+    (the end of the sequence is reached and RepeatEnabled is false). Used for stepping the virtual clock.
+  */
+  bool GetNextFrameTime(double& nextFrameTime);
+
+  /*! Returns true if frames are read from the file during playback (instead of from the local buffer) */
+  bool IsStreamingPlayback() const;
+
 protected:
   /*! Constructor */
   vtkPlusSavedDataSource();
@@ -101,6 +129,12 @@ protected:
   /*! Connect to device, in case the output is a tracker stream */
   virtual PlusStatus InternalConnectTracker( vtkIGSIOTrackedFrameList* savedDataBuffer );
 
+  /*! Connect to device, in case the output is a video stream that is read from the file during playback */
+  virtual PlusStatus InternalConnectStreaming( const std::string& sequenceFilePath );
+
+  /*! Set up the output video sources to match the format of the replayed images */
+  PlusStatus SetupVideoSources( US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType );
+
   /*! Disconnect from device */
   virtual PlusStatus InternalDisconnect();
 
@@ -129,6 +163,18 @@ protected:
 
   void DeleteLocalBuffers();
 
+  /*! Get the timestamp of the first and last frame of the replayed data */
+  PlusStatus GetLocalTimeRange( double& oldestTimestamp_Local, double& latestTimestamp_Local );
+
+  /*! Get the UID of the frame that has the closest timestamp to the specified time */
+  PlusStatus GetLocalFrameUidFromTime( double time_Local, BufferItemUidType& frameUid );
+
+  /*! Get the timestamp of a frame of the replayed data */
+  PlusStatus GetLocalFrameTimestamp( BufferItemUidType frameUid, double& timestamp_Local );
+
+  /*! Add a frame that is read from the file (in streaming mode) to the output video sources */
+  PlusStatus AddStreamedVideoFrame( BufferItemUidType frameUid, double unfilteredTimestamp, double filteredTimestamp );
+
 protected:
   /*! Byte alignment of each row in the framebuffer */
   int FrameBufferRowAlignment;
@@ -155,6 +201,18 @@ protected:
   /*! Local buffer for each tracker tool, used for storing data read from sequence metafile */
   std::map<std::string, vtkPlusBuffer*> LocalTrackerBuffers;
 
+  /*! Read frames from the file during playback, keep only a window of frames in memory */
+  bool StreamingEnabled;
+
+  /*! Maximum number of frames that are kept in memory in streaming mode */
+  int StreamingWindowSize;
+
+  /*!
+    Reads frames from the file in streaming mode, used instead of LocalVideoBuffer.
+    Frame UIDs are the frame indices in the file plus one.
+  */
+  PlusSequenceFramePrefetcher* FramePrefetcher;
+
   /*! Read all the frame fields from the file and provide them in the output */
   bool UseAllFrameFields;
 
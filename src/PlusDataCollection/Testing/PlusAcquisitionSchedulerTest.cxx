@@ -0,0 +1,214 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusAcquisitionSchedulerTest.cxx
+  \brief Test period accuracy and overrun handling of the acquisition scheduler
+
+  A periodic task records its start times. The test checks that every start time is on the schedule grid
+  (first start time + a whole number of periods), so there is no drift. In the overrun test one update takes
+  several periods: the missed periods have to be reported and the following updates have to stay on the grid.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusAcquisitionScheduler.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  //----------------------------------------------------------------------------
+  class TaskRecorder
+  {
+  public:
+    TaskRecorder(int overrunUpdateIndex, double overrunDurationSec)
+      : OverrunUpdateIndex(overrunUpdateIndex)
+      , OverrunDurationSec(overrunDurationSec)
+    {
+    }
+
+    void Update()
+    {
+      Clock::time_point startTime = Clock::now();
+      size_t updateIndex = 0;
+      {
+        std::lock_guard<std::mutex> lock(this->Mutex);
+        updateIndex = this->StartTimes.size();
+        this->StartTimes.push_back(startTime);
+      }
+      if (static_cast<int>(updateIndex) == this->OverrunUpdateIndex)
+      {
+        std::this_thread::sleep_for(std::chrono::duration<double>(this->OverrunDurationSec));
+      }
+    }
+
+    std::vector<Clock::time_point> GetStartTimes()
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      return this->StartTimes;
+    }
+
+  protected:
+    int OverrunUpdateIndex;
+    double OverrunDurationSec;
+    std::mutex Mutex;
+    std::vector<Clock::time_point> StartTimes;
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Run a task for the given time and check that all the start times are on the schedule grid */
+  int RunTask(const std::string& name, double periodSec, double runTimeSec, double maxPhaseErrorSec, int overrunUpdateIndex, double overrunDurationSec,
+              std::vector<Clock::time_point>& startTimes, PlusAcquisitionScheduler::TaskStatistics& statistics)
+  {
+    int numberOfErrors(0);
+    TaskRecorder recorder(overrunUpdateIndex, overrunDurationSec);
+    PlusAcquisitionScheduler* scheduler = PlusAcquisitionScheduler::GetInstance();
+    if (scheduler->AddTask(name, periodSec, 0, -1, std::bind(&TaskRecorder::Update, &recorder)) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add task " << name);
+      return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(runTimeSec));
+    if (scheduler->GetTaskStatistics(name, statistics) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get statistics of task " << name);
+      numberOfErrors++;
+    }
+    if (scheduler->RemoveTask(name) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to remove task " << name);
+      numberOfErrors++;
+    }
+
+    startTimes = recorder.GetStartTimes();
+    if (startTimes.size() < 2)
+    {
+      LOG_ERROR("Task " << name << " was executed " << startTimes.size() << " times only");
+      return numberOfErrors + 1;
+    }
+
+    int numberOfOffGridUpdates(0);
+    double maxPhaseErrorFoundSec(0.0);
+    for (size_t i = 1; i < startTimes.size(); ++i)
+    {
+      double elapsedSec = std::chrono::duration<double>(startTimes[i] - startTimes[0]).count();
+      double phaseErrorSec = fabs(elapsedSec - floor(elapsedSec / periodSec + 0.5) * periodSec);
+      maxPhaseErrorFoundSec = std::max(maxPhaseErrorFoundSec, phaseErrorSec);
+      if (phaseErrorSec > maxPhaseErrorSec)
+      {
+        numberOfOffGridUpdates++;
+      }
+    }
+    LOG_INFO("Task " << name << ": " << startTimes.size() << " updates, " << statistics.NumberOfMissedDeadlines << " missed deadlines, max phase error: "
+             << maxPhaseErrorFoundSec * 1000.0 << "ms, mean jitter: " << statistics.MeanJitterSec * 1000.0 << "ms");
+    if (numberOfOffGridUpdates > 0)
+    {
+      LOG_ERROR("Task " << name << ": " << numberOfOffGridUpdates << " updates are not on the schedule grid (max phase error: " << maxPhaseErrorFoundSec * 1000.0
+                << "ms, allowed: " << maxPhaseErrorSec * 1000.0 << "ms)");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  double periodSec(0.01);
+  double runTimeSec(1.0);
+  double maxPhaseErrorSec(0.003);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--period", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &periodSec, "Period of the test task in seconds (Default: 0.01).");
+  args.AddArgument("--running-time", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &runTimeSec, "Running time of each test in seconds (Default: 1.0).");
+  args.AddArgument("--max-phase-error", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxPhaseErrorSec, "Maximum allowed difference between a start time and the schedule grid in seconds (Default: 0.003).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  PlusAcquisitionScheduler::GetInstance()->SetNumberOfThreads(2);
+
+  // Period accuracy: all updates are on the grid and (almost) no period is skipped
+  {
+    std::vector<Clock::time_point> startTimes;
+    PlusAcquisitionScheduler::TaskStatistics statistics;
+    numberOfErrors += RunTask("PeriodTest", periodSec, runTimeSec, maxPhaseErrorSec, -1, 0.0, startTimes, statistics);
+    int expectedNumberOfUpdates = static_cast<int>(runTimeSec / periodSec);
+    if (static_cast<int>(startTimes.size()) < expectedNumberOfUpdates * 9 / 10)
+    {
+      LOG_ERROR("PeriodTest: " << startTimes.size() << " updates, expected at least " << expectedNumberOfUpdates * 9 / 10);
+      numberOfErrors++;
+    }
+    if (!startTimes.empty())
+    {
+      double averagePeriodSec = std::chrono::duration<double>(startTimes.back() - startTimes.front()).count() / (startTimes.size() - 1);
+      if (fabs(averagePeriodSec - periodSec) > periodSec * 0.1)
+      {
+        LOG_ERROR("PeriodTest: average period is " << averagePeriodSec * 1000.0 << "ms, expected " << periodSec * 1000.0 << "ms");
+        numberOfErrors++;
+      }
+    }
+  }
+
+  // Overrun: the 5th update takes 3.5 periods, the next update has to be on the first grid point after the overrun
+  {
+    const int overrunUpdateIndex = 5;
+    const double overrunDurationSec = periodSec * 3.5;
+    std::vector<Clock::time_point> startTimes;
+    PlusAcquisitionScheduler::TaskStatistics statistics;
+    numberOfErrors += RunTask("OverrunTest", periodSec, runTimeSec, maxPhaseErrorSec, overrunUpdateIndex, overrunDurationSec, startTimes, statistics);
+    if (statistics.NumberOfMissedDeadlines < 3)
+    {
+      LOG_ERROR("OverrunTest: " << statistics.NumberOfMissedDeadlines << " missed deadlines are reported, expected at least 3");
+      numberOfErrors++;
+    }
+    if (static_cast<int>(startTimes.size()) > overrunUpdateIndex + 1)
+    {
+      double gapSec = std::chrono::duration<double>(startTimes[overrunUpdateIndex + 1] - startTimes[overrunUpdateIndex]).count();
+      if (fabs(gapSec - 4 * periodSec) > maxPhaseErrorSec)
+      {
+        LOG_ERROR("OverrunTest: the update after the overrun started " << gapSec * 1000.0 << "ms after the overrun, expected " << 4 * periodSec * 1000.0 << "ms");
+        numberOfErrors++;
+      }
+    }
+    else
+    {
+      LOG_ERROR("OverrunTest: the task was not executed after the overrun");
+      numberOfErrors++;
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,249 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusFramePoolTest.cxx
+  \brief Test size-class rounding, memory reuse and memory budget enforcement of the frame pool
+
+  Frames are allocated directly from the pool into vtkImageData objects and the pool totals are checked after each
+  step: the reserved size has to match the expected size class, released frames have to be reused by the next
+  allocation of the same size class and the budget has to be enforced by first returning cached frames to the system.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusFramePool.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkImageData> AllocateFrame(unsigned int width, unsigned int height, const void* owner)
+  {
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    FrameSizeType frameSize = { width, height, 1 };
+    if (PlusFramePool::GetInstance()->AllocateImage(image, frameSize, VTK_UNSIGNED_CHAR, 1, owner, "PlusFramePoolTest") != PLUS_SUCCESS)
+    {
+      return NULL;
+    }
+    return image;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckPoolSize(const std::string& step, uint64_t expectedUsedBytes, uint64_t expectedReservedBytes)
+  {
+    PlusFramePool* pool = PlusFramePool::GetInstance();
+    if (pool->GetUsedBytes() != expectedUsedBytes || pool->GetReservedBytes() != expectedReservedBytes)
+    {
+      LOG_ERROR(step << ": pool holds " << pool->GetUsedBytes() << " used and " << pool->GetReservedBytes() << " reserved bytes, expected "
+                << expectedUsedBytes << " used and " << expectedReservedBytes << " reserved bytes");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Small frames are rounded up to whole pages, large frames to 1/8 of their power-of-two range */
+  int TestSizeClasses()
+  {
+    LOG_INFO("Testing size classes");
+    int numberOfErrors(0);
+    struct SizeClassTestCase
+    {
+      unsigned int Width;
+      unsigned int Height;
+      uint64_t ExpectedSizeClass;
+    };
+    const SizeClassTestCase testCases[] =
+    {
+      { 1, 1, 4096 },
+      { 100, 100, 12288 },
+      { 256, 256, 65536 },
+      { 300, 300, 90112 },
+      { 640, 480, 327680 }
+    };
+    int owner(0);
+    for (const SizeClassTestCase& testCase : testCases)
+    {
+      vtkSmartPointer<vtkImageData> image = AllocateFrame(testCase.Width, testCase.Height, &owner);
+      if (image == NULL)
+      {
+        LOG_ERROR("Failed to allocate " << testCase.Width << "x" << testCase.Height << " frame");
+        numberOfErrors++;
+        continue;
+      }
+      int* extent = image->GetExtent();
+      if (extent[1] != static_cast<int>(testCase.Width) - 1 || extent[3] != static_cast<int>(testCase.Height) - 1)
+      {
+        LOG_ERROR("Frame extent does not match the requested " << testCase.Width << "x" << testCase.Height << " frame size");
+        numberOfErrors++;
+      }
+      uint64_t allocatedBytes = PlusFramePool::GetInstance()->GetAllocatedBytes(&owner);
+      if (allocatedBytes != testCase.ExpectedSizeClass)
+      {
+        LOG_ERROR(testCase.Width << "x" << testCase.Height << " frame is allocated in a " << allocatedBytes << " bytes block, expected " << testCase.ExpectedSizeClass);
+        numberOfErrors++;
+      }
+    }
+    if (PlusFramePool::GetInstance()->GetAllocatedBytes(&owner) != 0)
+    {
+      LOG_ERROR("Memory is still accounted to the owner after all its frames are deleted");
+      numberOfErrors++;
+    }
+    PlusFramePool::GetInstance()->ReleaseCachedMemory();
+    numberOfErrors += CheckPoolSize("Size classes", 0, 0);
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Released frames are cached and reused by frames of the same size class */
+  int TestReuse()
+  {
+    LOG_INFO("Testing reuse of released frames");
+    int numberOfErrors(0);
+    int owner(0);
+    vtkSmartPointer<vtkImageData> image = AllocateFrame(300, 300, &owner);
+    if (image == NULL)
+    {
+      LOG_ERROR("Failed to allocate frame");
+      return 1;
+    }
+    void* pixelPointer = image->GetScalarPointer();
+    image = NULL;
+    numberOfErrors += CheckPoolSize("Release", 0, 90112);
+
+    // Different frame size, but the same size class
+    image = AllocateFrame(299, 300, &owner);
+    if (image == NULL)
+    {
+      LOG_ERROR("Failed to allocate frame");
+      return numberOfErrors + 1;
+    }
+    if (image->GetScalarPointer() != pixelPointer)
+    {
+      LOG_ERROR("Released frame memory is not reused");
+      numberOfErrors++;
+    }
+    numberOfErrors += CheckPoolSize("Reuse", 90112, 90112);
+
+    // Allocating into an image that already has pool memory returns the previous memory to the pool
+    FrameSizeType frameSize = { 100, 100, 1 };
+    if (PlusFramePool::GetInstance()->AllocateImage(image, frameSize, VTK_UNSIGNED_CHAR, 1, &owner, "PlusFramePoolTest") != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to reallocate frame");
+      numberOfErrors++;
+    }
+    numberOfErrors += CheckPoolSize("Reallocate", 12288, 90112 + 12288);
+
+    image = NULL;
+    PlusFramePool::GetInstance()->ReleaseCachedMemory();
+    numberOfErrors += CheckPoolSize("Release cached memory", 0, 0);
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Allocation fails if the budget is exceeded, cached frames are returned to the system before that */
+  int TestMemoryBudget()
+  {
+    LOG_INFO("Testing memory budget");
+    int numberOfErrors(0);
+    int owner(0);
+    PlusFramePool* pool = PlusFramePool::GetInstance();
+    pool->SetMemoryBudgetBytes(3 * 90112);
+
+    std::vector<vtkSmartPointer<vtkImageData> > images;
+    for (int i = 0; i < 3; ++i)
+    {
+      vtkSmartPointer<vtkImageData> image = AllocateFrame(300, 300, &owner);
+      if (image == NULL)
+      {
+        LOG_ERROR("Failed to allocate frame " << i << " within the memory budget");
+        numberOfErrors++;
+        continue;
+      }
+      images.push_back(image);
+    }
+    numberOfErrors += CheckPoolSize("Fill budget", 3 * 90112, 3 * 90112);
+
+    if (AllocateFrame(300, 300, &owner) != NULL || AllocateFrame(1, 1, &owner) != NULL)
+    {
+      LOG_ERROR("Frame is allocated beyond the memory budget");
+      numberOfErrors++;
+    }
+    numberOfErrors += CheckPoolSize("Exceed budget", 3 * 90112, 3 * 90112);
+
+    // The released frame is cached, but it has to be returned to the system to make room for a frame of another size class
+    images.pop_back();
+    numberOfErrors += CheckPoolSize("Release within budget", 2 * 90112, 3 * 90112);
+    vtkSmartPointer<vtkImageData> smallImage = AllocateFrame(100, 100, &owner);
+    if (smallImage == NULL)
+    {
+      LOG_ERROR("Failed to allocate frame after releasing a frame");
+      numberOfErrors++;
+    }
+    numberOfErrors += CheckPoolSize("Release cached frame for budget", 2 * 90112 + 12288, 2 * 90112 + 12288);
+
+    // Reducing the budget releases cached frames immediately
+    images.clear();
+    smallImage = NULL;
+    numberOfErrors += CheckPoolSize("Release all", 0, 2 * 90112 + 12288);
+    pool->SetMemoryBudgetBytes(90112);
+    if (pool->GetReservedBytes() > 90112)
+    {
+      LOG_ERROR("Pool holds " << pool->GetReservedBytes() << " bytes after reducing the budget to 90112 bytes");
+      numberOfErrors++;
+    }
+
+    pool->SetMemoryBudgetBytes(0);
+    pool->ReleaseCachedMemory();
+    numberOfErrors += CheckPoolSize("Remove budget", 0, 0);
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  // Huge page rounding depends on the platform, test the default size classes only
+  PlusFramePool::GetInstance()->SetUseHugePages(false);
+
+  int numberOfErrors(0);
+  numberOfErrors += TestSizeClasses();
+  numberOfErrors += TestReuse();
+  numberOfErrors += TestMemoryBudget();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
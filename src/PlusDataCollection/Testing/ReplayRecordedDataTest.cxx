@@ -7,6 +7,10 @@ See License.txt for details.
 /*!
   \file ReplayRecordedDataTest.cxx
   \brief This program tests if a recorded tracked ultrasound buffer can be read.
+
+  If --virtual-clock is specified then the recorded data is replayed twice using the virtual clock, with a virtual capture
+  device added downstream of the last output channel. The test checks that the replay completes faster than real time
+  and both replays produce the same frames, both in the first channel and in the captured sequence files.
 */ 
 
 #include "PlusConfigure.h"
@@ -15,8 +19,185 @@ See License.txt for details.
 #include "vtksys/CommandLineArguments.hxx"
 #include "vtkXMLUtilities.h"
 
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusChannel.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusSavedDataSource.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusVirtualCapture.h"
+
+#include <cstring>
+
+static const double VIRTUAL_CLOCK_REPLAY_TIMEOUT_SEC = 60.0;
+static const char* VIRTUAL_CLOCK_CAPTURE_DEVICE_ID = "ReplayCaptureDevice";
+
+//----------------------------------------------------------------------------
+// Add a virtual capture device that records the last output channel of the device set
+PlusStatus AddCaptureDevice(vtkXMLDataElement* configRootElement, const std::string& baseFilename)
+{
+  vtkXMLDataElement* dataCollectionElement = configRootElement->FindNestedElementWithName("DataCollection");
+  if (dataCollectionElement == NULL)
+  {
+    LOG_ERROR("DataCollection element is not found in the configuration");
+    return PLUS_FAIL;
+  }
+
+  std::string inputChannelId;
+  for (int deviceIndex = 0; deviceIndex < dataCollectionElement->GetNumberOfNestedElements(); ++deviceIndex)
+  {
+    vtkXMLDataElement* outputChannelsElement = dataCollectionElement->GetNestedElement(deviceIndex)->FindNestedElementWithName("OutputChannels");
+    for (int channelIndex = 0; outputChannelsElement != NULL && channelIndex < outputChannelsElement->GetNumberOfNestedElements(); ++channelIndex)
+    {
+      const char* channelId = outputChannelsElement->GetNestedElement(channelIndex)->GetAttribute("Id");
+      if (channelId != NULL)
+      {
+        inputChannelId = channelId;
+      }
+    }
+  }
+  if (inputChannelId.empty())
+  {
+    LOG_ERROR("No output channel is found in the configuration");
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> captureDeviceElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  captureDeviceElement->SetName("Device");
+  captureDeviceElement->SetAttribute("Id", VIRTUAL_CLOCK_CAPTURE_DEVICE_ID);
+  captureDeviceElement->SetAttribute("Type", "VirtualCapture");
+  captureDeviceElement->SetAttribute("BaseFilename", baseFilename.c_str());
+  captureDeviceElement->SetAttribute("EnableCapturingOnStart", "TRUE");
+  captureDeviceElement->SetAttribute("EnableFileCompression", "FALSE");
+  vtkSmartPointer<vtkXMLDataElement> inputChannelsElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  inputChannelsElement->SetName("InputChannels");
+  vtkSmartPointer<vtkXMLDataElement> inputChannelElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  inputChannelElement->SetName("InputChannel");
+  inputChannelElement->SetAttribute("Id", inputChannelId.c_str());
+  inputChannelsElement->AddNestedElement(inputChannelElement);
+  captureDeviceElement->AddNestedElement(inputChannelsElement);
+  dataCollectionElement->AddNestedElement(captureDeviceElement);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Compare the sequences captured by two replays: timestamps, frame fields and pixel data have to be identical
+int CompareCapturedFrames(vtkIGSIOTrackedFrameList* capturedFrames1, vtkIGSIOTrackedFrameList* capturedFrames2)
+{
+  if (capturedFrames1->GetNumberOfTrackedFrames() == 0)
+  {
+    LOG_ERROR("No frames were captured during the virtual clock replay");
+    return 1;
+  }
+  if (capturedFrames1->GetNumberOfTrackedFrames() != capturedFrames2->GetNumberOfTrackedFrames())
+  {
+    LOG_ERROR("Virtual clock replays captured different number of frames: " << capturedFrames1->GetNumberOfTrackedFrames()
+              << " and " << capturedFrames2->GetNumberOfTrackedFrames());
+    return 1;
+  }
+  for (unsigned int frameIndex = 0; frameIndex < capturedFrames1->GetNumberOfTrackedFrames(); frameIndex++)
+  {
+    igsioTrackedFrame* frame1 = capturedFrames1->GetTrackedFrame(frameIndex);
+    igsioTrackedFrame* frame2 = capturedFrames2->GetTrackedFrame(frameIndex);
+    if (frame1->GetTimestamp() != frame2->GetTimestamp() || frame1->GetCustomFields() != frame2->GetCustomFields())
+    {
+      LOG_ERROR("Captured frame " << frameIndex << " has different timestamp or frame fields in the two virtual clock replays");
+      return 1;
+    }
+    igsioVideoFrame* image1 = frame1->GetImageData();
+    igsioVideoFrame* image2 = frame2->GetImageData();
+    if (image1->IsImageValid() != image2->IsImageValid())
+    {
+      LOG_ERROR("Captured frame " << frameIndex << " has image data in only one of the virtual clock replays");
+      return 1;
+    }
+    if (image1->IsImageValid()
+        && (image1->GetFrameSizeInBytes() != image2->GetFrameSizeInBytes()
+            || memcmp(image1->GetScalarPointer(), image2->GetScalarPointer(), image1->GetFrameSizeInBytes()) != 0))
+    {
+      LOG_ERROR("Captured frame " << frameIndex << " has different pixel data in the two virtual clock replays");
+      return 1;
+    }
+  }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// Replay the recorded data (without repeat) using the virtual clock and get the timestamps of the frames in the first channel,
+// the frames that the capture device recorded, and the speedup of the replay
+PlusStatus ReplayWithVirtualClock(vtkXMLDataElement* configRootElement, std::vector<double>& frameTimestamps, vtkIGSIOTrackedFrameList* capturedFrames, double& speedup)
+{
+  vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+  if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read data collector configuration");
+    return PLUS_FAIL;
+  }
+  dataCollector->SetVirtualClockEnabled(true);
+  for (DeviceCollectionConstIterator it = dataCollector->GetDeviceConstIteratorBegin(); it != dataCollector->GetDeviceConstIteratorEnd(); ++it)
+  {
+    vtkPlusSavedDataSource* savedDataSource = dynamic_cast<vtkPlusSavedDataSource*>(*it);
+    if (savedDataSource != NULL)
+    {
+      savedDataSource->SetRepeatEnabled(false);
+    }
+  }
+
+  if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start data collection with virtual clock");
+    return PLUS_FAIL;
+  }
+
+  const double timeoutTime = vtkIGSIOAccurateTimer::GetSystemTime() + VIRTUAL_CLOCK_REPLAY_TIMEOUT_SEC;
+  while (!dataCollector->IsVirtualClockReplayCompleted() && vtkIGSIOAccurateTimer::GetSystemTime() < timeoutTime)
+  {
+    vtkIGSIOAccurateTimer::Delay(0.01);
+  }
+  if (!dataCollector->IsVirtualClockReplayCompleted())
+  {
+    LOG_ERROR("Virtual clock replay was not completed in " << VIRTUAL_CLOCK_REPLAY_TIMEOUT_SEC << " sec");
+    dataCollector->Stop();
+    dataCollector->Disconnect();
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  vtkPlusChannel* channel = NULL;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  double timestampFrom = 0;
+  if (dataCollector->GetFirstChannel(channel) != PLUS_SUCCESS
+      || channel->GetOldestTimestamp(timestampFrom) != PLUS_SUCCESS
+      || channel->GetTrackedFrameList(timestampFrom, frameList, -1) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get the replayed frames");
+    status = PLUS_FAIL;
+  }
+  frameTimestamps.clear();
+  for (unsigned int frameIndex = 0; frameIndex < frameList->GetNumberOfTrackedFrames(); frameIndex++)
+  {
+    frameTimestamps.push_back(frameList->GetTrackedFrame(frameIndex)->GetTimestamp());
+  }
+  speedup = dataCollector->GetVirtualClockReplaySpeedup();
+
+  dataCollector->Stop();
+
+  // The capture device is not updated anymore, so the captured file can be finalized and read back
+  vtkPlusDevice* captureDevice = NULL;
+  dataCollector->GetDevice(captureDevice, VIRTUAL_CLOCK_CAPTURE_DEVICE_ID);
+  vtkPlusVirtualCapture* capture = dynamic_cast<vtkPlusVirtualCapture*>(captureDevice);
+  std::string capturedFilename;
+  if (capture == NULL
+      || capture->CloseFile(NULL, &capturedFilename) != PLUS_SUCCESS
+      || vtkPlusSequenceIO::Read(capturedFilename, capturedFrames) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get the frames captured during the virtual clock replay");
+    status = PLUS_FAIL;
+  }
+
+  dataCollector->Disconnect();
+  return status;
+}
 
 
 int main( int argc, char** argv )
@@ -27,6 +208,7 @@ int main( int argc, char** argv )
   std::string  inputConfigFileName;
   std::string  inputVideoBufferMetafile;
   std::string  inputTrackerBufferMetafile;
+  bool         virtualClock = false;
   int          verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
   vtksys::CommandLineArguments args;
@@ -34,6 +216,8 @@ int main( int argc, char** argv )
 
   args.AddArgument( "--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
     &inputConfigFileName, "Name of the input configuration file." );
+  args.AddArgument( "--virtual-clock", vtksys::CommandLineArguments::NO_ARGUMENT,
+    &virtualClock, "Replay the recorded data using the virtual clock and check that the replay is reproducible." );
   args.AddArgument( "--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, 
     &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug 5=trace)" );  
 
@@ -56,6 +240,47 @@ int main( int argc, char** argv )
 
   vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
 
+  if (virtualClock)
+  {
+    if (AddCaptureDevice(configRootElement, "ReplayRecordedDataTestVirtualClock.igs.mha") != PLUS_SUCCESS)
+    {
+      return EXIT_FAILURE;
+    }
+    std::vector<double> frameTimestamps1;
+    std::vector<double> frameTimestamps2;
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> capturedFrames1 = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> capturedFrames2 = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    double speedup1 = 0;
+    double speedup2 = 0;
+    if (ReplayWithVirtualClock(configRootElement, frameTimestamps1, capturedFrames1, speedup1) != PLUS_SUCCESS
+        || ReplayWithVirtualClock(configRootElement, frameTimestamps2, capturedFrames2, speedup2) != PLUS_SUCCESS)
+    {
+      return EXIT_FAILURE;
+    }
+    if (frameTimestamps1.empty())
+    {
+      LOG_ERROR("No frames were replayed");
+      return EXIT_FAILURE;
+    }
+    if (frameTimestamps1 != frameTimestamps2)
+    {
+      LOG_ERROR("Virtual clock replays are different: " << frameTimestamps1.size() << " and " << frameTimestamps2.size() << " frames");
+      return EXIT_FAILURE;
+    }
+    if (CompareCapturedFrames(capturedFrames1, capturedFrames2) != 0)
+    {
+      return EXIT_FAILURE;
+    }
+    if (speedup1 <= 1.0 || speedup2 <= 1.0)
+    {
+      LOG_ERROR("Virtual clock replay is not faster than real time (speedup: " << speedup1 << "x and " << speedup2 << "x)");
+      return EXIT_FAILURE;
+    }
+    LOG_INFO("Virtual clock replay of " << frameTimestamps1.size() << " frames (" << capturedFrames1->GetNumberOfTrackedFrames()
+             << " captured frames) is reproducible, speedup: " << speedup1 << "x and " << speedup2 << "x");
+    return EXIT_SUCCESS;
+  }
+
   vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
 
   dataCollector->ReadConfiguration( configRootElement );
@@ -7,6 +7,10 @@ See License.txt for details.
 /*!
   \file TimestampFilteringTest.cxx
   \brief This program tests the timestamp filtering algorithm.
+
+  If --compare-streaming-filter is specified then the filtered timestamps are computed with both the linear regression and
+  the streaming filtering method and the results are compared. The streaming method is also tested on simulated data
+  with hardware timestamps, dropped items and delayed items.
 */
 
 // Local includes
@@ -22,8 +26,282 @@ See License.txt for details.
 // VTK includes
 #include <vtksys/CommandLineArguments.hxx>
 #include <vtksys/SystemTools.hxx>
+#include <vtkMatrix4x4.h>
 #include <vtkTable.h>
 
+// STL includes
+#include <map>
+#include <random>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Check that the filtered timestamps are close to the unfiltered timestamps and the frame periods are more uniform after filtering
+  int CheckFilteringResults(vtkPlusBuffer* trackerBuffer, double inputMaxTimestampDifference, double inputMinStdevReductionFactor, const std::string& methodName)
+  {
+    int numberOfErrors(0);
+
+    // Check filtering results
+    //************************
+
+    // 1. The maximum difference between the filtered and nonfiltered timestamps for each frame shall be below a specified threshold (fabs(timestamp-unfilteredTimestamp) < maxTimestampDifference)
+    double maxTimestampDifference(0);
+    for (BufferItemUidType item = trackerBuffer->GetOldestItemUidInBuffer(); item <= trackerBuffer->GetLatestItemUidInBuffer(); ++item)
+    {
+      StreamBufferItem bufferItem;
+      if (trackerBuffer->GetStreamBufferItem(item, &bufferItem) != ITEM_OK)
+      {
+        LOG_WARNING("Failed to get buffer item with UID: " << item);
+        numberOfErrors++;
+        continue;
+      }
+
+      double timestampDifference = fabs(bufferItem.GetUnfilteredTimestamp(0) - bufferItem.GetFilteredTimestamp(0));
+      if (timestampDifference > maxTimestampDifference)
+      {
+        maxTimestampDifference = timestampDifference;
+      }
+      if (timestampDifference > inputMaxTimestampDifference)
+      {
+        LOG_ERROR("Difference between the filtered and nonfiltered timestamps are higher than the threshold (UID: " << item
+                  << ", unfilteredTimestamp: " << std::fixed << bufferItem.GetUnfilteredTimestamp(0)
+                  << ", filteredTimestamp: " << std::fixed << bufferItem.GetFilteredTimestamp(0)
+                  << ", timestamp diference: " << timestampDifference << ", threshold: " << inputMaxTimestampDifference << ")");
+        numberOfErrors++;
+      }
+    }
+
+    LOG_INFO("Maximum filtered (" << methodName << ") and unfiltered timestamp difference: " << maxTimestampDifference * 1000 << "ms");
+
+    //2. The standard deviation of the frame periods in the filtered data should be better than without filtering (stdevFramePeriodsUnfiltered / stdevFramePeriodsFiltered < minStdevReductionFactor)
+    vnl_vector<double>unfilteredFramePeriods(trackerBuffer->GetNumberOfItems() - 1);
+    vnl_vector<double>filteredFramePeriods(trackerBuffer->GetNumberOfItems() - 1);
+    int i = 0;
+    for (BufferItemUidType item = trackerBuffer->GetOldestItemUidInBuffer(); item < trackerBuffer->GetLatestItemUidInBuffer(); ++item)
+    {
+      StreamBufferItem bufferItem_1;
+      if (trackerBuffer->GetStreamBufferItem(item, &bufferItem_1) != ITEM_OK)
+      {
+        LOG_WARNING("Failed to get buffer item with UID: " << item);
+        numberOfErrors++;
+        continue;
+      }
+
+      StreamBufferItem bufferItem_2;
+      if (trackerBuffer->GetStreamBufferItem(item + 1, &bufferItem_2) != ITEM_OK)
+      {
+        LOG_WARNING("Failed to get buffer item with UID: " << item + 1);
+        numberOfErrors++;
+        continue;
+      }
+
+      unfilteredFramePeriods.put(i, (bufferItem_2.GetUnfilteredTimestamp(0) - bufferItem_1.GetUnfilteredTimestamp(0)) / (bufferItem_2.GetIndex() - bufferItem_1.GetIndex()));
+      filteredFramePeriods.put(i, (bufferItem_2.GetFilteredTimestamp(0) - bufferItem_1.GetFilteredTimestamp(0)) / (bufferItem_2.GetIndex() - bufferItem_1.GetIndex()));
+      i++;
+    }
+
+    // Compute frame period means
+    double unfilteredFramePeriodsMean = unfilteredFramePeriods.mean();
+    double filteredFramePeriodsMean = filteredFramePeriods.mean();
+
+    // Compute frame period stdev
+    vnl_vector<double> diffFromMeanUnfilteredFramePeriods = unfilteredFramePeriods - unfilteredFramePeriodsMean;
+    double unfilteredFramePeriodsStd = sqrt(diffFromMeanUnfilteredFramePeriods.squared_magnitude() / diffFromMeanUnfilteredFramePeriods.size());
+
+    LOG_INFO("Unfiltered frame periods mean: " << std::fixed << unfilteredFramePeriodsMean * 1000 << "ms stdev: " << unfilteredFramePeriodsStd * 1000 << "ms");
+
+    vnl_vector<double> diffFromMeanFilteredFramePeriods = filteredFramePeriods - filteredFramePeriodsMean;
+    double filteredFramePeriodsStd = sqrt(diffFromMeanFilteredFramePeriods.squared_magnitude() / diffFromMeanFilteredFramePeriods.size());
+
+    LOG_INFO("Filtered (" << methodName << ") frame periods mean: " << std::fixed << filteredFramePeriodsMean * 1000 << "ms stdev: " << filteredFramePeriodsStd * 1000 << "ms");
+
+    LOG_INFO("Filtered (" << methodName << ") data frame period reduction factor: " << std::fixed << unfilteredFramePeriodsStd / filteredFramePeriodsStd);
+
+    if (unfilteredFramePeriodsStd / filteredFramePeriodsStd < inputMinStdevReductionFactor)
+    {
+      LOG_ERROR("Filtered data frame period reduction factor is smaller than the threshold (factor: " << std::fixed << unfilteredFramePeriodsStd / filteredFramePeriodsStd << ", threshold: " << inputMinStdevReductionFactor << ")");
+      numberOfErrors++;
+    }
+
+    LOG_INFO("Estimated frame period (" << methodName << "): " << std::fixed << trackerBuffer->GetEstimatedFramePeriodSec() * 1000 << "ms, timestamp jitter: " << trackerBuffer->GetTimestampJitterSec() * 1000 << "ms");
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  // Compare the filtered timestamps of the items that are present in both buffers
+  int CompareFilteredTimestamps(vtkPlusBuffer* referenceBuffer, vtkPlusBuffer* comparedBuffer, double maxTimestampDifference)
+  {
+    std::map<unsigned long, double> referenceFilteredTimestamps;
+    for (BufferItemUidType item = referenceBuffer->GetOldestItemUidInBuffer(); item <= referenceBuffer->GetLatestItemUidInBuffer(); ++item)
+    {
+      StreamBufferItem bufferItem;
+      if (referenceBuffer->GetStreamBufferItem(item, &bufferItem) == ITEM_OK)
+      {
+        referenceFilteredTimestamps[bufferItem.GetIndex()] = bufferItem.GetFilteredTimestamp(0);
+      }
+    }
+
+    int numberOfComparedItems(0);
+    double maxDifference(0);
+    double sumDifference(0);
+    for (BufferItemUidType item = comparedBuffer->GetOldestItemUidInBuffer(); item <= comparedBuffer->GetLatestItemUidInBuffer(); ++item)
+    {
+      StreamBufferItem bufferItem;
+      if (comparedBuffer->GetStreamBufferItem(item, &bufferItem) != ITEM_OK)
+      {
+        continue;
+      }
+      std::map<unsigned long, double>::iterator referenceIt = referenceFilteredTimestamps.find(bufferItem.GetIndex());
+      if (referenceIt == referenceFilteredTimestamps.end())
+      {
+        continue;
+      }
+      double difference = fabs(bufferItem.GetFilteredTimestamp(0) - referenceIt->second);
+      maxDifference = std::max(maxDifference, difference);
+      sumDifference += difference;
+      numberOfComparedItems++;
+    }
+
+    if (numberOfComparedItems == 0)
+    {
+      LOG_ERROR("Filtered timestamps cannot be compared: there are no common items in the buffers");
+      return 1;
+    }
+
+    LOG_INFO("Difference between linear regression and streaming filtered timestamps: mean " << std::fixed << sumDifference / numberOfComparedItems * 1000 << "ms, maximum " << maxDifference * 1000 << "ms"
+             << " (compared items: " << numberOfComparedItems << ")");
+    if (maxDifference > maxTimestampDifference)
+    {
+      LOG_ERROR("Difference between linear regression and streaming filtered timestamps is higher than the threshold (difference: " << std::fixed << maxDifference << ", threshold: " << maxTimestampDifference << ")");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Simulate a device that provides hardware timestamps from a drifting clock, drops some items and some items are delayed
+  // (e.g., by the operating system), and check the filtered timestamps and the estimated clock parameters
+  int TestHardwareTimestampFiltering()
+  {
+    const unsigned long numberOfItems = 10000;
+    const int averagedItemsForFiltering = 2000;
+    // Filtered timestamps are evaluated after both filters are filled up
+    const unsigned long firstEvaluatedItemIndex = 2 * averagedItemsForFiltering;
+    const double framePeriodSec = 0.001;
+    const double hardwareClockStartSec = 10.0;
+    const double systemClockOffsetSec = 1000.0;
+    const double clockDriftPpm = 500.0;
+    const double maxTransferDelaySec = 0.001;
+    const double delayedItemExtraDelaySec = 0.020;
+
+    vtkSmartPointer<vtkPlusBuffer> streamingBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    streamingBuffer->SetBufferSize(numberOfItems);
+    streamingBuffer->SetAveragedItemsForFiltering(averagedItemsForFiltering);
+    streamingBuffer->SetTimestampFilteringMethod(vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_STREAMING);
+    vtkSmartPointer<vtkPlusBuffer> linearRegressionBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    linearRegressionBuffer->SetBufferSize(numberOfItems);
+    linearRegressionBuffer->SetAveragedItemsForFiltering(averagedItemsForFiltering);
+
+    // Fixed seed to make the test reproducible
+    std::mt19937 randomGenerator(12345);
+    std::uniform_real_distribution<double> transferDelayDistribution(0.0, maxTransferDelaySec);
+
+    vtkSmartPointer<vtkMatrix4x4> identityMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    igsioFieldMapType customFields;
+    customFields[vtkPlusBuffer::HARDWARE_TIMESTAMP_FIELD_NAME].first = FRAMEFIELD_NONE;
+    for (unsigned long itemIndex = 0; itemIndex < numberOfItems; ++itemIndex)
+    {
+      if (itemIndex % 50 == 49)
+      {
+        // Dropped item
+        continue;
+      }
+      double hardwareTimestamp = hardwareClockStartSec + itemIndex * framePeriodSec;
+      double unfilteredTimestamp = systemClockOffsetSec + hardwareTimestamp * (1.0 + clockDriftPpm * 1e-6) + transferDelayDistribution(randomGenerator);
+      if (itemIndex % 97 == 0)
+      {
+        unfilteredTimestamp += delayedItemExtraDelaySec;
+      }
+      // Until the filters are filled up unfiltered timestamps are used and items that are not newer than the previous one
+      // are not added to the buffers, therefore the returned status is not checked
+      customFields[vtkPlusBuffer::HARDWARE_TIMESTAMP_FIELD_NAME].second = std::to_string(hardwareTimestamp);
+      streamingBuffer->AddTimeStampedItem(identityMatrix, TOOL_OK, itemIndex, unfilteredTimestamp, UNDEFINED_TIMESTAMP, &customFields);
+      linearRegressionBuffer->AddTimeStampedItem(identityMatrix, TOOL_OK, itemIndex, unfilteredTimestamp);
+    }
+
+    double rmsErrorUnfiltered(0);
+    double rmsErrorLinearRegression(0);
+    double rmsErrorStreaming(0);
+    for (int bufferIndex = 0; bufferIndex < 2; ++bufferIndex)
+    {
+      vtkPlusBuffer* buffer = (bufferIndex == 0 ? linearRegressionBuffer.GetPointer() : streamingBuffer.GetPointer());
+      int numberOfEvaluatedItems(0);
+      double sumSquaredErrorUnfiltered(0);
+      double sumSquaredErrorFiltered(0);
+      for (BufferItemUidType item = buffer->GetOldestItemUidInBuffer(); item <= buffer->GetLatestItemUidInBuffer(); ++item)
+      {
+        StreamBufferItem bufferItem;
+        if (buffer->GetStreamBufferItem(item, &bufferItem) != ITEM_OK || bufferItem.GetIndex() < firstEvaluatedItemIndex)
+        {
+          continue;
+        }
+        // Filtered timestamps are expected to contain the average transfer delay
+        double hardwareTimestamp = hardwareClockStartSec + bufferItem.GetIndex() * framePeriodSec;
+        double expectedTimestamp = systemClockOffsetSec + hardwareTimestamp * (1.0 + clockDriftPpm * 1e-6) + maxTransferDelaySec / 2;
+        sumSquaredErrorUnfiltered += (bufferItem.GetUnfilteredTimestamp(0) - expectedTimestamp) * (bufferItem.GetUnfilteredTimestamp(0) - expectedTimestamp);
+        sumSquaredErrorFiltered += (bufferItem.GetFilteredTimestamp(0) - expectedTimestamp) * (bufferItem.GetFilteredTimestamp(0) - expectedTimestamp);
+        numberOfEvaluatedItems++;
+      }
+      if (numberOfEvaluatedItems == 0)
+      {
+        LOG_ERROR("Simulated hardware timestamps - no items were added to the buffer");
+        return 1;
+      }
+      rmsErrorUnfiltered = sqrt(sumSquaredErrorUnfiltered / numberOfEvaluatedItems);
+      if (bufferIndex == 0)
+      {
+        rmsErrorLinearRegression = sqrt(sumSquaredErrorFiltered / numberOfEvaluatedItems);
+      }
+      else
+      {
+        rmsErrorStreaming = sqrt(sumSquaredErrorFiltered / numberOfEvaluatedItems);
+      }
+    }
+
+    LOG_INFO("Simulated hardware timestamps - RMS timestamp error: unfiltered " << std::fixed << rmsErrorUnfiltered * 1000 << "ms, linear regression " << rmsErrorLinearRegression * 1000
+             << "ms, streaming " << rmsErrorStreaming * 1000 << "ms");
+    LOG_INFO("Simulated hardware timestamps - estimated clock drift: " << std::fixed << streamingBuffer->GetEstimatedClockDriftPpm() << "ppm (true: " << clockDriftPpm << "ppm)"
+             << ", frame period: " << streamingBuffer->GetEstimatedFramePeriodSec() * 1000 << "ms, jitter: " << streamingBuffer->GetTimestampJitterSec() * 1000 << "ms");
+
+    int numberOfErrors(0);
+    if (rmsErrorStreaming > 0.1e-3)
+    {
+      LOG_ERROR("RMS error of the streaming filtered timestamps is too high: " << std::fixed << rmsErrorStreaming * 1000 << "ms");
+      numberOfErrors++;
+    }
+    if (fabs(streamingBuffer->GetEstimatedClockDriftPpm() - clockDriftPpm) > 100.0)
+    {
+      LOG_ERROR("Estimated clock drift is incorrect: " << std::fixed << streamingBuffer->GetEstimatedClockDriftPpm() << "ppm (true: " << clockDriftPpm << "ppm)");
+      numberOfErrors++;
+    }
+    // Transfer delay is uniformly distributed, delayed items are expected to be excluded from the fitting
+    double expectedJitterSec = maxTransferDelaySec / sqrt(12.0);
+    if (fabs(streamingBuffer->GetTimestampJitterSec() - expectedJitterSec) > 0.3 * expectedJitterSec)
+    {
+      LOG_ERROR("Estimated timestamp jitter is incorrect: " << std::fixed << streamingBuffer->GetTimestampJitterSec() * 1000 << "ms (expected: " << expectedJitterSec * 1000 << "ms)");
+      numberOfErrors++;
+    }
+    // One item is dropped out of every 50, so the average period between the received items is 50/49 frame period
+    double expectedFramePeriodSec = framePeriodSec * 50.0 / 49.0;
+    if (fabs(streamingBuffer->GetEstimatedFramePeriodSec() - expectedFramePeriodSec) > 0.01 * expectedFramePeriodSec)
+    {
+      LOG_ERROR("Estimated frame period is incorrect: " << std::fixed << streamingBuffer->GetEstimatedFramePeriodSec() * 1000 << "ms (expected: " << expectedFramePeriodSec * 1000 << "ms)");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
 
 int main(int argc, char** argv)
 {
@@ -36,6 +314,7 @@ int main(int argc, char** argv)
   double inputMaxTimestampDifference(0.080);
   double inputMinStdevReductionFactor(3.0);
   std::string inputTransformName;
+  bool compareStreamingFilter(false);
 
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
@@ -48,6 +327,7 @@ int main(int argc, char** argv)
   args.AddArgument("--averaged-items-for-filtering", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputAveragedItemsForFiltering, "Number of averaged items used for filtering (Default: 20).");
   args.AddArgument("--max-timestamp-difference", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMaxTimestampDifference, "The maximum difference between the filtered and nonfiltered timestamps for each frame (Default: 0.08s).");
   args.AddArgument("--min-stdev-reduction-factor", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMinStdevReductionFactor, "Minimum factor that the filtering should reduces the standard deviation of the frame periods on filtered data (Default: 3.0 ).");
+  args.AddArgument("--compare-streaming-filter", vtksys::CommandLineArguments::NO_ARGUMENT, &compareStreamingFilter, "Compute filtered timestamps with the streaming filtering method as well and compare the results.");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
 
   if (!args.Parse())
@@ -90,6 +370,7 @@ int main(int argc, char** argv)
   LOG_INFO("Copy buffer to tracker buffer...");
   vtkSmartPointer<vtkPlusBuffer> trackerBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
   trackerBuffer->SetTimeStampReporting(true);
+  trackerBuffer->SetAveragedItemsForFiltering(inputAveragedItemsForFiltering);
   // compute filtered timestamps now to test the filtering
   if (trackerBuffer->CopyTransformFromTrackedFrameList(trackerFrameList, vtkPlusBuffer::READ_UNFILTERED_COMPUTE_FILTERED_TIMESTAMPS, transformName) != PLUS_SUCCESS)
   {
@@ -97,89 +378,33 @@ int main(int argc, char** argv)
     numberOfErrors++;
   }
 
-  // Check filtering results
-  //************************
-
-  // 1. The maximum difference between the filtered and nonfiltered timestamps for each frame shall be below a specified threshold (fabs(timestamp-unfilteredTimestamp) < maxTimestampDifference)
-  double maxTimestampDifference(0);
-  for (BufferItemUidType item = trackerBuffer->GetOldestItemUidInBuffer(); item <= trackerBuffer->GetLatestItemUidInBuffer(); ++item)
-  {
-    StreamBufferItem bufferItem;
-    if (trackerBuffer->GetStreamBufferItem(item, &bufferItem) != ITEM_OK)
-    {
-      LOG_WARNING("Failed to get buffer item with UID: " << item);
-      numberOfErrors++;
-      continue;
-    }
-
-    double timestampDifference = fabs(bufferItem.GetUnfilteredTimestamp(0) - bufferItem.GetFilteredTimestamp(0));
-    if (timestampDifference > maxTimestampDifference)
-    {
-      maxTimestampDifference = timestampDifference;
-    }
-    if (timestampDifference > inputMaxTimestampDifference)
-    {
-      LOG_ERROR("Difference between the filtered and nonfiltered timestamps are higher than the threshold (UID: " << item
-                << ", unfilteredTimestamp: " << std::fixed << bufferItem.GetUnfilteredTimestamp(0)
-                << ", filteredTimestamp: " << std::fixed << bufferItem.GetFilteredTimestamp(0)
-                << ", timestamp diference: " << timestampDifference << ", threshold: " << inputMaxTimestampDifference << ")");
-      numberOfErrors++;
-    }
-  }
-
-  LOG_INFO("Maximum filtered and unfiltered timestamp difference: " << maxTimestampDifference * 1000 << "ms");
+  numberOfErrors += CheckFilteringResults(trackerBuffer, inputMaxTimestampDifference, inputMinStdevReductionFactor, "linear regression");
 
-  //2. The standard deviation of the frame periods in the filtered data should be better than without filtering (stdevFramePeriodsUnfiltered / stdevFramePeriodsFiltered < minStdevReductionFactor)
-  vnl_vector<double>unfilteredFramePeriods(trackerBuffer->GetNumberOfItems() - 1);
-  vnl_vector<double>filteredFramePeriods(trackerBuffer->GetNumberOfItems() - 1);
-  int i = 0;
-  for (BufferItemUidType item = trackerBuffer->GetOldestItemUidInBuffer(); item < trackerBuffer->GetLatestItemUidInBuffer(); ++item)
+  if (compareStreamingFilter)
   {
-    StreamBufferItem bufferItem_1;
-    if (trackerBuffer->GetStreamBufferItem(item, &bufferItem_1) != ITEM_OK)
+    LOG_INFO("Copy buffer to tracker buffer with streaming timestamp filtering...");
+    vtkSmartPointer<vtkPlusBuffer> streamingTrackerBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    streamingTrackerBuffer->SetAveragedItemsForFiltering(inputAveragedItemsForFiltering);
+    streamingTrackerBuffer->SetTimestampFilteringMethod(vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_STREAMING);
+    if (streamingTrackerBuffer->CopyTransformFromTrackedFrameList(trackerFrameList, vtkPlusBuffer::READ_UNFILTERED_COMPUTE_FILTERED_TIMESTAMPS, transformName) != PLUS_SUCCESS)
     {
-      LOG_WARNING("Failed to get buffer item with UID: " << item);
+      LOG_ERROR("CopyDefaultTrackerDataToBuffer failed");
       numberOfErrors++;
-      continue;
     }
-
-    StreamBufferItem bufferItem_2;
-    if (trackerBuffer->GetStreamBufferItem(item + 1, &bufferItem_2) != ITEM_OK)
+    numberOfErrors += CheckFilteringResults(streamingTrackerBuffer, inputMaxTimestampDifference, inputMinStdevReductionFactor, "streaming");
+    numberOfErrors += CompareFilteredTimestamps(trackerBuffer, streamingTrackerBuffer, inputMaxTimestampDifference);
+    numberOfErrors += TestHardwareTimestampFiltering();
+
+    // A copied buffer has to keep filtering timestamps with the same method
+    vtkSmartPointer<vtkPlusBuffer> copiedStreamingTrackerBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    copiedStreamingTrackerBuffer->DeepCopy(streamingTrackerBuffer);
+    if (copiedStreamingTrackerBuffer->GetTimestampFilteringMethod() != vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_STREAMING)
     {
-      LOG_WARNING("Failed to get buffer item with UID: " << item + 1);
+      LOG_ERROR("Timestamp filtering method is not copied by DeepCopy");
       numberOfErrors++;
-      continue;
     }
-
-    unfilteredFramePeriods.put(i, (bufferItem_2.GetUnfilteredTimestamp(0) - bufferItem_1.GetUnfilteredTimestamp(0)) / (bufferItem_2.GetIndex() - bufferItem_1.GetIndex()));
-    filteredFramePeriods.put(i, (bufferItem_2.GetFilteredTimestamp(0) - bufferItem_1.GetFilteredTimestamp(0)) / (bufferItem_2.GetIndex() - bufferItem_1.GetIndex()));
-    i++;
   }
 
-  // Compute frame period means
-  double unfilteredFramePeriodsMean = unfilteredFramePeriods.mean();
-  double filteredFramePeriodsMean = filteredFramePeriods.mean();
-
-  // Compute frame period stdev
-  vnl_vector<double> diffFromMeanUnfilteredFramePeriods = unfilteredFramePeriods - unfilteredFramePeriodsMean;
-  double unfilteredFramePeriodsStd = sqrt(diffFromMeanUnfilteredFramePeriods.squared_magnitude() / diffFromMeanUnfilteredFramePeriods.size());
-
-  LOG_INFO("Unfiltered frame periods mean: " << std::fixed << unfilteredFramePeriodsMean * 1000 << "ms stdev: " << unfilteredFramePeriodsStd * 1000 << "ms");
-
-  vnl_vector<double> diffFromMeanFilteredFramePeriods = filteredFramePeriods - filteredFramePeriodsMean;
-  double filteredFramePeriodsStd = sqrt(diffFromMeanFilteredFramePeriods.squared_magnitude() / diffFromMeanFilteredFramePeriods.size());
-
-  LOG_INFO("Filtered frame periods mean: " << std::fixed << filteredFramePeriodsMean * 1000 << "ms stdev: " << filteredFramePeriodsStd * 1000 << "ms");
-
-  LOG_INFO("Filtered data frame period reduction factor: " << std::fixed << unfilteredFramePeriodsStd / filteredFramePeriodsStd);
-
-  if (unfilteredFramePeriodsStd / filteredFramePeriodsStd < inputMinStdevReductionFactor)
-  {
-    LOG_ERROR("Filtered data frame period reduction factor is smaller than the threshold (factor: " << std::fixed << unfilteredFramePeriodsStd / filteredFramePeriodsStd << ", threshold: " << inputMinStdevReductionFactor << ")");
-    numberOfErrors++;
-  }
-
-
   vtkSmartPointer<vtkTable> timestampReportTable = vtkSmartPointer<vtkTable>::New();
   if (trackerBuffer->GetTimeStampReportTable(timestampReportTable) != PLUS_SUCCESS)
   {
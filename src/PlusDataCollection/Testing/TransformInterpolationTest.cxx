@@ -162,6 +162,66 @@ int main(int argc, char **argv)
     prevmatrix->DeepCopy(matrix);      
   }
 
+  // Check transform time series query
+  //****************************
+
+  PlusTransformTimeSeries timeSeries;
+  if ( trackerBuffer->GetTransformTimeSeries(startTime, endTime, timeSeries) != PLUS_SUCCESS )
+  {
+    LOG_ERROR("Failed to get transform time series from tracker buffer!");
+    numberOfErrors++;
+  }
+  else if ( static_cast<int>(timeSeries.GetNumberOfSamples()) != trackerBuffer->GetNumberOfItems() )
+  {
+    LOG_ERROR("Number of samples in transform time series (" << timeSeries.GetNumberOfSamples() << ") does not match the number of buffer items (" << trackerBuffer->GetNumberOfItems() << ")!");
+    numberOfErrors++;
+  }
+
+  // Resampled time series must match the interpolated buffer items
+  const double resamplingPeriodSec = 1.0 / (frameRate * 5.0);
+  if ( trackerBuffer->GetTransformTimeSeries(startTime, endTime, timeSeries, resamplingPeriodSec) != PLUS_SUCCESS )
+  {
+    LOG_ERROR("Failed to get resampled transform time series from tracker buffer!");
+    numberOfErrors++;
+  }
+  for ( size_t sampleIndex = 0; sampleIndex < timeSeries.GetNumberOfSamples(); ++sampleIndex )
+  {
+    if ( timeSeries.Statuses[sampleIndex] != TOOL_OK )
+    {
+      continue;
+    }
+    double sampleTime = timeSeries.Timestamps[sampleIndex];
+    StreamBufferItem bufferItem;
+    if ( trackerBuffer->GetStreamBufferItemFromTime(sampleTime, &bufferItem, vtkPlusBuffer::INTERPOLATED) != ITEM_OK || bufferItem.GetStatus() != TOOL_OK )
+    {
+      LOG_ERROR("Transform time series sample is valid but interpolated buffer item is not available (timestamp=" << std::fixed << sampleTime << ")!");
+      numberOfErrors++;
+      continue;
+    }
+    bufferItem.GetMatrix(matrix);
+
+    double rotation[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    vtkMath::QuaternionToMatrix3x3(timeSeries.GetQuaternion(sampleIndex), rotation);
+    const double* translation = timeSeries.GetTranslation(sampleIndex);
+    vtkSmartPointer<vtkMatrix4x4> sampleMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for ( int i = 0; i < 3; i++ )
+    {
+      sampleMatrix->SetElement(i, 0, rotation[i][0]);
+      sampleMatrix->SetElement(i, 1, rotation[i][1]);
+      sampleMatrix->SetElement(i, 2, rotation[i][2]);
+      sampleMatrix->SetElement(i, 3, translation[i]);
+    }
+
+    const double maxTimeSeriesDifference = 0.001;
+    double rotDiff = igsioMath::GetOrientationDifference(sampleMatrix, matrix);
+    double transDiff = igsioMath::GetPositionDifference(sampleMatrix, matrix);
+    if ( rotDiff > maxTimeSeriesDifference || transDiff > maxTimeSeriesDifference )
+    {
+      LOG_ERROR("Transform time series sample does not match the interpolated buffer item (rotation difference=" << std::fixed << rotDiff << ", translation difference=" << transDiff << ", timestamp=" << sampleTime << ")!");
+      numberOfErrors++;
+    }
+  }
+
   if ( numberOfErrors != 0 )
   {
     LOG_INFO("Test failed!");
@@ -0,0 +1,318 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkDataCollectorParallelStartupTest.cxx
+  \brief Test the dependency ordered connection and start of devices in the data collector
+
+  The device set is a mixer device that uses the output channels of two source devices. The mixer is added to the
+  data collector first, so the configuration order differs from the dependency order. Each device takes some time
+  to connect and start. The test checks that the sources are connected and started before the mixer, that the
+  independent sources are processed concurrently if ParallelStartup is enabled, that a dependency cycle falls back
+  to processing the devices one by one in configuration order, and that a failing device makes Connect or Start fail.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkObjectFactory.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDevice.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+// STL includes
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+  /*! Time that a device needs to connect or start, long enough to detect concurrent processing reliably */
+  const double DEVICE_TASK_DURATION_SEC = 0.2;
+
+  struct DeviceTaskEvent
+  {
+    std::string DeviceId;
+    std::string TaskName;
+    double BeginTime;
+    double EndTime;
+  };
+
+  std::mutex DeviceTaskEventsMutex;
+  std::vector<DeviceTaskEvent> DeviceTaskEvents;
+
+  //----------------------------------------------------------------------------
+  PlusStatus RecordDeviceTask(const std::string& deviceId, const std::string& taskName, bool fail)
+  {
+    DeviceTaskEvent taskEvent;
+    taskEvent.DeviceId = deviceId;
+    taskEvent.TaskName = taskName;
+    taskEvent.BeginTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    vtkIGSIOAccurateTimer::Delay(DEVICE_TASK_DURATION_SEC);
+    taskEvent.EndTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    {
+      std::lock_guard<std::mutex> lock(DeviceTaskEventsMutex);
+      DeviceTaskEvents.push_back(taskEvent);
+    }
+    return fail ? PLUS_FAIL : PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+/*! Device that records when it is connected and started */
+class vtkPlusStartupOrderTestDevice : public vtkPlusDevice
+{
+public:
+  static vtkPlusStartupOrderTestDevice* New();
+  vtkTypeMacro(vtkPlusStartupOrderTestDevice, vtkPlusDevice);
+
+  vtkSetMacro(FailConnect, bool);
+  vtkSetMacro(FailStart, bool);
+
+protected:
+  vtkPlusStartupOrderTestDevice() : FailConnect(false), FailStart(false) {}
+  ~vtkPlusStartupOrderTestDevice() {}
+
+  virtual PlusStatus InternalConnect() { return RecordDeviceTask(this->GetDeviceId(), "Connect", this->FailConnect); }
+  virtual PlusStatus InternalStartRecording() { return RecordDeviceTask(this->GetDeviceId(), "Start", this->FailStart); }
+
+  bool FailConnect;
+  bool FailStart;
+
+private:
+  vtkPlusStartupOrderTestDevice(const vtkPlusStartupOrderTestDevice&); // Not implemented
+  void operator=(const vtkPlusStartupOrderTestDevice&); // Not implemented
+};
+
+vtkStandardNewMacro(vtkPlusStartupOrderTestDevice);
+
+namespace
+{
+  const char MIXER_DEVICE_ID[] = "MixerDevice";
+  const char FIRST_SOURCE_DEVICE_ID[] = "FirstSourceDevice";
+  const char SECOND_SOURCE_DEVICE_ID[] = "SecondSourceDevice";
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkPlusStartupOrderTestDevice> CreateDevice(vtkPlusDataCollector* dataCollector, const std::string& deviceId)
+  {
+    vtkSmartPointer<vtkPlusStartupOrderTestDevice> device = vtkSmartPointer<vtkPlusStartupOrderTestDevice>::New();
+    device->SetDeviceId(deviceId);
+    vtkSmartPointer<vtkPlusChannel> outputChannel = vtkSmartPointer<vtkPlusChannel>::New();
+    outputChannel->SetChannelId((deviceId + "Stream").c_str());
+    device->AddOutputChannel(outputChannel);
+    dataCollector->AddDevice(device);
+    return device;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Mixer device that uses the output channels of two source devices (mixer is added to the data collector first) */
+  vtkSmartPointer<vtkPlusDataCollector> CreateDeviceSet(bool parallelStartup, std::map<std::string, vtkSmartPointer<vtkPlusStartupOrderTestDevice> >& devices)
+  {
+    vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+    dataCollector->SetParallelStartup(parallelStartup);
+    dataCollector->SetStartupDelaySec(0.0);
+    devices.clear();
+    devices[MIXER_DEVICE_ID] = CreateDevice(dataCollector, MIXER_DEVICE_ID);
+    devices[FIRST_SOURCE_DEVICE_ID] = CreateDevice(dataCollector, FIRST_SOURCE_DEVICE_ID);
+    devices[SECOND_SOURCE_DEVICE_ID] = CreateDevice(dataCollector, SECOND_SOURCE_DEVICE_ID);
+    const char* sourceDeviceIds[] = { FIRST_SOURCE_DEVICE_ID, SECOND_SOURCE_DEVICE_ID };
+    for (int i = 0; i < 2; ++i)
+    {
+      devices[MIXER_DEVICE_ID]->AddInputChannel(*(devices[sourceDeviceIds[i]]->GetOutputChannelsStart()));
+    }
+
+    std::lock_guard<std::mutex> lock(DeviceTaskEventsMutex);
+    DeviceTaskEvents.clear();
+    return dataCollector;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetDeviceTaskEvent(const std::string& deviceId, const std::string& taskName, DeviceTaskEvent& taskEvent)
+  {
+    std::lock_guard<std::mutex> lock(DeviceTaskEventsMutex);
+    for (std::vector<DeviceTaskEvent>::iterator it = DeviceTaskEvents.begin(); it != DeviceTaskEvents.end(); ++it)
+    {
+      if (it->DeviceId == deviceId && it->TaskName == taskName)
+      {
+        taskEvent = *it;
+        return PLUS_SUCCESS;
+      }
+    }
+    LOG_ERROR(taskName << " of " << deviceId << " is not executed");
+    return PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckTaskOrder(const std::string& taskName, bool concurrentSourcesExpected)
+  {
+    DeviceTaskEvent mixerEvent;
+    DeviceTaskEvent firstSourceEvent;
+    DeviceTaskEvent secondSourceEvent;
+    if (GetDeviceTaskEvent(MIXER_DEVICE_ID, taskName, mixerEvent) != PLUS_SUCCESS
+        || GetDeviceTaskEvent(FIRST_SOURCE_DEVICE_ID, taskName, firstSourceEvent) != PLUS_SUCCESS
+        || GetDeviceTaskEvent(SECOND_SOURCE_DEVICE_ID, taskName, secondSourceEvent) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+
+    int numberOfErrors(0);
+    if (mixerEvent.BeginTime < firstSourceEvent.EndTime || mixerEvent.BeginTime < secondSourceEvent.EndTime)
+    {
+      LOG_ERROR(taskName << " of the mixer device began before its input devices completed the same");
+      numberOfErrors++;
+    }
+    bool sourcesConcurrent = (firstSourceEvent.BeginTime < secondSourceEvent.EndTime && secondSourceEvent.BeginTime < firstSourceEvent.EndTime);
+    if (sourcesConcurrent != concurrentSourcesExpected)
+    {
+      LOG_ERROR(taskName << " of the independent source devices is " << (sourcesConcurrent ? "" : "not ") << "executed concurrently");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestDependencyOrder(bool parallelStartup)
+  {
+    LOG_INFO("Test dependency order with ParallelStartup " << (parallelStartup ? "enabled" : "disabled"));
+    std::map<std::string, vtkSmartPointer<vtkPlusStartupOrderTestDevice> > devices;
+    vtkSmartPointer<vtkPlusDataCollector> dataCollector = CreateDeviceSet(parallelStartup, devices);
+
+    int numberOfErrors(0);
+    if (dataCollector->Connect() != PLUS_SUCCESS || !dataCollector->GetConnected())
+    {
+      LOG_ERROR("Failed to connect the devices");
+      numberOfErrors++;
+    }
+    numberOfErrors += CheckTaskOrder("Connect", parallelStartup);
+    if (dataCollector->Start() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to start the devices");
+      numberOfErrors++;
+    }
+    numberOfErrors += CheckTaskOrder("Start", parallelStartup);
+    dataCollector->Stop();
+    dataCollector->Disconnect();
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestDependencyCycle()
+  {
+    LOG_INFO("Test dependency cycle");
+    std::map<std::string, vtkSmartPointer<vtkPlusStartupOrderTestDevice> > devices;
+    vtkSmartPointer<vtkPlusDataCollector> dataCollector = CreateDeviceSet(true, devices);
+    // The first source uses the output of the mixer as well
+    devices[FIRST_SOURCE_DEVICE_ID]->AddInputChannel(*(devices[MIXER_DEVICE_ID]->GetOutputChannelsStart()));
+
+    int numberOfErrors(0);
+    if (dataCollector->Connect() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to connect the devices with a dependency cycle");
+      numberOfErrors++;
+    }
+
+    dataCollector->Disconnect();
+
+    // Devices are connected one by one in configuration order
+    std::vector<DeviceTaskEvent> taskEvents;
+    {
+      std::lock_guard<std::mutex> lock(DeviceTaskEventsMutex);
+      taskEvents = DeviceTaskEvents;
+    }
+    const char* expectedDeviceOrder[] = { MIXER_DEVICE_ID, FIRST_SOURCE_DEVICE_ID, SECOND_SOURCE_DEVICE_ID };
+    if (taskEvents.size() != 3)
+    {
+      LOG_ERROR(taskEvents.size() << " devices are connected, expected 3");
+      return numberOfErrors + 1;
+    }
+    for (size_t i = 0; i < taskEvents.size(); ++i)
+    {
+      if (taskEvents[i].DeviceId != expectedDeviceOrder[i] || (i > 0 && taskEvents[i].BeginTime < taskEvents[i - 1].EndTime))
+      {
+        LOG_ERROR("Device " << taskEvents[i].DeviceId << " is connected as device " << i << ", expected " << expectedDeviceOrder[i] << " after the previous device is connected");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestDeviceFailure(bool failConnect)
+  {
+    LOG_INFO("Test device failure in " << (failConnect ? "Connect" : "Start"));
+    std::map<std::string, vtkSmartPointer<vtkPlusStartupOrderTestDevice> > devices;
+    vtkSmartPointer<vtkPlusDataCollector> dataCollector = CreateDeviceSet(true, devices);
+    devices[SECOND_SOURCE_DEVICE_ID]->SetFailConnect(failConnect);
+    devices[SECOND_SOURCE_DEVICE_ID]->SetFailStart(!failConnect);
+
+    int numberOfErrors(0);
+    PlusStatus connectStatus = dataCollector->Connect();
+    if (failConnect)
+    {
+      if (connectStatus == PLUS_SUCCESS || dataCollector->GetConnected())
+      {
+        LOG_ERROR("Connect succeeded although a device failed to connect");
+        numberOfErrors++;
+      }
+    }
+    else
+    {
+      if (connectStatus != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to connect the devices");
+        numberOfErrors++;
+      }
+      if (dataCollector->Start() == PLUS_SUCCESS)
+      {
+        LOG_ERROR("Start succeeded although a device failed to start");
+        numberOfErrors++;
+      }
+      dataCollector->Stop();
+    }
+    dataCollector->Disconnect();
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  // The dependency cycle and the device failures are reported as errors, therefore only the number of
+  // errors found by the test decides the result
+  int numberOfErrors(0);
+  numberOfErrors += TestDependencyOrder(true);
+  numberOfErrors += TestDependencyOrder(false);
+  numberOfErrors += TestDependencyCycle();
+  numberOfErrors += TestDeviceFailure(true);
+  numberOfErrors += TestDeviceFailure(false);
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,409 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkOpenIGTLinkReceiveThreadTest.cxx
+  \brief Test OpenIGTLink video source and tracker devices that receive messages on a dedicated thread
+
+  A test server in this process sends bursts of IMAGE and TDATA messages (all messages of a burst are sent at once).
+  The devices use UseReceiveThread="TRUE" and a low acquisition rate, so a burst is only received in time if the
+  messages are read as they arrive and not one per acquisition period. After two bursts the server closes the
+  connection: the devices have to reconnect and receive the third burst as well. Each received image is compared
+  to the sent one, so frames that are assembled from partially received messages are detected.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+#include "vtkXMLUtilities.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+// OpenIGTLink includes
+#include <igtlClientSocket.h>
+#include <igtlImageMessage.h>
+#include <igtlMessageHeader.h>
+#include <igtlServerSocket.h>
+#include <igtlTrackingDataMessage.h>
+
+// STL includes
+#include <cmath>
+#include <set>
+
+namespace
+{
+  const int NUMBER_OF_BURSTS = 3;
+  const int NUMBER_OF_MESSAGES_PER_BURST = 40;
+  // The connection is closed by the server before this burst
+  const int RECONNECT_BEFORE_BURST = 2;
+  // Messages are polled at this rate if the receive thread is not used, then a burst would take NUMBER_OF_MESSAGES_PER_BURST/ACQUISITION_RATE sec
+  const double ACQUISITION_RATE = 10.0;
+  const double BURST_RECEIVE_TIMEOUT_SEC = 2.0;
+  const double RECONNECT_TIMEOUT_SEC = 10.0;
+  const unsigned int IMAGE_WIDTH = 64;
+  const unsigned int IMAGE_HEIGHT = 48;
+
+  //----------------------------------------------------------------------------
+  unsigned char GetExpectedPixelValue(int messageIndex, unsigned int pixelIndex)
+  {
+    return static_cast<unsigned char>((messageIndex * 7 + pixelIndex) & 0xFF);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! OpenIGTLink server that sends the messages of a burst without any delay between them */
+  class BurstServer
+  {
+  public:
+    PlusStatus Listen(int port)
+    {
+      this->ServerSocket = igtl::ServerSocket::New();
+      if (this->ServerSocket->CreateServer(port) != 0)
+      {
+        LOG_ERROR("Failed to create test server on port " << port);
+        return PLUS_FAIL;
+      }
+      return PLUS_SUCCESS;
+    }
+
+    //----------------------------------------------------------------------------
+    /*! Accept the connection of the device and discard the messages that it sends after connecting (client info, tracking data request) */
+    PlusStatus AcceptClient()
+    {
+      this->ClientSocket = this->ServerSocket->WaitForConnection(static_cast<unsigned long>(RECONNECT_TIMEOUT_SEC * 1000));
+      if (this->ClientSocket.IsNull())
+      {
+        LOG_ERROR("Device did not connect to the test server in " << RECONNECT_TIMEOUT_SEC << " sec");
+        return PLUS_FAIL;
+      }
+      this->ClientSocket->SetReceiveTimeout(200);
+      igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+      while (true)
+      {
+        headerMsg->InitBuffer();
+        bool timeout(false);
+        int numOfBytesReceived = this->ClientSocket->Receive(headerMsg->GetBufferPointer(), headerMsg->GetBufferSize(), timeout);
+        if (numOfBytesReceived <= 0 || static_cast<igtlUint64>(numOfBytesReceived) != headerMsg->GetBufferSize())
+        {
+          break;
+        }
+        headerMsg->Unpack();
+        LOG_DEBUG("Test server received " << headerMsg->GetMessageType() << " message");
+        this->ClientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+      }
+      return PLUS_SUCCESS;
+    }
+
+    //----------------------------------------------------------------------------
+    PlusStatus SendBurst(const std::string& messageType, const std::string& toolName, int firstMessageIndex)
+    {
+      for (int messageIndex = firstMessageIndex; messageIndex < firstMessageIndex + NUMBER_OF_MESSAGES_PER_BURST; ++messageIndex)
+      {
+        igtl::MessageBase::Pointer message;
+        if (messageType == "IMAGE")
+        {
+          igtl::ImageMessage::Pointer imageMessage = igtl::ImageMessage::New();
+          imageMessage->SetDeviceName("Image");
+          imageMessage->SetDimensions(IMAGE_WIDTH, IMAGE_HEIGHT, 1);
+          imageMessage->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+          imageMessage->AllocateScalars();
+          unsigned char* pixels = static_cast<unsigned char*>(imageMessage->GetScalarPointer());
+          for (unsigned int pixelIndex = 0; pixelIndex < IMAGE_WIDTH * IMAGE_HEIGHT; ++pixelIndex)
+          {
+            pixels[pixelIndex] = GetExpectedPixelValue(messageIndex, pixelIndex);
+          }
+          message = imageMessage.GetPointer();
+        }
+        else
+        {
+          igtl::Matrix4x4 matrix;
+          igtl::IdentityMatrix(matrix);
+          matrix[0][3] = static_cast<float>(messageIndex);
+          igtl::TrackingDataElement::Pointer trackingElement = igtl::TrackingDataElement::New();
+          trackingElement->SetName(toolName.c_str());
+          trackingElement->SetType(igtl::TrackingDataElement::TYPE_6D);
+          trackingElement->SetMatrix(matrix);
+          igtl::TrackingDataMessage::Pointer trackingDataMessage = igtl::TrackingDataMessage::New();
+          trackingDataMessage->SetDeviceName("Tracker");
+          trackingDataMessage->AddTrackingDataElement(trackingElement);
+          message = trackingDataMessage.GetPointer();
+        }
+        message->Pack();
+        if (this->ClientSocket->Send(message->GetBufferPointer(), message->GetBufferSize()) == 0)
+        {
+          LOG_ERROR("Test server failed to send " << messageType << " message " << messageIndex);
+          return PLUS_FAIL;
+        }
+      }
+      return PLUS_SUCCESS;
+    }
+
+    //----------------------------------------------------------------------------
+    void CloseClient()
+    {
+      if (this->ClientSocket.IsNotNull())
+      {
+        this->ClientSocket->CloseSocket();
+        this->ClientSocket = NULL;
+      }
+    }
+
+    //----------------------------------------------------------------------------
+    void Close()
+    {
+      this->CloseClient();
+      if (this->ServerSocket.IsNotNull())
+      {
+        this->ServerSocket->CloseSocket();
+      }
+    }
+
+  protected:
+    igtl::ServerSocket::Pointer ServerSocket;
+    igtl::ClientSocket::Pointer ClientSocket;
+  };
+
+  //----------------------------------------------------------------------------
+  std::string CreateDeviceSetConfiguration(const std::string& messageType, int port)
+  {
+    std::ostringstream xml;
+    xml << "<PlusConfiguration version=\"2.1\">\n"
+        << "  <DataCollection StartupDelaySec=\"0.0\">\n"
+        << "    <DeviceSet Name=\"vtkOpenIGTLinkReceiveThreadTest\" Description=\"OpenIGTLink device receiving " << messageType << " messages on a dedicated thread\" />\n";
+    if (messageType == "IMAGE")
+    {
+      xml << "    <Device Id=\"ReceiverDevice\" Type=\"OpenIGTLinkVideo\" MessageType=\"IMAGE\"";
+    }
+    else
+    {
+      xml << "    <Device Id=\"ReceiverDevice\" Type=\"OpenIGTLinkTracker\" MessageType=\"TDATA\" ToolReferenceFrame=\"Tracker\"";
+    }
+    xml << " ServerAddress=\"127.0.0.1\" ServerPort=\"" << port << "\" AcquisitionRate=\"" << ACQUISITION_RATE << "\""
+        << " ReceiveTimeoutSec=\"0.2\" ReconnectOnReceiveTimeout=\"TRUE\" UseReceiveThread=\"TRUE\">\n"
+        << "      <DataSources>\n";
+    if (messageType == "IMAGE")
+    {
+      xml << "        <DataSource Type=\"Video\" Id=\"Video\" PortUsImageOrientation=\"MF\" BufferSize=\"500\" />\n"
+          << "      </DataSources>\n"
+          << "      <OutputChannels>\n"
+          << "        <OutputChannel Id=\"ReceiverStream\" VideoDataSourceId=\"Video\" />\n";
+    }
+    else
+    {
+      xml << "        <DataSource Type=\"Tool\" Id=\"Stylus\" BufferSize=\"500\" />\n"
+          << "      </DataSources>\n"
+          << "      <OutputChannels>\n"
+          << "        <OutputChannel Id=\"ReceiverStream\">\n"
+          << "          <DataSource Id=\"Stylus\" />\n"
+          << "        </OutputChannel>\n";
+    }
+    xml << "      </OutputChannels>\n"
+        << "    </Device>\n"
+        << "  </DataCollection>\n"
+        << "</PlusConfiguration>\n";
+    return xml.str();
+  }
+
+  //----------------------------------------------------------------------------
+  vtkPlusDataSource* GetReceiverSource(vtkPlusDevice* device, const std::string& messageType)
+  {
+    vtkPlusDataSource* source = NULL;
+    if (messageType == "IMAGE")
+    {
+      device->GetFirstVideoSource(source);
+    }
+    else if (device->GetToolIteratorBegin() != device->GetToolIteratorEnd())
+    {
+      source = device->GetToolIteratorBegin()->second;
+    }
+    return source;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Index of the messages that are found in the received items (images are also checked pixel by pixel) */
+  void GetReceivedMessageIndices(vtkPlusDataSource* source, const std::string& messageType, std::set<int>& receivedMessageIndices, int& numberOfErrors)
+  {
+    receivedMessageIndices.clear();
+    if (source->GetNumberOfItems() == 0)
+    {
+      return;
+    }
+    int expectedMessageIndex = 0;
+    for (BufferItemUidType uid = source->GetOldestItemUidInBuffer(); uid <= source->GetLatestItemUidInBuffer(); ++uid)
+    {
+      StreamBufferItem bufferItem;
+      if (source->GetStreamBufferItem(uid, &bufferItem) != ITEM_OK)
+      {
+        continue;
+      }
+      if (messageType == "IMAGE")
+      {
+        // Every received message is an image, in the order as they were sent
+        const unsigned char* pixels = static_cast<const unsigned char*>(bufferItem.GetFrame().GetScalarPointer());
+        for (unsigned int pixelIndex = 0; pixelIndex < IMAGE_WIDTH * IMAGE_HEIGHT; ++pixelIndex)
+        {
+          if (pixels == NULL || pixels[pixelIndex] != GetExpectedPixelValue(expectedMessageIndex, pixelIndex))
+          {
+            LOG_ERROR("Received image " << expectedMessageIndex << " differs from the sent image at pixel " << pixelIndex);
+            numberOfErrors++;
+            break;
+          }
+        }
+        receivedMessageIndices.insert(expectedMessageIndex++);
+      }
+      else
+      {
+        // The tracker also stores the last known or invalid transforms while no messages are received
+        vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+        if (bufferItem.GetStatus() == TOOL_OK && bufferItem.GetMatrix(toolMatrix) == PLUS_SUCCESS)
+        {
+          receivedMessageIndices.insert(static_cast<int>(floor(toolMatrix->GetElement(0, 3) + 0.5)));
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus WaitForMessages(vtkPlusDataSource* source, const std::string& messageType, int numberOfMessages, double timeoutSec, int& numberOfErrors)
+  {
+    const double timeoutTime = vtkIGSIOAccurateTimer::GetSystemTime() + timeoutSec;
+    std::set<int> receivedMessageIndices;
+    while (true)
+    {
+      int numberOfImageErrors(0);
+      GetReceivedMessageIndices(source, messageType, receivedMessageIndices, numberOfImageErrors);
+      if (static_cast<int>(receivedMessageIndices.size()) >= numberOfMessages || vtkIGSIOAccurateTimer::GetSystemTime() > timeoutTime)
+      {
+        numberOfErrors += numberOfImageErrors;
+        break;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+    for (int messageIndex = 0; messageIndex < numberOfMessages; ++messageIndex)
+    {
+      if (receivedMessageIndices.find(messageIndex) == receivedMessageIndices.end())
+      {
+        LOG_ERROR(messageType << " message " << messageIndex << " was not received in " << timeoutSec << " sec (received " << receivedMessageIndices.size()
+                  << " of " << numberOfMessages << " messages)");
+        return PLUS_FAIL;
+      }
+    }
+    if (static_cast<int>(receivedMessageIndices.size()) != numberOfMessages)
+    {
+      LOG_ERROR("Received " << receivedMessageIndices.size() << " " << messageType << " messages, expected " << numberOfMessages);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestReceiveThread(const std::string& messageType, int port)
+  {
+    LOG_INFO("Test receiving " << messageType << " messages on a dedicated thread");
+    int numberOfErrors(0);
+
+    BurstServer server;
+    if (server.Listen(port) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(CreateDeviceSetConfiguration(messageType, port).c_str()));
+    vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+    vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+    vtkPlusDevice* device = NULL;
+    if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS || dataCollector->GetDevice(device, "ReceiverDevice") != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read the configuration of the " << messageType << " receiver device");
+      server.Close();
+      return 1;
+    }
+    vtkPlusDataSource* source = GetReceiverSource(device, messageType);
+    if (source == NULL)
+    {
+      LOG_ERROR("Data source of the " << messageType << " receiver device is not found");
+      server.Close();
+      return 1;
+    }
+
+    // The device connects to the listening server socket, its connection is accepted afterwards
+    if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS || server.AcceptClient() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to connect the " << messageType << " receiver device to the test server");
+      dataCollector->Disconnect();
+      server.Close();
+      return 1;
+    }
+
+    for (int burstIndex = 0; burstIndex < NUMBER_OF_BURSTS; ++burstIndex)
+    {
+      if (burstIndex == RECONNECT_BEFORE_BURST)
+      {
+        // The device has to notice that the connection is lost and connect again
+        LOG_INFO("Close the connection of the " << messageType << " receiver device");
+        server.CloseClient();
+        if (server.AcceptClient() != PLUS_SUCCESS)
+        {
+          numberOfErrors++;
+          break;
+        }
+      }
+      int firstMessageIndex = burstIndex * NUMBER_OF_MESSAGES_PER_BURST;
+      if (server.SendBurst(messageType, source->GetId(), firstMessageIndex) != PLUS_SUCCESS
+          || WaitForMessages(source, messageType, firstMessageIndex + NUMBER_OF_MESSAGES_PER_BURST, BURST_RECEIVE_TIMEOUT_SEC, numberOfErrors) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+        break;
+      }
+    }
+
+    // Disconnect before the server is closed, as the tracker sends a stop request to the server when disconnecting
+    dataCollector->Stop();
+    dataCollector->Disconnect();
+    server.Close();
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int videoPort(28956);
+  int trackerPort(28957);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--video-port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &videoPort, "Port of the test server that sends IMAGE messages (default: 28956).");
+  args.AddArgument("--tracker-port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &trackerPort, "Port of the test server that sends TDATA messages (default: 28957).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  numberOfErrors += TestReceiveThread("IMAGE", videoPort);
+  numberOfErrors += TestReceiveThread("TDATA", trackerPort);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,334 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkOpenIGTLinkTrackerCoalescedTDataTest.cxx
+  \brief Test TDATA messages that contain the tool poses of multiple samples (TDATA coalescing)
+
+  Several samples with per-tool statuses are packed into one TDATA message the same way as the server does it.
+  The message is unpacked from its byte stream and the sample meta data is read back. Then the message is processed
+  by an OpenIGTLink tracker: each sample has to be added to the tool buffers with the statuses it was sent with
+  and with the same time offset relative to the latest sample as on the server. A second message is processed right
+  after the first one, its samples that would overlap with the already received ones must be skipped.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlClientInfo.h"
+#include "vtkMatrix4x4.h"
+#include "vtkObjectFactory.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusIgtlMessageCommon.h"
+#include "vtkPlusOpenIGTLinkTracker.h"
+#include "vtkXMLUtilities.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+// OpenIGTLink includes
+#include <igtlMessageHeader.h>
+#include <igtlTrackingDataMessage.h>
+
+// STL includes
+#include <cmath>
+#include <cstring>
+
+//----------------------------------------------------------------------------
+/*! Tracker that gives access to the processing of unpacked TDATA messages */
+class vtkCoalescedTDataTestTracker : public vtkPlusOpenIGTLinkTracker
+{
+public:
+  static vtkCoalescedTDataTestTracker* New();
+  vtkTypeMacro(vtkCoalescedTDataTestTracker, vtkPlusOpenIGTLinkTracker);
+
+  using vtkPlusOpenIGTLinkTracker::ProcessTrackingDataMessage;
+
+protected:
+  vtkCoalescedTDataTestTracker() {}
+  ~vtkCoalescedTDataTestTracker() {}
+
+private:
+  vtkCoalescedTDataTestTracker(const vtkCoalescedTDataTestTracker&); // Not implemented
+  void operator=(const vtkCoalescedTDataTestTracker&); // Not implemented
+};
+
+vtkStandardNewMacro(vtkCoalescedTDataTestTracker);
+
+namespace
+{
+  const char STYLUS_TRANSFORM_NAME[] = "StylusToTracker";
+  const char PROBE_TRANSFORM_NAME[] = "ProbeToTracker";
+  /*! Time between the samples on the server */
+  const double SAMPLE_PERIOD_SEC = 0.01;
+  const double TIMESTAMP_TOLERANCE_SEC = 1e-5;
+
+  const char DEVICE_SET_CONFIGURATION[] =
+    "<PlusConfiguration version=\"2.1\">\n"
+    "  <DataCollection StartupDelaySec=\"0.0\">\n"
+    "    <DeviceSet Name=\"vtkOpenIGTLinkTrackerCoalescedTDataTest\" Description=\"OpenIGTLink tracker receiving coalesced TDATA messages\" />\n"
+    "    <Device Id=\"TrackerDevice\" Type=\"OpenIGTLinkTracker\" MessageType=\"TDATA\" TDATACoalescing=\"TRUE\" ToolReferenceFrame=\"Tracker\" ServerAddress=\"127.0.0.1\" ServerPort=\"18944\">\n"
+    "      <DataSources>\n"
+    "        <DataSource Type=\"Tool\" Id=\"Stylus\" BufferSize=\"50\" />\n"
+    "        <DataSource Type=\"Tool\" Id=\"Probe\" BufferSize=\"50\" />\n"
+    "      </DataSources>\n"
+    "    </Device>\n"
+    "  </DataCollection>\n"
+    "</PlusConfiguration>\n";
+
+  //----------------------------------------------------------------------------
+  /*! Tool pose with a translation that identifies the sample */
+  PlusIgtlClientInfo::TrackingDataSampleElement CreateElement(const std::string& transformName, double translationX, ToolStatus status)
+  {
+    PlusIgtlClientInfo::TrackingDataSampleElement element;
+    element.TransformName = transformName;
+    igtl::IdentityMatrix(element.Matrix);
+    element.Matrix[0][3] = static_cast<float>(translationX);
+    element.Status = status;
+    return element;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Pack the samples into a TDATA message, then unpack the message from its byte stream */
+  igtl::TrackingDataMessage::Pointer SendSamples(const std::vector<PlusIgtlClientInfo::TrackingDataSample>& samples)
+  {
+    igtl::TrackingDataMessage::Pointer sentMessage = igtl::TrackingDataMessage::New();
+    // Meta data is only sent with header version 2
+    sentMessage->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+    if (vtkPlusIgtlMessageCommon::PackTrackingDataMessage(sentMessage, samples) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to pack TDATA message");
+      return NULL;
+    }
+
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitBuffer();
+    memcpy(headerMsg->GetBufferPointer(), sentMessage->GetBufferPointer(), headerMsg->GetBufferSize());
+    headerMsg->Unpack();
+
+    igtl::TrackingDataMessage::Pointer receivedMessage = igtl::TrackingDataMessage::New();
+    receivedMessage->SetMessageHeader(headerMsg);
+    receivedMessage->AllocateBuffer();
+    if (receivedMessage->GetBufferBodySize() != sentMessage->GetBufferBodySize())
+    {
+      LOG_ERROR("Body size of the received TDATA message (" << receivedMessage->GetBufferBodySize() << ") does not match the sent message (" << sentMessage->GetBufferBodySize() << ")");
+      return NULL;
+    }
+    memcpy(receivedMessage->GetBufferBodyPointer(), sentMessage->GetBufferBodyPointer(), receivedMessage->GetBufferBodySize());
+    int c = receivedMessage->Unpack(1);
+    if (!(c & igtl::MessageHeader::UNPACK_BODY))
+    {
+      LOG_ERROR("Failed to unpack TDATA message");
+      return NULL;
+    }
+    return receivedMessage;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckSampleMetaData(igtl::TrackingDataMessage::Pointer message, const std::vector<PlusIgtlClientInfo::TrackingDataSample>& samples)
+  {
+    int numberOfErrors(0);
+    std::vector<double> sampleTimestamps;
+    std::vector<int> sampleElementCounts;
+    std::vector<ToolStatus> elementStatuses;
+    if (vtkPlusIgtlMessageCommon::GetTrackingDataMessageSamples(message, sampleTimestamps, sampleElementCounts, elementStatuses) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get the samples of the TDATA message");
+      return 1;
+    }
+    if (sampleTimestamps.size() != samples.size() || sampleElementCounts.size() != samples.size())
+    {
+      LOG_ERROR("TDATA message has " << sampleTimestamps.size() << " sample timestamps and " << sampleElementCounts.size() << " element counts, expected " << samples.size());
+      return 1;
+    }
+
+    size_t elementIndex = 0;
+    for (size_t sampleIndex = 0; sampleIndex < samples.size(); ++sampleIndex)
+    {
+      if (fabs(sampleTimestamps[sampleIndex] - samples[sampleIndex].Timestamp) > TIMESTAMP_TOLERANCE_SEC)
+      {
+        LOG_ERROR("Timestamp of sample " << sampleIndex << " is " << std::fixed << sampleTimestamps[sampleIndex] << ", expected " << samples[sampleIndex].Timestamp);
+        numberOfErrors++;
+      }
+      if (sampleElementCounts[sampleIndex] != static_cast<int>(samples[sampleIndex].Elements.size()))
+      {
+        LOG_ERROR("Sample " << sampleIndex << " has " << sampleElementCounts[sampleIndex] << " elements, expected " << samples[sampleIndex].Elements.size());
+        numberOfErrors++;
+        continue;
+      }
+      for (size_t i = 0; i < samples[sampleIndex].Elements.size(); ++i, ++elementIndex)
+      {
+        const PlusIgtlClientInfo::TrackingDataSampleElement& expectedElement = samples[sampleIndex].Elements[i];
+        if (elementIndex >= elementStatuses.size() || elementStatuses[elementIndex] != expectedElement.Status)
+        {
+          LOG_ERROR("Status of " << expectedElement.TransformName << " in sample " << sampleIndex << " is not received correctly");
+          numberOfErrors++;
+        }
+        igtl::TrackingDataElement::Pointer trackingElement = igtl::TrackingDataElement::New();
+        message->GetTrackingDataElement(static_cast<int>(elementIndex), trackingElement);
+        igtl::Matrix4x4 matrix;
+        trackingElement->GetMatrix(matrix);
+        if (expectedElement.TransformName != trackingElement->GetName() || matrix[0][3] != expectedElement.Matrix[0][3])
+        {
+          LOG_ERROR("Element " << elementIndex << " of the TDATA message is " << trackingElement->GetName() << " with translation " << matrix[0][3]
+                    << ", expected " << expectedElement.TransformName << " with translation " << expectedElement.Matrix[0][3]);
+          numberOfErrors++;
+        }
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Compare the content of the tool buffer to the expected sample poses (identified by their translation) and statuses */
+  int CheckToolBuffer(vtkPlusDataSource* tool, const std::vector<double>& expectedTranslations, const std::vector<ToolStatus>& expectedStatuses,
+                      const std::vector<double>& expectedTimeOffsets)
+  {
+    int numberOfErrors(0);
+    if (tool->GetNumberOfItems() != static_cast<int>(expectedTranslations.size()))
+    {
+      LOG_ERROR("Buffer of " << tool->GetId() << " has " << tool->GetNumberOfItems() << " items, expected " << expectedTranslations.size());
+      return 1;
+    }
+
+    double firstTimestamp(0);
+    int itemIndex = 0;
+    for (BufferItemUidType uid = tool->GetOldestItemUidInBuffer(); uid <= tool->GetLatestItemUidInBuffer(); ++uid, ++itemIndex)
+    {
+      StreamBufferItem bufferItem;
+      if (tool->GetStreamBufferItem(uid, &bufferItem) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get item " << itemIndex << " from the buffer of " << tool->GetId());
+        numberOfErrors++;
+        continue;
+      }
+      vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      bufferItem.GetMatrix(toolMatrix);
+      if (bufferItem.GetStatus() != expectedStatuses[itemIndex] || fabs(toolMatrix->GetElement(0, 3) - expectedTranslations[itemIndex]) > 1e-6)
+      {
+        LOG_ERROR("Item " << itemIndex << " of " << tool->GetId() << " has translation " << toolMatrix->GetElement(0, 3) << " and status " << igsioCommon::ConvertToolStatusToString(bufferItem.GetStatus())
+                  << ", expected " << expectedTranslations[itemIndex] << " and " << igsioCommon::ConvertToolStatusToString(expectedStatuses[itemIndex]));
+        numberOfErrors++;
+      }
+      double timestamp = bufferItem.GetUnfilteredTimestamp(0);
+      if (itemIndex == 0)
+      {
+        firstTimestamp = timestamp;
+      }
+      else if (fabs((timestamp - firstTimestamp) - expectedTimeOffsets[itemIndex]) > TIMESTAMP_TOLERANCE_SEC)
+      {
+        LOG_ERROR("Item " << itemIndex << " of " << tool->GetId() << " is " << std::fixed << timestamp - firstTimestamp << " sec after the first item, expected " << expectedTimeOffsets[itemIndex] << " sec");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(DEVICE_SET_CONFIGURATION));
+  vtkSmartPointer<vtkCoalescedTDataTestTracker> tracker = vtkSmartPointer<vtkCoalescedTDataTestTracker>::New();
+  tracker->SetDeviceId("TrackerDevice");
+  vtkPlusDataSource* stylus = NULL;
+  vtkPlusDataSource* probe = NULL;
+  if (tracker->ReadConfiguration(configRootElement) != PLUS_SUCCESS
+      || tracker->GetTool(STYLUS_TRANSFORM_NAME, stylus) != PLUS_SUCCESS || tracker->GetTool(PROBE_TRANSFORM_NAME, probe) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read the tracker configuration");
+    return EXIT_FAILURE;
+  }
+
+  // First message: both tools in the first two samples, only the stylus in the last one
+  std::vector<PlusIgtlClientInfo::TrackingDataSample> firstSamples(3);
+  for (size_t sampleIndex = 0; sampleIndex < firstSamples.size(); ++sampleIndex)
+  {
+    firstSamples[sampleIndex].Timestamp = 100.0 + sampleIndex * SAMPLE_PERIOD_SEC;
+  }
+  firstSamples[0].Elements.push_back(CreateElement(STYLUS_TRANSFORM_NAME, 0, TOOL_OK));
+  firstSamples[0].Elements.push_back(CreateElement(PROBE_TRANSFORM_NAME, 100, TOOL_MISSING));
+  firstSamples[1].Elements.push_back(CreateElement(STYLUS_TRANSFORM_NAME, 1, TOOL_OUT_OF_VIEW));
+  firstSamples[1].Elements.push_back(CreateElement(PROBE_TRANSFORM_NAME, 101, TOOL_OK));
+  firstSamples[2].Elements.push_back(CreateElement(STYLUS_TRANSFORM_NAME, 2, TOOL_OK));
+
+  // Second message: the samples continue on the server, but the message is received right after the first one.
+  // The first two samples would be placed before the latest received sample, only the last one can be added.
+  std::vector<PlusIgtlClientInfo::TrackingDataSample> secondSamples(3);
+  for (size_t sampleIndex = 0; sampleIndex < secondSamples.size(); ++sampleIndex)
+  {
+    secondSamples[sampleIndex].Timestamp = firstSamples.back().Timestamp + (sampleIndex + 1) * SAMPLE_PERIOD_SEC;
+    secondSamples[sampleIndex].Elements.push_back(CreateElement(STYLUS_TRANSFORM_NAME, 3 + sampleIndex, TOOL_OK));
+  }
+
+  igtl::TrackingDataMessage::Pointer firstMessage = SendSamples(firstSamples);
+  igtl::TrackingDataMessage::Pointer secondMessage = SendSamples(secondSamples);
+  if (firstMessage.IsNull() || secondMessage.IsNull())
+  {
+    LOG_ERROR("Test failed: TDATA messages cannot be sent");
+    return EXIT_FAILURE;
+  }
+  numberOfErrors += CheckSampleMetaData(firstMessage, firstSamples);
+  numberOfErrors += CheckSampleMetaData(secondMessage, secondSamples);
+
+  // Samples are placed before the receive time and only samples after the last added one (initially at 0) are kept
+  while (vtkIGSIOAccurateTimer::GetSystemTime() < 1.0)
+  {
+    vtkIGSIOAccurateTimer::Delay(0.1);
+  }
+  if (tracker->ProcessTrackingDataMessage(firstMessage) != PLUS_SUCCESS || tracker->ProcessTrackingDataMessage(secondMessage) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to process the received TDATA messages");
+    numberOfErrors++;
+  }
+
+  // Tools that are not in a sample are out of view. The first message is received some time before the second one,
+  // therefore the offset of the last item is not checked.
+  std::vector<double> expectedStylusTranslations = { 0, 1, 2, 5 };
+  std::vector<ToolStatus> expectedStylusStatuses = { TOOL_OK, TOOL_OUT_OF_VIEW, TOOL_OK, TOOL_OK };
+  std::vector<double> expectedTimeOffsets = { 0, SAMPLE_PERIOD_SEC, 2 * SAMPLE_PERIOD_SEC };
+  numberOfErrors += CheckToolBuffer(stylus, expectedStylusTranslations, expectedStylusStatuses, expectedTimeOffsets);
+  std::vector<double> expectedProbeTranslations = { 100, 101, 0, 0 };
+  std::vector<ToolStatus> expectedProbeStatuses = { TOOL_MISSING, TOOL_OK, TOOL_OUT_OF_VIEW, TOOL_OUT_OF_VIEW };
+  numberOfErrors += CheckToolBuffer(probe, expectedProbeTranslations, expectedProbeStatuses, expectedTimeOffsets);
+
+  // The item of the second message has to be added after the last item of the first message
+  StreamBufferItem lastFirstMessageItem;
+  StreamBufferItem secondMessageItem;
+  if (stylus->GetStreamBufferItem(stylus->GetLatestItemUidInBuffer() - 1, &lastFirstMessageItem) != ITEM_OK || stylus->GetStreamBufferItem(stylus->GetLatestItemUidInBuffer(), &secondMessageItem) != ITEM_OK
+      || secondMessageItem.GetUnfilteredTimestamp(0) <= lastFirstMessageItem.GetUnfilteredTimestamp(0))
+  {
+    LOG_ERROR("Sample of the second TDATA message is not added after the samples of the first message");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -25,6 +25,35 @@ vtkNew<vtkPlusOpenIGTLinkServer> server;
 
 void PrintLogsCallback(vtkObject* obj, unsigned long eid, void* clientdata, void* calldata);
 
+// Add a datagram broadcast of the client's tool transforms to the server configuration
+PlusStatus AddDatagramBroadcast(vtkXMLDataElement* serverConfigRootElement, vtkPlusOpenIGTLinkTracker* client, int datagramPort)
+{
+  XML_FIND_NESTED_ELEMENT_REQUIRED(serverElement, serverConfigRootElement, "PlusOpenIGTLinkServer");
+  vtkNew<vtkXMLDataElement> datagramBroadcast;
+  datagramBroadcast->SetName("DatagramBroadcast");
+  datagramBroadcast->SetAttribute("Address", "127.0.0.1");
+  datagramBroadcast->SetIntAttribute("Port", datagramPort);
+  vtkNew<vtkXMLDataElement> messageTypes;
+  messageTypes->SetName("MessageTypes");
+  vtkNew<vtkXMLDataElement> message;
+  message->SetName("Message");
+  message->SetAttribute("Type", "TRANSFORM");
+  messageTypes->AddNestedElement(message);
+  datagramBroadcast->AddNestedElement(messageTypes);
+  vtkNew<vtkXMLDataElement> transformNames;
+  transformNames->SetName("TransformNames");
+  for (DataSourceContainerConstIterator it = client->GetToolIteratorBegin(); it != client->GetToolIteratorEnd(); ++it)
+  {
+    vtkNew<vtkXMLDataElement> transform;
+    transform->SetName("Transform");
+    transform->SetAttribute("Name", it->second->GetId().c_str());
+    transformNames->AddNestedElement(transform);
+  }
+  datagramBroadcast->AddNestedElement(transformNames);
+  serverElement->AddNestedElement(datagramBroadcast);
+  return PLUS_SUCCESS;
+}
+
 PlusStatus StartServer(vtkXMLDataElement* configRootElement, const std::string& configFilePath)
 {
   LOG_INFO("Server status: Reading configuration.");
@@ -74,6 +103,8 @@ int main(int argc, char** argv)
   std::string clientConfigFileName;
   std::string serverConfigFileName;
   bool renderingOff(false);
+  int datagramPort(-1);
+  double maxDatagramLossPercent(5.0);
 
   vtksys::CommandLineArguments args;
   args.Initialize(argc, argv);
@@ -83,6 +114,8 @@ int main(int argc, char** argv)
   args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
   args.AddArgument("--client-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &clientConfigFileName, "Config file containing the client configuration.");
   args.AddArgument("--server-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &serverConfigFileName, "Config file containing the server configuration.");
+  args.AddArgument("--datagram-port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &datagramPort, "If specified then the server broadcasts the tool transforms in datagrams to this port and the client receives them from there instead of the TCP connection.");
+  args.AddArgument("--max-datagram-loss-percent", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxDatagramLossPercent, "Maximum allowed percentage of lost datagrams (default: 5).");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
 
   if (!args.Parse())
@@ -109,12 +142,6 @@ int main(int argc, char** argv)
     return EXIT_FAILURE;
   }
 
-  if (StartServer(serverConfigRootElement, serverConfigFileName) != PLUS_SUCCESS)
-  {
-    LOG_ERROR("Unable to start server");
-    return EXIT_FAILURE;
-  }
-
   // Read client config file
   LOG_INFO("Reading client config file...");
   vtkNew<vtkXMLDataElement> clientConfigRootElement;
@@ -131,12 +158,35 @@ int main(int argc, char** argv)
   client->AddObserver("WarningEvent", callbackCommand);
   client->AddObserver("ErrorEvent", callbackCommand);
   client->SetDeviceId("TrackerDevice");
+  if (datagramPort > 0)
+  {
+    vtkXMLDataElement* dataCollectionElement = clientConfigRootElement->FindNestedElementWithName("DataCollection");
+    vtkXMLDataElement* deviceElement = (dataCollectionElement != NULL ? dataCollectionElement->FindNestedElementWithNameAndAttribute("Device", "Id", "TrackerDevice") : NULL);
+    if (deviceElement == NULL)
+    {
+      LOG_ERROR("Unable to find TrackerDevice in the client configuration.");
+      return EXIT_FAILURE;
+    }
+    deviceElement->SetIntAttribute("DatagramPort", datagramPort);
+  }
   if (client->ReadConfiguration(clientConfigRootElement) != PLUS_SUCCESS)
   {
     LOG_ERROR("Unable to configure client.");
     return EXIT_FAILURE;
   }
 
+  if (datagramPort > 0 && AddDatagramBroadcast(serverConfigRootElement, client, datagramPort) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to add datagram broadcast to the server configuration.");
+    return EXIT_FAILURE;
+  }
+
+  if (StartServer(serverConfigRootElement, serverConfigFileName) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to start server");
+    return EXIT_FAILURE;
+  }
+
   LOG_INFO("Connect client...");
   if (client->Connect() != PLUS_SUCCESS)
   {
@@ -172,6 +222,33 @@ int main(int argc, char** argv)
     exit(EXIT_FAILURE);
   }
 
+  if (datagramPort > 0)
+  {
+    // The transforms must have been received through the datagram receive path of the tracker
+    uint64_t receivedDatagrams = client->GetNumberOfReceivedDatagrams();
+    uint64_t lostDatagrams = client->GetNumberOfLostDatagrams();
+    LOG_INFO("Datagrams received: " << receivedDatagrams << ", lost: " << lostDatagrams);
+    if (receivedDatagrams == 0)
+    {
+      LOG_ERROR("No tracking data datagrams were received by the client.");
+      exit(EXIT_FAILURE);
+    }
+    double lossPercent = 100.0 * lostDatagrams / (receivedDatagrams + lostDatagrams);
+    if (lossPercent > maxDatagramLossPercent)
+    {
+      LOG_ERROR("Datagram loss (" << lossPercent << "%) exceeds the allowed maximum (" << maxDatagramLossPercent << "%).");
+      exit(EXIT_FAILURE);
+    }
+    for (DataSourceContainerConstIterator it = client->GetToolIteratorBegin(); it != client->GetToolIteratorEnd(); ++it)
+    {
+      if (it->second->GetNumberOfItems() == 0)
+      {
+        LOG_ERROR("No transforms were stored for tool " << it->second->GetId() << " from the received datagrams.");
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+
   client->Disconnect();
   LOG_INFO("Exit successfully");
   exit(EXIT_SUCCESS);
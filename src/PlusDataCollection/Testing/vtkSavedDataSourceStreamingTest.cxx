@@ -0,0 +1,539 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkSavedDataSourceStreamingTest.cxx
+  \brief Test streaming playback of sequence files by the saved data source
+
+  A sequence is generated, in which every pixel value encodes the index of the frame. The frame prefetcher is tested
+  directly (window size, wrap-around, playback range changes, frames that are kept by the caller while the window moves),
+  then the output of the saved data source with StreamingEnabled and a window that is smaller than the number of frames
+  is compared with the output of the non-streaming playback, with original and current timestamps, with a loop time range
+  and with a compressed file (that cannot be streamed, so the whole sequence has to be loaded instead).
+*/
+
+#include "PlusConfigure.h"
+#include "PlusSequenceFramePrefetcher.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusSavedDataSource.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkSmartPointer.h"
+#include "vtkXMLUtilities.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+  const unsigned int NUMBER_OF_FRAMES = 20;
+  const unsigned int FRAME_WIDTH = 16;
+  const unsigned int FRAME_HEIGHT = 12;
+  const unsigned int STREAMING_WINDOW_SIZE = 4;
+  const double FIRST_TIMESTAMP = 1.0;
+  const double FRAME_PERIOD_SEC = 0.1;
+  const double FRAME_TIMEOUT_SEC = 5.0;
+  const double REPLAY_TIMEOUT_SEC = 60.0;
+  const double TIMESTAMP_TOLERANCE_SEC = 1e-6;
+
+  //----------------------------------------------------------------------------
+  /*! Pixel (0,0) of each frame is the frame index, so the frame can be identified by its first pixel */
+  unsigned char GetExpectedPixelValue(unsigned int frameIndex, unsigned int x, unsigned int y)
+  {
+    return static_cast<unsigned char>(frameIndex + x * 3 + y * 7);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus WriteTestSequence(const std::string& filename, bool useCompression)
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    FrameSizeType frameSize = { FRAME_WIDTH, FRAME_HEIGHT, 1 };
+    for (unsigned int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+    {
+      igsioVideoFrame image;
+      image.AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1);
+      image.SetImageOrientation(US_IMG_ORIENT_MF);
+      image.SetImageType(US_IMG_BRIGHTNESS);
+      unsigned char* pixels = static_cast<unsigned char*>(image.GetScalarPointer());
+      for (unsigned int y = 0; y < FRAME_HEIGHT; ++y)
+      {
+        for (unsigned int x = 0; x < FRAME_WIDTH; ++x)
+        {
+          pixels[y * FRAME_WIDTH + x] = GetExpectedPixelValue(frameIndex, x, y);
+        }
+      }
+      igsioTrackedFrame trackedFrame;
+      trackedFrame.SetImageData(image);
+      trackedFrame.SetTimestamp(FIRST_TIMESTAMP + frameIndex * FRAME_PERIOD_SEC);
+      frameList->AddTrackedFrame(&trackedFrame);
+    }
+    if (vtkPlusSequenceIO::Write(filename, frameList, US_IMG_ORIENT_MF, useCompression) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write test sequence: " << filename);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Get the frame index from the image content. Returns false if the image content does not match any frame. */
+  bool GetFrameIndex(igsioVideoFrame& image, unsigned int& frameIndex)
+  {
+    FrameSizeType frameSize = { 0, 0, 0 };
+    image.GetFrameSize(frameSize);
+    if (frameSize[0] != FRAME_WIDTH || frameSize[1] != FRAME_HEIGHT || image.GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
+    {
+      LOG_ERROR("Unexpected frame size (" << frameSize[0] << "x" << frameSize[1] << ") or pixel type");
+      return false;
+    }
+    const unsigned char* pixels = static_cast<const unsigned char*>(image.GetScalarPointer());
+    frameIndex = pixels[0];
+    for (unsigned int y = 0; y < FRAME_HEIGHT; ++y)
+    {
+      for (unsigned int x = 0; x < FRAME_WIDTH; ++x)
+      {
+        if (pixels[y * FRAME_WIDTH + x] != GetExpectedPixelValue(frameIndex, x, y))
+        {
+          LOG_ERROR("Pixel (" << x << ", " << y << ") of frame " << frameIndex << " is " << static_cast<int>(pixels[y * FRAME_WIDTH + x])
+                    << ", expected " << static_cast<int>(GetExpectedPixelValue(frameIndex, x, y)));
+          return false;
+        }
+      }
+    }
+    return frameIndex < NUMBER_OF_FRAMES;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckPrefetchedFrame(PlusSequenceFramePrefetcher& prefetcher, const std::shared_ptr<igsioTrackedFrame>& frame, unsigned int expectedFrameIndex)
+  {
+    unsigned int frameIndex = 0;
+    if (!frame || !GetFrameIndex(*frame->GetImageData(), frameIndex))
+    {
+      LOG_ERROR("Frame " << expectedFrameIndex << " is not available or invalid");
+      return 1;
+    }
+    if (frameIndex != expectedFrameIndex)
+    {
+      LOG_ERROR("Content of frame " << expectedFrameIndex << " belongs to frame " << frameIndex);
+      return 1;
+    }
+    if (prefetcher.GetNumberOfFramesInMemory() > STREAMING_WINDOW_SIZE)
+    {
+      LOG_ERROR(prefetcher.GetNumberOfFramesInMemory() << " frames are in memory, window size is " << STREAMING_WINDOW_SIZE);
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestPrefetcher(const std::string& sequenceFile)
+  {
+    int numberOfErrors(0);
+    PlusSequenceFramePrefetcher prefetcher;
+    if (prefetcher.Open(sequenceFile, STREAMING_WINDOW_SIZE) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to open " << sequenceFile << " for streaming");
+      return 1;
+    }
+    if (prefetcher.GetNumberOfFrames() != NUMBER_OF_FRAMES)
+    {
+      LOG_ERROR("Number of frames is " << prefetcher.GetNumberOfFrames() << ", expected " << NUMBER_OF_FRAMES);
+      numberOfErrors++;
+    }
+    for (unsigned int frameIndex = 0; frameIndex < prefetcher.GetNumberOfFrames(); ++frameIndex)
+    {
+      if (fabs(prefetcher.GetTimestamp(frameIndex) - (FIRST_TIMESTAMP + frameIndex * FRAME_PERIOD_SEC)) > TIMESTAMP_TOLERANCE_SEC)
+      {
+        LOG_ERROR("Timestamp of frame " << frameIndex << " is " << prefetcher.GetTimestamp(frameIndex));
+        numberOfErrors++;
+      }
+    }
+
+    // Play the whole sequence more than twice, the window wraps around at the end of the sequence
+    prefetcher.SetPlaybackRange(0, NUMBER_OF_FRAMES - 1, true);
+    for (unsigned int playbackPosition = 0; playbackPosition < 2 * NUMBER_OF_FRAMES + STREAMING_WINDOW_SIZE; ++playbackPosition)
+    {
+      unsigned int frameIndex = playbackPosition % NUMBER_OF_FRAMES;
+      numberOfErrors += CheckPrefetchedFrame(prefetcher, prefetcher.GetFrame(frameIndex, FRAME_TIMEOUT_SEC), frameIndex);
+    }
+
+    // Repeat a sub-range of the sequence
+    const unsigned int firstFrameIndex = 5;
+    const unsigned int lastFrameIndex = 9;
+    prefetcher.SetPlaybackRange(firstFrameIndex, lastFrameIndex, true);
+    for (unsigned int playbackPosition = 0; playbackPosition < 3 * (lastFrameIndex - firstFrameIndex + 1); ++playbackPosition)
+    {
+      unsigned int frameIndex = firstFrameIndex + playbackPosition % (lastFrameIndex - firstFrameIndex + 1);
+      numberOfErrors += CheckPrefetchedFrame(prefetcher, prefetcher.GetFrame(frameIndex, FRAME_TIMEOUT_SEC), frameIndex);
+    }
+
+    // A frame that is kept by the caller remains valid when the playback range is changed and the frame is released by the prefetcher
+    std::shared_ptr<igsioTrackedFrame> keptFrame = prefetcher.GetFrame(7, FRAME_TIMEOUT_SEC);
+    prefetcher.SetPlaybackRange(12, NUMBER_OF_FRAMES - 1, false);
+    for (unsigned int frameIndex = 12; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+    {
+      numberOfErrors += CheckPrefetchedFrame(prefetcher, prefetcher.GetFrame(frameIndex, FRAME_TIMEOUT_SEC), frameIndex);
+    }
+    numberOfErrors += CheckPrefetchedFrame(prefetcher, keptFrame, 7);
+
+    LOG_INFO("Frame prefetcher window misses: " << prefetcher.GetNumberOfWindowMisses());
+    prefetcher.Close();
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  struct ReplayParameters
+  {
+    ReplayParameters()
+      : StreamingEnabled(false)
+      , ExpectStreamingPlayback(false)
+      , UseOriginalTimestamps(true)
+      , RepeatEnabled(false)
+      , LoopStartTime(0.0)
+      , LoopStopTime(0.0)
+      , NumberOfUpdates(0)
+    {
+    }
+    std::string SequenceFile;
+    bool StreamingEnabled;
+    /*! False if the sequence file cannot be streamed and the saved data source has to load the whole sequence instead */
+    bool ExpectStreamingPlayback;
+    /*! If true then the sequence is replayed using the virtual clock, otherwise by NumberOfUpdates explicit updates */
+    bool UseOriginalTimestamps;
+    bool RepeatEnabled;
+    /*! The loop time range is set if LoopStopTime > LoopStartTime */
+    double LoopStartTime;
+    double LoopStopTime;
+    int NumberOfUpdates;
+  };
+
+  //----------------------------------------------------------------------------
+  struct ReplayedFrames
+  {
+    std::vector<unsigned int> FrameIndices;
+    std::vector<double> Timestamps;
+  };
+
+  //----------------------------------------------------------------------------
+  std::string CreateDeviceSetConfiguration(const ReplayParameters& params)
+  {
+    std::ostringstream xml;
+    xml << "<PlusConfiguration version=\"2.1\">\n"
+        << "  <DataCollection StartupDelaySec=\"0.0\">\n"
+        << "    <DeviceSet Name=\"vtkSavedDataSourceStreamingTest\" Description=\"Saved data source replaying a generated sequence\" />\n"
+        << "    <Device Id=\"SavedDataDevice\" Type=\"SavedDataSource\" SequenceFile=\"" << params.SequenceFile << "\" UseData=\"IMAGE\" AcquisitionRate=\"10\""
+        << " RepeatEnabled=\"" << (params.RepeatEnabled ? "TRUE" : "FALSE") << "\""
+        << " UseOriginalTimestamps=\"" << (params.UseOriginalTimestamps ? "TRUE" : "FALSE") << "\""
+        << " StreamingEnabled=\"" << (params.StreamingEnabled ? "TRUE" : "FALSE") << "\""
+        << " StreamingWindowSize=\"" << STREAMING_WINDOW_SIZE << "\">\n"
+        << "      <DataSources>\n"
+        << "        <DataSource Type=\"Video\" Id=\"Video\" PortUsImageOrientation=\"MF\" BufferSize=\"200\" />\n"
+        << "      </DataSources>\n"
+        << "      <OutputChannels>\n"
+        << "        <OutputChannel Id=\"VideoStream\" VideoDataSourceId=\"Video\" />\n"
+        << "      </OutputChannels>\n"
+        << "    </Device>\n"
+        << "  </DataCollection>\n"
+        << "</PlusConfiguration>\n";
+    return xml.str();
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetReplayedFrames(vtkPlusDataSource* videoSource, ReplayedFrames& replayedFrames)
+  {
+    if (videoSource->GetNumberOfItems() == 0)
+    {
+      LOG_ERROR("No frames were replayed");
+      return PLUS_FAIL;
+    }
+    for (BufferItemUidType uid = videoSource->GetOldestItemUidInBuffer(); uid <= videoSource->GetLatestItemUidInBuffer(); ++uid)
+    {
+      StreamBufferItem bufferItem;
+      unsigned int frameIndex = 0;
+      if (videoSource->GetStreamBufferItem(uid, &bufferItem) != ITEM_OK || !GetFrameIndex(bufferItem.GetFrame(), frameIndex))
+      {
+        LOG_ERROR("Invalid replayed frame, UID=" << uid);
+        return PLUS_FAIL;
+      }
+      replayedFrames.FrameIndices.push_back(frameIndex);
+      replayedFrames.Timestamps.push_back(bufferItem.GetFilteredTimestamp(0.0));
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus Replay(const ReplayParameters& params, ReplayedFrames& replayedFrames)
+  {
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(CreateDeviceSetConfiguration(params).c_str()));
+    vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+    vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+    if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read data collector configuration");
+      return PLUS_FAIL;
+    }
+    vtkPlusDevice* device = NULL;
+    dataCollector->GetDevice(device, "SavedDataDevice");
+    vtkPlusSavedDataSource* savedDataSource = dynamic_cast<vtkPlusSavedDataSource*>(device);
+    if (savedDataSource == NULL)
+    {
+      LOG_ERROR("Saved data source device is not found");
+      return PLUS_FAIL;
+    }
+    if (params.UseOriginalTimestamps)
+    {
+      // Deterministic replay with the original timing
+      dataCollector->SetVirtualClockEnabled(true);
+    }
+    else
+    {
+      // One frame is added at each update
+      savedDataSource->SetExternalUpdateStepping(true);
+    }
+
+    if (dataCollector->Connect() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to connect to the saved data source");
+      return PLUS_FAIL;
+    }
+    PlusStatus status = PLUS_SUCCESS;
+    if (savedDataSource->IsStreamingPlayback() != params.ExpectStreamingPlayback)
+    {
+      LOG_ERROR("Streaming playback is " << (savedDataSource->IsStreamingPlayback() ? "enabled" : "disabled") << " for " << params.SequenceFile
+                << " (StreamingEnabled: " << (params.StreamingEnabled ? "TRUE" : "FALSE") << ")");
+      status = PLUS_FAIL;
+    }
+    if (params.LoopStopTime > params.LoopStartTime)
+    {
+      savedDataSource->SetLoopTimeRange(params.LoopStartTime, params.LoopStopTime);
+    }
+    if (dataCollector->Start() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to start data collection");
+      dataCollector->Disconnect();
+      return PLUS_FAIL;
+    }
+
+    if (params.UseOriginalTimestamps)
+    {
+      const double timeoutTime = vtkIGSIOAccurateTimer::GetSystemTime() + REPLAY_TIMEOUT_SEC;
+      while (!dataCollector->IsVirtualClockReplayCompleted() && vtkIGSIOAccurateTimer::GetSystemTime() < timeoutTime)
+      {
+        vtkIGSIOAccurateTimer::Delay(0.01);
+      }
+      if (!dataCollector->IsVirtualClockReplayCompleted())
+      {
+        LOG_ERROR("Replay was not completed in " << REPLAY_TIMEOUT_SEC << " sec");
+        status = PLUS_FAIL;
+      }
+    }
+    else
+    {
+      for (int update = 0; update < params.NumberOfUpdates; ++update)
+      {
+        if (savedDataSource->ForceUpdate() != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to update the saved data source");
+          status = PLUS_FAIL;
+        }
+        // Frames are added with the current time, make sure that the timestamps are different
+        vtkIGSIOAccurateTimer::Delay(0.002);
+      }
+    }
+
+    vtkPlusDataSource* videoSource = NULL;
+    if (savedDataSource->GetFirstVideoSource(videoSource) != PLUS_SUCCESS || GetReplayedFrames(videoSource, replayedFrames) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+
+    dataCollector->Stop();
+    dataCollector->Disconnect();
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Replay the sequence without and with streaming and compare the output. The output of the non-streaming replay is returned in replayedFrames. */
+  int CompareStreamingReplay(const std::string& description, ReplayParameters params, const std::string& streamedSequenceFile, bool expectStreamingPlayback, ReplayedFrames& replayedFrames)
+  {
+    params.StreamingEnabled = false;
+    params.ExpectStreamingPlayback = false;
+    if (Replay(params, replayedFrames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(description << ": replay failed without streaming");
+      return 1;
+    }
+    params.SequenceFile = streamedSequenceFile;
+    params.StreamingEnabled = true;
+    params.ExpectStreamingPlayback = expectStreamingPlayback;
+    ReplayedFrames streamedFrames;
+    if (Replay(params, streamedFrames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(description << ": replay failed with streaming");
+      return 1;
+    }
+
+    if (streamedFrames.FrameIndices != replayedFrames.FrameIndices)
+    {
+      LOG_ERROR(description << ": streamed frames are different from the frames replayed without streaming ("
+                << streamedFrames.FrameIndices.size() << " and " << replayedFrames.FrameIndices.size() << " frames)");
+      return 1;
+    }
+    if (params.UseOriginalTimestamps)
+    {
+      for (unsigned int i = 0; i < replayedFrames.Timestamps.size(); ++i)
+      {
+        if (fabs(streamedFrames.Timestamps[i] - replayedFrames.Timestamps[i]) > TIMESTAMP_TOLERANCE_SEC)
+        {
+          LOG_ERROR(description << ": timestamp of streamed frame " << i << " is " << streamedFrames.Timestamps[i]
+                    << ", expected " << replayedFrames.Timestamps[i]);
+          return 1;
+        }
+      }
+    }
+    LOG_INFO(description << ": " << replayedFrames.FrameIndices.size() << " frames are replayed identically with streaming");
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Check that the frames follow each other in playback order in the specified range */
+  int CheckPlaybackOrder(const std::string& description, const ReplayedFrames& replayedFrames, unsigned int firstFrameIndex, unsigned int lastFrameIndex, unsigned int expectedNumberOfFrames)
+  {
+    if (replayedFrames.FrameIndices.size() != expectedNumberOfFrames)
+    {
+      LOG_ERROR(description << ": " << replayedFrames.FrameIndices.size() << " frames are replayed, expected " << expectedNumberOfFrames);
+      return 1;
+    }
+    for (unsigned int i = 0; i < replayedFrames.FrameIndices.size(); ++i)
+    {
+      unsigned int expectedFrameIndex = firstFrameIndex + i % (lastFrameIndex - firstFrameIndex + 1);
+      if (replayedFrames.FrameIndices[i] != expectedFrameIndex)
+      {
+        LOG_ERROR(description << ": replayed frame " << i << " is frame " << replayedFrames.FrameIndices[i] << ", expected " << expectedFrameIndex);
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestSavedDataSource(const std::string& sequenceFile, const std::string& compressedSequenceFile)
+  {
+    int numberOfErrors(0);
+
+    // Original timestamps, whole sequence
+    ReplayParameters params;
+    params.SequenceFile = sequenceFile;
+    params.UseOriginalTimestamps = true;
+    ReplayedFrames replayedFrames;
+    int errors = CompareStreamingReplay("Original timestamps", params, sequenceFile, true, replayedFrames);
+    if (errors == 0)
+    {
+      errors += CheckPlaybackOrder("Original timestamps", replayedFrames, 0, NUMBER_OF_FRAMES - 1, NUMBER_OF_FRAMES);
+    }
+    numberOfErrors += errors;
+
+    // Original timestamps, loop time range
+    const unsigned int loopFirstFrameIndex = 5;
+    const unsigned int loopLastFrameIndex = 12;
+    params.LoopStartTime = FIRST_TIMESTAMP + loopFirstFrameIndex * FRAME_PERIOD_SEC;
+    params.LoopStopTime = FIRST_TIMESTAMP + loopLastFrameIndex * FRAME_PERIOD_SEC;
+    replayedFrames = ReplayedFrames();
+    errors = CompareStreamingReplay("Loop time range", params, sequenceFile, true, replayedFrames);
+    if (errors == 0 && (replayedFrames.FrameIndices.front() != loopFirstFrameIndex || replayedFrames.FrameIndices.back() > loopLastFrameIndex))
+    {
+      LOG_ERROR("Loop time range: frames " << replayedFrames.FrameIndices.front() << "-" << replayedFrames.FrameIndices.back()
+                << " are replayed, expected frames " << loopFirstFrameIndex << "-" << loopLastFrameIndex);
+      errors++;
+    }
+    numberOfErrors += errors;
+
+    // Current timestamps, the sequence is repeated, so the window wraps around
+    params = ReplayParameters();
+    params.SequenceFile = sequenceFile;
+    params.UseOriginalTimestamps = false;
+    params.RepeatEnabled = true;
+    params.NumberOfUpdates = 2 * NUMBER_OF_FRAMES + NUMBER_OF_FRAMES / 2;
+    replayedFrames = ReplayedFrames();
+    errors = CompareStreamingReplay("Current timestamps with repeat", params, sequenceFile, true, replayedFrames);
+    if (errors == 0)
+    {
+      errors += CheckPlaybackOrder("Current timestamps with repeat", replayedFrames, 0, NUMBER_OF_FRAMES - 1, params.NumberOfUpdates);
+    }
+    numberOfErrors += errors;
+
+    // Current timestamps, a sub-range of the sequence is repeated
+    params.LoopStartTime = FIRST_TIMESTAMP + loopFirstFrameIndex * FRAME_PERIOD_SEC;
+    params.LoopStopTime = FIRST_TIMESTAMP + loopLastFrameIndex * FRAME_PERIOD_SEC;
+    replayedFrames = ReplayedFrames();
+    errors = CompareStreamingReplay("Current timestamps with repeated loop time range", params, sequenceFile, true, replayedFrames);
+    if (errors == 0)
+    {
+      errors += CheckPlaybackOrder("Current timestamps with repeated loop time range", replayedFrames, loopFirstFrameIndex, loopLastFrameIndex, params.NumberOfUpdates);
+    }
+    numberOfErrors += errors;
+
+    // Compressed sequence files cannot be streamed, the whole sequence is loaded instead and the output is the same
+    params = ReplayParameters();
+    params.SequenceFile = sequenceFile;
+    params.UseOriginalTimestamps = true;
+    replayedFrames = ReplayedFrames();
+    numberOfErrors += CompareStreamingReplay("Fallback to loading the whole sequence", params, compressedSequenceFile, false, replayedFrames);
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  std::string sequenceFile = vtkPlusConfig::GetInstance()->GetOutputPath("vtkSavedDataSourceStreamingTest.igs.mha");
+  std::string compressedSequenceFile = vtkPlusConfig::GetInstance()->GetOutputPath("vtkSavedDataSourceStreamingTestCompressed.igs.mha");
+  if (WriteTestSequence(sequenceFile, false) != PLUS_SUCCESS || WriteTestSequence(compressedSequenceFile, true) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors(0);
+  numberOfErrors += TestPrefetcher(sequenceFile);
+  numberOfErrors += TestSavedDataSource(sequenceFile, compressedSequenceFile);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkVirtualCaptureCompressionTest.cxx
+  \brief Test the recording of compressed MetaImage sequence files by the virtual capture device
+
+  Frames are recorded uncompressed and the file is compressed when it is closed. If the result file name is requested
+  then the compression has to be completed when CloseFile returns: the file header has to describe chunk compressed
+  pixel data, no temporary file may be left behind, and the frames read back from the file have to match the recorded
+  frames. Both attached (.mha) and detached (.mhd) pixel data are tested.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusVirtualCapture.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkSmartPointer.h"
+#include "vtksys/CommandLineArguments.hxx"
+#include "vtksys/SystemTools.hxx"
+
+// STL includes
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+  const unsigned int FRAME_WIDTH = 64;
+  const unsigned int FRAME_HEIGHT = 48;
+  const int NUMBER_OF_FRAMES = 5;
+
+  //----------------------------------------------------------------------------
+  std::vector<unsigned char> CreateFramePixels(int frameIndex)
+  {
+    std::vector<unsigned char> pixels(FRAME_WIDTH * FRAME_HEIGHT);
+    for (unsigned int y = 0; y < FRAME_HEIGHT; ++y)
+    {
+      for (unsigned int x = 0; x < FRAME_WIDTH; ++x)
+      {
+        pixels[y * FRAME_WIDTH + x] = static_cast<unsigned char>(x + 3 * y + 40 * frameIndex);
+      }
+    }
+    return pixels;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns true if the MetaImage header specifies pixel data that is compressed in chunks */
+  bool IsChunkCompressedMetaImageHeader(const std::string& filename)
+  {
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    bool compressedData = false;
+    bool chunkStreamSizesFound = false;
+    std::string line;
+    while (std::getline(file, line))
+    {
+      if (line.find("CompressedData = True") == 0)
+      {
+        compressedData = true;
+      }
+      else if (line.find("CompressedDataChunkStreamSizes = ") == 0)
+      {
+        chunkStreamSizesFound = true;
+      }
+      else if (line.find("ElementDataFile") == 0)
+      {
+        // This is always the last field of the header
+        break;
+      }
+    }
+    return compressedData && chunkStreamSizesFound;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestCompressedRecording(const std::string& filename)
+  {
+    vtkSmartPointer<vtkPlusDataSource> videoSource = vtkSmartPointer<vtkPlusDataSource>::New();
+    videoSource->SetId("Video");
+    videoSource->SetInputImageOrientation(US_IMG_ORIENT_MF);
+    videoSource->SetImageType(US_IMG_BRIGHTNESS);
+    videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+    videoSource->SetNumberOfScalarComponents(1);
+    videoSource->SetInputFrameSize(FRAME_WIDTH, FRAME_HEIGHT, 1);
+
+    vtkSmartPointer<vtkPlusChannel> channel = vtkSmartPointer<vtkPlusChannel>::New();
+    channel->SetChannelId("VideoStream");
+    channel->SetVideoSource(videoSource);
+
+    vtkSmartPointer<vtkPlusVirtualCapture> capture = vtkSmartPointer<vtkPlusVirtualCapture>::New();
+    capture->SetDeviceId("CaptureDevice");
+    capture->AddInputChannel(channel);
+    if (capture->NotifyConfigured() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to configure the capture device");
+      return 1;
+    }
+    capture->SetEnableFileCompression(true);
+    if (capture->OpenFile(filename.c_str()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to open " << filename << " for recording");
+      return 1;
+    }
+
+    // Record each frame as a snapshot, right after it is added to the video buffer
+    const FrameSizeType frameSize = { FRAME_WIDTH, FRAME_HEIGHT, 1 };
+    for (int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+    {
+      std::vector<unsigned char> pixels = CreateFramePixels(frameIndex);
+      const double timestamp = 1.0 + 0.1 * frameIndex;
+      if (videoSource->AddItem(&pixels[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameIndex, timestamp, timestamp) != PLUS_SUCCESS
+          || capture->TakeSnapshot() != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to record frame " << frameIndex << " into " << filename);
+        return 1;
+      }
+    }
+
+    std::string resultFilename;
+    if (capture->CloseFile(NULL, &resultFilename) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to close and compress " << filename);
+      return 1;
+    }
+
+    // The file is not modified anymore when CloseFile returns
+    int numberOfErrors(0);
+    if (!IsChunkCompressedMetaImageHeader(resultFilename))
+    {
+      LOG_ERROR("Pixel data is not compressed in " << resultFilename);
+      numberOfErrors++;
+    }
+    if (vtksys::SystemTools::FileExists(resultFilename + ".tmp") || vtksys::SystemTools::FileExists(resultFilename + ".compressed.tmp"))
+    {
+      LOG_ERROR("Temporary file of the compression is left behind for " << resultFilename);
+      numberOfErrors++;
+    }
+
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (vtkPlusSequenceIO::Read(resultFilename, frames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read the recorded file " << resultFilename);
+      return numberOfErrors + 1;
+    }
+    if (frames->GetNumberOfTrackedFrames() != NUMBER_OF_FRAMES)
+    {
+      LOG_ERROR(resultFilename << " contains " << frames->GetNumberOfTrackedFrames() << " frames, expected " << NUMBER_OF_FRAMES);
+      return numberOfErrors + 1;
+    }
+    for (int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+    {
+      igsioVideoFrame* image = frames->GetTrackedFrame(frameIndex)->GetImageData();
+      std::vector<unsigned char> expectedPixels = CreateFramePixels(frameIndex);
+      if (!image->IsImageValid() || image->GetFrameSizeInBytes() != expectedPixels.size()
+          || memcmp(image->GetScalarPointer(), &expectedPixels[0], expectedPixels.size()) != 0)
+      {
+        LOG_ERROR("Pixel data of frame " << frameIndex << " in " << resultFilename << " does not match the recorded frame");
+        numberOfErrors++;
+      }
+    }
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  numberOfErrors += TestCompressedRecording("VirtualCaptureCompressionTest.igs.mha");
+  numberOfErrors += TestCompressedRecording("VirtualCaptureCompressionTest.igs.mhd");
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
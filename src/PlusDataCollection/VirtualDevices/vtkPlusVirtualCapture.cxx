@@ -5,16 +5,23 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusClock.h"
+#include "PlusMetrics.h"
 #include "igsioTrackedFrame.h"
 #include "vtkIGSIOMetaImageSequenceIO.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
+#include "vtkPlusSequenceIO.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkPlusVirtualCapture.h"
 #include "vtksys/SystemTools.hxx"
 
+// STL includes
+#include <algorithm>
+#include <chrono>
+
 #ifdef PLUS_USE_VTKVIDEOIO_MKV
 //  #include "vtkPlusMkvSequenceIO.h"
 #endif
@@ -72,6 +79,7 @@ vtkPlusVirtualCapture::~vtkPlusVirtualCapture()
   {
     this->CloseFile();
   }
+  this->WaitForFileCompression();
 
   if (RecordedFrames != NULL)
   {
@@ -139,7 +147,7 @@ PlusStatus vtkPlusVirtualCapture::InternalConnect()
     this->SetEnableCapturing(true);
   }
 
-  this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->LastUpdateTime = PlusClock::GetTime();
 
   return PLUS_SUCCESS;
 }
@@ -185,23 +193,11 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
       // default to nrrd
       ext = ".nrrd";
     }
-    else if (vtkIGSIOMetaImageSequenceIO::CanWriteFile(this->BaseFilename) && this->GetEnableFileCompression())
-    {
-      // they've requested mhd/mha with compression, no can do, yet
-      LOG_WARNING("Compressed saving of metaimage file requested. This is not supported. Reverting to uncompressed metaimage file.");
-      this->SetEnableFileCompression(false);
-    }
     this->CurrentFilename = filenameRoot + "_" + vtksys::SystemTools::GetCurrentDateTime("%Y%m%d_%H%M%S") + ext;
     aFilename = this->CurrentFilename.c_str();
   }
   else
   {
-    if (vtkIGSIOMetaImageSequenceIO::CanWriteFile(aFilename) && this->GetEnableFileCompression())
-    {
-      // they've requested mhd/mha with compression, no can do, yet
-      LOG_WARNING("Compressed saving of metaimage file requested. This is not supported. Reverting to uncompressed metaimage file.");
-      this->SetEnableFileCompression(false);
-    }
     this->CurrentFilename = aFilename;
   }
 
@@ -211,7 +207,7 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
     LOG_ERROR("Could not create writer for file: " << aFilename);
     return PLUS_FAIL;
   }
-  this->Writer->SetUseCompression(this->EnableFileCompression);
+  this->Writer->SetUseCompression(this->EnableFileCompression && !this->IsFileCompressedOnClose(aFilename));
   this->Writer->SetTrackedFrameList(this->RecordedFrames);
   // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
   this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
@@ -256,6 +252,40 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
 
   this->Writer->Close();
 
+  PlusStatus compressionStatus = PLUS_SUCCESS;
+  if (this->IsFileCompressedOnClose(this->Writer->GetFileName()))
+  {
+    std::string recordedFilename = this->Writer->GetFileName();
+    if (resultFilename != NULL)
+    {
+      // The caller uses the file right away (e.g., the file name is returned in a command reply),
+      // so the file must not be rewritten after this method returns
+      if (vtkPlusSequenceIO::CompressSequenceFile(recordedFilename) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to compress recorded sequence file: " << recordedFilename);
+        compressionStatus = PLUS_FAIL;
+      }
+    }
+    else
+    {
+      // Compressing a long recording takes a while, do not block the thread that closes the file (e.g., the recording thread)
+      this->FileCompressionTasks.push_back(std::async(std::launch::async, [recordedFilename]()
+      {
+        if (vtkPlusSequenceIO::CompressSequenceFile(recordedFilename) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to compress recorded sequence file: " << recordedFilename);
+          return PLUS_FAIL;
+        }
+        return PLUS_SUCCESS;
+      }));
+    }
+  }
+  // Forget the compression tasks that are already completed
+  this->FileCompressionTasks.erase(std::remove_if(this->FileCompressionTasks.begin(), this->FileCompressionTasks.end(), [](const std::future<PlusStatus>& task)
+  {
+    return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }), this->FileCompressionTasks.end());
+
   std::string fullPath = vtkPlusConfig::GetInstance()->GetOutputPath(this->CurrentFilename);
   std::string path = vtksys::SystemTools::GetFilenamePath(fullPath);
   std::string filename = vtksys::SystemTools::GetFilenameWithoutExtension(fullPath);
@@ -271,7 +301,23 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
     return PLUS_FAIL;
   }
 
-  return PLUS_SUCCESS;
+  return compressionStatus;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::WaitForFileCompression()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+  PlusStatus status = PLUS_SUCCESS;
+  for (std::vector<std::future<PlusStatus> >::iterator taskIt = this->FileCompressionTasks.begin(); taskIt != this->FileCompressionTasks.end(); ++taskIt)
+  {
+    if (taskIt->get() != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+  this->FileCompressionTasks.clear();
+  return status;
 }
 
 //----------------------------------------------------------------------------
@@ -296,13 +342,13 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
 
   if (this->LastUpdateTime == 0.0)
   {
-    this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->LastUpdateTime = PlusClock::GetTime();
   }
   if (this->NextFrameToBeRecordedTimestamp == 0.0)
   {
-    this->NextFrameToBeRecordedTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->NextFrameToBeRecordedTimestamp = PlusClock::GetTime();
   }
-  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  double startTimeSec = PlusClock::GetTime();
 
   this->TimeWaited += startTimeSec - LastUpdateTime;
 
@@ -315,6 +361,11 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
   this->TimeWaited = 0.0;
 
   double maxProcessingTimeSec = samplingPeriodSec * 2.0; // put a hard limit on the max processing time to make sure the application remains responsive during recording
+  if (PlusClock::IsVirtualClockEnabled())
+  {
+    // Replay is stepped by the data collector, the recorded frames must not depend on the processing speed
+    maxProcessingTimeSec = -1;
+  }
   double requestedFramePeriodSec = 0.1;
   if (this->RequestedFrameRate > 0)
   {
@@ -385,9 +436,9 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
   }
 
   // Check whether the recording needed more time than the sampling interval
-  double recordingTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
-  double currentSystemTime = vtkIGSIOAccurateTimer::GetSystemTime();
-  double recordingLagSec =  currentSystemTime - this->NextFrameToBeRecordedTimestamp;
+  double recordingTimeSec = PlusClock::GetTime() - startTimeSec;
+  double currentTime = PlusClock::GetTime();
+  double recordingLagSec =  currentTime - this->NextFrameToBeRecordedTimestamp;
 
   if (recordingTimeSec > samplingPeriodSec)
   {
@@ -402,7 +453,7 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
     double latestInputTimestamp = this->NextFrameToBeRecordedTimestamp;
     if (GetLatestInputItemTimestamp(latestInputTimestamp) == PLUS_SUCCESS)
     {
-      acquisitionLagSec = currentSystemTime - latestInputTimestamp;
+      acquisitionLagSec = currentTime - latestInputTimestamp;
     }
     if (acquisitionLagSec < MAX_ALLOWED_RECORDING_LAG_SEC)
     {
@@ -410,10 +461,10 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
       // (because acquisitionLagSec < MAX_ALLOWED_RECORDING_LAG_SEC)
       LOG_ERROR("Recording cannot keep up with the acquisition. Skip " << recordingLagSec << " seconds of the data stream to catch up.");
     }
-    this->NextFrameToBeRecordedTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->NextFrameToBeRecordedTimestamp = PlusClock::GetTime();
   }
 
-  this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->LastUpdateTime = PlusClock::GetTime();
 
   return PLUS_SUCCESS;
 }
@@ -470,12 +521,27 @@ void vtkPlusVirtualCapture::InternalWriteOutputChannels(vtkXMLDataElement* rootX
 //----------------------------------------------------------------------------
 void vtkPlusVirtualCapture::SetEnableFileCompression(bool aFileCompression)
 {
+  this->EnableFileCompression = aFileCompression;
+
   if (this->Writer != NULL)
   {
-    this->Writer->SetUseCompression(aFileCompression);
+    this->Writer->SetUseCompression(aFileCompression && !this->IsFileCompressedOnClose(this->CurrentFilename));
   }
+}
 
-  this->EnableFileCompression = aFileCompression;
+//----------------------------------------------------------------------------
+bool vtkPlusVirtualCapture::IsFileCompressedOnClose(const std::string& filename) const
+{
+  if (!this->EnableFileCompression)
+  {
+    return false;
+  }
+  if (vtkIGSIOMetaImageSequenceIO::CanWriteFile(filename))
+  {
+    // MetaImage writer cannot compress the frames while recording
+    return true;
+  }
+  return vtkPlusSequenceIO::GetParallelCompressionEnabled() && vtkPlusSequenceIO::CanCompressSequenceFile(filename);
 }
 
 //-----------------------------------------------------------------------------
@@ -490,7 +556,7 @@ void vtkPlusVirtualCapture::SetEnableCapturing(bool aValue)
     this->LastAlreadyRecordedFrameTimestamp = UNDEFINED_TIMESTAMP;
     this->NextFrameToBeRecordedTimestamp = 0.0;
     this->FirstFrameIndexInThisSegment = this->RecordedFrames->GetNumberOfTrackedFrames();
-    this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime(); // reset the starting time for the grace period
+    this->RecordingStartTime = PlusClock::GetTime(); // reset the starting time for the grace period
   }
 }
 
@@ -519,7 +585,7 @@ PlusStatus vtkPlusVirtualCapture::Reset()
     return PLUS_FAIL;
   }
 
-  this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->LastUpdateTime = PlusClock::GetTime();
 
   return PLUS_SUCCESS;
 }
@@ -625,6 +691,8 @@ PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
   if (force || !this->IsFrameBuffered() ||
       (this->IsFrameBuffered() && this->RecordedFrames->GetNumberOfTrackedFrames() > this->GetFrameBufferSize()))
   {
+    PLUS_METRIC_SCOPED_TIMER("plus_capture_write_frames_seconds", PlusMetricsRegistry::MakeLabel("device", this->GetDeviceId()));
+    PLUS_METRIC_COUNTER_ADD("plus_capture_written_frames_total", PlusMetricsRegistry::MakeLabel("device", this->GetDeviceId()), this->RecordedFrames->GetNumberOfTrackedFrames());
     if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to append image data to header.");
@@ -10,7 +10,9 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusDevice.h"
 #include "vtkIGSIOSequenceIOBase.h"
+#include <future>
 #include <string>
+#include <vector>
 
 //class vtkIGSIOTrackedFrameList;
 
@@ -46,9 +48,17 @@ public:
     Close the output file.
     resultFilename contains the full path of the actual written file name. It may be different than the requested name
     if the requested name was not valid (for example wrong extension).
+    If resultFilename is requested then a file that is compressed on close is compressed before this method returns and
+    a compression failure is returned, otherwise the file is compressed in the background (see WaitForFileCompression).
   */
   virtual PlusStatus CloseFile(const char* aFilename = NULL, std::string* resultFilename = NULL);
 
+  /*!
+    Wait until the background compression of the closed files is completed.
+    Returns PLUS_FAIL if any of the files could not be compressed.
+  */
+  PlusStatus WaitForFileCompression();
+
   virtual PlusStatus Reset();
 
   virtual PlusStatus TakeSnapshot();
@@ -155,6 +165,15 @@ protected:
   /*! Sequence writer to write to */
   vtkIGSIOSequenceIOBase* Writer;
 
+  /*!
+    Returns true if the file is recorded uncompressed and compressed by vtkPlusSequenceIO::CompressSequenceFile when it is closed.
+    This is the case if file compression is enabled, for MetaImage files and, if parallel compression is enabled, for NRRD files.
+  */
+  bool IsFileCompressedOnClose(const std::string& filename) const;
+
+  /*! Compression of the closed files that is running in the background */
+  std::vector<std::future<PlusStatus> > FileCompressionTasks;
+
   /*! When closing the file, re-read the data from file, and write it compressed */
   bool EnableFileCompression;
 
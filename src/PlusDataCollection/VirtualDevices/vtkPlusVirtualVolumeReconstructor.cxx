@@ -5,6 +5,7 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusClock.h"
 #include "igsioTrackedFrame.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlusChannel.h"
@@ -107,7 +108,7 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalConnect()
     LOG_WARNING("vtkPlusVirtualVolumeReconstructor acquisition rate is not known");
   }
 
-  m_LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  m_LastUpdateTime = PlusClock::GetTime();
 
   return PLUS_SUCCESS;
 }
@@ -130,13 +131,13 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
 
   if (m_LastUpdateTime == 0.0)
   {
-    m_LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    m_LastUpdateTime = PlusClock::GetTime();
   }
   if (m_NextFrameToBeRecordedTimestamp == 0.0)
   {
-    m_NextFrameToBeRecordedTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    m_NextFrameToBeRecordedTimestamp = PlusClock::GetTime();
   }
-  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  double startTimeSec = PlusClock::GetTime();
 
   m_TimeWaited += startTimeSec - m_LastUpdateTime;
 
@@ -149,6 +150,11 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
   m_TimeWaited = 0.0;
 
   double maxProcessingTimeSec = GetSamplingPeriodSec() * 2.0; // put a hard limit on the max processing time to make sure the application remains responsive during reconstruction
+  if (PlusClock::IsVirtualClockEnabled())
+  {
+    // Replay is stepped by the data collector, the reconstructed frames must not depend on the processing speed
+    maxProcessingTimeSec = -1;
+  }
   double requestedFramePeriodSec = 0.1;
   double requestedFrameRate = this->RequestedFrameRate;
   if (requestedFrameRate <= 0)
@@ -195,20 +201,20 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
   this->TotalFramesRecorded += nbFramesRecorded;
 
   // Check whether the reconstruction needed more time than the sampling interval
-  double recordingTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+  double recordingTimeSec = PlusClock::GetTime() - startTimeSec;
   if (recordingTimeSec > GetSamplingPeriodSec())
   {
     LOG_WARNING("Volume reconstruction of the acquired " << nbFramesRecorded << " frames takes too long time (" << recordingTimeSec << "sec instead of the allocated " << GetSamplingPeriodSec() << "sec). This can cause slow-down of the application and non-uniform sampling. Reduce the image acquisition rate, output size, or image clip rectangle size to resolve the problem.");
   }
-  double recordingLagSec = vtkIGSIOAccurateTimer::GetSystemTime() - m_NextFrameToBeRecordedTimestamp;
+  double recordingLagSec = PlusClock::GetTime() - m_NextFrameToBeRecordedTimestamp;
 
   if (recordingLagSec > MAX_ALLOWED_RECONSTRUCTION_LAG_SEC)
   {
     LOG_ERROR("Volume reconstruction cannot keep up with the acquisition. Skip " << recordingLagSec << " seconds of the data stream to catch up.");
-    m_NextFrameToBeRecordedTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    m_NextFrameToBeRecordedTimestamp = PlusClock::GetTime();
   }
 
-  m_LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  m_LastUpdateTime = PlusClock::GetTime();
 
   return PLUS_SUCCESS;
 }
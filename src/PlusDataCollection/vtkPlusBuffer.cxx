@@ -6,6 +6,9 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusClock.h"
+#include "PlusFramePool.h"
+#include "PlusMetrics.h"
 #include "igsioMath.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusBuffer.h"
@@ -20,6 +23,7 @@ See License.txt for details.
 #include <vtkMath.h>
 #include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
 #include <vtkUnsignedLongLongArray.h>
 
 // vtkAddon includes
@@ -30,6 +34,28 @@ static const double ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG = 10; // if the in
 
 vtkStandardNewMacro(vtkPlusBuffer);
 
+const char* vtkPlusBuffer::HARDWARE_TIMESTAMP_FIELD_NAME = "HardwareTimestamp";
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Returns UNDEFINED_TIMESTAMP if the device did not provide a hardware timestamp
+  double GetHardwareTimestamp(const igsioFieldMapType* customFields)
+  {
+    if (customFields == NULL)
+    {
+      return UNDEFINED_TIMESTAMP;
+    }
+    igsioFieldMapType::const_iterator fieldIt = customFields->find(vtkPlusBuffer::HARDWARE_TIMESTAMP_FIELD_NAME);
+    double hardwareTimestamp = UNDEFINED_TIMESTAMP;
+    if (fieldIt == customFields->end() || igsioCommon::StringToNumber<double>(fieldIt->second.second, hardwareTimestamp) != PLUS_SUCCESS)
+    {
+      return UNDEFINED_TIMESTAMP;
+    }
+    return hardwareTimestamp;
+  }
+}
+
 #define LOCAL_LOG_ERROR(msg) \
 { \
   std::ostringstream msgStream; \
@@ -84,6 +110,7 @@ vtkPlusBuffer::vtkPlusBuffer()
   , StreamBuffer(vtkPlusTimestampedCircularBuffer::New())
   , MaxAllowedTimeDifference(0.5)
   , DescriptiveName(NULL)
+  , FrameAllocationFailureReported(false)
 {
   this->FrameSize[0] = 0;
   this->FrameSize[1] = 0;
@@ -115,6 +142,7 @@ void vtkPlusBuffer::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Scalar pixel type: " << vtkImageScalarTypeNameMacro(this->GetPixelType()) << std::endl;
   os << indent << "Image type: " << igsioCommon::GetStringFromUsImageType(this->GetImageType()) << std::endl;
   os << indent << "Image orientation: " << igsioCommon::GetStringFromUsImageOrientation(this->GetImageOrientation()) << std::endl;
+  os << indent << "Allocated frame memory (bytes): " << PlusFramePool::GetInstance()->GetAllocatedBytes(this) << std::endl;
 
   os << indent << "StreamBuffer: " << this->StreamBuffer << "\n";
   if (this->StreamBuffer)
@@ -126,21 +154,77 @@ void vtkPlusBuffer::PrintSelf(ostream& os, vtkIndent indent)
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::AllocateMemoryForFrames()
 {
+  // Memory is not allocated for the frames here, but from the frame pool when a frame is first written into a slot
+  // (see AllocateFrameForNextItem). Only release the memory of slots that do not match the current frame format.
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
-  PlusStatus result = PLUS_SUCCESS;
 
   for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
   {
-    if (!this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame().IsFrameEncoded())
+    igsioVideoFrame& frame = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame();
+    if (!frame.IsFrameEncoded() && frame.GetImage() != NULL && !this->IsFrameAllocated(frame))
     {
-      if (this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame().AllocateFrame(this->GetFrameSize(), this->GetPixelType(), this->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
-      {
-        LOCAL_LOG_ERROR("Failed to allocate memory for frame " << i);
-        result = PLUS_FAIL;
-      }
+      frame.GetImage()->Initialize();
     }
   }
-  return result;
+  this->FrameAllocationFailureReported = false;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusBuffer::IsFrameAllocated(igsioVideoFrame& frame)
+{
+  vtkImageData* image = frame.GetImage();
+  if (image == NULL || image->GetPointData()->GetScalars() == NULL)
+  {
+    return false;
+  }
+  int* dimensions = image->GetDimensions();
+  return static_cast<unsigned int>(dimensions[0]) == this->FrameSize[0]
+         && static_cast<unsigned int>(dimensions[1]) == this->FrameSize[1]
+         && static_cast<unsigned int>(dimensions[2]) == this->FrameSize[2]
+         && image->GetScalarType() == this->PixelType
+         && static_cast<unsigned int>(image->GetNumberOfScalarComponents()) == this->NumberOfScalarComponents;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::AllocateFrameForNextItem()
+{
+  // the caller must have locked the buffer
+  // Memory is allocated before the item is added, so that the buffer does not contain an item without image data if the allocation fails
+  StreamBufferItem* item = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(this->StreamBuffer->GetNextWriteBufferIndex());
+  if (item == NULL)
+  {
+    // empty buffer, adding the item will fail anyway
+    return PLUS_SUCCESS;
+  }
+  igsioVideoFrame& frame = item->GetFrame();
+  if (this->IsFrameAllocated(frame))
+  {
+    return PLUS_SUCCESS;
+  }
+  if (this->FrameSize[0] == 0 || this->FrameSize[1] == 0 || this->FrameSize[2] == 0)
+  {
+    // no image data is stored in this buffer
+    return PLUS_SUCCESS;
+  }
+  if (frame.GetImage() == NULL)
+  {
+    // no image object to store the pixel data in, let the frame allocate it
+    return frame.AllocateFrame(this->FrameSize, this->PixelType, this->NumberOfScalarComponents);
+  }
+
+  std::string ownerName = (this->DescriptiveName != NULL ? this->DescriptiveName : "vtkPlusBuffer");
+  if (PlusFramePool::GetInstance()->AllocateImage(frame.GetImage(), this->FrameSize, this->PixelType, this->NumberOfScalarComponents, this, ownerName) != PLUS_SUCCESS)
+  {
+    if (!this->FrameAllocationFailureReported)
+    {
+      // Report only once, as it would be repeated for every frame until memory is released
+      LOCAL_LOG_ERROR("Failed to allocate memory for a new frame, frame memory budget is exceeded. Frames are not recorded in this buffer until memory becomes available.");
+      this->FrameAllocationFailureReported = true;
+    }
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
@@ -323,6 +407,7 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
                                   double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
                                   double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/)
 {
+  PLUS_METRIC_SCOPED_TIMER("plus_buffer_add_fields_item_seconds", PlusMetricsRegistry::MakeLabel("buffer", this->DescriptiveName != NULL ? this->DescriptiveName : ""));
   if (fields.empty())
   {
     return PLUS_SUCCESS;
@@ -330,12 +415,12 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
 
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
-    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    unfilteredTimestamp = PlusClock::GetTime();
   }
   if (filteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     bool filteredTimestampProbablyValid = true;
-    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid, GetHardwareTimestamp(&fields)) != PLUS_SUCCESS)
     {
       LOCAL_LOG_DEBUG("Failed to create filtered timestamp for tracker buffer item with item index: " << frameNumber);
       return PLUS_FAIL;
@@ -401,15 +486,16 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
                                   const igsioFieldMapType* customFields /*= NULL */,
                                   vtkStreamingVolumeFrame* encodedFrame /*=NULL*/)
 {
+  PLUS_METRIC_SCOPED_TIMER("plus_buffer_add_video_item_seconds", PlusMetricsRegistry::MakeLabel("buffer", this->DescriptiveName != NULL ? this->DescriptiveName : ""));
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
-    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    unfilteredTimestamp = PlusClock::GetTime();
   }
 
   if (filteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     bool filteredTimestampProbablyValid = true;
-    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid, GetHardwareTimestamp(customFields)) != PLUS_SUCCESS)
     {
       LOCAL_LOG_WARNING("Failed to create filtered timestamp for video buffer item with item index: " << frameNumber);
       return PLUS_FAIL;
@@ -466,6 +552,10 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
   int bufferIndex(0);
   BufferItemUidType itemUid;
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (imageDataPtr != NULL && this->AllocateFrameForNextItem() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
   if (this->StreamBuffer->PrepareForNewItem(filteredTimestamp, itemUid, bufferIndex) != PLUS_SUCCESS)
   {
     // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
@@ -539,15 +629,16 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frameSize, unsigned int inputFrameSizeInBytes, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
+  PLUS_METRIC_SCOPED_TIMER("plus_buffer_add_encoded_item_seconds", PlusMetricsRegistry::MakeLabel("buffer", this->DescriptiveName != NULL ? this->DescriptiveName : ""));
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
-    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    unfilteredTimestamp = PlusClock::GetTime();
   }
 
   if (filteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     bool filteredTimestampProbablyValid = true;
-    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid, GetHardwareTimestamp(customFields)) != PLUS_SUCCESS)
     {
       LOCAL_LOG_WARNING("Failed to create filtered timestamp for video buffer item with item index: " << frameNumber);
       return PLUS_FAIL;
@@ -579,6 +670,10 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
   int bufferIndex(0);
   BufferItemUidType itemUid;
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (imageDataPtr != NULL && this->AllocateFrameForNextItem() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
   if (this->StreamBuffer->PrepareForNewItem(filteredTimestamp, itemUid, bufferIndex) != PLUS_SUCCESS)
   {
     // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
@@ -630,6 +725,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
+  PLUS_METRIC_SCOPED_TIMER("plus_buffer_add_tracker_item_seconds", PlusMetricsRegistry::MakeLabel("buffer", this->DescriptiveName != NULL ? this->DescriptiveName : ""));
   if (matrix == NULL)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to add NULL matrix to tracker buffer!");
@@ -637,12 +733,12 @@ PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus st
   }
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
-    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    unfilteredTimestamp = PlusClock::GetTime();
   }
   if (filteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     bool filteredTimestampProbablyValid = true;
-    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid, GetHardwareTimestamp(customFields)) != PLUS_SUCCESS)
     {
       LOCAL_LOG_DEBUG("Failed to create filtered timestamp for tracker buffer item with item index: " << frameNumber);
       return PLUS_FAIL;
@@ -744,6 +840,36 @@ int vtkPlusBuffer::GetAveragedItemsForFiltering()
   return this->StreamBuffer->GetAveragedItemsForFiltering();
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::SetTimestampFilteringMethod(vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType method)
+{
+  this->StreamBuffer->SetTimestampFilteringMethod(method);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType vtkPlusBuffer::GetTimestampFilteringMethod()
+{
+  return this->StreamBuffer->GetTimestampFilteringMethod();
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusBuffer::GetEstimatedFramePeriodSec()
+{
+  return this->StreamBuffer->GetEstimatedFramePeriodSec();
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusBuffer::GetEstimatedClockDriftPpm()
+{
+  return this->StreamBuffer->GetEstimatedClockDriftPpm();
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusBuffer::GetTimestampJitterSec()
+{
+  return this->StreamBuffer->GetTimestampJitterSec();
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusBuffer::SetStartTime(double startTime)
 {
@@ -1273,6 +1399,179 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+namespace
+{
+  // Get orientation and translation of a buffer item (the matrix is passed in to avoid allocation for each item)
+  void GetItemPose(StreamBufferItem* item, vtkMatrix4x4* matrix, double quaternion[4], double translation[3])
+  {
+    item->GetMatrix(matrix);
+    double rotation[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    for (int i = 0; i < 3; i++)
+    {
+      rotation[i][0] = matrix->GetElement(i, 0);
+      rotation[i][1] = matrix->GetElement(i, 1);
+      rotation[i][2] = matrix->GetElement(i, 2);
+      translation[i] = matrix->GetElement(i, 3);
+    }
+    vtkMath::Matrix3x3ToQuaternion(rotation, quaternion);
+  }
+
+  ToolStatus GetItemTransformStatus(StreamBufferItem* item)
+  {
+    return item->HasValidTransformData() ? item->GetStatus() : TOOL_INVALID;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::GetTransformTimeSeries(double startTime, double endTime, PlusTransformTimeSeries& series, double resamplingPeriodSec/*=0.0*/)
+{
+  series.Clear();
+  if (endTime < startTime)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Invalid time range for transform time series (start: " << std::fixed << startTime << ", end: " << endTime << ")");
+    return PLUS_FAIL;
+  }
+  if (resamplingPeriodSec < 0)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Invalid resampling period for transform time series: " << resamplingPeriodSec);
+    return PLUS_FAIL;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  const double localTimeOffsetSec = this->StreamBuffer->GetLocalTimeOffsetSec();
+  const int numberOfItems = this->StreamBuffer->GetNumberOfItems();
+  // Items in [oldestUid, endUid) are in the buffer
+  const BufferItemUidType oldestUid = (numberOfItems > 0 ? this->StreamBuffer->GetOldestItemUidInBuffer() : 0);
+  const BufferItemUidType endUid = (numberOfItems > 0 ? this->StreamBuffer->GetLatestItemUidInBuffer() + 1 : 0);
+
+  // Items are accessed directly, the buffer is locked during the whole query
+  StreamBufferItem* item = NULL;
+  auto getItem = [&](BufferItemUidType uid) -> StreamBufferItem*
+  {
+    StreamBufferItem* itemPtr = NULL;
+    this->StreamBuffer->GetBufferItemPointerFromUid(uid, itemPtr);
+    return itemPtr;
+  };
+  // Returns the first item UID in the buffer that has timestamp larger than (or, if inclusive is true, equal to) the specified time
+  auto findFirstUidAfter = [&](double time, bool inclusive) -> BufferItemUidType
+  {
+    BufferItemUidType lower = oldestUid;
+    BufferItemUidType upper = endUid;
+    while (lower < upper)
+    {
+      BufferItemUidType middle = lower + (upper - lower) / 2;
+      double middleTime = getItem(middle)->GetFilteredTimestamp(localTimeOffsetSec);
+      if (middleTime < time || (!inclusive && middleTime == time))
+      {
+        lower = middle + 1;
+      }
+      else
+      {
+        upper = middle;
+      }
+    }
+    return lower;
+  };
+
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  double quaternion[4] = {1, 0, 0, 0};
+  double translation[3] = {0, 0, 0};
+
+  if (resamplingPeriodSec == 0)
+  {
+    // Return the items as they are in the buffer
+    const BufferItemUidType firstUid = findFirstUidAfter(startTime, true);
+    const BufferItemUidType lastUid = findFirstUidAfter(endTime, false);
+    series.Reserve(lastUid - firstUid);
+    for (BufferItemUidType uid = firstUid; uid < lastUid; ++uid)
+    {
+      item = getItem(uid);
+      GetItemPose(item, matrix, quaternion, translation);
+      series.AddSample(item->GetFilteredTimestamp(localTimeOffsetSec), quaternion, translation, GetItemTransformStatus(item));
+    }
+    return PLUS_SUCCESS;
+  }
+
+  // Resample to a uniform time grid
+  const size_t numberOfSamples = static_cast<size_t>(floor((endTime - startTime) / resamplingPeriodSec + NEGLIGIBLE_TIME_DIFFERENCE)) + 1;
+  series.Reserve(numberOfSamples);
+  const double identityQuaternion[4] = {1, 0, 0, 0};
+  const double zeroTranslation[3] = {0, 0, 0};
+  double quaternionB[4] = {1, 0, 0, 0};
+  double translationB[3] = {0, 0, 0};
+  double interpolatedQuaternion[4] = {1, 0, 0, 0};
+  double interpolatedTranslation[3] = {0, 0, 0};
+
+  // First item that is after the current sample time
+  BufferItemUidType nextUid = findFirstUidAfter(startTime, false);
+  for (size_t sampleIndex = 0; sampleIndex < numberOfSamples; ++sampleIndex)
+  {
+    const double time = startTime + sampleIndex * resamplingPeriodSec;
+    while (nextUid < endUid && getItem(nextUid)->GetFilteredTimestamp(localTimeOffsetSec) <= time)
+    {
+      ++nextUid;
+    }
+
+    // Item A is the closest item to the requested time, item B is on the other side of the requested time
+    // (same rules as in GetPrevNextBufferItemFromTime and GetInterpolatedStreamBufferItemFromTime)
+    StreamBufferItem* prevItem = (nextUid > oldestUid ? getItem(nextUid - 1) : NULL);
+    StreamBufferItem* nextItem = (nextUid < endUid ? getItem(nextUid) : NULL);
+    if (prevItem == NULL && nextItem == NULL)
+    {
+      series.AddSample(time, identityQuaternion, zeroTranslation, TOOL_MISSING);
+      continue;
+    }
+    StreamBufferItem* itemA = prevItem;
+    StreamBufferItem* itemB = nextItem;
+    if (prevItem == NULL || (nextItem != NULL
+                             && fabs(nextItem->GetFilteredTimestamp(localTimeOffsetSec) - time) < fabs(prevItem->GetFilteredTimestamp(localTimeOffsetSec) - time)))
+    {
+      itemA = nextItem;
+      itemB = prevItem;
+    }
+    const double itemAtime = itemA->GetFilteredTimestamp(localTimeOffsetSec);
+    GetItemPose(itemA, matrix, quaternion, translation);
+
+    if (GetItemTransformStatus(itemA) != TOOL_OK || fabs(itemAtime - time) > this->GetMaxAllowedTimeDifference())
+    {
+      // Interpolation is not possible, use the closest item and mark it as missing
+      series.AddSample(time, quaternion, translation, TOOL_MISSING);
+      continue;
+    }
+    if (fabs(itemAtime - time) < NEGLIGIBLE_TIME_DIFFERENCE)
+    {
+      series.AddSample(time, quaternion, translation, TOOL_OK);
+      continue;
+    }
+    if (itemB == NULL || GetItemTransformStatus(itemB) != TOOL_OK
+        || fabs(itemB->GetFilteredTimestamp(localTimeOffsetSec) - time) > this->GetMaxAllowedTimeDifference())
+    {
+      series.AddSample(time, quaternion, translation, TOOL_MISSING);
+      continue;
+    }
+
+    const double itemBtime = itemB->GetFilteredTimestamp(localTimeOffsetSec);
+    if (fabs(itemAtime - itemBtime) < NEGLIGIBLE_TIME_DIFFERENCE)
+    {
+      series.AddSample(time, quaternion, translation, TOOL_OK);
+      continue;
+    }
+    GetItemPose(itemB, matrix, quaternionB, translationB);
+    const double itemAweight = fabs(itemBtime - time) / fabs(itemAtime - itemBtime);
+    const double itemBweight = 1 - itemAweight;
+    igsioMath::Slerp(interpolatedQuaternion, itemBweight, quaternion, quaternionB);
+    for (int i = 0; i < 3; i++)
+    {
+      interpolatedTranslation[i] = translation[i] * itemAweight + translationB[i] * itemBweight;
+    }
+    series.AddSample(time, interpolatedQuaternion, interpolatedTranslation, TOOL_OK);
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation)
 {
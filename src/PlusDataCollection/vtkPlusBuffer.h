@@ -19,6 +19,7 @@ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
 #include "PlusConfigure.h"
 #include "vtkPlusDataCollectionExport.h"
 #include "PlusStreamBufferItem.h"
+#include "PlusTransformTimeSeries.h"
 #include "vtkPlusTimestampedCircularBuffer.h"
 
 //#include "igsioTrackedFrame.h"
@@ -53,6 +54,13 @@ public:
   vtkTypeMacro(vtkPlusBuffer, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
 
+  /*!
+    Name of the custom frame field that devices may use for providing the acquisition time measured by the device's own clock (in seconds).
+    If the field is present and the filtered timestamp is not specified when adding an item then the streaming timestamp filter
+    computes the filtered timestamp from this hardware timestamp.
+  */
+  static const char* HARDWARE_TIMESTAMP_FIELD_NAME;
+
   /*!
     Set the size of the buffer, i.e. the maximum number of
     video frames that it will hold.  The default is 30.
@@ -165,6 +173,19 @@ public:
   };
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation);
+
+  /*!
+    Get all transforms in the [startTime, endTime] time range as contiguous arrays (timestamps, quaternions, translations, status).
+    Items are read directly from the buffer, without creating a StreamBufferItem or tracked frame for each sample,
+    so it can be used for processing long transform histories.
+    \param startTime Start of the time range (global time, in seconds)
+    \param endTime End of the time range (global time, in seconds)
+    \param series Output time series. Existing content is cleared, allocated memory is reused.
+    \param resamplingPeriodSec If larger than 0 then the transforms are interpolated at startTime + k * resamplingPeriodSec times,
+      the same way as GetStreamBufferItemFromTime does with INTERPOLATED option (samples that cannot be interpolated get TOOL_MISSING status).
+      If 0 then the items that are in the buffer are returned without resampling.
+  */
+  virtual PlusStatus GetTransformTimeSeries(double startTime, double endTime, PlusTransformTimeSeries& series, double resamplingPeriodSec = 0.0);
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
   /*! Get latest timestamp in the buffer */
@@ -258,6 +279,17 @@ public:
 
   virtual int GetAveragedItemsForFiltering();
 
+  /*! Set the algorithm used for computing filtered timestamps */
+  virtual void SetTimestampFilteringMethod(vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType method);
+  virtual vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType GetTimestampFilteringMethod();
+
+  /*! Average time between consecutive items, as estimated by the timestamp filter (in seconds) */
+  virtual double GetEstimatedFramePeriodSec();
+  /*! Drift of the device clock compared to the system clock (in parts per million), only available if the device provides hardware timestamps */
+  virtual double GetEstimatedClockDriftPpm();
+  /*! Root mean square difference between the unfiltered timestamps and the timestamps computed by the filter (in seconds) */
+  virtual double GetTimestampJitterSec();
+
   /*! Set recording start time */
   virtual void SetStartTime(double startTime);
   /*! Get recording start time */
@@ -321,9 +353,18 @@ protected:
   vtkPlusBuffer();
   ~vtkPlusBuffer();
 
-  /*! Update video buffer by setting the frame format for each frame  */
+  /*!
+    Update video buffer after the frame format is changed. Memory of frames that do not match the new format is released.
+    Memory for frames is allocated lazily, from the shared frame pool, when a frame is written into a buffer slot.
+  */
   virtual PlusStatus AllocateMemoryForFrames();
 
+  /*! Returns true if the frame has pixel data allocated that matches the buffer frame format */
+  bool IsFrameAllocated(igsioVideoFrame& frame);
+
+  /*! Allocate pixel data from the frame pool for the buffer item that will be written next, if it is not allocated yet. The caller must have locked the buffer. */
+  PlusStatus AllocateFrameForNextItem();
+
   /*!
     Compares frame format with new frame imaging parameters.
     \return true if current buffer frame format matches the method arguments, otherwise false
@@ -371,6 +412,9 @@ protected:
 
   char* DescriptiveName;
 
+  /*! Frame allocation failures are only reported once (until the frame format is changed) */
+  bool FrameAllocationFailureReported;
+
 private:
   vtkPlusBuffer(const vtkPlusBuffer&);
   void operator=(const vtkPlusBuffer&);
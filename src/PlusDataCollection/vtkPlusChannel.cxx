@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusMetrics.h"
 #ifdef PLUS_RENDERING_ENABLED
 #include "PlusPlotter.h"
 #endif
@@ -531,6 +532,7 @@ void vtkPlusChannel::SetVideoSource(vtkPlusDataSource* aSource)
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame& aTrackedFrame, bool enableImageData/*=true*/)
 {
+  PLUS_METRIC_SCOPED_TIMER("plus_channel_get_tracked_frame_seconds", PlusMetricsRegistry::MakeLabel("channel", this->ChannelId != NULL ? this->ChannelId : ""));
   int numberOfErrors(0);
   double synchronizedTimestamp(0);
 
@@ -716,6 +718,7 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(igsioTrackedFrame& trackedFrame)
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetTrackedFrameList(double& aTimestampOfLastFrameAlreadyGot, vtkIGSIOTrackedFrameList* aTrackedFrameList, int aMaxNumberOfFramesToAdd)
 {
+  PLUS_METRIC_SCOPED_TIMER("plus_channel_get_tracked_frame_list_seconds", PlusMetricsRegistry::MakeLabel("channel", this->ChannelId != NULL ? this->ChannelId : ""));
   LOG_TRACE("vtkPlusDevice::GetTrackedFrameList(" << aTimestampOfLastFrameAlreadyGot << ", " << aMaxNumberOfFramesToAdd << ")");
 
   if (aTrackedFrameList == NULL)
@@ -1656,6 +1659,21 @@ int vtkPlusChannel::GetNumberOfFramesBetweenTimestamps(double aTimestampFrom, do
   return numberOfFrames + 1;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::GetTransformTimeSeries(double startTime, double endTime, std::map<std::string, PlusTransformTimeSeries>& toolTimeSeries, double resamplingPeriodSec/*=0.0*/)
+{
+  PlusStatus status = PLUS_SUCCESS;
+  for (DataSourceContainerConstIterator it = this->Tools.begin(); it != this->Tools.end(); ++it)
+  {
+    if (it->second->GetTransformTimeSeries(startTime, endTime, toolTimeSeries[it->first], resamplingPeriodSec) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get transform time series of tool " << it->first);
+      status = PLUS_FAIL;
+    }
+  }
+  return status;
+}
+
 //----------------------------------------------------------------------------
 double vtkPlusChannel::GetClosestTrackedFrameTimestampByTime(double time)
 {
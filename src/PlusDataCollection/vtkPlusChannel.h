@@ -11,6 +11,7 @@
 #include "vtkPlusDataCollectionExport.h"
 
 #include "PlusStreamBufferItem.h"
+#include "PlusTransformTimeSeries.h"
 #include "vtkDataObject.h"
 #include "vtkPlusRfProcessor.h"
 
@@ -133,6 +134,13 @@ public:
   */
   PlusStatus GetTrackedFrameList(double& aTimestampOfLastFrameAlreadyGot, vtkIGSIOTrackedFrameList* aTrackedFrameList, int aMaxNumberOfFramesToAdd);
 
+  /*!
+    Get transforms of all the tools of the channel in a time range as contiguous arrays (see vtkPlusBuffer::GetTransformTimeSeries).
+    If a resampling period is specified then the samples of all the tools are at the same times.
+    \param toolTimeSeries Output time series for each tool (key: tool source ID). Existing entries are reused to avoid memory allocation.
+  */
+  virtual PlusStatus GetTransformTimeSeries(double startTime, double endTime, std::map<std::string, PlusTransformTimeSeries>& toolTimeSeries, double resamplingPeriodSec = 0.0);
+
   /*! Get the closest tracked frame timestamp to the specified time */
   virtual double GetClosestTrackedFrameTimestampByTime(double time);
 
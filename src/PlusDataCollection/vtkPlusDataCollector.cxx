@@ -6,6 +6,10 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusAcquisitionScheduler.h"
+#include "PlusClock.h"
+#include "PlusFramePool.h"
+#include "PlusMetrics.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataCollector.h"
@@ -25,6 +29,10 @@ See License.txt for details.
 #endif
 
 // STD includes
+#include <algorithm>
+#include <future>
+#include <iomanip>
+#include <limits>
 #include <set>
 
 // VTK includes
@@ -36,10 +44,24 @@ See License.txt for details.
 
 vtkStandardNewMacro(vtkPlusDataCollector);
 
+// The virtual clock is set slightly after the timestamp of the next frame to make sure that rounding errors
+// in the timestamp computations do not prevent adding the frame
+static const double VIRTUAL_CLOCK_STEP_MARGIN_SEC = 1e-6;
+// Number of consecutive steps without any replayed frame before the replay is aborted
+static const int VIRTUAL_CLOCK_MAX_STALLED_STEPS = 10;
+// Number of update periods the clock is advanced at the end of the replay to let the devices process the last frames
+static const int VIRTUAL_CLOCK_FLUSH_STEPS = 2;
+
 //----------------------------------------------------------------------------
 vtkPlusDataCollector::vtkPlusDataCollector()
   : vtkObject()
   , StartupDelaySec(0.0)
+  , ParallelStartup(false)
+  , InputDataReadyTimeoutSec(5.0)
+  , VirtualClockEnabled(false)
+  , VirtualClockStopRequested(false)
+  , VirtualClockReplayCompleted(false)
+  , VirtualClockReplaySpeedup(0.0)
   , DeviceFactory(vtkSmartPointer<vtkPlusDeviceFactory>::New())
   , Connected(false)
   , Started(false)
@@ -105,6 +127,35 @@ PlusStatus vtkPlusDataCollector::ReadConfiguration(vtkXMLDataElement* aConfig)
     LOG_DEBUG("StartupDelaySec: " << std::fixed << startupDelaySec);
   }
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ParallelStartup, dataCollectionElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, InputDataReadyTimeoutSec, dataCollectionElement);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(VirtualClockEnabled, dataCollectionElement);
+
+  // Shared acquisition scheduler settings (used by devices with UseAcquisitionScheduler enabled).
+  // The scheduler is a singleton, so the defaults are set if not specified, otherwise a previous configuration's settings would be kept.
+  int schedulerNumberOfThreads = 0;
+  int schedulerRealTimePriority = 0;
+  XML_FIND_NESTED_ELEMENT_OPTIONAL(schedulerElement, dataCollectionElement, "AcquisitionScheduler");
+  if (schedulerElement != NULL)
+  {
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, NumberOfThreads, schedulerNumberOfThreads, schedulerElement);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, RealTimePriority, schedulerRealTimePriority, schedulerElement);
+  }
+  PlusAcquisitionScheduler::GetInstance()->SetNumberOfThreads(schedulerNumberOfThreads);
+  PlusAcquisitionScheduler::GetInstance()->SetRealTimePriority(schedulerRealTimePriority);
+
+  // Shared memory pool for video buffer frames. The pool is a singleton as well, so the defaults are set if not specified.
+  int memoryBudgetMb = 0;
+  bool useHugePages = false;
+  XML_FIND_NESTED_ELEMENT_OPTIONAL(framePoolElement, dataCollectionElement, "FrameMemoryPool");
+  if (framePoolElement != NULL)
+  {
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, MemoryBudgetMB, memoryBudgetMb, framePoolElement);
+    XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(UseHugePages, useHugePages, framePoolElement);
+  }
+  PlusFramePool::GetInstance()->SetMemoryBudgetBytes(static_cast<uint64_t>(std::max(memoryBudgetMb, 0)) * 1024 * 1024);
+  PlusFramePool::GetInstance()->SetUseHugePages(useHugePages);
+
   std::set<std::string> existingDeviceIds;
 
   for (int i = 0; i < dataCollectionElement->GetNumberOfNestedElements(); ++i)
@@ -281,6 +332,19 @@ PlusStatus vtkPlusDataCollector::WriteConfiguration(vtkXMLDataElement* aConfig)
   }
 
   dataCollectionConfig->SetDoubleAttribute("StartupDelaySec", GetStartupDelaySec());
+  if (this->ParallelStartup)
+  {
+    dataCollectionConfig->SetAttribute("ParallelStartup", "TRUE");
+    dataCollectionConfig->SetDoubleAttribute("InputDataReadyTimeoutSec", this->InputDataReadyTimeoutSec);
+  }
+  if (this->VirtualClockEnabled)
+  {
+    dataCollectionConfig->SetAttribute("VirtualClockEnabled", "TRUE");
+  }
+  else
+  {
+    XML_REMOVE_ATTRIBUTE("VirtualClockEnabled", dataCollectionConfig);
+  }
 
   PlusStatus status = PLUS_SUCCESS;
 
@@ -318,25 +382,82 @@ PlusStatus vtkPlusDataCollector::Start()
 {
   LOG_TRACE("vtkPlusDataCollector::Start()");
 
-  PlusStatus status = PLUS_SUCCESS;
+  const bool virtualClock = this->VirtualClockEnabled;
+  if (virtualClock && this->StartVirtualClock() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start data collection with virtual clock");
+    return PLUS_FAIL;
+  }
 
-  const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  const double systemStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  const double startTime = PlusClock::GetTime();
+  // Input data only arrives when the virtual clock is stepped, so it is not waited for
+  const bool waitForInputData = this->ParallelStartup && !virtualClock;
+  const double inputDataReadyTimeoutSec = this->InputDataReadyTimeoutSec;
 
-  for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
+  PlusStatus status = this->ExecuteDeviceTasks([startTime, waitForInputData, inputDataReadyTimeoutSec](vtkPlusDevice * device)
   {
-    vtkPlusDevice* device = *it;
+    const double deviceStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (waitForInputData && !WaitForInputData(device, inputDataReadyTimeoutSec))
+    {
+      LOG_WARNING("No data received in the input channels of device " << device->GetDeviceId() << " in " << std::fixed << inputDataReadyTimeoutSec << " sec. Starting the device anyway.");
+    }
 
+    PlusStatus deviceStatus = PLUS_SUCCESS;
     if (device->StartRecording() != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to start data acquisition for device " << device->GetDeviceId() << ".");
-      status = PLUS_FAIL;
+      deviceStatus = PLUS_FAIL;
     }
     device->SetStartTime(startTime);
-  }
 
-  LOG_DEBUG("vtkPlusDataCollector::Start -- wait " << std::fixed << this->StartupDelaySec << " sec for buffer init...");
+    const double elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - deviceStartTime;
+    LOG_INFO("Device " << device->GetDeviceId() << " started in " << std::fixed << std::setprecision(3) << elapsedTimeSec << " sec");
+    PLUS_METRIC_GAUGE_SET("plus_device_start_seconds", PlusMetricsRegistry::MakeLabel("device", device->GetDeviceId()), elapsedTimeSec);
+    return deviceStatus;
+  });
 
-  vtkIGSIOAccurateTimer::DelayWithEventProcessing(this->StartupDelaySec);
+  if (virtualClock)
+  {
+    // No startup delay: timestamps are exact in the replayed data and devices only acquire data when the clock is stepped
+    this->VirtualClockStopRequested = false;
+    this->VirtualClockReplayCompleted = false;
+    this->VirtualClockReplaySpeedup = 0.0;
+    this->VirtualClockThread = std::thread(&vtkPlusDataCollector::VirtualClockReplayThread, this);
+  }
+  else if (this->ParallelStartup)
+  {
+    // Wait until all the buffers contain data (instead of waiting for the full startup delay)
+    LOG_DEBUG("vtkPlusDataCollector::Start -- wait at most " << std::fixed << this->StartupDelaySec << " sec for buffer init...");
+    const double delayEndTime = systemStartTime + this->StartupDelaySec;
+    bool allDataAvailable = false;
+    while (!allDataAvailable && vtkIGSIOAccurateTimer::GetSystemTime() < delayEndTime)
+    {
+      allDataAvailable = true;
+      for (DeviceCollectionIterator it = this->Devices.begin(); it != this->Devices.end() && allDataAvailable; ++it)
+      {
+        for (ChannelContainerConstIterator channelIt = (*it)->GetOutputChannelsStart(); channelIt != (*it)->GetOutputChannelsEnd(); ++channelIt)
+        {
+          if (!IsChannelDataAvailable(*channelIt))
+          {
+            allDataAvailable = false;
+            break;
+          }
+        }
+      }
+      if (!allDataAvailable)
+      {
+        vtkIGSIOAccurateTimer::DelayWithEventProcessing(0.01);
+      }
+    }
+  }
+  else
+  {
+    LOG_DEBUG("vtkPlusDataCollector::Start -- wait " << std::fixed << this->StartupDelaySec << " sec for buffer init...");
+    vtkIGSIOAccurateTimer::DelayWithEventProcessing(this->StartupDelaySec);
+  }
+
+  LOG_INFO("Data collection started in " << std::fixed << std::setprecision(3) << vtkIGSIOAccurateTimer::GetSystemTime() - systemStartTime << " sec");
 
   this->Started = true;
 
@@ -348,8 +469,14 @@ PlusStatus vtkPlusDataCollector::Stop()
 {
   LOG_TRACE("vtkPlusDataCollector::Stop()");
 
+  this->StopVirtualClock();
+
   this->Started = false;
 
+  std::ostringstream frameMemoryUsage;
+  PlusFramePool::GetInstance()->PrintUsage(frameMemoryUsage);
+  LOG_DEBUG(frameMemoryUsage.str());
+
   return PLUS_SUCCESS;
 }
 
@@ -358,18 +485,25 @@ PlusStatus vtkPlusDataCollector::Connect()
 {
   LOG_TRACE("vtkPlusDataCollector::Connect()");
 
-  PlusStatus status = PLUS_SUCCESS;
+  const double connectStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
-  for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
+  PlusStatus status = this->ExecuteDeviceTasks([](vtkPlusDevice * device)
   {
-    vtkPlusDevice* device = *it;
-
+    const double deviceStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    PlusStatus deviceStatus = PLUS_SUCCESS;
     if (device->Connect() != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to connect device: " << device->GetDeviceId() << ".");
-      status = PLUS_FAIL;
+      deviceStatus = PLUS_FAIL;
     }
-  }
+
+    const double elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - deviceStartTime;
+    LOG_INFO("Device " << device->GetDeviceId() << " connected in " << std::fixed << std::setprecision(3) << elapsedTimeSec << " sec");
+    PLUS_METRIC_GAUGE_SET("plus_device_connect_seconds", PlusMetricsRegistry::MakeLabel("device", device->GetDeviceId()), elapsedTimeSec);
+    return deviceStatus;
+  });
+
+  LOG_INFO("Devices connected in " << std::fixed << std::setprecision(3) << vtkIGSIOAccurateTimer::GetSystemTime() - connectStartTime << " sec");
 
   if (status != PLUS_SUCCESS)
   {
@@ -387,11 +521,349 @@ PlusStatus vtkPlusDataCollector::Connect()
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataCollector::GetDevicesInDependencyOrder(DeviceCollection& orderedDevices, std::map<vtkPlusDevice*, DeviceCollection>& inputDevices) const
+{
+  orderedDevices.clear();
+  inputDevices.clear();
+
+  for (DeviceCollectionConstIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+  {
+    DeviceCollection& deviceInputs = inputDevices[*it];
+    for (ChannelContainerConstIterator channelIt = (*it)->GetInputChannelsStart(); channelIt != (*it)->GetInputChannelsEnd(); ++channelIt)
+    {
+      vtkPlusDevice* ownerDevice = (*channelIt)->GetOwnerDevice();
+      if (ownerDevice != NULL && ownerDevice != *it && std::find(deviceInputs.begin(), deviceInputs.end(), ownerDevice) == deviceInputs.end())
+      {
+        deviceInputs.push_back(ownerDevice);
+      }
+    }
+  }
+
+  // Topological sort: repeatedly take the first device (in configuration order) that has all its inputs already added
+  std::set<vtkPlusDevice*> addedDevices;
+  while (orderedDevices.size() < this->Devices.size())
+  {
+    bool deviceAdded = false;
+    for (DeviceCollectionConstIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+    {
+      if (addedDevices.count(*it) > 0)
+      {
+        continue;
+      }
+      const DeviceCollection& deviceInputs = inputDevices[*it];
+      bool allInputsAdded = true;
+      for (DeviceCollectionConstIterator inputIt = deviceInputs.begin(); inputIt != deviceInputs.end(); ++inputIt)
+      {
+        if (addedDevices.count(*inputIt) == 0)
+        {
+          allInputsAdded = false;
+          break;
+        }
+      }
+      if (allInputsAdded)
+      {
+        orderedDevices.push_back(*it);
+        addedDevices.insert(*it);
+        deviceAdded = true;
+        break;
+      }
+    }
+    if (!deviceAdded)
+    {
+      LOG_ERROR("Circular dependency found between device input and output channels. Devices will be processed in configuration order.");
+      orderedDevices = this->Devices;
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataCollector::ExecuteDeviceTasks(const std::function<PlusStatus(vtkPlusDevice*)>& task)
+{
+  DeviceCollection orderedDevices;
+  std::map<vtkPlusDevice*, DeviceCollection> inputDevices;
+  bool dependencyOrderValid = (this->GetDevicesInDependencyOrder(orderedDevices, inputDevices) == PLUS_SUCCESS);
+
+  PlusStatus status = PLUS_SUCCESS;
+  if (!this->ParallelStartup || !dependencyOrderValid)
+  {
+    for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+    {
+      if (task(*it) != PLUS_SUCCESS)
+      {
+        status = PLUS_FAIL;
+      }
+    }
+    return status;
+  }
+
+  // Tasks are launched in dependency order, therefore the tasks of all input devices already exist when a task is launched
+  std::map<vtkPlusDevice*, std::shared_future<PlusStatus> > deviceTasks;
+  for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+  {
+    std::vector<std::shared_future<PlusStatus> > inputTasks;
+    const DeviceCollection& deviceInputs = inputDevices[*it];
+    for (DeviceCollectionConstIterator inputIt = deviceInputs.begin(); inputIt != deviceInputs.end(); ++inputIt)
+    {
+      inputTasks.push_back(deviceTasks[*inputIt]);
+    }
+    vtkPlusDevice* device = *it;
+    deviceTasks[device] = std::async(std::launch::async, [device, inputTasks, &task]()
+    {
+      for (auto inputTaskIt = inputTasks.begin(); inputTaskIt != inputTasks.end(); ++inputTaskIt)
+      {
+        inputTaskIt->wait();
+      }
+      return task(device);
+    }).share();
+  }
+
+  for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+  {
+    if (deviceTasks[*it].get() != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusDataCollector::IsChannelDataAvailable(vtkPlusChannel* channel)
+{
+  vtkPlusDataSource* videoSource = NULL;
+  if (channel->HasVideoSource() && channel->GetVideoSource(videoSource) == PLUS_SUCCESS && videoSource->GetNumberOfItems() == 0)
+  {
+    return false;
+  }
+  for (DataSourceContainerConstIterator it = channel->GetToolsStartConstIterator(); it != channel->GetToolsEndConstIterator(); ++it)
+  {
+    if (it->second->GetNumberOfItems() == 0)
+    {
+      return false;
+    }
+  }
+  for (DataSourceContainerConstIterator it = channel->GetFieldDataSourcesStartConstIterator(); it != channel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    if (it->second->GetNumberOfItems() == 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusDataCollector::WaitForInputData(vtkPlusDevice* device, double timeoutSec)
+{
+  const double timeoutTime = vtkIGSIOAccurateTimer::GetSystemTime() + timeoutSec;
+  for (ChannelContainerConstIterator it = device->GetInputChannelsStart(); it != device->GetInputChannelsEnd(); ++it)
+  {
+    while (!IsChannelDataAvailable(*it))
+    {
+      if (vtkIGSIOAccurateTimer::GetSystemTime() > timeoutTime)
+      {
+        return false;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataCollector::StartVirtualClock()
+{
+  // Stop the replay of a previous start
+  this->StopVirtualClock();
+
+  double clockStartTime = 0;
+  bool savedDataSourceFound = false;
+  for (DeviceCollectionIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+  {
+    vtkPlusSavedDataSource* savedDataSource = dynamic_cast<vtkPlusSavedDataSource*>(*it);
+    if (savedDataSource == NULL)
+    {
+      if ((*it)->GetInputChannelsStart() == (*it)->GetInputChannelsEnd())
+      {
+        LOG_ERROR("Virtual clock replay requires that all data is provided by saved data sources. Device " << (*it)->GetDeviceId() << " has no input channels and it is not a saved data source.");
+        return PLUS_FAIL;
+      }
+      continue;
+    }
+    if (savedDataSource->GetRepeatEnabled())
+    {
+      LOG_WARNING("RepeatEnabled is set for saved data source " << savedDataSource->GetDeviceId() << ", virtual clock replay will continue until data collection is stopped");
+    }
+    double loopStartTime = 0;
+    double loopStopTime = 0;
+    savedDataSource->GetLoopTimeRange(loopStartTime, loopStopTime);
+    if (!savedDataSourceFound || loopStartTime < clockStartTime)
+    {
+      clockStartTime = loopStartTime;
+    }
+    savedDataSourceFound = true;
+  }
+
+  if (!savedDataSourceFound)
+  {
+    LOG_ERROR("Virtual clock replay requires at least one saved data source");
+    return PLUS_FAIL;
+  }
+
+  // Start the clock at the beginning of the recording, so that the replayed frames get their recorded timestamps.
+  // Zero time is used by some devices as "not initialized yet", so the clock always starts at a positive time.
+  if (clockStartTime <= 0)
+  {
+    clockStartTime = 1.0;
+  }
+
+  for (DeviceCollectionIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+  {
+    (*it)->SetExternalUpdateStepping(true);
+  }
+  PlusClock::EnableVirtualClock(clockStartTime);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDataCollector::VirtualClockReplayThread()
+{
+  DeviceCollection orderedDevices;
+  std::map<vtkPlusDevice*, DeviceCollection> inputDevices;
+  this->GetDevicesInDependencyOrder(orderedDevices, inputDevices);
+
+  std::vector<vtkPlusSavedDataSource*> savedDataSources;
+  double maxUpdatePeriodSec = 0;
+  for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+  {
+    vtkPlusSavedDataSource* savedDataSource = dynamic_cast<vtkPlusSavedDataSource*>(*it);
+    if (savedDataSource != NULL)
+    {
+      savedDataSources.push_back(savedDataSource);
+    }
+    if ((*it)->GetAcquisitionRate() > 0)
+    {
+      maxUpdatePeriodSec = std::max(maxUpdatePeriodSec, 1.0 / (*it)->GetAcquisitionRate());
+    }
+  }
+
+  auto updateDevices = [&orderedDevices]()
+  {
+    for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+    {
+      if ((*it)->IsExternalUpdateSteppingActive())
+      {
+        (*it)->ForceUpdate();
+      }
+    }
+  };
+
+  const double systemStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  const double virtualStartTime = PlusClock::GetTime();
+  uint64_t numberOfSteps = 0;
+  int numberOfStalledSteps = 0;
+  double previousNextFrameTime = -std::numeric_limits<double>::max();
+  bool replayCompleted = false;
+  while (!this->VirtualClockStopRequested)
+  {
+    double nextFrameTime = std::numeric_limits<double>::max();
+    bool nextFrameFound = false;
+    for (std::vector<vtkPlusSavedDataSource*>::iterator it = savedDataSources.begin(); it != savedDataSources.end(); ++it)
+    {
+      double sourceNextFrameTime = 0;
+      if ((*it)->GetNextFrameTime(sourceNextFrameTime))
+      {
+        nextFrameTime = std::min(nextFrameTime, sourceNextFrameTime);
+        nextFrameFound = true;
+      }
+    }
+    if (!nextFrameFound)
+    {
+      replayCompleted = true;
+      break;
+    }
+
+    // If the next frame did not change then the previous step could not replay it
+    numberOfStalledSteps = (nextFrameTime == previousNextFrameTime ? numberOfStalledSteps + 1 : 0);
+    if (numberOfStalledSteps >= VIRTUAL_CLOCK_MAX_STALLED_STEPS)
+    {
+      LOG_ERROR("Virtual clock replay stopped: frame at time " << std::fixed << nextFrameTime << " could not be replayed");
+      break;
+    }
+    previousNextFrameTime = nextFrameTime;
+
+    PlusClock::SetVirtualTime(nextFrameTime + VIRTUAL_CLOCK_STEP_MARGIN_SEC);
+    updateDevices();
+    numberOfSteps++;
+  }
+
+  if (replayCompleted)
+  {
+    // Devices that are updated at a lower rate than the frame rate (e.g., capture devices) may not have processed the last frames yet
+    for (int flushStep = 0; flushStep < VIRTUAL_CLOCK_FLUSH_STEPS && !this->VirtualClockStopRequested; flushStep++)
+    {
+      PlusClock::SetVirtualTime(PlusClock::GetTime() + maxUpdatePeriodSec);
+      updateDevices();
+    }
+
+    const double replayedTimeSec = PlusClock::GetTime() - virtualStartTime;
+    const double elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - systemStartTime;
+    const double speedup = (elapsedTimeSec > 0 ? replayedTimeSec / elapsedTimeSec : 0);
+    LOG_INFO("Virtual clock replay completed: " << std::fixed << std::setprecision(3) << replayedTimeSec << " sec of data replayed in " << elapsedTimeSec
+             << " sec (" << std::setprecision(1) << speedup << "x real time, " << numberOfSteps << " steps)");
+    PLUS_METRIC_GAUGE_SET("plus_virtual_clock_replay_speedup", "", speedup);
+    this->VirtualClockReplaySpeedup = speedup;
+    this->VirtualClockReplayCompleted = true;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDataCollector::StopVirtualClock()
+{
+  if (this->VirtualClockThread.joinable())
+  {
+    this->VirtualClockStopRequested = true;
+    this->VirtualClockThread.join();
+  }
+  if (this->VirtualClockEnabled && PlusClock::IsVirtualClockEnabled())
+  {
+    PlusClock::DisableVirtualClock();
+  }
+  if (this->VirtualClockEnabled)
+  {
+    // Takes effect at the next StartRecording, devices that are still recording keep their current update mode until they are stopped
+    for (DeviceCollectionIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+    {
+      (*it)->SetExternalUpdateStepping(false);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusDataCollector::IsVirtualClockReplayCompleted() const
+{
+  return this->VirtualClockReplayCompleted;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusDataCollector::GetVirtualClockReplaySpeedup() const
+{
+  return this->VirtualClockReplaySpeedup;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataCollector::Disconnect()
 {
   LOG_TRACE("vtkPlusDataCollector::Disconnect()");
 
+  // Devices must not be updated by the replay thread while they are disconnected
+  this->StopVirtualClock();
+
   PlusStatus status = PLUS_SUCCESS;
 
   for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
@@ -665,7 +1137,7 @@ PlusStatus vtkPlusDataCollector::SetLoopTimes()
       // loops are only set for saved data sources
       continue;
     }
-    if (!savedDataSource->GetUseOriginalTimestamps())
+    if (!savedDataSource->GetUseOriginalTimestamps() && !this->VirtualClockEnabled)
     {
       LOG_DEBUG("The device " << savedDataSource->GetDeviceId() << " does not use original timestamps, therefore synchronization of loop time is not applicable");
       continue;
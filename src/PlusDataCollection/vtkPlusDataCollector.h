@@ -15,6 +15,12 @@ See License.txt for details.
 // VTK includes
 #include <vtkObject.h>
 
+// STL includes
+#include <atomic>
+#include <functional>
+#include <map>
+#include <thread>
+
 //class igsioTrackedFrame; 
 class vtkPlusChannel;
 class vtkPlusDeviceFactory;
@@ -27,6 +33,12 @@ class vtkXMLDataElement;
 
 Provides an interface for clients to connect to a device set, and request data to the currently active devices.
 
+If VirtualClockEnabled is set then the recorded data of the saved data sources is replayed using a virtual clock (see PlusClock):
+the clock is advanced to the timestamp of the next recorded frame, then all devices are updated in dependency order, as fast as
+the processing allows. No device updates run in the background, therefore the output of the downstream virtual devices
+(capture, volume reconstruction, image processing) is reproducible and does not depend on the processing speed.
+All the devices that have no input channels must be saved data sources.
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusDataCollector : public vtkObject
@@ -154,13 +166,82 @@ public:
   /*! Get startup delay in sec to give some time to the buffers for proper initialization */
   vtkGetMacro(StartupDelaySec, double);
 
+  /*!
+    If enabled then devices that do not depend on each other are connected and started in parallel.
+    Devices are started when data is available in all their input channels (see InputDataReadyTimeoutSec)
+    and the startup delay is ended as soon as all output channels contain data.
+  */
+  vtkSetMacro(ParallelStartup, bool);
+  /*! Get parallel startup flag. See SetParallelStartup(). */
+  vtkGetMacro(ParallelStartup, bool);
+  vtkBooleanMacro(ParallelStartup, bool);
+
+  /*! Maximum time in sec to wait for data in the input channels before a device is started in parallel startup mode */
+  vtkSetMacro(InputDataReadyTimeoutSec, double);
+  /*! Maximum time in sec to wait for data in the input channels before a device is started in parallel startup mode */
+  vtkGetMacro(InputDataReadyTimeoutSec, double);
+
+  /*! If enabled then Start() replays the saved data sources using a virtual clock, as fast as possible. Must be set before Connect(). */
+  vtkSetMacro(VirtualClockEnabled, bool);
+  /*! Get virtual clock replay flag. See SetVirtualClockEnabled(). */
+  vtkGetMacro(VirtualClockEnabled, bool);
+  vtkBooleanMacro(VirtualClockEnabled, bool);
+
+  /*! Returns true if the virtual clock replay reached the end of the recorded data and all devices are updated */
+  bool IsVirtualClockReplayCompleted() const;
+
+  /*! Replayed time divided by the elapsed system time of the last completed virtual clock replay (0 if no replay is completed yet) */
+  double GetVirtualClockReplaySpeedup() const;
+
 protected:
   vtkPlusDataCollector();
   virtual ~vtkPlusDataCollector();
 
+  /*!
+    Get the devices in an order where each device comes after the devices that provide its input channels.
+    Devices that do not depend on each other keep their configuration order.
+    \param inputDevices For each device, the list of devices that own its input channels
+  */
+  PlusStatus GetDevicesInDependencyOrder(DeviceCollection& orderedDevices, std::map<vtkPlusDevice*, DeviceCollection>& inputDevices) const;
+
+  /*!
+    Execute a task (connect, start) for all devices, in dependency order.
+    If ParallelStartup is enabled then the task of each device is executed in a separate thread
+    as soon as the tasks of all its input devices are completed.
+  */
+  PlusStatus ExecuteDeviceTasks(const std::function<PlusStatus(vtkPlusDevice*)>& task);
+
+  /*! Returns true if all data sources of the channel contain at least one item */
+  static bool IsChannelDataAvailable(vtkPlusChannel* channel);
+
+  /*! Wait until data is available in all the input channels of the device. Returns false if timed out. */
+  static bool WaitForInputData(vtkPlusDevice* device, double timeoutSec);
+
+  /*! Check that the devices can be replayed and switch to the virtual clock, starting at the beginning of the recorded data */
+  PlusStatus StartVirtualClock();
+
+  /*! Advance the virtual clock frame by frame and update all devices, until all recorded frames are replayed or stop is requested */
+  void VirtualClockReplayThread();
+
+  /*! Stop the replay thread, switch back to the system clock, and let the devices use their own update threads again at the next start */
+  void StopVirtualClock();
+
   /*! The timestamp filtering methods require some time to initialize. Synchronization will ignore data that are acquired during startup delay. */
   double StartupDelaySec;
 
+  /*! Connect and start independent devices in parallel */
+  bool ParallelStartup;
+
+  /*! Maximum time to wait for input data before starting a device in parallel startup mode */
+  double InputDataReadyTimeoutSec;
+
+  /*! Replay saved data sources using a virtual clock */
+  bool VirtualClockEnabled;
+  std::thread VirtualClockThread;
+  std::atomic<bool> VirtualClockStopRequested;
+  std::atomic<bool> VirtualClockReplayCompleted;
+  double VirtualClockReplaySpeedup;
+
   vtkSmartPointer<vtkPlusDeviceFactory> DeviceFactory;
 
   DeviceCollection Devices;
@@ -401,6 +401,23 @@ PlusStatus vtkPlusDataSource::ReadConfiguration(vtkXMLDataElement* sourceElement
     LOG_DEBUG("AveragedItemsForFiltering is not defined in source element \"" << this->GetId() << "\". Using default value: " << this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  const char* timestampFilteringMethod = sourceElement->GetAttribute("TimestampFilteringMethod");
+  if (timestampFilteringMethod != NULL)
+  {
+    if (STRCASECMP(timestampFilteringMethod, "LINEAR_REGRESSION") == 0)
+    {
+      this->GetBuffer()->SetTimestampFilteringMethod(vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_LINEAR_REGRESSION);
+    }
+    else if (STRCASECMP(timestampFilteringMethod, "STREAMING") == 0)
+    {
+      this->GetBuffer()->SetTimestampFilteringMethod(vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_STREAMING);
+    }
+    else
+    {
+      LOG_WARNING("Unknown TimestampFilteringMethod \"" << timestampFilteringMethod << "\" in source element \"" << this->GetId() << "\". Valid values: LINEAR_REGRESSION, STREAMING.");
+    }
+  }
+
   std::string descName;
   if (!aDescriptiveNameForBuffer.empty())
   {
@@ -462,6 +479,12 @@ PlusStatus vtkPlusDataSource::WriteConfiguration(vtkXMLDataElement* aSourceEleme
     aSourceElement->SetIntAttribute("AveragedItemsForFiltering", this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  if (aSourceElement->GetAttribute("TimestampFilteringMethod") != NULL)
+  {
+    aSourceElement->SetAttribute("TimestampFilteringMethod",
+                                 this->GetBuffer()->GetTimestampFilteringMethod() == vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_STREAMING ? "STREAMING" : "LINEAR_REGRESSION");
+  }
+
   // Write custom properties
   if (this->CustomProperties.size() > 0)
   {
@@ -831,6 +854,12 @@ ItemStatus vtkPlusDataSource::GetStreamBufferItemFromTime(double time, StreamBuf
   return this->GetBuffer()->GetStreamBufferItemFromTime(time, bufferItem, interpolation);
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::GetTransformTimeSeries(double startTime, double endTime, PlusTransformTimeSeries& series, double resamplingPeriodSec/*=0.0*/)
+{
+  return this->GetBuffer()->GetTransformTimeSeries(startTime, endTime, series, resamplingPeriodSec);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value)
 {
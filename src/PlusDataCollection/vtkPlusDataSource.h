@@ -140,6 +140,8 @@ public:
   virtual ItemStatus GetOldestStreamBufferItem(StreamBufferItem* bufferItem);
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, vtkPlusBuffer::DataItemTemporalInterpolationType interpolation);
+  /*! Get all transforms in a time range as contiguous arrays, optionally resampled to a uniform time grid (see vtkPlusBuffer::GetTransformTimeSeries) */
+  virtual PlusStatus GetTransformTimeSeries(double startTime, double endTime, PlusTransformTimeSeries& series, double resamplingPeriodSec = 0.0);
   /*! Update a field in the specified stream buffer item */
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
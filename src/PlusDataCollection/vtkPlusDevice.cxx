@@ -6,6 +6,8 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusAcquisitionScheduler.h"
+#include "PlusClock.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
@@ -139,6 +141,13 @@ vtkPlusDevice::vtkPlusDevice()
   , OutputNeedsInitialization(1)
   , CorrectlyConfigured(true)
   , StartThreadForInternalUpdates(false)
+  , UseAcquisitionScheduler(false)
+  , AcquisitionSchedulerPriority(0)
+  , AcquisitionSchedulerCpuAffinity(-1)
+  , AcquisitionTaskScheduled(false)
+  , ScheduledUpdateCount(0)
+  , ExternalUpdateStepping(false)
+  , ExternalUpdateSteppingActive(false)
   , LocalTimeOffsetSec(0.0)
   , MissingInputGracePeriodSec(0.0)
   , RequireImageOrientationInConfiguration(false)
@@ -199,6 +208,11 @@ void vtkPlusDevice::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Connected: " << (this->Connected ? "Yes\n" : "No\n");
   os << indent << "SDK version: " << this->GetSdkVersion() << std::endl;
   os << indent << "AcquisitionRate: " << this->AcquisitionRate << std::endl;
+  if (this->UseAcquisitionScheduler)
+  {
+    os << indent << "AcquisitionSchedulerPriority: " << this->AcquisitionSchedulerPriority << std::endl;
+    os << indent << "AcquisitionSchedulerCpuAffinity: " << this->AcquisitionSchedulerCpuAffinity << std::endl;
+  }
   os << indent << "Recording: " << (this->Recording ? "On\n" : "Off\n");
 
   for (ChannelContainerConstIterator it = this->OutputChannels.begin(); it != this->OutputChannels.end(); ++it)
@@ -1103,6 +1117,10 @@ PlusStatus vtkPlusDevice::ReadConfiguration(vtkXMLDataElement* rootXMLElement)
     LOCAL_LOG_DEBUG("Local time offset was not defined in device configuration");
   }
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseAcquisitionScheduler, deviceXMLElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, AcquisitionSchedulerPriority, deviceXMLElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, AcquisitionSchedulerCpuAffinity, deviceXMLElement);
+
   // Parameter reading
   XML_FIND_NESTED_ELEMENT_OPTIONAL(parametersElem, deviceXMLElement, vtkPlusDevice::PARAMETERS_XML_ELEMENT_TAG.c_str());
   if (parametersElem)
@@ -1201,6 +1219,13 @@ PlusStatus vtkPlusDevice::WriteConfiguration(vtkXMLDataElement* config)
     deviceDataElement->SetDoubleAttribute("LocalTimeOffsetSec", this->GetLocalTimeOffsetSec());
   }
 
+  if (this->UseAcquisitionScheduler)
+  {
+    deviceDataElement->SetAttribute("UseAcquisitionScheduler", "TRUE");
+    deviceDataElement->SetIntAttribute("AcquisitionSchedulerPriority", this->AcquisitionSchedulerPriority);
+    deviceDataElement->SetIntAttribute("AcquisitionSchedulerCpuAffinity", this->AcquisitionSchedulerCpuAffinity);
+  }
+
   // Parameters writing
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(parameterList, deviceDataElement, PARAMETERS_XML_ELEMENT_TAG.c_str());
 
@@ -1295,10 +1320,29 @@ PlusStatus vtkPlusDevice::StartRecording()
     return PLUS_FAIL;
   }
 
-  this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->RecordingStartTime = PlusClock::GetTime();
   this->Recording = 1;
 
-  if (this->StartThreadForInternalUpdates)
+  this->ExternalUpdateSteppingActive = this->StartThreadForInternalUpdates && this->ExternalUpdateStepping;
+  if (this->ExternalUpdateSteppingActive)
+  {
+    LOCAL_LOG_DEBUG("Internal updates are stepped externally, no data capture thread is started");
+  }
+  else if (this->StartThreadForInternalUpdates && this->UseAcquisitionScheduler)
+  {
+    this->ScheduledUpdateTimes.assign(FRAME_RATE_AVERAGING, 0.0);
+    this->ScheduledUpdateCount = 0;
+    if (PlusAcquisitionScheduler::GetInstance()->AddTask(this->DeviceId, 1.0 / this->GetAcquisitionRate(), this->AcquisitionSchedulerPriority,
+        this->AcquisitionSchedulerCpuAffinity, [this]() { this->ScheduledInternalUpdate(); }) == PLUS_SUCCESS)
+    {
+      this->AcquisitionTaskScheduled = true;
+    }
+    else
+    {
+      LOCAL_LOG_WARNING("Failed to add device to the acquisition scheduler, a dedicated data capture thread is used instead");
+    }
+  }
+  if (this->StartThreadForInternalUpdates && !this->AcquisitionTaskScheduled && !this->ExternalUpdateSteppingActive)
   {
     this->ThreadId =
       this->Threader->SpawnThread((vtkThreadFunctionType)\
@@ -1325,7 +1369,19 @@ PlusStatus vtkPlusDevice::StopRecording()
 
   this->Recording = 0;
 
-  if (this->GetStartThreadForInternalUpdates())
+  if (this->ExternalUpdateSteppingActive)
+  {
+    // Wait for the ongoing external update (if any) to complete
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->UpdateMutex);
+    this->ExternalUpdateSteppingActive = false;
+  }
+  else if (this->AcquisitionTaskScheduled)
+  {
+    // Returns when the scheduled update is completed
+    PlusAcquisitionScheduler::GetInstance()->RemoveTask(this->DeviceId);
+    this->AcquisitionTaskScheduled = false;
+  }
+  else if (this->GetStartThreadForInternalUpdates())
   {
     LOCAL_LOG_DEBUG("Wait for internal update thread to terminate");
     // Let's give a chance to the thread to stop before we kill the connection
@@ -1397,6 +1453,38 @@ void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
   return NULL;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusDevice::ScheduledInternalUpdate()
+{
+  if (!this->IsRecording() || !this->GetCorrectlyConfigured())
+  {
+    return;
+  }
+
+  double newtime = vtkIGSIOAccurateTimer::GetSystemTime();
+  // get current tracking rate over last few updates
+  double difftime = newtime - this->ScheduledUpdateTimes[this->ScheduledUpdateCount % FRAME_RATE_AVERAGING];
+  this->ScheduledUpdateTimes[this->ScheduledUpdateCount % FRAME_RATE_AVERAGING] = newtime;
+  if (this->ScheduledUpdateCount > FRAME_RATE_AVERAGING && difftime != 0)
+  {
+    this->InternalUpdateRate = (FRAME_RATE_AVERAGING / difftime);
+  }
+
+  {
+    // Lock before update
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->UpdateMutex);
+    if (!this->Recording)
+    {
+      // recording has been stopped
+      return;
+    }
+    this->InternalUpdate();
+    this->UpdateTime.Modified();
+  }
+
+  this->ScheduledUpdateCount++;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::InternalConnect()
 {
@@ -2309,6 +2397,18 @@ ChannelContainerIterator vtkPlusDevice::GetOutputChannelsEnd()
   return this->OutputChannels.end();
 }
 
+//----------------------------------------------------------------------------
+ChannelContainerConstIterator vtkPlusDevice::GetInputChannelsStart() const
+{
+  return this->InputChannels.begin();
+}
+
+//----------------------------------------------------------------------------
+ChannelContainerConstIterator vtkPlusDevice::GetInputChannelsEnd() const
+{
+  return this->InputChannels.end();
+}
+
 //------------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::GetToolReferenceFrameFromTrackedFrame(igsioTrackedFrame& aFrame, std::string& aToolReferenceFrameName)
 {
@@ -2382,7 +2482,7 @@ void vtkPlusDevice::SetDataCollector(vtkPlusDataCollector* _arg)
 //------------------------------------------------------------------------------
 bool vtkPlusDevice::HasGracePeriodExpired()
 {
-  return (vtkIGSIOAccurateTimer::GetSystemTime() - this->RecordingStartTime) > this->MissingInputGracePeriodSec;
+  return (PlusClock::GetTime() - this->RecordingStartTime) > this->MissingInputGracePeriodSec;
 }
 
 //----------------------------------------------------------------------------
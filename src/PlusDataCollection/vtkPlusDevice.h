@@ -162,6 +162,29 @@ public:
   /*! Get the internal update rate for this tracking system.  This is the number of buffer entry items sent by the device per second (per tool). */
   double GetInternalUpdateRate() const;
 
+  /*!
+    If enabled then the InternalUpdate polling of this device (see StartThreadForInternalUpdates) is performed by the
+    shared PlusAcquisitionScheduler (using absolute deadlines) instead of a dedicated thread.
+  */
+  vtkSetMacro(UseAcquisitionScheduler, bool);
+  vtkGetMacro(UseAcquisitionScheduler, bool);
+  /*! Priority of the device in the acquisition scheduler. If multiple devices are due then the one with the highest priority is updated first. */
+  vtkSetMacro(AcquisitionSchedulerPriority, int);
+  vtkGetMacro(AcquisitionSchedulerPriority, int);
+  /*! Index of the CPU core where the scheduled updates are executed. -1 means any core. */
+  vtkSetMacro(AcquisitionSchedulerCpuAffinity, int);
+  vtkGetMacro(AcquisitionSchedulerCpuAffinity, int);
+
+  /*!
+    If enabled then StartRecording does not start the InternalUpdate polling (data capture thread or acquisition scheduler task),
+    the device is updated by explicit ForceUpdate() calls instead. Used by vtkPlusDataCollector for virtual clock replay.
+    Must be set before StartRecording is called.
+  */
+  vtkSetMacro(ExternalUpdateStepping, bool);
+  vtkGetMacro(ExternalUpdateStepping, bool);
+  /*! Returns true if the device is recording and its InternalUpdate has to be called by ForceUpdate() (see ExternalUpdateStepping) */
+  bool IsExternalUpdateSteppingActive() const { return this->ExternalUpdateSteppingActive; }
+
   /*! Get the data source object for the specified Id name, checks both video and tools */
   PlusStatus GetDataSource(const char* aSourceId, vtkPlusDataSource*& aSource);
   PlusStatus GetDataSource(const std::string& aSourceId, vtkPlusDataSource*& aSource);
@@ -396,6 +419,10 @@ public:
   /*! Add an input channel */
   PlusStatus AddInputChannel(vtkPlusChannel* aChannel);
 
+  /*! Access the input channels */
+  ChannelContainerConstIterator GetInputChannelsStart() const;
+  ChannelContainerConstIterator GetInputChannelsEnd() const;
+
   /*!
   Perform any completion tasks once configured
   */
@@ -445,6 +472,9 @@ public:
 protected:
   static void* vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data);
 
+  /*! Called by the acquisition scheduler (instead of the data capture thread) if UseAcquisitionScheduler is enabled */
+  void ScheduledInternalUpdate();
+
   /*! Should be overridden to connect to the hardware */
   virtual PlusStatus InternalConnect();
 
@@ -587,6 +617,21 @@ protected:
   */
   bool StartThreadForInternalUpdates;
 
+  /*! Use the shared acquisition scheduler instead of a dedicated data capture thread */
+  bool UseAcquisitionScheduler;
+  int AcquisitionSchedulerPriority;
+  int AcquisitionSchedulerCpuAffinity;
+  /*! True if the device is currently updated by the acquisition scheduler */
+  bool AcquisitionTaskScheduled;
+  /*! Update times for computing InternalUpdateRate in scheduled updates */
+  std::vector<double> ScheduledUpdateTimes;
+  unsigned long ScheduledUpdateCount;
+
+  /*! InternalUpdate is called by ForceUpdate() only, no polling is started */
+  bool ExternalUpdateStepping;
+  /*! True if the polling was not started by StartRecording because ExternalUpdateStepping was enabled */
+  bool ExternalUpdateSteppingActive;
+
   /*! Value to use when mixing data with another temporally calibrated device*/
   double LocalTimeOffsetSec;
 
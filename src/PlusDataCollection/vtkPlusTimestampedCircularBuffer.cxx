@@ -12,8 +12,18 @@ See License.txt for details.
 #include "vtkTable.h"
 #include "vtkVariantArray.h"
 
+#include <algorithm>
+
 vtkStandardNewMacro(vtkPlusTimestampedCircularBuffer);
 
+namespace
+{
+  // The streaming timestamp filter excludes an item from the line fitting if its unfiltered timestamp differs
+  // from the fitted line by more than this factor times the current jitter (but at least by the minimum threshold)
+  const double STREAMING_FILTER_OUTLIER_REJECTION_FACTOR = 4.0;
+  const double STREAMING_FILTER_MINIMUM_OUTLIER_THRESHOLD_SEC = 0.002;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   : Mutex(vtkIGSIORecursiveCriticalSection::New())
@@ -23,6 +33,25 @@ vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   , LocalTimeOffsetSec(0.0)
   , LatestItemUid(0)
   , AveragedItemsForFiltering(20)
+  , TimestampFilteringMethod(TIMESTAMP_FILTERING_LINEAR_REGRESSION)
+  , StreamingFilterReferenceX(0.0)
+  , StreamingFilterReferenceY(0.0)
+  , StreamingFilterSumX(0.0)
+  , StreamingFilterSumY(0.0)
+  , StreamingFilterSumXX(0.0)
+  , StreamingFilterSumXY(0.0)
+  , StreamingFilterSumYY(0.0)
+  , StreamingFilterSlope(0.0)
+  , StreamingFilterIntercept(0.0)
+  , StreamingFilterLineValid(false)
+  , StreamingFilterUsesHardwareTimestamps(false)
+  , StreamingFilterLastX(0.0)
+  , StreamingFilterAverageHardwareTimestampDifference(0.0)
+  , StreamingFilterNumberOfConsecutiveOutliers(0)
+  , EstimatedFramePeriodSec(0.0)
+  , EstimatedClockDriftPpm(0.0)
+  , TimestampJitterSec(0.0)
+  , NumberOfTimestampOutliers(0)
   , MaxAllowedFilteringTimeDifference(0.5)
   , TimeStampReportTable(NULL)
   , TimeStampReporting(false)
@@ -406,10 +435,25 @@ void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer
   this->LatestItemUid = buffer->LatestItemUid;
   this->StartTime = buffer->StartTime;
   this->AveragedItemsForFiltering = buffer->AveragedItemsForFiltering;
+  this->TimestampFilteringMethod = buffer->TimestampFilteringMethod;
   this->FilterContainersNumberOfValidElements = buffer->FilterContainersNumberOfValidElements;
   this->FilterContainersOldestIndex = buffer->FilterContainersOldestIndex;
   this->FilterContainerTimestampVector = buffer->FilterContainerTimestampVector;
   this->FilterContainerIndexVector = buffer->FilterContainerIndexVector;
+  this->StreamingFilterReferenceX = buffer->StreamingFilterReferenceX;
+  this->StreamingFilterReferenceY = buffer->StreamingFilterReferenceY;
+  this->StreamingFilterSumX = buffer->StreamingFilterSumX;
+  this->StreamingFilterSumY = buffer->StreamingFilterSumY;
+  this->StreamingFilterSumXX = buffer->StreamingFilterSumXX;
+  this->StreamingFilterSumXY = buffer->StreamingFilterSumXY;
+  this->StreamingFilterSumYY = buffer->StreamingFilterSumYY;
+  this->StreamingFilterSlope = buffer->StreamingFilterSlope;
+  this->StreamingFilterIntercept = buffer->StreamingFilterIntercept;
+  this->StreamingFilterLineValid = buffer->StreamingFilterLineValid;
+  this->StreamingFilterUsesHardwareTimestamps = buffer->StreamingFilterUsesHardwareTimestamps;
+  this->StreamingFilterLastX = buffer->StreamingFilterLastX;
+  this->StreamingFilterAverageHardwareTimestampDifference = buffer->StreamingFilterAverageHardwareTimestampDifference;
+  this->StreamingFilterNumberOfConsecutiveOutliers = buffer->StreamingFilterNumberOfConsecutiveOutliers;
 
   this->BufferItemContainer = buffer->BufferItemContainer;
   this->Unlock();
@@ -523,10 +567,37 @@ double vtkPlusTimestampedCircularBuffer::GetFrameRate(bool ideal /*=false*/, dou
   return frameRate;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::SetTimestampFilteringMethod(TimestampFilteringMethodType method)
+{
+  this->Lock();
+  if (this->TimestampFilteringMethod != method)
+  {
+    this->TimestampFilteringMethod = method;
+    this->ResetTimestampFilter();
+  }
+  this->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::ResetTimestampFilter()
+{
+  this->FilterContainersOldestIndex = 0;
+  this->FilterContainersNumberOfValidElements = 0;
+  this->StreamingFilterSumX = 0.0;
+  this->StreamingFilterSumY = 0.0;
+  this->StreamingFilterSumXX = 0.0;
+  this->StreamingFilterSumXY = 0.0;
+  this->StreamingFilterSumYY = 0.0;
+  this->StreamingFilterLineValid = false;
+  this->StreamingFilterAverageHardwareTimestampDifference = 0.0;
+  this->StreamingFilterNumberOfConsecutiveOutliers = 0;
+}
+
 //----------------------------------------------------------------------------
 // for accurate timing of the frame: an exponential moving average
 // is computed to smooth out the jitter in the times that are returned by the system clock:
-PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid)
+PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid, double inHardwareTimestamp/*=UNDEFINED_TIMESTAMP*/)
 {
   this->Lock();
   filteredTimestampProbablyValid = true;
@@ -537,10 +608,36 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
     // this call set elements to null
     this->FilterContainerIndexVector.set_size(this->AveragedItemsForFiltering);
     this->FilterContainerTimestampVector.set_size(this->AveragedItemsForFiltering);
-    this->FilterContainersOldestIndex = 0;
-    this->FilterContainersNumberOfValidElements = 0;
+    this->ResetTimestampFilter();
+  }
+
+  if (this->TimestampFilteringMethod == TIMESTAMP_FILTERING_STREAMING)
+  {
+    this->CreateFilteredTimeStampStreaming(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp, filteredTimestampProbablyValid, inHardwareTimestamp);
+  }
+  else
+  {
+    this->CreateFilteredTimeStampLinearRegression(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp, filteredTimestampProbablyValid);
+  }
+
+  AddToTimeStampReport(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp);
+
+  if (!filteredTimestampProbablyValid)
+  {
+    // Write current timestamps and frame indexes to the log to allow investigation of the problem
+    LOG_DEBUG("Difference between unfiltered timestamp is larger than the threshold. The unfiltered timestamp may be incorrect."
+              << " Unfiltered timestamp: " << inUnfilteredTimestamp << ", filtered timestamp: " << outFilteredTimestamp << ", difference: " << fabs(outFilteredTimestamp - inUnfilteredTimestamp) << ", threshold: " << this->MaxAllowedFilteringTimeDifference << "."
+              << " timestamps = [" << std::fixed << this->FilterContainerTimestampVector << "];"
+              << " frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
   }
 
+  this->Unlock();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampLinearRegression(unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid)
+{
   // We store the last AveragedItemsForFiltering unfiltered timestamp and item indexes, because these are used for computing the filtered timestamp.
   if (this->AveragedItemsForFiltering > 1)
   {
@@ -564,9 +661,7 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   if (this->AveragedItemsForFiltering < 2 || this->FilterContainersNumberOfValidElements < this->AveragedItemsForFiltering)
   {
     outFilteredTimestamp = inUnfilteredTimestamp;
-    AddToTimeStampReport(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp);
-    this->Unlock();
-    return PLUS_SUCCESS;
+    return;
   }
 
   // The items are acquired periodically, with quite accurate frame periods. The data is not timestamped
@@ -595,37 +690,229 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   double yMean = this->FilterContainerTimestampVector.mean();
   double covarianceXY = 0;
   double varianceX = 0;
+  double varianceY = 0;
   for (int i = this->FilterContainerTimestampVector.size() - 1; i >= 0; i--)
   {
     double xiMinusXmean = (this->FilterContainerIndexVector(i) - xMean);
-    covarianceXY += xiMinusXmean * (this->FilterContainerTimestampVector(i) - yMean);
+    double yiMinusYmean = (this->FilterContainerTimestampVector(i) - yMean);
+    covarianceXY += xiMinusXmean * yiMinusYmean;
     varianceX += xiMinusXmean * xiMinusXmean;
+    varianceY += yiMinusYmean * yiMinusYmean;
   }
   double a = covarianceXY / varianceX;
   double b = yMean - a * xMean;
 
   outFilteredTimestamp = a * itemIndex + b;
 
+  this->EstimatedFramePeriodSec = a;
+  double sumSquaredResiduals = varianceY - a * covarianceXY;
+  this->TimestampJitterSec = (sumSquaredResiduals > 0 ? sqrt(sumSquaredResiduals / this->FilterContainerTimestampVector.size()) : 0.0);
+
   if (this->TimeStampLogging)
   {
     LOG_TRACE("timestamps = [" << std::fixed << this->FilterContainerTimestampVector << "];");
     LOG_TRACE("frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
   }
 
-  AddToTimeStampReport(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp);
+  if (fabs(outFilteredTimestamp - inUnfilteredTimestamp) > this->MaxAllowedFilteringTimeDifference)
+  {
+    filteredTimestampProbablyValid = false;
+  }
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampStreaming(unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid, double inHardwareTimestamp)
+{
+  // Same line model as in CreateFilteredTimeStampLinearRegression, but instead of recomputing the means and covariances
+  // from all the stored items, running sums are updated: the new item is added and the oldest one is subtracted.
+  // The sums are recomputed from the stored items each time the containers wrap around, which keeps the
+  // round-off error bounded and the amortized cost constant.
+  //
+  // If the device provides hardware timestamps then x is the hardware timestamp instead of the item index.
+  // The slope of the line is then the rate of the system clock compared to the device clock (1 + drift) and
+  // the filtered timestamps are not affected by missing item indexes or irregular acquisition.
+  //
+  // Items that are far from the current line (e.g., delayed by the operating system) are not added to the
+  // sums, so that they do not distort the filtered timestamps of the following items.
+
+  outFilteredTimestamp = inUnfilteredTimestamp;
+  if (this->AveragedItemsForFiltering < 2)
+  {
+    return;
+  }
+
+  bool useHardwareTimestamp = (inHardwareTimestamp != UNDEFINED_TIMESTAMP);
+  double x = useHardwareTimestamp ? inHardwareTimestamp : static_cast<double>(itemIndex);
+  if (useHardwareTimestamp != this->StreamingFilterUsesHardwareTimestamps)
+  {
+    this->ResetTimestampFilter();
+    this->StreamingFilterUsesHardwareTimestamps = useHardwareTimestamp;
+  }
+  if (this->FilterContainersNumberOfValidElements > 0 && x <= this->StreamingFilterLastX)
+  {
+    // Index or hardware clock is not increasing (e.g., the device was restarted), the stored items cannot be used anymore
+    LOG_DEBUG("Timestamp filter is reset, because the item index or hardware timestamp is not increasing (previous: " << std::fixed << this->StreamingFilterLastX << ", current: " << x << ")");
+    this->ResetTimestampFilter();
+  }
+  else if (this->FilterContainersNumberOfValidElements > 0 && useHardwareTimestamp)
+  {
+    // Moving average of the hardware clock difference between consecutive items (including outliers and missing items)
+    double hardwareTimestampDifference = x - this->StreamingFilterLastX;
+    if (this->StreamingFilterAverageHardwareTimestampDifference <= 0)
+    {
+      this->StreamingFilterAverageHardwareTimestampDifference = hardwareTimestampDifference;
+    }
+    else
+    {
+      this->StreamingFilterAverageHardwareTimestampDifference += (hardwareTimestampDifference - this->StreamingFilterAverageHardwareTimestampDifference) / this->AveragedItemsForFiltering;
+    }
+  }
+  this->StreamingFilterLastX = x;
+
+  if (this->StreamingFilterLineValid && this->FilterContainersNumberOfValidElements >= this->AveragedItemsForFiltering)
+  {
+    double predictedTimestamp = this->GetStreamingFilterLineValue(x);
+    double outlierThresholdSec = std::max(STREAMING_FILTER_OUTLIER_REJECTION_FACTOR * this->TimestampJitterSec, STREAMING_FILTER_MINIMUM_OUTLIER_THRESHOLD_SEC);
+    if (fabs(inUnfilteredTimestamp - predictedTimestamp) > outlierThresholdSec)
+    {
+      this->NumberOfTimestampOutliers++;
+      this->StreamingFilterNumberOfConsecutiveOutliers++;
+      if (this->StreamingFilterNumberOfConsecutiveOutliers < this->AveragedItemsForFiltering)
+      {
+        outFilteredTimestamp = predictedTimestamp;
+        if (fabs(outFilteredTimestamp - inUnfilteredTimestamp) > this->MaxAllowedFilteringTimeDifference)
+        {
+          filteredTimestampProbablyValid = false;
+        }
+        return;
+      }
+      // All the recent items are far from the line, so probably the line is wrong (e.g., the frame rate was changed), start over
+      LOG_DEBUG("Timestamp filter is reset, because the last " << this->StreamingFilterNumberOfConsecutiveOutliers << " items were outliers");
+      this->ResetTimestampFilter();
+    }
+    else
+    {
+      this->StreamingFilterNumberOfConsecutiveOutliers = 0;
+    }
+  }
+
+  if (this->FilterContainersNumberOfValidElements == 0)
+  {
+    this->StreamingFilterReferenceX = x;
+    this->StreamingFilterReferenceY = inUnfilteredTimestamp;
+  }
+
+  // Replace the oldest stored item by the new one
+  if (this->FilterContainersNumberOfValidElements >= this->AveragedItemsForFiltering)
+  {
+    double oldX = this->FilterContainerIndexVector(this->FilterContainersOldestIndex) - this->StreamingFilterReferenceX;
+    double oldY = this->FilterContainerTimestampVector(this->FilterContainersOldestIndex) - this->StreamingFilterReferenceY;
+    this->StreamingFilterSumX -= oldX;
+    this->StreamingFilterSumY -= oldY;
+    this->StreamingFilterSumXX -= oldX * oldX;
+    this->StreamingFilterSumXY -= oldX * oldY;
+    this->StreamingFilterSumYY -= oldY * oldY;
+  }
+  else
+  {
+    this->FilterContainersNumberOfValidElements++;
+  }
+  this->FilterContainerIndexVector(this->FilterContainersOldestIndex) = x;
+  this->FilterContainerTimestampVector(this->FilterContainersOldestIndex) = inUnfilteredTimestamp;
+  double newX = x - this->StreamingFilterReferenceX;
+  double newY = inUnfilteredTimestamp - this->StreamingFilterReferenceY;
+  this->StreamingFilterSumX += newX;
+  this->StreamingFilterSumY += newY;
+  this->StreamingFilterSumXX += newX * newX;
+  this->StreamingFilterSumXY += newX * newY;
+  this->StreamingFilterSumYY += newY * newY;
+
+  this->FilterContainersOldestIndex++;
+  if (this->FilterContainersOldestIndex >= this->AveragedItemsForFiltering)
+  {
+    this->FilterContainersOldestIndex = 0;
+    this->RecomputeStreamingFilterSums();
+  }
+
+  // Fit the line
+  double n = this->FilterContainersNumberOfValidElements;
+  double varianceX = this->StreamingFilterSumXX - this->StreamingFilterSumX * this->StreamingFilterSumX / n;
+  double covarianceXY = this->StreamingFilterSumXY - this->StreamingFilterSumX * this->StreamingFilterSumY / n;
+  double varianceY = this->StreamingFilterSumYY - this->StreamingFilterSumY * this->StreamingFilterSumY / n;
+  if (this->FilterContainersNumberOfValidElements < 2 || varianceX <= 0)
+  {
+    this->StreamingFilterLineValid = false;
+    return;
+  }
+  this->StreamingFilterSlope = covarianceXY / varianceX;
+  this->StreamingFilterIntercept = (this->StreamingFilterSumY - this->StreamingFilterSlope * this->StreamingFilterSumX) / n;
+  this->StreamingFilterLineValid = true;
+
+  double sumSquaredResiduals = varianceY - this->StreamingFilterSlope * covarianceXY;
+  this->TimestampJitterSec = (sumSquaredResiduals > 0 ? sqrt(sumSquaredResiduals / n) : 0.0);
+  if (this->StreamingFilterUsesHardwareTimestamps)
+  {
+    // Average hardware clock difference between consecutive items, converted to system time
+    this->EstimatedFramePeriodSec = this->StreamingFilterSlope * this->StreamingFilterAverageHardwareTimestampDifference;
+    this->EstimatedClockDriftPpm = (this->StreamingFilterSlope - 1.0) * 1e6;
+  }
+  else
+  {
+    this->EstimatedFramePeriodSec = this->StreamingFilterSlope;
+    this->EstimatedClockDriftPpm = 0.0;
+  }
+
+  if (this->TimeStampLogging)
+  {
+    LOG_TRACE("timestamps = [" << std::fixed << this->FilterContainerTimestampVector << "];");
+    LOG_TRACE("frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
+  }
+
+  // Same as in CreateFilteredTimeStampLinearRegression: unfiltered timestamps are used until the containers are filled
+  if (this->FilterContainersNumberOfValidElements < this->AveragedItemsForFiltering)
+  {
+    return;
+  }
+
+  outFilteredTimestamp = this->GetStreamingFilterLineValue(x);
   if (fabs(outFilteredTimestamp - inUnfilteredTimestamp) > this->MaxAllowedFilteringTimeDifference)
   {
-    // Write current timestamps and frame indexes to the log to allow investigation of the problem
     filteredTimestampProbablyValid = false;
-    LOG_DEBUG("Difference between unfiltered timestamp is larger than the threshold. The unfiltered timestamp may be incorrect."
-              << " Unfiltered timestamp: " << inUnfilteredTimestamp << ", filtered timestamp: " << outFilteredTimestamp << ", difference: " << fabs(outFilteredTimestamp - inUnfilteredTimestamp) << ", threshold: " << this->MaxAllowedFilteringTimeDifference << "."
-              << " timestamps = [" << std::fixed << this->FilterContainerTimestampVector << "];"
-              << " frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
   }
+}
 
-  this->Unlock();
-  return PLUS_SUCCESS;
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::RecomputeStreamingFilterSums()
+{
+  this->StreamingFilterSumX = 0.0;
+  this->StreamingFilterSumY = 0.0;
+  this->StreamingFilterSumXX = 0.0;
+  this->StreamingFilterSumXY = 0.0;
+  this->StreamingFilterSumYY = 0.0;
+  if (this->FilterContainersNumberOfValidElements == 0)
+  {
+    return;
+  }
+  // Use the oldest stored item as reference, so that the summed values remain small
+  unsigned int oldestIndex = (this->FilterContainersNumberOfValidElements < this->AveragedItemsForFiltering ? 0 : this->FilterContainersOldestIndex);
+  this->StreamingFilterReferenceX = this->FilterContainerIndexVector(oldestIndex);
+  this->StreamingFilterReferenceY = this->FilterContainerTimestampVector(oldestIndex);
+  for (unsigned int i = 0; i < this->FilterContainersNumberOfValidElements; i++)
+  {
+    double x = this->FilterContainerIndexVector(i) - this->StreamingFilterReferenceX;
+    double y = this->FilterContainerTimestampVector(i) - this->StreamingFilterReferenceY;
+    this->StreamingFilterSumX += x;
+    this->StreamingFilterSumY += y;
+    this->StreamingFilterSumXX += x * x;
+    this->StreamingFilterSumXY += x * y;
+    this->StreamingFilterSumYY += y * y;
+  }
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusTimestampedCircularBuffer::GetStreamingFilterLineValue(double x) const
+{
+  return this->StreamingFilterReferenceY + this->StreamingFilterIntercept + this->StreamingFilterSlope * (x - this->StreamingFilterReferenceX);
 }
 
 //----------------------------------------------------------------------------
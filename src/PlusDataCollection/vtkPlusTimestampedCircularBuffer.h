@@ -37,6 +37,15 @@ enum ItemStatus { ITEM_OK, ITEM_NOT_AVAILABLE_YET, ITEM_NOT_AVAILABLE_ANYMORE, I
 class vtkPlusTimestampedCircularBuffer: public vtkObject
 {
 public:
+  /*! Algorithm used for computing filtered timestamps from unfiltered timestamps */
+  enum TimestampFilteringMethodType
+  {
+    /*! A line is fitted to all the stored (index, timestamp) pairs for each new item */
+    TIMESTAMP_FILTERING_LINEAR_REGRESSION,
+    /*! The line is updated from running sums, outliers are excluded from the fit, hardware timestamps are used if available */
+    TIMESTAMP_FILTERING_STREAMING
+  };
+
   static vtkPlusTimestampedCircularBuffer* New();
   void PrintSelf( ostream& os, vtkIndent indent );
 
@@ -166,6 +175,12 @@ public:
   */
   virtual ItemStatus GetBufferItemPointerFromUid( const BufferItemUidType uid, StreamBufferItem*& itemPtr );
 
+  /*!
+    Get the index of the buffer object that the next PrepareForNewItem call will return
+    INTERNAL USE ONLY! Need to lock buffer until we use the buffer index
+  */
+  inline int GetNextWriteBufferIndex() { return this->WritePointer; };
+
   virtual PlusStatus PrepareForNewItem( const double timestamp, BufferItemUidType& newFrameUid, int& bufferIndex );
 
   /*!
@@ -177,8 +192,10 @@ public:
     If the filtered timestamp is very different from the non-filtered timestamp then
     filteredTimestampProbablyValid will be false and it is recommended not to use that item,
     because its timestamp is probably incorrect.
+    If the device provides a timestamp from its own clock (inHardwareTimestamp) and the streaming filtering method is used
+    then the line is fitted to the hardware and unfiltered timestamps instead, which also estimates the drift between the clocks.
   */
-  virtual PlusStatus CreateFilteredTimeStampForItem( unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid );
+  virtual PlusStatus CreateFilteredTimeStampForItem( unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid, double inHardwareTimestamp = UNDEFINED_TIMESTAMP );
 
   /*! Add values to the timestamp report. If reporting is not enabled then no values will be added. This should only be called if an item is added without calling CreateFilteredTimeStampForItem. */
   void AddToTimeStampReport( unsigned long itemIndex, double unfilteredTimestamp, double filteredTimestamp );
@@ -201,6 +218,22 @@ public:
   /*! Get number of items used for timestamp filtering (with LSQR mimimizer) */
   vtkGetMacro( AveragedItemsForFiltering, int );
 
+  /*! Set the algorithm used for computing filtered timestamps (default: TIMESTAMP_FILTERING_LINEAR_REGRESSION) */
+  virtual void SetTimestampFilteringMethod( TimestampFilteringMethodType method );
+  vtkGetMacro( TimestampFilteringMethod, TimestampFilteringMethodType );
+
+  /*! Average time between consecutive items, as estimated by the timestamp filter (in seconds, 0 if not available yet) */
+  vtkGetMacro( EstimatedFramePeriodSec, double );
+  /*!
+    Drift of the device clock compared to the system clock, as estimated by the timestamp filter (in parts per million).
+    Only available if the streaming filtering method is used and the device provides hardware timestamps, otherwise 0.
+  */
+  vtkGetMacro( EstimatedClockDriftPpm, double );
+  /*! Root mean square difference between the unfiltered timestamps and the fitted line (in seconds) */
+  vtkGetMacro( TimestampJitterSec, double );
+  /*! Number of items that the streaming filter excluded from the line fitting because their unfiltered timestamp was too far from the fitted line */
+  vtkGetMacro( NumberOfTimestampOutliers, unsigned int );
+
   /*! Set recording start time */
   vtkSetMacro( StartTime, double );
   /*! Get recording start time */
@@ -210,6 +243,21 @@ protected:
   vtkPlusTimestampedCircularBuffer();
   ~vtkPlusTimestampedCircularBuffer();
 
+  /*! Compute the filtered timestamp by fitting a line to all the stored items (O(AveragedItemsForFiltering) for each item) */
+  void CreateFilteredTimeStampLinearRegression( unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid );
+
+  /*! Compute the filtered timestamp from the running sums of the stored items (amortized O(1) for each item) */
+  void CreateFilteredTimeStampStreaming( unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid, double inHardwareTimestamp );
+
+  /*! Remove all stored items from the timestamp filter */
+  void ResetTimestampFilter();
+
+  /*! Recompute the running sums of the streaming filter from the stored items, relative to the oldest stored item */
+  void RecomputeStreamingFilterSums();
+
+  /*! Compute the timestamp on the line that is fitted by the streaming filter (x is the item index or hardware timestamp) */
+  double GetStreamingFilterLineValue( double x ) const;
+
 protected:
   vtkIGSIORecursiveCriticalSection* Mutex;
 
@@ -246,6 +294,42 @@ protected:
   /*! Number of averaged items used for filtering - read from config files */
   unsigned int AveragedItemsForFiltering;
 
+  TimestampFilteringMethodType TimestampFilteringMethod;
+
+  /*!
+    Running sums of the streaming filter. The stored x (item index or hardware timestamp) and y (unfiltered timestamp) values
+    are summed relative to a reference item (StreamingFilterReferenceX/Y) to prevent loss of precision.
+  */
+  double StreamingFilterReferenceX;
+  double StreamingFilterReferenceY;
+  double StreamingFilterSumX;
+  double StreamingFilterSumY;
+  double StreamingFilterSumXX;
+  double StreamingFilterSumXY;
+  double StreamingFilterSumYY;
+
+  /*! Parameters of the line fitted by the streaming filter: y - ReferenceY = Slope * (x - ReferenceX) + Intercept */
+  double StreamingFilterSlope;
+  double StreamingFilterIntercept;
+  bool StreamingFilterLineValid;
+
+  /*! True if the streaming filter uses hardware timestamps as x values */
+  bool StreamingFilterUsesHardwareTimestamps;
+
+  /*! x value of the most recently received item */
+  double StreamingFilterLastX;
+
+  /*! Moving average of the hardware timestamp difference between consecutive items */
+  double StreamingFilterAverageHardwareTimestampDifference;
+
+  /*! Number of consecutive items that were excluded from the fitting as outliers */
+  unsigned int StreamingFilterNumberOfConsecutiveOutliers;
+
+  double EstimatedFramePeriodSec;
+  double EstimatedClockDriftPpm;
+  double TimestampJitterSec;
+  unsigned int NumberOfTimestampOutliers;
+
   /*!
     Maximum time difference that is allowed between filtered and the non-filtered timestamp (in seconds).
     If the filtered value differs too much from the non-filtered one, then it rejects the filtering result.
@@ -0,0 +1,302 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMetrics.h"
+#include "PlusModelAssetCache.h"
+
+// VTK includes
+#include <vtkAbstractPolyDataReader.h>
+#include <vtkOBJReader.h>
+#include <vtkPLYReader.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataReader.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkSTLReader.h>
+#include <vtkTriangleFilter.h>
+#include <vtkXMLPolyDataReader.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  const unsigned int DEFAULT_MAXIMUM_NUMBER_OF_MODELS = 32;
+}
+
+//----------------------------------------------------------------------------
+PlusModelAssetCache::PlusModelAssetCache()
+  : MaximumNumberOfModels(DEFAULT_MAXIMUM_NUMBER_OF_MODELS)
+  , AccessCounter(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusModelAssetCache* PlusModelAssetCache::GetInstance()
+{
+  // Intentionally never deleted: cached VTK objects must not be released during static deinitialization
+  static PlusModelAssetCache* instance = new PlusModelAssetCache;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+void PlusModelAssetCache::SetMaximumNumberOfModels(unsigned int maximumNumberOfModels)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MaximumNumberOfModels = maximumNumberOfModels;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusModelAssetCache::GetMaximumNumberOfModels() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->MaximumNumberOfModels;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusModelAssetCache::GetNumberOfModels() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return static_cast<unsigned int>(this->Entries.size());
+}
+
+//----------------------------------------------------------------------------
+void PlusModelAssetCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->Entries.clear();
+  PLUS_METRIC_GAUGE_SET("plus_model_asset_cache_models", "", 0);
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> PlusModelAssetCache::GetPolyData(const std::string& absoluteFilePath, double targetReduction)
+{
+  std::shared_ptr<ModelEntry> entry = this->GetEntry(absoluteFilePath);
+  std::lock_guard<std::mutex> lock(entry->Mutex);
+  if (this->UpdateEntry(*entry, absoluteFilePath) != PLUS_SUCCESS)
+  {
+    return nullptr;
+  }
+  return this->GetVariant(*entry, GetReductionPercent(targetReduction));
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkObject> PlusModelAssetCache::GetDerivedAsset(const std::string& absoluteFilePath, const std::string& assetName, AssetFactory factory, double targetReduction)
+{
+  std::shared_ptr<ModelEntry> entry = this->GetEntry(absoluteFilePath);
+  std::lock_guard<std::mutex> lock(entry->Mutex);
+  if (this->UpdateEntry(*entry, absoluteFilePath) != PLUS_SUCCESS)
+  {
+    return nullptr;
+  }
+
+  int reductionPercent = GetReductionPercent(targetReduction);
+  std::pair<int, std::string> assetKey(reductionPercent, assetName);
+  std::map<std::pair<int, std::string>, vtkSmartPointer<vtkObject> >::iterator assetIt = entry->Assets.find(assetKey);
+  if (assetIt != entry->Assets.end())
+  {
+    return assetIt->second;
+  }
+
+  vtkSmartPointer<vtkPolyData> polyData = this->GetVariant(*entry, reductionPercent);
+  if (polyData == NULL)
+  {
+    return nullptr;
+  }
+  vtkSmartPointer<vtkObject> asset = factory(polyData);
+  if (asset == NULL)
+  {
+    LOG_WARNING("Failed to create asset " << assetName << " for model " << absoluteFilePath);
+    return nullptr;
+  }
+  entry->Assets[assetKey] = asset;
+  return asset;
+}
+
+//----------------------------------------------------------------------------
+std::shared_ptr<PlusModelAssetCache::ModelEntry> PlusModelAssetCache::GetEntry(const std::string& absoluteFilePath)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::shared_ptr<ModelEntry>& entry = this->Entries[absoluteFilePath];
+  if (!entry)
+  {
+    entry = std::make_shared<ModelEntry>();
+  }
+  entry->LastAccess = ++this->AccessCounter;
+  std::shared_ptr<ModelEntry> requestedEntry = entry;
+
+  // Entries that are removed here may still be used by other threads, they are deleted when those are done
+  while (this->MaximumNumberOfModels > 0 && this->Entries.size() > this->MaximumNumberOfModels)
+  {
+    std::map<std::string, std::shared_ptr<ModelEntry> >::iterator leastRecentlyUsedIt = this->Entries.end();
+    for (std::map<std::string, std::shared_ptr<ModelEntry> >::iterator entryIt = this->Entries.begin(); entryIt != this->Entries.end(); ++entryIt)
+    {
+      if (entryIt->second != requestedEntry && (leastRecentlyUsedIt == this->Entries.end() || entryIt->second->LastAccess < leastRecentlyUsedIt->second->LastAccess))
+      {
+        leastRecentlyUsedIt = entryIt;
+      }
+    }
+    LOG_DEBUG("Remove model from the asset cache: " << leastRecentlyUsedIt->first);
+    this->Entries.erase(leastRecentlyUsedIt);
+  }
+
+  PLUS_METRIC_GAUGE_SET("plus_model_asset_cache_models", "", static_cast<double>(this->Entries.size()));
+  return requestedEntry;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusModelAssetCache::UpdateEntry(ModelEntry& entry, const std::string& absoluteFilePath)
+{
+  if (!vtksys::SystemTools::FileExists(absoluteFilePath, true))
+  {
+    LOG_ERROR("Model file not found: " << absoluteFilePath);
+    entry.Loaded = false;
+    entry.Variants.clear();
+    entry.Assets.clear();
+    return PLUS_FAIL;
+  }
+
+  long modifiedTime = vtksys::SystemTools::ModifiedTime(absoluteFilePath);
+  unsigned long fileSize = vtksys::SystemTools::FileLength(absoluteFilePath);
+  if (entry.Loaded && entry.ModifiedTime == modifiedTime && entry.FileSize == fileSize)
+  {
+    PLUS_METRIC_COUNTER_ADD("plus_model_asset_cache_hits_total", "", 1);
+    return PLUS_SUCCESS;
+  }
+
+  if (entry.Loaded)
+  {
+    LOG_INFO("Model file has changed, reading it again: " << absoluteFilePath);
+  }
+  PLUS_METRIC_COUNTER_ADD("plus_model_asset_cache_misses_total", "", 1);
+  entry.Loaded = false;
+  entry.Variants.clear();
+  entry.Assets.clear();
+
+  vtkSmartPointer<vtkPolyData> polyData = ReadModelFile(absoluteFilePath);
+  if (polyData == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  entry.Variants[0] = polyData;
+  entry.ModifiedTime = modifiedTime;
+  entry.FileSize = fileSize;
+  entry.Loaded = true;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> PlusModelAssetCache::GetVariant(ModelEntry& entry, int reductionPercent)
+{
+  std::map<int, vtkSmartPointer<vtkPolyData> >::iterator variantIt = entry.Variants.find(reductionPercent);
+  if (variantIt != entry.Variants.end())
+  {
+    return variantIt->second;
+  }
+
+  // Decimation requires a triangle mesh
+  vtkSmartPointer<vtkTriangleFilter> triangleFilter = vtkSmartPointer<vtkTriangleFilter>::New();
+  triangleFilter->SetInputData(entry.Variants[0]);
+  vtkSmartPointer<vtkQuadricDecimation> decimation = vtkSmartPointer<vtkQuadricDecimation>::New();
+  decimation->SetInputConnection(triangleFilter->GetOutputPort());
+  decimation->SetTargetReduction(reductionPercent / 100.0);
+  decimation->Update();
+
+  vtkSmartPointer<vtkPolyData> polyData = decimation->GetOutput();
+  if (polyData == NULL || polyData->GetNumberOfPoints() == 0)
+  {
+    LOG_ERROR("Failed to decimate model with target reduction " << reductionPercent << "%");
+    return nullptr;
+  }
+  LOG_DEBUG("Decimated model with target reduction " << reductionPercent << "%: " << entry.Variants[0]->GetNumberOfCells() << " -> " << polyData->GetNumberOfCells() << " cells");
+  entry.Variants[reductionPercent] = polyData;
+  return polyData;
+}
+
+//----------------------------------------------------------------------------
+int PlusModelAssetCache::GetReductionPercent(double targetReduction)
+{
+  if (targetReduction <= 0.0)
+  {
+    return 0;
+  }
+  int reductionPercent = static_cast<int>(std::floor(targetReduction * 100.0 + 0.5));
+  return std::min(reductionPercent, 99);
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> PlusModelAssetCache::ReadModelFile(const std::string& absoluteFilePath)
+{
+  std::string fileExt = vtksys::SystemTools::GetFilenameLastExtension(absoluteFilePath);
+  vtkSmartPointer<vtkPolyData> polyData;
+  if (igsioCommon::IsEqualInsensitive(fileExt, ".vtp"))
+  {
+    vtkSmartPointer<vtkXMLPolyDataReader> reader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
+    reader->SetFileName(absoluteFilePath.c_str());
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (igsioCommon::IsEqualInsensitive(fileExt, ".stl"))
+  {
+    vtkSmartPointer<vtkSTLReader> reader = vtkSmartPointer<vtkSTLReader>::New();
+    reader->SetFileName(absoluteFilePath.c_str());
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (igsioCommon::IsEqualInsensitive(fileExt, ".obj"))
+  {
+    vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+    reader->SetFileName(absoluteFilePath.c_str());
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (igsioCommon::IsEqualInsensitive(fileExt, ".ply"))
+  {
+    vtkSmartPointer<vtkPLYReader> reader = vtkSmartPointer<vtkPLYReader>::New();
+    reader->SetFileName(absoluteFilePath.c_str());
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else
+  {
+    // Legacy VTK file or unknown extension: use the legacy reader if the file content is recognized, otherwise try the other readers
+    vtkSmartPointer<vtkPolyDataReader> legacyReader = vtkSmartPointer<vtkPolyDataReader>::New();
+    legacyReader->SetFileName(absoluteFilePath.c_str());
+    if (legacyReader->IsFilePolyData())
+    {
+      legacyReader->Update();
+      polyData = legacyReader->GetOutput();
+    }
+    else
+    {
+      vtkSmartPointer<vtkAbstractPolyDataReader> readers[] =
+      {
+        vtkSmartPointer<vtkSTLReader>::New(),
+        vtkSmartPointer<vtkOBJReader>::New(),
+        vtkSmartPointer<vtkPLYReader>::New()
+      };
+      for (unsigned int i = 0; i < sizeof(readers) / sizeof(readers[0]); ++i)
+      {
+        readers[i]->SetFileName(absoluteFilePath.c_str());
+        readers[i]->Update();
+        if (readers[i]->GetErrorCode() == 0 && readers[i]->GetOutput() != NULL && readers[i]->GetOutput()->GetNumberOfPoints() > 0)
+        {
+          polyData = readers[i]->GetOutput();
+          break;
+        }
+      }
+    }
+  }
+
+  if (polyData == NULL || polyData->GetNumberOfPoints() == 0)
+  {
+    LOG_ERROR("Failed to read model file or the model contains no points: " << absoluteFilePath);
+    return nullptr;
+  }
+  LOG_DEBUG("Model read into the asset cache: " << absoluteFilePath << " (" << polyData->GetNumberOfPoints() << " points, " << polyData->GetNumberOfCells() << " cells)");
+  return polyData;
+}
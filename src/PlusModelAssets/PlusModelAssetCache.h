@@ -0,0 +1,121 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusModelAssetCache_h
+#define __PlusModelAssetCache_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusModelAssetsExport.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class vtkObject;
+class vtkPolyData;
+
+/*!
+  \class PlusModelAssetCache
+  \brief Process-wide cache of surface models and of the data structures that are derived from them
+
+  Model files (.vtk, .vtp, .stl, .obj, .ply) are read only once and the parsed mesh is shared by all users.
+  In addition to the mesh, users can store derived assets (such as a mesh with computed normals or a packed network message)
+  that are computed once per model file, and decimated level-of-detail variants of the mesh can be requested.
+
+  Models are identified by their absolute path. The modification time and size of the file is checked on each access
+  and if the file has changed then it is read again and all the derived assets of the model are discarded.
+  If more models are cached than the maximum number of models then the least recently used models are removed.
+
+  Cached meshes and assets are shared, therefore they must not be modified by the callers. Objects that change their
+  internal state while they are used (such as cell locators) must not be stored as assets, because they may be used
+  from several threads at the same time.
+
+  \ingroup PlusLibModelAssets
+*/
+class vtkPlusModelAssetsExport PlusModelAssetCache
+{
+public:
+  /*! Function that computes a derived asset from the (possibly decimated) mesh of the model */
+  typedef std::function<vtkSmartPointer<vtkObject>(vtkPolyData*)> AssetFactory;
+
+  static PlusModelAssetCache* GetInstance();
+
+  /*! Maximum number of model files that are kept in the cache. If 0 then there is no limit. */
+  void SetMaximumNumberOfModels(unsigned int maximumNumberOfModels);
+  unsigned int GetMaximumNumberOfModels() const;
+
+  /*!
+    Get the mesh of the model file. Returns NULL if the file cannot be read or it contains no points.
+    \param absoluteFilePath Absolute path of the model file
+    \param targetReduction If larger than 0 then a decimated variant of the mesh is returned, with approximately
+      this fraction of the triangles removed (between 0 and 1, rounded to 0.01)
+  */
+  vtkSmartPointer<vtkPolyData> GetPolyData(const std::string& absoluteFilePath, double targetReduction = 0.0);
+
+  /*!
+    Get an asset that is derived from the mesh of the model. If the asset is not in the cache yet then it is created
+    by calling the factory function with the mesh (the same mesh that GetPolyData returns for the same targetReduction).
+    Returns NULL if the model file cannot be read or the factory returns NULL (then the factory is called again next time).
+    The factory is called with the model locked, therefore it must not access the same model in the cache.
+    \param assetName Name that identifies the asset. Assets of different targetReduction values are stored separately.
+  */
+  vtkSmartPointer<vtkObject> GetDerivedAsset(const std::string& absoluteFilePath, const std::string& assetName, AssetFactory factory, double targetReduction = 0.0);
+
+  /*! Remove all models from the cache. Meshes and assets that are still used by the callers are not affected. */
+  void Clear();
+
+  /*! Number of model files that are currently in the cache */
+  unsigned int GetNumberOfModels() const;
+
+protected:
+  PlusModelAssetCache();
+
+  struct ModelEntry
+  {
+    /*! Locked while the model is read or its variants or assets are created */
+    std::mutex Mutex;
+    bool Loaded;
+    long ModifiedTime;
+    unsigned long FileSize;
+    /*! Mesh variants, indexed by target reduction in percent (0 is the original mesh) */
+    std::map<int, vtkSmartPointer<vtkPolyData> > Variants;
+    /*! Derived assets, indexed by target reduction in percent and asset name */
+    std::map<std::pair<int, std::string>, vtkSmartPointer<vtkObject> > Assets;
+    uint64_t LastAccess;
+    ModelEntry() : Loaded(false), ModifiedTime(0), FileSize(0), LastAccess(0) {}
+  };
+
+  /*! Get the entry of the model and remove the least recently used entries if the cache is full */
+  std::shared_ptr<ModelEntry> GetEntry(const std::string& absoluteFilePath);
+
+  /*! Read the model file if it has not been read yet or it has changed since then. Requires the entry mutex to be locked. */
+  PlusStatus UpdateEntry(ModelEntry& entry, const std::string& absoluteFilePath);
+
+  /*! Get the mesh variant, create it if needed. Requires the entry mutex to be locked and the entry to be loaded. */
+  vtkSmartPointer<vtkPolyData> GetVariant(ModelEntry& entry, int reductionPercent);
+
+  static int GetReductionPercent(double targetReduction);
+  static vtkSmartPointer<vtkPolyData> ReadModelFile(const std::string& absoluteFilePath);
+
+  std::map<std::string, std::shared_ptr<ModelEntry> > Entries;
+  unsigned int MaximumNumberOfModels;
+  uint64_t AccessCounter;
+
+  mutable std::mutex Mutex;
+
+private:
+  PlusModelAssetCache(const PlusModelAssetCache&);
+  void operator=(const PlusModelAssetCache&);
+};
+
+#endif //__PlusModelAssetCache_h
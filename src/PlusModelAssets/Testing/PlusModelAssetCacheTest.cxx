@@ -0,0 +1,256 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusModelAssetCacheTest.cxx
+  \brief Test reuse, invalidation and eviction of cached models and their variants
+
+  Model files are generated in the output directory. Checks that repeated requests return the cached mesh and derived
+  asset, that a model is read again when its file is modified, that the least recently used model is evicted when the
+  cache is full, and that decimated variants are smaller than the original mesh and are cached as well.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusModelAssetCache.h"
+#include "vtkPolyData.h"
+#include "vtkSphereSource.h"
+#include "vtkXMLPolyDataWriter.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+  const std::string TEST_ASSET_NAME = "PlusModelAssetCacheTest.Asset";
+
+  //----------------------------------------------------------------------------
+  PlusStatus WriteSphereModel(const std::string& filePath, int resolution)
+  {
+    vtkSmartPointer<vtkSphereSource> sphereSource = vtkSmartPointer<vtkSphereSource>::New();
+    sphereSource->SetRadius(10.0);
+    sphereSource->SetThetaResolution(resolution);
+    sphereSource->SetPhiResolution(resolution);
+    vtkSmartPointer<vtkXMLPolyDataWriter> writer = vtkSmartPointer<vtkXMLPolyDataWriter>::New();
+    writer->SetInputConnection(sphereSource->GetOutputPort());
+    writer->SetFileName(filePath.c_str());
+    if (writer->Write() == 0)
+    {
+      LOG_ERROR("Failed to write model file " << filePath);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Get the derived test asset (a copy of the mesh) and count how many times it had to be created */
+  vtkSmartPointer<vtkObject> GetTestAsset(const std::string& filePath, int& numberOfAssetsCreated)
+  {
+    return PlusModelAssetCache::GetInstance()->GetDerivedAsset(filePath, TEST_ASSET_NAME, [&numberOfAssetsCreated](vtkPolyData * polyData) -> vtkSmartPointer<vtkObject>
+    {
+      ++numberOfAssetsCreated;
+      vtkSmartPointer<vtkPolyData> asset = vtkSmartPointer<vtkPolyData>::New();
+      asset->DeepCopy(polyData);
+      return asset;
+    });
+  }
+
+  //----------------------------------------------------------------------------
+  int TestCacheHitAndInvalidation(const std::string& filePath)
+  {
+    int numberOfErrors(0);
+    PlusModelAssetCache* cache = PlusModelAssetCache::GetInstance();
+
+    vtkSmartPointer<vtkPolyData> polyData = cache->GetPolyData(filePath);
+    if (polyData == NULL || polyData->GetNumberOfCells() == 0)
+    {
+      LOG_ERROR("Failed to read model " << filePath);
+      return 1;
+    }
+    if (cache->GetPolyData(filePath) != polyData)
+    {
+      LOG_ERROR("Repeated request of an unchanged model did not return the cached mesh");
+      numberOfErrors++;
+    }
+    int numberOfAssetsCreated(0);
+    vtkSmartPointer<vtkObject> asset = GetTestAsset(filePath, numberOfAssetsCreated);
+    if (asset == NULL || GetTestAsset(filePath, numberOfAssetsCreated) != asset || numberOfAssetsCreated != 1)
+    {
+      LOG_ERROR("Derived asset was created " << numberOfAssetsCreated << " times for an unchanged model, expected 1");
+      numberOfErrors++;
+    }
+
+    // Rewrite the file with the same content: only the modification time changes (it has one second resolution)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    if (WriteSphereModel(filePath, 16) != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    vtkSmartPointer<vtkPolyData> touchedPolyData = cache->GetPolyData(filePath);
+    if (touchedPolyData == NULL || touchedPolyData == polyData)
+    {
+      LOG_ERROR("Model was not read again after the modification time of its file changed");
+      numberOfErrors++;
+    }
+    if (GetTestAsset(filePath, numberOfAssetsCreated) == asset || numberOfAssetsCreated != 2)
+    {
+      LOG_ERROR("Derived asset was not created again after the model file changed");
+      numberOfErrors++;
+    }
+
+    // Rewrite the file with a different mesh
+    if (WriteSphereModel(filePath, 32) != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    vtkSmartPointer<vtkPolyData> modifiedPolyData = cache->GetPolyData(filePath);
+    if (modifiedPolyData == NULL || modifiedPolyData->GetNumberOfCells() <= polyData->GetNumberOfCells())
+    {
+      LOG_ERROR("Modified model was not read again: number of cells is " << (modifiedPolyData == NULL ? 0 : modifiedPolyData->GetNumberOfCells())
+                << ", expected more than " << polyData->GetNumberOfCells());
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestDecimatedVariants(const std::string& filePath)
+  {
+    int numberOfErrors(0);
+    PlusModelAssetCache* cache = PlusModelAssetCache::GetInstance();
+
+    vtkSmartPointer<vtkPolyData> polyData = cache->GetPolyData(filePath);
+    vtkSmartPointer<vtkPolyData> decimatedPolyData = cache->GetPolyData(filePath, 0.5);
+    if (polyData == NULL || decimatedPolyData == NULL)
+    {
+      LOG_ERROR("Failed to get the original and the decimated mesh of model " << filePath);
+      return 1;
+    }
+    if (decimatedPolyData == polyData || decimatedPolyData->GetNumberOfCells() >= polyData->GetNumberOfCells())
+    {
+      LOG_ERROR("Decimated mesh has " << decimatedPolyData->GetNumberOfCells() << " cells, expected less than " << polyData->GetNumberOfCells());
+      numberOfErrors++;
+    }
+    // Target reductions that round to the same percentage share the variant
+    if (cache->GetPolyData(filePath, 0.501) != decimatedPolyData)
+    {
+      LOG_ERROR("Repeated request of a decimated mesh did not return the cached variant");
+      numberOfErrors++;
+    }
+    vtkSmartPointer<vtkPolyData> moreDecimatedPolyData = cache->GetPolyData(filePath, 0.9);
+    if (moreDecimatedPolyData == NULL || moreDecimatedPolyData->GetNumberOfCells() >= decimatedPolyData->GetNumberOfCells())
+    {
+      LOG_ERROR("Mesh decimated with target reduction 0.9 is not smaller than the one decimated with 0.5");
+      numberOfErrors++;
+    }
+    if (cache->GetPolyData(filePath) != polyData)
+    {
+      LOG_ERROR("Original mesh was not kept in the cache after decimated variants were created");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestLeastRecentlyUsedEviction(const std::string& filePathA, const std::string& filePathB, const std::string& filePathC)
+  {
+    int numberOfErrors(0);
+    PlusModelAssetCache* cache = PlusModelAssetCache::GetInstance();
+    cache->Clear();
+    cache->SetMaximumNumberOfModels(2);
+
+    vtkSmartPointer<vtkPolyData> polyDataA = cache->GetPolyData(filePathA);
+    vtkSmartPointer<vtkPolyData> polyDataB = cache->GetPolyData(filePathB);
+    // Use A again, so that B becomes the least recently used model
+    cache->GetPolyData(filePathA);
+    vtkSmartPointer<vtkPolyData> polyDataC = cache->GetPolyData(filePathC);
+    if (polyDataA == NULL || polyDataB == NULL || polyDataC == NULL)
+    {
+      LOG_ERROR("Failed to read the models of the eviction test");
+      return 1;
+    }
+    if (cache->GetNumberOfModels() != 2)
+    {
+      LOG_ERROR("Number of cached models is " << cache->GetNumberOfModels() << ", expected 2");
+      numberOfErrors++;
+    }
+    if (cache->GetPolyData(filePathA) != polyDataA)
+    {
+      LOG_ERROR("Recently used model was evicted from the cache");
+      numberOfErrors++;
+    }
+    // The evicted mesh is still valid for the callers that hold it, but a new request reads the file again
+    if (polyDataB->GetNumberOfCells() == 0 || cache->GetPolyData(filePathB) == polyDataB)
+    {
+      LOG_ERROR("Least recently used model was not evicted from the cache");
+      numberOfErrors++;
+    }
+
+    cache->SetMaximumNumberOfModels(0);
+    cache->GetPolyData(filePathC);
+    cache->GetPolyData(filePathA);
+    if (cache->GetNumberOfModels() != 3)
+    {
+      LOG_ERROR("Number of cached models is " << cache->GetNumberOfModels() << " without a limit, expected 3");
+      numberOfErrors++;
+    }
+    cache->Clear();
+    if (cache->GetNumberOfModels() != 0)
+    {
+      LOG_ERROR("Cache is not empty after Clear");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  std::string filePathA = vtkPlusConfig::GetInstance()->GetOutputPath("PlusModelAssetCacheTestA.vtp");
+  std::string filePathB = vtkPlusConfig::GetInstance()->GetOutputPath("PlusModelAssetCacheTestB.vtp");
+  std::string filePathC = vtkPlusConfig::GetInstance()->GetOutputPath("PlusModelAssetCacheTestC.vtp");
+  if (WriteSphereModel(filePathA, 16) != PLUS_SUCCESS
+      || WriteSphereModel(filePathB, 16) != PLUS_SUCCESS
+      || WriteSphereModel(filePathC, 16) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors(0);
+  numberOfErrors += TestCacheHitAndInvalidation(filePathA);
+  numberOfErrors += TestDecimatedVariants(filePathA);
+  numberOfErrors += TestLeastRecentlyUsedEviction(filePathA, filePathB, filePathC);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -10,12 +10,69 @@ See License.txt for details.
 // IGTL includes
 #include <igtl_header.h>
 
+namespace
+{
+  //----------------------------------------------------------------------------
+  void ReadIntPairAttribute(vtkXMLDataElement* element, const char* attributeName, std::array<int, 2>& value)
+  {
+    int tmpValue[2] = { 0, 0 };
+    if (element->GetAttribute(attributeName) == NULL)
+    {
+      return;
+    }
+    if (element->GetVectorAttribute(attributeName, 2, tmpValue) != 2)
+    {
+      LOG_WARNING("Unable to read " << attributeName << " attribute of " << (element->GetName() ? element->GetName() : "") << " element: two integer values are expected");
+      return;
+    }
+    value[0] = tmpValue[0];
+    value[1] = tmpValue[1];
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Read the image shaping parameters from the attributes of an Image or Video element */
+  void ReadShapingParameters(vtkXMLDataElement* streamElem, PlusIgtlClientInfo::ShapingParameters& shaping)
+  {
+    ReadIntPairAttribute(streamElem, "ClipRectangleOrigin", shaping.ClipRectangleOrigin);
+    ReadIntPairAttribute(streamElem, "ClipRectangleSize", shaping.ClipRectangleSize);
+    ReadIntPairAttribute(streamElem, "TargetSize", shaping.TargetSize);
+    XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(Grayscale, shaping.Grayscale, streamElem);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, MaxFrameRate, shaping.MaxFrameRate, streamElem);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Write the image shaping parameters that differ from the default into the attributes of an Image or Video element */
+  void WriteShapingParameters(const PlusIgtlClientInfo::ShapingParameters& shaping, vtkXMLDataElement* streamElem)
+  {
+    if (shaping.IsClipped())
+    {
+      streamElem->SetVectorAttribute("ClipRectangleOrigin", 2, shaping.ClipRectangleOrigin.data());
+      streamElem->SetVectorAttribute("ClipRectangleSize", 2, shaping.ClipRectangleSize.data());
+    }
+    if (shaping.TargetSize[0] > 0 || shaping.TargetSize[1] > 0)
+    {
+      streamElem->SetVectorAttribute("TargetSize", 2, shaping.TargetSize.data());
+    }
+    if (shaping.Grayscale)
+    {
+      streamElem->SetAttribute("Grayscale", "TRUE");
+    }
+    if (shaping.MaxFrameRate > 0)
+    {
+      streamElem->SetDoubleAttribute("MaxFrameRate", shaping.MaxFrameRate);
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusIgtlClientInfo::PlusIgtlClientInfo()
   : ClientHeaderVersion(IGTL_HEADER_VERSION_1)
   , TDATAResolution(0)
   , TDATARequested(false)
   , LastTDATASentTimeStamp(-1)
+  , TDATACoalescing(false)
+  , SharedMemoryTransport(false)
+  , TrackedFrameBinaryData(false)
 {
 
 }
@@ -54,6 +111,9 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
   XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, ClientHeaderVersion, clientInfo.ClientHeaderVersion, xmldata);
   XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(TDATARequested, clientInfo.TDATARequested, xmldata);
   XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, TDATAResolution, clientInfo.TDATAResolution, xmldata);
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(TDATACoalescing, clientInfo.TDATACoalescing, xmldata);
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(SharedMemoryTransport, clientInfo.SharedMemoryTransport, xmldata);
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(TrackedFrameBinaryData, clientInfo.TrackedFrameBinaryData, xmldata);
   if (xmldata->GetAttribute("Resolution") != NULL)
   {
     int resolution;
@@ -146,6 +206,7 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
       stream.Name = name;
       stream.FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
       stream.FrameConverter->EnableCacheOn();
+      ReadShapingParameters(imageElem, stream.Shaping);
 
       clientInfo.ImageStreams.push_back(stream);
     }
@@ -182,8 +243,7 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
       VideoStream stream;
       stream.EmbeddedTransformToFrame = embeddedTransformToFrame;
       stream.Name = name;
-      stream.FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
-      stream.FrameConverter->EnableCacheOn();
+      ReadShapingParameters(videoElem, stream.Shaping);
 
       XML_FIND_NESTED_ELEMENT_OPTIONAL(encodingElem, videoElem, "Encoding");
       if (encodingElem)
@@ -237,8 +297,24 @@ void PlusIgtlClientInfo::GetClientInfoInXmlData(std::string& strXmlData)
 {
   vtkSmartPointer<vtkXMLDataElement> xmldata = vtkSmartPointer<vtkXMLDataElement>::New();
   xmldata->SetName("ClientInfo");
+  if (this->GetClientHeaderVersion() > IGTL_HEADER_VERSION_1)
+  {
+    xmldata->SetIntAttribute("ClientHeaderVersion", this->GetClientHeaderVersion());
+  }
   xmldata->SetAttribute("TDATARequested", (this->GetTDATARequested() ? "TRUE" : "FALSE"));
   xmldata->SetIntAttribute("TDATAResolution", this->GetTDATAResolution());
+  if (this->GetTDATACoalescing())
+  {
+    xmldata->SetAttribute("TDATACoalescing", "TRUE");
+  }
+  if (this->GetSharedMemoryTransport())
+  {
+    xmldata->SetAttribute("SharedMemoryTransport", "TRUE");
+  }
+  if (this->GetTrackedFrameBinaryData())
+  {
+    xmldata->SetAttribute("TrackedFrameBinaryData", "TRUE");
+  }
 
   vtkSmartPointer<vtkXMLDataElement> messageTypes = vtkSmartPointer<vtkXMLDataElement>::New();
   messageTypes->SetName("MessageTypes");
@@ -295,6 +371,7 @@ void PlusIgtlClientInfo::GetClientInfoInXmlData(std::string& strXmlData)
     image->SetName("Image");
     image->SetAttribute("Name", ImageStreams[i].Name.c_str());
     image->SetAttribute("EmbeddedTransformToFrame", ImageStreams[i].EmbeddedTransformToFrame.c_str());
+    WriteShapingParameters(ImageStreams[i].Shaping, image);
     imageNames->AddNestedElement(image);
   }
   xmldata->AddNestedElement(imageNames);
@@ -329,6 +406,9 @@ void PlusIgtlClientInfo::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "TDATARequested: " << (this->GetTDATARequested() ? "TRUE" : "FALSE") << ". ";
   os << indent << "LastTDATASentTimeStamp: " << this->GetLastTDATASentTimeStamp() << ". ";
   os << indent << "TDATAResolution: " << this->GetTDATAResolution() << ". ";
+  os << indent << "TDATACoalescing: " << (this->GetTDATACoalescing() ? "TRUE" : "FALSE") << ". ";
+  os << indent << "SharedMemoryTransport: " << (this->GetSharedMemoryTransport() ? "TRUE" : "FALSE") << ". ";
+  os << indent << "TrackedFrameBinaryData: " << (this->GetTrackedFrameBinaryData() ? "TRUE" : "FALSE") << ". ";
 
   os << ". Transforms: ";
   if (!this->TransformNames.empty())
@@ -433,3 +513,45 @@ void PlusIgtlClientInfo::SetLastTDATASentTimeStamp(double val)
 {
   this->LastTDATASentTimeStamp = val;
 }
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetTDATACoalescing() const
+{
+  return this->TDATACoalescing;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetTDATACoalescing(bool val)
+{
+  this->TDATACoalescing = val;
+}
+
+//----------------------------------------------------------------------------
+std::vector<PlusIgtlClientInfo::TrackingDataSample>& PlusIgtlClientInfo::GetPendingTDATASamples()
+{
+  return this->PendingTDATASamples;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetSharedMemoryTransport() const
+{
+  return this->SharedMemoryTransport;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetSharedMemoryTransport(bool val)
+{
+  this->SharedMemoryTransport = val;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetTrackedFrameBinaryData() const
+{
+  return this->TrackedFrameBinaryData;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetTrackedFrameBinaryData(bool val)
+{
+  this->TrackedFrameBinaryData = val;
+}
\ No newline at end of file
@@ -16,8 +16,10 @@
 
 // IGTL includes
 #include <igtlClientSocket.h>
+#include <igtlMath.h>
 
 // STL includes
+#include <array>
 #include <string>
 #include <vector>
 
@@ -59,6 +61,45 @@ public:
     }
   };
 
+  /*! Server-side reduction of an image or video stream, for clients that do not need full resolution images at full frame rate
+  (e.g., remote monitoring). The shaped image is computed once for each frame and shared by all clients that request the same parameters.
+  */
+  struct ShapingParameters
+  {
+    /*! Origin of the sent region of the image (in pixels). Only used if ClipRectangleSize is set. */
+    std::array<int, 2> ClipRectangleOrigin;
+    /*! Size of the sent region of the image (in pixels). If 0 then the full image is sent. */
+    std::array<int, 2> ClipRectangleSize;
+    /*! Size of the sent image (in pixels), the clipped region is resampled to this size.
+    If one of the components is 0 then it is computed from the other so that the aspect ratio is preserved. If both are 0 then the image is not resampled. */
+    std::array<int, 2> TargetSize;
+    /*! If true then color images are converted to grayscale */
+    bool Grayscale;
+    /*! Maximum number of frames sent per second. If 0 then all frames are sent. */
+    double MaxFrameRate;
+    ShapingParameters()
+      : Grayscale(false)
+      , MaxFrameRate(0.0)
+    {
+      ClipRectangleOrigin.fill(0);
+      ClipRectangleSize.fill(0);
+      TargetSize.fill(0);
+    }
+    bool IsClipped() const
+    {
+      return ClipRectangleSize[0] > 0 && ClipRectangleSize[1] > 0;
+    }
+    /*! Returns true if the image has to be modified (not just the frame rate limited) */
+    bool IsImageModified() const
+    {
+      return IsClipped() || TargetSize[0] > 0 || TargetSize[1] > 0 || Grayscale;
+    }
+    bool IsEnabled() const
+    {
+      return IsImageModified() || MaxFrameRate > 0;
+    }
+  };
+
   /*! Helper struct for storing image stream and embedded transform frame names
   IGTL image message device name: [Name]_[EmbeddedTransformToFrame]
   */
@@ -68,6 +109,8 @@ public:
     std::string Name;
     /*! Name of the IGTL image message embedded transform "To" frame */
     std::string EmbeddedTransformToFrame;
+    /*! Optional clipping, resampling, pixel type and frame rate reduction */
+    ShapingParameters Shaping;
     /*! Class for decoding and encoding frames */
     vtkSmartPointer<vtkIGSIOFrameConverter> FrameConverter;
     ImageStream()
@@ -85,14 +128,25 @@ public:
     std::string Name;
     /*! Name of the IGTL image message embedded transform "To" frame */
     std::string EmbeddedTransformToFrame;
-    /*! Parameters for how to encode video for compressed streams*/
+    /*! Parameters for how to encode video for compressed streams. Clients that request the same stream with the same parameters share the encoder. */
     EncodingParameters EncodeVideoParameters;
-    /*! Class for decoding and encoding frames */
-    vtkSmartPointer<vtkIGSIOFrameConverter> FrameConverter;
-    VideoStream()
-      : FrameConverter(nullptr)
-    {
-    };
+    /*! Optional clipping, resampling, pixel type and frame rate reduction (applied before encoding) */
+    ShapingParameters Shaping;
+  };
+
+  /*! Pose of a single tool in a coalesced TDATA sample */
+  struct TrackingDataSampleElement
+  {
+    std::string TransformName;
+    igtl::Matrix4x4 Matrix;
+    ToolStatus Status;
+  };
+
+  /*! Tool poses of one tracked frame, collected until the next coalesced TDATA message is sent */
+  struct TrackingDataSample
+  {
+    double Timestamp;
+    std::vector<TrackingDataSampleElement> Elements;
   };
 
   PlusIgtlClientInfo();
@@ -130,6 +184,39 @@ public:
   /*! timestamp of the last sent TDATA message. */
   void SetLastTDATASentTimeStamp(double val);
 
+  /*!
+    If enabled then tool poses of all tracked frames are collected and sent together in one TDATA message
+    when TDATAResolution time is elapsed (instead of sending only the latest poses). Each sample's timestamp is
+    preserved in the message meta data. This allows streaming of high-rate trackers with low packet rate.
+  */
+  bool GetTDATACoalescing() const;
+  /*! Enable sending all collected tool poses in each TDATA message. See GetTDATACoalescing(). */
+  void SetTDATACoalescing(bool val);
+
+  /*!
+    Tool poses that are collected for the next coalesced TDATA message of this client.
+    The list is part of the client info state, each client info object has its own list.
+  */
+  std::vector<TrackingDataSample>& GetPendingTDATASamples();
+
+  /*!
+    If enabled then the client requests image pixel data of TRACKEDFRAME messages to be transferred through
+    a shared memory ring instead of the socket. The server only honors the request if shared memory transport
+    is enabled on the server, the client is connected from the same host, and the client requested binary TRACKEDFRAME
+    frame data (the image reference is stored in the binary frame data).
+  */
+  bool GetSharedMemoryTransport() const;
+  /*! Request image transfer through shared memory. See GetSharedMemoryTransport(). */
+  void SetSharedMemoryTransport(bool val);
+
+  /*!
+    If enabled then the client can read the binary frame data layout of TRACKEDFRAME messages, which is faster
+    to generate and parse than the XML layout. The server sends XML frame data to clients that do not request it.
+  */
+  bool GetTrackedFrameBinaryData() const;
+  /*! Request binary frame data in TRACKEDFRAME messages. See GetTrackedFrameBinaryData(). */
+  void SetTrackedFrameBinaryData(bool val);
+
   /*! Message types that client expects from the server */
   std::vector<std::string> IgtlMessageTypes;
 
@@ -150,6 +237,10 @@ protected:
   bool    TDATARequested;
   double  LastTDATASentTimeStamp;
   int     TDATAResolution;
+  bool    TDATACoalescing;
+  bool    SharedMemoryTransport;
+  bool    TrackedFrameBinaryData;
+  std::vector<TrackingDataSample> PendingTDATASamples;
 };
 
 #endif
\ No newline at end of file
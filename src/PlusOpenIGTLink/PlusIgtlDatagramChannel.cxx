@@ -0,0 +1,480 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlDatagramChannel.h"
+#include "PlusMetrics.h"
+#include "vtkPlusIgtlMessageFactory.h"
+
+// OpenIGTLink includes
+#include <igtlMessageHeader.h>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #define PLUS_INVALID_DATAGRAM_SOCKET static_cast<intptr_t>(INVALID_SOCKET)
+  typedef int PlusSocketAddressLength;
+#else
+  #include <arpa/inet.h>
+  #include <netdb.h>
+  #include <netinet/in.h>
+  #include <sys/select.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+  #define PLUS_INVALID_DATAGRAM_SOCKET static_cast<intptr_t>(-1)
+  typedef socklen_t PlusSocketAddressLength;
+#endif
+
+namespace
+{
+  const unsigned char DATAGRAM_MAGIC[4] = { 'P', 'L', 'D', 'G' };
+  const uint16_t DATAGRAM_HEADER_VERSION = 1;
+  // magic (4), version (2), flags (2), sequence number (8), send time (8)
+  const size_t DATAGRAM_HEADER_SIZE = 24;
+  // Largest UDP payload over IPv4
+  const size_t MAX_DATAGRAM_SIZE = 65507;
+  // Backward jump in the sequence number that is interpreted as a restart of the sender (instead of a late datagram)
+  const uint64_t SEQUENCE_RESTART_THRESHOLD = 1000;
+
+  //----------------------------------------------------------------------------
+  void WriteBigEndian(unsigned char* buffer, uint64_t value, int numberOfBytes)
+  {
+    for (int i = numberOfBytes - 1; i >= 0; --i)
+    {
+      buffer[i] = static_cast<unsigned char>(value & 0xFF);
+      value >>= 8;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  uint64_t ReadBigEndian(const unsigned char* buffer, int numberOfBytes)
+  {
+    uint64_t value = 0;
+    for (int i = 0; i < numberOfBytes; ++i)
+    {
+      value = (value << 8) | buffer[i];
+    }
+    return value;
+  }
+
+  //----------------------------------------------------------------------------
+  void CloseSocketHandle(intptr_t socketHandle)
+  {
+#ifdef _WIN32
+    closesocket(static_cast<SOCKET>(socketHandle));
+#else
+    close(static_cast<int>(socketHandle));
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlDatagramChannel::PlusIgtlDatagramChannel()
+  : Socket(PLUS_INVALID_DATAGRAM_SOCKET)
+  , Multicast(false)
+  , DestinationAddress(0)
+  , DestinationPort(0)
+  , SourceAddress(0)
+  , NextSequenceNumber(1)
+  , SequenceStarted(false)
+  , LastReceivedSequenceNumber(0)
+  , LastReceivedSendTime(0)
+  , NumberOfDatagrams(0)
+  , NumberOfLostDatagrams(0)
+  , NumberOfDroppedDatagrams(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlDatagramChannel::~PlusIgtlDatagramChannel()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlDatagramChannel::IsMulticastAddress(const std::string& address)
+{
+  in_addr addr;
+  if (address.empty() || inet_pton(AF_INET, address.c_str(), &addr) != 1)
+  {
+    return false;
+  }
+  uint32_t hostAddress = ntohl(addr.s_addr);
+  return (hostAddress >> 28) == 0xE; // 224.0.0.0/4
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlDatagramChannel::OpenSocket()
+{
+  this->Close();
+
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+  {
+    LOG_ERROR("Failed to initialize Windows sockets for the datagram channel");
+    return PLUS_FAIL;
+  }
+#endif
+
+  this->Socket = static_cast<intptr_t>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+  if (this->Socket == PLUS_INVALID_DATAGRAM_SOCKET)
+  {
+    LOG_ERROR("Failed to create datagram socket");
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return PLUS_FAIL;
+  }
+
+  this->Buffer.resize(MAX_DATAGRAM_SIZE);
+  this->SourceAddress = 0;
+  this->NextSequenceNumber = 1;
+  this->SequenceStarted = false;
+  this->LastReceivedSequenceNumber = 0;
+  this->LastReceivedSendTime = 0;
+  this->NumberOfDatagrams = 0;
+  this->NumberOfLostDatagrams = 0;
+  this->NumberOfDroppedDatagrams = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlDatagramChannel::OpenSender(const std::string& address, int port, int multicastTimeToLive)
+{
+  in_addr destination;
+  if (inet_pton(AF_INET, address.c_str(), &destination) != 1 || port <= 0 || port > 65535)
+  {
+    LOG_ERROR("Failed to open datagram sender - invalid destination: " << address << ":" << port);
+    return PLUS_FAIL;
+  }
+  if (this->OpenSocket() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  this->DestinationAddress = destination.s_addr;
+  this->DestinationPort = htons(static_cast<uint16_t>(port));
+  this->Multicast = IsMulticastAddress(address);
+  this->MetricLabels = PlusMetricsRegistry::MakeLabel("port", igsioCommon::ToString<int>(port));
+  if (this->Multicast)
+  {
+    unsigned char ttl = static_cast<unsigned char>(std::max(1, std::min(255, multicastTimeToLive)));
+    unsigned char loop = 1; // allow subscribers on the same host
+    if (setsockopt(this->Socket, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char*>(&ttl), sizeof(ttl)) != 0
+        || setsockopt(this->Socket, IPPROTO_IP, IP_MULTICAST_LOOP, reinterpret_cast<const char*>(&loop), sizeof(loop)) != 0)
+    {
+      LOG_WARNING("Failed to set multicast options of the datagram sender (" << address << ":" << port << ")");
+    }
+  }
+
+  LOG_INFO("Sending tracking data datagrams to " << (this->Multicast ? "multicast group " : "") << address << ":" << port);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlDatagramChannel::OpenReceiver(const std::string& address, int port, const std::string& sourceAddress)
+{
+  if (port <= 0 || port > 65535)
+  {
+    LOG_ERROR("Failed to open datagram receiver - invalid port: " << port);
+    return PLUS_FAIL;
+  }
+  if (this->OpenSocket() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (!sourceAddress.empty())
+  {
+    // The source may be given as a host name (e.g., the server address of a device)
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* resolvedAddresses = NULL;
+    if (getaddrinfo(sourceAddress.c_str(), NULL, &hints, &resolvedAddresses) != 0 || resolvedAddresses == NULL)
+    {
+      LOG_ERROR("Failed to open datagram receiver - cannot resolve sender address " << sourceAddress);
+      this->Close();
+      return PLUS_FAIL;
+    }
+    this->SourceAddress = reinterpret_cast<sockaddr_in*>(resolvedAddresses->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(resolvedAddresses);
+  }
+  this->Multicast = IsMulticastAddress(address);
+
+  // Multiple receivers on the same host may subscribe to the same multicast group
+  int reuse = 1;
+  setsockopt(this->Socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+  // Tracking data arrives in bursts (one datagram per message), avoid losing datagrams in the socket buffer
+  int receiveBufferSize = 1024 * 1024;
+  setsockopt(this->Socket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receiveBufferSize), sizeof(receiveBufferSize));
+
+  sockaddr_in localAddress;
+  memset(&localAddress, 0, sizeof(localAddress));
+  localAddress.sin_family = AF_INET;
+  localAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+#ifndef _WIN32
+  if (this->Multicast)
+  {
+    // Bound to the group address the socket does not receive the datagrams of other groups (or unicast datagrams) on the same port.
+    // Windows does not allow binding to a multicast address, but delivers only the datagrams of the groups that the socket joined.
+    inet_pton(AF_INET, address.c_str(), &localAddress.sin_addr);
+  }
+#endif
+  localAddress.sin_port = htons(static_cast<uint16_t>(port));
+  if (bind(this->Socket, reinterpret_cast<sockaddr*>(&localAddress), sizeof(localAddress)) != 0)
+  {
+    LOG_ERROR("Failed to open datagram receiver - cannot bind to port " << port);
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  this->MetricLabels = PlusMetricsRegistry::MakeLabel("port", igsioCommon::ToString<int>(port));
+  if (this->Multicast)
+  {
+    ip_mreq membership;
+    memset(&membership, 0, sizeof(membership));
+    inet_pton(AF_INET, address.c_str(), &membership.imr_multiaddr);
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(this->Socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char*>(&membership), sizeof(membership)) != 0)
+    {
+      LOG_ERROR("Failed to open datagram receiver - cannot join multicast group " << address);
+      this->Close();
+      return PLUS_FAIL;
+    }
+  }
+
+  LOG_DEBUG("Receiving tracking data datagrams on port " << port << (this->Multicast ? " from multicast group " + address : std::string())
+            << (sourceAddress.empty() ? std::string() : " sent by " + sourceAddress));
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlDatagramChannel::Close()
+{
+  if (this->Socket == PLUS_INVALID_DATAGRAM_SOCKET)
+  {
+    return;
+  }
+  CloseSocketHandle(this->Socket);
+  this->Socket = PLUS_INVALID_DATAGRAM_SOCKET;
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlDatagramChannel::Send(igtl::MessageBase* packedMessage, double sendTimeUtc)
+{
+  if (!this->IsOpen() || this->DestinationPort == 0)
+  {
+    LOG_ERROR("Failed to send datagram - the channel is not open for sending");
+    return PLUS_FAIL;
+  }
+  if (packedMessage == NULL)
+  {
+    LOG_ERROR("Failed to send datagram - message is NULL");
+    return PLUS_FAIL;
+  }
+
+  size_t messageSize = packedMessage->GetBufferSize();
+  if (DATAGRAM_HEADER_SIZE + messageSize > MAX_DATAGRAM_SIZE)
+  {
+    LOG_WARNING("Failed to send " << packedMessage->GetMessageType() << " message in a datagram - message size (" << messageSize << " bytes) exceeds the datagram size limit");
+    return PLUS_FAIL;
+  }
+
+  unsigned char* datagram = &this->Buffer[0];
+  memcpy(datagram, DATAGRAM_MAGIC, 4);
+  WriteBigEndian(datagram + 4, DATAGRAM_HEADER_VERSION, 2);
+  WriteBigEndian(datagram + 6, 0, 2);
+  WriteBigEndian(datagram + 8, this->NextSequenceNumber, 8);
+  uint64_t sendTimeBits = 0;
+  memcpy(&sendTimeBits, &sendTimeUtc, sizeof(sendTimeBits));
+  WriteBigEndian(datagram + 16, sendTimeBits, 8);
+  memcpy(datagram + DATAGRAM_HEADER_SIZE, packedMessage->GetBufferPointer(), messageSize);
+
+  sockaddr_in destination;
+  memset(&destination, 0, sizeof(destination));
+  destination.sin_family = AF_INET;
+  destination.sin_addr.s_addr = this->DestinationAddress;
+  destination.sin_port = this->DestinationPort;
+  int datagramSize = static_cast<int>(DATAGRAM_HEADER_SIZE + messageSize);
+  if (sendto(this->Socket, reinterpret_cast<const char*>(datagram), datagramSize, 0, reinterpret_cast<sockaddr*>(&destination), sizeof(destination)) != datagramSize)
+  {
+    LOG_DEBUG("Failed to send datagram " << this->NextSequenceNumber);
+    return PLUS_FAIL;
+  }
+
+  this->NextSequenceNumber++;
+  this->NumberOfDatagrams++;
+  PLUS_METRIC_COUNTER_ADD("plus_igtl_datagrams_sent_total", this->MetricLabels, 1);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlDatagramChannel::ReceiveMessage(double timeoutSec, vtkPlusIgtlMessageFactory* factory, int crccheck, igtl::MessageBase::Pointer& message)
+{
+  message = NULL;
+  if (!this->IsOpen())
+  {
+    LOG_ERROR("Failed to receive datagram - the channel is not open");
+    return PLUS_FAIL;
+  }
+  if (factory == NULL)
+  {
+    LOG_ERROR("Failed to receive datagram - message factory is NULL");
+    return PLUS_FAIL;
+  }
+
+  // Invalid, late, and duplicate datagrams are skipped, keep reading until a valid one is found or there are no more datagrams
+  while (true)
+  {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(this->Socket, &readSet);
+    timeval timeout;
+    timeout.tv_sec = static_cast<long>(timeoutSec);
+    timeout.tv_usec = static_cast<long>((timeoutSec - timeout.tv_sec) * 1e6);
+    int ready = select(static_cast<int>(this->Socket + 1), &readSet, NULL, NULL, &timeout);
+    if (ready < 0)
+    {
+      LOG_ERROR("Failed to receive datagram - socket error");
+      return PLUS_FAIL;
+    }
+    if (ready == 0)
+    {
+      // timeout
+      return PLUS_SUCCESS;
+    }
+    // Only wait for the first datagram
+    timeoutSec = 0;
+
+    sockaddr_in senderAddress;
+    PlusSocketAddressLength senderAddressLength = sizeof(senderAddress);
+    int datagramSize = recvfrom(this->Socket, reinterpret_cast<char*>(&this->Buffer[0]), static_cast<int>(this->Buffer.size()), 0,
+                                reinterpret_cast<sockaddr*>(&senderAddress), &senderAddressLength);
+    if (datagramSize < static_cast<int>(DATAGRAM_HEADER_SIZE + IGTL_HEADER_SIZE))
+    {
+      continue;
+    }
+    if (this->SourceAddress != 0 && senderAddress.sin_addr.s_addr != this->SourceAddress)
+    {
+      LOG_DEBUG("Datagram of an unexpected sender received, ignored");
+      continue;
+    }
+    const unsigned char* datagram = &this->Buffer[0];
+    if (memcmp(datagram, DATAGRAM_MAGIC, 4) != 0 || ReadBigEndian(datagram + 4, 2) != DATAGRAM_HEADER_VERSION)
+    {
+      LOG_DEBUG("Unrecognized datagram received, ignored");
+      continue;
+    }
+    uint64_t sequenceNumber = ReadBigEndian(datagram + 8, 8);
+    if (!this->AcceptSequenceNumber(sequenceNumber))
+    {
+      continue;
+    }
+    uint64_t sendTimeBits = ReadBigEndian(datagram + 16, 8);
+    memcpy(&this->LastReceivedSendTime, &sendTimeBits, sizeof(sendTimeBits));
+
+    // Unpack the OpenIGTLink message from the datagram
+    const unsigned char* igtlData = datagram + DATAGRAM_HEADER_SIZE;
+    size_t igtlDataSize = datagramSize - DATAGRAM_HEADER_SIZE;
+    igtl::MessageHeader::Pointer headerMsg = factory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
+    memcpy(headerMsg->GetBufferPointer(), igtlData, IGTL_HEADER_SIZE);
+    headerMsg->Unpack();
+    if (IGTL_HEADER_SIZE + headerMsg->GetBodySizeToRead() != igtlDataSize)
+    {
+      LOG_WARNING("Invalid " << headerMsg->GetDeviceType() << " message in datagram " << sequenceNumber << " - size mismatch");
+      continue;
+    }
+    igtl::MessageBase::Pointer bodyMsg = factory->CreateReceiveMessage(headerMsg);
+    if (bodyMsg.IsNull())
+    {
+      continue;
+    }
+    memcpy(bodyMsg->GetBufferBodyPointer(), igtlData + IGTL_HEADER_SIZE, bodyMsg->GetBufferBodySize());
+    int c = bodyMsg->Unpack(crccheck);
+    if (!(c & igtl::MessageHeader::UNPACK_BODY))
+    {
+      LOG_WARNING("Failed to unpack " << headerMsg->GetDeviceType() << " message in datagram " << sequenceNumber);
+      continue;
+    }
+    message = bodyMsg;
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlDatagramChannel::AcceptSequenceNumber(uint64_t sequenceNumber)
+{
+  if (this->SequenceStarted && sequenceNumber <= this->LastReceivedSequenceNumber)
+  {
+    if (this->LastReceivedSequenceNumber - sequenceNumber < SEQUENCE_RESTART_THRESHOLD)
+    {
+      // Late or duplicate datagram, newer data has been already received
+      this->NumberOfDroppedDatagrams++;
+      PLUS_METRIC_COUNTER_ADD("plus_igtl_datagrams_dropped_total", this->MetricLabels, 1);
+      return false;
+    }
+    LOG_INFO("Datagram sequence number restarted (" << this->LastReceivedSequenceNumber << " -> " << sequenceNumber << "), the sender has probably been restarted");
+    this->SequenceStarted = false;
+  }
+
+  if (this->SequenceStarted && sequenceNumber > this->LastReceivedSequenceNumber + 1)
+  {
+    uint64_t numberOfLostDatagrams = sequenceNumber - this->LastReceivedSequenceNumber - 1;
+    this->NumberOfLostDatagrams += numberOfLostDatagrams;
+    PLUS_METRIC_COUNTER_ADD("plus_igtl_datagrams_lost_total", this->MetricLabels, numberOfLostDatagrams);
+  }
+  this->SequenceStarted = true;
+  this->LastReceivedSequenceNumber = sequenceNumber;
+  this->NumberOfDatagrams++;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlDatagramChannel::IsOpen() const
+{
+  return this->Socket != PLUS_INVALID_DATAGRAM_SOCKET;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlDatagramChannel::IsMulticast() const
+{
+  return this->Multicast;
+}
+
+//----------------------------------------------------------------------------
+double PlusIgtlDatagramChannel::GetLastReceivedSendTime() const
+{
+  return this->LastReceivedSendTime;
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusIgtlDatagramChannel::GetNumberOfDatagrams() const
+{
+  return this->NumberOfDatagrams;
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusIgtlDatagramChannel::GetNumberOfLostDatagrams() const
+{
+  return this->NumberOfLostDatagrams;
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusIgtlDatagramChannel::GetNumberOfDroppedDatagrams() const
+{
+  return this->NumberOfDroppedDatagrams;
+}
@@ -0,0 +1,128 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlDatagramChannel_h
+#define __PlusIgtlDatagramChannel_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusOpenIGTLinkExport.h"
+
+// OpenIGTLink includes
+#include <igtlMessageBase.h>
+
+// STL includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class vtkPlusIgtlMessageFactory;
+
+/*!
+  \class PlusIgtlDatagramChannel
+  \brief Sends and receives small OpenIGTLink messages (TRANSFORM, POSITION, TDATA) in UDP datagrams
+
+  Each datagram contains exactly one packed OpenIGTLink message, prefixed by a short datagram header:
+  magic number ("PLDG"), header version, flags, sequence number, and send time (UTC). All fields are big endian.
+
+  The destination may be a unicast address or an IPv4 multicast group (224.0.0.0 - 239.255.255.255).
+  With a multicast group the tracking data is sent only once, regardless of the number of subscribers.
+  A receiver that joins a multicast group only receives the datagrams of that group. A receiver may also be
+  restricted to a single sender address, datagrams of other senders are ignored then.
+
+  Datagrams may be lost or reordered. The receiver detects lost datagrams from gaps in the sequence numbers
+  and drops datagrams that arrive late (out of order) or duplicated, so received messages are always in send order.
+  A large backward jump in the sequence number is interpreted as a restart of the sender.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport PlusIgtlDatagramChannel
+{
+public:
+  PlusIgtlDatagramChannel();
+  /*! Closes the socket */
+  ~PlusIgtlDatagramChannel();
+
+  /*!
+    Open the channel for sending
+    \param address Destination address (unicast address or multicast group)
+    \param port Destination port
+    \param multicastTimeToLive Maximum number of router hops of multicast datagrams (1: local network only)
+  */
+  PlusStatus OpenSender(const std::string& address, int port, int multicastTimeToLive = 1);
+
+  /*!
+    Open the channel for receiving
+    \param address Multicast group to join. If empty or not a multicast address then datagrams sent to any local address are received.
+    \param port Local port to receive datagrams on
+    \param sourceAddress Address or host name of the sender. If not empty then datagrams of other senders are ignored.
+  */
+  PlusStatus OpenReceiver(const std::string& address, int port, const std::string& sourceAddress = std::string());
+
+  void Close();
+
+  /*! Send a packed OpenIGTLink message in a single datagram */
+  PlusStatus Send(igtl::MessageBase* packedMessage, double sendTimeUtc);
+
+  /*!
+    Receive the next OpenIGTLink message.
+    \param timeoutSec Maximum time to wait for a datagram. Zero means that only already received datagrams are processed.
+    \param factory Creates the message object from the received message header
+    \param crccheck If nonzero then the CRC of the message body is checked
+    \param message Unpacked message. NULL if no valid message was received before the timeout.
+  */
+  PlusStatus ReceiveMessage(double timeoutSec, vtkPlusIgtlMessageFactory* factory, int crccheck, igtl::MessageBase::Pointer& message);
+
+  bool IsOpen() const;
+  bool IsMulticast() const;
+
+  /*! Send time (UTC) of the last received message, as recorded by the sender */
+  double GetLastReceivedSendTime() const;
+
+  /*! Number of datagrams that were sent (sender) or accepted (receiver) */
+  uint64_t GetNumberOfDatagrams() const;
+  /*! Number of datagrams that were missing from the received sequence */
+  uint64_t GetNumberOfLostDatagrams() const;
+  /*! Number of datagrams that arrived out of order or duplicated and were dropped */
+  uint64_t GetNumberOfDroppedDatagrams() const;
+
+  /*! Returns true if the address is an IPv4 multicast group */
+  static bool IsMulticastAddress(const std::string& address);
+
+protected:
+  PlusStatus OpenSocket();
+
+  /*! Process the sequence number of a received datagram. Returns false if the datagram has to be dropped. */
+  bool AcceptSequenceNumber(uint64_t sequenceNumber);
+
+  /*! Socket handle (SOCKET on Windows) */
+  intptr_t Socket;
+  bool Multicast;
+  /*! Destination IPv4 address and port of sent datagrams, in network byte order */
+  uint32_t DestinationAddress;
+  uint16_t DestinationPort;
+  /*! Accepted sender IPv4 address of received datagrams, in network byte order. Zero if datagrams of any sender are accepted. */
+  uint32_t SourceAddress;
+
+  std::vector<unsigned char> Buffer;
+  uint64_t NextSequenceNumber;
+  bool SequenceStarted;
+  uint64_t LastReceivedSequenceNumber;
+  double LastReceivedSendTime;
+
+  uint64_t NumberOfDatagrams;
+  uint64_t NumberOfLostDatagrams;
+  uint64_t NumberOfDroppedDatagrams;
+
+  /*! Labels of the reported metrics (local or destination port) */
+  std::string MetricLabels;
+
+private:
+  PlusIgtlDatagramChannel(const PlusIgtlDatagramChannel&);
+  void operator=(const PlusIgtlDatagramChannel&);
+};
+
+#endif //__PlusIgtlDatagramChannel_h
@@ -0,0 +1,333 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlImageStreamShaper.h"
+#include "PlusMetrics.h"
+
+// IGSIO includes
+#include "igsioTrackedFrame.h"
+#include "igsioVideoFrame.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkImageResize.h>
+#include <vtkMatrix4x4.h>
+
+// STL includes
+#include <algorithm>
+#include <array>
+#include <sstream>
+
+namespace
+{
+  // Shapes that have not been used for this long are removed
+  const double UNUSED_SHAPE_TIMEOUT_SEC = 10.0;
+
+  // Frames that arrive this much earlier than the next output time are still sent
+  // (so that the output rate is not halved when the input period is exactly the requested period)
+  const double FRAME_RATE_TIMESTAMP_TOLERANCE_SEC = 0.001;
+
+  //----------------------------------------------------------------------------
+  /*! Convert an RGB(A) region of the input image to grayscale. Integer weights (ITU-R BT.601 luma) allow vectorization of the inner loop. */
+  void ConvertToGrayscale(vtkImageData* inputImage, int clipOrigin[2], int clipSize[2], vtkImageData* outputImage)
+  {
+    const int numberOfComponents = inputImage->GetNumberOfScalarComponents();
+    outputImage->SetExtent(0, clipSize[0] - 1, 0, clipSize[1] - 1, 0, 0);
+    outputImage->SetSpacing(inputImage->GetSpacing());
+    outputImage->SetOrigin(inputImage->GetOrigin());
+    outputImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+
+    int inputExtent[6] = { 0 };
+    inputImage->GetExtent(inputExtent);
+    for (int y = 0; y < clipSize[1]; ++y)
+    {
+      const unsigned char* inputRow = static_cast<const unsigned char*>(inputImage->GetScalarPointer(inputExtent[0] + clipOrigin[0], inputExtent[2] + clipOrigin[1] + y, inputExtent[4]));
+      unsigned char* outputRow = static_cast<unsigned char*>(outputImage->GetScalarPointer(0, y, 0));
+      for (int x = 0; x < clipSize[0]; ++x)
+      {
+        const unsigned char* pixel = inputRow + x * numberOfComponents;
+        outputRow[x] = static_cast<unsigned char>((77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlImageStreamShaper::PlusIgtlImageStreamShaper()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlImageStreamShaper::~PlusIgtlImageStreamShaper()
+{
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlImageStreamShaper::GetShapingKey(const PlusIgtlClientInfo::ShapingParameters& parameters)
+{
+  std::ostringstream key;
+  key << parameters.ClipRectangleOrigin[0] << " " << parameters.ClipRectangleOrigin[1]
+      << "|" << parameters.ClipRectangleSize[0] << " " << parameters.ClipRectangleSize[1]
+      << "|" << parameters.TargetSize[0] << " " << parameters.TargetSize[1]
+      << "|" << (parameters.Grayscale ? 1 : 0)
+      << "|" << parameters.MaxFrameRate;
+  return key.str();
+}
+
+//----------------------------------------------------------------------------
+int PlusIgtlImageStreamShaper::GetNumberOfShapes() const
+{
+  return static_cast<int>(this->Shapes.size());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlImageStreamShaper::GetShapedFrame(const PlusIgtlClientInfo::ShapingParameters& parameters, igsioTrackedFrame& trackedFrame, igsioTrackedFrame*& shapedFrame, vtkMatrix4x4* shapedImageToImageMatrix)
+{
+  shapedFrame = NULL;
+  const double timestamp = trackedFrame.GetTimestamp();
+  const std::string key = GetShapingKey(parameters);
+
+  std::map<std::string, Shape>::iterator shapeIt = this->Shapes.find(key);
+  if (shapeIt == this->Shapes.end())
+  {
+    Shape newShape;
+    newShape.InputTimestamp = UNDEFINED_TIMESTAMP;
+    newShape.NextOutputTimestamp = UNDEFINED_TIMESTAMP;
+    newShape.OutputAvailable = false;
+    newShape.ShapedImageToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    newShape.Resize = vtkSmartPointer<vtkImageResize>::New();
+    newShape.Resize->SetResizeMethodToOutputDimensions();
+    // Align the edges (not the centers) of the corner pixels of the input and output images
+    newShape.Resize->BorderOn();
+    newShape.Resize->InterpolateOn();
+    newShape.UnsupportedGrayscaleConversionReported = false;
+    newShape.ShapingFailureReported = false;
+    shapeIt = this->Shapes.insert(std::make_pair(key, newShape)).first;
+  }
+  Shape& shape = shapeIt->second;
+
+  if (shape.InputTimestamp == UNDEFINED_TIMESTAMP || shape.InputTimestamp != timestamp)
+  {
+    // New frame, it has not been processed for another stream or client yet
+    shape.InputTimestamp = timestamp;
+    shape.OutputAvailable = false;
+
+    bool frameRateLimited = false;
+    if (parameters.MaxFrameRate > 0)
+    {
+      const double framePeriodSec = 1.0 / parameters.MaxFrameRate;
+      if (shape.NextOutputTimestamp != UNDEFINED_TIMESTAMP && timestamp + FRAME_RATE_TIMESTAMP_TOLERANCE_SEC < shape.NextOutputTimestamp)
+      {
+        frameRateLimited = true;
+      }
+      else if (shape.NextOutputTimestamp == UNDEFINED_TIMESTAMP || timestamp - shape.NextOutputTimestamp > framePeriodSec)
+      {
+        // First frame or there was a gap in the input, restart the schedule
+        shape.NextOutputTimestamp = timestamp + framePeriodSec;
+      }
+      else
+      {
+        // Keep the schedule, so that the average output rate matches the requested rate
+        shape.NextOutputTimestamp += framePeriodSec;
+      }
+    }
+
+    if (!frameRateLimited)
+    {
+      if (parameters.IsImageModified())
+      {
+        PLUS_METRIC_SCOPED_TIMER("plus_igtl_image_shaping_seconds", "");
+        shape.ShapedFrame = std::make_shared<igsioTrackedFrame>();
+        shape.ShapedFrame->SetTimestamp(timestamp);
+        igsioFieldMapType customFields = trackedFrame.GetCustomFields();
+        for (igsioFieldMapType::iterator fieldIt = customFields.begin(); fieldIt != customFields.end(); ++fieldIt)
+        {
+          shape.ShapedFrame->SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+        }
+        if (this->ShapeImage(parameters, shape, *trackedFrame.GetImageData(), *shape.ShapedFrame->GetImageData()) != PLUS_SUCCESS)
+        {
+          // Send the original image to all the clients that requested this shape instead of silently dropping the frame.
+          // The failure is reported only once, until shaping succeeds again, to avoid flooding the log.
+          if (!shape.ShapingFailureReported)
+          {
+            LOG_WARNING("Image shaping failed (shaping parameters: " << key << "). Original images are sent until shaping succeeds.");
+            shape.ShapingFailureReported = true;
+          }
+          shape.ShapedFrame.reset();
+          shape.ShapedImageToImageMatrix->Identity();
+        }
+        else if (shape.ShapingFailureReported)
+        {
+          LOG_INFO("Image shaping succeeded again (shaping parameters: " << key << ")");
+          shape.ShapingFailureReported = false;
+        }
+      }
+      else
+      {
+        shape.ShapedFrame.reset();
+        shape.ShapedImageToImageMatrix->Identity();
+      }
+      shape.OutputAvailable = true;
+    }
+
+    // Forget about shapes that are not requested anymore
+    for (std::map<std::string, Shape>::iterator it = this->Shapes.begin(); it != this->Shapes.end();)
+    {
+      if (it->second.InputTimestamp != UNDEFINED_TIMESTAMP && it->second.InputTimestamp < timestamp - UNUSED_SHAPE_TIMEOUT_SEC)
+      {
+        it = this->Shapes.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  if (!shape.OutputAvailable)
+  {
+    // Skipped because of the frame rate limit
+    return PLUS_SUCCESS;
+  }
+  shapedFrame = (shape.ShapedFrame != NULL ? shape.ShapedFrame.get() : &trackedFrame);
+  if (shapedImageToImageMatrix != NULL)
+  {
+    shapedImageToImageMatrix->DeepCopy(shape.ShapedImageToImageMatrix);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlImageStreamShaper::ShapeImage(const PlusIgtlClientInfo::ShapingParameters& parameters, Shape& shape, igsioVideoFrame& inputFrame, igsioVideoFrame& outputFrame)
+{
+  vtkImageData* inputImage = inputFrame.GetImage();
+  if (inputImage == NULL || !inputFrame.IsImageValid())
+  {
+    if (!shape.ShapingFailureReported)
+    {
+      LOG_ERROR("Failed to shape image: input image is invalid");
+    }
+    return PLUS_FAIL;
+  }
+  int dimensions[3] = { 0 };
+  inputImage->GetDimensions(dimensions);
+
+  // Clip rectangle
+  int clipOrigin[2] = { 0, 0 };
+  int clipSize[2] = { dimensions[0], dimensions[1] };
+  if (parameters.IsClipped())
+  {
+    for (int i = 0; i < 2; ++i)
+    {
+      clipOrigin[i] = std::max(0, parameters.ClipRectangleOrigin[i]);
+      clipSize[i] = std::min(parameters.ClipRectangleSize[i], dimensions[i] - clipOrigin[i]);
+    }
+    if (clipSize[0] <= 0 || clipSize[1] <= 0)
+    {
+      if (!shape.ShapingFailureReported)
+      {
+        LOG_ERROR("Failed to shape image: clip rectangle (origin: " << parameters.ClipRectangleOrigin[0] << ", " << parameters.ClipRectangleOrigin[1]
+                  << ", size: " << parameters.ClipRectangleSize[0] << ", " << parameters.ClipRectangleSize[1] << ") is outside the image (size: "
+                  << dimensions[0] << ", " << dimensions[1] << ")");
+      }
+      return PLUS_FAIL;
+    }
+  }
+
+  // Output size. If only one component is specified then the aspect ratio of the clipped region is preserved.
+  int outputSize[2] = { clipSize[0], clipSize[1] };
+  if (parameters.TargetSize[0] > 0 && parameters.TargetSize[1] > 0)
+  {
+    outputSize[0] = parameters.TargetSize[0];
+    outputSize[1] = parameters.TargetSize[1];
+  }
+  else if (parameters.TargetSize[0] > 0)
+  {
+    outputSize[0] = parameters.TargetSize[0];
+    outputSize[1] = std::max(1, static_cast<int>(clipSize[1] * static_cast<double>(parameters.TargetSize[0]) / clipSize[0] + 0.5));
+  }
+  else if (parameters.TargetSize[1] > 0)
+  {
+    outputSize[1] = parameters.TargetSize[1];
+    outputSize[0] = std::max(1, static_cast<int>(clipSize[0] * static_cast<double>(parameters.TargetSize[1]) / clipSize[1] + 0.5));
+  }
+
+  bool convertToGrayscale = false;
+  if (parameters.Grayscale && inputImage->GetNumberOfScalarComponents() > 1)
+  {
+    if (inputImage->GetScalarType() == VTK_UNSIGNED_CHAR && inputImage->GetNumberOfScalarComponents() >= 3)
+    {
+      convertToGrayscale = true;
+    }
+    else if (!shape.UnsupportedGrayscaleConversionReported)
+    {
+      LOG_WARNING("Grayscale conversion is only supported for unsigned char RGB or RGBA images. Images are sent in their original pixel format.");
+      shape.UnsupportedGrayscaleConversionReported = true;
+    }
+  }
+
+  // Clip and convert. These are done before resampling so that the resampling processes the fewest pixels.
+  vtkSmartPointer<vtkImageData> clippedImage = inputImage;
+  if (convertToGrayscale)
+  {
+    clippedImage = vtkSmartPointer<vtkImageData>::New();
+    ConvertToGrayscale(inputImage, clipOrigin, clipSize, clippedImage);
+  }
+  else if (parameters.IsClipped())
+  {
+    clippedImage = vtkSmartPointer<vtkImageData>::New();
+    igsioVideoFrame::FlipInfoType noFlip;
+    std::array<int, 3> clipRectangleOrigin = { clipOrigin[0], clipOrigin[1], 0 };
+    std::array<int, 3> clipRectangleSize = { clipSize[0], clipSize[1], 1 };
+    if (igsioVideoFrame::FlipClipImage(inputImage, noFlip, clipRectangleOrigin, clipRectangleSize, clippedImage) != PLUS_SUCCESS)
+    {
+      if (!shape.ShapingFailureReported)
+      {
+        LOG_ERROR("Failed to shape image: clipping failed");
+      }
+      return PLUS_FAIL;
+    }
+  }
+
+  // Resample
+  vtkImageData* outputImage = clippedImage;
+  if (outputSize[0] != clipSize[0] || outputSize[1] != clipSize[1])
+  {
+    shape.Resize->SetInputData(clippedImage);
+    shape.Resize->SetOutputDimensions(outputSize[0], outputSize[1], 1);
+    shape.Resize->Update();
+    outputImage = shape.Resize->GetOutput();
+  }
+
+  if (outputFrame.DeepCopyFrom(outputImage) != PLUS_SUCCESS)
+  {
+    if (!shape.ShapingFailureReported)
+    {
+      LOG_ERROR("Failed to shape image: cannot copy the shaped image");
+    }
+    return PLUS_FAIL;
+  }
+  // The image to reference transform describes the image geometry, keep the spacing and origin of the input image
+  outputFrame.GetImage()->SetSpacing(inputImage->GetSpacing());
+  outputFrame.GetImage()->SetOrigin(inputImage->GetOrigin());
+  outputFrame.SetImageOrientation(inputFrame.GetImageOrientation());
+  outputFrame.SetImageType(convertToGrayscale ? US_IMG_BRIGHTNESS : inputFrame.GetImageType());
+
+  // Shaped image pixel (i, j) covers the input image region starting at clipOrigin + (i, j) * scale (edges are aligned),
+  // therefore its center is at clipOrigin + (i + 0.5) * scale - 0.5.
+  // The Image coordinate frame unit is the pixel (ImageToReference maps pixel indices to the reference frame), so the
+  // translation is in input pixels and the image spacing must not be applied.
+  shape.ShapedImageToImageMatrix->Identity();
+  for (int i = 0; i < 2; ++i)
+  {
+    double scale = static_cast<double>(clipSize[i]) / outputSize[i];
+    shape.ShapedImageToImageMatrix->SetElement(i, i, scale);
+    shape.ShapedImageToImageMatrix->SetElement(i, 3, clipOrigin[i] + 0.5 * scale - 0.5);
+  }
+
+  return PLUS_SUCCESS;
+}
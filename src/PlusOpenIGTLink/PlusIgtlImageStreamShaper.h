@@ -0,0 +1,93 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlImageStreamShaper_h
+#define __PlusIgtlImageStreamShaper_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlClientInfo.h"
+#include "vtkPlusOpenIGTLinkExport.h"
+
+// STL includes
+#include <map>
+#include <memory>
+#include <string>
+
+class igsioTrackedFrame;
+class igsioVideoFrame;
+class vtkImageData;
+class vtkImageResize;
+class vtkMatrix4x4;
+
+/*!
+  \class PlusIgtlImageStreamShaper
+  \brief Reduces image streams (clipping, resampling, grayscale conversion, frame rate limiting) for clients that do not need the full images
+
+  Each distinct set of shaping parameters is applied only once to each frame, the result is reused for all the image
+  and video streams of all clients that requested the same shaping parameters.
+
+  The shaped image has a different size and origin than the original image, therefore the image to reference transform
+  of the shaped image is ImageToReference * ShapedImageToImage, where ShapedImageToImage is returned by GetShapedFrame.
+  The unit of the Image coordinate frame is the pixel (regardless of the image spacing), so ShapedImageToImage maps
+  shaped image pixel indices to input image pixel indices.
+
+  Not thread-safe, it is intended to be used from the thread that packs the messages.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport PlusIgtlImageStreamShaper
+{
+public:
+  PlusIgtlImageStreamShaper();
+  ~PlusIgtlImageStreamShaper();
+
+  /*! Get a string that uniquely identifies the shaping parameters */
+  static std::string GetShapingKey(const PlusIgtlClientInfo::ShapingParameters& parameters);
+
+  /*!
+    Get the shaped version of the tracked frame
+    \param parameters Shaping parameters
+    \param trackedFrame Input frame
+    \param shapedFrame Output frame. Set to NULL if the frame must not be sent because of the frame rate limit.
+      It may be the input frame itself (if only the frame rate is limited, or if shaping failed, in which case the transform is identity).
+      The frame is valid until the next call with the same parameters.
+    \param shapedImageToImageMatrix Transform from shaped image pixel coordinates to input image pixel coordinates
+  */
+  PlusStatus GetShapedFrame(const PlusIgtlClientInfo::ShapingParameters& parameters, igsioTrackedFrame& trackedFrame, igsioTrackedFrame*& shapedFrame, vtkMatrix4x4* shapedImageToImageMatrix);
+
+  /*! Get the number of distinct shaping parameter sets that are currently in use */
+  int GetNumberOfShapes() const;
+
+protected:
+  struct Shape
+  {
+    /*! Timestamp of the last input frame */
+    double InputTimestamp;
+    /*! Frames received before this time are not sent (used for frame rate limiting) */
+    double NextOutputTimestamp;
+    /*! True if the last input frame has to be sent */
+    bool OutputAvailable;
+    /*! Shaped version of the last input frame, NULL if the image does not have to be modified */
+    std::shared_ptr<igsioTrackedFrame> ShapedFrame;
+    vtkSmartPointer<vtkMatrix4x4> ShapedImageToImageMatrix;
+    vtkSmartPointer<vtkImageResize> Resize;
+    bool UnsupportedGrayscaleConversionReported;
+    /*! True if a shaping failure has been reported and shaping has not succeeded since then */
+    bool ShapingFailureReported;
+  };
+
+  /*! Clip, convert and resample the image */
+  PlusStatus ShapeImage(const PlusIgtlClientInfo::ShapingParameters& parameters, Shape& shape, igsioVideoFrame& inputFrame, igsioVideoFrame& outputFrame);
+
+  std::map<std::string, Shape> Shapes;
+
+private:
+  PlusIgtlImageStreamShaper(const PlusIgtlImageStreamShaper&);
+  void operator=(const PlusIgtlImageStreamShaper&);
+};
+
+#endif //__PlusIgtlImageStreamShaper_h
@@ -0,0 +1,398 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlSharedMemoryRing.h"
+
+// STL includes
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+  const uint32_t RING_MAGIC = 0x504C5352; // "PLSR"
+  const uint32_t RING_LAYOUT_VERSION = 1;
+
+  // Ring header, slot headers, and slot data are aligned to cache lines to avoid false sharing
+  const size_t CACHE_LINE_SIZE = 64;
+
+  //----------------------------------------------------------------------------
+  size_t AlignToCacheLine(size_t size)
+  {
+    return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetPlatformName(const std::string& name)
+  {
+#ifdef _WIN32
+    return "Local\\" + name;
+#else
+    return "/" + name;
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+struct PlusIgtlSharedMemoryRing::RingHeader
+{
+  uint32_t Magic;
+  uint32_t LayoutVersion;
+  uint32_t NumberOfSlots;
+  uint32_t Reserved;
+  uint64_t SlotSize;
+  /*! Sequence number of the next data block that will be written */
+  std::atomic<uint64_t> NextSequenceNumber;
+};
+
+//----------------------------------------------------------------------------
+struct PlusIgtlSharedMemoryRing::SlotHeader
+{
+  /*! 0: empty, 2*n+1: data block n is being written, 2*n+2: data block n is available */
+  std::atomic<uint64_t> State;
+  uint64_t DataSize;
+};
+
+//----------------------------------------------------------------------------
+PlusIgtlSharedMemoryRing::PlusIgtlSharedMemoryRing()
+  : Writer(false)
+  , SlotSize(0)
+  , SlotStride(0)
+  , NumberOfSlots(0)
+  , Memory(NULL)
+  , MemorySize(0)
+#ifdef _WIN32
+  , MappingHandle(NULL)
+#endif
+{
+  static_assert(sizeof(RingHeader) <= CACHE_LINE_SIZE, "Shared memory ring header must fit in a cache line");
+  static_assert(sizeof(SlotHeader) <= CACHE_LINE_SIZE, "Shared memory slot header must fit in a cache line");
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlSharedMemoryRing::~PlusIgtlSharedMemoryRing()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSharedMemoryRing::Create(const std::string& name, unsigned int numberOfSlots, size_t slotSize)
+{
+  this->Close();
+
+  if (name.empty() || numberOfSlots == 0 || slotSize == 0)
+  {
+    LOG_ERROR("Failed to create shared memory ring - invalid parameters (name: '" << name << "', number of slots: " << numberOfSlots << ", slot size: " << slotSize << ")");
+    return PLUS_FAIL;
+  }
+
+  size_t slotStride = CACHE_LINE_SIZE + AlignToCacheLine(slotSize);
+  size_t memorySize = CACHE_LINE_SIZE + numberOfSlots * slotStride;
+  std::string platformName = GetPlatformName(name);
+
+#ifdef _WIN32
+  HANDLE mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                         static_cast<DWORD>(static_cast<uint64_t>(memorySize) >> 32), static_cast<DWORD>(memorySize & 0xFFFFFFFF), platformName.c_str());
+  if (mappingHandle == NULL)
+  {
+    LOG_ERROR("Failed to create shared memory ring " << name << " (error code: " << GetLastError() << ")");
+    return PLUS_FAIL;
+  }
+  if (GetLastError() == ERROR_ALREADY_EXISTS)
+  {
+    LOG_ERROR("Failed to create shared memory ring " << name << " - it already exists");
+    CloseHandle(mappingHandle);
+    return PLUS_FAIL;
+  }
+  void* memory = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, memorySize);
+  if (memory == NULL)
+  {
+    LOG_ERROR("Failed to map shared memory ring " << name << " (error code: " << GetLastError() << ")");
+    CloseHandle(mappingHandle);
+    return PLUS_FAIL;
+  }
+  this->MappingHandle = mappingHandle;
+#else
+  // Remove the leftover of a process that was terminated without closing the ring
+  shm_unlink(platformName.c_str());
+  int fd = shm_open(platformName.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+  {
+    LOG_ERROR("Failed to create shared memory ring " << name << ": " << strerror(errno));
+    return PLUS_FAIL;
+  }
+  if (ftruncate(fd, static_cast<off_t>(memorySize)) != 0)
+  {
+    LOG_ERROR("Failed to allocate " << memorySize << " bytes for shared memory ring " << name << ": " << strerror(errno));
+    close(fd);
+    shm_unlink(platformName.c_str());
+    return PLUS_FAIL;
+  }
+  void* memory = mmap(NULL, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED)
+  {
+    LOG_ERROR("Failed to map shared memory ring " << name << ": " << strerror(errno));
+    shm_unlink(platformName.c_str());
+    return PLUS_FAIL;
+  }
+#endif
+
+  this->Name = name;
+  this->Writer = true;
+  this->SlotSize = slotSize;
+  this->SlotStride = slotStride;
+  this->NumberOfSlots = numberOfSlots;
+  this->Memory = static_cast<unsigned char*>(memory);
+  this->MemorySize = memorySize;
+
+  // The memory is zero-filled, readers reject the ring until the magic number is set
+  RingHeader* header = new (this->Memory) RingHeader;
+  header->LayoutVersion = RING_LAYOUT_VERSION;
+  header->NumberOfSlots = numberOfSlots;
+  header->Reserved = 0;
+  header->SlotSize = slotSize;
+  header->NextSequenceNumber.store(0, std::memory_order_relaxed);
+  for (unsigned int i = 0; i < numberOfSlots; ++i)
+  {
+    SlotHeader* slot = new (this->Memory + CACHE_LINE_SIZE + i * slotStride) SlotHeader;
+    slot->State.store(0, std::memory_order_relaxed);
+    slot->DataSize = 0;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  header->Magic = RING_MAGIC;
+
+  LOG_DEBUG("Shared memory ring " << name << " created: " << numberOfSlots << " slots of " << slotSize << " bytes");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSharedMemoryRing::Open(const std::string& name)
+{
+  this->Close();
+
+  // Failures are logged at debug level only: a ring that cannot be opened (e.g., because the server runs as a
+  // different user) is an expected condition for clients that fall back to the socket, the caller reports it.
+  std::string platformName = GetPlatformName(name);
+
+  // The memory is mapped writable for readers as well, because atomic 64-bit loads
+  // may be implemented with compare-exchange instructions on 32-bit platforms.
+#ifdef _WIN32
+  HANDLE mappingHandle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, platformName.c_str());
+  if (mappingHandle == NULL)
+  {
+    LOG_DEBUG("Failed to open shared memory ring " << name << " (error code: " << GetLastError() << ")");
+    return PLUS_FAIL;
+  }
+  void* memory = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  if (memory == NULL)
+  {
+    LOG_DEBUG("Failed to map shared memory ring " << name << " (error code: " << GetLastError() << ")");
+    CloseHandle(mappingHandle);
+    return PLUS_FAIL;
+  }
+  MEMORY_BASIC_INFORMATION memoryInfo;
+  size_t memorySize = (VirtualQuery(memory, &memoryInfo, sizeof(memoryInfo)) != 0 ? memoryInfo.RegionSize : 0);
+  this->MappingHandle = mappingHandle;
+#else
+  int fd = shm_open(platformName.c_str(), O_RDWR, 0);
+  if (fd < 0)
+  {
+    LOG_DEBUG("Failed to open shared memory ring " << name << ": " << strerror(errno));
+    return PLUS_FAIL;
+  }
+  struct stat fileStatus;
+  if (fstat(fd, &fileStatus) != 0 || fileStatus.st_size <= 0)
+  {
+    LOG_DEBUG("Failed to get the size of shared memory ring " << name);
+    close(fd);
+    return PLUS_FAIL;
+  }
+  size_t memorySize = static_cast<size_t>(fileStatus.st_size);
+  void* memory = mmap(NULL, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED)
+  {
+    LOG_DEBUG("Failed to map shared memory ring " << name << ": " << strerror(errno));
+    return PLUS_FAIL;
+  }
+#endif
+
+  this->Name = name;
+  this->Writer = false;
+  this->Memory = static_cast<unsigned char*>(memory);
+  this->MemorySize = memorySize;
+
+  const RingHeader* header = reinterpret_cast<const RingHeader*>(this->Memory);
+  if (memorySize < CACHE_LINE_SIZE || header->Magic != RING_MAGIC)
+  {
+    LOG_DEBUG("Failed to open shared memory ring " << name << " - ring is not initialized");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header->LayoutVersion != RING_LAYOUT_VERSION)
+  {
+    LOG_DEBUG("Failed to open shared memory ring " << name << " - unsupported layout version: " << header->LayoutVersion << " (supported: " << RING_LAYOUT_VERSION << ")");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  this->NumberOfSlots = header->NumberOfSlots;
+  this->SlotSize = static_cast<size_t>(header->SlotSize);
+  this->SlotStride = CACHE_LINE_SIZE + AlignToCacheLine(this->SlotSize);
+  if (this->NumberOfSlots == 0 || memorySize < CACHE_LINE_SIZE + this->NumberOfSlots * this->SlotStride)
+  {
+    LOG_DEBUG("Failed to open shared memory ring " << name << " - ring is truncated");
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlSharedMemoryRing::Close()
+{
+  if (this->Memory == NULL)
+  {
+    return;
+  }
+
+#ifdef _WIN32
+  // The file mapping is removed by the system when the last handle is closed
+  UnmapViewOfFile(this->Memory);
+  CloseHandle(this->MappingHandle);
+  this->MappingHandle = NULL;
+#else
+  munmap(this->Memory, this->MemorySize);
+  if (this->Writer)
+  {
+    // Readers that still have the ring mapped can continue to use it, the memory is released when they unmap it
+    shm_unlink(GetPlatformName(this->Name).c_str());
+  }
+#endif
+
+  this->Memory = NULL;
+  this->MemorySize = 0;
+  this->Name.clear();
+  this->Writer = false;
+  this->SlotSize = 0;
+  this->SlotStride = 0;
+  this->NumberOfSlots = 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSharedMemoryRing::Write(const void* data, size_t dataSize, uint64_t& sequenceNumber)
+{
+  if (!this->Writer)
+  {
+    LOG_ERROR("Failed to write into shared memory ring " << this->Name << " - ring is not created by this object");
+    return PLUS_FAIL;
+  }
+  if (dataSize > this->SlotSize)
+  {
+    LOG_ERROR("Failed to write into shared memory ring " << this->Name << " - data size (" << dataSize << ") exceeds slot size (" << this->SlotSize << ")");
+    return PLUS_FAIL;
+  }
+
+  RingHeader* header = reinterpret_cast<RingHeader*>(this->Memory);
+  sequenceNumber = header->NextSequenceNumber.load(std::memory_order_relaxed);
+
+  SlotHeader* slot = this->GetSlotHeader(sequenceNumber);
+  slot->State.store(2 * sequenceNumber + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->DataSize = dataSize;
+  if (dataSize > 0)
+  {
+    memcpy(reinterpret_cast<unsigned char*>(slot) + CACHE_LINE_SIZE, data, dataSize);
+  }
+  slot->State.store(2 * sequenceNumber + 2, std::memory_order_release);
+
+  header->NextSequenceNumber.store(sequenceNumber + 1, std::memory_order_release);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSharedMemoryRing::Read(uint64_t sequenceNumber, void* buffer, size_t bufferSize) const
+{
+  if (this->Memory == NULL)
+  {
+    LOG_ERROR("Failed to read from shared memory ring - ring is not open");
+    return PLUS_FAIL;
+  }
+
+  SlotHeader* slot = this->GetSlotHeader(sequenceNumber);
+  const uint64_t completedState = 2 * sequenceNumber + 2;
+  if (slot->State.load(std::memory_order_acquire) != completedState)
+  {
+    // Overwritten by a newer data block or not written yet
+    return PLUS_FAIL;
+  }
+  if (slot->DataSize != bufferSize)
+  {
+    LOG_ERROR("Failed to read from shared memory ring " << this->Name << " - data size (" << slot->DataSize << ") does not match the expected size (" << bufferSize << ")");
+    return PLUS_FAIL;
+  }
+  if (bufferSize > 0)
+  {
+    memcpy(buffer, reinterpret_cast<const unsigned char*>(slot) + CACHE_LINE_SIZE, bufferSize);
+  }
+
+  // If the writer started to overwrite the slot during the copy then the copied data may be inconsistent
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot->State.load(std::memory_order_relaxed) != completedState)
+  {
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlSharedMemoryRing::SlotHeader* PlusIgtlSharedMemoryRing::GetSlotHeader(uint64_t sequenceNumber) const
+{
+  return reinterpret_cast<SlotHeader*>(this->Memory + CACHE_LINE_SIZE + (sequenceNumber % this->NumberOfSlots) * this->SlotStride);
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlSharedMemoryRing::IsOpen() const
+{
+  return this->Memory != NULL;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlSharedMemoryRing::IsWriter() const
+{
+  return this->Writer;
+}
+
+//----------------------------------------------------------------------------
+const std::string& PlusIgtlSharedMemoryRing::GetName() const
+{
+  return this->Name;
+}
+
+//----------------------------------------------------------------------------
+size_t PlusIgtlSharedMemoryRing::GetSlotSize() const
+{
+  return this->SlotSize;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusIgtlSharedMemoryRing::GetNumberOfSlots() const
+{
+  return this->NumberOfSlots;
+}
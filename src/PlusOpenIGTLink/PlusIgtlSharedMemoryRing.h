@@ -0,0 +1,104 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlSharedMemoryRing_h
+#define __PlusIgtlSharedMemoryRing_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusOpenIGTLinkExport.h"
+
+// STL includes
+#include <cstdint>
+#include <string>
+
+/*!
+  \class PlusIgtlSharedMemoryRing
+  \brief Fixed size ring of data slots in named shared memory, for passing image data to clients on the same host
+
+  The ring is created by a single writer process (the server) and can be opened by any number of reader processes.
+  Each written data block gets a sequence number, which the writer has to communicate to the readers
+  (e.g., in an OpenIGTLink message that is sent through the socket). Readers copy the data block out of the ring
+  using the sequence number. Readers never block the writer: if a reader falls behind by more than the number of
+  slots then the slot is already overwritten and Read() fails, the reader has to skip that data block.
+
+  Each slot is protected by a sequence lock: the slot state is odd while the writer is writing the slot and
+  it contains the sequence number of the stored data block when the write is completed. Readers check the
+  state before and after copying the data, therefore they detect if the slot is overwritten during the copy.
+
+  On POSIX systems the ring is stored in a POSIX shared memory object, on Windows in a named file mapping.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport PlusIgtlSharedMemoryRing
+{
+public:
+  PlusIgtlSharedMemoryRing();
+  /*! Closes the ring. The shared memory is removed if this object created it. */
+  ~PlusIgtlSharedMemoryRing();
+
+  /*!
+    Create a new ring for writing
+    \param name Name of the ring (letters, digits, and underscores), the platform specific prefix is added automatically
+    \param numberOfSlots Number of data blocks that are kept in the ring
+    \param slotSize Maximum size of a data block in bytes
+  */
+  PlusStatus Create(const std::string& name, unsigned int numberOfSlots, size_t slotSize);
+
+  /*!
+    Open an existing ring for reading.
+    Failures are only logged at debug level, the caller has to report them (or fall back to another transport).
+  */
+  PlusStatus Open(const std::string& name);
+
+  /*! Unmap the shared memory. The shared memory is removed if this object created it. */
+  void Close();
+
+  /*!
+    Write a data block into the next slot. Only the object that created the ring may write into it.
+    \param sequenceNumber Sequence number of the written data block, readers can get the data block with this number
+  */
+  PlusStatus Write(const void* data, size_t dataSize, uint64_t& sequenceNumber);
+
+  /*!
+    Copy a data block out of the ring
+    \param sequenceNumber Sequence number of the data block
+    \param buffer Output buffer
+    \param bufferSize Size of the output buffer in bytes. Must be the same as the size of the stored data block.
+    Returns PLUS_FAIL if the data block is already overwritten, not written yet, or its size is not the expected size.
+  */
+  PlusStatus Read(uint64_t sequenceNumber, void* buffer, size_t bufferSize) const;
+
+  bool IsOpen() const;
+  bool IsWriter() const;
+  const std::string& GetName() const;
+  size_t GetSlotSize() const;
+  unsigned int GetNumberOfSlots() const;
+
+protected:
+  struct RingHeader;
+  struct SlotHeader;
+
+  SlotHeader* GetSlotHeader(uint64_t sequenceNumber) const;
+
+  std::string Name;
+  bool Writer;
+  size_t SlotSize;
+  size_t SlotStride;
+  unsigned int NumberOfSlots;
+  unsigned char* Memory;
+  size_t MemorySize;
+
+#ifdef _WIN32
+  void* MappingHandle;
+#endif
+
+private:
+  PlusIgtlSharedMemoryRing(const PlusIgtlSharedMemoryRing&);
+  void operator=(const PlusIgtlSharedMemoryRing&);
+};
+
+#endif //__PlusIgtlSharedMemoryRing_h
@@ -0,0 +1,346 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlImageStreamShaper.h"
+#include "PlusIgtlVideoEncoderPool.h"
+#include "PlusMetrics.h"
+
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+
+// IGSIO includes
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOFrameConverter.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+
+// OpenIGTLink includes
+#include "igtlCodecCommonClasses.h"
+#include "igtlVideoMessage.h"
+
+// Local includes
+#include "vtkPlusIgtlMessageCommon.h"
+
+// STL includes
+#include <sstream>
+
+namespace
+{
+  // Number of encoded messages that are kept for clients that have not retrieved them yet.
+  // A client that falls behind more than this restarts from the next key frame.
+  const size_t MAX_NUMBER_OF_RETAINED_MESSAGES = 30;
+
+  //----------------------------------------------------------------------------
+  std::map<std::string, std::string> GetEncoderParameters(const PlusIgtlClientInfo::EncodingParameters& encodingParameters)
+  {
+    std::map<std::string, std::string> parameters;
+    parameters["losslessEncoding"] = encodingParameters.Lossless ? "1" : "0";
+    if (!encodingParameters.Lossless)
+    {
+      parameters["rateControl"] = encodingParameters.RateControl;
+      parameters["minimumKeyFrameDistance"] = igsioCommon::ToString(encodingParameters.MinKeyframeDistance);
+      parameters["maximumKeyFrameDistance"] = igsioCommon::ToString(encodingParameters.MaxKeyframeDistance);
+      parameters["encodingSpeed"] = igsioCommon::ToString(encodingParameters.Speed);
+      parameters["bitRate"] = igsioCommon::ToString(encodingParameters.TargetBitrate);
+      parameters["deadlineMode"] = encodingParameters.DeadlineMode;
+    }
+    return parameters;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlVideoEncoderPool::PlusIgtlVideoEncoderPool()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlVideoEncoderPool::~PlusIgtlVideoEncoderPool()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.begin(); encoderIt != this->Encoders.end(); ++encoderIt)
+  {
+    StopEncoder(*encoderIt->second);
+  }
+  this->Encoders.clear();
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlVideoEncoderPool::GetEncoderKey(const PlusIgtlClientInfo::VideoStream& videoStream, int headerVersion)
+{
+  const PlusIgtlClientInfo::EncodingParameters& parameters = videoStream.EncodeVideoParameters;
+  std::ostringstream key;
+  key << videoStream.Name << "|" << videoStream.EmbeddedTransformToFrame
+      << "|" << parameters.FourCC
+      << "|" << (parameters.Lossless ? 1 : 0)
+      << "|" << parameters.MinKeyframeDistance
+      << "|" << parameters.MaxKeyframeDistance
+      << "|" << parameters.Speed
+      << "|" << parameters.RateControl
+      << "|" << parameters.DeadlineMode
+      << "|" << parameters.TargetBitrate
+      << "|" << PlusIgtlImageStreamShaper::GetShapingKey(videoStream.Shaping)
+      << "|" << headerVersion;
+  return key.str();
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoEncoderPool::SubmitFrame(const std::string& encoderKey, int clientId, const PlusIgtlClientInfo::EncodingParameters& encodingParameters, igtl::MessageBase::Pointer messageTemplate,
+    const std::string& deviceName, igsioTrackedFrame& trackedFrame, vtkMatrix4x4& imageToReferenceMatrix)
+{
+  std::shared_ptr<Encoder> encoder;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.find(encoderKey);
+    if (encoderIt == this->Encoders.end())
+    {
+      encoder = std::make_shared<Encoder>();
+      encoder->Key = encoderKey;
+      encoder->EncodingParameters = encodingParameters;
+      encoder->MessageTemplate = messageTemplate;
+      encoder->StopRequested = false;
+      encoder->LastSubmittedTimestamp = UNDEFINED_TIMESTAMP;
+      encoder->KeyFrameRequested = true;
+      encoder->NextSequenceNumber = 0;
+      encoder->Thread = std::thread(&PlusIgtlVideoEncoderPool::EncoderThread, encoder);
+      this->Encoders[encoderKey] = encoder;
+      LOG_DEBUG("Video encoder started: " << encoderKey);
+    }
+    else
+    {
+      encoder = encoderIt->second;
+    }
+    // Subscribe while the pool is locked, so a concurrent RemoveClient cannot miss the encoder
+    std::lock_guard<std::mutex> encoderLock(encoder->Mutex);
+    AddSubscriber(*encoder, clientId);
+  }
+
+  std::lock_guard<std::mutex> encoderLock(encoder->Mutex);
+  if (encoder->LastSubmittedTimestamp != UNDEFINED_TIMESTAMP && trackedFrame.GetTimestamp() <= encoder->LastSubmittedTimestamp)
+  {
+    // This frame has been already submitted for another client
+    return;
+  }
+  encoder->LastSubmittedTimestamp = trackedFrame.GetTimestamp();
+  if (encoder->PendingFrame)
+  {
+    // The encoder could not keep up, the previous frame is skipped
+    PLUS_METRIC_COUNTER_ADD("plus_igtl_video_encoder_dropped_frames_total", PlusMetricsRegistry::MakeLabel("encoder", encoder->Key), 1);
+  }
+  encoder->PendingFrame = std::make_shared<igsioTrackedFrame>(trackedFrame);
+  if (encoder->PendingMatrix == NULL)
+  {
+    encoder->PendingMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  }
+  encoder->PendingMatrix->DeepCopy(&imageToReferenceMatrix);
+  encoder->PendingDeviceName = deviceName;
+  encoder->Condition.notify_one();
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoEncoderPool::GetEncodedMessages(const std::string& encoderKey, int clientId, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+{
+  std::shared_ptr<Encoder> encoder;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.find(encoderKey);
+    if (encoderIt == this->Encoders.end())
+    {
+      return;
+    }
+    encoder = encoderIt->second;
+  }
+
+  std::lock_guard<std::mutex> encoderLock(encoder->Mutex);
+  Subscriber& subscriber = AddSubscriber(*encoder, clientId);
+
+  if (!encoder->EncodedMessages.empty() && subscriber.NextSequenceNumber < encoder->EncodedMessages.front().SequenceNumber)
+  {
+    // Some messages are already discarded, the client has to wait for a new key frame
+    LOG_DEBUG("Client " << clientId << " fell behind on video stream " << encoderKey << ", waiting for next key frame");
+    subscriber.WaitingForDecodingStartPoint = true;
+    encoder->KeyFrameRequested = true;
+  }
+
+  for (std::deque<EncodedMessage>::const_iterator messageIt = encoder->EncodedMessages.begin(); messageIt != encoder->EncodedMessages.end(); ++messageIt)
+  {
+    if (messageIt->SequenceNumber < subscriber.NextSequenceNumber)
+    {
+      continue;
+    }
+    if (subscriber.WaitingForDecodingStartPoint)
+    {
+      if (!messageIt->DecodingStartPoint)
+      {
+        continue;
+      }
+      subscriber.WaitingForDecodingStartPoint = false;
+    }
+    igtlMessages.push_back(messageIt->Message);
+  }
+  subscriber.NextSequenceNumber = encoder->NextSequenceNumber;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoEncoderPool::RemoveClient(int clientId)
+{
+  std::vector<std::shared_ptr<Encoder> > encodersToStop;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.begin(); encoderIt != this->Encoders.end();)
+    {
+      bool unused = false;
+      {
+        std::lock_guard<std::mutex> encoderLock(encoderIt->second->Mutex);
+        if (encoderIt->second->Subscribers.erase(clientId) > 0)
+        {
+          unused = encoderIt->second->Subscribers.empty();
+        }
+      }
+      if (unused)
+      {
+        LOG_DEBUG("Video encoder stopped: " << encoderIt->first);
+        encodersToStop.push_back(encoderIt->second);
+        encoderIt = this->Encoders.erase(encoderIt);
+      }
+      else
+      {
+        ++encoderIt;
+      }
+    }
+  }
+
+  // Join the threads outside the lock so that sending to other clients is not blocked
+  for (std::vector<std::shared_ptr<Encoder> >::iterator encoderIt = encodersToStop.begin(); encoderIt != encodersToStop.end(); ++encoderIt)
+  {
+    StopEncoder(**encoderIt);
+  }
+}
+
+//----------------------------------------------------------------------------
+int PlusIgtlVideoEncoderPool::GetNumberOfEncoders() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return static_cast<int>(this->Encoders.size());
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlVideoEncoderPool::Subscriber& PlusIgtlVideoEncoderPool::AddSubscriber(Encoder& encoder, int clientId)
+{
+  std::map<int, Subscriber>::iterator subscriberIt = encoder.Subscribers.find(clientId);
+  if (subscriberIt == encoder.Subscribers.end())
+  {
+    // New client, it can only start decoding from a key frame
+    Subscriber subscriber;
+    subscriber.NextSequenceNumber = encoder.NextSequenceNumber;
+    subscriber.WaitingForDecodingStartPoint = true;
+    subscriberIt = encoder.Subscribers.insert(std::make_pair(clientId, subscriber)).first;
+    encoder.KeyFrameRequested = true;
+  }
+  return subscriberIt->second;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoEncoderPool::StopEncoder(Encoder& encoder)
+{
+  {
+    std::lock_guard<std::mutex> encoderLock(encoder.Mutex);
+    encoder.StopRequested = true;
+  }
+  encoder.Condition.notify_all();
+  if (encoder.Thread.joinable())
+  {
+    encoder.Thread.join();
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoEncoderPool::EncoderThread(std::shared_ptr<Encoder> encoder)
+{
+  vtkSmartPointer<vtkIGSIOFrameConverter> frameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+  std::map<std::string, std::string> parameters = GetEncoderParameters(encoder->EncodingParameters);
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+
+  while (true)
+  {
+    std::shared_ptr<igsioTrackedFrame> trackedFrame;
+    std::string deviceName;
+    bool keyFrameRequested = false;
+    {
+      std::unique_lock<std::mutex> encoderLock(encoder->Mutex);
+      encoder->Condition.wait(encoderLock, [&encoder] { return encoder->StopRequested || encoder->PendingFrame; });
+      if (encoder->StopRequested)
+      {
+        break;
+      }
+      trackedFrame.swap(encoder->PendingFrame);
+      matrix->DeepCopy(encoder->PendingMatrix);
+      deviceName = encoder->PendingDeviceName;
+      keyFrameRequested = encoder->KeyFrameRequested;
+      encoder->KeyFrameRequested = false;
+    }
+
+    if (keyFrameRequested)
+    {
+      frameConverter->RequestKeyFrameOn();
+    }
+
+    igtl::VideoMessage::Pointer videoMessage = dynamic_cast<igtl::VideoMessage*>(encoder->MessageTemplate->Clone().GetPointer());
+    videoMessage->SetDeviceName(deviceName.c_str());
+
+    // Send igsioTrackedFrame::CustomFrameFields as meta data in the video message.
+    std::vector<std::string> frameFields;
+    trackedFrame->GetFrameFieldNameList(frameFields);
+    for (std::vector<std::string>::const_iterator stringNameIterator = frameFields.begin(); stringNameIterator != frameFields.end(); ++stringNameIterator)
+    {
+      if (trackedFrame->GetFrameField(*stringNameIterator).empty())
+      {
+        // No value is available, do not send anything
+        continue;
+      }
+      videoMessage->SetMetaDataElement(*stringNameIterator, IANA_TYPE_US_ASCII, trackedFrame->GetFrameField(*stringNameIterator));
+    }
+
+    PlusStatus packStatus = PLUS_FAIL;
+    {
+      PLUS_METRIC_SCOPED_TIMER("plus_igtl_video_encode_seconds", PlusMetricsRegistry::MakeLabel("encoder", encoder->Key));
+      packStatus = vtkPlusIgtlMessageCommon::PackVideoMessage(videoMessage, *trackedFrame, *matrix, frameConverter, encoder->EncodingParameters.FourCC, parameters);
+    }
+    if (packStatus != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to create VIDEO message - unable to pack video message (" << deviceName << ")");
+      if (keyFrameRequested)
+      {
+        // Try again with the next frame
+        std::lock_guard<std::mutex> encoderLock(encoder->Mutex);
+        encoder->KeyFrameRequested = true;
+      }
+      continue;
+    }
+
+    // The key frame flag is in the low byte for color frames and in the high byte for grayscale frames
+    int frameType = videoMessage->GetFrameType();
+    bool isKeyFrame = ((frameType & 0xFF) == FrameTypeKey) || ((frameType >> 8) == FrameTypeKey);
+
+    std::lock_guard<std::mutex> encoderLock(encoder->Mutex);
+    if (keyFrameRequested && !isKeyFrame)
+    {
+      // The encoder did not produce the requested key frame, subscribers keep waiting for one
+      encoder->KeyFrameRequested = true;
+    }
+    EncodedMessage encodedMessage;
+    encodedMessage.SequenceNumber = encoder->NextSequenceNumber++;
+    encodedMessage.DecodingStartPoint = isKeyFrame;
+    encodedMessage.Message = videoMessage.GetPointer();
+    encoder->EncodedMessages.push_back(encodedMessage);
+    while (encoder->EncodedMessages.size() > MAX_NUMBER_OF_RETAINED_MESSAGES)
+    {
+      encoder->EncodedMessages.pop_front();
+    }
+  }
+}
+
+#endif
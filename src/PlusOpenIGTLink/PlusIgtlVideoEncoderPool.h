@@ -0,0 +1,149 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlVideoEncoderPool_h
+#define __PlusIgtlVideoEncoderPool_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlClientInfo.h"
+#include "vtkPlusOpenIGTLinkExport.h"
+
+// OpenIGTLink includes
+#include <igtlMessageBase.h>
+
+// STL includes
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+
+class igsioTrackedFrame;
+class vtkMatrix4x4;
+
+/*!
+  \class PlusIgtlVideoEncoderPool
+  \brief Encodes OpenIGTLink VIDEO messages on background threads, shared by all clients that request the same stream
+
+  There is one encoder for each distinct (video stream name, embedded transform frame, encoding parameters, shaping parameters,
+  IGTL header version) combination. Each encoder has its own frame converter and worker thread, so encoding does not delay sending other messages
+  (TRANSFORM, TDATA, ...) and clients that request the same stream with the same encoding parameters share a single encoder.
+
+  Frames are submitted by SubmitFrame. If the encoder is still busy with a previous frame when a new one arrives then only the
+  most recent frame is kept, so a slow encoder reduces the video frame rate instead of accumulating latency. The same frame
+  may be submitted for each client, it is encoded only once.
+
+  Encoded messages are packed once and the same (reference counted) message object is returned to each client by
+  GetEncodedMessages. Messages are returned to a client in the order they were encoded, without gaps. A client that has just
+  subscribed to an encoder (or fell behind by more than the number of retained messages) receives messages starting from a
+  key frame, which is requested from the encoder automatically.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport PlusIgtlVideoEncoderPool
+{
+public:
+  PlusIgtlVideoEncoderPool();
+  /*! Stops all the encoder threads */
+  ~PlusIgtlVideoEncoderPool();
+
+  /*! Get the identifier of the encoder that encodes the specified video stream for clients with the specified header version */
+  static std::string GetEncoderKey(const PlusIgtlClientInfo::VideoStream& videoStream, int headerVersion);
+
+  /*!
+    Submit a frame for encoding. Returns immediately, the frame is copied and encoded on the encoder's thread.
+    The frame is ignored if its timestamp is not newer than the timestamp of the previously submitted frame.
+    The client is subscribed to the encoder, so the encoder is stopped by RemoveClient even if the client never retrieved any messages.
+    \param encoderKey Encoder identifier returned by GetEncoderKey. The encoder is created if it does not exist yet.
+    \param clientId Client that the frame is submitted for
+    \param encodingParameters Encoding parameters of the stream (only used when the encoder is created)
+    \param messageTemplate Empty VIDEO message with the client's header version, it is cloned for each encoded frame
+    \param deviceName Device name of the VIDEO messages
+    \param trackedFrame Frame that contains the image to encode, its frame fields are sent as message meta data
+    \param imageToReferenceMatrix Image pose that is embedded in the VIDEO message
+  */
+  void SubmitFrame(const std::string& encoderKey, int clientId, const PlusIgtlClientInfo::EncodingParameters& encodingParameters, igtl::MessageBase::Pointer messageTemplate,
+                   const std::string& deviceName, igsioTrackedFrame& trackedFrame, vtkMatrix4x4& imageToReferenceMatrix);
+
+  /*!
+    Append the messages that the encoder produced since the last call for this client.
+    If the client is not subscribed to the encoder yet then it is subscribed and a key frame is requested.
+  */
+  void GetEncodedMessages(const std::string& encoderKey, int clientId, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
+
+  /*! Unsubscribe the client from all encoders. Encoders that have no more subscribers are stopped. */
+  void RemoveClient(int clientId);
+
+  /*! Get the number of running encoders */
+  int GetNumberOfEncoders() const;
+
+protected:
+  struct EncodedMessage
+  {
+    uint64_t SequenceNumber;
+    /*! True if decoding can start at this message (the encoder produced a key frame) */
+    bool DecodingStartPoint;
+    igtl::MessageBase::Pointer Message;
+  };
+
+  struct Subscriber
+  {
+    /*! Sequence number of the next message that the client needs */
+    uint64_t NextSequenceNumber;
+    /*! If true then messages are skipped until a decoding start point */
+    bool WaitingForDecodingStartPoint;
+  };
+
+  struct Encoder
+  {
+    std::string Key;
+    PlusIgtlClientInfo::EncodingParameters EncodingParameters;
+    igtl::MessageBase::Pointer MessageTemplate;
+
+    std::thread Thread;
+    std::mutex Mutex;
+    std::condition_variable Condition;
+    bool StopRequested;
+
+    /*! Most recent frame that is not encoded yet (NULL if there is no such frame) */
+    std::shared_ptr<igsioTrackedFrame> PendingFrame;
+    vtkSmartPointer<vtkMatrix4x4> PendingMatrix;
+    std::string PendingDeviceName;
+    double LastSubmittedTimestamp;
+    bool KeyFrameRequested;
+
+    std::deque<EncodedMessage> EncodedMessages;
+    uint64_t NextSequenceNumber;
+    std::map<int, Subscriber> Subscribers;
+  };
+
+  /*! Subscribe the client to the encoder if it is not subscribed yet. The encoder must be locked. */
+  static Subscriber& AddSubscriber(Encoder& encoder, int clientId);
+
+  /*! Encoder thread: waits for submitted frames, encodes and packs them */
+  static void EncoderThread(std::shared_ptr<Encoder> encoder);
+
+  /*! Stop the encoder thread and wait for it to finish */
+  static void StopEncoder(Encoder& encoder);
+
+  std::map<std::string, std::shared_ptr<Encoder> > Encoders;
+  mutable std::mutex Mutex;
+
+private:
+  PlusIgtlVideoEncoderPool(const PlusIgtlVideoEncoderPool&);
+  void operator=(const PlusIgtlVideoEncoderPool&);
+};
+
+#endif
+
+#endif //__PlusIgtlVideoEncoderPool_h
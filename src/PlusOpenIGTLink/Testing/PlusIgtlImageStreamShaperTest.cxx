@@ -0,0 +1,349 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusIgtlImageStreamShaperTest.cxx
+  \brief Test clipping, resizing, grayscale conversion and frame rate limiting of image streams
+
+  Checks the pixel values and size of the shaped images and the ShapedImageToImage transform. The input images have
+  non-unit spacing, because the transform is in pixels: the spacing must not change it.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlImageStreamShaper.h"
+#include "igsioTrackedFrame.h"
+#include "vtkImageData.h"
+#include "vtkMatrix4x4.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+  const int IMAGE_WIDTH = 64;
+  const int IMAGE_HEIGHT = 48;
+  const double IMAGE_SPACING_MM = 0.2;
+
+  //----------------------------------------------------------------------------
+  /*! Pixel value of the grayscale test image (linear gradient) */
+  double GetGradientValue(double x, double y)
+  {
+    return 2.0 * x + 2.0 * y;
+  }
+
+  //----------------------------------------------------------------------------
+  void CreateGrayscaleFrame(igsioTrackedFrame& trackedFrame, double timestamp)
+  {
+    FrameSizeType frameSize = { IMAGE_WIDTH, IMAGE_HEIGHT, 1 };
+    trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1);
+    trackedFrame.GetImageData()->SetImageType(US_IMG_BRIGHTNESS);
+    trackedFrame.GetImageData()->GetImage()->SetSpacing(IMAGE_SPACING_MM, IMAGE_SPACING_MM, 1.0);
+    unsigned char* pixels = static_cast<unsigned char*>(trackedFrame.GetImageData()->GetScalarPointer());
+    for (int y = 0; y < IMAGE_HEIGHT; ++y)
+    {
+      for (int x = 0; x < IMAGE_WIDTH; ++x)
+      {
+        pixels[y * IMAGE_WIDTH + x] = static_cast<unsigned char>(GetGradientValue(x, y));
+      }
+    }
+    trackedFrame.SetTimestamp(timestamp);
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckMatrix(vtkMatrix4x4* shapedImageToImageMatrix, double scaleX, double scaleY, double translationX, double translationY, const std::string& testName)
+  {
+    vtkSmartPointer<vtkMatrix4x4> expectedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    expectedMatrix->SetElement(0, 0, scaleX);
+    expectedMatrix->SetElement(1, 1, scaleY);
+    expectedMatrix->SetElement(0, 3, translationX);
+    expectedMatrix->SetElement(1, 3, translationY);
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        if (fabs(shapedImageToImageMatrix->GetElement(row, column) - expectedMatrix->GetElement(row, column)) > 1e-6)
+        {
+          LOG_ERROR(testName << ": ShapedImageToImage element (" << row << ", " << column << ") is " << shapedImageToImageMatrix->GetElement(row, column)
+                    << ", expected " << expectedMatrix->GetElement(row, column));
+          return 1;
+        }
+      }
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckFrameSize(igsioTrackedFrame* shapedFrame, unsigned int width, unsigned int height, unsigned int numberOfComponents, const std::string& testName)
+  {
+    if (shapedFrame == NULL)
+    {
+      LOG_ERROR(testName << ": no shaped frame is returned");
+      return 1;
+    }
+    FrameSizeType frameSize = shapedFrame->GetImageData()->GetFrameSize();
+    unsigned int shapedNumberOfComponents(0);
+    shapedFrame->GetImageData()->GetNumberOfScalarComponents(shapedNumberOfComponents);
+    if (frameSize[0] != width || frameSize[1] != height || shapedNumberOfComponents != numberOfComponents)
+    {
+      LOG_ERROR(testName << ": shaped image size is " << frameSize[0] << "x" << frameSize[1] << "x" << shapedNumberOfComponents
+                << ", expected " << width << "x" << height << "x" << numberOfComponents);
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestClip()
+  {
+    PlusIgtlImageStreamShaper shaper;
+    PlusIgtlClientInfo::ShapingParameters parameters;
+    parameters.ClipRectangleOrigin[0] = 10;
+    parameters.ClipRectangleOrigin[1] = 8;
+    parameters.ClipRectangleSize[0] = 20;
+    parameters.ClipRectangleSize[1] = 16;
+
+    igsioTrackedFrame trackedFrame;
+    CreateGrayscaleFrame(trackedFrame, 1.0);
+    igsioTrackedFrame* shapedFrame = NULL;
+    vtkSmartPointer<vtkMatrix4x4> shapedImageToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (shaper.GetShapedFrame(parameters, trackedFrame, shapedFrame, shapedImageToImageMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Clip: failed to shape frame");
+      return 1;
+    }
+    if (CheckFrameSize(shapedFrame, 20, 16, 1, "Clip") != 0)
+    {
+      return 1;
+    }
+    // The translation is the clip origin in pixels, independently from the spacing
+    int numberOfErrors = CheckMatrix(shapedImageToImageMatrix, 1.0, 1.0, 10.0, 8.0, "Clip");
+
+    const unsigned char* pixels = static_cast<const unsigned char*>(shapedFrame->GetImageData()->GetScalarPointer());
+    for (int y = 0; y < 16; ++y)
+    {
+      for (int x = 0; x < 20; ++x)
+      {
+        int expectedValue = static_cast<int>(GetGradientValue(x + 10, y + 8));
+        if (pixels[y * 20 + x] != expectedValue)
+        {
+          LOG_ERROR("Clip: pixel (" << x << ", " << y << ") is " << static_cast<int>(pixels[y * 20 + x]) << ", expected " << expectedValue);
+          return numberOfErrors + 1;
+        }
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestResize()
+  {
+    PlusIgtlImageStreamShaper shaper;
+    PlusIgtlClientInfo::ShapingParameters parameters;
+    // Only the width is specified, the height is computed from the aspect ratio
+    parameters.TargetSize[0] = IMAGE_WIDTH / 2;
+
+    igsioTrackedFrame trackedFrame;
+    CreateGrayscaleFrame(trackedFrame, 1.0);
+    igsioTrackedFrame* shapedFrame = NULL;
+    vtkSmartPointer<vtkMatrix4x4> shapedImageToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (shaper.GetShapedFrame(parameters, trackedFrame, shapedFrame, shapedImageToImageMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Resize: failed to shape frame");
+      return 1;
+    }
+    if (CheckFrameSize(shapedFrame, IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2, 1, "Resize") != 0)
+    {
+      return 1;
+    }
+    // Pixel centers: shaped pixel i covers input pixels 2i and 2i+1, so its center is at 2i+0.5
+    int numberOfErrors = CheckMatrix(shapedImageToImageMatrix, 2.0, 2.0, 0.5, 0.5, "Resize");
+
+    // The gradient is linear, so the interpolated value at the pixel center mapped by ShapedImageToImage is known
+    // (pixels next to the border are not checked, as they are affected by the interpolation kernel)
+    const unsigned char* pixels = static_cast<const unsigned char*>(shapedFrame->GetImageData()->GetScalarPointer());
+    const int border = 3;
+    for (int y = border; y < IMAGE_HEIGHT / 2 - border; ++y)
+    {
+      for (int x = border; x < IMAGE_WIDTH / 2 - border; ++x)
+      {
+        double shapedPixel[4] = { static_cast<double>(x), static_cast<double>(y), 0, 1 };
+        double inputPixel[4] = { 0, 0, 0, 1 };
+        shapedImageToImageMatrix->MultiplyPoint(shapedPixel, inputPixel);
+        double expectedValue = GetGradientValue(inputPixel[0], inputPixel[1]);
+        if (fabs(pixels[y * (IMAGE_WIDTH / 2) + x] - expectedValue) > 1.0)
+        {
+          LOG_ERROR("Resize: pixel (" << x << ", " << y << ") is " << static_cast<int>(pixels[y * (IMAGE_WIDTH / 2) + x]) << ", expected " << expectedValue);
+          return numberOfErrors + 1;
+        }
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestGrayscale()
+  {
+    int numberOfErrors(0);
+    PlusIgtlImageStreamShaper shaper;
+    PlusIgtlClientInfo::ShapingParameters parameters;
+    parameters.Grayscale = true;
+
+    // Each row has a different color
+    const unsigned char colors[4][3] = { { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 }, { 200, 100, 50 } };
+    igsioTrackedFrame trackedFrame;
+    FrameSizeType frameSize = { 8, 4, 1 };
+    trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 3);
+    trackedFrame.GetImageData()->SetImageType(US_IMG_RGB_COLOR);
+    unsigned char* pixels = static_cast<unsigned char*>(trackedFrame.GetImageData()->GetScalarPointer());
+    for (unsigned int y = 0; y < frameSize[1]; ++y)
+    {
+      for (unsigned int x = 0; x < frameSize[0]; ++x)
+      {
+        for (int component = 0; component < 3; ++component)
+        {
+          pixels[(y * frameSize[0] + x) * 3 + component] = colors[y][component];
+        }
+      }
+    }
+    trackedFrame.SetTimestamp(1.0);
+
+    igsioTrackedFrame* shapedFrame = NULL;
+    vtkSmartPointer<vtkMatrix4x4> shapedImageToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (shaper.GetShapedFrame(parameters, trackedFrame, shapedFrame, shapedImageToImageMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Grayscale: failed to shape frame");
+      return 1;
+    }
+    if (CheckFrameSize(shapedFrame, frameSize[0], frameSize[1], 1, "Grayscale") != 0)
+    {
+      return 1;
+    }
+    if (shapedFrame->GetImageData()->GetImageType() != US_IMG_BRIGHTNESS)
+    {
+      LOG_ERROR("Grayscale: shaped image type is not brightness");
+      numberOfErrors++;
+    }
+    numberOfErrors += CheckMatrix(shapedImageToImageMatrix, 1.0, 1.0, 0.0, 0.0, "Grayscale");
+
+    // ITU-R BT.601 luma
+    const unsigned char* shapedPixels = static_cast<const unsigned char*>(shapedFrame->GetImageData()->GetScalarPointer());
+    for (unsigned int y = 0; y < frameSize[1]; ++y)
+    {
+      double expectedValue = 0.299 * colors[y][0] + 0.587 * colors[y][1] + 0.114 * colors[y][2];
+      if (fabs(shapedPixels[y * frameSize[0]] - expectedValue) > 1.0)
+      {
+        LOG_ERROR("Grayscale: value of color (" << static_cast<int>(colors[y][0]) << ", " << static_cast<int>(colors[y][1]) << ", " << static_cast<int>(colors[y][2])
+                  << ") is " << static_cast<int>(shapedPixels[y * frameSize[0]]) << ", expected " << expectedValue);
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestFrameRateLimit()
+  {
+    int numberOfErrors(0);
+    PlusIgtlImageStreamShaper shaper;
+    PlusIgtlClientInfo::ShapingParameters parameters;
+    parameters.MaxFrameRate = 10.0;
+
+    // 40 fps input for 2 seconds
+    const double inputPeriodSec = 0.025;
+    const int numberOfInputFrames = 80;
+    int numberOfOutputFrames(0);
+    double lastOutputTimestamp(UNDEFINED_TIMESTAMP);
+    for (int frameIndex = 0; frameIndex < numberOfInputFrames; ++frameIndex)
+    {
+      igsioTrackedFrame trackedFrame;
+      CreateGrayscaleFrame(trackedFrame, 10.0 + frameIndex * inputPeriodSec);
+
+      // The same frame is shaped for two clients, they must get the same result
+      igsioTrackedFrame* shapedFrame = NULL;
+      igsioTrackedFrame* shapedFrameSecondClient = NULL;
+      if (shaper.GetShapedFrame(parameters, trackedFrame, shapedFrame, NULL) != PLUS_SUCCESS
+          || shaper.GetShapedFrame(parameters, trackedFrame, shapedFrameSecondClient, NULL) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Frame rate limit: failed to shape frame");
+        return numberOfErrors + 1;
+      }
+      if (shapedFrame != shapedFrameSecondClient)
+      {
+        LOG_ERROR("Frame rate limit: clients with the same parameters got different frames at timestamp " << trackedFrame.GetTimestamp());
+        numberOfErrors++;
+      }
+      if (shapedFrame == NULL)
+      {
+        continue;
+      }
+      if (shapedFrame != &trackedFrame)
+      {
+        LOG_ERROR("Frame rate limit: the image is copied although it is not modified");
+        numberOfErrors++;
+      }
+      if (lastOutputTimestamp != UNDEFINED_TIMESTAMP && trackedFrame.GetTimestamp() - lastOutputTimestamp < 1.0 / parameters.MaxFrameRate - 0.002)
+      {
+        LOG_ERROR("Frame rate limit: frames are sent at " << lastOutputTimestamp << " and " << trackedFrame.GetTimestamp() << ", closer than the minimum period");
+        numberOfErrors++;
+      }
+      lastOutputTimestamp = trackedFrame.GetTimestamp();
+      numberOfOutputFrames++;
+    }
+
+    int expectedNumberOfOutputFrames = static_cast<int>(numberOfInputFrames * inputPeriodSec * parameters.MaxFrameRate);
+    if (abs(numberOfOutputFrames - expectedNumberOfOutputFrames) > 1)
+    {
+      LOG_ERROR("Frame rate limit: " << numberOfOutputFrames << " frames are sent, expected " << expectedNumberOfOutputFrames);
+      numberOfErrors++;
+    }
+    if (shaper.GetNumberOfShapes() != 1)
+    {
+      LOG_ERROR("Frame rate limit: number of shapes is " << shaper.GetNumberOfShapes() << ", expected 1");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  numberOfErrors += TestClip();
+  numberOfErrors += TestResize();
+  numberOfErrors += TestGrayscale();
+  numberOfErrors += TestFrameRateLimit();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
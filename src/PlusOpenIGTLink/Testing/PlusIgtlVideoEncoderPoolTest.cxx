@@ -0,0 +1,253 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusIgtlVideoEncoderPoolTest.cxx
+  \brief Test sharing, key frame handling and cleanup of the video encoder pool
+
+  Checks that clients that request the same stream share one encoder and receive the same messages, that every client
+  (including one that subscribes later) starts receiving from an actual key frame, and that encoders are stopped when
+  their clients are removed, also if a client is removed before it retrieved any encoded messages.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlVideoEncoderPool.h"
+#include "vtkMatrix4x4.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+
+#include "igsioTrackedFrame.h"
+#include "igtlCodecCommonClasses.h"
+#include "igtlVideoMessage.h"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+  const double ENCODING_TIMEOUT_SEC = 10.0;
+
+  //----------------------------------------------------------------------------
+  void CreateTestFrame(igsioTrackedFrame& trackedFrame, double timestamp)
+  {
+    FrameSizeType frameSize = { 64, 48, 1 };
+    trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1);
+    unsigned char* pixels = static_cast<unsigned char*>(trackedFrame.GetImageData()->GetScalarPointer());
+    // Moving gradient, so consecutive frames differ
+    int offset = static_cast<int>(timestamp * 10);
+    for (unsigned int y = 0; y < frameSize[1]; ++y)
+    {
+      for (unsigned int x = 0; x < frameSize[0]; ++x)
+      {
+        pixels[y * frameSize[0] + x] = static_cast<unsigned char>((x + y + offset) * 4);
+      }
+    }
+    trackedFrame.SetTimestamp(timestamp);
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsKeyFrame(igtl::MessageBase* message)
+  {
+    igtl::VideoMessage* videoMessage = dynamic_cast<igtl::VideoMessage*>(message);
+    if (videoMessage == NULL)
+    {
+      return false;
+    }
+    // The key frame flag is in the low byte for color frames and in the high byte for grayscale frames
+    int frameType = videoMessage->GetFrameType();
+    return ((frameType & 0xFF) == FrameTypeKey) || ((frameType >> 8) == FrameTypeKey);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Retrieve encoded messages until the client has at least the requested number of messages or the timeout is reached */
+  void WaitForMessages(PlusIgtlVideoEncoderPool& pool, const std::string& encoderKey, int clientId, std::vector<igtl::MessageBase::Pointer>& messages, size_t minimumNumberOfMessages)
+  {
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    while (true)
+    {
+      pool.GetEncodedMessages(encoderKey, clientId, messages);
+      if (messages.size() >= minimumNumberOfMessages
+          || std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() > ENCODING_TIMEOUT_SEC)
+      {
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Submit frames for all the clients and retrieve the encoded messages after each frame */
+  void StreamFrames(PlusIgtlVideoEncoderPool& pool, const std::string& encoderKey, const PlusIgtlClientInfo::EncodingParameters& encodingParameters,
+                    const std::vector<int>& clientIds, std::map<int, std::vector<igtl::MessageBase::Pointer> >& clientMessages, double& timestamp, int numberOfFrames)
+  {
+    vtkSmartPointer<vtkMatrix4x4> imageToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+    {
+      timestamp += 0.1;
+      igsioTrackedFrame trackedFrame;
+      CreateTestFrame(trackedFrame, timestamp);
+      for (std::vector<int>::const_iterator clientIt = clientIds.begin(); clientIt != clientIds.end(); ++clientIt)
+      {
+        igtl::VideoMessage::Pointer messageTemplate = igtl::VideoMessage::New();
+        messageTemplate->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+        // Every client submits the same frame, it must be encoded only once
+        pool.SubmitFrame(encoderKey, *clientIt, encodingParameters, messageTemplate.GetPointer(), "TestImage", trackedFrame, *imageToReferenceMatrix);
+        pool.GetEncodedMessages(encoderKey, *clientIt, clientMessages[*clientIt]);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckStartsWithKeyFrame(const std::vector<igtl::MessageBase::Pointer>& messages, int clientId)
+  {
+    if (messages.empty())
+    {
+      LOG_ERROR("Client " << clientId << " did not receive any encoded messages");
+      return 1;
+    }
+    if (!IsKeyFrame(messages.front()))
+    {
+      LOG_ERROR("The first message that client " << clientId << " received is not a key frame");
+      return 1;
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int TestVideoEncoderPool()
+{
+  int numberOfErrors(0);
+  PlusIgtlVideoEncoderPool pool;
+
+  PlusIgtlClientInfo::VideoStream videoStream;
+  videoStream.Name = "Video";
+  videoStream.EmbeddedTransformToFrame = "Reference";
+  std::string encoderKey = PlusIgtlVideoEncoderPool::GetEncoderKey(videoStream, IGTL_HEADER_VERSION_2);
+  double timestamp(0.0);
+
+  // Two clients that request the same stream share the encoder and the encoded messages
+  std::map<int, std::vector<igtl::MessageBase::Pointer> > clientMessages;
+  std::vector<int> clientIds;
+  clientIds.push_back(1);
+  clientIds.push_back(2);
+  StreamFrames(pool, encoderKey, videoStream.EncodeVideoParameters, clientIds, clientMessages, timestamp, 10);
+  WaitForMessages(pool, encoderKey, 1, clientMessages[1], 5);
+  WaitForMessages(pool, encoderKey, 2, clientMessages[2], clientMessages[1].size());
+  if (pool.GetNumberOfEncoders() != 1)
+  {
+    LOG_ERROR("Number of encoders is " << pool.GetNumberOfEncoders() << " for two clients that request the same stream, expected 1");
+    numberOfErrors++;
+  }
+  numberOfErrors += CheckStartsWithKeyFrame(clientMessages[1], 1);
+  numberOfErrors += CheckStartsWithKeyFrame(clientMessages[2], 2);
+  if (clientMessages[1].size() != clientMessages[2].size()
+      || (!clientMessages[1].empty() && clientMessages[1].back().GetPointer() != clientMessages[2].back().GetPointer()))
+  {
+    LOG_ERROR("Clients of the same encoder received different messages (" << clientMessages[1].size() << " and " << clientMessages[2].size() << " messages)");
+    numberOfErrors++;
+  }
+
+  // A client that subscribes later starts from a key frame that the encoder actually produced
+  clientIds.push_back(3);
+  size_t numberOfMessagesBeforeLateClient = clientMessages[1].size();
+  StreamFrames(pool, encoderKey, videoStream.EncodeVideoParameters, clientIds, clientMessages, timestamp, 10);
+  WaitForMessages(pool, encoderKey, 3, clientMessages[3], 1);
+  numberOfErrors += CheckStartsWithKeyFrame(clientMessages[3], 3);
+  if (clientMessages[1].size() <= numberOfMessagesBeforeLateClient)
+  {
+    LOG_ERROR("Client 1 did not receive any messages after client 3 subscribed");
+    numberOfErrors++;
+  }
+
+  // A different stream gets its own encoder
+  PlusIgtlClientInfo::VideoStream losslessVideoStream = videoStream;
+  losslessVideoStream.EncodeVideoParameters.Lossless = true;
+  std::string losslessEncoderKey = PlusIgtlVideoEncoderPool::GetEncoderKey(losslessVideoStream, IGTL_HEADER_VERSION_2);
+  std::map<int, std::vector<igtl::MessageBase::Pointer> > losslessClientMessages;
+  StreamFrames(pool, losslessEncoderKey, losslessVideoStream.EncodeVideoParameters, std::vector<int>(1, 4), losslessClientMessages, timestamp, 1);
+  if (pool.GetNumberOfEncoders() != 2)
+  {
+    LOG_ERROR("Number of encoders is " << pool.GetNumberOfEncoders() << " for two different streams, expected 2");
+    numberOfErrors++;
+  }
+
+  // Encoders are stopped when their last client is removed
+  pool.RemoveClient(1);
+  pool.RemoveClient(2);
+  if (pool.GetNumberOfEncoders() != 2)
+  {
+    LOG_ERROR("Number of encoders is " << pool.GetNumberOfEncoders() << " after removing 2 of the 3 clients of an encoder, expected 2");
+    numberOfErrors++;
+  }
+  pool.RemoveClient(3);
+  pool.RemoveClient(4);
+  if (pool.GetNumberOfEncoders() != 0)
+  {
+    LOG_ERROR("Number of encoders is " << pool.GetNumberOfEncoders() << " after removing all clients, expected 0");
+    numberOfErrors++;
+  }
+
+  // A client that disconnects after submitting a frame but before retrieving messages does not leave its encoder running
+  {
+    igsioTrackedFrame trackedFrame;
+    CreateTestFrame(trackedFrame, timestamp + 0.1);
+    vtkSmartPointer<vtkMatrix4x4> imageToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    igtl::VideoMessage::Pointer messageTemplate = igtl::VideoMessage::New();
+    messageTemplate->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+    pool.SubmitFrame(encoderKey, 5, videoStream.EncodeVideoParameters, messageTemplate.GetPointer(), "TestImage", trackedFrame, *imageToReferenceMatrix);
+    pool.RemoveClient(5);
+    if (pool.GetNumberOfEncoders() != 0)
+    {
+      LOG_ERROR("Encoder of a client that was removed before retrieving messages is still running");
+      numberOfErrors++;
+    }
+  }
+
+  return numberOfErrors;
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+  int numberOfErrors = TestVideoEncoderPool();
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+#else
+  LOG_INFO("OpenIGTLink video streaming is not enabled, test skipped");
+#endif
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,259 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusTrackedFrameMessageTest.cxx
+  \brief Test packing, unpacking and cloning of TRACKEDFRAME messages
+
+  Checks that the XML frame data layout is used by default, that the binary layout is only used if it is enabled
+  and that both layouts are unpacked to the same tracked frame. Also checks that a cloned message keeps referring
+  to the image data if image data gather is enabled.
+*/
+
+#include "PlusConfigure.h"
+#include "igtlMessageHeader.h"
+#include "igtlPlusTrackedFrameMessage.h"
+#include "vtkPlusIgtlMessageCommon.h"
+#include "vtkPlusIgtlMessageFactory.h"
+#include "vtkImageData.h"
+#include "vtkMatrix4x4.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+  const char BINARY_FRAME_DATA_SIGNATURE[] = "PTFB";
+
+  //----------------------------------------------------------------------------
+  void CreateTestFrame(igsioTrackedFrame& trackedFrame, const igsioTransformName& transformName)
+  {
+    FrameSizeType frameSize = { 16, 8, 1 };
+    trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1);
+    unsigned char* pixels = static_cast<unsigned char*>(trackedFrame.GetImageData()->GetScalarPointer());
+    for (unsigned int i = 0; i < frameSize[0] * frameSize[1]; ++i)
+    {
+      pixels[i] = static_cast<unsigned char>(i % 251);
+    }
+    trackedFrame.SetTimestamp(12.5);
+    trackedFrame.SetFrameField("TestField", "TestValue");
+
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    matrix->SetElement(0, 3, 10.0);
+    matrix->SetElement(1, 3, 20.0);
+    matrix->SetElement(2, 3, 30.0);
+    trackedFrame.SetFrameTransform(transformName, matrix);
+    trackedFrame.SetFrameTransformStatus(transformName, TOOL_OK);
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetSentData(igtl::PlusTrackedFrameMessage* message)
+  {
+    std::vector<std::pair<const unsigned char*, size_t> > segments;
+    message->GetSendSegments(segments);
+    std::string data;
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+      data.append(reinterpret_cast<const char*>(segments[i].first), segments[i].second);
+    }
+    return data;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ReceiveTrackedFrame(const std::string& data, igsioTrackedFrame& trackedFrame)
+  {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitBuffer();
+    if (data.size() < static_cast<size_t>(headerMsg->GetBufferSize()))
+    {
+      LOG_ERROR("Sent data is shorter than the message header");
+      return PLUS_FAIL;
+    }
+    memcpy(headerMsg->GetBufferPointer(), data.data(), headerMsg->GetBufferSize());
+    headerMsg->Unpack();
+
+    igtl::PlusTrackedFrameMessage::Pointer trackedFrameMsg = igtl::PlusTrackedFrameMessage::New();
+    trackedFrameMsg->SetMessageHeader(headerMsg);
+    trackedFrameMsg->AllocateBuffer();
+    if (data.size() != static_cast<size_t>(headerMsg->GetBufferSize() + trackedFrameMsg->GetBufferBodySize()))
+    {
+      LOG_ERROR("Sent data size (" << data.size() << ") does not match the message size in the header ("
+                << headerMsg->GetBufferSize() + trackedFrameMsg->GetBufferBodySize() << ")");
+      return PLUS_FAIL;
+    }
+    memcpy(trackedFrameMsg->GetBufferBodyPointer(), data.data() + headerMsg->GetBufferSize(), trackedFrameMsg->GetBufferBodySize());
+
+    // Check CRC as well, it must cover the image data that is not in the message buffer
+    int c = trackedFrameMsg->Unpack(1);
+    if (!(c & igtl::MessageHeader::UNPACK_BODY))
+    {
+      LOG_ERROR("Failed to unpack tracked frame message");
+      return PLUS_FAIL;
+    }
+    trackedFrame = trackedFrameMsg->GetTrackedFrame();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareTrackedFrames(igsioTrackedFrame& expected, igsioTrackedFrame& actual, const igsioTransformName& transformName)
+  {
+    int numberOfErrors(0);
+    if (actual.GetFrameField("TestField") != expected.GetFrameField("TestField"))
+    {
+      LOG_ERROR("Frame field mismatch: " << actual.GetFrameField("TestField") << " (expected " << expected.GetFrameField("TestField") << ")");
+      numberOfErrors++;
+    }
+
+    vtkSmartPointer<vtkMatrix4x4> expectedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    vtkSmartPointer<vtkMatrix4x4> actualMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    expected.GetFrameTransform(transformName, expectedMatrix);
+    if (actual.GetFrameTransform(transformName, actualMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Transform " << transformName.GetTransformName() << " is missing from the received frame");
+      numberOfErrors++;
+    }
+    else
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        for (int j = 0; j < 4; ++j)
+        {
+          if (fabs(actualMatrix->GetElement(i, j) - expectedMatrix->GetElement(i, j)) > 1e-6)
+          {
+            LOG_ERROR("Transform " << transformName.GetTransformName() << " mismatch in element (" << i << ", " << j << ")");
+            numberOfErrors++;
+          }
+        }
+      }
+    }
+
+    igsioVideoFrame* expectedImage = expected.GetImageData();
+    igsioVideoFrame* actualImage = actual.GetImageData();
+    if (actualImage->GetFrameSizeInBytes() != expectedImage->GetFrameSizeInBytes()
+        || memcmp(actualImage->GetScalarPointer(), expectedImage->GetScalarPointer(), expectedImage->GetFrameSizeInBytes()) != 0)
+    {
+      LOG_ERROR("Image data mismatch");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestRoundTrip(vtkPlusIgtlMessageFactory* factory, igsioTrackedFrame& trackedFrame, const igsioTransformName& transformName, bool binaryFrameData, bool imageDataGather)
+  {
+    LOG_INFO("Testing round trip (binary frame data: " << (binaryFrameData ? "TRUE" : "FALSE") << ", image data gather: " << (imageDataGather ? "TRUE" : "FALSE") << ")");
+    int numberOfErrors(0);
+
+    igtl::PlusTrackedFrameMessage::Pointer message = dynamic_cast<igtl::PlusTrackedFrameMessage*>(factory->CreateSendMessage("TRACKEDFRAME", IGTL_HEADER_VERSION_2).GetPointer());
+    if (binaryFrameData)
+    {
+      message->SetBinaryFrameDataEnabled(true);
+    }
+    message->SetImageDataGatherEnabled(imageDataGather);
+    std::vector<igsioTransformName> requestedTransforms;
+    requestedTransforms.push_back(transformName);
+    vtkSmartPointer<vtkMatrix4x4> imageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (vtkPlusIgtlMessageCommon::PackTrackedFrameMessage(message, trackedFrame, imageMatrix, requestedTransforms) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to pack tracked frame message");
+      return 1;
+    }
+
+    std::string data = GetSentData(message);
+    bool binaryFrameDataSent = (data.find(BINARY_FRAME_DATA_SIGNATURE) != std::string::npos);
+    if (binaryFrameDataSent != binaryFrameData)
+    {
+      LOG_ERROR("Frame data is sent in " << (binaryFrameDataSent ? "binary" : "XML") << " layout, expected " << (binaryFrameData ? "binary" : "XML"));
+      numberOfErrors++;
+    }
+
+    igsioTrackedFrame receivedFrame;
+    if (ReceiveTrackedFrame(data, receivedFrame) != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    numberOfErrors += CompareTrackedFrames(trackedFrame, receivedFrame, transformName);
+
+    // The clone of a packed message has to be sent in exactly the same way as the original
+    igtl::PlusTrackedFrameMessage::Pointer clone = dynamic_cast<igtl::PlusTrackedFrameMessage*>(message->Clone().GetPointer());
+    if (clone->GetBinaryFrameDataEnabled() != message->GetBinaryFrameDataEnabled()
+        || clone->GetImageDataGatherEnabled() != message->GetImageDataGatherEnabled())
+    {
+      LOG_ERROR("Cloned message settings do not match the original message");
+      numberOfErrors++;
+    }
+    std::vector<std::pair<const unsigned char*, size_t> > segments;
+    message->GetSendSegments(segments);
+    std::vector<std::pair<const unsigned char*, size_t> > cloneSegments;
+    clone->GetSendSegments(cloneSegments);
+    if (cloneSegments.size() != segments.size())
+    {
+      LOG_ERROR("Cloned message is sent in " << cloneSegments.size() << " segments, expected " << segments.size());
+      numberOfErrors++;
+    }
+    else
+    {
+      if (imageDataGather && (segments.size() < 2 || cloneSegments[1] != segments[1]))
+      {
+        LOG_ERROR("Cloned message does not refer to the image data of the original message");
+        numberOfErrors++;
+      }
+      // The header contains the body size and CRC that include the gathered image data
+      if (cloneSegments[0].second < IGTL_HEADER_SIZE || memcmp(cloneSegments[0].first, segments[0].first, IGTL_HEADER_SIZE) != 0)
+      {
+        LOG_ERROR("Cloned message header does not match the original message header");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  igsioTransformName transformName("Probe", "Tracker");
+  igsioTrackedFrame trackedFrame;
+  CreateTestFrame(trackedFrame, transformName);
+
+  vtkSmartPointer<vtkPlusIgtlMessageFactory> factory = vtkSmartPointer<vtkPlusIgtlMessageFactory>::New();
+
+  int numberOfErrors(0);
+  numberOfErrors += TestRoundTrip(factory, trackedFrame, transformName, false, false);
+  numberOfErrors += TestRoundTrip(factory, trackedFrame, transformName, false, true);
+  numberOfErrors += TestRoundTrip(factory, trackedFrame, transformName, true, false);
+  numberOfErrors += TestRoundTrip(factory, trackedFrame, transformName, true, true);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
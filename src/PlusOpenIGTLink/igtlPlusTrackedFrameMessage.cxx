@@ -5,16 +5,183 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusIgtlSharedMemoryRing.h"
 #include "igtlPlusTrackedFrameMessage.h"
 #include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
 #include "vtkPlusIgtlMessageFactory.h"
+#include "vtkPoints.h"
+
+// STL includes
+#include <map>
+
+namespace
+{
+  const char TRACKEDFRAME_BINARY_SIGNATURE[4] = { 'P', 'T', 'F', 'B' };
+  const igtl_uint16 TRACKEDFRAME_BINARY_LAYOUT_VERSION = 1;
+  // Layout version of frame data that refers to image data in shared memory (older receivers reject it instead of reading a truncated image)
+  const igtl_uint16 TRACKEDFRAME_BINARY_LAYOUT_VERSION_SHARED_MEMORY = 2;
+  const igtl_uint16 TRACKEDFRAME_BINARY_FLAG_SHARED_MEMORY_IMAGE = 0x0001;
+  // signature, layout version, flags, number of strings, transforms, fields, fiducial points
+  const size_t TRACKEDFRAME_BINARY_HEADER_SIZE = 4 + 2 + 2 + 4 * 4;
+
+  //----------------------------------------------------------------------------
+  // Writers and readers of big endian values. Readers return false if the data is truncated.
+
+  void AppendUInt16(std::string& data, igtl_uint16 value)
+  {
+    data.push_back(static_cast<char>((value >> 8) & 0xFF));
+    data.push_back(static_cast<char>(value & 0xFF));
+  }
+
+  void AppendUInt32(std::string& data, igtl_uint32 value)
+  {
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+      data.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+  }
+
+  void AppendUInt64(std::string& data, igtl_uint64 value)
+  {
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+      data.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+  }
+
+  void AppendFloat64(std::string& data, double value)
+  {
+    igtl_uint64 bits(0);
+    memcpy(&bits, &value, sizeof(bits));
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+      data.push_back(static_cast<char>((bits >> shift) & 0xFF));
+    }
+  }
+
+  class BinaryReader
+  {
+  public:
+    BinaryReader(const unsigned char* data, size_t size) : Data(data), End(data + size) {}
+
+    bool ReadUInt16(igtl_uint16& value)
+    {
+      if (this->End - this->Data < 2)
+      {
+        return false;
+      }
+      value = static_cast<igtl_uint16>((this->Data[0] << 8) | this->Data[1]);
+      this->Data += 2;
+      return true;
+    }
+
+    bool ReadUInt32(igtl_uint32& value)
+    {
+      if (this->End - this->Data < 4)
+      {
+        return false;
+      }
+      value = 0;
+      for (int i = 0; i < 4; ++i)
+      {
+        value = (value << 8) | this->Data[i];
+      }
+      this->Data += 4;
+      return true;
+    }
+
+    bool ReadUInt64(igtl_uint64& value)
+    {
+      if (this->End - this->Data < 8)
+      {
+        return false;
+      }
+      value = 0;
+      for (int i = 0; i < 8; ++i)
+      {
+        value = (value << 8) | this->Data[i];
+      }
+      this->Data += 8;
+      return true;
+    }
+
+    bool ReadFloat64(double& value)
+    {
+      if (this->End - this->Data < 8)
+      {
+        return false;
+      }
+      igtl_uint64 bits(0);
+      for (int i = 0; i < 8; ++i)
+      {
+        bits = (bits << 8) | this->Data[i];
+      }
+      memcpy(&value, &bits, sizeof(value));
+      this->Data += 8;
+      return true;
+    }
+
+    bool ReadString(std::string& value, size_t length)
+    {
+      if (static_cast<size_t>(this->End - this->Data) < length)
+      {
+        return false;
+      }
+      value.assign(reinterpret_cast<const char*>(this->Data), length);
+      this->Data += length;
+      return true;
+    }
+
+    bool Skip(size_t length)
+    {
+      if (static_cast<size_t>(this->End - this->Data) < length)
+      {
+        return false;
+      }
+      this->Data += length;
+      return true;
+    }
+
+  protected:
+    const unsigned char* Data;
+    const unsigned char* End;
+  };
+
+  //----------------------------------------------------------------------------
+  class StringTable
+  {
+  public:
+    igtl_uint32 GetIndex(const std::string& str)
+    {
+      std::map<std::string, igtl_uint32>::iterator it = this->Indices.find(str);
+      if (it != this->Indices.end())
+      {
+        return it->second;
+      }
+      igtl_uint32 index = static_cast<igtl_uint32>(this->Strings.size());
+      this->Indices[str] = index;
+      this->Strings.push_back(str);
+      return index;
+    }
+
+    std::vector<std::string> Strings;
+
+  protected:
+    std::map<std::string, igtl_uint32> Indices;
+  };
+}
 
 namespace igtl
 {
   //----------------------------------------------------------------------------
   PlusTrackedFrameMessage::PlusTrackedFrameMessage()
     : MessageBase()
+    , m_FrameTimestamp(0.0)
+    , m_BinaryFrameDataEnabled(false)
+    , m_ImageDataGatherEnabled(false)
+    , m_SharedMemoryImageReference(false)
+    , m_SharedMemorySequenceNumber(0)
   {
     this->m_SendMessageType = "TRACKEDFRAME";
   }
@@ -44,21 +211,46 @@ namespace igtl
       msg->CopyBody(this);
     }
 
+    // The image is not in the message buffer if image data gather is enabled, so the clone has to refer to it as well
+    msg->m_TrackedFrame = this->m_TrackedFrame;
+    msg->m_TrackedFrameData = this->m_TrackedFrameData;
+    msg->m_ImageData = this->m_ImageData;
+    msg->m_FrameTimestamp = this->m_FrameTimestamp;
+    msg->m_BinaryFrameDataEnabled = this->m_BinaryFrameDataEnabled;
+    msg->m_ImageDataGatherEnabled = this->m_ImageDataGatherEnabled;
+    msg->m_SharedMemoryImageReference = this->m_SharedMemoryImageReference;
+    msg->m_SharedMemoryRingName = this->m_SharedMemoryRingName;
+    msg->m_SharedMemorySequenceNumber = this->m_SharedMemorySequenceNumber;
+    msg->m_MessageHeader = this->m_MessageHeader;
+
     return clone;
   }
 
   //----------------------------------------------------------------------------
   PlusStatus PlusTrackedFrameMessage::SetTrackedFrame(const igsioTrackedFrame& trackedFrame, const std::vector<igsioTransformName>& requestedTransforms)
   {
-    this->m_TrackedFrame = trackedFrame;
-
-    if (this->m_TrackedFrame.GetTrackedFrameInXmlData(this->m_TrackedFrameXmlData, requestedTransforms) != PLUS_SUCCESS)
+    // The whole frame is not copied: frame data is serialized right away and the image is only referenced.
+    // igsioTrackedFrame accessors are not const-qualified, but the frame is not modified here.
+    igsioTrackedFrame& frame = const_cast<igsioTrackedFrame&>(trackedFrame);
+    if (this->m_BinaryFrameDataEnabled)
     {
-      LOG_ERROR("Failed to pack Plus TrackedFrame message - unable to get tracked frame in xml data.");
-      return PLUS_FAIL;
+      if (this->PackBinaryFrameData(frame, requestedTransforms) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to pack Plus TrackedFrame message - unable to get tracked frame in binary data.");
+        return PLUS_FAIL;
+      }
+    }
+    else
+    {
+      if (frame.GetTrackedFrameInXmlData(this->m_TrackedFrameData, requestedTransforms) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to pack Plus TrackedFrame message - unable to get tracked frame in xml data.");
+        return PLUS_FAIL;
+      }
     }
 
-    FrameSizeType frameSize = this->m_TrackedFrame.GetFrameSize();
+    igsioVideoFrame* videoFrame = frame.GetImageData();
+    FrameSizeType frameSize = videoFrame->GetFrameSize();
     if (frameSize[0] > static_cast<unsigned int>(std::numeric_limits<igtl_uint16>::max()) ||
         frameSize[1] > static_cast<unsigned int>(std::numeric_limits<igtl_uint16>::max()) ||
         frameSize[2] > static_cast<unsigned int>(std::numeric_limits<igtl_uint16>::max()))
@@ -70,23 +262,40 @@ namespace igtl
     this->m_MessageHeader.m_FrameSize[0] = frameSize[0];
     this->m_MessageHeader.m_FrameSize[1] = frameSize[1];
     this->m_MessageHeader.m_FrameSize[2] = frameSize[2];
-    this->m_MessageHeader.m_XmlDataSizeInBytes = this->m_TrackedFrameXmlData.size();
-    this->m_MessageHeader.m_ScalarType = PlusCommon::GetIGTLScalarPixelTypeFromVTK(this->m_TrackedFrame.GetImageData()->GetVTKScalarPixelType());
+    this->m_MessageHeader.m_FrameDataSizeInBytes = this->m_TrackedFrameData.size();
+    this->m_MessageHeader.m_ScalarType = PlusCommon::GetIGTLScalarPixelTypeFromVTK(videoFrame->GetVTKScalarPixelType());
 
     unsigned int numberOfScalarComponents(1);
-    if (m_TrackedFrame.GetImageData()->GetNumberOfScalarComponents(numberOfScalarComponents) == PLUS_FAIL)
+    if (videoFrame->GetNumberOfScalarComponents(numberOfScalarComponents) == PLUS_FAIL)
     {
       LOG_ERROR("Unable to retrieve number of scalar components.");
       return PLUS_FAIL;
     }
     this->m_MessageHeader.m_NumberOfComponents = numberOfScalarComponents;
-    this->m_MessageHeader.m_ImageType = m_TrackedFrame.GetImageData()->GetImageType();
-    this->m_MessageHeader.m_ImageDataSizeInBytes = this->m_TrackedFrame.GetImageData()->GetFrameSizeInBytes();
-    this->m_MessageHeader.m_ImageOrientation = (igtl_uint16)this->m_TrackedFrame.GetImageData()->GetImageOrientation();
+    this->m_MessageHeader.m_ImageType = videoFrame->GetImageType();
+    this->m_MessageHeader.m_ImageDataSizeInBytes = videoFrame->GetFrameSizeInBytes();
+    this->m_MessageHeader.m_ImageOrientation = (igtl_uint16)videoFrame->GetImageOrientation();
+    this->m_ImageData = videoFrame->GetImage();
+    this->m_FrameTimestamp = frame.GetTimestamp();
+    this->m_SharedMemoryImageReference = false;
+    this->m_SharedMemoryRingName.clear();
+    this->m_SharedMemorySequenceNumber = 0;
 
     return PLUS_SUCCESS;
   }
 
+  //----------------------------------------------------------------------------
+  void PlusTrackedFrameMessage::SetBinaryFrameDataEnabled(bool enabled)
+  {
+    this->m_BinaryFrameDataEnabled = enabled;
+  }
+
+  //----------------------------------------------------------------------------
+  bool PlusTrackedFrameMessage::GetBinaryFrameDataEnabled() const
+  {
+    return this->m_BinaryFrameDataEnabled;
+  }
+
   //----------------------------------------------------------------------------
   igsioTrackedFrame PlusTrackedFrameMessage::GetTrackedFrame()
   {
@@ -121,12 +330,367 @@ namespace igtl
     return mat;
   }
 
+  //----------------------------------------------------------------------------
+  void PlusTrackedFrameMessage::SetImageDataGatherEnabled(bool enabled)
+  {
+    this->m_ImageDataGatherEnabled = enabled;
+  }
+
+  //----------------------------------------------------------------------------
+  bool PlusTrackedFrameMessage::GetImageDataGatherEnabled() const
+  {
+    return this->m_ImageDataGatherEnabled;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::UpdateHeaderForImageDataGather()
+  {
+    if (!this->m_ImageDataGatherEnabled)
+    {
+      return PLUS_SUCCESS;
+    }
+
+    std::vector<std::pair<const unsigned char*, size_t> > segments;
+    this->GetSendSegments(segments);
+    if (segments.empty() || segments[0].second < IGTL_HEADER_SIZE)
+    {
+      LOG_ERROR("Failed to update tracked frame message header - message is not packed");
+      return PLUS_FAIL;
+    }
+
+    // The CRC covers the whole body: the part of the first segment after the header and all the other segments
+    igtl_uint64 crc = crc64(0, 0, 0LL);
+    crc = crc64(const_cast<unsigned char*>(segments[0].first) + IGTL_HEADER_SIZE, segments[0].second - IGTL_HEADER_SIZE, crc);
+    igtl_uint64 bodySize = segments[0].second - IGTL_HEADER_SIZE;
+    for (size_t i = 1; i < segments.size(); ++i)
+    {
+      crc = crc64(const_cast<unsigned char*>(segments[i].first), segments[i].second, crc);
+      bodySize += segments[i].second;
+    }
+
+    igtl_header* header = (igtl_header*)(this->m_Header);
+    igtl_header_convert_byte_order(header);
+    header->body_size = bodySize;
+    header->crc = crc;
+    igtl_header_convert_byte_order(header);
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusTrackedFrameMessage::GetSendSegments(std::vector<std::pair<const unsigned char*, size_t> >& segments)
+  {
+    segments.clear();
+    const unsigned char* buffer = (const unsigned char*)this->GetBufferPointer();
+    size_t bufferSize = this->GetBufferSize();
+    if (!this->m_ImageDataGatherEnabled || this->m_SharedMemoryImageReference || this->m_ImageData == NULL || this->m_MessageHeader.m_ImageDataSizeInBytes == 0)
+    {
+      segments.push_back(std::make_pair(buffer, bufferSize));
+      return;
+    }
+
+    // Message buffer: [igtl header][extended header][tracked frame header][frame data] [meta data]
+    // The image data is sent between the frame data and the meta data.
+    size_t imageDataOffset = IGTL_HEADER_SIZE + (this->m_Content - this->m_Body)
+                             + this->m_MessageHeader.GetMessageHeaderSize() + this->m_MessageHeader.m_FrameDataSizeInBytes;
+    segments.push_back(std::make_pair(buffer, imageDataOffset));
+    segments.push_back(std::make_pair((const unsigned char*)this->m_ImageData->GetScalarPointer(), (size_t)this->m_MessageHeader.m_ImageDataSizeInBytes));
+    if (bufferSize > imageDataOffset)
+    {
+      segments.push_back(std::make_pair(buffer + imageDataOffset, bufferSize - imageDataOffset));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::SetSharedMemoryImageReference(const std::string& ringName, igtl_uint64 sequenceNumber)
+  {
+    if (!IsBinaryFrameData(reinterpret_cast<const unsigned char*>(this->m_TrackedFrameData.data()), this->m_TrackedFrameData.size()))
+    {
+      LOG_ERROR("Failed to set shared memory image reference - binary tracked frame data is required");
+      return PLUS_FAIL;
+    }
+    if (this->m_SharedMemoryImageReference)
+    {
+      LOG_ERROR("Failed to set shared memory image reference - it is already set");
+      return PLUS_FAIL;
+    }
+
+    // Update layout version and flags in the already serialized frame data, then append the reference after the fiducial points
+    std::string layoutVersionAndFlags;
+    AppendUInt16(layoutVersionAndFlags, TRACKEDFRAME_BINARY_LAYOUT_VERSION_SHARED_MEMORY);
+    AppendUInt16(layoutVersionAndFlags, TRACKEDFRAME_BINARY_FLAG_SHARED_MEMORY_IMAGE);
+    this->m_TrackedFrameData.replace(sizeof(TRACKEDFRAME_BINARY_SIGNATURE), layoutVersionAndFlags.size(), layoutVersionAndFlags);
+    AppendUInt32(this->m_TrackedFrameData, static_cast<igtl_uint32>(ringName.size()));
+    this->m_TrackedFrameData.append(ringName);
+    AppendUInt64(this->m_TrackedFrameData, sequenceNumber);
+    this->m_MessageHeader.m_FrameDataSizeInBytes = this->m_TrackedFrameData.size();
+
+    this->m_SharedMemoryImageReference = true;
+    this->m_SharedMemoryRingName = ringName;
+    this->m_SharedMemorySequenceNumber = sequenceNumber;
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  bool PlusTrackedFrameMessage::HasSharedMemoryImageReference() const
+  {
+    return this->m_SharedMemoryImageReference;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string PlusTrackedFrameMessage::GetSharedMemoryRingName() const
+  {
+    return this->m_SharedMemoryRingName;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl_uint64 PlusTrackedFrameMessage::GetSharedMemorySequenceNumber() const
+  {
+    return this->m_SharedMemorySequenceNumber;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::ReadImageDataFromSharedMemory(const PlusIgtlSharedMemoryRing& ring)
+  {
+    if (!this->m_SharedMemoryImageReference)
+    {
+      LOG_ERROR("Failed to read image data from shared memory - the message does not refer to shared memory");
+      return PLUS_FAIL;
+    }
+    if (ring.GetName() != this->m_SharedMemoryRingName)
+    {
+      LOG_ERROR("Failed to read image data from shared memory - the message refers to ring " << this->m_SharedMemoryRingName << ", not " << ring.GetName());
+      return PLUS_FAIL;
+    }
+
+    igsioVideoFrame* videoFrame = this->m_TrackedFrame.GetImageData();
+    if (ring.Read(this->m_SharedMemorySequenceNumber, videoFrame->GetScalarPointer(), this->m_MessageHeader.m_ImageDataSizeInBytes) != PLUS_SUCCESS)
+    {
+      LOG_DEBUG("Image data of frame " << this->m_SharedMemorySequenceNumber << " is not available in shared memory ring " << this->m_SharedMemoryRingName << ", it has been overwritten already");
+      return PLUS_FAIL;
+    }
+    videoFrame->GetImage()->Modified();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  bool PlusTrackedFrameMessage::IsBinaryFrameData(const unsigned char* frameData, size_t frameDataSize)
+  {
+    // XML frame data always starts with '<', therefore the signature cannot be present in XML frame data
+    return frameDataSize >= TRACKEDFRAME_BINARY_HEADER_SIZE
+           && memcmp(frameData, TRACKEDFRAME_BINARY_SIGNATURE, sizeof(TRACKEDFRAME_BINARY_SIGNATURE)) == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::PackBinaryFrameData(igsioTrackedFrame& trackedFrame, const std::vector<igsioTransformName>& requestedTransforms)
+  {
+    StringTable stringTable;
+
+    // Transforms: if no transforms are requested then all transforms of the frame are sent
+    std::vector<igsioTransformName> transformNames(requestedTransforms);
+    if (transformNames.empty())
+    {
+      trackedFrame.GetFrameTransformNameList(transformNames);
+    }
+    std::string transformRecords;
+    igtl_uint32 numberOfTransforms(0);
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (std::vector<igsioTransformName>::iterator nameIt = transformNames.begin(); nameIt != transformNames.end(); ++nameIt)
+    {
+      if (trackedFrame.GetFrameTransform(*nameIt, matrix) != PLUS_SUCCESS)
+      {
+        continue;
+      }
+      ToolStatus status(TOOL_INVALID);
+      trackedFrame.GetFrameTransformStatus(*nameIt, status);
+      AppendUInt32(transformRecords, stringTable.GetIndex(nameIt->GetTransformName()));
+      AppendUInt16(transformRecords, static_cast<igtl_uint16>(status));
+      for (int i = 0; i < 4; ++i)
+      {
+        for (int j = 0; j < 4; ++j)
+        {
+          AppendFloat64(transformRecords, matrix->GetElement(i, j));
+        }
+      }
+      ++numberOfTransforms;
+    }
+
+    // Fields: transforms and statuses are already stored in transform records
+    std::string fieldRecords;
+    igtl_uint32 numberOfFields(0);
+    igsioFieldMapType frameFields = trackedFrame.GetFrameFields();
+    for (igsioFieldMapType::iterator fieldIt = frameFields.begin(); fieldIt != frameFields.end(); ++fieldIt)
+    {
+      if (igsioTrackedFrame::IsTransform(fieldIt->first) || igsioTrackedFrame::IsTransformStatus(fieldIt->first))
+      {
+        continue;
+      }
+      AppendUInt32(fieldRecords, stringTable.GetIndex(fieldIt->first));
+      AppendUInt32(fieldRecords, stringTable.GetIndex(fieldIt->second.second));
+      AppendUInt16(fieldRecords, static_cast<igtl_uint16>(fieldIt->second.first));
+      ++numberOfFields;
+    }
+
+    vtkPoints* fiducialPoints = trackedFrame.GetFiducialPointsCoordinatePx();
+    igtl_uint32 numberOfFiducialPoints = (fiducialPoints != NULL ? static_cast<igtl_uint32>(fiducialPoints->GetNumberOfPoints()) : 0);
+
+    std::string& data = this->m_TrackedFrameData;
+    data.clear();
+    data.append(TRACKEDFRAME_BINARY_SIGNATURE, sizeof(TRACKEDFRAME_BINARY_SIGNATURE));
+    AppendUInt16(data, TRACKEDFRAME_BINARY_LAYOUT_VERSION);
+    AppendUInt16(data, 0);   // reserved
+    AppendUInt32(data, static_cast<igtl_uint32>(stringTable.Strings.size()));
+    AppendUInt32(data, numberOfTransforms);
+    AppendUInt32(data, numberOfFields);
+    AppendUInt32(data, numberOfFiducialPoints);
+    for (std::vector<std::string>::iterator stringIt = stringTable.Strings.begin(); stringIt != stringTable.Strings.end(); ++stringIt)
+    {
+      AppendUInt32(data, static_cast<igtl_uint32>(stringIt->size()));
+      data.append(*stringIt);
+    }
+    data.append(transformRecords);
+    data.append(fieldRecords);
+    for (igtl_uint32 i = 0; i < numberOfFiducialPoints; ++i)
+    {
+      double point[3] = { 0, 0, 0 };
+      fiducialPoints->GetPoint(i, point);
+      AppendFloat64(data, point[0]);
+      AppendFloat64(data, point[1]);
+      AppendFloat64(data, point[2]);
+    }
+
+    if (data.size() > static_cast<size_t>(std::numeric_limits<igtl_uint32>::max()))
+    {
+      LOG_ERROR("Tracked frame data is too large to be sent over OpenIGTLink.");
+      return PLUS_FAIL;
+    }
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::UnpackBinaryFrameData(const unsigned char* frameData, size_t frameDataSize)
+  {
+    BinaryReader reader(frameData, frameDataSize);
+    reader.Skip(sizeof(TRACKEDFRAME_BINARY_SIGNATURE));
+
+    igtl_uint16 layoutVersion(0);
+    igtl_uint16 flags(0);
+    igtl_uint32 numberOfStrings(0);
+    igtl_uint32 numberOfTransforms(0);
+    igtl_uint32 numberOfFields(0);
+    igtl_uint32 numberOfFiducialPoints(0);
+    if (!reader.ReadUInt16(layoutVersion) || !reader.ReadUInt16(flags)
+        || !reader.ReadUInt32(numberOfStrings) || !reader.ReadUInt32(numberOfTransforms)
+        || !reader.ReadUInt32(numberOfFields) || !reader.ReadUInt32(numberOfFiducialPoints))
+    {
+      LOG_ERROR("Failed to read tracked frame data - header is truncated");
+      return PLUS_FAIL;
+    }
+    if (layoutVersion > TRACKEDFRAME_BINARY_LAYOUT_VERSION_SHARED_MEMORY)
+    {
+      LOG_ERROR("Failed to read tracked frame data - unsupported layout version: " << layoutVersion << " (supported: " << TRACKEDFRAME_BINARY_LAYOUT_VERSION_SHARED_MEMORY << ")");
+      return PLUS_FAIL;
+    }
+
+    std::vector<std::string> strings;
+    for (igtl_uint32 i = 0; i < numberOfStrings; ++i)
+    {
+      igtl_uint32 length(0);
+      std::string str;
+      if (!reader.ReadUInt32(length) || !reader.ReadString(str, length))
+      {
+        LOG_ERROR("Failed to read tracked frame data - string table is truncated");
+        return PLUS_FAIL;
+      }
+      strings.push_back(str);
+    }
+
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (igtl_uint32 i = 0; i < numberOfTransforms; ++i)
+    {
+      igtl_uint32 nameIndex(0);
+      igtl_uint16 status(0);
+      if (!reader.ReadUInt32(nameIndex) || !reader.ReadUInt16(status) || nameIndex >= strings.size())
+      {
+        LOG_ERROR("Failed to read tracked frame data - invalid transform record");
+        return PLUS_FAIL;
+      }
+      for (int row = 0; row < 4; ++row)
+      {
+        for (int col = 0; col < 4; ++col)
+        {
+          double element(0);
+          if (!reader.ReadFloat64(element))
+          {
+            LOG_ERROR("Failed to read tracked frame data - transform record is truncated");
+            return PLUS_FAIL;
+          }
+          matrix->SetElement(row, col, element);
+        }
+      }
+      igsioTransformName transformName;
+      if (transformName.SetTransformName(strings[nameIndex]) != PLUS_SUCCESS)
+      {
+        LOG_WARNING("Invalid transform name in tracked frame data: " << strings[nameIndex]);
+        continue;
+      }
+      this->m_TrackedFrame.SetFrameTransform(transformName, matrix);
+      this->m_TrackedFrame.SetFrameTransformStatus(transformName, static_cast<ToolStatus>(status));
+    }
+
+    for (igtl_uint32 i = 0; i < numberOfFields; ++i)
+    {
+      igtl_uint32 nameIndex(0);
+      igtl_uint32 valueIndex(0);
+      igtl_uint16 flags(0);
+      if (!reader.ReadUInt32(nameIndex) || !reader.ReadUInt32(valueIndex) || !reader.ReadUInt16(flags)
+          || nameIndex >= strings.size() || valueIndex >= strings.size())
+      {
+        LOG_ERROR("Failed to read tracked frame data - invalid field record");
+        return PLUS_FAIL;
+      }
+      this->m_TrackedFrame.SetFrameField(strings[nameIndex], strings[valueIndex], static_cast<igsioFrameFieldFlags>(flags));
+    }
+
+    if (numberOfFiducialPoints > 0)
+    {
+      vtkSmartPointer<vtkPoints> fiducialPoints = vtkSmartPointer<vtkPoints>::New();
+      for (igtl_uint32 i = 0; i < numberOfFiducialPoints; ++i)
+      {
+        double point[3] = { 0, 0, 0 };
+        if (!reader.ReadFloat64(point[0]) || !reader.ReadFloat64(point[1]) || !reader.ReadFloat64(point[2]))
+        {
+          LOG_ERROR("Failed to read tracked frame data - fiducial points are truncated");
+          return PLUS_FAIL;
+        }
+        fiducialPoints->InsertNextPoint(point);
+      }
+      this->m_TrackedFrame.SetFiducialPointsCoordinatePx(fiducialPoints);
+    }
+
+    if (layoutVersion >= TRACKEDFRAME_BINARY_LAYOUT_VERSION_SHARED_MEMORY && (flags & TRACKEDFRAME_BINARY_FLAG_SHARED_MEMORY_IMAGE))
+    {
+      igtl_uint32 length(0);
+      if (!reader.ReadUInt32(length) || !reader.ReadString(this->m_SharedMemoryRingName, length) || !reader.ReadUInt64(this->m_SharedMemorySequenceNumber))
+      {
+        LOG_ERROR("Failed to read tracked frame data - shared memory image reference is truncated");
+        return PLUS_FAIL;
+      }
+      this->m_SharedMemoryImageReference = true;
+    }
+
+    return PLUS_SUCCESS;
+  }
+
   //----------------------------------------------------------------------------
   igtlUint64 PlusTrackedFrameMessage::CalculateContentBufferSize()
   {
+    // If image data gather is enabled then the image data is sent directly from the frame, not from the message buffer.
+    // If the image data is in shared memory then it is not sent at all.
     return this->m_MessageHeader.GetMessageHeaderSize()
-           + this->m_MessageHeader.m_ImageDataSizeInBytes
-           + this->m_MessageHeader.m_XmlDataSizeInBytes;
+           + ((this->m_ImageDataGatherEnabled || this->m_SharedMemoryImageReference) ? 0 : this->m_MessageHeader.m_ImageDataSizeInBytes)
+           + this->m_MessageHeader.m_FrameDataSizeInBytes;
   }
 
   //----------------------------------------------------------------------------
@@ -143,22 +707,27 @@ namespace igtl
     header->m_FrameSize[1] = this->m_MessageHeader.m_FrameSize[1];
     header->m_FrameSize[2] = this->m_MessageHeader.m_FrameSize[2];
     header->m_ImageDataSizeInBytes = this->m_MessageHeader.m_ImageDataSizeInBytes;
-    header->m_XmlDataSizeInBytes = this->m_MessageHeader.m_XmlDataSizeInBytes;
+    header->m_FrameDataSizeInBytes = this->m_MessageHeader.m_FrameDataSizeInBytes;
     header->m_ImageOrientation = this->m_MessageHeader.m_ImageOrientation;
     memcpy(header->m_EmbeddedImageTransform, this->m_MessageHeader.m_EmbeddedImageTransform, sizeof(igtl::Matrix4x4));
 
-    // Copy xml data
-    char* xmlData = (char*)(this->m_Content + header->GetMessageHeaderSize());
-    strncpy(xmlData, this->m_TrackedFrameXmlData.c_str(), this->m_TrackedFrameXmlData.size());
-    header->m_XmlDataSizeInBytes = this->m_MessageHeader.m_XmlDataSizeInBytes;
+    // Copy frame data (xml or binary)
+    char* frameData = (char*)(this->m_Content + header->GetMessageHeaderSize());
+    if (!this->m_TrackedFrameData.empty())
+    {
+      memcpy(frameData, this->m_TrackedFrameData.data(), this->m_TrackedFrameData.size());
+    }
 
-    // Copy image data
-    void* imageData = (void*)(this->m_Content + header->GetMessageHeaderSize() + header->m_XmlDataSizeInBytes);
-    memcpy(imageData, this->m_TrackedFrame.GetImageData()->GetScalarPointer(), this->m_TrackedFrame.GetImageData()->GetFrameSizeInBytes());
+    // Copy image data directly from the referenced image, this is the only copy of the pixel data on the sender side
+    void* imageData = (void*)(this->m_Content + header->GetMessageHeaderSize() + header->m_FrameDataSizeInBytes);
+    if (!this->m_ImageDataGatherEnabled && !this->m_SharedMemoryImageReference && this->m_ImageData != NULL && this->m_MessageHeader.m_ImageDataSizeInBytes > 0)
+    {
+      memcpy(imageData, this->m_ImageData->GetScalarPointer(), this->m_MessageHeader.m_ImageDataSizeInBytes);
+    }
 
     // Set timestamp
     auto timestamp = igtl::TimeStamp::New();
-    timestamp->SetTime(this->m_TrackedFrame.GetTimestamp());
+    timestamp->SetTime(this->m_FrameTimestamp);
     this->SetTimeStamp(timestamp);
 
     // Convert header endian
@@ -183,21 +752,37 @@ namespace igtl
     this->m_MessageHeader.m_FrameSize[1] = header->m_FrameSize[1];
     this->m_MessageHeader.m_FrameSize[2] = header->m_FrameSize[2];
     this->m_MessageHeader.m_ImageDataSizeInBytes = header->m_ImageDataSizeInBytes;
-    this->m_MessageHeader.m_XmlDataSizeInBytes = header->m_XmlDataSizeInBytes;
+    this->m_MessageHeader.m_FrameDataSizeInBytes = header->m_FrameDataSizeInBytes;
     this->m_MessageHeader.m_ImageOrientation = header->m_ImageOrientation;
     memcpy(this->m_MessageHeader.m_EmbeddedImageTransform, header->m_EmbeddedImageTransform, sizeof(igtl::Matrix4x4));
 
-    // Copy xml data
-    char* xmlData = (char*)(this->m_Content + header->GetMessageHeaderSize());
-    this->m_TrackedFrameXmlData.assign(xmlData, header->m_XmlDataSizeInBytes);
-    if (this->m_TrackedFrame.SetTrackedFrameFromXmlData(this->m_TrackedFrameXmlData) != PLUS_SUCCESS)
+    this->m_SharedMemoryImageReference = false;
+    this->m_SharedMemoryRingName.clear();
+    this->m_SharedMemorySequenceNumber = 0;
+
+    // Read frame data, the layout is detected from the content so that messages of older servers can be read as well
+    const unsigned char* frameData = (const unsigned char*)(this->m_Content + header->GetMessageHeaderSize());
+    if (IsBinaryFrameData(frameData, header->m_FrameDataSizeInBytes))
     {
-      LOG_ERROR("Failed to set tracked frame data from xml received in Plus TrackedFrame message");
-      return 0;
+      this->m_TrackedFrame = igsioTrackedFrame();
+      if (this->UnpackBinaryFrameData(frameData, header->m_FrameDataSizeInBytes) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set tracked frame data from binary data received in Plus TrackedFrame message");
+        return 0;
+      }
+    }
+    else
+    {
+      this->m_TrackedFrameData.assign((const char*)frameData, header->m_FrameDataSizeInBytes);
+      if (this->m_TrackedFrame.SetTrackedFrameFromXmlData(this->m_TrackedFrameData) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set tracked frame data from xml received in Plus TrackedFrame message");
+        return 0;
+      }
     }
 
     // Copy image data
-    void* imageData = (void*)(this->m_Content + header->GetMessageHeaderSize() + header->m_XmlDataSizeInBytes);
+    void* imageData = (void*)(this->m_Content + header->GetMessageHeaderSize() + header->m_FrameDataSizeInBytes);
     FrameSizeType frameSize = { header->m_FrameSize[0], header->m_FrameSize[1], header->m_FrameSize[2] };
     if (this->m_TrackedFrame.GetImageData()->AllocateFrame(frameSize, PlusCommon::GetVTKScalarPixelTypeFromIGTL(header->m_ScalarType), header->m_NumberOfComponents) != PLUS_SUCCESS)
     {
@@ -208,8 +793,12 @@ namespace igtl
     // Carry the image type forward
     m_TrackedFrame.GetImageData()->SetImageType((US_IMAGE_TYPE)header->m_ImageType);
 
-    memcpy(this->m_TrackedFrame.GetImageData()->GetScalarPointer(), imageData, header->m_ImageDataSizeInBytes);
-    m_TrackedFrame.GetImageData()->GetImage()->Modified();
+    // If the image data is in shared memory then the receiver has to read it using ReadImageDataFromSharedMemory()
+    if (!this->m_SharedMemoryImageReference)
+    {
+      memcpy(this->m_TrackedFrame.GetImageData()->GetScalarPointer(), imageData, header->m_ImageDataSizeInBytes);
+      m_TrackedFrame.GetImageData()->GetImage()->Modified();
+    }
 
     // Set timestamp
     auto timestamp = igtl::TimeStamp::New();
@@ -16,9 +16,14 @@
 #include "igtlObject.h"
 #include "igtl_header.h"
 #include "igtl_util.h"
+#include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
 #include "vtkSmartPointer.h"
 #include <string>
+#include <utility>
+#include <vector>
+
+class PlusIgtlSharedMemoryRing;
 
 namespace igtl
 {
@@ -28,6 +33,29 @@ namespace igtl
   /*!
     \class PlusTrackedFrameMessage
     \brief IGTL message helper class for tracked frame messages
+
+    The message body consists of a fixed size header, the frame data (transforms, transform statuses, frame fields)
+    and the image pixel data. The frame data is stored in one of two layouts:
+    - XML string, as generated by igsioTrackedFrame::GetTrackedFrameInXmlData (default)
+    - binary layout (signature, layout version, string table, fixed size records), only if enabled by
+      SetBinaryFrameDataEnabled(). Servers enable it only for clients that request it in their client info
+      (PlusIgtlClientInfo::SetTrackedFrameBinaryData), because older receivers can only read XML frame data.
+
+    Receivers detect the frame data layout from the signature, therefore messages sent by older servers
+    (XML frame data) can still be read. All binary values are stored in big endian byte order.
+
+    Binary frame data layout (version 1):
+    - char[4] signature ("PTFB"), uint16 layout version, uint16 flags (0 in version 1)
+    - uint32 number of strings, uint32 number of transforms, uint32 number of fields, uint32 number of fiducial points
+    - string table: for each string uint32 length followed by the characters (not zero terminated)
+    - transform records: uint32 name string index, uint16 status, float64[16] matrix elements (row major)
+    - field records: uint32 name string index, uint32 value string index, uint16 flags
+    - fiducial point records: float64[3] position (pixel coordinates)
+
+    Layout version 2 is only used if the image pixel data is not included in the message but stored in a shared memory ring
+    (flags bit 0 is set). The shared memory image reference follows the fiducial point records:
+    - uint32 ring name length, ring name characters, uint64 sequence number of the data block in the ring
+
     \ingroup PlusLibOpenIGTLink
   */
   class vtkPlusOpenIGTLinkExport PlusTrackedFrameMessage: public MessageBase
@@ -40,10 +68,20 @@ namespace igtl
     /*! Override clone so that we use the plus igtl factory */
     virtual igtl::MessageBase::Pointer Clone();
 
-    /*! Set Plus TrackedFrame */
+    /*!
+      Set Plus TrackedFrame. Frame data is serialized immediately, the image pixel data is referenced
+      (not copied) and written directly into the message body when the message is packed.
+    */
     PlusStatus SetTrackedFrame(const igsioTrackedFrame& trackedFrame, const std::vector<igsioTransformName>& requestedTransforms);
 
-    /*! Get Plus TrackedFrame */
+    /*!
+      If enabled then SetTrackedFrame() serializes the frame data in the binary layout instead of XML.
+      Only enable it if the receiver announced that it can read binary frame data. Disabled by default.
+    */
+    void SetBinaryFrameDataEnabled(bool enabled);
+    bool GetBinaryFrameDataEnabled() const;
+
+    /*! Get Plus TrackedFrame (available after the message is unpacked) */
     igsioTrackedFrame GetTrackedFrame();
 
     /*! Set the embedded transform of the underlying image */
@@ -52,6 +90,43 @@ namespace igtl
     /*! Get the embedded transform of the underlying image */
     vtkSmartPointer<vtkMatrix4x4> GetEmbeddedImageTransform();
 
+    /*!
+      If enabled then the image pixel data is not copied into the message buffer when the message is packed.
+      The message has to be sent using the memory segments returned by GetSendSegments(), which refer to the
+      image data of the tracked frame (kept alive by the message). Disabled by default.
+    */
+    void SetImageDataGatherEnabled(bool enabled);
+    bool GetImageDataGatherEnabled() const;
+
+    /*!
+      Update the body size and CRC in the packed message header to include the image data that is not stored
+      in the message buffer. Must be called after Pack() if image data gather is enabled.
+    */
+    PlusStatus UpdateHeaderForImageDataGather();
+
+    /*! Get the memory segments of the packed message in sending order. The total size is the full message size. */
+    void GetSendSegments(std::vector<std::pair<const unsigned char*, size_t> >& segments);
+
+    /*!
+      Do not include the image pixel data in the message, refer to a data block in a shared memory ring instead.
+      Must be called after SetTrackedFrame(). Requires binary frame data (see SetBinaryFrameDataEnabled()).
+      The message body then only contains the image size and type, the frame data and the embedded transform.
+    */
+    PlusStatus SetSharedMemoryImageReference(const std::string& ringName, igtl_uint64 sequenceNumber);
+
+    /*! Returns true if the image pixel data of the (sent or received) message is stored in a shared memory ring */
+    bool HasSharedMemoryImageReference() const;
+    /*! Name of the shared memory ring that contains the image pixel data */
+    std::string GetSharedMemoryRingName() const;
+    /*! Sequence number of the data block in the shared memory ring that contains the image pixel data */
+    igtl_uint64 GetSharedMemorySequenceNumber() const;
+
+    /*!
+      Copy the image pixel data of a received message from the shared memory ring into the tracked frame.
+      Fails if the data block is already overwritten in the ring (the receiver fell behind by more frames than the ring size).
+    */
+    PlusStatus ReadImageDataFromSharedMemory(const PlusIgtlSharedMemoryRing& ring);
+
   protected:
     class TrackedFrameHeader
     {
@@ -61,7 +136,7 @@ namespace igtl
         , m_NumberOfComponents(0)
         , m_ImageType(0)
         , m_ImageDataSizeInBytes(0)
-        , m_XmlDataSizeInBytes(0)
+        , m_FrameDataSizeInBytes(0)
         , m_ImageOrientation(0)
       {
         m_FrameSize[0] = m_FrameSize[1] = m_FrameSize[2] = 0;
@@ -82,7 +157,7 @@ namespace igtl
         headersize += sizeof(igtl_uint16);        // m_ImageType
         headersize += sizeof(igtl_uint16) * 3;    // m_FrameSize[3]
         headersize += sizeof(igtl_uint32);        // m_ImageDataSizeInBytes
-        headersize += sizeof(igtl_uint32);        // m_XmlDataSizeInBytes
+        headersize += sizeof(igtl_uint32);        // m_FrameDataSizeInBytes
         headersize += sizeof(igtl_uint16);        // m_ImageOrientation
         headersize += sizeof(igtl::Matrix4x4);    // m_EmbeddedImageTransform[4][4]
 
@@ -100,7 +175,7 @@ namespace igtl
           m_FrameSize[1] = BYTE_SWAP_INT16(m_FrameSize[1]);
           m_FrameSize[2] = BYTE_SWAP_INT16(m_FrameSize[2]);
           m_ImageDataSizeInBytes = BYTE_SWAP_INT32(m_ImageDataSizeInBytes);
-          m_XmlDataSizeInBytes = BYTE_SWAP_INT32(m_XmlDataSizeInBytes);
+          m_FrameDataSizeInBytes = BYTE_SWAP_INT32(m_FrameDataSizeInBytes);
           m_ImageOrientation = BYTE_SWAP_INT16(m_ImageOrientation);
         }
       }
@@ -110,7 +185,7 @@ namespace igtl
       igtl_uint16     m_ImageType;              /* image type */
       igtl_uint16     m_FrameSize[3];           /* entire image volume size */
       igtl_uint32     m_ImageDataSizeInBytes;   /* size of the image, in bytes */
-      igtl_uint32     m_XmlDataSizeInBytes;     /* size of the xml data, in bytes */
+      igtl_uint32     m_FrameDataSizeInBytes;   /* size of the frame data (xml or binary), in bytes */
       igtl_uint16     m_ImageOrientation;       /* orientation of the image */
       igtl::Matrix4x4 m_EmbeddedImageTransform; /* matrix representing the IJK to world transformation */
     };
@@ -119,11 +194,34 @@ namespace igtl
     virtual int  PackContent();
     virtual int  UnpackContent();
 
+    /*! Serialize transforms, statuses, fields, and fiducial points into the binary frame data layout */
+    PlusStatus PackBinaryFrameData(igsioTrackedFrame& trackedFrame, const std::vector<igsioTransformName>& requestedTransforms);
+
+    /*! Set transforms, statuses, fields, and fiducial points from binary frame data */
+    PlusStatus UnpackBinaryFrameData(const unsigned char* frameData, size_t frameDataSize);
+
+    /*! Returns true if the frame data is in binary layout (XML otherwise) */
+    static bool IsBinaryFrameData(const unsigned char* frameData, size_t frameDataSize);
+
     PlusTrackedFrameMessage();
     ~PlusTrackedFrameMessage();
 
+    /*! Received tracked frame */
     igsioTrackedFrame m_TrackedFrame;
-    std::string m_TrackedFrameXmlData;
+    /*! Serialized frame data (XML or binary layout) */
+    std::string m_TrackedFrameData;
+    /*! Image to be sent. Reference counted to avoid copying the pixel data before packing. */
+    vtkSmartPointer<vtkImageData> m_ImageData;
+    /*! Timestamp of the frame to be sent */
+    double m_FrameTimestamp;
+    /*! If enabled then the frame data is serialized in binary layout, otherwise in XML */
+    bool m_BinaryFrameDataEnabled;
+    /*! If enabled then the image data is not copied into the message buffer */
+    bool m_ImageDataGatherEnabled;
+    /*! If true then the image data is stored in a shared memory ring instead of the message */
+    bool m_SharedMemoryImageReference;
+    std::string m_SharedMemoryRingName;
+    igtl_uint64 m_SharedMemorySequenceNumber;
 
     TrackedFrameHeader m_MessageHeader;
   };
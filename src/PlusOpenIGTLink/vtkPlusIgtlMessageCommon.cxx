@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusIgtlSharedMemoryRing.h"
 #include "igsioTrackedFrame.h"
 #include "igsioVideoFrame.h"
 #include "vtkPlusIgtlMessageCommon.h"
@@ -32,6 +33,10 @@ See License.txt for details.
   #include <igtlioVideoConverter.h>
 #endif
 
+// STL includes
+#include <iomanip>
+#include <sstream>
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusIgtlMessageCommon);
@@ -89,7 +94,9 @@ PlusStatus vtkPlusIgtlMessageCommon::GetIgtlMatrix(igtl::Matrix4x4& igtlMatrix,
 PlusStatus vtkPlusIgtlMessageCommon::PackTrackedFrameMessage(igtl::PlusTrackedFrameMessage::Pointer trackedFrameMessage,
     igsioTrackedFrame& trackedFrame,
     vtkSmartPointer<vtkMatrix4x4> embeddedImageTransform,
-    const std::vector<igsioTransformName>& requestedTransforms)
+    const std::vector<igsioTransformName>& requestedTransforms,
+    const std::string& sharedMemoryRingName,
+    igtl_uint64 sharedMemorySequenceNumber)
 {
   if (trackedFrameMessage.IsNull())
   {
@@ -107,9 +114,20 @@ PlusStatus vtkPlusIgtlMessageCommon::PackTrackedFrameMessage(igtl::PlusTrackedFr
   {
     return status;
   }
+  if (!sharedMemoryRingName.empty())
+  {
+    status = trackedFrameMessage->SetSharedMemoryImageReference(sharedMemoryRingName, sharedMemorySequenceNumber);
+    if (status == PLUS_FAIL)
+    {
+      return status;
+    }
+  }
 
   trackedFrameMessage->Pack();
 
+  // No-op if image data gather is disabled
+  status = trackedFrameMessage->UpdateHeaderForImageDataGather();
+
   return status;
 }
 
@@ -118,8 +136,15 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(igtl::MessageHead
     igtl::Socket* socket,
     igsioTrackedFrame& trackedFrame,
     const igsioTransformName& embeddedTransformName,
-    int crccheck)
+    int crccheck,
+    PlusIgtlSharedMemoryRing* sharedMemoryRing,
+    SharedMemoryImageStatus* sharedMemoryStatus)
 {
+  if (sharedMemoryStatus != NULL)
+  {
+    *sharedMemoryStatus = SHARED_MEMORY_IMAGE_NOT_USED;
+  }
+
   if (headerMsg.IsNull())
   {
     LOG_ERROR("Unable to unpack tracked frame message - header message is NULL!");
@@ -150,6 +175,48 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(igtl::MessageHead
     return PLUS_FAIL;
   }
 
+  if (trackedFrameMsg->HasSharedMemoryImageReference())
+  {
+    // Image data is not in the message, get it from the shared memory ring of the server
+    if (sharedMemoryRing == NULL)
+    {
+      if (sharedMemoryStatus != NULL)
+      {
+        LOG_DEBUG("Received tracked frame message refers to image data in shared memory but shared memory transport is not enabled, frame is dropped");
+        *sharedMemoryStatus = SHARED_MEMORY_RING_UNAVAILABLE;
+        return PLUS_FAIL;
+      }
+      LOG_ERROR("Received tracked frame message refers to image data in shared memory but shared memory transport is not enabled");
+      return PLUS_FAIL;
+    }
+    if (!sharedMemoryRing->IsOpen() || sharedMemoryRing->GetName() != trackedFrameMsg->GetSharedMemoryRingName())
+    {
+      if (sharedMemoryRing->Open(trackedFrameMsg->GetSharedMemoryRingName()) != PLUS_SUCCESS)
+      {
+        if (sharedMemoryStatus != NULL)
+        {
+          *sharedMemoryStatus = SHARED_MEMORY_RING_UNAVAILABLE;
+          return PLUS_FAIL;
+        }
+        LOG_ERROR("Unable to open shared memory ring " << trackedFrameMsg->GetSharedMemoryRingName() << " of the server");
+        return PLUS_FAIL;
+      }
+    }
+    if (trackedFrameMsg->ReadImageDataFromSharedMemory(*sharedMemoryRing) != PLUS_SUCCESS)
+    {
+      // Normal back-pressure: the reader is slower than the server, skip this frame
+      if (sharedMemoryStatus != NULL)
+      {
+        *sharedMemoryStatus = SHARED_MEMORY_IMAGE_OVERWRITTEN;
+      }
+      return PLUS_FAIL;
+    }
+    if (sharedMemoryStatus != NULL)
+    {
+      *sharedMemoryStatus = SHARED_MEMORY_IMAGE_READ;
+    }
+  }
+
   // if CRC check is OK. get tracked frame data.
   trackedFrame = trackedFrameMsg->GetTrackedFrame();
 
@@ -685,6 +752,142 @@ PlusStatus vtkPlusIgtlMessageCommon::PackTrackingDataMessage(igtl::TrackingDataM
   return PLUS_SUCCESS;
 }
 
+//-------------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::PackTrackingDataMessage(igtl::TrackingDataMessage::Pointer trackingDataMessage,
+    const std::vector<PlusIgtlClientInfo::TrackingDataSample>& samples)
+{
+  if (trackingDataMessage.IsNull())
+  {
+    LOG_ERROR("Failed to pack tracking data message - input tracking data message is NULL");
+    return PLUS_FAIL;
+  }
+  if (samples.empty())
+  {
+    LOG_ERROR("Failed to pack tracking data message - no samples are provided");
+    return PLUS_FAIL;
+  }
+
+  std::ostringstream sampleTimestamps;
+  sampleTimestamps << std::fixed << std::setprecision(6);
+  std::ostringstream sampleElementCounts;
+  std::ostringstream sampleStatuses;
+  uint32_t elementIndex = 0;
+  for (auto sampleIt = samples.begin(); sampleIt != samples.end(); ++sampleIt)
+  {
+    bool latestSample = (sampleIt + 1 == samples.end());
+    if (sampleIt != samples.begin())
+    {
+      sampleTimestamps << " ";
+      sampleElementCounts << " ";
+    }
+    sampleTimestamps << sampleIt->Timestamp;
+    sampleElementCounts << sampleIt->Elements.size();
+
+    for (auto elementIt = sampleIt->Elements.begin(); elementIt != sampleIt->Elements.end(); ++elementIt)
+    {
+      auto trackElement = igtl::TrackingDataElement::New();
+      std::string shortenedName = elementIt->TransformName.substr(0, IGTL_TDATA_LEN_NAME);
+      trackElement->SetName(shortenedName.c_str());
+      trackElement->SetType(igtl::TrackingDataElement::TYPE_6D);
+      // SetMatrix takes a non-const matrix
+      igtl::Matrix4x4 matrix;
+      for (int r = 0; r < 4; ++r)
+      {
+        for (int c = 0; c < 4; ++c)
+        {
+          matrix[r][c] = elementIt->Matrix[r][c];
+        }
+      }
+      trackElement->SetMatrix(matrix);
+      trackingDataMessage->AddTrackingDataElement(trackElement);
+
+      if (elementIndex > 0)
+      {
+        sampleStatuses << " ";
+      }
+      sampleStatuses << igsioCommon::ConvertToolStatusToString(elementIt->Status);
+      if (latestSample)
+      {
+        trackingDataMessage->SetMetaDataElement(elementIt->TransformName + "Status", IANA_TYPE_US_ASCII, igsioCommon::ConvertToolStatusToString(elementIt->Status));
+        trackingDataMessage->SetMetaDataElement(elementIt->TransformName + "Index", IANA_TYPE_US_ASCII, igsioCommon::ToString(elementIndex));
+      }
+      ++elementIndex;
+    }
+  }
+  trackingDataMessage->SetMetaDataElement("SampleCount", IANA_TYPE_US_ASCII, igsioCommon::ToString(samples.size()));
+  trackingDataMessage->SetMetaDataElement("SampleTimestamps", IANA_TYPE_US_ASCII, sampleTimestamps.str());
+  trackingDataMessage->SetMetaDataElement("SampleElementCounts", IANA_TYPE_US_ASCII, sampleElementCounts.str());
+  trackingDataMessage->SetMetaDataElement("SampleStatuses", IANA_TYPE_US_ASCII, sampleStatuses.str());
+
+  // Device name is based on the number of tools (same as for single-sample messages)
+  auto igtlTime = igtl::TimeStamp::New();
+  igtlTime->SetTime(samples.back().Timestamp);
+  trackingDataMessage->SetDeviceName("TDATA_" + igsioCommon::ToString(samples.back().Elements.size()) + "Elem");
+  trackingDataMessage->SetTimeStamp(igtlTime);
+  trackingDataMessage->Pack();
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::GetTrackingDataMessageSamples(igtl::TrackingDataMessage::Pointer trackingDataMessage, std::vector<double>& sampleTimestamps,
+    std::vector<int>& sampleElementCounts, std::vector<ToolStatus>& elementStatuses)
+{
+  sampleTimestamps.clear();
+  sampleElementCounts.clear();
+  elementStatuses.clear();
+  if (trackingDataMessage.IsNull())
+  {
+    return PLUS_FAIL;
+  }
+
+  std::string sampleTimestampsStr;
+  std::string sampleElementCountsStr;
+  std::string sampleStatusesStr;
+  if (!trackingDataMessage->GetMetaDataElement("SampleTimestamps", sampleTimestampsStr)
+      || !trackingDataMessage->GetMetaDataElement("SampleElementCounts", sampleElementCountsStr)
+      || !trackingDataMessage->GetMetaDataElement("SampleStatuses", sampleStatusesStr))
+  {
+    // not a multi-sample message
+    return PLUS_FAIL;
+  }
+
+  std::istringstream timestampsStream(sampleTimestampsStr);
+  double timestamp = 0;
+  while (timestampsStream >> timestamp)
+  {
+    sampleTimestamps.push_back(timestamp);
+  }
+  std::istringstream elementCountsStream(sampleElementCountsStr);
+  int elementCount = 0;
+  int totalNumberOfElements = 0;
+  while (elementCountsStream >> elementCount)
+  {
+    sampleElementCounts.push_back(elementCount);
+    totalNumberOfElements += elementCount;
+  }
+  std::istringstream statusesStream(sampleStatusesStr);
+  std::string status;
+  while (statusesStream >> status)
+  {
+    elementStatuses.push_back(igsioCommon::ConvertStringToToolStatus(status));
+  }
+
+  if (sampleTimestamps.size() != sampleElementCounts.size()
+      || static_cast<int>(elementStatuses.size()) != totalNumberOfElements
+      || totalNumberOfElements != trackingDataMessage->GetNumberOfTrackingDataElements())
+  {
+    LOG_ERROR("Invalid sample meta data in TDATA message: " << sampleTimestamps.size() << " timestamps, " << sampleElementCounts.size() << " element counts, "
+              << elementStatuses.size() << " statuses, " << trackingDataMessage->GetNumberOfTrackingDataElements() << " elements");
+    sampleTimestamps.clear();
+    sampleElementCounts.clear();
+    elementStatuses.clear();
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusIgtlMessageCommon::UnpackTrackingDataMessage(igtl::MessageHeader::Pointer headerMsg,
     igtl::Socket* socket,
@@ -815,7 +1018,24 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackTransformMessage(igtl::MessageHeader:
     LOG_ERROR("Couldn't receive transform message from server!");
     return PLUS_FAIL;
   }
+
   // if CRC check is OK. Read transform data.
+  return GetTransformFromTransformMessage(transMsg, transformMatrix, toolStatus, transformName, timestamp);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::GetTransformFromTransformMessage(igtl::TransformMessage::Pointer transMsg,
+    vtkMatrix4x4* transformMatrix,
+    ToolStatus& toolStatus,
+    std::string& transformName,
+    double& timestamp)
+{
+  if (transMsg.IsNull() || transformMatrix == NULL)
+  {
+    LOG_ERROR("Unable to get transform from transform message - message or matrix is NULL!");
+    return PLUS_FAIL;
+  }
+
   igtl::Matrix4x4 igtlMatrix;
   igtl::IdentityMatrix(igtlMatrix);
   transMsg->GetMatrix(igtlMatrix);
@@ -929,6 +1149,22 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackPositionMessage(igtl::MessageHeader::
   }
 
   // if CRC check is OK. Read position data.
+  return GetTransformFromPositionMessage(posMsg, transformMatrix, transformName, toolStatus, timestamp);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::GetTransformFromPositionMessage(igtl::PositionMessage::Pointer posMsg,
+    vtkMatrix4x4* transformMatrix,
+    std::string& transformName,
+    ToolStatus& toolStatus,
+    double& timestamp)
+{
+  if (posMsg.IsNull() || transformMatrix == NULL)
+  {
+    LOG_ERROR("Unable to get transform from position message - message or matrix is NULL!");
+    return PLUS_FAIL;
+  }
+
   float position[3] = {0};
   posMsg->GetPosition(position);
 
@@ -9,6 +9,7 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusIgtlClientInfo.h"
 #include "vtkPlusOpenIGTLinkExport.h"
 
 // VTK includes
@@ -31,6 +32,7 @@ See License.txt for details.
   #include <igtlVideoMessage.h>
 #endif
 
+class PlusIgtlSharedMemoryRing;
 class vtkXMLDataElement;
 //class igsioTrackedFrame;
 class vtkPolyData;
@@ -52,11 +54,33 @@ public:
   vtkTypeMacro(vtkPlusIgtlMessageCommon, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
 
-  /*! Pack tracked frame message from tracked frame */
-  static PlusStatus PackTrackedFrameMessage(igtl::PlusTrackedFrameMessage::Pointer trackedFrameMessage, igsioTrackedFrame& trackedFrame, vtkSmartPointer<vtkMatrix4x4> embeddedImageTransform, const std::vector<igsioTransformName>& requestedTransforms);
-
-  /*! Unpack tracked frame message to tracked frame */
-  static PlusStatus UnpackTrackedFrameMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck);
+  /*! Source of the image data of a received TRACKEDFRAME message */
+  enum SharedMemoryImageStatus
+  {
+    SHARED_MEMORY_IMAGE_NOT_USED,     /*!< Image data was sent in the message */
+    SHARED_MEMORY_IMAGE_READ,         /*!< Image data was read from the shared memory ring */
+    SHARED_MEMORY_IMAGE_OVERWRITTEN,  /*!< Image data is not in the ring anymore, the receiver fell behind the server */
+    SHARED_MEMORY_RING_UNAVAILABLE    /*!< The shared memory ring of the server cannot be opened (or shared memory is not enabled) */
+  };
+
+  /*!
+    Pack tracked frame message from tracked frame
+    \param sharedMemoryRingName If not empty then the image data is not included in the message, the message refers to
+      the data block of the shared memory ring that contains the image instead
+    \param sharedMemorySequenceNumber Sequence number of the data block in the shared memory ring
+  */
+  static PlusStatus PackTrackedFrameMessage(igtl::PlusTrackedFrameMessage::Pointer trackedFrameMessage, igsioTrackedFrame& trackedFrame, vtkSmartPointer<vtkMatrix4x4> embeddedImageTransform, const std::vector<igsioTransformName>& requestedTransforms,
+      const std::string& sharedMemoryRingName = std::string(), igtl_uint64 sharedMemorySequenceNumber = 0);
+
+  /*!
+    Unpack tracked frame message to tracked frame
+    \param sharedMemoryRing Ring that is used for reading image data that the server sent through shared memory.
+      The ring is (re)opened if the message refers to a different ring. If NULL then messages that refer to shared memory are rejected.
+    \param sharedMemoryStatus If not NULL then it is set to the source of the image data. If the image data is not available in
+      shared memory then PLUS_FAIL is returned without logging an error, the caller decides how to handle the missing frame.
+  */
+  static PlusStatus UnpackTrackedFrameMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck,
+      PlusIgtlSharedMemoryRing* sharedMemoryRing = NULL, SharedMemoryImageStatus* sharedMemoryStatus = NULL);
 
   /*! Pack US message from tracked frame */
   static PlusStatus PackUsMessage(igtl::PlusUsMessage::Pointer usMessage, igsioTrackedFrame& trackedFrame);
@@ -91,6 +115,22 @@ public:
   /*! Pack data message from tracked frame */
   static PlusStatus PackTrackingDataMessage(igtl::TrackingDataMessage::Pointer tdataMessage, const std::vector<igsioTransformName>& names, const vtkIGSIOTransformRepository& repository, double timestamp);
 
+  /*!
+    Pack tool poses of multiple tracked frames into a single TDATA message.
+    Elements of all samples are added in time order. Sample timestamps, number of elements per sample, and element statuses
+    are stored in the SampleTimestamps, SampleElementCounts, SampleStatuses meta data elements, while the
+    [TransformName]Status and [TransformName]Index meta data elements refer to the latest sample.
+    Message timestamp is the timestamp of the latest sample.
+  */
+  static PlusStatus PackTrackingDataMessage(igtl::TrackingDataMessage::Pointer tdataMessage, const std::vector<PlusIgtlClientInfo::TrackingDataSample>& samples);
+
+  /*!
+    Get per-sample information from a TDATA message that was packed from multiple samples.
+    Returns PLUS_FAIL if the message does not contain multiple samples (or the sample meta data is invalid).
+  */
+  static PlusStatus GetTrackingDataMessageSamples(igtl::TrackingDataMessage::Pointer tdataMessage, std::vector<double>& sampleTimestamps,
+      std::vector<int>& sampleElementCounts, std::vector<ToolStatus>& elementStatuses);
+
   /*! Unpack data message */
   static PlusStatus UnpackTrackingDataMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket,
       std::vector<igsioTransformName>& names, vtkIGSIOTransformRepository& repository, double& timestamp, int crccheck);
@@ -99,6 +139,10 @@ public:
   static PlusStatus UnpackTransformMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket,
       vtkMatrix4x4* transformMatrix, ToolStatus& toolStatus, std::string& transformName, double& timestamp, int crccheck);
 
+  /*! Get transform data from an already unpacked transform message (e.g., received in a datagram) */
+  static PlusStatus GetTransformFromTransformMessage(igtl::TransformMessage::Pointer transMsg,
+      vtkMatrix4x4* transformMatrix, ToolStatus& toolStatus, std::string& transformName, double& timestamp);
+
   /*! Pack position message from tracked frame */
   static PlusStatus PackPositionMessage(igtl::PositionMessage::Pointer positionMessage, igsioTransformName& transformName, ToolStatus status,
                                         float position[3], float quaternion[4], double timestamp);
@@ -107,6 +151,10 @@ public:
   static PlusStatus UnpackPositionMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket,
                                           vtkMatrix4x4* transformMatrix, std::string& transformName, ToolStatus& toolStatus, double& timestamp, int crccheck);
 
+  /*! Get transform data from an already unpacked position message (e.g., received in a datagram) */
+  static PlusStatus GetTransformFromPositionMessage(igtl::PositionMessage::Pointer posMsg,
+      vtkMatrix4x4* transformMatrix, std::string& transformName, ToolStatus& toolStatus, double& timestamp);
+
   /*! Pack string message */
   static PlusStatus PackStringMessage(igtl::StringMessage::Pointer stringMessage, const char* stringName, const char* stringValue, double timestamp);
   static PlusStatus PackStringMessage(igtl::StringMessage::Pointer stringMessage, const std::string& stringName, const std::string& stringValue, double timestamp);
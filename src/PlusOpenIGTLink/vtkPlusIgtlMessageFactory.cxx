@@ -5,6 +5,7 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusMetrics.h"
 
 #include "igsioTrackedFrame.h"
 #include "igsioVideoFrame.h"
@@ -14,9 +15,13 @@ See License.txt for details.
 #include "vtkObjectFactory.h"
 #include "vtkPlusIgtlMessageCommon.h"
 #include "vtkPlusIgtlMessageFactory.h"
+#include "PlusIgtlImageStreamShaper.h"
+#include "PlusIgtlSharedMemoryRing.h"
+#include "PlusIgtlVideoEncoderPool.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
 #include "vtksys/SystemTools.hxx"
+#include <sstream>
 #include <typeinfo>
 
 //----------------------------------------------------------------------------
@@ -45,11 +50,31 @@ See License.txt for details.
 
 //----------------------------------------------------------------------------
 
+namespace
+{
+  // Coalesced TDATA message is sent when this many samples are collected, even if the resolution time is not elapsed yet
+  const size_t MAX_NUMBER_OF_COALESCED_TDATA_SAMPLES = 1000;
+
+  // Number of images kept in the shared memory ring. Clients that fall behind by more frames drop the overwritten frames.
+  const unsigned int NUMBER_OF_SHARED_MEMORY_SLOTS = 8;
+}
+
+//----------------------------------------------------------------------------
+
 vtkStandardNewMacro(vtkPlusIgtlMessageFactory);
 
 //----------------------------------------------------------------------------
 vtkPlusIgtlMessageFactory::vtkPlusIgtlMessageFactory()
   : IgtlFactory(igtl::MessageFactory::New())
+  , ImageDataGatherEnabled(false)
+  , SharedMemoryRing(new PlusIgtlSharedMemoryRing)
+  , SharedMemoryRingGeneration(0)
+  , SharedMemoryFrameTimestamp(-1)
+  , SharedMemorySequenceNumber(0)
+  , ImageStreamShaper(new PlusIgtlImageStreamShaper)
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+  , VideoEncoderPool(new PlusIgtlVideoEncoderPool)
+#endif
 {
   this->IgtlFactory->AddMessageType("CLIENTINFO", (PointerToMessageBaseNew)&igtl::PlusClientInfoMessage::New);
   this->IgtlFactory->AddMessageType("TRACKEDFRAME", (PointerToMessageBaseNew)&igtl::PlusTrackedFrameMessage::New);
@@ -59,13 +84,30 @@ vtkPlusIgtlMessageFactory::vtkPlusIgtlMessageFactory()
 //----------------------------------------------------------------------------
 vtkPlusIgtlMessageFactory::~vtkPlusIgtlMessageFactory()
 {
+  delete this->ImageStreamShaper;
+  this->ImageStreamShaper = NULL;
+  delete this->SharedMemoryRing;
+  this->SharedMemoryRing = NULL;
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+  delete this->VideoEncoderPool;
+  this->VideoEncoderPool = NULL;
+#endif
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::RemoveClient(int clientId)
+{
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+  this->VideoEncoderPool->RemoveClient(clientId);
+#endif
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusIgtlMessageFactory::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "ImageDataGatherEnabled: " << (this->ImageDataGatherEnabled ? "true" : "false") << std::endl;
+  os << indent << "SharedMemoryRingNamePrefix: " << this->SharedMemoryRingNamePrefix << std::endl;
   this->PrintAvailableMessageTypes(os, indent);
 }
 
@@ -139,9 +181,10 @@ igtl::MessageBase::Pointer vtkPlusIgtlMessageFactory::CreateSendMessage(const st
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtlMessages, igsioTrackedFrame& trackedFrame,
+PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtlMessages, igsioTrackedFrame& trackedFrame,
     bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository/*=NULL*/)
 {
+  PLUS_METRIC_SCOPED_TIMER("plus_igtl_pack_messages_seconds", PlusMetricsRegistry::MakeLabel("client", igsioCommon::ToString<int>(clientId)));
   int numberOfErrors(0);
   igtlMessages.clear();
 
@@ -289,7 +332,20 @@ int vtkPlusIgtlMessageFactory::PackTrackedFrameMessage(igtl::MessageBase::Pointe
       return numberOfErrors;
     }
   }
-  if (vtkPlusIgtlMessageCommon::PackTrackedFrameMessage(trackedFrameMessage, trackedFrame, imageMatrix, clientInfo.TransformNames) != PLUS_SUCCESS)
+  // Local clients may get the image data through shared memory, the message only contains the reference then.
+  // If the image cannot be written into shared memory then it is sent in the message.
+  std::string sharedMemoryRingName;
+  igtl_uint64 sharedMemorySequenceNumber(0);
+  if (clientInfo.GetSharedMemoryTransport() && clientInfo.GetTrackedFrameBinaryData() && !this->SharedMemoryRingNamePrefix.empty()
+      && this->WriteImageToSharedMemory(trackedFrame, sharedMemorySequenceNumber) == PLUS_SUCCESS)
+  {
+    sharedMemoryRingName = this->SharedMemoryRing->GetName();
+  }
+
+  // Binary frame data is only sent to clients that can read it, all others get XML frame data
+  trackedFrameMessage->SetBinaryFrameDataEnabled(clientInfo.GetTrackedFrameBinaryData());
+  trackedFrameMessage->SetImageDataGatherEnabled(this->ImageDataGatherEnabled);
+  if (vtkPlusIgtlMessageCommon::PackTrackedFrameMessage(trackedFrameMessage, trackedFrame, imageMatrix, clientInfo.TransformNames, sharedMemoryRingName, sharedMemorySequenceNumber) != PLUS_SUCCESS)
   {
     LOG_ERROR("Failed to pack IGT messages - unable to pack tracked frame message");
     numberOfErrors++;
@@ -299,6 +355,48 @@ int vtkPlusIgtlMessageFactory::PackTrackedFrameMessage(igtl::MessageBase::Pointe
   return numberOfErrors;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageFactory::WriteImageToSharedMemory(igsioTrackedFrame& trackedFrame, igtl_uint64& sequenceNumber)
+{
+  igsioVideoFrame* videoFrame = trackedFrame.GetImageData();
+  if (videoFrame == NULL || !videoFrame->IsImageValid())
+  {
+    return PLUS_FAIL;
+  }
+
+  // The same frame is packed for each client, the image is written only once
+  if (this->SharedMemoryRing->IsOpen() && this->SharedMemoryFrameTimestamp >= 0 && this->SharedMemoryFrameTimestamp == trackedFrame.GetTimestamp())
+  {
+    sequenceNumber = this->SharedMemorySequenceNumber;
+    return PLUS_SUCCESS;
+  }
+
+  size_t imageSize = videoFrame->GetFrameSizeInBytes();
+  if (!this->SharedMemoryRing->IsOpen() || this->SharedMemoryRing->GetSlotSize() < imageSize)
+  {
+    // Messages refer to the ring by name, so clients switch to the new ring when they receive the first message that refers to it
+    std::ostringstream ringName;
+    ringName << this->SharedMemoryRingNamePrefix << "_" << ++this->SharedMemoryRingGeneration;
+    if (this->SharedMemoryRing->Create(ringName.str(), NUMBER_OF_SHARED_MEMORY_SLOTS, imageSize) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to create shared memory ring for sending images to local clients, images are sent through the socket");
+      this->SharedMemoryFrameTimestamp = -1;
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Shared memory ring " << ringName.str() << " is created for sending images to local clients (" << NUMBER_OF_SHARED_MEMORY_SLOTS << " x " << imageSize << " bytes)");
+  }
+
+  PLUS_METRIC_SCOPED_TIMER("plus_igtl_shared_memory_write_seconds", "");
+  if (this->SharedMemoryRing->Write(videoFrame->GetScalarPointer(), imageSize, this->SharedMemorySequenceNumber) != PLUS_SUCCESS)
+  {
+    this->SharedMemoryFrameTimestamp = -1;
+    return PLUS_FAIL;
+  }
+  this->SharedMemoryFrameTimestamp = trackedFrame.GetTimestamp();
+  sequenceNumber = this->SharedMemorySequenceNumber;
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
 {
@@ -331,9 +429,61 @@ int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& cli
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
 {
-  if (clientInfo.GetTDATARequested() && clientInfo.GetLastTDATASentTimeStamp() + clientInfo.GetTDATAResolution() < trackedFrame.GetTimestamp())
+  if (!clientInfo.GetTDATARequested())
+  {
+    return 0;
+  }
+
+  // TDATAResolution is specified in milliseconds, timestamps are in seconds
+  bool resolutionTimeElapsed = (clientInfo.GetLastTDATASentTimeStamp() + clientInfo.GetTDATAResolution() * 0.001 < trackedFrame.GetTimestamp());
+
+  if (clientInfo.GetTDATACoalescing())
+  {
+    // Collect tool poses of all frames and send them in one message when the resolution time is elapsed
+    std::vector<PlusIgtlClientInfo::TrackingDataSample>& pendingSamples = clientInfo.GetPendingTDATASamples();
+    if (pendingSamples.empty() || pendingSamples.back().Timestamp < trackedFrame.GetTimestamp())
+    {
+      PlusIgtlClientInfo::TrackingDataSample sample;
+      sample.Timestamp = trackedFrame.GetTimestamp();
+      for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
+      {
+        igsioTransformName transformName = (*transformNameIterator);
+        ToolStatus status(TOOL_INVALID);
+        vtkNew<vtkMatrix4x4> mat;
+        if (transformRepository.GetTransform(transformName, mat.GetPointer(), &status) != PLUS_SUCCESS)
+        {
+          continue;
+        }
+        if (status != TOOL_OK && packValidTransformsOnly)
+        {
+          LOG_TRACE("Attempted to send invalid transform over IGT Link when server has prevented sending.");
+          continue;
+        }
+        PlusIgtlClientInfo::TrackingDataSampleElement element;
+        element.TransformName = transformName.GetTransformName();
+        element.Status = status;
+        vtkPlusIgtlMessageCommon::GetIgtlMatrix(element.Matrix, &transformRepository, transformName);
+        sample.Elements.push_back(element);
+      }
+      pendingSamples.push_back(sample);
+    }
+
+    if (!resolutionTimeElapsed && pendingSamples.size() < MAX_NUMBER_OF_COALESCED_TDATA_SAMPLES)
+    {
+      return 0;
+    }
+
+    igtl::TrackingDataMessage::Pointer trackingDataMessage = dynamic_cast<igtl::TrackingDataMessage*>(igtlMessage->Clone().GetPointer());
+    vtkPlusIgtlMessageCommon::PackTrackingDataMessage(trackingDataMessage, pendingSamples);
+    igtlMessages.push_back(trackingDataMessage.GetPointer());
+    PLUS_METRIC_COUNTER_ADD("plus_server_tdata_coalesced_samples_total", "", pendingSamples.size());
+    pendingSamples.clear();
+    return 0;
+  }
+
+  if (resolutionTimeElapsed)
   {
     std::vector<igsioTransformName> names;
 
@@ -421,6 +571,24 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
       continue;
     }
 
+    igsioTrackedFrame* imageFrame = &trackedFrame;
+    if (imageStream.Shaping.IsEnabled())
+    {
+      vtkSmartPointer<vtkMatrix4x4> shapedImageToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      if (this->ImageStreamShaper->GetShapedFrame(imageStream.Shaping, trackedFrame, imageFrame, shapedImageToImageMatrix) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to create " << messageType << " message - unable to shape image");
+        numberOfErrors++;
+        continue;
+      }
+      if (imageFrame == NULL)
+      {
+        // Frame is skipped to limit the frame rate
+        continue;
+      }
+      vtkMatrix4x4::Multiply4x4(matrix, shapedImageToImageMatrix, matrix);
+    }
+
     std::string deviceName = imageTransformName.From() + std::string("_") + imageTransformName.To();
 
     igtl::ImageMessage::Pointer imageMessage = dynamic_cast<igtl::ImageMessage*>(igtlMessage->Clone().GetPointer());
@@ -446,7 +614,7 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
       imageMessage->SetMetaDataElement(*stringNameIterator, IANA_TYPE_US_ASCII, trackedFrame.GetFrameField(*stringNameIterator));
     }
 
-    if (vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, trackedFrame, *matrix, imageStream.FrameConverter) != PLUS_SUCCESS)
+    if (vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, *imageFrame, *matrix, imageStream.FrameConverter) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to create " << messageType << " message - unable to pack image message");
       numberOfErrors++;
@@ -478,50 +646,44 @@ int vtkPlusIgtlMessageFactory::PackVideoMessage(const PlusIgtlClientInfo& client
     }
 
     std::string deviceName = imageTransformName.From() + std::string("_") + imageTransformName.To();
-
-    igtl::VideoMessage::Pointer videoMessage = dynamic_cast<igtl::VideoMessage*>(igtlMessage->Clone().GetPointer());
     if (trackedFrame.IsFrameFieldDefined(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME))
     {
       // Allow overriding of device name with something human readable
       // The transform name is passed in the metadata
       deviceName = trackedFrame.GetFrameField(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME);
     }
-    videoMessage->SetDeviceName(deviceName.c_str());
 
-    // Send igsioTrackedFrame::CustomFrameFields as meta data in the image message.
-    std::vector<std::string> frameFields;
-    trackedFrame.GetFrameFieldNameList(frameFields);
-    for (std::vector<std::string>::const_iterator stringNameIterator = frameFields.begin(); stringNameIterator != frameFields.end(); ++stringNameIterator)
+    if (trackedFrame.GetImageData() == NULL || !trackedFrame.GetImageData()->IsImageValid())
     {
-      if (trackedFrame.GetFrameField(*stringNameIterator).empty())
+      LOG_WARNING("Unable to send " << messageType << " message - image data is NOT valid!");
+      numberOfErrors++;
+      continue;
+    }
+
+    igsioTrackedFrame* imageFrame = &trackedFrame;
+    if (videoStream.Shaping.IsEnabled())
+    {
+      vtkSmartPointer<vtkMatrix4x4> shapedImageToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      if (this->ImageStreamShaper->GetShapedFrame(videoStream.Shaping, trackedFrame, imageFrame, shapedImageToImageMatrix) != PLUS_SUCCESS)
       {
-        // No value is available, do not send anything
-        LOG_WARNING("No metadata value for: " << *stringNameIterator);
+        LOG_ERROR("Failed to create " << messageType << " message - unable to shape image");
+        numberOfErrors++;
         continue;
       }
-      videoMessage->SetMetaDataElement(*stringNameIterator, IANA_TYPE_US_ASCII, trackedFrame.GetFrameField(*stringNameIterator));
-    }
-    videoMessage = igtl::VideoMessage::New();
-    videoMessage->SetDeviceName(deviceName.c_str());
-    std::map<std::string, std::string> parameters;
-    parameters["losslessEncoding"] = videoStream.EncodeVideoParameters.Lossless ? "1" : "0";
-    if (!videoStream.EncodeVideoParameters.Lossless)
-    {
-      parameters["rateControl"] = videoStream.EncodeVideoParameters.RateControl;
-      parameters["minimumKeyFrameDistance"] = igsioCommon::ToString(videoStream.EncodeVideoParameters.MinKeyframeDistance);
-      parameters["maximumKeyFrameDistance"] = igsioCommon::ToString(videoStream.EncodeVideoParameters.MaxKeyframeDistance);
-      parameters["encodingSpeed"] = igsioCommon::ToString(videoStream.EncodeVideoParameters.Speed);
-      parameters["bitRate"] = igsioCommon::ToString(videoStream.EncodeVideoParameters.TargetBitrate);
-      parameters["deadlineMode"] = videoStream.EncodeVideoParameters.DeadlineMode;
+      if (imageFrame != NULL)
+      {
+        vtkMatrix4x4::Multiply4x4(matrix, shapedImageToImageMatrix, matrix);
+      }
     }
 
-    if (vtkPlusIgtlMessageCommon::PackVideoMessage(videoMessage, trackedFrame, *matrix, videoStream.FrameConverter, videoStream.EncodeVideoParameters.FourCC, parameters) != PLUS_SUCCESS)
+    // Encoding is performed asynchronously by the encoder that is shared by all clients that requested the same stream.
+    // Messages that are already encoded are sent now, the current frame is sent with one of the next frames.
+    std::string encoderKey = PlusIgtlVideoEncoderPool::GetEncoderKey(videoStream, igtlMessage->GetHeaderVersion());
+    if (imageFrame != NULL)
     {
-      LOG_ERROR("Failed to create " << messageType << " message - unable to pack image message");
-      numberOfErrors++;
-      continue;
+      this->VideoEncoderPool->SubmitFrame(encoderKey, clientId, videoStream.EncodeVideoParameters, igtlMessage, deviceName, *imageFrame, *matrix);
     }
-    igtlMessages.push_back(videoMessage.GetPointer());
+    this->VideoEncoderPool->GetEncodedMessages(encoderKey, clientId, igtlMessages);
   }
   return numberOfErrors;
 }
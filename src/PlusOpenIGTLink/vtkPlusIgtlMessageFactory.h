@@ -20,6 +20,9 @@
 // PlusLib includes
 #include "PlusIgtlClientInfo.h"
 
+class PlusIgtlImageStreamShaper;
+class PlusIgtlSharedMemoryRing;
+class PlusIgtlVideoEncoderPool;
 class vtkXMLDataElement;
 //class igsioTrackedFrame; 
 //class vtkIGSIOTransformRepository;
@@ -72,20 +75,65 @@ public:
   Generate and pack IGTL messages from tracked frame
   \param clientId Id of the client that messages will be sent to
   \param packValidTransformsOnly Control whether or not to pack transform messages if they contain invalid transforms
-  \param clientInfo Specifies list of message types and names to generate for a client.
+  \param clientInfo Specifies list of message types and names to generate for a client. The TDATA state of the client
+    (pending coalesced samples) is updated.
   \param igtMessages Output list for the generated IGTL messages
   \param trackedFrame Input tracked frame data used for IGTL message generation
   \param transformRepository Transform repository used for computing the selected transforms
   */
-  PlusStatus PackMessages(int clientId, const PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtMessages, igsioTrackedFrame& trackedFrame,
+  PlusStatus PackMessages(int clientId, PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtMessages, igsioTrackedFrame& trackedFrame,
                           bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository = NULL);
 
+  /*!
+  If enabled then image pixel data is not copied into the buffer of the messages that support it (TRACKEDFRAME),
+  the caller has to send these messages using the segments returned by igtl::PlusTrackedFrameMessage::GetSendSegments().
+  Disabled by default.
+  */
+  vtkSetMacro(ImageDataGatherEnabled, bool);
+  vtkGetMacro(ImageDataGatherEnabled, bool);
+  vtkBooleanMacro(ImageDataGatherEnabled, bool);
+
+  /*!
+  Name prefix of the shared memory ring that is used for transferring the image data of TRACKEDFRAME messages to clients
+  that requested shared memory transport (see PlusIgtlClientInfo::GetSharedMemoryTransport()). The ring is created
+  when the first image is sent through it, and recreated with a new name if a larger image has to be sent.
+  If empty (default) then image data is always included in the messages.
+  */
+  vtkSetStdStringMacro(SharedMemoryRingNamePrefix);
+  vtkGetStdStringMacro(SharedMemoryRingNamePrefix);
+
+  /*! Release the resources (such as video encoders) that were allocated for the specified client. Call this when the client disconnects. */
+  void RemoveClient(int clientId);
+
 protected:
   vtkPlusIgtlMessageFactory();
   virtual ~vtkPlusIgtlMessageFactory();
 
   igtl::MessageFactory::Pointer IgtlFactory;
 
+  bool ImageDataGatherEnabled;
+
+  /*!
+  Write the image of the tracked frame into the shared memory ring (only once, if it is packed for multiple clients).
+  Creates or recreates the ring if needed.
+  */
+  PlusStatus WriteImageToSharedMemory(igsioTrackedFrame& trackedFrame, igtl_uint64& sequenceNumber);
+
+  std::string SharedMemoryRingNamePrefix;
+  PlusIgtlSharedMemoryRing* SharedMemoryRing;
+  int SharedMemoryRingGeneration;
+  /*! Timestamp of the last frame that was written into the shared memory ring, negative if no frame is written yet */
+  double SharedMemoryFrameTimestamp;
+  igtl_uint64 SharedMemorySequenceNumber;
+
+  /*! Clipped, resampled, etc. images, shared between all clients that request the same shaping of image and video streams */
+  PlusIgtlImageStreamShaper* ImageStreamShaper;
+
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+  /*! Video encoders, shared between all clients that request the same video stream with the same encoding parameters */
+  PlusIgtlVideoEncoderPool* VideoEncoderPool;
+#endif
+
 protected:
   int PackImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType,
                        igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
@@ -95,7 +143,7 @@ protected:
 #endif
   int PackTransformMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly,
                            igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
-  int PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly,
+  int PackTrackingDataMessage(PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly,
                               igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
   int PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage,
                           igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
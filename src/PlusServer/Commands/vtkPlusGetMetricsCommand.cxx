@@ -0,0 +1,116 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMetrics.h"
+#include "vtkPlusGetMetricsCommand.h"
+
+vtkStandardNewMacro(vtkPlusGetMetricsCommand);
+
+namespace
+{
+  static const std::string GET_METRICS_CMD = "GetMetrics";
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetMetricsCommand::vtkPlusGetMetricsCommand()
+  : Reset(false)
+{
+  // It handles only one command, set its name by default
+  this->SetName(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetMetricsCommand::~vtkPlusGetMetricsCommand()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetMetricsCommand::SetNameToGetMetrics()
+{
+  this->SetName(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetMetricsCommand::GetCommandNames(std::list<std::string>& cmdNames)
+{
+  cmdNames.clear();
+  cmdNames.push_back(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusGetMetricsCommand::GetDescription(const std::string& commandName)
+{
+  std::string desc;
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_METRICS_CMD))
+  {
+    desc += GET_METRICS_CMD;
+    desc += ": Get runtime performance metrics (counters, gauges, latency histograms) in Prometheus text format. Attributes: Enable=TRUE/FALSE, Reset=TRUE/FALSE.";
+  }
+  return desc;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetMetricsCommand::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Enable: " << (this->Enable.empty() ? "(unchanged)" : this->Enable) << std::endl;
+  os << indent << "Reset: " << (this->Reset ? "TRUE" : "FALSE") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetMetricsCommand::ReadConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(Enable, aConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(Reset, aConfig);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetMetricsCommand::WriteConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::WriteConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(Enable, aConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(Reset, aConfig);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetMetricsCommand::Execute()
+{
+  LOG_DEBUG("vtkPlusGetMetricsCommand::Execute: " << (!this->Name.empty() ? this->Name : "(undefined)"));
+
+  if (!this->Enable.empty())
+  {
+    if (STRCASECMP(this->Enable.c_str(), "TRUE") == 0)
+    {
+      PlusMetricsRegistry::SetEnabled(true);
+    }
+    else if (STRCASECMP(this->Enable.c_str(), "FALSE") == 0)
+    {
+      PlusMetricsRegistry::SetEnabled(false);
+    }
+    else
+    {
+      this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "Invalid Enable attribute value: " + this->Enable + ". Valid values: TRUE, FALSE.");
+      return PLUS_FAIL;
+    }
+  }
+
+  std::string metricsText = PlusMetricsRegistry::GetInstance()->GetPrometheusText(this->Reset);
+
+  igtl::MessageBase::MetaDataMap metadata;
+  metadata["MetricsEnabled"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, PlusMetricsRegistry::IsEnabled() ? "TRUE" : "FALSE");
+  this->QueueCommandResponse(PLUS_SUCCESS, metricsText, "", &metadata);
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,71 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusGetMetricsCommand_h
+#define __vtkPlusGetMetricsCommand_h
+
+#include "vtkPlusServerExport.h"
+
+#include "vtkPlusCommand.h"
+
+/*!
+  \class vtkPlusGetMetricsCommand
+  \brief This command returns the runtime performance metrics of the server process in Prometheus text format.
+  \ingroup PlusLibPlusServer
+
+  Optional attributes:
+  - Enable: TRUE/FALSE to switch metrics collection on or off (unchanged if not specified)
+  - Reset: if TRUE then all metrics are reset to zero after they are reported
+ */
+class vtkPlusServerExport vtkPlusGetMetricsCommand : public vtkPlusCommand
+{
+public:
+
+  static vtkPlusGetMetricsCommand* New();
+  vtkTypeMacro(vtkPlusGetMetricsCommand, vtkPlusCommand);
+  virtual void PrintSelf(ostream& os, vtkIndent indent);
+  virtual vtkPlusCommand* Clone() { return New(); }
+
+  /*! Executes the command  */
+  virtual PlusStatus Execute();
+
+  /*! Read command parameters from XML */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Write command parameters to XML */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Get all the command names that this class can execute */
+  virtual void GetCommandNames(std::list<std::string>& cmdNames);
+
+  /*! Gets the description for the specified command name. */
+  virtual std::string GetDescription(const std::string& commandName);
+
+  /*! Requested metrics collection state: empty (no change), TRUE, or FALSE */
+  vtkGetStdStringMacro(Enable);
+  vtkSetStdStringMacro(Enable);
+
+  /*! If true then all metrics are reset after they are reported */
+  vtkSetMacro(Reset, bool);
+  vtkGetMacro(Reset, bool);
+  vtkBooleanMacro(Reset, bool);
+
+  void SetNameToGetMetrics();
+
+protected:
+  vtkPlusGetMetricsCommand();
+  virtual ~vtkPlusGetMetricsCommand();
+
+private:
+  std::string Enable;
+  bool Reset;
+
+  vtkPlusGetMetricsCommand(const vtkPlusGetMetricsCommand&);
+  void operator=(const vtkPlusGetMetricsCommand&);
+};
+
+
+#endif
@@ -6,15 +6,12 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusModelAssetCache.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusGetPolydataCommand.h"
 
 // VTK includes
-#include <vtkOBJReader.h>
-#include <vtkPLYReader.h>
 #include <vtkPolyData.h>
-#include <vtkPolyDataReader.h>
-#include <vtkSTLReader.h>
 
 namespace
 {
@@ -26,6 +23,7 @@ vtkStandardNewMacro(vtkPlusGetPolydataCommand);
 //----------------------------------------------------------------------------
 vtkPlusGetPolydataCommand::vtkPlusGetPolydataCommand()
   : PolydataId("")
+  , TargetReduction(0.0)
 {
 
 }
@@ -59,6 +57,17 @@ PlusStatus vtkPlusGetPolydataCommand::ReadConfiguration(vtkXMLDataElement* aConf
     return PLUS_FAIL;
   }
 
+  // Optional level of detail
+  double targetReduction = 0.0;
+  if (aConfig->GetScalarAttribute("TargetReduction", targetReduction))
+  {
+    this->SetTargetReduction(targetReduction);
+  }
+  else if (this->MetaData.find("TargetReduction") != this->MetaData.end())
+  {
+    this->SetTargetReduction(std::atof(this->MetaData["TargetReduction"].second.c_str()));
+  }
+
   return Superclass::ReadConfiguration(aConfig);
 }
 
@@ -71,6 +80,10 @@ PlusStatus vtkPlusGetPolydataCommand::WriteConfiguration(vtkXMLDataElement* aCon
     return PLUS_FAIL;
   }
   aConfig->SetAttribute("FileName", this->GetPolydataId().c_str());
+  if (this->TargetReduction > 0.0)
+  {
+    aConfig->SetDoubleAttribute("TargetReduction", this->TargetReduction);
+  }
 
   return Superclass::WriteConfiguration(aConfig);
 }
@@ -122,81 +135,36 @@ PlusStatus vtkPlusGetPolydataCommand::Execute()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusGetPolydataCommand::ExecutePolydataReply(std::string& outErrorString)
 {
-  bool loaded(false);
-
-  vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
-
   std::string finalFileName(this->PolydataId);
-  if (vtksys::SystemTools::FileExists(this->PolydataId))
+  if (!vtksys::SystemTools::FileExists(this->PolydataId))
   {
-    reader->SetFileName(this->PolydataId.c_str());
-  }
-  else
-  {
-    if (vtkPlusConfig::GetInstance()->FindModelPath(this->PolydataId, finalFileName) == PLUS_SUCCESS)
-    {
-      reader->SetFileName(finalFileName.c_str());
-    }
-    else
+    if (vtkPlusConfig::GetInstance()->FindModelPath(this->PolydataId, finalFileName) != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to locate file with name " << this->PolydataId);
       this->QueueCommandResponse(PLUS_FAIL, "Command failed.", std::string("Unable to locate file with name ") + this->PolydataId);
       return PLUS_FAIL;
     }
   }
+  finalFileName = vtksys::SystemTools::CollapseFullPath(finalFileName);
 
-  vtkSmartPointer<vtkAbstractPolyDataReader> polyReader = vtkSmartPointer<vtkSTLReader>::New();
-  if (!reader->IsFilePolyData())
+  // The model is read from the file only if it is not in the cache yet or the file has changed since it was read
+  vtkSmartPointer<vtkPolyData> polyData = PlusModelAssetCache::GetInstance()->GetPolyData(finalFileName, this->TargetReduction);
+  if (polyData == nullptr)
   {
-    reader = nullptr; // This flags later code to recognize that it's not a .vtk file
-    polyReader->SetFileName(finalFileName.c_str());
-    polyReader->Update();
-    if (polyReader->GetOutput() == nullptr)
-    {
-      polyReader = vtkSmartPointer<vtkOBJReader>::New();
-      polyReader->SetFileName(finalFileName.c_str());
-      polyReader->Update();
-      if (polyReader->GetOutput() == nullptr)
-      {
-        polyReader = vtkSmartPointer<vtkPLYReader>::New();
-        polyReader->SetFileName(finalFileName.c_str());
-        polyReader->Update();
-        if (polyReader->GetOutput() == nullptr)
-        {
-          LOG_ERROR("Unrecognized polydata file type: " << this->PolydataId);
-          this->QueueCommandResponse(PLUS_FAIL, "Command failed.", std::string("Unrecognized polydata file type: ") + this->PolydataId);
-          return PLUS_FAIL;
-        }
-      }
-    }
-  }
-  else
-  {
-    reader->Update();
-  }
-
-  auto errorCode = (reader == nullptr ? polyReader->GetErrorCode() : reader->GetErrorCode());
-  vtkPolyData* polyData = (reader == nullptr ? polyReader->GetOutput() : reader->GetOutput());
-  if (errorCode != 0)
-  {
-    std::stringstream ss;
-    ss << "Reader threw error: " << errorCode;
-    this->QueueCommandResponse(PLUS_FAIL, "PlusServer", ss.str());
-  }
-  else if (polyData != nullptr)
-  {
-    vtkSmartPointer<vtkPlusCommandPolydataResponse> response = vtkSmartPointer<vtkPlusCommandPolydataResponse>::New();
-    response->SetClientId(this->ClientId);
-    response->SetPolyDataName(this->GetPolydataId());
-    response->SetPolyData(polyData);
-    response->SetRespondWithCommandMessage(this->RespondWithCommandMessage);
-    this->CommandResponseQueue.push_back(response);
-
-    std::string name = vtksys::SystemTools::GetFilenameName(this->PolydataId);
-    this->QueueCommandResponse(PLUS_SUCCESS, name, "Command succeeded.");
-    return PLUS_SUCCESS;
+    this->QueueCommandResponse(PLUS_FAIL, "Unable to load polydata.", std::string("Unrecognized polydata file type or invalid file: ") + this->PolydataId);
+    return PLUS_FAIL;
   }
 
-  this->QueueCommandResponse(PLUS_FAIL, "Unable to load polydata.");
-  return PLUS_FAIL;
-}
\ No newline at end of file
+  vtkSmartPointer<vtkPlusCommandPolydataResponse> response = vtkSmartPointer<vtkPlusCommandPolydataResponse>::New();
+  response->SetClientId(this->ClientId);
+  response->SetPolyDataName(this->GetPolydataId());
+  response->SetPolyData(polyData);
+  response->SetModelFilePath(finalFileName);
+  response->SetTargetReduction(this->TargetReduction);
+  response->SetRespondWithCommandMessage(this->RespondWithCommandMessage);
+  this->CommandResponseQueue.push_back(response);
+
+  std::string name = vtksys::SystemTools::GetFilenameName(this->PolydataId);
+  this->QueueCommandResponse(PLUS_SUCCESS, name, "Command succeeded.");
+  return PLUS_SUCCESS;
+}
@@ -13,6 +13,10 @@
 /*!
   \class vtkPlusGetPolydataCommand
   \brief This command is used to answer the OpenIGTLink message GET_POLYDATA. GET_POLYDATA returns the requested polydata.
+
+  Models are read through PlusModelAssetCache, therefore repeated requests for the same file do not read the file again.
+  If TargetReduction is specified (as attribute or metadata, between 0 and 1) then a decimated variant of the model is returned
+  (for example, 0.9 removes approximately 90% of the triangles), which is useful for remote clients with limited bandwidth.
   \ingroup PlusLibPlusServer
  */
 class vtkPlusServerExport vtkPlusGetPolydataCommand : public vtkPlusCommand
@@ -45,6 +49,10 @@ public:
   vtkGetStdStringMacro(PolydataId);
   vtkSetStdStringMacro(PolydataId);
 
+  /*! Fraction of triangles to remove from the returned model (0 = original model) */
+  vtkGetMacro(TargetReduction, double);
+  vtkSetClampMacro(TargetReduction, double, 0.0, 0.99);
+
 protected:
   /*! Prepare sending image as a response */
   PlusStatus ExecutePolydataReply(std::string& outErrorString);
@@ -54,6 +62,7 @@ protected:
 
 protected:
   std::string PolydataId;
+  double TargetReduction;
 
 private:
   vtkPlusGetPolydataCommand(const vtkPlusGetPolydataCommand&);
@@ -0,0 +1,1002 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+\file PlusServerBenchmark.cxx
+\brief End-to-end performance benchmark of the Plus acquisition and broadcasting pipeline.
+
+A synthetic video device (configurable frame size, pixel type and rate) and a synthetic tracker
+(configurable tool count and rate) feed a virtual mixer, an optional image processor and an optional
+virtual capture device. The mixed stream is broadcast by a vtkPlusOpenIGTLinkServer to a number of
+loopback OpenIGTLink clients. Latency is measured at each stage from the acquisition timestamp of the
+item, and the results (latency percentiles, frame rates, CPU usage, memory usage) are written as JSON.
+
+Clients fully unpack TRACKEDFRAME messages (including the image data). With --shared-memory the clients
+request the image data through the shared memory ring of the server, which allows comparing the socket
+and shared memory transports of the same stream. With --scatter-gather-send the server sends the image data
+of TRACKEDFRAME messages directly from the frame memory (see ScatterGatherSendEnabled of the server).
+
+With --datagram-port the server also broadcasts the tool transforms in UDP datagrams (see the DatagramBroadcast
+element of the server configuration), which are received by a datagram subscriber. The datagram loss and the
+end-to-end latency of the datagrams are reported, which allows comparing them to the TCP clients.
+The benchmark fails if the datagram loss exceeds --max-datagram-loss-percent.
+
+All components run in the same process, so acquisition and receive times are read from the same clock.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlClientInfo.h"
+#include "PlusIgtlDatagramChannel.h"
+#include "PlusIgtlSharedMemoryRing.h"
+#include "igsioCommon.h"
+#include "igsioTrackedFrame.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+#include "vtkPlusDeviceFactory.h"
+#include "vtkPlusIgtlMessageCommon.h"
+#include "vtkPlusIgtlMessageFactory.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+#include "vtkPlusVirtualCapture.h"
+#include "vtkIGSIOTransformRepository.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// IGTL includes
+#include <igtlClientSocket.h>
+#include <igtlMessageHeader.h>
+#include <igtlPlusClientInfoMessage.h>
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// OS includes
+#ifdef _WIN32
+  #include <windows.h>
+  #include <psapi.h>
+#else
+  #include <sys/resource.h>
+  #include <sys/time.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Collects latency samples and event counters of the benchmark stages */
+  class BenchmarkStatistics
+  {
+  public:
+    BenchmarkStatistics() : Enabled(false) {}
+
+    void AddSample(const std::string& stageName, double valueSec)
+    {
+      if (!this->Enabled)
+      {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Samples[stageName].push_back(valueSec);
+    }
+
+    void AddCount(const std::string& counterName, double value)
+    {
+      if (!this->Enabled)
+      {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Counters[counterName] += value;
+    }
+
+    void SetEnabled(bool enabled) { this->Enabled = enabled; }
+
+    double GetCount(const std::string& counterName)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      std::map<std::string, double>::const_iterator it = this->Counters.find(counterName);
+      return (it != this->Counters.end() ? it->second : 0);
+    }
+
+    /*! Write per-stage latency percentiles (in milliseconds) and rates (per second) as JSON members */
+    void WriteJson(std::ostream& os, double measurementTimeSec)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      os << "  \"stages\": {";
+      bool first = true;
+      for (std::map<std::string, std::vector<double> >::iterator it = this->Samples.begin(); it != this->Samples.end(); ++it)
+      {
+        std::vector<double>& samples = it->second;
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (std::vector<double>::const_iterator sampleIt = samples.begin(); sampleIt != samples.end(); ++sampleIt)
+        {
+          sum += *sampleIt;
+        }
+        os << (first ? "" : ",") << "\n    \"" << it->first << "\": {"
+           << "\"count\": " << samples.size()
+           << ", \"ratePerSec\": " << (measurementTimeSec > 0 ? samples.size() / measurementTimeSec : 0)
+           << ", \"meanMs\": " << (samples.empty() ? 0 : 1000.0 * sum / samples.size())
+           << ", \"minMs\": " << 1000.0 * GetPercentile(samples, 0.0)
+           << ", \"p50Ms\": " << 1000.0 * GetPercentile(samples, 0.50)
+           << ", \"p90Ms\": " << 1000.0 * GetPercentile(samples, 0.90)
+           << ", \"p99Ms\": " << 1000.0 * GetPercentile(samples, 0.99)
+           << ", \"p999Ms\": " << 1000.0 * GetPercentile(samples, 0.999)
+           << ", \"maxMs\": " << 1000.0 * GetPercentile(samples, 1.0)
+           << "}";
+        first = false;
+      }
+      os << "\n  },\n";
+
+      os << "  \"counters\": {";
+      first = true;
+      for (std::map<std::string, double>::const_iterator it = this->Counters.begin(); it != this->Counters.end(); ++it)
+      {
+        os << (first ? "" : ",") << "\n    \"" << it->first << "\": {"
+           << "\"total\": " << it->second
+           << ", \"ratePerSec\": " << (measurementTimeSec > 0 ? it->second / measurementTimeSec : 0)
+           << "}";
+        first = false;
+      }
+      os << "\n  },\n";
+    }
+
+  protected:
+    /*! Nearest-rank percentile of a sorted sample vector */
+    static double GetPercentile(const std::vector<double>& sortedSamples, double fraction)
+    {
+      if (sortedSamples.empty())
+      {
+        return 0;
+      }
+      size_t index = static_cast<size_t>(fraction * (sortedSamples.size() - 1) + 0.5);
+      return sortedSamples[std::min(index, sortedSamples.size() - 1)];
+    }
+
+    std::atomic<bool> Enabled;
+    std::mutex Mutex;
+    std::map<std::string, std::vector<double> > Samples;
+    std::map<std::string, double> Counters;
+  };
+
+  BenchmarkStatistics Statistics;
+
+  //----------------------------------------------------------------------------
+  /*! Process CPU time (user + system) in seconds */
+  double GetProcessCpuTimeSec()
+  {
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+      return 0;
+    }
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return (kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+      return 0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Current and peak resident memory of the process in bytes */
+  void GetProcessMemoryUsage(double& currentBytes, double& peakBytes)
+  {
+    currentBytes = 0;
+    peakBytes = 0;
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+      currentBytes = static_cast<double>(counters.WorkingSetSize);
+      peakBytes = static_cast<double>(counters.PeakWorkingSetSize);
+    }
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef __APPLE__
+      peakBytes = static_cast<double>(usage.ru_maxrss);
+#else
+      peakBytes = static_cast<double>(usage.ru_maxrss) * 1024.0;
+#endif
+    }
+    std::ifstream statm("/proc/self/statm");
+    double totalPages(0), residentPages(0);
+    if (statm >> totalPages >> residentPages)
+    {
+      currentBytes = residentPages * sysconf(_SC_PAGESIZE);
+    }
+    else
+    {
+      currentBytes = peakBytes;
+    }
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Parse a pixel type name (uchar, char, ushort, short, float) */
+  PlusStatus GetPixelTypeFromString(const std::string& name, igsioCommon::VTKScalarPixelType& pixelType, unsigned int& bytesPerScalar)
+  {
+    if (STRCASECMP(name.c_str(), "uchar") == 0)
+    {
+      pixelType = VTK_UNSIGNED_CHAR;
+      bytesPerScalar = 1;
+    }
+    else if (STRCASECMP(name.c_str(), "char") == 0)
+    {
+      pixelType = VTK_CHAR;
+      bytesPerScalar = 1;
+    }
+    else if (STRCASECMP(name.c_str(), "ushort") == 0)
+    {
+      pixelType = VTK_UNSIGNED_SHORT;
+      bytesPerScalar = 2;
+    }
+    else if (STRCASECMP(name.c_str(), "short") == 0)
+    {
+      pixelType = VTK_SHORT;
+      bytesPerScalar = 2;
+    }
+    else if (STRCASECMP(name.c_str(), "float") == 0)
+    {
+      pixelType = VTK_FLOAT;
+      bytesPerScalar = 4;
+    }
+    else
+    {
+      LOG_ERROR("Unsupported pixel type: " << name << ". Valid values: uchar, char, ushort, short, float.");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+/*!
+\class vtkPlusBenchmarkVideoSource
+\brief Synthetic video device that generates frames of a configurable size and pixel type at the acquisition rate
+*/
+class vtkPlusBenchmarkVideoSource : public vtkPlusDevice
+{
+public:
+  static vtkPlusBenchmarkVideoSource* New();
+  vtkTypeMacro(vtkPlusBenchmarkVideoSource, vtkPlusDevice);
+
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+  {
+    XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+    deviceConfig->GetScalarAttribute("FrameWidth", this->FrameWidth);
+    deviceConfig->GetScalarAttribute("FrameHeight", this->FrameHeight);
+    deviceConfig->GetScalarAttribute("NumberOfScalarComponents", this->NumberOfScalarComponents);
+    const char* pixelTypeName = deviceConfig->GetAttribute("PixelType");
+    if (pixelTypeName != NULL && GetPixelTypeFromString(pixelTypeName, this->PixelType, this->BytesPerScalar) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  virtual bool IsTracker() const { return false; }
+
+protected:
+  vtkPlusBenchmarkVideoSource()
+    : FrameWidth(640)
+    , FrameHeight(480)
+    , NumberOfScalarComponents(1)
+    , PixelType(VTK_UNSIGNED_CHAR)
+    , BytesPerScalar(1)
+  {
+    this->StartThreadForInternalUpdates = true;
+    this->AcquisitionRate = 30;
+  }
+
+  virtual PlusStatus InternalConnect()
+  {
+    FrameSizeType frameSize = { static_cast<unsigned int>(this->FrameWidth), static_cast<unsigned int>(this->FrameHeight), 1 };
+    std::vector<vtkPlusDataSource*> videoSources = this->GetVideoSources();
+    for (std::vector<vtkPlusDataSource*>::iterator it = videoSources.begin(); it != videoSources.end(); ++it)
+    {
+      (*it)->SetInputFrameSize(frameSize);
+      (*it)->SetPixelType(this->PixelType);
+      (*it)->SetNumberOfScalarComponents(this->NumberOfScalarComponents);
+      (*it)->SetImageType(this->NumberOfScalarComponents == 3 ? US_IMG_RGB_COLOR : US_IMG_BRIGHTNESS);
+    }
+    this->FrameBuffer.assign(static_cast<size_t>(this->FrameWidth) * this->FrameHeight * this->NumberOfScalarComponents * this->BytesPerScalar, 0);
+    this->FrameNumber = 0;
+    return PLUS_SUCCESS;
+  }
+
+  virtual PlusStatus InternalUpdate()
+  {
+    if (!this->IsRecording())
+    {
+      return PLUS_SUCCESS;
+    }
+    const double acquisitionTime = vtkIGSIOAccurateTimer::GetSystemTime();
+
+    // Modify one row per frame so that the content changes without the cost of regenerating the whole image
+    const size_t rowBytes = static_cast<size_t>(this->FrameWidth) * this->NumberOfScalarComponents * this->BytesPerScalar;
+    const size_t row = this->FrameNumber % this->FrameHeight;
+    std::fill(this->FrameBuffer.begin() + row * rowBytes, this->FrameBuffer.begin() + (row + 1) * rowBytes, static_cast<unsigned char>(this->FrameNumber));
+
+    FrameSizeType frameSize = { static_cast<unsigned int>(this->FrameWidth), static_cast<unsigned int>(this->FrameHeight), 1 };
+    PlusStatus status = this->AddVideoItemToVideoSources(this->GetVideoSources(), &this->FrameBuffer[0], US_IMG_ORIENT_MF, frameSize,
+                        this->PixelType, this->NumberOfScalarComponents, this->NumberOfScalarComponents == 3 ? US_IMG_RGB_COLOR : US_IMG_BRIGHTNESS, 0,
+                        this->FrameNumber, acquisitionTime, acquisitionTime);
+    this->FrameNumber++;
+
+    Statistics.AddSample("videoAcquisition", vtkIGSIOAccurateTimer::GetSystemTime() - acquisitionTime);
+    Statistics.AddCount("videoFramesGenerated", 1);
+    Statistics.AddCount("videoBytesGenerated", static_cast<double>(this->FrameBuffer.size()));
+    return status;
+  }
+
+  int FrameWidth;
+  int FrameHeight;
+  unsigned int NumberOfScalarComponents;
+  igsioCommon::VTKScalarPixelType PixelType;
+  unsigned int BytesPerScalar;
+  std::vector<unsigned char> FrameBuffer;
+
+private:
+  vtkPlusBenchmarkVideoSource(const vtkPlusBenchmarkVideoSource&);   // Not implemented.
+  void operator=(const vtkPlusBenchmarkVideoSource&);   // Not implemented.
+};
+
+vtkStandardNewMacro(vtkPlusBenchmarkVideoSource);
+
+//----------------------------------------------------------------------------
+/*!
+\class vtkPlusBenchmarkTracker
+\brief Synthetic tracker that moves all of its tools along a simple trajectory at the acquisition rate
+*/
+class vtkPlusBenchmarkTracker : public vtkPlusDevice
+{
+public:
+  static vtkPlusBenchmarkTracker* New();
+  vtkTypeMacro(vtkPlusBenchmarkTracker, vtkPlusDevice);
+
+  virtual bool IsTracker() const { return true; }
+
+protected:
+  vtkPlusBenchmarkTracker()
+    : ToolMatrix(vtkSmartPointer<vtkMatrix4x4>::New())
+    , TrackerFrameNumber(0)
+  {
+    this->StartThreadForInternalUpdates = true;
+    this->AcquisitionRate = 100;
+  }
+
+  virtual PlusStatus InternalUpdate()
+  {
+    if (!this->IsRecording())
+    {
+      return PLUS_SUCCESS;
+    }
+    const double acquisitionTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    PlusStatus status = PLUS_SUCCESS;
+    int toolIndex = 0;
+    for (DataSourceContainerConstIterator it = this->GetToolIteratorBegin(); it != this->GetToolIteratorEnd(); ++it, ++toolIndex)
+    {
+      this->ToolMatrix->Identity();
+      this->ToolMatrix->SetElement(0, 3, toolIndex * 10.0);
+      this->ToolMatrix->SetElement(1, 3, (this->TrackerFrameNumber % 1000) * 0.1);
+      if (this->ToolTimeStampedUpdateWithoutFiltering(it->second->GetId(), this->ToolMatrix, TOOL_OK, acquisitionTime, acquisitionTime) != PLUS_SUCCESS)
+      {
+        status = PLUS_FAIL;
+      }
+    }
+    this->TrackerFrameNumber++;
+
+    Statistics.AddSample("trackerAcquisition", vtkIGSIOAccurateTimer::GetSystemTime() - acquisitionTime);
+    Statistics.AddCount("trackerSamplesGenerated", toolIndex);
+    return status;
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> ToolMatrix;
+  unsigned long TrackerFrameNumber;
+
+private:
+  vtkPlusBenchmarkTracker(const vtkPlusBenchmarkTracker&);   // Not implemented.
+  void operator=(const vtkPlusBenchmarkTracker&);   // Not implemented.
+};
+
+vtkStandardNewMacro(vtkPlusBenchmarkTracker);
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  struct BenchmarkParameters
+  {
+    int FrameWidth;
+    int FrameHeight;
+    std::string PixelType;
+    int NumberOfScalarComponents;
+    double VideoRate;
+    int NumberOfTools;
+    double TrackerRate;
+    int NumberOfClients;
+    int ListeningPort;
+    bool EnableCapture;
+    bool SharedMemoryTransport;
+    bool ScatterGatherSend;
+    std::string DatagramAddress;
+    int DatagramPort;
+    std::string ProcessorConfigFile;
+    std::vector<std::string> MessageTypes;
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Generate the device set configuration of the benchmark pipeline */
+  std::string CreateDeviceSetConfiguration(const BenchmarkParameters& params)
+  {
+    std::ostringstream xml;
+    xml << "<PlusConfiguration version=\"2.1\">\n"
+        << "  <DataCollection StartupDelaySec=\"0.5\">\n"
+        << "    <DeviceSet Name=\"PlusServerBenchmark\" Description=\"Synthetic video and tracker pipeline for benchmarking\" />\n";
+
+    xml << "    <Device Id=\"BenchmarkVideoDevice\" Type=\"BenchmarkVideo\" AcquisitionRate=\"" << params.VideoRate << "\""
+        << " FrameWidth=\"" << params.FrameWidth << "\" FrameHeight=\"" << params.FrameHeight << "\""
+        << " PixelType=\"" << params.PixelType << "\" NumberOfScalarComponents=\"" << params.NumberOfScalarComponents << "\">\n"
+        << "      <DataSources>\n"
+        << "        <DataSource Type=\"Video\" Id=\"Video\" PortUsImageOrientation=\"MF\" BufferSize=\"100\" />\n"
+        << "      </DataSources>\n"
+        << "      <OutputChannels>\n"
+        << "        <OutputChannel Id=\"VideoStream\" VideoDataSourceId=\"Video\" />\n"
+        << "      </OutputChannels>\n"
+        << "    </Device>\n";
+
+    xml << "    <Device Id=\"BenchmarkTrackerDevice\" Type=\"BenchmarkTracker\" AcquisitionRate=\"" << params.TrackerRate << "\" ToolReferenceFrame=\"Tracker\">\n"
+        << "      <DataSources>\n";
+    for (int i = 0; i < params.NumberOfTools; ++i)
+    {
+      xml << "        <DataSource Type=\"Tool\" Id=\"Tool" << i << "\" PortName=\"" << i << "\" BufferSize=\"500\" />\n";
+    }
+    xml << "      </DataSources>\n"
+        << "      <OutputChannels>\n"
+        << "        <OutputChannel Id=\"TrackerStream\">\n";
+    for (int i = 0; i < params.NumberOfTools; ++i)
+    {
+      xml << "          <DataSource Id=\"Tool" << i << "\" />\n";
+    }
+    xml << "        </OutputChannel>\n"
+        << "      </OutputChannels>\n"
+        << "    </Device>\n";
+
+    std::string mixerVideoInput = "VideoStream";
+    if (!params.ProcessorConfigFile.empty())
+    {
+      vtkSmartPointer<vtkXMLDataElement> processorElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromFile(params.ProcessorConfigFile.c_str()));
+      if (processorElement == NULL)
+      {
+        LOG_ERROR("Failed to read image processor configuration from file: " << params.ProcessorConfigFile);
+        return "";
+      }
+      std::ostringstream processorXml;
+      vtkXMLUtilities::FlattenElement(processorElement, processorXml);
+      xml << "    <Device Id=\"BenchmarkProcessorDevice\" Type=\"ImageProcessor\">\n"
+          << "      " << processorXml.str() << "\n"
+          << "      <InputChannels>\n"
+          << "        <InputChannel Id=\"VideoStream\" />\n"
+          << "      </InputChannels>\n"
+          << "      <OutputChannels>\n"
+          << "        <OutputChannel Id=\"ProcessedVideoStream\" />\n"
+          << "      </OutputChannels>\n"
+          << "    </Device>\n";
+      mixerVideoInput = "ProcessedVideoStream";
+    }
+
+    xml << "    <Device Id=\"BenchmarkMixerDevice\" Type=\"VirtualMixer\">\n"
+        << "      <InputChannels>\n"
+        << "        <InputChannel Id=\"TrackerStream\" />\n"
+        << "        <InputChannel Id=\"" << mixerVideoInput << "\" />\n"
+        << "      </InputChannels>\n"
+        << "      <OutputChannels>\n"
+        << "        <OutputChannel Id=\"TrackedVideoStream\" />\n"
+        << "      </OutputChannels>\n"
+        << "    </Device>\n";
+
+    if (params.EnableCapture)
+    {
+      xml << "    <Device Id=\"BenchmarkCaptureDevice\" Type=\"VirtualCapture\" BaseFilename=\"PlusServerBenchmark.igs.mha\" EnableFileCompression=\"FALSE\" EnableCapturingOnStart=\"TRUE\">\n"
+          << "      <InputChannels>\n"
+          << "        <InputChannel Id=\"TrackedVideoStream\" />\n"
+          << "      </InputChannels>\n"
+          << "    </Device>\n";
+    }
+    xml << "  </DataCollection>\n";
+
+    xml << "  <CoordinateDefinitions>\n"
+        << "    <Transform From=\"Image\" To=\"Tool0\" Matrix=\"1 0 0 0  0 1 0 0  0 0 1 0  0 0 0 1\" />\n"
+        << "  </CoordinateDefinitions>\n";
+
+    xml << "  <PlusOpenIGTLinkServer MaxNumberOfIgtlMessagesToSend=\"100\" MaxTimeSpentWithProcessingMs=\"50\" ListeningPort=\"" << params.ListeningPort << "\""
+        << " SendValidTransformsOnly=\"TRUE\" OutputChannelId=\"TrackedVideoStream\""
+        << " SharedMemoryTransportEnabled=\"" << (params.SharedMemoryTransport ? "TRUE" : "FALSE") << "\""
+        << " ScatterGatherSendEnabled=\"" << (params.ScatterGatherSend ? "TRUE" : "FALSE") << "\">\n"
+        << "    <DefaultClientInfo>\n"
+        << "      <MessageTypes>\n";
+    for (std::vector<std::string>::const_iterator it = params.MessageTypes.begin(); it != params.MessageTypes.end(); ++it)
+    {
+      xml << "        <Message Type=\"" << *it << "\" />\n";
+    }
+    xml << "      </MessageTypes>\n"
+        << "      <TransformNames>\n";
+    for (int i = 0; i < params.NumberOfTools; ++i)
+    {
+      xml << "        <Transform Name=\"Tool" << i << "ToTracker\" />\n";
+    }
+    xml << "      </TransformNames>\n"
+        << "      <ImageNames>\n"
+        << "        <Image Name=\"Image\" EmbeddedTransformToFrame=\"Tracker\" />\n"
+        << "      </ImageNames>\n"
+        << "    </DefaultClientInfo>\n";
+    if (params.DatagramPort > 0)
+    {
+      xml << "    <DatagramBroadcast Address=\"" << params.DatagramAddress << "\" Port=\"" << params.DatagramPort << "\">\n"
+          << "      <MessageTypes>\n"
+          << "        <Message Type=\"TRANSFORM\" />\n"
+          << "      </MessageTypes>\n"
+          << "      <TransformNames>\n";
+      for (int i = 0; i < params.NumberOfTools; ++i)
+      {
+        xml << "        <Transform Name=\"Tool" << i << "ToTracker\" />\n";
+      }
+      xml << "      </TransformNames>\n"
+          << "    </DatagramBroadcast>\n";
+    }
+    xml << "  </PlusOpenIGTLinkServer>\n"
+        << "</PlusConfiguration>\n";
+    return xml.str();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Polls the channels of the pipeline and records the delay between acquisition and availability of the newest item */
+  void ChannelProbeThread(const std::vector<std::pair<std::string, vtkPlusChannel*> >* channels, const std::atomic<bool>* active)
+  {
+    std::vector<double> lastTimestamps(channels->size(), 0);
+    while (*active)
+    {
+      for (size_t i = 0; i < channels->size(); ++i)
+      {
+        double mostRecentTimestamp(0);
+        if ((*channels)[i].second->GetMostRecentTimestamp(mostRecentTimestamp) != PLUS_SUCCESS || mostRecentTimestamp <= lastTimestamps[i])
+        {
+          continue;
+        }
+        Statistics.AddSample((*channels)[i].first, vtkIGSIOAccurateTimer::GetSystemTime() - mostRecentTimestamp);
+        lastTimestamps[i] = mostRecentTimestamp;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.001);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Request shared memory transport of the images (the other settings are the same as the default client info of the server) */
+  PlusStatus SendSharedMemoryClientInfo(igtl::ClientSocket* clientSocket, const BenchmarkParameters& params)
+  {
+    PlusIgtlClientInfo clientInfo;
+    clientInfo.IgtlMessageTypes = params.MessageTypes;
+    for (int i = 0; i < params.NumberOfTools; ++i)
+    {
+      std::ostringstream toolName;
+      toolName << "Tool" << i;
+      clientInfo.TransformNames.push_back(igsioTransformName(toolName.str(), "Tracker"));
+    }
+    PlusIgtlClientInfo::ImageStream imageStream;
+    imageStream.Name = "Image";
+    imageStream.EmbeddedTransformToFrame = "Tracker";
+    clientInfo.ImageStreams.push_back(imageStream);
+    clientInfo.SetClientHeaderVersion(IGTL_HEADER_VERSION_2);
+    clientInfo.SetSharedMemoryTransport(true);
+    clientInfo.SetTrackedFrameBinaryData(true);
+
+    igtl::PlusClientInfoMessage::Pointer clientInfoMsg = igtl::PlusClientInfoMessage::New();
+    clientInfoMsg->SetClientInfo(clientInfo);
+    clientInfoMsg->Pack();
+    return clientSocket->Send(clientInfoMsg->GetBufferPointer(), clientInfoMsg->GetBufferSize()) != 0 ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Receives messages from the server and records the end-to-end latency per message type */
+  void LoopbackClientThread(int clientIndex, const BenchmarkParameters* params, const std::atomic<bool>* active, std::atomic<int>* numberOfConnectedClients)
+  {
+    igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+    int errorCode = 0;
+    RETRY_UNTIL_TRUE((errorCode = clientSocket->ConnectToServer("127.0.0.1", params->ListeningPort)) == 0, 10, 0.5);
+    if (errorCode != 0)
+    {
+      LOG_ERROR("Loopback client " << clientIndex << " failed to connect to the server on port " << params->ListeningPort);
+      return;
+    }
+    clientSocket->SetReceiveTimeout(500);
+    if (params->SharedMemoryTransport && SendSharedMemoryClientInfo(clientSocket, *params) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Loopback client " << clientIndex << " failed to request shared memory transport");
+      return;
+    }
+    (*numberOfConnectedClients)++;
+
+    std::ostringstream clientName;
+    clientName << "client" << clientIndex;
+    PlusIgtlSharedMemoryRing sharedMemoryRing;
+    igsioTrackedFrame trackedFrame;
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
+    while (*active)
+    {
+      headerMsg->InitBuffer();
+      bool timeout(false);
+      igtlUint64 bytesReceived = clientSocket->Receive(headerMsg->GetBufferPointer(), headerMsg->GetBufferSize(), timeout);
+      if (bytesReceived == IGTL_EMPTY_DATA_SIZE || bytesReceived != headerMsg->GetBufferSize())
+      {
+        continue;
+      }
+      headerMsg->Unpack();
+      if (std::string(headerMsg->GetDeviceType()) == "TRACKEDFRAME")
+      {
+        // Receive the whole frame, as a real client would (the image is read from shared memory if the server put it there)
+        vtkPlusIgtlMessageCommon::SharedMemoryImageStatus sharedMemoryStatus(vtkPlusIgtlMessageCommon::SHARED_MEMORY_IMAGE_NOT_USED);
+        if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(headerMsg, clientSocket, trackedFrame, igsioTransformName(), 0, &sharedMemoryRing, &sharedMemoryStatus) != PLUS_SUCCESS)
+        {
+          Statistics.AddCount(clientName.str() + (sharedMemoryStatus == vtkPlusIgtlMessageCommon::SHARED_MEMORY_RING_UNAVAILABLE ? ".sharedMemoryUnavailable" : ".droppedFrames"), 1);
+          continue;
+        }
+        if (sharedMemoryStatus == vtkPlusIgtlMessageCommon::SHARED_MEMORY_IMAGE_READ)
+        {
+          Statistics.AddCount("sharedMemoryFrames", 1);
+        }
+      }
+      else
+      {
+        clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+      }
+      const double receiveTimeUniversal = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(vtkIGSIOAccurateTimer::GetSystemTime());
+
+      headerMsg->GetTimeStamp(timestamp);
+      const std::string messageType = headerMsg->GetDeviceType();
+      Statistics.AddSample("endToEnd." + messageType, receiveTimeUniversal - timestamp->GetTimeStamp());
+      Statistics.AddCount(clientName.str() + "." + messageType + ".messages", 1);
+      Statistics.AddCount(clientName.str() + ".bytes", static_cast<double>(headerMsg->GetBufferSize() + headerMsg->GetBodySizeToRead()));
+    }
+    clientSocket->CloseSocket();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Receives the tracking data datagrams of the server and records the end-to-end latency and the datagram loss */
+  void DatagramSubscriberThread(PlusIgtlDatagramChannel* datagramChannel, const std::atomic<bool>* active)
+  {
+    vtkSmartPointer<vtkPlusIgtlMessageFactory> messageFactory = vtkSmartPointer<vtkPlusIgtlMessageFactory>::New();
+    igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
+    uint64_t lostDatagrams = datagramChannel->GetNumberOfLostDatagrams();
+    while (*active)
+    {
+      igtl::MessageBase::Pointer message;
+      if (datagramChannel->ReceiveMessage(0.1, messageFactory, 0, message) != PLUS_SUCCESS)
+      {
+        break;
+      }
+      if (message.IsNull())
+      {
+        continue;
+      }
+      const double receiveTimeUniversal = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(vtkIGSIOAccurateTimer::GetSystemTime());
+      message->GetTimeStamp(timestamp);
+      const std::string messageType = message->GetMessageType();
+      Statistics.AddSample("endToEnd.datagram." + messageType, receiveTimeUniversal - timestamp->GetTimeStamp());
+      Statistics.AddCount("datagram." + messageType + ".messages", 1);
+      Statistics.AddCount("datagram.lost", static_cast<double>(datagramChannel->GetNumberOfLostDatagrams() - lostDatagrams));
+      lostDatagrams = datagramChannel->GetNumberOfLostDatagrams();
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  double warmupTimeSec = 2.0;
+  double runTimeSec = 10.0;
+  std::string outputFileName;
+  std::string messageTypes = "IMAGE TRANSFORM";
+  double maxDatagramLossPercent = 100.0;
+
+  BenchmarkParameters params;
+  params.FrameWidth = 640;
+  params.FrameHeight = 480;
+  params.PixelType = "uchar";
+  params.NumberOfScalarComponents = 1;
+  params.VideoRate = 30;
+  params.NumberOfTools = 4;
+  params.TrackerRate = 100;
+  params.NumberOfClients = 1;
+  params.ListeningPort = 18950;
+  params.EnableCapture = false;
+  params.SharedMemoryTransport = false;
+  params.ScatterGatherSend = false;
+  params.DatagramAddress = "127.0.0.1";
+  params.DatagramPort = -1;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--frame-width", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.FrameWidth, "Width of the synthetic video frames in pixels (default: 640).");
+  args.AddArgument("--frame-height", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.FrameHeight, "Height of the synthetic video frames in pixels (default: 480).");
+  args.AddArgument("--pixel-type", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.PixelType, "Pixel type of the synthetic video frames: uchar, char, ushort, short, float (default: uchar).");
+  args.AddArgument("--number-of-components", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.NumberOfScalarComponents, "Number of scalar components of the synthetic video frames: 1 or 3 (default: 1).");
+  args.AddArgument("--video-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.VideoRate, "Acquisition rate of the synthetic video device in frames per second (default: 30).");
+  args.AddArgument("--number-of-tools", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.NumberOfTools, "Number of tools of the synthetic tracker (default: 4).");
+  args.AddArgument("--tracker-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.TrackerRate, "Acquisition rate of the synthetic tracker in samples per second (default: 100).");
+  args.AddArgument("--number-of-clients", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.NumberOfClients, "Number of loopback OpenIGTLink clients (default: 1).");
+  args.AddArgument("--port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.ListeningPort, "Listening port of the OpenIGTLink server (default: 18950).");
+  args.AddArgument("--message-types", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &messageTypes, "Space-separated list of OpenIGTLink message types sent to the clients (default: \"IMAGE TRANSFORM\").");
+  args.AddArgument("--enable-capture", vtksys::CommandLineArguments::NO_ARGUMENT, &params.EnableCapture, "Record the mixed stream to file with a virtual capture device.");
+  args.AddArgument("--shared-memory", vtksys::CommandLineArguments::NO_ARGUMENT, &params.SharedMemoryTransport, "Clients receive the image data of TRACKEDFRAME messages through shared memory instead of the socket.");
+  args.AddArgument("--scatter-gather-send", vtksys::CommandLineArguments::NO_ARGUMENT, &params.ScatterGatherSend, "The server sends the image data of TRACKEDFRAME messages directly from the frame memory with vectored socket I/O.");
+  args.AddArgument("--datagram-port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.DatagramPort, "If specified then the server broadcasts the tool transforms in UDP datagrams to this port as well.");
+  args.AddArgument("--datagram-address", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.DatagramAddress, "Destination of the tracking data datagrams, unicast address or multicast group (default: 127.0.0.1).");
+  args.AddArgument("--max-datagram-loss-percent", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxDatagramLossPercent, "The benchmark fails if the percentage of lost or dropped (out of order) datagrams exceeds this value (default: 100).");
+  args.AddArgument("--processor-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &params.ProcessorConfigFile, "File containing a Processor element. If specified then an image processor device is inserted between the video device and the mixer.");
+  args.AddArgument("--warmup-time", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &warmupTimeSec, "Time in seconds before measurement starts (default: 2).");
+  args.AddArgument("--running-time", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &runTimeSec, "Measurement time in seconds (default: 10).");
+  args.AddArgument("--output-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFileName, "Name of the JSON file the results are written to. If not specified then the results are written to the standard output.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  igsioCommon::VTKScalarPixelType pixelType(VTK_UNSIGNED_CHAR);
+  unsigned int bytesPerScalar(1);
+  if (GetPixelTypeFromString(params.PixelType, pixelType, bytesPerScalar) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+  if (params.NumberOfTools < 1 || params.NumberOfClients < 0 || params.FrameWidth < 1 || params.FrameHeight < 1
+      || (params.NumberOfScalarComponents != 1 && params.NumberOfScalarComponents != 3))
+  {
+    LOG_ERROR("Invalid benchmark parameters. At least one tool and a valid frame size are required, number of components must be 1 or 3.");
+    exit(EXIT_FAILURE);
+  }
+  params.MessageTypes = igsioCommon::SplitStringIntoTokens(messageTypes, ' ', false);
+  if (params.SharedMemoryTransport && std::find(params.MessageTypes.begin(), params.MessageTypes.end(), "TRACKEDFRAME") == params.MessageTypes.end())
+  {
+    LOG_WARNING("Shared memory transport is only used for TRACKEDFRAME messages, add TRACKEDFRAME to --message-types");
+  }
+
+  // Create the device set configuration
+  std::string configXml = CreateDeviceSetConfiguration(params);
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(configXml.c_str()));
+  if (configRootElement == NULL)
+  {
+    LOG_ERROR("Failed to create benchmark configuration");
+    exit(EXIT_FAILURE);
+  }
+  std::string configFilePath = vtkPlusConfig::GetInstance()->GetOutputPath("PlusServerBenchmarkConfig.xml");
+  igsioCommon::XML::PrintXML(configFilePath, configRootElement);
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationFileName(configFilePath);
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+  dataCollector->GetDeviceFactory().RegisterDevice("BenchmarkVideo", "vtkPlusBenchmarkVideoSource", (vtkPlusDeviceFactory::PointerToDevice)&vtkPlusBenchmarkVideoSource::New);
+  dataCollector->GetDeviceFactory().RegisterDevice("BenchmarkTracker", "vtkPlusBenchmarkTracker", (vtkPlusDeviceFactory::PointerToDevice)&vtkPlusBenchmarkTracker::New);
+  if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to read configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (transformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Transform repository failed to read configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  if (dataCollector->Connect() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to connect to devices");
+    exit(EXIT_FAILURE);
+  }
+  if (dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to start");
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkPlusOpenIGTLinkServer> server = vtkSmartPointer<vtkPlusOpenIGTLinkServer>::New();
+  vtkXMLDataElement* serverElement = configRootElement->FindNestedElementWithName("PlusOpenIGTLinkServer");
+  if (server->Start(dataCollector, transformRepository, serverElement, configFilePath) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start OpenIGTLink server");
+    exit(EXIT_FAILURE);
+  }
+
+  // Channels monitored by the probe thread, in pipeline order
+  std::vector<std::pair<std::string, vtkPlusChannel*> > probedChannels;
+  const char* probedChannelIds[] = { "VideoStream", "TrackerStream", "ProcessedVideoStream", "TrackedVideoStream" };
+  const char* probedStageNames[] = { "videoChannel", "trackerChannel", "processorChannel", "mixerChannel" };
+  for (int i = 0; i < 4; ++i)
+  {
+    vtkPlusChannel* channel(NULL);
+    if (dataCollector->GetChannel(channel, probedChannelIds[i]) == PLUS_SUCCESS)
+    {
+      probedChannels.push_back(std::make_pair(std::string(probedStageNames[i]), channel));
+    }
+  }
+
+  std::atomic<bool> active(true);
+  std::atomic<int> numberOfConnectedClients(0);
+  std::vector<std::thread> threads;
+  threads.push_back(std::thread(ChannelProbeThread, &probedChannels, &active));
+  PlusIgtlDatagramChannel datagramChannel;
+  if (params.DatagramPort > 0)
+  {
+    if (datagramChannel.OpenReceiver(params.DatagramAddress, params.DatagramPort) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to open datagram subscriber on port " << params.DatagramPort);
+      exit(EXIT_FAILURE);
+    }
+    threads.push_back(std::thread(DatagramSubscriberThread, &datagramChannel, &active));
+  }
+  for (int i = 0; i < params.NumberOfClients; ++i)
+  {
+    threads.push_back(std::thread(LoopbackClientThread, i, &params, &active, &numberOfConnectedClients));
+  }
+
+  LOG_INFO("Warming up for " << warmupTimeSec << " seconds");
+  vtkIGSIOAccurateTimer::Delay(warmupTimeSec);
+  if (numberOfConnectedClients < params.NumberOfClients)
+  {
+    LOG_WARNING("Only " << numberOfConnectedClients << " of " << params.NumberOfClients << " loopback clients are connected");
+  }
+
+  vtkPlusVirtualCapture* captureDevice = NULL;
+  long capturedFramesAtStart = 0;
+  vtkPlusDevice* device = NULL;
+  if (dataCollector->GetDevice(device, "BenchmarkCaptureDevice") == PLUS_SUCCESS)
+  {
+    captureDevice = vtkPlusVirtualCapture::SafeDownCast(device);
+    capturedFramesAtStart = captureDevice->GetTotalFramesRecorded();
+  }
+
+  LOG_INFO("Measuring for " << runTimeSec << " seconds");
+  const double cpuTimeAtStart = GetProcessCpuTimeSec();
+  const double measurementStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  Statistics.SetEnabled(true);
+  vtkIGSIOAccurateTimer::Delay(runTimeSec);
+  Statistics.SetEnabled(false);
+  const double measurementTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - measurementStartTime;
+  const double cpuTimeSec = GetProcessCpuTimeSec() - cpuTimeAtStart;
+  long capturedFrames = (captureDevice != NULL ? captureDevice->GetTotalFramesRecorded() - capturedFramesAtStart : 0);
+  double currentMemoryBytes(0), peakMemoryBytes(0);
+  GetProcessMemoryUsage(currentMemoryBytes, peakMemoryBytes);
+
+  active = false;
+  for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+  {
+    it->join();
+  }
+  server->Stop();
+  dataCollector->Stop();
+  dataCollector->Disconnect();
+
+  bool benchmarkFailed(false);
+  if (params.DatagramPort > 0)
+  {
+    const uint64_t missingDatagrams = datagramChannel.GetNumberOfLostDatagrams() + datagramChannel.GetNumberOfDroppedDatagrams();
+    const double datagramLossPercent = (datagramChannel.GetNumberOfDatagrams() > 0 ? 100.0 * missingDatagrams / (datagramChannel.GetNumberOfDatagrams() + missingDatagrams) : 100.0);
+    if (datagramChannel.GetNumberOfDatagrams() == 0)
+    {
+      LOG_ERROR("No tracking data datagrams were received on port " << params.DatagramPort);
+      benchmarkFailed = true;
+    }
+    else if (datagramLossPercent > maxDatagramLossPercent)
+    {
+      LOG_ERROR("Tracking data datagram loss (" << datagramLossPercent << "%) exceeds the allowed maximum (" << maxDatagramLossPercent << "%). Received: " << datagramChannel.GetNumberOfDatagrams()
+                << ", lost: " << datagramChannel.GetNumberOfLostDatagrams() << ", dropped (out of order): " << datagramChannel.GetNumberOfDroppedDatagrams());
+      benchmarkFailed = true;
+    }
+    else if (missingDatagrams > 0)
+    {
+      LOG_WARNING("Tracking data datagrams received: " << datagramChannel.GetNumberOfDatagrams() << ", lost: " << datagramChannel.GetNumberOfLostDatagrams()
+                  << ", dropped (out of order): " << datagramChannel.GetNumberOfDroppedDatagrams());
+    }
+  }
+
+  if (params.SharedMemoryTransport && params.NumberOfClients > 0 && Statistics.GetCount("sharedMemoryFrames") == 0)
+  {
+    LOG_ERROR("No image data was received through shared memory");
+    benchmarkFailed = true;
+  }
+
+  // Write results
+  std::ofstream outputFile;
+  if (!outputFileName.empty())
+  {
+    outputFile.open(outputFileName.c_str());
+    if (!outputFile.is_open())
+    {
+      LOG_ERROR("Failed to open output file: " << outputFileName);
+      exit(EXIT_FAILURE);
+    }
+  }
+  std::ostream& os = (outputFile.is_open() ? static_cast<std::ostream&>(outputFile) : std::cout);
+  os << "{\n"
+     << "  \"parameters\": {"
+     << "\"frameWidth\": " << params.FrameWidth
+     << ", \"frameHeight\": " << params.FrameHeight
+     << ", \"pixelType\": \"" << params.PixelType << "\""
+     << ", \"numberOfComponents\": " << params.NumberOfScalarComponents
+     << ", \"videoRate\": " << params.VideoRate
+     << ", \"numberOfTools\": " << params.NumberOfTools
+     << ", \"trackerRate\": " << params.TrackerRate
+     << ", \"numberOfClients\": " << params.NumberOfClients
+     << ", \"connectedClients\": " << numberOfConnectedClients
+     << ", \"messageTypes\": \"" << messageTypes << "\""
+     << ", \"capture\": " << (params.EnableCapture ? "true" : "false")
+     << ", \"sharedMemory\": " << (params.SharedMemoryTransport ? "true" : "false")
+     << ", \"scatterGatherSend\": " << (params.ScatterGatherSend ? "true" : "false")
+     << ", \"datagramPort\": " << params.DatagramPort
+     << ", \"processor\": " << (params.ProcessorConfigFile.empty() ? "false" : "true")
+     << ", \"measurementTimeSec\": " << measurementTimeSec
+     << "},\n";
+  Statistics.WriteJson(os, measurementTimeSec);
+  os << "  \"capture\": {\"framesRecorded\": " << capturedFrames
+     << ", \"fps\": " << (measurementTimeSec > 0 ? capturedFrames / measurementTimeSec : 0) << "},\n"
+     << "  \"datagram\": {\"received\": " << datagramChannel.GetNumberOfDatagrams()
+     << ", \"lost\": " << datagramChannel.GetNumberOfLostDatagrams()
+     << ", \"dropped\": " << datagramChannel.GetNumberOfDroppedDatagrams() << "},\n"
+     << "  \"process\": {\"cpuTimeSec\": " << cpuTimeSec
+     << ", \"cpuPercent\": " << (measurementTimeSec > 0 ? 100.0 * cpuTimeSec / measurementTimeSec : 0)
+     << ", \"residentMemoryBytes\": " << std::fixed << std::setprecision(0) << currentMemoryBytes
+     << ", \"peakResidentMemoryBytes\": " << peakMemoryBytes << "}\n"
+     << "}\n";
+
+  if (!outputFileName.empty())
+  {
+    LOG_INFO("Benchmark results written to " << outputFileName);
+  }
+  return benchmarkFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "igtlPlusServerSocket.h"
+
+namespace igtl
+{
+  //----------------------------------------------------------------------------
+  PlusClientSocket::PlusClientSocket()
+    : ClientSocket()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  PlusClientSocket::~PlusClientSocket()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusClientSocket::GetDescriptor() const
+  {
+    return this->m_SocketDescriptor;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusServerSocket::PlusServerSocket()
+    : ServerSocket()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  PlusServerSocket::~PlusServerSocket()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  ClientSocket::Pointer PlusServerSocket::WaitForConnection(unsigned long msec /*=0*/)
+  {
+    if (this->m_SocketDescriptor < 0)
+    {
+      return NULL;
+    }
+
+    // SelectSocket returns 0 on timeout and -1 on error
+    if (this->SelectSocket(this->m_SocketDescriptor, msec) <= 0)
+    {
+      return NULL;
+    }
+
+    int clientSocketDescriptor = this->Accept(this->m_SocketDescriptor);
+    if (clientSocketDescriptor == -1)
+    {
+      return NULL;
+    }
+
+    PlusClientSocket::Pointer clientSocket = PlusClientSocket::New();
+    clientSocket->m_SocketDescriptor = clientSocketDescriptor;
+    return clientSocket.GetPointer();
+  }
+}
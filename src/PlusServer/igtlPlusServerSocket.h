@@ -0,0 +1,67 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __igtlPlusServerSocket_h
+#define __igtlPlusServerSocket_h
+
+// Local includes
+#include "vtkPlusServerExport.h"
+
+// IGTL includes
+#include <igtlClientSocket.h>
+#include <igtlServerSocket.h>
+
+namespace igtl
+{
+  /*!
+    \class PlusClientSocket
+    \brief Client socket that is accepted by PlusServerSocket
+
+    igtl::Socket only allows derived classes to access the socket descriptor. The server needs it for
+    vectored socket I/O and for socket options that igtl::Socket does not provide (e.g., TCP_CORK).
+
+    \ingroup PlusLibPlusServer
+  */
+  class vtkPlusServerExport PlusClientSocket: public ClientSocket
+  {
+  public:
+    igtlTypeMacro(igtl::PlusClientSocket, igtl::ClientSocket);
+    igtlNewMacro(igtl::PlusClientSocket);
+
+    /*! Native descriptor of the connected socket, -1 if the socket is not connected */
+    int GetDescriptor() const;
+
+  protected:
+    PlusClientSocket();
+    ~PlusClientSocket();
+
+    friend class PlusServerSocket;
+  };
+
+  /*!
+    \class PlusServerSocket
+    \brief Server socket that returns PlusClientSocket instances for the accepted connections
+    \ingroup PlusLibPlusServer
+  */
+  class vtkPlusServerExport PlusServerSocket: public ServerSocket
+  {
+  public:
+    igtlTypeMacro(igtl::PlusServerSocket, igtl::ServerSocket);
+    igtlNewMacro(igtl::PlusServerSocket);
+
+    /*!
+      Wait for a connection for the given time (in milliseconds, 0 means no timeout) and accept it.
+      Same as ServerSocket::WaitForConnection but the returned socket is a PlusClientSocket.
+    */
+    ClientSocket::Pointer WaitForConnection(unsigned long msec = 0);
+
+  protected:
+    PlusServerSocket();
+    ~PlusServerSocket();
+  };
+}
+
+#endif
@@ -42,6 +42,7 @@ See License.txt for details.
 #include "vtkPlusAddRecordingDeviceCommand.h"
 #include "vtkPlusGenericSerialCommand.h"
 #include "vtkPlusGetFrameRateCommand.h"
+#include "vtkPlusGetMetricsCommand.h"
 #include "vtkPlusGetPolydataCommand.h"
 #include "vtkPlusGetTransformCommand.h"
 #include "vtkPlusGetUsParameterCommand.h"
@@ -88,6 +89,7 @@ vtkPlusCommandProcessor::vtkPlusCommandProcessor()
   RegisterPlusCommand(vtkSmartPointer<vtkPlusAddRecordingDeviceCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGenericSerialCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetFrameRateCommand>::New());
+  RegisterPlusCommand(vtkSmartPointer<vtkPlusGetMetricsCommand>::New());
 #ifdef PLUS_USE_FLIRSPINNAKER_CAM
   RegisterPlusCommand(vtkSmartPointer<vtkPlusFLIRCommand>::New());
 #endif
@@ -163,9 +163,16 @@ public:
   vtkSetMacro(PolyDataName, std::string);
   vtkSetObjectMacro(PolyData, vtkPolyData);
   vtkGetMacro(PolyData, vtkPolyData*);
+  /*! Absolute path of the model file if the polydata was retrieved from PlusModelAssetCache, empty otherwise */
+  vtkGetMacro(ModelFilePath, std::string);
+  vtkSetMacro(ModelFilePath, std::string);
+  /*! Target reduction that was used for getting the polydata from PlusModelAssetCache */
+  vtkGetMacro(TargetReduction, double);
+  vtkSetMacro(TargetReduction, double);
 protected:
   vtkPlusCommandPolydataResponse()
     : PolyData(NULL)
+    , TargetReduction(0.0)
   {
   }
   virtual ~vtkPlusCommandPolydataResponse()
@@ -174,6 +181,8 @@ protected:
   }
   std::string   PolyDataName;
   vtkPolyData*  PolyData;
+  std::string   ModelFilePath;
+  double        TargetReduction;
 
 private:
   vtkPlusCommandPolydataResponse(const vtkPlusCommandPolydataResponse&);
@@ -7,6 +7,9 @@ See License.txt for details.
 // Local includes
 #include "PlusConfigure.h"
 #include "PlusCommon.h"
+#include "PlusIgtlDatagramChannel.h"
+#include "PlusMetrics.h"
+#include "PlusModelAssetCache.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusCommand.h"
@@ -24,7 +27,7 @@ See License.txt for details.
 #include <vtkObjectFactory.h>
 #include <vtkPoints.h>
 #include <vtkPolyData.h>
-#include <vtkPolyDataReader.h>
+#include <vtkUnsignedCharArray.h>
 
 // OpenIGTLink includes
 #include <igtlCommandMessage.h>
@@ -32,11 +35,13 @@ See License.txt for details.
 #include <igtlImageMetaMessage.h>
 #include <igtlMessageHeader.h>
 #include <igtlPlusClientInfoMessage.h>
+#include <igtlPlusTrackedFrameMessage.h>
 #include <igtlPointMessage.h>
 #include <igtlPolyDataMessage.h>
 #include <igtlStatusMessage.h>
 #include <igtlStringMessage.h>
 #include <igtlTrackingDataMessage.h>
+#include <igtl_header.h>
 
 // OpenIGTLinkIO includes
 #include <igtlioPolyDataConverter.h>
@@ -62,11 +67,28 @@ namespace
   const double SERVER_START_CHECK_DELAY_SEC = 2.0;
   const double SERVER_START_CHECK_DELAY_INTERVAL_SEC = 0.05;
 
+  // Client identifier used for packing the datagram broadcast messages (valid client IDs start at 1)
+  const int DATAGRAM_BROADCAST_CLIENT_ID = 0;
+
   //----------------------------------------------------------------------------
   // If a frame cannot be retrieved from the device buffers (because it was overwritten by new frames)
   // then we skip a SAMPLING_SKIPPING_MARGIN_SEC long period to allow the application to catch up.
   // This time should be long enough to comfortably retrieve a frame from the buffer.
   const double SAMPLING_SKIPPING_MARGIN_SEC = 0.1;
+
+  //----------------------------------------------------------------------------
+  // Returns true if the client is connected from the same host (only these clients can use shared memory transport)
+  bool IsLocalClient(igtl::ClientSocket* clientSocket)
+  {
+#if (OPENIGTLINK_VERSION_MAJOR > 1) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR > 9 ) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR == 9 && OPENIGTLINK_VERSION_PATCH > 4 )
+    int port = 0;
+    std::string address;
+    clientSocket->GetSocketAddressAndPort(address, port);
+    return address.compare(0, 4, "127.") == 0 || address == "::1" || address.compare(0, 11, "::ffff:127.") == 0;
+#else
+    return false;
+#endif
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -77,7 +99,7 @@ const float vtkPlusOpenIGTLinkServer::CLIENT_SOCKET_TIMEOUT_SEC = 0.5f;
 
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
-  : ServerSocket(igtl::ServerSocket::New())
+  : ServerSocket(igtl::PlusServerSocket::New())
   , TransformRepository(NULL)
   , DataCollector(NULL)
   , Threader(vtkSmartPointer<vtkMultiThreader>::New())
@@ -95,6 +117,11 @@ vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
   , MaxTimeSpentWithProcessingMs(50)
   , LastProcessingTimePerFrameMs(-1)
   , SendValidTransformsOnly(true)
+  , ScatterGatherSendEnabled(false)
+  , SharedMemoryTransportEnabled(false)
+  , DatagramBroadcastPort(-1)
+  , DatagramBroadcastMulticastTimeToLive(1)
+  , DatagramChannel(NULL)
   , DefaultClientSendTimeoutSec(CLIENT_SOCKET_TIMEOUT_SEC)
   , DefaultClientReceiveTimeoutSec(CLIENT_SOCKET_TIMEOUT_SEC)
   , IgtlMessageCrcCheckEnabled(0)
@@ -106,7 +133,9 @@ vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
   , MissingInputGracePeriodSec(0.0)
   , BroadcastStartTime(0.0)
-  , NewClientConnected(false)
+  , EnableMetrics(false)
+  , MetricsFileUpdateIntervalSec(5.0)
+  , LastMetricsFileUpdateTime(0.0)
 {
 
 }
@@ -118,6 +147,8 @@ vtkPlusOpenIGTLinkServer::~vtkPlusOpenIGTLinkServer()
   this->SetTransformRepository(NULL);
   this->SetDataCollector(NULL);
   this->SetConfigFilename(NULL);
+  delete this->DatagramChannel;
+  this->DatagramChannel = NULL;
 }
 
 //----------------------------------------------------------------------------
@@ -192,6 +223,30 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
 
   this->PlusCommandProcessor->SetPlusServer(this);
 
+  if (this->SharedMemoryTransportEnabled)
+  {
+    std::ostringstream ringNamePrefix;
+    ringNamePrefix << "PlusServer_" << this->ListeningPort;
+    this->IgtlMessageFactory->SetSharedMemoryRingNamePrefix(ringNamePrefix.str());
+  }
+  else
+  {
+    this->IgtlMessageFactory->SetSharedMemoryRingNamePrefix("");
+  }
+
+  if (this->DatagramBroadcastPort > 0)
+  {
+    if (this->DatagramChannel == NULL)
+    {
+      this->DatagramChannel = new PlusIgtlDatagramChannel;
+    }
+    if (this->DatagramChannel->OpenSender(this->DatagramBroadcastAddress, this->DatagramBroadcastPort, this->DatagramBroadcastMulticastTimeToLive) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to start broadcasting tracking data datagrams to " << this->DatagramBroadcastAddress << ":" << this->DatagramBroadcastPort);
+      return PLUS_FAIL;
+    }
+  }
+
   this->BroadcastStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
   return PLUS_SUCCESS;
@@ -213,6 +268,13 @@ PlusStatus vtkPlusOpenIGTLinkServer::StopOpenIGTLinkService()
     LOG_DEBUG("ConnectionReceiverThread stopped");
   }
 
+  if (this->DatagramChannel != NULL)
+  {
+    // The data sender thread stops when the connection receiver thread is stopped, wait for it before closing the datagram socket
+    RETRY_UNTIL_TRUE(!this->DataSenderActive.Respond, vtkMath::Round(SERVER_START_CHECK_DELAY_SEC / SERVER_START_CHECK_DELAY_INTERVAL_SEC), SERVER_START_CHECK_DELAY_INTERVAL_SEC);
+    this->DatagramChannel->Close();
+  }
+
   // Disconnect clients (stop receiving thread, close socket)
   std::vector< int > clientIds;
   {
@@ -259,7 +321,6 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
       ClientData newClient;
       self->IgtlClients.push_back(newClient);
-      self->NewClientConnected = true;
 
       ClientData* client = &(self->IgtlClients.back());   // get a reference to the client data that is stored in the list
       client->ClientId = self->ClientIdCounter;
@@ -280,15 +341,6 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
           imageStream->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
         }
       }
-      for (std::vector<PlusIgtlClientInfo::VideoStream>::iterator videoStreamIterator = client->ClientInfo.VideoStreams.begin();
-           videoStreamIterator != client->ClientInfo.VideoStreams.end(); ++videoStreamIterator)
-      {
-        PlusIgtlClientInfo::VideoStream* videoStream = &(*videoStreamIterator);
-        if (!videoStream->FrameConverter)
-        {
-          videoStream->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
-        }
-      }
 
       int port = 0;
       std::string address = "unknown";
@@ -377,7 +429,8 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
   double elapsedTimeSinceLastPacketSentSec = 0;
   while (self->ConnectionActive.Request && self->DataSenderActive.Request)
   {
-    bool clientsConnected = false;
+    // Datagram subscribers are not known, the tracking data is broadcast even if no client is connected
+    bool clientsConnected = (self->DatagramChannel != NULL && self->DatagramChannel->IsOpen());
     {
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
       if (!self->IgtlClients.empty())
@@ -405,6 +458,8 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
 
     // Send image/tracking/string data
     SendLatestFramesToClients(*self, elapsedTimeSinceLastPacketSentSec);
+
+    self->UpdateMetricsFile();
   }
   // Close thread
   self->DataSenderThreadId = -1;
@@ -536,16 +591,22 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendCommandResponses(vtkPlusOpenIGTLinkServ
   {
     for (PlusCommandResponseList::iterator responseIt = replies.begin(); responseIt != replies.end(); responseIt++)
     {
-      igtl::MessageBase::Pointer igtlResponseMessage = self.CreateIgtlMessageFromCommandResponse(*responseIt);
-      if (igtlResponseMessage.IsNull())
+      // Models from the asset cache are sent as prepacked messages, other responses are converted to messages here
+      vtkSmartPointer<vtkUnsignedCharArray> prepackedMessage = self.GetPrepackedPolydataMessage(*responseIt);
+      igtl::MessageBase::Pointer igtlResponseMessage;
+      if (prepackedMessage == NULL)
       {
-        LOG_ERROR("Failed to create OpenIGTLink message from command response");
-        continue;
+        igtlResponseMessage = self.CreateIgtlMessageFromCommandResponse(*responseIt);
+        if (igtlResponseMessage.IsNull())
+        {
+          LOG_ERROR("Failed to create OpenIGTLink message from command response");
+          continue;
+        }
+        igtlResponseMessage->Pack();
       }
-      igtlResponseMessage->Pack();
 
       // Only send the response to the client that requested the command
-      LOG_DEBUG("Send command reply to client " << (*responseIt)->GetClientId() << ": " << igtlResponseMessage->GetDeviceName());
+      LOG_DEBUG("Send command reply to client " << (*responseIt)->GetClientId() << ": " << (prepackedMessage != NULL ? "prepacked POLYDATA" : igtlResponseMessage->GetDeviceName()));
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
       igtl::ClientSocket::Pointer clientSocket = NULL;
       for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
@@ -562,7 +623,24 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendCommandResponses(vtkPlusOpenIGTLinkServ
         LOG_WARNING("Message reply cannot be sent to client " << (*responseIt)->GetClientId() << ", probably client has been disconnected");
         continue;
       }
-      clientSocket->Send(igtlResponseMessage->GetBufferPointer(), igtlResponseMessage->GetBufferSize());
+      if (prepackedMessage != NULL)
+      {
+        // The prepacked message is shared by all requests of the model, therefore its header is copied and
+        // stamped with the send time (the timestamp is not covered by the CRC, so the body is sent unchanged)
+        igtl_header header;
+        memcpy(&header, prepackedMessage->GetPointer(0), IGTL_HEADER_SIZE);
+        igtl_header_convert_byte_order(&header);
+        igtl::TimeStamp::Pointer sendTime = igtl::TimeStamp::New();
+        sendTime->SetTime(vtkIGSIOAccurateTimer::GetSystemTime());
+        header.timestamp = sendTime->GetTimeStampUint64();
+        igtl_header_convert_byte_order(&header);
+        clientSocket->Send(&header, IGTL_HEADER_SIZE);
+        clientSocket->Send(prepackedMessage->GetPointer(IGTL_HEADER_SIZE), prepackedMessage->GetNumberOfTuples() - IGTL_HEADER_SIZE);
+      }
+      else
+      {
+        clientSocket->Send(igtlResponseMessage->GetBufferPointer(), igtlResponseMessage->GetBufferSize());
+      }
     }
   }
 
@@ -631,7 +709,33 @@ void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo*
       {
         // Message received from client, need to lock to modify client info
         igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
+        int knownClientHeaderVersion = client->ClientInfo.GetClientHeaderVersion();
         client->ClientInfo = clientInfoMsg->GetClientInfo();
+        // The client may request a newer header version in the client info (upper bounded by the servers version)
+        client->ClientInfo.SetClientHeaderVersion(std::min<int>(self->GetIGTLHeaderVersion(), std::max<int>(knownClientHeaderVersion, client->ClientInfo.GetClientHeaderVersion())));
+        if (client->ClientInfo.GetSharedMemoryTransport())
+        {
+          // Fall back to sending images through the socket if shared memory cannot be used for this client
+          if (!self->SharedMemoryTransportEnabled)
+          {
+            LOG_INFO("Client " << clientId << " requested shared memory transport but it is not enabled in the server, images are sent through the socket");
+            client->ClientInfo.SetSharedMemoryTransport(false);
+          }
+          else if (!IsLocalClient(clientSocket))
+          {
+            LOG_WARNING("Client " << clientId << " requested shared memory transport but it is not connected from the same host, images are sent through the socket");
+            client->ClientInfo.SetSharedMemoryTransport(false);
+          }
+          else if (!client->ClientInfo.GetTrackedFrameBinaryData())
+          {
+            LOG_WARNING("Client " << clientId << " requested shared memory transport but it requires binary TRACKEDFRAME frame data, images are sent through the socket");
+            client->ClientInfo.SetSharedMemoryTransport(false);
+          }
+          else
+          {
+            LOG_INFO("Client " << clientId << " receives images through shared memory");
+          }
+        }
         LOG_DEBUG("Client info message received from client " << clientId);
       }
     }
@@ -767,8 +871,11 @@ void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo*
       int c = startTracking->Unpack(self->IgtlMessageCrcCheckEnabled);
       if (c & igtl::MessageHeader::UNPACK_BODY || startTracking->GetBufferBodySize() == 0)
       {
+        // The pending TDATA samples are updated by the sending thread as well, need to lock to modify client info
+        igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
         client->ClientInfo.SetTDATAResolution(startTracking->GetResolution());
         client->ClientInfo.SetTDATARequested(true);
+        client->ClientInfo.GetPendingTDATASamples().clear();
       }
       else
       {
@@ -832,11 +939,13 @@ void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo*
           }
         }
 
-        vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
-        reader->SetFileName(fileName.c_str());
-        reader->Update();
-
-        auto polyData = reader->GetOutput();
+        // The model is read from the file only if it is not in the model asset cache yet or the file has changed since it was read
+        std::string modelFilePath(fileName);
+        if (!vtksys::SystemTools::FileExists(fileName) && vtkPlusConfig::GetInstance()->FindModelPath(fileName, modelFilePath) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Unable to locate file with name " << fileName);
+        }
+        vtkSmartPointer<vtkPolyData> polyData = PlusModelAssetCache::GetInstance()->GetPolyData(vtksys::SystemTools::CollapseFullPath(modelFilePath));
         if (polyData != nullptr)
         {
           igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("POLYDATA", client->ClientInfo.GetClientHeaderVersion());
@@ -1031,6 +1140,7 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
 
   // Convert relative timestamp to UTC
   double timestampSystem = trackedFrame.GetTimestamp(); // save original timestamp, we'll restore it later
+  PLUS_METRIC_HISTOGRAM_RECORD_SEC("plus_server_frame_age_seconds", PlusMetricsRegistry::MakeLabel("channel", this->OutputChannelId), vtkIGSIOAccurateTimer::GetSystemTime() - timestampSystem);
   double timestampUniversal = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(timestampSystem);
   trackedFrame.SetTimestamp(timestampUniversal);
 
@@ -1038,23 +1148,6 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
   {
     // Lock before we send message to the clients
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
-    if (this->NewClientConnected)
-    {
-      for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
-      {
-        std::vector<PlusIgtlClientInfo::VideoStream> videoStreams = (*clientIterator).ClientInfo.VideoStreams;
-        for (std::vector<PlusIgtlClientInfo::VideoStream>::iterator videoStream = videoStreams.begin(); videoStream != videoStreams.end(); ++videoStream)
-        {
-          vtkIGSIOFrameConverter* frameConverter = videoStream->FrameConverter;
-          if (frameConverter)
-          {
-            frameConverter->RequestKeyFrameOn();
-          }
-        }
-      }
-    }
-    this->NewClientConnected = false;
-
     for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
     {
       igtl::ClientSocket::Pointer clientSocket = (*clientIterator).ClientSocket;
@@ -1063,11 +1156,23 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
       std::vector<igtl::MessageBase::Pointer> igtlMessages;
       std::vector<igtl::MessageBase::Pointer>::iterator igtlMessageIterator;
 
+      // Vectored I/O needs the native socket descriptor, which is available for the sockets accepted by our server socket
+      igtl::PlusClientSocket* plusClientSocket = dynamic_cast<igtl::PlusClientSocket*>(clientSocket.GetPointer());
+      int socketDescriptor = (plusClientSocket != NULL ? plusClientSocket->GetDescriptor() : -1);
+      bool scatterGatherSend = this->ScatterGatherSendEnabled && socketDescriptor >= 0;
+
+      this->IgtlMessageFactory->SetImageDataGatherEnabled(scatterGatherSend);
       if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
       {
         LOG_WARNING("Failed to pack all IGT messages");
       }
 
+      // Coalesce all messages of the frame into full packets, they are flushed when the socket is uncorked
+      if (scatterGatherSend && !igtlMessages.empty())
+      {
+        SetSocketCork(socketDescriptor, true);
+      }
+
       // Send all messages to a client
       for (igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
       {
@@ -1078,7 +1183,31 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
         }
 
         int retValue = 0;
-        RETRY_UNTIL_TRUE((retValue = clientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
+        igtlUint64 messageSize = igtlMessage->GetBufferSize();
+        igtl::PlusTrackedFrameMessage* trackedFrameMessage = dynamic_cast<igtl::PlusTrackedFrameMessage*>(igtlMessage.GetPointer());
+        if (trackedFrameMessage != NULL && trackedFrameMessage->GetImageDataGatherEnabled())
+        {
+          // Image data is sent directly from the frame
+          std::vector<std::pair<const unsigned char*, size_t> > segments;
+          trackedFrameMessage->GetSendSegments(segments);
+          messageSize = 0;
+          for (size_t i = 0; i < segments.size(); ++i)
+          {
+            messageSize += segments[i].second;
+          }
+          PLUS_METRIC_SCOPED_TIMER("plus_server_socket_send_seconds", PlusMetricsRegistry::MakeLabel("client", igsioCommon::ToString<int>(clientIterator->ClientId)));
+          // Retrying after a partial send would put a duplicated message prefix on the wire and break the message framing,
+          // therefore a send is only retried if nothing was written. Otherwise the client is disconnected.
+          size_t numberOfBytesSent = 0;
+          RETRY_UNTIL_TRUE((retValue = SendSegments(socketDescriptor, segments, numberOfBytesSent)) != 0 || numberOfBytesSent > 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
+        }
+        else
+        {
+          PLUS_METRIC_SCOPED_TIMER("plus_server_socket_send_seconds", PlusMetricsRegistry::MakeLabel("client", igsioCommon::ToString<int>(clientIterator->ClientId)));
+          RETRY_UNTIL_TRUE((retValue = clientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
+        }
+        PLUS_METRIC_COUNTER_ADD("plus_server_sent_messages_total", PlusMetricsRegistry::MakeLabel("client", igsioCommon::ToString<int>(clientIterator->ClientId)), 1);
+        PLUS_METRIC_COUNTER_ADD("plus_server_sent_bytes_total", PlusMetricsRegistry::MakeLabel("client", igsioCommon::ToString<int>(clientIterator->ClientId)), messageSize);
         if (retValue == 0)
         {
           disconnectedClientIds.push_back(clientIterator->ClientId);
@@ -1089,8 +1218,16 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
           break;
         }
 
-        // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
-        clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
+        if (typeid(*igtlMessage) == typeid(igtl::TrackingDataMessage))
+        {
+          // TDATA resolution is measured from the last sent TDATA message
+          clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
+        }
+      }
+
+      if (scatterGatherSend && !igtlMessages.empty())
+      {
+        SetSocketCork(socketDescriptor, false);
       }
     }
   }
@@ -1101,12 +1238,56 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
     DisconnectClient(*it);
   }
 
+  if (this->DatagramChannel != NULL && this->DatagramChannel->IsOpen())
+  {
+    if (this->SendTrackedFrameDatagrams(trackedFrame) != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+  }
+
   // restore original timestamp
   trackedFrame.SetTimestamp(timestampSystem);
 
   return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrameDatagrams(igsioTrackedFrame& trackedFrame)
+{
+  // Messages are packed once for all subscribers
+  std::vector<igtl::MessageBase::Pointer> igtlMessages;
+  this->IgtlMessageFactory->SetImageDataGatherEnabled(false);
+  if (this->IgtlMessageFactory->PackMessages(DATAGRAM_BROADCAST_CLIENT_ID, this->DatagramBroadcastClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Failed to pack all IGT messages for datagram broadcast");
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  const double sendTimeUtc = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(vtkIGSIOAccurateTimer::GetSystemTime());
+  for (std::vector<igtl::MessageBase::Pointer>::iterator igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
+  {
+    igtl::MessageBase::Pointer igtlMessage = (*igtlMessageIterator);
+    if (igtlMessage.IsNull())
+    {
+      continue;
+    }
+    if (this->DatagramChannel->Send(igtlMessage, sendTimeUtc) != PLUS_SUCCESS)
+    {
+      // Datagrams are not retried, subscribers detect the lost message from the sequence number
+      status = PLUS_FAIL;
+      continue;
+    }
+    PLUS_METRIC_COUNTER_ADD("plus_server_sent_datagram_bytes_total", PlusMetricsRegistry::MakeLabel("channel", this->OutputChannelId), igtlMessage->GetBufferSize());
+    if (typeid(*igtlMessage) == typeid(igtl::TrackingDataMessage))
+    {
+      // TDATA resolution is measured from the last sent TDATA message
+      this->DatagramBroadcastClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
+    }
+  }
+  return status;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
 {
@@ -1190,6 +1371,9 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
     }
   }
 
+  // Stop the video encoders that were only used by this client
+  this->IgtlMessageFactory->RemoveClient(clientId);
+
   LOG_INFO("Client disconnected (" <<  address << ":" << port << "). Number of connected clients: " << GetNumberOfConnectedClients());
 }
 
@@ -1278,6 +1462,8 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, DelayBetweenRetryAttemptsSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, KeepAliveIntervalSec, serverElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SendValidTransformsOnly, serverElement);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ScatterGatherSendEnabled, serverElement);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SharedMemoryTransportEnabled, serverElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IgtlMessageCrcCheckEnabled, serverElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(LogWarningOnNoDataAvailable, serverElement);
 
@@ -1298,9 +1484,55 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
     }
   }
 
+  this->DatagramBroadcastPort = -1;
+  vtkXMLDataElement* datagramBroadcast = serverElement->FindNestedElementWithName("DatagramBroadcast");
+  if (datagramBroadcast != NULL)
+  {
+    XML_READ_STRING_ATTRIBUTE_NONMEMBER_REQUIRED(Address, this->DatagramBroadcastAddress, datagramBroadcast);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_REQUIRED(int, Port, this->DatagramBroadcastPort, datagramBroadcast);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, MulticastTimeToLive, this->DatagramBroadcastMulticastTimeToLive, datagramBroadcast);
+    if (this->DatagramBroadcastClientInfo.SetClientInfoFromXmlData(datagramBroadcast) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (datagramBroadcast->GetAttribute("ClientHeaderVersion") == NULL)
+    {
+      // Tool status is sent in meta data, which requires header version 2
+      this->DatagramBroadcastClientInfo.SetClientHeaderVersion(this->IGTLHeaderVersion);
+    }
+
+    // Only small tracking data messages fit in datagrams
+    std::vector<std::string> messageTypes;
+    for (std::vector<std::string>::iterator it = this->DatagramBroadcastClientInfo.IgtlMessageTypes.begin(); it != this->DatagramBroadcastClientInfo.IgtlMessageTypes.end(); ++it)
+    {
+      if (igsioCommon::IsEqualInsensitive(*it, "TRANSFORM") || igsioCommon::IsEqualInsensitive(*it, "POSITION") || igsioCommon::IsEqualInsensitive(*it, "TDATA"))
+      {
+        messageTypes.push_back(*it);
+      }
+      else
+      {
+        LOG_WARNING("Message type " << *it << " cannot be sent in datagrams, it is ignored in DatagramBroadcast. Only TRANSFORM, POSITION, and TDATA messages are supported.");
+      }
+    }
+    this->DatagramBroadcastClientInfo.IgtlMessageTypes = messageTypes;
+    this->DatagramBroadcastClientInfo.ImageStreams.clear();
+    this->DatagramBroadcastClientInfo.VideoStreams.clear();
+    this->DatagramBroadcastClientInfo.StringNames.clear();
+    // TDATA is sent without a start request from the subscribers
+    this->DatagramBroadcastClientInfo.SetTDATARequested(true);
+  }
+
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(float, DefaultClientSendTimeoutSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(float, DefaultClientReceiveTimeoutSec, serverElement);
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableMetrics, serverElement);
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(MetricsFileName, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MetricsFileUpdateIntervalSec, serverElement);
+  if (this->EnableMetrics || !this->MetricsFileName.empty())
+  {
+    PlusMetricsRegistry::SetEnabled(true);
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -1310,6 +1542,23 @@ int vtkPlusOpenIGTLinkServer::ProcessPendingCommands()
   return this->PlusCommandProcessor->ExecuteCommands();
 }
 
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::UpdateMetricsFile()
+{
+  if (this->MetricsFileName.empty() || !PlusMetricsRegistry::IsEnabled())
+  {
+    return;
+  }
+  double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (currentTime - this->LastMetricsFileUpdateTime < this->MetricsFileUpdateIntervalSec)
+  {
+    return;
+  }
+  this->LastMetricsFileUpdateTime = currentTime;
+  PLUS_METRIC_GAUGE_SET("plus_server_connected_clients", PlusMetricsRegistry::MakeLabel("channel", this->OutputChannelId), this->GetNumberOfConnectedClients());
+  PlusMetricsRegistry::GetInstance()->WritePrometheusTextFile(vtkPlusConfig::GetInstance()->GetOutputPath(this->MetricsFileName));
+}
+
 //------------------------------------------------------------------------------
 bool vtkPlusOpenIGTLinkServer::HasGracePeriodExpired()
 {
@@ -1359,6 +1608,61 @@ PlusStatus vtkPlusOpenIGTLinkServer::Stop()
   return status;
 }
 
+//------------------------------------------------------------------------------
+igtl::MessageBase::Pointer vtkPlusOpenIGTLinkServer::CreatePolydataMessage(const std::string& polydataName, vtkPolyData* polyData, int headerVersion)
+{
+  igtl::PolyDataMessage::Pointer igtlMessage = dynamic_cast<igtl::PolyDataMessage*>(this->IgtlMessageFactory->CreateSendMessage("POLYDATA", headerVersion).GetPointer());
+  igtlMessage->SetDeviceName("PlusServer");
+  igtlMessage->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, polydataName);
+
+  if (vtkPlusIgtlMessageCommon::PackPolyDataMessage(igtlMessage, polyData, vtkIGSIOAccurateTimer::GetSystemTime()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to create polydata mesage from command response");
+    return NULL;
+  }
+  return igtlMessage.GetPointer();
+}
+
+//------------------------------------------------------------------------------
+vtkSmartPointer<vtkUnsignedCharArray> vtkPlusOpenIGTLinkServer::GetPrepackedPolydataMessage(vtkPlusCommandResponse* response)
+{
+  vtkPlusCommandPolydataResponse* polydataResponse = vtkPlusCommandPolydataResponse::SafeDownCast(response);
+  if (polydataResponse == NULL || polydataResponse->GetModelFilePath().empty())
+  {
+    return nullptr;
+  }
+
+  int replyHeaderVersion = IGTL_HEADER_VERSION_1;
+  PlusIgtlClientInfo info;
+  if (GetClientInfo(response->GetClientId(), info) == PLUS_SUCCESS)
+  {
+    replyHeaderVersion = info.GetClientHeaderVersion();
+  }
+  std::string polydataName = polydataResponse->GetPolyDataName();
+  if (polydataName.empty())
+  {
+    polydataName = "UnknownFile";
+  }
+
+  std::ostringstream assetName;
+  assetName << "vtkPlusOpenIGTLinkServer.POLYDATA.v" << replyHeaderVersion << "." << polydataName;
+  vtkSmartPointer<vtkObject> asset = PlusModelAssetCache::GetInstance()->GetDerivedAsset(polydataResponse->GetModelFilePath(), assetName.str(),
+                                     [this, &polydataName, replyHeaderVersion](vtkPolyData * polyData) -> vtkSmartPointer<vtkObject>
+  {
+    igtl::MessageBase::Pointer igtlMessage = this->CreatePolydataMessage(polydataName, polyData, replyHeaderVersion);
+    if (igtlMessage.IsNull())
+    {
+      return nullptr;
+    }
+    vtkSmartPointer<vtkUnsignedCharArray> packedMessage = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    packedMessage->SetNumberOfTuples(igtlMessage->GetBufferSize());
+    memcpy(packedMessage->GetPointer(0), igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize());
+    return packedMessage;
+  }, polydataResponse->GetTargetReduction());
+
+  return vtkUnsignedCharArray::SafeDownCast(asset);
+}
+
 //------------------------------------------------------------------------------
 igtl::MessageBase::Pointer vtkPlusOpenIGTLinkServer::CreateIgtlMessageFromCommandResponse(vtkPlusCommandResponse* response)
 {
@@ -1431,16 +1735,7 @@ igtl::MessageBase::Pointer vtkPlusOpenIGTLinkServer::CreateIgtlMessageFromComman
       return NULL;
     }
 
-    igtl::PolyDataMessage::Pointer igtlMessage = dynamic_cast<igtl::PolyDataMessage*>(this->IgtlMessageFactory->CreateSendMessage("POLYDATA", replyHeaderVersion).GetPointer());
-    igtlMessage->SetDeviceName("PlusServer");
-    igtlMessage->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, polydataName);
-
-    if (vtkPlusIgtlMessageCommon::PackPolyDataMessage(igtlMessage, polyData, vtkIGSIOAccurateTimer::GetSystemTime()) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to create polydata mesage from command response");
-      return NULL;
-    }
-    return igtlMessage.GetPointer();
+    return this->CreatePolydataMessage(polydataName, polyData, replyHeaderVersion);
   }
 
   vtkPlusCommandImageMetaDataResponse* imageMetaDataResponse = vtkPlusCommandImageMetaDataResponse::SafeDownCast(response);
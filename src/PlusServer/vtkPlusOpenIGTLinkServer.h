@@ -9,6 +9,7 @@
 
 // Local includes
 #include "vtkPlusServerExport.h"
+#include "igtlPlusServerSocket.h"
 #include "PlusIgtlClientInfo.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusIgtlMessageFactory.h"
@@ -37,8 +38,11 @@ class vtkPlusOpenIGTLinkServer;
 class vtkPlusChannel;
 class vtkPlusCommandProcessor;
 class vtkPlusCommandResponse;
+class vtkPolyData;
+class vtkUnsignedCharArray;
 class vtkIGSIORecursiveCriticalSection;
 //class vtkIGSIOTransformRepository;
+class PlusIgtlDatagramChannel;
 
 struct ClientData
 {
@@ -83,6 +87,13 @@ struct ClientData
   requested image and tracking information in the same format as in the DefaultClientInfo element in the device set
   configuration file.
 
+  Tracking data (TRANSFORM, POSITION, TDATA messages) can be broadcast to any number of subscribers in UDP datagrams, in addition
+  to the TCP connections, by adding a DatagramBroadcast element to the server configuration. Its Address attribute is the
+  destination (a multicast group or a unicast address), Port is the destination port, and MulticastTimeToLive limits the number of
+  router hops. The sent messages and transforms are defined by nested MessageTypes and TransformNames elements, in the same format
+  as in the DefaultClientInfo element. Each message is packed and sent once per frame, regardless of the number of subscribers.
+  Commands and images are still sent only through TCP.
+
   \ingroup PlusLibPlusServer
 */
 class vtkPlusServerExport vtkPlusOpenIGTLinkServer: public vtkObject
@@ -120,6 +131,23 @@ public:
   vtkSetMacro(SendValidTransformsOnly, bool);
   vtkGetMacroConst(SendValidTransformsOnly, bool);
 
+  /*!
+    If enabled then image data of TRACKEDFRAME messages is sent directly from the frame memory using vectored
+    socket I/O (no copy into the message buffer) and the messages of each frame are coalesced into full TCP packets
+    (TCP_CORK). Disabled by default.
+  */
+  vtkSetMacro(ScatterGatherSendEnabled, bool);
+  vtkGetMacroConst(ScatterGatherSendEnabled, bool);
+
+  /*!
+    If enabled then clients that connect from the same host and request it in their client info (SharedMemoryTransport="TRUE")
+    receive the image data of TRACKEDFRAME messages through a shared memory ring instead of the socket. The image of each frame
+    is written into the ring once, the messages sent through the socket only contain the metadata and the location of the image
+    in the ring. Requires IGTL header version 2 or later. Disabled by default.
+  */
+  vtkSetMacro(SharedMemoryTransportEnabled, bool);
+  vtkGetMacroConst(SharedMemoryTransportEnabled, bool);
+
   vtkSetMacro(DefaultClientSendTimeoutSec, float);
   vtkGetMacroConst(DefaultClientSendTimeoutSec, float);
 
@@ -153,6 +181,21 @@ public:
   vtkGetMacro(IGTLProtocolVersion, int);
   vtkGetMacro(IGTLHeaderVersion, int);
 
+  /*! Enable collection of runtime performance metrics (see PlusMetricsRegistry). Disabled by default. */
+  vtkSetMacro(EnableMetrics, bool);
+  vtkGetMacroConst(EnableMetrics, bool);
+
+  /*!
+    If not empty then the performance metrics are periodically written to this file in Prometheus text format.
+    Relative paths are interpreted relative to the output directory.
+  */
+  vtkSetStdStringMacro(MetricsFileName);
+  vtkGetStdStringMacro(MetricsFileName);
+
+  /*! Time between metrics file updates */
+  vtkSetMacro(MetricsFileUpdateIntervalSec, double);
+  vtkGetMacroConst(MetricsFileUpdateIntervalSec, double);
+
   /*!
     Execute all commands in the queue from the current thread (useful if commands should be executed from the main thread)
     \return Number of executed commands
@@ -187,12 +230,28 @@ protected:
   /*! Tracked frame interface, sends the selected message type and data to all clients */
   virtual PlusStatus SendTrackedFrame(igsioTrackedFrame& trackedFrame);
 
+  /*! Send the tracking data of the frame to the datagram subscribers (timestamp of the frame must be already converted to UTC) */
+  virtual PlusStatus SendTrackedFrameDatagrams(igsioTrackedFrame& trackedFrame);
+
   /*! Converts a command response to an OpenIGTLink message that can be sent to the client */
   igtl::MessageBase::Pointer CreateIgtlMessageFromCommandResponse(vtkPlusCommandResponse* response);
 
+  /*! Create a packed POLYDATA message */
+  igtl::MessageBase::Pointer CreatePolydataMessage(const std::string& polydataName, vtkPolyData* polyData, int headerVersion);
+
+  /*!
+    Get the packed POLYDATA message of a polydata command response from the model asset cache. The message is packed only once
+    for each model file, level of detail, polydata name, and header version (the message timestamp is the time of the packing).
+    Returns NULL if the response is not a polydata response or its polydata is not from the model asset cache.
+  */
+  vtkSmartPointer<vtkUnsignedCharArray> GetPrepackedPolydataMessage(vtkPlusCommandResponse* response);
+
   /*! Send status message to clients to keep alive the connection */
   virtual void KeepAlive();
 
+  /*! Write the performance metrics file if the update interval has elapsed */
+  void UpdateMetricsFile();
+
   /*! Stops client's data receiving thread, closes the socket, and removes the client from the client list */
   void DisconnectClient(int clientId);
 
@@ -226,7 +285,7 @@ private:
   void operator=(const vtkPlusOpenIGTLinkServer&);
 
   /*! IGTL server socket */
-  igtl::ServerSocket::Pointer ServerSocket;
+  igtl::PlusServerSocket::Pointer ServerSocket;
 
   /*! Transform repository instance */
   vtkSmartPointer<vtkIGSIOTransformRepository> TransformRepository;
@@ -291,6 +350,23 @@ private:
   /*! Whether or not the server should send invalid transforms through the IGT Link */
   bool SendValidTransformsOnly;
 
+  /*! Send image data without copying it into the message buffer and coalesce the messages of a frame */
+  bool ScatterGatherSendEnabled;
+
+  /*! Allow local clients to receive image data through shared memory */
+  bool SharedMemoryTransportEnabled;
+
+  /*! Destination of the tracking data datagrams. Datagram broadcast is disabled if the port is not positive. */
+  std::string DatagramBroadcastAddress;
+  int DatagramBroadcastPort;
+  int DatagramBroadcastMulticastTimeToLive;
+
+  /*! Message types and transforms that are sent in datagrams */
+  PlusIgtlClientInfo DatagramBroadcastClientInfo;
+
+  /*! Datagram sender, only used from the data sender thread */
+  PlusIgtlDatagramChannel* DatagramChannel;
+
   /*!
   Default IGT client info used for sending data to clients.
   Used only if the client didn't set IGT message types and transform/image/string names.
@@ -333,7 +409,10 @@ private:
 
   static const float CLIENT_SOCKET_TIMEOUT_SEC;
 
-  bool NewClientConnected;
+  bool EnableMetrics;
+  std::string MetricsFileName;
+  double MetricsFileUpdateIntervalSec;
+  double LastMetricsFileUpdateTime;
 };
 
 #endif
\ No newline at end of file
@@ -2,6 +2,11 @@
 #include <sys/socket.h>
 #include <ifaddrs.h>
 #include <stdio.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "vtkPlusOpenIGTLinkServerPosix.cxx"
 
 void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
 {
@@ -35,4 +40,13 @@ void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
   }
   ss << " -- port " << self->GetListeningPort();
   LOG_INFO(ss.str());
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------------
+// While corked, the kernel only sends full packets, therefore multiple small messages are coalesced.
+// Uncorking flushes the pending data.
+void SetSocketCork(int socketDescriptor, bool cork)
+{
+  int value = (cork ? 1 : 0);
+  setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NOPUSH, &value, sizeof(value));
+}
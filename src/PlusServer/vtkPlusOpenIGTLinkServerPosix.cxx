@@ -0,0 +1,63 @@
+// Helpers shared by the Linux and MacOSX server sources
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+//----------------------------------------------------------------------------
+// Send memory segments as one contiguous stream without concatenating them into one buffer.
+// Returns 0 on failure (same as igtl::Socket::Send). numberOfBytesSent is set to the number of bytes that were
+// written to the socket, a failed send can only be retried if nothing was written.
+int SendSegments(int socketDescriptor, const std::vector<std::pair<const unsigned char*, size_t> >& segments, size_t& numberOfBytesSent)
+{
+  numberOfBytesSent = 0;
+#ifdef MSG_NOSIGNAL
+  const int flags = MSG_NOSIGNAL;
+#else
+  const int flags = 0;
+#endif
+  std::vector<struct iovec> ioVectors;
+  for (size_t i = 0; i < segments.size(); ++i)
+  {
+    if (segments[i].second > 0)
+    {
+      struct iovec ioVector;
+      ioVector.iov_base = const_cast<unsigned char*>(segments[i].first);
+      ioVector.iov_len = segments[i].second;
+      ioVectors.push_back(ioVector);
+    }
+  }
+
+  size_t firstVector = 0;
+  while (firstVector < ioVectors.size())
+  {
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &ioVectors[firstVector];
+    message.msg_iovlen = ioVectors.size() - firstVector;
+    ssize_t bytesSent = sendmsg(socketDescriptor, &message, flags);
+    if (bytesSent < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (bytesSent < 1)
+    {
+      return 0;
+    }
+    numberOfBytesSent += static_cast<size_t>(bytesSent);
+    // Skip the fully sent segments and adjust the partially sent one
+    size_t remaining = static_cast<size_t>(bytesSent);
+    while (firstVector < ioVectors.size() && remaining >= ioVectors[firstVector].iov_len)
+    {
+      remaining -= ioVectors[firstVector].iov_len;
+      ++firstVector;
+    }
+    if (remaining > 0)
+    {
+      ioVectors[firstVector].iov_base = static_cast<char*>(ioVectors[firstVector].iov_base) + remaining;
+      ioVectors[firstVector].iov_len -= remaining;
+    }
+  }
+  return 1;
+}
@@ -79,4 +79,47 @@ void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
   }
   ss << " -- port " << self->GetListeningPort();
   LOG_INFO(ss.str());
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------------
+// Send memory segments as one contiguous stream without concatenating them into one buffer.
+// Returns 0 on failure (same as igtl::Socket::Send). numberOfBytesSent is set to the number of bytes that were
+// written to the socket, a failed send can only be retried if nothing was written.
+int SendSegments(int socketDescriptor, const std::vector<std::pair<const unsigned char*, size_t> >& segments, size_t& numberOfBytesSent)
+{
+  numberOfBytesSent = 0;
+  size_t totalSize = 0;
+  std::vector<WSABUF> buffers;
+  for (size_t i = 0; i < segments.size(); ++i)
+  {
+    if (segments[i].second > 0)
+    {
+      WSABUF buffer;
+      buffer.buf = reinterpret_cast<CHAR*>(const_cast<unsigned char*>(segments[i].first));
+      buffer.len = static_cast<ULONG>(segments[i].second);
+      buffers.push_back(buffer);
+      totalSize += segments[i].second;
+    }
+  }
+  if (buffers.empty())
+  {
+    return 1;
+  }
+
+  // Blocking sockets send all the buffers before WSASend returns
+  DWORD bytesSent = 0;
+  if (WSASend(static_cast<SOCKET>(socketDescriptor), &buffers[0], static_cast<DWORD>(buffers.size()), &bytesSent, 0, NULL, NULL) != 0)
+  {
+    // The number of bytes sent is not reported on failure, only a send that would have blocked is known to have sent nothing
+    numberOfBytesSent = (WSAGetLastError() == WSAEWOULDBLOCK ? 0 : totalSize);
+    return 0;
+  }
+  numberOfBytesSent = bytesSent;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+// There is no equivalent of TCP_CORK on Windows, messages are sent as they are written
+void SetSocketCork(int socketDescriptor, bool cork)
+{
+}
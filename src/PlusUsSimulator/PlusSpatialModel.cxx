@@ -6,19 +6,19 @@ See License.txt for details.
 
 #include "PlusConfigure.h"
 
+#include "PlusModelAssetCache.h"
 #include "PlusSpatialModel.h"
 
+#include "vtkGenericCell.h"
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
 #include "vtkModifiedBSPTree.h"
 #include "vtkObjectFactory.h"
-#include "vtkSTLReader.h"
-#include "vtkXMLPolyDataReader.h"
+#include "vtkPolyData.h"
 #include "vtkPolyDataNormals.h"
 #include "vtkProbeFilter.h"
 #include "vtkPointData.h"
 #include "vtkIdList.h"
-#include "vtkTriangle.h"
 
 // If fraction of the transmitted beam intensity is smaller then this value then we consider the beam to be completely absorbed
 const double MINIMUM_BEAM_INTENSITY = 1e-9;
@@ -26,6 +26,25 @@ const double MINIMUM_BEAM_INTENSITY = 1e-9;
 // Characterizes the specular reflection BRDF. If the value is smaller then reflection is limited to a smaller angle range (closer to 90deg incidence angle).
 double SPECULAR_REFLECTION_BRDF_STDEV = 30.0;
 
+namespace
+{
+  // Name of the model asset cache entry that stores the model with computed normals
+  const std::string MODEL_WITH_NORMALS_ASSET_NAME = "PlusSpatialModel.ModelWithNormals";
+
+  //-----------------------------------------------------------------------------
+  vtkSmartPointer<vtkObject> CreateModelWithNormals(vtkPolyData* polyData)
+  {
+    vtkSmartPointer<vtkPolyDataNormals> polyDataNormalsComputer = vtkSmartPointer<vtkPolyDataNormals>::New();
+    polyDataNormalsComputer->SetInputData(polyData);
+    polyDataNormalsComputer->Update();
+    vtkSmartPointer<vtkPolyData> polyDataWithNormals = polyDataNormalsComputer->GetOutput();
+    // The mesh is shared between threads, so the lazily built cells and bounds are created here, while it is not shared yet
+    polyDataWithNormals->BuildCells();
+    polyDataWithNormals->ComputeBounds();
+    return polyDataWithNormals;
+  }
+}
+
 //-----------------------------------------------------------------------------
 PlusSpatialModel::PlusSpatialModel()
   : Name("")
@@ -402,6 +421,9 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
 
   // Get surface normals at intersection points
   vtkDataArray* normals_Model = NULL;
+  // The mesh may be shared with other spatial models that are used in other threads, therefore only
+  // those accessors are used that store their result in objects that this thread owns
+  vtkSmartPointer<vtkGenericCell> cell = vtkSmartPointer<vtkGenericCell>::New();
   if (this->PolyData->GetPointData())
   {
     normals_Model = this->PolyData->GetPointData()->GetNormals();
@@ -416,8 +438,8 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
     intersectionPoints_Model->GetPoint(intersectionPointIndex, intersectionPoint_Model);
     modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
     intersectionInfo.IntersectionDistanceFromStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(scanLineStartPoint_Reference, intersectionPoint_Reference));
-    vtkTriangle* cell = vtkTriangle::SafeDownCast(this->PolyData->GetCell(intersectionCellIds->GetId(intersectionPointIndex)));
-    if (cell != NULL && normals_Model != NULL)
+    this->PolyData->GetCell(intersectionCellIds->GetId(intersectionPointIndex), cell);
+    if (cell->GetCellType() == VTK_TRIANGLE && normals_Model != NULL)
     {
       const int NUMBER_OF_POINTS_PER_CELL = 3; // triangle cell
       double pcoords[NUMBER_OF_POINTS_PER_CELL] = {0, 0, 0};
@@ -429,12 +451,8 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
       double interpolatedNormal_Model[3] = {0, 0, 0};
       for (int pointIndex = 0; pointIndex < NUMBER_OF_POINTS_PER_CELL; pointIndex++)
       {
-        double* normalAtCellCorner = normals_Model->GetTuple3(cell->GetPointId(pointIndex));
-        if (normalAtCellCorner == NULL)
-        {
-          LOG_ERROR("SpatialModel::GetLineIntersections error: invalid normal");
-          continue;
-        }
+        double normalAtCellCorner[3] = {0, 0, 0};
+        normals_Model->GetTuple(cell->GetPointId(pointIndex), normalAtCellCorner);
         interpolatedNormal_Model[0] += normalAtCellCorner[0] * weights[pointIndex];
         interpolatedNormal_Model[1] += normalAtCellCorner[1] * weights[pointIndex];
         interpolatedNormal_Model[2] += normalAtCellCorner[2] * weights[pointIndex];
@@ -461,11 +479,7 @@ PlusStatus PlusSpatialModel::UpdateModelFile()
 
   this->ModelFileNeedsUpdate = false;
 
-  if (this->PolyData != NULL)
-  {
-    this->PolyData->Delete();
-    this->PolyData = NULL;
-  }
+  SetPolyData(NULL);
 
   if (this->ModelFile.empty())
   {
@@ -482,40 +496,24 @@ PlusStatus PlusSpatialModel::UpdateModelFile()
     return PLUS_FAIL;
   }
 
-  vtkSmartPointer<vtkPolyData> polyData;
-
-  std::string fileExt = vtksys::SystemTools::GetFilenameLastExtension(foundAbsoluteImagePath);
-  if (igsioCommon::IsEqualInsensitive(fileExt, ".stl"))
-  {
-    vtkSmartPointer<vtkSTLReader> modelReader = vtkSmartPointer<vtkSTLReader>::New();
-    modelReader->SetFileName(foundAbsoluteImagePath.c_str());
-    modelReader->Update();
-    polyData = modelReader->GetOutput();
-  }
-  else //if (igsioCommon::IsEqualInsensitive(fileExt.c_str(),".vtp"))
-  {
-    vtkSmartPointer<vtkXMLPolyDataReader> modelReader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
-    modelReader->SetFileName(foundAbsoluteImagePath.c_str());
-    modelReader->Update();
-    polyData = modelReader->GetOutput();
-  }
-
-  if (polyData.GetPointer() == NULL || polyData->GetNumberOfPoints() == 0)
+  // The model is shared by all spatial models (and simulators) that use the same model file, therefore the model file
+  // is read and the normals are computed only once
+  vtkPolyData* polyData = vtkPolyData::SafeDownCast(
+    PlusModelAssetCache::GetInstance()->GetDerivedAsset(foundAbsoluteImagePath, MODEL_WITH_NORMALS_ASSET_NAME, CreateModelWithNormals));
+  if (polyData == NULL)
   {
     LOG_ERROR("Model specified cannot be found: " << foundAbsoluteImagePath);
     return PLUS_FAIL;
   }
+  SetPolyData(polyData);
 
-  vtkSmartPointer<vtkPolyDataNormals> polyDataNormalsComputer = vtkSmartPointer<vtkPolyDataNormals>::New();
-  polyDataNormalsComputer->SetInputData(polyData);
-  polyDataNormalsComputer->Update();
-  this->PolyData = polyDataNormalsComputer->GetOutput();
-  this->PolyData->Register(NULL);
-
-  this->ModelLocalizer->SetDataSet(this->PolyData);
-  this->ModelLocalizer->SetMaxLevel(24);
-  this->ModelLocalizer->SetNumberOfCellsPerNode(32);
-  this->ModelLocalizer->BuildLocator();
+  // The localizer is not shared, because intersection queries modify its internal state
+  vtkSmartPointer<vtkModifiedBSPTree> modelLocalizer = vtkSmartPointer<vtkModifiedBSPTree>::New();
+  modelLocalizer->SetDataSet(this->PolyData);
+  modelLocalizer->SetMaxLevel(24);
+  modelLocalizer->SetNumberOfCellsPerNode(32);
+  modelLocalizer->BuildLocator();
+  SetModelLocalizer(modelLocalizer);
 
   return PLUS_SUCCESS;
 }